@@ -55,6 +55,7 @@ enum PINT_perf_type
 {
     PINT_PERF_COUNTER = 0,
     PINT_PERF_TIMER = 1,
+    PINT_PERF_HISTOGRAM = 2,
 };
 
 /*
@@ -89,6 +90,8 @@ enum PINT_server_perf_keys
     PINT_PERF_IO = 20,                  /* io requests called */
     PINT_PERF_SMALL_IO = 21,            /* small_io requests called */
     PINT_PERF_READDIR = 22,             /* readdir requests called */
+    PINT_PERF_OPEN_CACHE_HITS = 23,     /* bstream fd cache hits */
+    PINT_PERF_OPEN_CACHE_MISSES = 24,   /* bstream fd cache misses */
 };
 
 /*
@@ -119,6 +122,51 @@ struct PINT_perf_timer
     int64_t max;   /* maximum time sample */
 };
 
+/** per-operation latency histograms kept by the server, one key per
+ * group of request types
+ */
+enum PINT_server_perf_hkeys
+{
+    PINT_PERF_HLOOKUP = 0,              /* lookup latency */
+    PINT_PERF_HCREATE = 1,              /* create latency */
+    PINT_PERF_HREMOVE = 2,              /* remove latency */
+    PINT_PERF_HMKDIR = 3,               /* mkdir latency */
+    PINT_PERF_HGETATTR = 4,             /* getattr latency */
+    PINT_PERF_HSETATTR = 5,             /* setattr latency */
+    PINT_PERF_HCRDIRENT = 6,            /* crdirent latency */
+    PINT_PERF_HRMDIRENT = 7,            /* rmdirent latency */
+    PINT_PERF_HIO = 8,                  /* io latency */
+    PINT_PERF_HSMALL_IO = 9,            /* small_io latency */
+    PINT_PERF_HREADDIR = 10,            /* readdir latency */
+    PINT_PERF_HLISTATTR = 11,           /* listattr latency */
+    PINT_PERF_HEATTR = 12,              /* get/set/del/list eattr latency */
+    PINT_PERF_HOTHER = 13,              /* latency of everything else */
+    PINT_PERF_HKEY_COUNT = 14
+};
+
+/** A histogram bins latencies (in microseconds) HDR style: values below
+ * PINT_PERF_HIST_SUB_COUNT get a bucket each, and every power of two
+ * above that is split into PINT_PERF_HIST_SUB_COUNT equal buckets, so the
+ * relative error of a percentile read from the histogram stays under
+ * 1/PINT_PERF_HIST_SUB_COUNT.  Values of 2^PINT_PERF_HIST_MAX_BITS
+ * microseconds (about 16 seconds) and above land in a final overflow
+ * bucket.
+ */
+#define PINT_PERF_HIST_SUB_BITS 2
+#define PINT_PERF_HIST_SUB_COUNT (1 << PINT_PERF_HIST_SUB_BITS)
+#define PINT_PERF_HIST_MAX_BITS 24
+#define PINT_PERF_HIST_BUCKETS \
+    (((PINT_PERF_HIST_MAX_BITS - PINT_PERF_HIST_SUB_BITS + 1) * \
+      PINT_PERF_HIST_SUB_COUNT) + 1)
+
+struct PINT_perf_histogram
+{
+    int64_t count; /* number of samples recorded */
+    int64_t sum;   /* sum of all samples in ns, for computing avg */
+    int64_t max;   /* largest sample in ns */
+    int64_t bucket[PINT_PERF_HIST_BUCKETS]; /* samples per latency bucket */
+};
+
 /* low level information about individual server level objects */
 struct PVFS_mgmt_dspace_info
 {
@@ -730,6 +730,9 @@ int PVFS_sys_wait(
     const char *in_op_str,
     int *out_error);
 
+/* releases an op completed with PVFS_sys_wait */
+void PVFS_sys_release(PVFS_sys_op_id op_id);
+
 int PVFS_sys_cancel(PVFS_sys_op_id op_id);
 
 #endif
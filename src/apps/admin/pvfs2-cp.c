@@ -7,6 +7,10 @@
 /* pvfs2-cp:
  *         copy a file from a unix or PVFS2 file system to a unix or PVFS2 file
  *         system.  Should replace pvfs2-import and pvfs2-export.
+ *
+ *         With -p the copy keeps several stripe aligned buffers moving at
+ *         once through the nonblocking I/O calls, and with -r it copies a
+ *         directory tree using a pool of worker threads.
  */
 #include <stdio.h>
 #include <stdlib.h>
@@ -20,12 +24,16 @@
 #include <time.h>
 #include <libgen.h>
 #include <getopt.h>
+#include <errno.h>
+#include <dirent.h>
+#include <pthread.h>
 
 #include "pvfs2.h"
 #include "str-utils.h"
 #include "pint-sysint-utils.h"
 #include "pvfs2-internal.h"
 #include "pvfs2-hint.h"
+#include "client-state-machine.h"
 
 /* optional parameters, filled in by parse_args() */
 struct options
@@ -36,6 +44,9 @@ struct options
     char* srcfile;
     char* destfile;
     int show_timings;
+    int depth;
+    int recursive;
+    int workers;
 };
 
 enum object_type {
@@ -51,8 +62,8 @@ enum open_type {
 typedef struct pvfs2_file_object_s {
     PVFS_fs_id fs_id;
     PVFS_object_ref ref;
-    char pvfs2_path[PVFS_NAME_MAX+1];
-    char user_path[PVFS_NAME_MAX+1];
+    char pvfs2_path[PVFS_PATH_MAX+1];
+    char user_path[PVFS_PATH_MAX+1];
     PVFS_sys_attr attr;
     PVFS_permissions perms;
 } pvfs2_file_object;
@@ -60,7 +71,7 @@ typedef struct pvfs2_file_object_s {
 typedef struct unix_file_object_s {
     int fd;
     int mode;
-    char path[NAME_MAX+1];
+    char path[PATH_MAX+1];
 } unix_file_object;
 
 typedef struct file_object_s {
@@ -71,6 +82,39 @@ typedef struct file_object_s {
     } u;
 } file_object;
 
+enum slot_state {
+    SLOT_IDLE,
+    SLOT_READ,
+    SLOT_WRITE
+};
+
+/* one buffer of a pipelined copy, read from the source and then written
+ * to the same offset of the destination */
+typedef struct copy_slot_s {
+    char *buffer;
+    int64_t offset;
+    size_t count;
+    int state;
+    int pending;                /* a PVFS2 operation is in flight */
+    int64_t done;               /* result of the last operation */
+    PVFS_Request mem_req;
+    PVFS_sysresp_io resp_io;
+    PVFS_sys_op_id op_id;
+} copy_slot;
+
+/* files found under the source directory, handed out to the workers */
+typedef struct copy_queue_s {
+    struct options *opts;
+    char **src;
+    char **dest;
+    int count;
+    int alloc;
+    int next;
+    int errors;
+    int64_t total;
+    pthread_mutex_t lock;
+} copy_queue;
+
 static PVFS_hint hints = NULL;
 
 static struct options* parse_args(int argc, char* argv[]);
@@ -89,6 +133,16 @@ static int generic_cleanup(file_object *src, file_object *dest,
 static void make_attribs(PVFS_sys_attr *attr,
                          PVFS_credential *credentials,
                          int nr_datafiles, int mode);
+static int copy_file(struct options *opts, char *srcfile, char *destfile,
+                     PVFS_credential *credentials, int64_t *total);
+static int copy_serial(struct options *opts, file_object *src,
+                       file_object *dest, PVFS_credential *credentials,
+                       int64_t *total);
+static int copy_pipelined(struct options *opts, file_object *src,
+                          file_object *dest, PVFS_credential *credentials,
+                          int64_t *total);
+static int copy_tree(struct options *opts, PVFS_credential *credentials,
+                     int64_t *total);
 
 static int convert_pvfs2_perms_to_mode(PVFS_permissions perms)
 {
@@ -120,10 +174,7 @@ int main (int argc, char ** argv)
 {
     struct options* user_opts = NULL;
     double time1=0, time2=0;
-    int current_size=0;
-    int64_t total_written=0, buffer_size=0;
-    file_object src, dest;
-    void* buffer = NULL;
+    int64_t total_written=0;
     int64_t ret;
     PVFS_credential credentials;
 
@@ -142,11 +193,6 @@ int main (int argc, char ** argv)
         PVFS_perror("PVFS_util_init_defaults", ret);
         return(-1);
     }
-    memset(&src, 0, sizeof(src));
-    memset(&dest, 0, sizeof(src));
-
-    resolve_filename(&src,  user_opts->srcfile );
-    resolve_filename(&dest, user_opts->destfile);
 
     ret = PVFS_util_gen_credential_defaults(&credentials);
     if (ret < 0)
@@ -155,39 +201,103 @@ int main (int argc, char ** argv)
         goto main_out;
     }
 
-    ret = generic_open(&src, &credentials, 0, 0, NULL, OPEN_SRC);
-    if (ret < 0)
+    time1 = Wtime();
+    if (user_opts->recursive)
     {
-        fprintf(stderr, "Could not open %s\n", user_opts->srcfile);
-        goto main_out;
+        ret = copy_tree(user_opts, &credentials, &total_written);
+    }
+    else
+    {
+        ret = copy_file(user_opts, user_opts->srcfile, user_opts->destfile,
+                        &credentials, &total_written);
     }
+    time2 = Wtime();
 
-    ret = generic_open(&dest, &credentials, user_opts->num_datafiles, user_opts->strip_size,
-                       user_opts->srcfile, OPEN_DEST);
+    if (ret == 0 && user_opts->show_timings)
+    {
+        print_timings(time2-time1, total_written);
+    }
 
+main_out:
+    PVFS_sys_finalize();
+    PINT_cleanup_credential(&credentials);
+    free(user_opts);
+
+    PVFS_hint_free(&hints);
+    return(ret);
+}
+
+/* copy_file:
+ *  copy 'srcfile' to 'destfile', adding the bytes copied to 'total'
+ */
+static int copy_file(struct options *opts, char *srcfile, char *destfile,
+                     PVFS_credential *credentials, int64_t *total)
+{
+    file_object src, dest;
+    int ret;
+
+    memset(&src, 0, sizeof(src));
+    memset(&dest, 0, sizeof(dest));
+
+    resolve_filename(&src,  srcfile );
+    resolve_filename(&dest, destfile);
+
+    ret = generic_open(&src, credentials, 0, 0, NULL, OPEN_SRC);
     if (ret < 0)
     {
-        fprintf(stderr, "Could not open %s\n", user_opts->destfile);
-        goto main_out;
+        fprintf(stderr, "Could not open %s\n", srcfile);
+        goto copy_out;
+    }
+
+    ret = generic_open(&dest, credentials, opts->num_datafiles,
+                       opts->strip_size, srcfile, OPEN_DEST);
+    if (ret < 0)
+    {
+        fprintf(stderr, "Could not open %s\n", destfile);
+        goto copy_out;
+    }
+
+    if (opts->depth > 1)
+    {
+        ret = copy_pipelined(opts, &src, &dest, credentials, total);
+    }
+    else
+    {
+        ret = copy_serial(opts, &src, &dest, credentials, total);
     }
 
+copy_out:
+    generic_cleanup(&src, &dest, credentials);
+    return ret;
+}
+
+/* copy_serial:
+ *  move one buffer at a time: read a chunk, then write it
+ */
+static int copy_serial(struct options *opts, file_object *src,
+                       file_object *dest, PVFS_credential *credentials,
+                       int64_t *total)
+{
+    int current_size=0;
+    int64_t total_written=0, buffer_size=0;
+    void* buffer = NULL;
+    int64_t ret;
+
     /* start moving data */
-    buffer = malloc(user_opts->buf_size);
+    buffer = malloc(opts->buf_size);
     if(!buffer)
     {
         perror("malloc");
-        ret = -1;
-        goto main_out;
+        return -1;
     }
 
-    time1 = Wtime();
-    while((current_size = generic_read(&src, buffer,
-                    total_written, user_opts->buf_size, &credentials)) > 0)
+    while((current_size = generic_read(src, buffer,
+                    total_written, opts->buf_size, credentials)) > 0)
     {
         buffer_size = current_size;
 
-        ret = generic_write(&dest, buffer, total_written,
-                buffer_size, &credentials);
+        ret = generic_write(dest, buffer, total_written,
+                buffer_size, credentials);
         if (ret != current_size)
         {
             if (ret == -1) {
@@ -195,30 +305,699 @@ int main (int argc, char ** argv)
             } else {
                 fprintf(stderr, "Error in write\n");
             }
-            ret = -1;
-            goto main_out;
+            free(buffer);
+            *total += total_written;
+            return -1;
         }
         total_written += current_size;
     }
 
-    time2 = Wtime();
+    free(buffer);
+    *total += total_written;
+    return 0;
+}
 
-    if (user_opts->show_timings)
+/* generic_size:
+ *  return the size of an open (unix or pvfs2) file, or -1
+ */
+static int64_t generic_size(file_object *obj, PVFS_credential *credentials)
+{
+    PVFS_sysresp_getattr resp_getattr;
+    struct stat stat_buf;
+    int ret;
+
+    if (obj->fs_type == UNIX_FILE)
     {
-        print_timings(time2-time1, total_written);
+        if (fstat(obj->u.ufs.fd, &stat_buf) < 0)
+        {
+            perror("fstat");
+            return -1;
+        }
+        return stat_buf.st_size;
     }
 
-    ret = 0;
+    memset(&resp_getattr, 0, sizeof(PVFS_sysresp_getattr));
+    ret = PVFS_sys_getattr(obj->u.pvfs2.ref, PVFS_ATTR_SYS_SIZE,
+                           credentials, &resp_getattr, hints);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_getattr", ret);
+        return -1;
+    }
+    return resp_getattr.attr.size;
+}
+
+/* copy_chunk_size:
+ *  round the buffer size up to whole stripes of the PVFS2 destination (or
+ *  source), so that every chunk keeps all of the file's servers busy
+ */
+static size_t copy_chunk_size(struct options *opts, file_object *src,
+                              file_object *dest, PVFS_credential *credentials)
+{
+    PVFS_sysresp_getattr resp_getattr;
+    file_object *obj = (dest->fs_type == PVFS2_FILE) ? dest : src;
+    int64_t chunk = opts->buf_size;
+    int64_t width;
+
+    if (obj->fs_type != PVFS2_FILE)
+    {
+        return chunk;
+    }
+
+    /* the block size is the strip size times the number of datafiles */
+    memset(&resp_getattr, 0, sizeof(PVFS_sysresp_getattr));
+    if (PVFS_sys_getattr(obj->u.pvfs2.ref,
+                         PVFS_ATTR_SYS_BLKSIZE | PVFS_ATTR_SYS_DFILE_COUNT,
+                         credentials, &resp_getattr, hints) == 0 &&
+        (resp_getattr.attr.mask & PVFS_ATTR_SYS_BLKSIZE) &&
+        resp_getattr.attr.blksize > 0)
+    {
+        width = resp_getattr.attr.blksize;
+        chunk = ((chunk + width - 1) / width) * width;
+    }
+    return chunk;
+}
+
+/* start_io:
+ *  start reading or writing the chunk of 'slot'.  Unix I/O completes here,
+ *  PVFS2 I/O is posted and left pending unless it finished immediately.
+ */
+static int start_io(file_object *obj, copy_slot *slot, int state,
+                    PVFS_credential *credentials)
+{
+    int ret;
+
+    slot->state = state;
+    slot->pending = 0;
+    slot->done = 0;
+
+    if (obj->fs_type == UNIX_FILE)
+    {
+        if (state == SLOT_READ)
+        {
+            slot->done = pread(obj->u.ufs.fd, slot->buffer, slot->count,
+                               slot->offset);
+        }
+        else
+        {
+            slot->done = pwrite(obj->u.ufs.fd, slot->buffer, slot->count,
+                                slot->offset);
+        }
+        if (slot->done < 0)
+        {
+            perror((state == SLOT_READ) ? "pread" : "pwrite");
+            return -1;
+        }
+        return 0;
+    }
+
+    ret = PVFS_Request_contiguous(slot->count, PVFS_BYTE, &slot->mem_req);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_Request_contiguous", ret);
+        slot->done = ret;
+        return ret;
+    }
+    PVFS_util_refresh_credential(credentials);
+    memset(&slot->resp_io, 0, sizeof(PVFS_sysresp_io));
+    ret = PVFS_isys_io(obj->u.pvfs2.ref, PVFS_BYTE, slot->offset,
+                       slot->buffer, slot->mem_req, credentials,
+                       &slot->resp_io,
+                       (state == SLOT_READ) ? PVFS_IO_READ : PVFS_IO_WRITE,
+                       &slot->op_id, hints, NULL);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_isys_io", ret);
+        PVFS_Request_free(&slot->mem_req);
+        slot->done = ret;
+        return ret;
+    }
+    if (slot->op_id == -1)
+    {
+        PVFS_Request_free(&slot->mem_req);
+        slot->done = slot->resp_io.total_completed;
+    }
+    else
+    {
+        slot->pending = 1;
+    }
+    return 0;
+}
+
+/* copy_pipelined:
+ *  keep 'depth' stripe aligned chunks in flight.  Each slot reads the next
+ *  chunk of the source and, once the read is done, writes it to the same
+ *  offset of the destination, so reads and writes of different chunks
+ *  overlap.
+ */
+static int copy_pipelined(struct options *opts, file_object *src,
+                          file_object *dest, PVFS_credential *credentials,
+                          int64_t *total)
+{
+    copy_slot *slots = NULL, *slot, *oldest;
+    int64_t size, next = 0;
+    size_t chunk;
+    int depth = opts->depth;
+    int i, busy, error, rc, ret = 0;
+
+    size = generic_size(src, credentials);
+    if (size < 0)
+    {
+        return -1;
+    }
+    chunk = copy_chunk_size(opts, src, dest, credentials);
+
+    slots = calloc(depth, sizeof(copy_slot));
+    if (!slots)
+    {
+        perror("calloc");
+        ret = -1;
+        goto pipe_out;
+    }
+    for (i = 0; i < depth; i++)
+    {
+        slots[i].buffer = malloc(chunk);
+        if (!slots[i].buffer)
+        {
+            perror("malloc");
+            ret = -1;
+            goto pipe_out;
+        }
+    }
+
+    for (;;)
+    {
+        /* start reading the next chunks into the idle slots */
+        for (i = 0; i < depth && ret == 0 && next < size; i++)
+        {
+            slot = &slots[i];
+            if (slot->state != SLOT_IDLE)
+            {
+                continue;
+            }
+            slot->offset = next;
+            slot->count = (size - next < (int64_t)chunk) ?
+                          (size_t)(size - next) : chunk;
+            next += slot->count;
+            if (start_io(src, slot, SLOT_READ, credentials) < 0)
+            {
+                ret = -1;
+            }
+        }
+
+        /* a finished read becomes a write, a finished write frees its slot */
+        for (i = 0; i < depth; i++)
+        {
+            slot = &slots[i];
+            while (slot->state != SLOT_IDLE && !slot->pending)
+            {
+                if (slot->done < 0 || ret < 0)
+                {
+                    ret = -1;
+                }
+                else if (slot->state == SLOT_READ && slot->done > 0)
+                {
+                    slot->count = slot->done;
+                    if (start_io(dest, slot, SLOT_WRITE, credentials) < 0)
+                    {
+                        ret = -1;
+                        slot->state = SLOT_IDLE;
+                    }
+                    continue;
+                }
+                else if (slot->state == SLOT_WRITE)
+                {
+                    if (slot->done != (int64_t)slot->count)
+                    {
+                        fprintf(stderr, "Error in write\n");
+                        ret = -1;
+                    }
+                    else
+                    {
+                        *total += slot->done;
+                    }
+                }
+                slot->state = SLOT_IDLE;
+            }
+        }
+
+        busy = 0;
+        oldest = NULL;
+        for (i = 0; i < depth; i++)
+        {
+            if (slots[i].state != SLOT_IDLE)
+            {
+                busy = 1;
+            }
+            if (slots[i].pending &&
+                (!oldest || slots[i].offset < oldest->offset))
+            {
+                oldest = &slots[i];
+            }
+        }
+        if (!busy && (ret < 0 || next >= size))
+        {
+            break;
+        }
+        if (!oldest)
+        {
+            continue;
+        }
+
+        /* wait for this copy's own operations only; testsome would also
+         * reap those of other copies running in other threads
+         */
+        slot = oldest;
+        error = 0;
+        rc = PVFS_sys_wait(slot->op_id, (slot->state == SLOT_READ) ?
+                           "read" : "write", &error);
+        PINT_sys_release(slot->op_id);
+        slot->pending = 0;
+        PVFS_Request_free(&slot->mem_req);
+        if (rc < 0 || error)
+        {
+            PVFS_perror((slot->state == SLOT_READ) ?
+                        "PVFS_isys_read" : "PVFS_isys_write",
+                        rc < 0 ? rc : error);
+            slot->done = rc < 0 ? rc : error;
+        }
+        else
+        {
+            slot->done = slot->resp_io.total_completed;
+        }
+    }
+
+pipe_out:
+    if (slots)
+    {
+        for (i = 0; i < depth; i++)
+        {
+            /* the buffer of an operation that never completed stays put */
+            if (!slots[i].pending)
+            {
+                free(slots[i].buffer);
+            }
+        }
+    }
+    free(slots);
+    return ret;
+}
+
+/* join_path:
+ *  return a newly allocated "dir/name"
+ */
+static char *join_path(const char *dir, const char *name)
+{
+    size_t len = strlen(dir);
+    char *path = malloc(len + strlen(name) + 2);
+
+    if (path)
+    {
+        sprintf(path, "%s%s%s", dir,
+                (len && dir[len - 1] == '/') ? "" : "/", name);
+    }
+    return path;
+}
+
+/* queue_add:
+ *  add a file to the work queue, which takes over both paths
+ */
+static int queue_add(copy_queue *queue, char *src, char *dest)
+{
+    char **new_src, **new_dest;
+    int alloc;
+
+    if (queue->count == queue->alloc)
+    {
+        alloc = queue->alloc ? queue->alloc * 2 : 1024;
+        new_src = realloc(queue->src, alloc * sizeof(char *));
+        if (new_src)
+        {
+            queue->src = new_src;
+        }
+        new_dest = realloc(queue->dest, alloc * sizeof(char *));
+        if (new_dest)
+        {
+            queue->dest = new_dest;
+        }
+        if (!new_src || !new_dest)
+        {
+            perror("realloc");
+            return -1;
+        }
+        queue->alloc = alloc;
+    }
+    queue->src[queue->count] = src;
+    queue->dest[queue->count] = dest;
+    queue->count++;
+    return 0;
+}
+
+/* make_dir:
+ *  create the (unix or pvfs2) directory 'path', which may already exist.
+ *  The owner keeps write permission so the copy can fill it in.
+ */
+static int make_dir(char *path, int mode, PVFS_credential *credentials)
+{
+    file_object obj;
+    PVFS_object_ref parent_ref;
+    PVFS_sys_attr attr;
+    PVFS_sysresp_mkdir resp_mkdir;
+    char str_buf[PVFS_NAME_MAX];
+    int ret;
+
+    memset(&obj, 0, sizeof(obj));
+    resolve_filename(&obj, path);
+    if (obj.fs_type == UNIX_FILE)
+    {
+        if (mkdir(path, mode | S_IRWXU) < 0 && errno != EEXIST)
+        {
+            perror("mkdir");
+            fprintf(stderr, "could not create %s\n", path);
+            return -1;
+        }
+        return 0;
+    }
+
+    if (strcmp(obj.u.pvfs2.pvfs2_path, "/") == 0)
+    {
+        return 0;
+    }
+    if (PINT_remove_base_dir(obj.u.pvfs2.pvfs2_path, str_buf, PVFS_NAME_MAX))
+    {
+        fprintf(stderr, "Error: cannot retrieve entry name for "
+                "creation on %s\n", path);
+        return -1;
+    }
+    ret = PINT_lookup_parent(obj.u.pvfs2.pvfs2_path, obj.u.pvfs2.fs_id,
+                             credentials, &parent_ref.handle);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_util_lookup_parent", ret);
+        return -1;
+    }
+    parent_ref.fs_id = obj.u.pvfs2.fs_id;
+
+    memset(&attr, 0, sizeof(PVFS_sys_attr));
+    make_attribs(&attr, credentials, -1, mode | S_IRWXU);
+    ret = PVFS_sys_mkdir(str_buf, parent_ref, attr, credentials,
+                         &resp_mkdir, hints);
+    if (ret < 0 && ret != -PVFS_EEXIST)
+    {
+        PVFS_perror("PVFS_sys_mkdir", ret);
+        return -1;
+    }
+    return 0;
+}
+
+/* walk_tree:
+ *  create 'destdir' and queue a copy of every regular file below 'srcdir'
+ */
+static int walk_tree(char *srcdir, char *destdir,
+                     PVFS_credential *credentials, copy_queue *queue)
+{
+    file_object obj;
+    PVFS_sysresp_lookup resp_lookup;
+    PVFS_sysresp_getattr resp_getattr;
+    PVFS_sysresp_readdirplus resp_rdplus;
+    PVFS_ds_position token;
+    struct stat stat_buf;
+    struct dirent *entry;
+    DIR *dir;
+    char *name, *src, *dest;
+    int is_dir, is_file;
+    int i, ret = 0;
+
+    memset(&obj, 0, sizeof(obj));
+    resolve_filename(&obj, srcdir);
+
+    if (obj.fs_type == UNIX_FILE)
+    {
+        if (stat(srcdir, &stat_buf) < 0 || !S_ISDIR(stat_buf.st_mode))
+        {
+            fprintf(stderr, "%s is not a directory\n", srcdir);
+            return -1;
+        }
+        if (make_dir(destdir, stat_buf.st_mode & 07777, credentials) < 0)
+        {
+            return -1;
+        }
+        dir = opendir(srcdir);
+        if (!dir)
+        {
+            perror("opendir");
+            return -1;
+        }
+        while (ret == 0 && (entry = readdir(dir)) != NULL)
+        {
+            if (PINT_is_dot_dir(entry->d_name))
+            {
+                continue;
+            }
+            src = join_path(srcdir, entry->d_name);
+            dest = join_path(destdir, entry->d_name);
+            if (!src || !dest || lstat(src, &stat_buf) < 0)
+            {
+                perror(src ? "lstat" : "malloc");
+                ret = -1;
+            }
+            else if (S_ISDIR(stat_buf.st_mode))
+            {
+                ret = walk_tree(src, dest, credentials, queue);
+            }
+            else if (S_ISREG(stat_buf.st_mode))
+            {
+                ret = queue_add(queue, src, dest);
+                if (ret == 0)
+                {
+                    continue;
+                }
+            }
+            else
+            {
+                fprintf(stderr, "Skipping %s: not a regular file\n", src);
+            }
+            free(src);
+            free(dest);
+        }
+        closedir(dir);
+        return ret;
+    }
+
+    memset(&resp_lookup, 0, sizeof(PVFS_sysresp_lookup));
+    ret = PVFS_sys_lookup(obj.u.pvfs2.fs_id, obj.u.pvfs2.pvfs2_path,
+                          credentials, &resp_lookup,
+                          PVFS2_LOOKUP_LINK_FOLLOW, hints);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_lookup", ret);
+        return -1;
+    }
+    memset(&resp_getattr, 0, sizeof(PVFS_sysresp_getattr));
+    ret = PVFS_sys_getattr(resp_lookup.ref,
+                           PVFS_ATTR_SYS_TYPE | PVFS_ATTR_SYS_PERM,
+                           credentials, &resp_getattr, hints);
+    if (ret < 0 || resp_getattr.attr.objtype != PVFS_TYPE_DIRECTORY)
+    {
+        fprintf(stderr, "%s is not a directory\n", srcdir);
+        return -1;
+    }
+    if (make_dir(destdir, convert_pvfs2_perms_to_mode(
+                     resp_getattr.attr.perms), credentials) < 0)
+    {
+        return -1;
+    }
+
+    token = PVFS_ITERATE_START;
+    do
+    {
+        memset(&resp_rdplus, 0, sizeof(PVFS_sysresp_readdirplus));
+        ret = PVFS_sys_readdirplus(resp_lookup.ref, token, 64, credentials,
+                                   PVFS_ATTR_SYS_TYPE, &resp_rdplus, hints);
+        if (ret < 0)
+        {
+            PVFS_perror("PVFS_sys_readdirplus", ret);
+            return -1;
+        }
+
+        for (i = 0; i < resp_rdplus.pvfs_dirent_outcount; i++)
+        {
+            if (ret < 0)
+            {
+                break;
+            }
+            name = resp_rdplus.dirent_array[i].d_name;
+            is_dir = !resp_rdplus.stat_err_array[i] &&
+                resp_rdplus.attr_array[i].objtype == PVFS_TYPE_DIRECTORY;
+            is_file = !resp_rdplus.stat_err_array[i] &&
+                resp_rdplus.attr_array[i].objtype == PVFS_TYPE_METAFILE;
+            src = join_path(srcdir, name);
+            dest = join_path(destdir, name);
+            if (!src || !dest)
+            {
+                perror("malloc");
+                ret = -1;
+            }
+            else if (is_dir)
+            {
+                ret = walk_tree(src, dest, credentials, queue);
+            }
+            else if (is_file)
+            {
+                ret = queue_add(queue, src, dest);
+                if (ret == 0)
+                {
+                    continue;
+                }
+            }
+            else
+            {
+                fprintf(stderr, "Skipping %s: not a regular file\n", src);
+            }
+            free(src);
+            free(dest);
+        }
+        token = resp_rdplus.token;
+
+        if (resp_rdplus.pvfs_dirent_outcount)
+        {
+            free(resp_rdplus.dirent_array);
+            free(resp_rdplus.stat_err_array);
+            for (i = 0; i < resp_rdplus.pvfs_dirent_outcount; i++)
+            {
+                if (resp_rdplus.attr_array)
+                {
+                    PVFS_util_release_sys_attr(&resp_rdplus.attr_array[i]);
+                }
+            }
+            free(resp_rdplus.attr_array);
+        }
+    } while (ret == 0 && token != PVFS_ITERATE_END);
+
+    return ret;
+}
+
+/* copy_worker:
+ *  copy files from the queue until it is empty
+ */
+static void *copy_worker(void *arg)
+{
+    copy_queue *queue = (copy_queue *)arg;
+    PVFS_credential credentials;
+    int64_t written;
+    int i, ret;
+
+    /* credentials are refreshed during I/O, so each worker has its own */
+    ret = PVFS_util_gen_credential_defaults(&credentials);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_util_gen_credential", ret);
+        pthread_mutex_lock(&queue->lock);
+        queue->errors++;
+        pthread_mutex_unlock(&queue->lock);
+        return NULL;
+    }
+
+    for (;;)
+    {
+        pthread_mutex_lock(&queue->lock);
+        i = (queue->next < queue->count) ? queue->next++ : -1;
+        pthread_mutex_unlock(&queue->lock);
+        if (i < 0)
+        {
+            break;
+        }
+
+        written = 0;
+        ret = copy_file(queue->opts, queue->src[i], queue->dest[i],
+                        &credentials, &written);
+
+        pthread_mutex_lock(&queue->lock);
+        queue->total += written;
+        if (ret < 0)
+        {
+            queue->errors++;
+        }
+        pthread_mutex_unlock(&queue->lock);
+    }
 
-main_out:
-    generic_cleanup(&src, &dest, &credentials);
-    PVFS_sys_finalize();
     PINT_cleanup_credential(&credentials);
-    free(user_opts);
-    free(buffer);
+    return NULL;
+}
 
-    PVFS_hint_free(&hints);
-    return(ret);
+/* copy_tree:
+ *  copy the directory tree 'srcfile' to 'destfile' with a pool of workers
+ */
+static int copy_tree(struct options *opts, PVFS_credential *credentials,
+                     int64_t *total)
+{
+    copy_queue queue;
+    pthread_t *threads;
+    int workers, started = 0;
+    int i, ret;
+
+    memset(&queue, 0, sizeof(copy_queue));
+    queue.opts = opts;
+    pthread_mutex_init(&queue.lock, NULL);
+
+    /* "dir/" names the same directory as "dir" */
+    for (i = strlen(opts->srcfile) - 1; i > 0 && opts->srcfile[i] == '/'; i--)
+    {
+        opts->srcfile[i] = '\0';
+    }
+    for (i = strlen(opts->destfile) - 1;
+         i > 0 && opts->destfile[i] == '/'; i--)
+    {
+        opts->destfile[i] = '\0';
+    }
+
+    ret = walk_tree(opts->srcfile, opts->destfile, credentials, &queue);
+    if (ret == 0 && queue.count > 0)
+    {
+        workers = (opts->workers < queue.count) ? opts->workers : queue.count;
+        threads = malloc(workers * sizeof(pthread_t));
+        if (!threads)
+        {
+            perror("malloc");
+            ret = -1;
+        }
+        for (i = 0; threads && i < workers; i++)
+        {
+            if (pthread_create(&threads[i], NULL, copy_worker, &queue) != 0)
+            {
+                perror("pthread_create");
+                break;
+            }
+            started++;
+        }
+        /* with no worker running, nothing gets copied */
+        if (threads && started == 0)
+        {
+            ret = -1;
+        }
+        for (i = 0; i < started; i++)
+        {
+            pthread_join(threads[i], NULL);
+        }
+        free(threads);
+        if (queue.errors)
+        {
+            fprintf(stderr, "%d of %d files could not be copied\n",
+                    queue.errors, queue.count);
+            ret = -1;
+        }
+    }
+    *total = queue.total;
+
+    for (i = 0; i < queue.count; i++)
+    {
+        free(queue.src[i]);
+        free(queue.dest[i]);
+    }
+    free(queue.src);
+    free(queue.dest);
+    pthread_mutex_destroy(&queue.lock);
+    return ret;
 }
 
 /* parse_args()
@@ -229,7 +1008,7 @@ main_out:
  */
 static struct options* parse_args(int argc, char* argv[])
 {
-    char flags[] = "tvs:n:b:";
+    char flags[] = "tvrs:n:b:p:w:";
     int one_opt = 0;
 
     struct options* tmp_opts = NULL;
@@ -246,6 +1025,8 @@ static struct options* parse_args(int argc, char* argv[])
     tmp_opts->strip_size = -1;
     tmp_opts->num_datafiles = -1;
     tmp_opts->buf_size = 10*1024*1024;
+    tmp_opts->depth = 1;
+    tmp_opts->workers = 4;
 
     /* look at command line arguments */
     while((one_opt = getopt(argc, argv, flags)) != EOF)
@@ -278,6 +1059,23 @@ static struct options* parse_args(int argc, char* argv[])
                     return(NULL);
                 }
                 break;
+            case('p'):
+                ret = sscanf(optarg, "%d", &tmp_opts->depth);
+                if(ret < 1 || tmp_opts->depth < 1){
+                    free(tmp_opts);
+                    return(NULL);
+                }
+                break;
+            case('r'):
+                tmp_opts->recursive = 1;
+                break;
+            case('w'):
+                ret = sscanf(optarg, "%d", &tmp_opts->workers);
+                if(ret < 1 || tmp_opts->workers < 1){
+                    free(tmp_opts);
+                    return(NULL);
+                }
+                break;
             case('?'):
                 usage(argc, argv);
                 exit(EXIT_FAILURE);
@@ -300,11 +1098,16 @@ static struct options* parse_args(int argc, char* argv[])
 static void usage(int argc, char** argv)
 {
     fprintf(stderr,
-        "Usage: %s ARGS src_file dest_file\n", argv[0]);
+        "Usage: %s ARGS src_file dest_file\n"
+        "       %s -r ARGS src_dir dest_dir\n", argv[0], argv[0]);
     fprintf(stderr, "Where ARGS is one or more of"
         "\n-s <strip_size>\t\t\tsize of access to PVFS2 volume"
         "\n-n <num_datafiles>\t\tnumber of PVFS2 datafiles to use"
         "\n-b <buffer_size in bytes>\thow much data to read/write at once"
+        "\n-p <depth>\t\t\tnumber of buffers kept in flight, each"
+        "\n\t\t\t\trounded up to whole PVFS2 stripes"
+        "\n-r\t\t\t\tcopy the contents of src_dir into dest_dir"
+        "\n-w <workers>\t\t\tnumber of files copied at once with -r"
         "\n-t\t\t\t\tprint some timing information"
         "\n-v\t\t\t\tprint version number and exit\n");
     return;
@@ -399,14 +1202,15 @@ static int resolve_filename(file_object *obj, char *filename)
     int ret;
 
     ret = PVFS_util_resolve(filename, &(obj->u.pvfs2.fs_id),
-            obj->u.pvfs2.pvfs2_path, PVFS_NAME_MAX);
+            obj->u.pvfs2.pvfs2_path, PVFS_PATH_MAX);
     if (ret < 0)
     {
         obj->fs_type = UNIX_FILE;
-        strncpy(obj->u.ufs.path, filename, NAME_MAX);
+        strncpy(obj->u.ufs.path, filename, PATH_MAX);
+        obj->u.ufs.fd = -1;
     } else {
         obj->fs_type = PVFS2_FILE;
-        strncpy(obj->u.pvfs2.user_path, filename, PVFS_NAME_MAX);
+        strncpy(obj->u.pvfs2.user_path, filename, PVFS_PATH_MAX);
     }
 
     return 0;
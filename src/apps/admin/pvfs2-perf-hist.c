@@ -0,0 +1,354 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* pvfs2-perf-hist: prints per-operation latency percentiles kept by each
+ * server, both since the server started and over its recent history
+ * window.
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <time.h>
+#include <stdlib.h>
+#include <getopt.h>
+
+#include "pvfs2.h"
+#include "pvfs2-mgmt.h"
+#include "pvfs2-internal.h"
+#include "pint-perf-counter.h"
+
+#ifndef PVFS2_VERSION
+#define PVFS2_VERSION "Unknown"
+#endif
+
+/* the newest (cumulative) sample and the oldest one still in the
+ * server's history; their difference is the recent window
+ */
+#define SAMPLES 2
+
+/* number of int64_t's in one sample returned from a server */
+#define SAMPLE_LEN ((PINT_PERF_HKEY_COUNT * \
+                     (sizeof(struct PINT_perf_histogram) / sizeof(int64_t))) \
+                    + 2)
+
+#define HIST(s,h,k) (&((struct PINT_perf_histogram *) \
+                       &perf_matrix[(s)][(h) * SAMPLE_LEN])[(k)])
+#define START_TIME(s,h) (perf_matrix[(s)][((h) + 1) * SAMPLE_LEN - 2])
+#define INTERVAL(s,h) (perf_matrix[(s)][((h) + 1) * SAMPLE_LEN - 1])
+
+struct options
+{
+    char* mnt_point;
+    int mnt_point_set;
+    int repeat;
+};
+
+static struct options* parse_args(int argc, char* argv[]);
+static void usage(int argc, char** argv);
+static void print_hist(const char *name,
+                       const struct PINT_perf_histogram *h);
+
+int main(int argc, char **argv)
+{
+    int ret = -1;
+    PVFS_fs_id cur_fs;
+    struct options* user_opts = NULL;
+    char pvfs_path[PVFS_NAME_MAX] = {0};
+    int i, j, k;
+    PVFS_credential cred;
+    int server_count;
+    int64_t** perf_matrix;
+    uint64_t* end_time_ms_array;
+    uint32_t* next_id_array;
+    PVFS_BMI_addr_t *addr_array;
+    int tmp_type;
+    int key_cnt;
+    int sample_cnt;
+    struct PINT_perf_histogram window;
+
+    /* look at command line arguments */
+    user_opts = parse_args(argc, argv);
+    if(!user_opts)
+    {
+        fprintf(stderr, "Error: failed to parse command line arguments.\n");
+        usage(argc, argv);
+        return(-1);
+    }
+
+    ret = PVFS_util_init_defaults();
+    if(ret < 0)
+    {
+        PVFS_perror("PVFS_util_init_defaults", ret);
+        return(-1);
+    }
+
+    /* translate local path into pvfs2 relative path */
+    ret = PVFS_util_resolve(user_opts->mnt_point,
+                            &cur_fs,
+                            pvfs_path,
+                            PVFS_NAME_MAX);
+    if(ret < 0)
+    {
+        PVFS_perror("PVFS_util_resolve", ret);
+        return(-1);
+    }
+
+    ret = PVFS_util_gen_credential_defaults(&cred);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_util_gen_credential", ret);
+        return(-1);
+    }
+
+    /* metadata servers matter as much as I/O servers here */
+    ret = PVFS_mgmt_count_servers(cur_fs,
+                                  PVFS_MGMT_IO_SERVER|PVFS_MGMT_META_SERVER,
+                                  &server_count);
+    if(ret < 0)
+    {
+        PVFS_perror("PVFS_mgmt_count_servers", ret);
+        return(-1);
+    }
+
+    perf_matrix = (int64_t **)malloc(server_count * sizeof(int64_t *));
+    next_id_array = (uint32_t *)malloc(server_count * sizeof(uint32_t));
+    end_time_ms_array = (uint64_t *)malloc(server_count * sizeof(uint64_t));
+    addr_array = (PVFS_BMI_addr_t *)malloc(server_count *
+                                           sizeof(PVFS_BMI_addr_t));
+    if(!perf_matrix || !next_id_array || !end_time_ms_array || !addr_array)
+    {
+        perror("malloc");
+        return(-1);
+    }
+    for(i = 0; i < server_count; i++)
+    {
+        perf_matrix[i] = (int64_t *)malloc(SAMPLES * SAMPLE_LEN *
+                                           sizeof(int64_t));
+        if (perf_matrix[i] == NULL)
+        {
+            perror("malloc");
+            return -1;
+        }
+    }
+
+    ret = PVFS_mgmt_get_server_array(cur_fs,
+                                     PVFS_MGMT_IO_SERVER|PVFS_MGMT_META_SERVER,
+                                     addr_array,
+                                     &server_count);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_mgmt_get_server_array", ret);
+        return -1;
+    }
+
+    do
+    {
+        /* always ask for everything the server has */
+        memset(next_id_array, 0, server_count * sizeof(uint32_t));
+        for(i = 0; i < server_count; i++)
+        {
+            memset(perf_matrix[i], 0, SAMPLES * SAMPLE_LEN * sizeof(int64_t));
+        }
+
+        PVFS_util_refresh_credential(&cred);
+        key_cnt = PINT_PERF_HKEY_COUNT;
+        sample_cnt = SAMPLES;
+        ret = PVFS_mgmt_perf_mon_list(cur_fs,
+                                      &cred,
+                                      PINT_PERF_HISTOGRAM,
+                                      perf_matrix,
+                                      end_time_ms_array,
+                                      addr_array,
+                                      next_id_array,
+                                      server_count,
+                                      &key_cnt,
+                                      &sample_cnt,
+                                      NULL,
+                                      NULL);
+        if (ret < 0)
+        {
+            PVFS_perror("PVFS_mgmt_perf_mon_list", ret);
+            return -1;
+        }
+        if (key_cnt > PINT_PERF_HKEY_COUNT)
+        {
+            key_cnt = PINT_PERF_HKEY_COUNT;
+        }
+
+        for (i = 0; i < server_count; i++)
+        {
+            printf("\nSERVER: %s\n",
+                   PVFS_mgmt_map_addr(cur_fs, addr_array[i], &tmp_type));
+
+            printf("\nsince start (usecs)\n");
+            printf("%-10s %10s %10s %10s %10s %10s %10s %10s\n",
+                   "op", "count", "mean", "p50", "p90", "p99", "p999",
+                   "max");
+            for (k = 0; k < key_cnt; k++)
+            {
+                print_hist(server_hkeys[k].key_name, HIST(i, 0, k));
+            }
+
+            /* the second sample is the oldest one the server still has;
+             * its values are the totals as of the end of its interval
+             */
+            if (sample_cnt < SAMPLES || START_TIME(i, 1) == 0 ||
+                START_TIME(i, 1) >= START_TIME(i, 0))
+            {
+                continue;
+            }
+
+            printf("\nlast %.1f seconds (usecs)\n",
+                   (double)(START_TIME(i, 0) + INTERVAL(i, 0) -
+                            START_TIME(i, 1) - INTERVAL(i, 1)) / 1000.0);
+            printf("%-10s %10s %10s %10s %10s %10s %10s %10s\n",
+                   "op", "count", "mean", "p50", "p90", "p99", "p999",
+                   "max<=");
+            for (k = 0; k < key_cnt; k++)
+            {
+                /* histograms are cumulative, so the window is the
+                 * difference; the max is only known as an upper bound
+                 */
+                window.count = HIST(i, 0, k)->count - HIST(i, 1, k)->count;
+                window.sum = HIST(i, 0, k)->sum - HIST(i, 1, k)->sum;
+                window.max = HIST(i, 0, k)->max;
+                for (j = 0; j < PINT_PERF_HIST_BUCKETS; j++)
+                {
+                    window.bucket[j] = HIST(i, 0, k)->bucket[j] -
+                                       HIST(i, 1, k)->bucket[j];
+                }
+                print_hist(server_hkeys[k].key_name, &window);
+            }
+        }
+        fflush(stdout);
+
+        if (user_opts->repeat > 0)
+        {
+            sleep(user_opts->repeat);
+        }
+    } while (user_opts->repeat > 0);
+
+    PVFS_sys_finalize();
+
+    return(ret);
+}
+
+/* print_hist()
+ *
+ * prints one row of the latency table; idle operations are skipped
+ */
+static void print_hist(const char *name,
+                       const struct PINT_perf_histogram *h)
+{
+    if (h->count <= 0)
+    {
+        return;
+    }
+    printf("%-10s %10lld %10lld %10lld %10lld %10lld %10lld %10lld\n",
+           name,
+           lld(h->count),
+           lld((h->sum / h->count) / 1000),
+           lld(PINT_perf_hist_percentile(h, 50.0)),
+           lld(PINT_perf_hist_percentile(h, 90.0)),
+           lld(PINT_perf_hist_percentile(h, 99.0)),
+           lld(PINT_perf_hist_percentile(h, 99.9)),
+           lld(h->max / 1000));
+}
+
+/* parse_args()
+ *
+ * parses command line arguments
+ *
+ * returns pointer to options structure on success, NULL on failure
+ */
+static struct options* parse_args(int argc, char* argv[])
+{
+    char flags[] = "vm:r:";
+    int one_opt = 0;
+    int len = 0;
+
+    struct options *tmp_opts = NULL;
+    int ret = -1;
+
+    /* create storage for the command line options */
+    tmp_opts = (struct options *) malloc(sizeof(struct options));
+    if(tmp_opts == NULL)
+    {
+        return(NULL);
+    }
+    memset(tmp_opts, 0, sizeof(struct options));
+
+    /* look at command line arguments */
+    while((one_opt = getopt(argc, argv, flags)) != EOF)
+    {
+        switch(one_opt)
+        {
+            case('r'):
+                tmp_opts->repeat = atoi(optarg);
+                break;
+            case('v'):
+                printf("%s\n", PVFS2_VERSION);
+                exit(0);
+            case('m'):
+                len = strlen(optarg) + 1;
+                tmp_opts->mnt_point = (char*)malloc(len + 1);
+                if(!tmp_opts->mnt_point)
+                {
+                    free(tmp_opts);
+                    return(NULL);
+                }
+                memset(tmp_opts->mnt_point, 0, len + 1);
+                ret = sscanf(optarg, "%s", tmp_opts->mnt_point);
+                if(ret < 1){
+                    free(tmp_opts);
+                    return(NULL);
+                }
+                /* TODO: dirty hack... fix later.  The remove_dir_prefix()
+                 * function expects some trailing segments or at least
+                 * a slash off of the mount point
+                 */
+                strcat(tmp_opts->mnt_point, "/");
+                tmp_opts->mnt_point_set = 1;
+                break;
+            case('?'):
+                usage(argc, argv);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (!tmp_opts->mnt_point_set)
+    {
+        free(tmp_opts);
+        return(NULL);
+    }
+
+    return(tmp_opts);
+}
+
+
+static void usage(int argc, char **argv)
+{
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Usage  : %s [-r seconds] -m fs_mount_point\n", argv[0]);
+    fprintf(stderr, "  -r  print again every given number of seconds\n");
+    fprintf(stderr, "Example: %s -m /mnt/pvfs2\n", argv[0]);
+    return;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -305,6 +305,7 @@ void print_keyval( struct dbpf_data key, struct dbpf_data val )
     struct dbpf_keyval_db_entry *k;
     uint64_t vh, kh;
     uint32_t vi;
+    struct dbpf_packed_extent *ext;
 
 
     k = key.data;
@@ -476,6 +477,17 @@ void print_keyval( struct dbpf_data key, struct dbpf_data val )
             printf("()(%zu) -> (%u)(%zu)\n", key.len, vi, val.len);
             break;
 
+        case DBPF_PACKED_EXTENT_TYPE:
+        case DBPF_PACKED_FREE_TYPE:
+            ext = (struct dbpf_packed_extent *)val.data;
+            printf("()(%zu) -> (extent %llu size %u)(%zu)\n", key.len,
+                   llu(ext->slot), 1U << ext->shift, val.len);
+            break;
+
+        case DBPF_INLINE_DATA_TYPE:
+            printf("()(%zu) -> (inline data)(%zu)\n", key.len, val.len);
+            break;
+
         default:
             printf("unrecognized record type: %c\n", k->type);
             break;
@@ -16,18 +16,29 @@
  */
 
 /* char *pvfs2fuse_version = "$Id: pvfs2fuse.c,v 1.3.8.2 2010-12-21 15:34:13 mtmoore Exp $"; */
-char *pvfs2fuse_version = "0.01";
+char *pvfs2fuse_version = "0.02";
+
+/* pvfs2fuse uses the FUSE low-level interface.  The kernel names objects
+ * by inode number, and each inode number we hand out points at an entry
+ * in a table of PVFS object references, so no request has to resolve a
+ * path.  FUSE worker threads post non-blocking PVFS_isys_* calls and
+ * return at once; a progress thread collects the completed calls and
+ * sends the replies, posting a follow-up call first when a request needs
+ * more than one (a lookup is a ref_lookup and then a getattr).  Nothing
+ * forces direct_io any more: data goes through the kernel page cache,
+ * which is kept when a file is reopened unchanged and dropped otherwise.
+ */
 
-#define FUSE_USE_VERSION 27
+#define FUSE_USE_VERSION 26
 
-#include <fuse.h>
+#include <fuse_lowlevel.h>
 #include <fuse_opt.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
 #include <stdio.h>
-#include <utime.h>
 #include <unistd.h>
+#include <pthread.h>
 
 #include "pvfs2-compat.h"
 #include "pint-dev-shared.h"
@@ -36,21 +47,119 @@ char *pvfs2fuse_version = "0.01";
 #include "pvfs2-util.h"
 #include "pint-security.h"
 #include "security-util.h"
+#include "gen-locks.h"
+#include "quickhash.h"
+#include "client-state-machine.h"
+
+/* number of directory entries fetched from the servers at a time */
+#define PVFS_FUSE_DIRENT_COUNT 256
+/* number of completed calls collected by one test */
+#define PVFS_FUSE_TEST_COUNT 64
+/* the progress thread looks at pvfs2fuse.exiting this often */
+#define PVFS_FUSE_TEST_TIMEOUT_MS 10
 
 typedef struct {
 	  PVFS_object_ref	ref;
 	  PVFS_credential	cred;
 } pvfs_fuse_handle_t;
 
+/* an object the kernel knows by inode number; freed when the kernel
+ * forgets every lookup of it
+ */
+typedef struct {
+   struct qhash_head hash_link;
+   PVFS_object_ref ref;
+   uint64_t nlookup;
+   /* size and mtime seen at the last open, to decide whether the pages
+    * the kernel cached for the file are still good
+    */
+   int open_seen;
+   PVFS_size open_size;
+   PVFS_time open_mtime;
+} pvfs_fuse_inode_t;
+
+/* an open directory with the last batch of entries read from it;
+ * FUSE offsets are entry indexes plus one
+ */
+typedef struct {
+   PVFS_object_ref ref;
+   PVFS_credential cred;
+   PVFS_ds_position token;   /* position after the batch */
+   off_t batch_off;          /* index of the first entry in the batch */
+   int count;
+   PVFS_dirent *dirents;
+   int eof;
+} pvfs_fuse_dir_t;
+
+/* the call a request has outstanding */
+enum pvfs_fuse_state {
+   PVFS_FUSE_LOOKUP,
+   PVFS_FUSE_ENTRY,
+   PVFS_FUSE_GETATTR,
+   PVFS_FUSE_TRUNCATE,
+   PVFS_FUSE_SETATTR,
+   PVFS_FUSE_READLINK,
+   PVFS_FUSE_MKDIR,
+   PVFS_FUSE_SYMLINK,
+   PVFS_FUSE_CREATE,
+   PVFS_FUSE_REMOVE,
+   PVFS_FUSE_RENAME,
+   PVFS_FUSE_FLUSH,
+   PVFS_FUSE_OPEN,
+   PVFS_FUSE_READ,
+   PVFS_FUSE_WRITE,
+   PVFS_FUSE_READDIR,
+   PVFS_FUSE_STATFS
+};
+
+/* one FUSE request from the time it is received until it is answered */
+typedef struct {
+   fuse_req_t req;
+   enum pvfs_fuse_state state;
+   PVFS_credential cred;
+   fuse_ino_t ino;
+   PVFS_object_ref ref;
+   /* the sysint keeps pointers to names until the call completes */
+   char *name;
+   char *newname;
+   /* ENTRY answers with fuse_reply_create rather than fuse_reply_entry */
+   int reply_create;
+   struct fuse_file_info fi;
+   PVFS_sys_attr attr;
+   char *buf;
+   size_t size;
+   off_t off;
+   PVFS_Request mem_req;
+   pvfs_fuse_dir_t *dir;
+   union {
+      PVFS_sysresp_lookup lookup;
+      PVFS_sysresp_getattr getattr;
+      PVFS_sysresp_mkdir mkdir;
+      PVFS_sysresp_symlink symlink;
+      PVFS_sysresp_create create;
+      PVFS_sysresp_io io;
+      PVFS_sysresp_readdir readdir;
+      PVFS_sysresp_statfs statfs;
+   } resp;
+} pvfs_fuse_op_t;
+
 struct pvfs2fuse {
 	  char	*fs_spec;
 	  char	*mntpoint;
 	  PVFS_fs_id	fs_id;
 	  struct PVFS_sys_mntent mntent;
+	  double attr_timeout;
+	  double entry_timeout;
+	  int direct_io;
+	  volatile int exiting;
 };
 
 static struct pvfs2fuse pvfs2fuse;
 
+static struct qhash_table *inode_table = NULL;
+static gen_mutex_t inode_mutex = GEN_MUTEX_INITIALIZER;
+static pvfs_fuse_inode_t root_inode;
+
 #if __LP64__
 #define SET_FUSE_HANDLE( fi, pfh ) \
 	fi->fh = (uint64_t)pfh
@@ -63,22 +172,33 @@ static struct pvfs2fuse pvfs2fuse;
 	*((pvfs_fuse_handle_t **)(&fi->fh))
 #endif
 
-#define PVFS_VERSION(a,b,c) (((a) << 16) + ((b) << 8) + (c))
-#define THIS_PVFS_VERSION \
-     PVFS_VERSION(PVFS2_VERSION_MAJOR, PVFS2_VERSION_MINOR, PVFS2_VERSION_SUB)
-
-#if THIS_PVFS_VERSION > PVFS_VERSION(2,6,3)
-#define PVFS_ERROR_TO_ERRNO_N(x) (-1)*PVFS_ERROR_TO_ERRNO(x)
-#else
-#define PVFS_ERROR_TO_ERRNO_N(x) PVFS_ERROR_TO_ERRNO(x)
-#endif
+#define SET_FUSE_DIR( fi, dir ) \
+   fi->fh = (uint64_t)(uintptr_t)dir
+#define GET_FUSE_DIR( fi ) \
+   ((pvfs_fuse_dir_t *)(uintptr_t)fi->fh)
 
 #define pvfs_fuse_cleanup_credential(cred) PINT_cleanup_credential(cred)
 
+static void pvfs_fuse_complete(pvfs_fuse_op_t *op, int error);
+
+/* pvfs_fuse_errno()
+ *
+ * converts a sysint error to the positive errno FUSE replies with
+ */
+static int pvfs_fuse_errno(int error)
+{
+   int err = PVFS_ERROR_TO_ERRNO(error);
+
+   if (err < 0)
+      err = -err;
+   return err ? err : EIO;
+}
+
 static int pvfs_fuse_gen_credential(
+   fuse_req_t req,
    PVFS_credential *credential)
 {
-   struct fuse_context *ctx = fuse_get_context();
+   const struct fuse_ctx *ctx = fuse_req_ctx(req);
    PVFS_credential *new_cred;
    char uid[16], gid[16];
    int ret;
@@ -87,34 +207,34 @@ static int pvfs_fuse_gen_credential(
    ret = snprintf(uid, sizeof(uid), "%u", ctx->uid);
    if (ret < 0 || ret >= sizeof(uid))
    {
-      return -1;
+      return -PVFS_EINVAL;
    }
 
    ret = snprintf(gid, sizeof(gid), "%u", ctx->gid);
    if (ret < 0 || ret >= sizeof(gid))
    {
-       return -1;
+      return -PVFS_EINVAL;
    }
 
    /* allocate new credential */
    new_cred = (PVFS_credential *) malloc(sizeof(PVFS_credential));
    if (!new_cred)
    {
-       return -ENOMEM;
+      return -PVFS_ENOMEM;
    }
    memset(new_cred, 0, sizeof(PVFS_credential));
 
    /* generate credential -- this process must be running as root */
-   ret = PVFS_util_gen_credential(uid, 
-                                  gid, 
-                                  PVFS2_DEFAULT_CREDENTIAL_TIMEOUT, 
+   ret = PVFS_util_gen_credential(uid,
+                                  gid,
+                                  PVFS2_DEFAULT_CREDENTIAL_TIMEOUT,
                                   NULL, NULL,
                                   new_cred);
 
    if (ret == 0)
    {
-       /* copy credential to provided buffer */
-       ret = PINT_copy_credential(new_cred, credential);      
+      /* copy credential to provided buffer */
+      ret = PINT_copy_credential(new_cred, credential);
    }
 
    /* free generated credential */
@@ -124,55 +244,105 @@ static int pvfs_fuse_gen_credential(
    return ret;
 }
 
-static int lookup( const char *path, pvfs_fuse_handle_t *pfh, 
-				   int32_t follow_link )
+/*
+ * inode table
+ */
+
+static int pvfs_fuse_inode_compare(const void *key, struct qhash_head *link)
 {
-   PVFS_sysresp_lookup lk_response;
-   int			ret;
+   pvfs_fuse_inode_t *inode = qhash_entry(link, pvfs_fuse_inode_t, hash_link);
 
-   /* we don't have to do a PVFS_util_resolve
-	* because FUSE resolves the path for us
-	*/
+   return inode->ref.handle == *(const PVFS_handle *)key;
+}
 
-   ret = pvfs_fuse_gen_credential(&pfh->cred);
-   if (ret < 0)
+static pvfs_fuse_inode_t *pvfs_fuse_inode(fuse_ino_t ino)
+{
+   if (ino == FUSE_ROOT_ID)
+      return &root_inode;
+   return (pvfs_fuse_inode_t *)(uintptr_t)ino;
+}
+
+/* pvfs_fuse_inode_get()
+ *
+ * returns the inode number of ref, counting one more lookup of it, or 0
+ * when out of memory
+ */
+static fuse_ino_t pvfs_fuse_inode_get(PVFS_object_ref ref)
+{
+   struct qhash_head *link;
+   pvfs_fuse_inode_t *inode;
+
+   if (ref.handle == root_inode.ref.handle)
+      return FUSE_ROOT_ID;
+
+   gen_mutex_lock(&inode_mutex);
+   link = qhash_search(inode_table, &ref.handle);
+   if (link)
    {
-      return ret;
+      inode = qhash_entry(link, pvfs_fuse_inode_t, hash_link);
+      inode->nlookup++;
    }
-
-   memset(&lk_response, 0, sizeof(lk_response));
-   ret = PVFS_sys_lookup(pvfs2fuse.fs_id, 
-						 (char *)path,
-						 &pfh->cred, 
-						 &lk_response, 
-						 follow_link);
-   if ( ret < 0 ) {
-      pvfs_fuse_cleanup_credential(&pfh->cred);
-	  return ret;
+   else
+   {
+      inode = (pvfs_fuse_inode_t *)calloc(1, sizeof(pvfs_fuse_inode_t));
+      if (inode)
+      {
+         inode->ref = ref;
+         inode->nlookup = 1;
+         qhash_add(inode_table, &inode->ref.handle, &inode->hash_link);
+      }
    }
+   gen_mutex_unlock(&inode_mutex);
 
-   pfh->ref.handle = lk_response.ref.handle;
-   pfh->ref.fs_id  = pvfs2fuse.fs_id;
+   return (fuse_ino_t)(uintptr_t)inode;
+}
 
-   return 0;
+static void pvfs_fuse_inode_forget(fuse_ino_t ino, uint64_t nlookup)
+{
+   pvfs_fuse_inode_t *inode;
+
+   if (ino == FUSE_ROOT_ID)
+      return;
+
+   inode = pvfs_fuse_inode(ino);
+   gen_mutex_lock(&inode_mutex);
+   inode->nlookup -= (nlookup < inode->nlookup) ? nlookup : inode->nlookup;
+   if (inode->nlookup == 0)
+   {
+      qhash_del(&inode->hash_link);
+      free(inode);
+   }
+   gen_mutex_unlock(&inode_mutex);
 }
 
-static int pvfs_fuse_getattr_pfhp(pvfs_fuse_handle_t *pfhp, struct stat *stbuf)
+/* pvfs_fuse_inode_keep_cache()
+ *
+ * records the attributes of a file being opened; returns 1 if the file
+ * has not changed since it was last opened here, so the pages the kernel
+ * holds for it may be kept
+ */
+static int pvfs_fuse_inode_keep_cache(fuse_ino_t ino, PVFS_sys_attr *attrs)
+{
+   pvfs_fuse_inode_t *inode = pvfs_fuse_inode(ino);
+   int keep;
+
+   gen_mutex_lock(&inode_mutex);
+   keep = inode->open_seen &&
+      inode->open_size == attrs->size &&
+      inode->open_mtime == attrs->mtime;
+   inode->open_seen = 1;
+   inode->open_size = attrs->size;
+   inode->open_mtime = attrs->mtime;
+   gen_mutex_unlock(&inode_mutex);
+
+   return keep;
+}
+
+static void pvfs_fuse_fill_stat(PVFS_object_ref ref, PVFS_sys_attr *attrs,
+                                struct stat *stbuf)
 {
-   PVFS_sysresp_getattr getattr_response;
-   PVFS_sys_attr*	attrs;
-   int			ret;
    int			perm_mode = 0;
 
-   memset(&getattr_response,0, sizeof(PVFS_sysresp_getattr));
-    
-   ret = PVFS_sys_getattr(pfhp->ref, 
-                          PVFS_ATTR_SYS_ALL_NOHINT,
-                          (PVFS_credential *) &pfhp->cred, 
-                          &getattr_response);
-   if ( ret < 0 )
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
-   
    memset(stbuf, 0, sizeof(struct stat));
 
    /* Code copied from kernel/linux-2.x/pvfs2-utils.c */
@@ -190,8 +360,6 @@ static int pvfs_fuse_getattr_pfhp(pvfs_fuse_handle_t *pfhp, struct stat *stbuf)
 
    */
 
-   attrs = &getattr_response.attr;
-   
    if (attrs->objtype == PVFS_TYPE_METAFILE)
    {
 	  if (attrs->mask & PVFS_ATTR_SYS_SIZE)
@@ -255,12 +423,6 @@ static int pvfs_fuse_getattr_pfhp(pvfs_fuse_handle_t *pfhp, struct stat *stbuf)
 
    stbuf->st_mode |= perm_mode;
 
-   /* FIXME special case: mark the root inode as sticky
-	  if (is_root_handle(inode))
-	  {
-	  inode->i_mode |= S_ISVTX;
-	  }
-   */
    switch (attrs->objtype)
    {
 	  case PVFS_TYPE_METAFILE:
@@ -268,7 +430,7 @@ static int pvfs_fuse_getattr_pfhp(pvfs_fuse_handle_t *pfhp, struct stat *stbuf)
 		 break;
 	  case PVFS_TYPE_DIRECTORY:
 		 stbuf->st_mode |= S_IFDIR;
-		 /* NOTE: we have no good way to keep nlink consistent for 
+		 /* NOTE: we have no good way to keep nlink consistent for
 		  * directories across clients; keep constant at 1.  Why 1?  If
 		  * we go with 2, then find(1) gets confused and won't work
 		  * properly withouth the -noleaf option */
@@ -281,814 +443,1034 @@ static int pvfs_fuse_getattr_pfhp(pvfs_fuse_handle_t *pfhp, struct stat *stbuf)
 		 break;
    }
 
-   stbuf->st_dev = pfhp->ref.fs_id;
-   stbuf->st_ino = pfhp->ref.handle;
+   stbuf->st_dev = ref.fs_id;
+   stbuf->st_ino = ref.handle;
 
    stbuf->st_rdev = 0;
    stbuf->st_blksize = 4096;
-
-   PVFS_util_release_sys_attr(attrs);
-    
-   return 0;
 }
 
-static int pvfs_fuse_getattr(const char *path, struct stat *stbuf)
+/*
+ * requests
+ */
+
+/* pvfs_fuse_op_alloc()
+ *
+ * starts a request, with a copy of cred or, if cred is NULL, a
+ * credential for the caller; answers the request itself on failure
+ */
+static pvfs_fuse_op_t *pvfs_fuse_op_alloc(fuse_req_t req,
+                                          const PVFS_credential *cred)
 {
-   int			ret;
-   pvfs_fuse_handle_t	pfh;
+   pvfs_fuse_op_t *op;
+   int ret;
 
-   ret = lookup( path, &pfh, PVFS2_LOOKUP_LINK_NO_FOLLOW );
-   if ( ret < 0 )
+   op = (pvfs_fuse_op_t *)calloc(1, sizeof(pvfs_fuse_op_t));
+   if (!op)
    {
-      return PVFS_ERROR_TO_ERRNO_N( ret );
+      fuse_reply_err(req, ENOMEM);
+      return NULL;
    }
 
-   ret = pvfs_fuse_getattr_pfhp( &pfh, stbuf );
+   if (cred)
+      ret = PINT_copy_credential(cred, &op->cred);
+   else
+      ret = pvfs_fuse_gen_credential(req, &op->cred);
+   if (ret < 0)
+   {
+      free(op);
+      fuse_reply_err(req, pvfs_fuse_errno(ret));
+      return NULL;
+   }
 
-   pvfs_fuse_cleanup_credential(&pfh.cred);
+   op->req = req;
+   return op;
+}
 
-   return ret;
+static void pvfs_fuse_op_free(pvfs_fuse_op_t *op)
+{
+   if (op->mem_req)
+      PVFS_Request_free(&op->mem_req);
+   pvfs_fuse_cleanup_credential(&op->cred);
+   free(op->name);
+   free(op->newname);
+   free(op->buf);
+   free(op);
 }
 
-static int pvfs_fuse_fgetattr(const char *path, struct stat *stbuf,
-							  struct fuse_file_info *fi)
+static void pvfs_fuse_op_reply_err(pvfs_fuse_op_t *op, int err)
 {
-   return pvfs_fuse_getattr_pfhp( GET_FUSE_HANDLE( fi ), stbuf );
+   fuse_reply_err(op->req, err);
+   pvfs_fuse_op_free(op);
 }
 
-static int pvfs_fuse_readlink(const char *path, char *buf, size_t size)
+/* pvfs_fuse_posted()
+ *
+ * completes a call that failed to post or finished while being posted;
+ * any other call is completed by the progress thread, and the request
+ * must not be touched again here
+ */
+static void pvfs_fuse_posted(pvfs_fuse_op_t *op, PVFS_sys_op_id op_id,
+                             int ret)
 {
-   PVFS_sysresp_getattr getattr_response;
-   int			ret;
-   size_t		len;
-   pvfs_fuse_handle_t	pfh;
+   if (ret < 0 || op_id == -1)
+      pvfs_fuse_complete(op, ret);
+}
 
-   ret = lookup( path, &pfh, PVFS2_LOOKUP_LINK_NO_FOLLOW );
-   if ( ret < 0 )
-   {
-      return PVFS_ERROR_TO_ERRNO_N( ret );
-   }
+static void pvfs_fuse_post_getattr(pvfs_fuse_op_t *op,
+                                   enum pvfs_fuse_state state,
+                                   PVFS_object_ref ref)
+{
+   PVFS_sys_op_id op_id = -1;
+   int ret;
 
-   ret = PVFS_sys_getattr(pfh.ref, 
-						  PVFS_ATTR_SYS_ALL_NOHINT,
-						  (PVFS_credential *) &pfh.cred, 
-						  &getattr_response);
+   op->state = state;
+   op->ref = ref;
+   memset(&op->resp.getattr, 0, sizeof(op->resp.getattr));
+   ret = PVFS_isys_getattr(ref, PVFS_ATTR_SYS_ALL_NOHINT, &op->cred,
+                           &op->resp.getattr, &op_id, PVFS_HINT_NULL, op);
+   pvfs_fuse_posted(op, op_id, ret);
+}
 
-   pvfs_fuse_cleanup_credential(&pfh.cred);
+static void pvfs_fuse_post_setattr(pvfs_fuse_op_t *op)
+{
+   PVFS_sys_op_id op_id = -1;
+   int ret;
 
-   if ( ret < 0 )
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
+   op->state = PVFS_FUSE_SETATTR;
+   ret = PVFS_isys_setattr(op->ref, op->attr, &op->cred,
+                           &op_id, PVFS_HINT_NULL, op);
+   pvfs_fuse_posted(op, op_id, ret);
+}
 
-   if (getattr_response.attr.objtype != PVFS_TYPE_SYMLINK)
-	  return -EINVAL;
+static void pvfs_fuse_post_readdir(pvfs_fuse_op_t *op)
+{
+   PVFS_sys_op_id op_id = -1;
+   int ret;
 
-   len = strlen( getattr_response.attr.link_target );
-   if ( len < (size-1) )
-	  size = len;
+   op->state = PVFS_FUSE_READDIR;
+   memset(&op->resp.readdir, 0, sizeof(op->resp.readdir));
+   ret = PVFS_isys_readdir(op->dir->ref, op->dir->token,
+                           PVFS_FUSE_DIRENT_COUNT, &op->cred,
+                           &op->resp.readdir, &op_id, PVFS_HINT_NULL, op);
+   pvfs_fuse_posted(op, op_id, ret);
+}
 
-   bcopy( getattr_response.attr.link_target, buf, size );
+static int pvfs_fuse_post_io(pvfs_fuse_op_t *op, pvfs_fuse_handle_t *pfh,
+                             enum PVFS_io_type type)
+{
+   PVFS_sys_op_id op_id = -1;
+   int ret;
 
-   buf[len] = '\0';
+   ret = PVFS_Request_contiguous(op->size, PVFS_BYTE, &op->mem_req);
+   if (ret < 0)
+      return ret;
 
+   op->state = (type == PVFS_IO_READ) ? PVFS_FUSE_READ : PVFS_FUSE_WRITE;
+   op->ref = pfh->ref;
+   ret = PVFS_isys_io(pfh->ref, PVFS_BYTE, op->off, op->buf, op->mem_req,
+                      &op->cred, &op->resp.io, type, &op_id,
+                      PVFS_HINT_NULL, op);
+   pvfs_fuse_posted(op, op_id, ret);
    return 0;
 }
 
-static int pvfs_fuse_mkdir(const char *path, mode_t mode)
+/* pvfs_fuse_readdir_reply()
+ *
+ * answers a readdir from the directory's current batch, or fetches the
+ * batch that holds the requested offset
+ */
+static void pvfs_fuse_readdir_reply(pvfs_fuse_op_t *op)
 {
-   int rc;
-   int num_segs;
-   PVFS_sys_attr attr;
-   char parent[PVFS_NAME_MAX];
-   char dirname[PVFS_SEGMENT_MAX];
-   pvfs_fuse_handle_t	parent_pfh;
+   pvfs_fuse_dir_t *dir = op->dir;
+   struct stat st;
+   size_t used = 0, len;
+   char *buf;
+   int i;
 
-   PVFS_sysresp_mkdir resp_mkdir;
+   if (op->off < dir->batch_off)
+   {
+      /* seeked backwards: read the directory again from the start */
+      free(dir->dirents);
+      dir->dirents = NULL;
+      dir->count = 0;
+      dir->batch_off = 0;
+      dir->token = PVFS_READDIR_START;
+      dir->eof = 0;
+   }
 
-   /* Translate path into pvfs2 relative path */
-   rc = PINT_get_base_dir((char *)path, parent, PVFS_NAME_MAX);
-   num_segs = PINT_string_count_segments((char *)path);
-   rc = PINT_get_path_element((char *)path, num_segs - 1,
-							  dirname, PVFS_SEGMENT_MAX);
+   if (op->off >= dir->batch_off + dir->count && !dir->eof)
+   {
+      pvfs_fuse_post_readdir(op);
+      return;
+   }
 
-   if (rc)
+   buf = (char *)malloc(op->size);
+   if (!buf)
    {
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
+      pvfs_fuse_op_reply_err(op, ENOMEM);
+      return;
    }
 
-   rc = lookup( parent, &parent_pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if (rc)
+   memset(&st, 0, sizeof(st));
+   for (i = op->off - dir->batch_off; i < dir->count; i++)
    {
-      return PVFS_ERROR_TO_ERRNO_N( rc );
+      st.st_ino = dir->dirents[i].handle;
+      len = fuse_add_direntry(op->req, buf + used, op->size - used,
+                              dir->dirents[i].d_name, &st,
+                              dir->batch_off + i + 1);
+      if (len > op->size - used)
+         break;
+      used += len;
    }
 
-   /* Set attributes */
-   memset(&attr, 0, sizeof(PVFS_sys_attr));
-   attr.owner = parent_pfh.cred.userid;
-   attr.group = parent_pfh.cred.group_array[0];
-   attr.perms = mode;
-   attr.mask = PVFS_ATTR_SYS_ALL_SETABLE;
+   fuse_reply_buf(op->req, buf, used);
+   free(buf);
+   pvfs_fuse_op_free(op);
+}
 
-   rc = PVFS_sys_mkdir(dirname,
-					   parent_pfh.ref,
-					   attr,
-					   &parent_pfh.cred,
-					   &resp_mkdir);
+static void pvfs_fuse_reply_entry(pvfs_fuse_op_t *op)
+{
+   struct fuse_entry_param e;
+   PVFS_sys_attr *attrs = &op->resp.getattr.attr;
+   pvfs_fuse_handle_t *pfh = NULL;
+   int ret;
 
-   pvfs_fuse_cleanup_credential(&parent_pfh.cred);
+   memset(&e, 0, sizeof(e));
+   pvfs_fuse_fill_stat(op->ref, attrs, &e.attr);
+   e.attr_timeout = pvfs2fuse.attr_timeout;
+   e.entry_timeout = pvfs2fuse.entry_timeout;
 
-   if (rc)
+   if (op->reply_create)
    {
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
+      pfh = (pvfs_fuse_handle_t *)malloc(sizeof(pvfs_fuse_handle_t));
+      if (!pfh || PINT_copy_credential(&op->cred, &pfh->cred) < 0)
+      {
+         free(pfh);
+         PVFS_util_release_sys_attr(attrs);
+         pvfs_fuse_op_reply_err(op, ENOMEM);
+         return;
+      }
+      pfh->ref = op->ref;
    }
 
-   return 0;
-}
+   e.ino = pvfs_fuse_inode_get(op->ref);
+   if (e.ino == 0)
+   {
+      if (pfh)
+      {
+         pvfs_fuse_cleanup_credential(&pfh->cred);
+         free(pfh);
+      }
+      PVFS_util_release_sys_attr(attrs);
+      pvfs_fuse_op_reply_err(op, ENOMEM);
+      return;
+   }
 
-static int pvfs_fuse_remove( const char *path )
-{
-   int rc;
-   int num_segs;
-   char parent[PVFS_NAME_MAX];
-   char filename[PVFS_SEGMENT_MAX];
-   pvfs_fuse_handle_t	parent_pfh;
-
-   /* Translate path into pvfs2 relative path */
-   rc = PINT_get_base_dir((char *)path, parent, PVFS_NAME_MAX);
-   num_segs = PINT_string_count_segments((char *)path);
-   rc = PINT_get_path_element((char *)path, num_segs - 1,
-							  filename, PVFS_SEGMENT_MAX);
-
-   if (rc)
+   if (pfh)
    {
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
+      pvfs_fuse_inode_keep_cache(e.ino, attrs);
+      SET_FUSE_HANDLE( (&op->fi), pfh );
+      op->fi.direct_io = pvfs2fuse.direct_io;
+      ret = fuse_reply_create(op->req, &e, &op->fi);
+   }
+   else
+   {
+      ret = fuse_reply_entry(op->req, &e);
    }
 
-   rc = lookup( parent, &parent_pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if (rc)
+   if (ret != 0)
    {
-      return PVFS_ERROR_TO_ERRNO_N( rc );
+      /* the request was interrupted; the kernel will not forget the
+       * lookup or release the handle
+       */
+      pvfs_fuse_inode_forget(e.ino, 1);
+      if (pfh)
+      {
+         pvfs_fuse_cleanup_credential(&pfh->cred);
+         free(pfh);
+      }
    }
 
-   rc = PVFS_sys_remove(filename, parent_pfh.ref, &parent_pfh.cred);
+   PVFS_util_release_sys_attr(attrs);
+   pvfs_fuse_op_free(op);
+}
 
-   pvfs_fuse_cleanup_credential(&parent_pfh.cred);
+static void pvfs_fuse_reply_open(pvfs_fuse_op_t *op)
+{
+   PVFS_sys_attr *attrs = &op->resp.getattr.attr;
+   pvfs_fuse_handle_t *pfh;
 
-   if (rc)
+   pfh = (pvfs_fuse_handle_t *)malloc(sizeof(pvfs_fuse_handle_t));
+   if (!pfh || PINT_copy_credential(&op->cred, &pfh->cred) < 0)
    {
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
+      free(pfh);
+      PVFS_util_release_sys_attr(attrs);
+      pvfs_fuse_op_reply_err(op, ENOMEM);
+      return;
    }
+   pfh->ref = op->ref;
 
-   return 0;
-}
+   /* close-to-open consistency: the kernel drops what it cached for the
+    * file unless it is the same size and age as at the last open
+    */
+   op->fi.keep_cache = pvfs_fuse_inode_keep_cache(op->ino, attrs);
+   op->fi.direct_io = pvfs2fuse.direct_io;
+   SET_FUSE_HANDLE( (&op->fi), pfh );
 
-static int pvfs_fuse_unlink(const char *path)
-{
-   return pvfs_fuse_remove(path);
+   if (fuse_reply_open(op->req, &op->fi) != 0)
+   {
+      pvfs_fuse_cleanup_credential(&pfh->cred);
+      free(pfh);
+   }
+
+   PVFS_util_release_sys_attr(attrs);
+   pvfs_fuse_op_free(op);
 }
 
-static int pvfs_fuse_rmdir(const char *path)
+static void pvfs_fuse_reply_statfs(pvfs_fuse_op_t *op)
 {
-   return pvfs_fuse_remove(path);
+   PVFS_sysresp_statfs *resp_statfs = &op->resp.statfs;
+   struct statvfs stbuf;
+
+   memset(&stbuf, 0, sizeof(stbuf));
+   memcpy(&stbuf.f_fsid, &resp_statfs->statfs_buf.fs_id,
+		  sizeof(resp_statfs->statfs_buf.fs_id));
+   /* FIXME is this bsize right? */
+
+   stbuf.f_bsize = PVFS2_BUFMAP_DEFAULT_DESC_SIZE;
+   stbuf.f_frsize = PVFS2_BUFMAP_DEFAULT_DESC_SIZE;
+   stbuf.f_namemax = PVFS_NAME_MAX;
+
+   stbuf.f_blocks = resp_statfs->statfs_buf.bytes_total / stbuf.f_bsize;
+   stbuf.f_bfree = resp_statfs->statfs_buf.bytes_available / stbuf.f_bsize;
+   stbuf.f_bavail = resp_statfs->statfs_buf.bytes_available / stbuf.f_bsize;
+   stbuf.f_files = resp_statfs->statfs_buf.handles_total_count;
+   stbuf.f_ffree = resp_statfs->statfs_buf.handles_available_count;
+   stbuf.f_favail = resp_statfs->statfs_buf.handles_available_count;
+
+   stbuf.f_flag = 0;
+
+   fuse_reply_statfs(op->req, &stbuf);
+   pvfs_fuse_op_free(op);
 }
 
-static int pvfs_fuse_symlink(const char *from, const char *to)
+/* pvfs_fuse_complete()
+ *
+ * called when the outstanding call of a request finishes; either posts
+ * the next call of the request or answers it
+ */
+static void pvfs_fuse_complete(pvfs_fuse_op_t *op, int error)
 {
-   int                  ret = 0;
-   PVFS_sys_attr        attr;
-   PVFS_sysresp_lookup  resp_lookup;
-   PVFS_object_ref      parent_ref;
-   PVFS_sysresp_symlink resp_sym;
-   PVFS_credential      credential;
-   pvfs_fuse_handle_t	dir_pfh;
-   char *tofile, *todir, *cp;
-
-   pvfs_fuse_gen_credential(&credential);
-
-   /* Initialize any variables */
-   memset(&attr,        0, sizeof(attr));
-   memset(&resp_lookup, 0, sizeof(resp_lookup));
-   memset(&parent_ref,  0, sizeof(parent_ref));
-   memset(&resp_sym,    0, sizeof(resp_sym));
-
-   /* Set the attributes for the new directory */
-   attr.owner = credential.userid;
-   attr.group = credential.group_array[0];
-   attr.perms = 0777;              
-   attr.mask = (PVFS_ATTR_SYS_ALL_SETABLE);
-
-   todir = strdup( to );
-   if ( todir == NULL )
-	  return -ENOMEM;
-
-   /* find the last / to get the parent directory */
-   cp = rindex( todir,  '/' );
-   if ( cp == NULL )
+   struct stat stbuf;
+   PVFS_sys_attr *attrs = &op->resp.getattr.attr;
+
+   if (error && op->state == PVFS_FUSE_CREATE && error == -PVFS_ENOENT)
    {
-	  free( todir );
-	  return -ENOTDIR;
+      /* FIXME
+       * the PVFS2 server code returns a ENOENT instead of an EACCES
+       * because it does a ACL lookup for the system.posix_acl_access
+       * which returns a ENOENT from the TROVE DBPF and that error is
+       * just passed up in prelude_check_acls (server/prelude.c).  I'm
+       * not sure that's the right thing to do.
+       */
+      pvfs_fuse_op_reply_err(op, EACCES);
+      return;
    }
-   tofile = strdup( cp+1 );
-   if ( cp == todir )
+   if (error)
    {
-	  /* we're creating a link at the root, so keep the slash */
-	  *(cp+1) = '\0';
+      pvfs_fuse_op_reply_err(op, pvfs_fuse_errno(error));
+      return;
    }
-   else
+
+   switch (op->state)
    {
-	  *cp = '\0';
+      case PVFS_FUSE_LOOKUP:
+         pvfs_fuse_post_getattr(op, PVFS_FUSE_ENTRY, op->resp.lookup.ref);
+         break;
+      case PVFS_FUSE_MKDIR:
+         pvfs_fuse_post_getattr(op, PVFS_FUSE_ENTRY, op->resp.mkdir.ref);
+         break;
+      case PVFS_FUSE_SYMLINK:
+         pvfs_fuse_post_getattr(op, PVFS_FUSE_ENTRY, op->resp.symlink.ref);
+         break;
+      case PVFS_FUSE_CREATE:
+         pvfs_fuse_post_getattr(op, PVFS_FUSE_ENTRY, op->resp.create.ref);
+         break;
+      case PVFS_FUSE_ENTRY:
+         pvfs_fuse_reply_entry(op);
+         break;
+      case PVFS_FUSE_GETATTR:
+         pvfs_fuse_fill_stat(op->ref, attrs, &stbuf);
+         PVFS_util_release_sys_attr(attrs);
+         fuse_reply_attr(op->req, &stbuf, pvfs2fuse.attr_timeout);
+         pvfs_fuse_op_free(op);
+         break;
+      case PVFS_FUSE_TRUNCATE:
+         if (op->attr.mask)
+            pvfs_fuse_post_setattr(op);
+         else
+            pvfs_fuse_post_getattr(op, PVFS_FUSE_GETATTR, op->ref);
+         break;
+      case PVFS_FUSE_SETATTR:
+         pvfs_fuse_post_getattr(op, PVFS_FUSE_GETATTR, op->ref);
+         break;
+      case PVFS_FUSE_READLINK:
+         if (attrs->objtype != PVFS_TYPE_SYMLINK || !attrs->link_target)
+            fuse_reply_err(op->req, EINVAL);
+         else
+            fuse_reply_readlink(op->req, attrs->link_target);
+         PVFS_util_release_sys_attr(attrs);
+         pvfs_fuse_op_free(op);
+         break;
+      case PVFS_FUSE_OPEN:
+         pvfs_fuse_reply_open(op);
+         break;
+      case PVFS_FUSE_READ:
+      {
+#if FUSE_VERSION >= 29
+         struct fuse_bufvec bufv = FUSE_BUFVEC_INIT(op->resp.io.total_completed);
+
+         /* spliced into the reply pipe when the kernel supports it */
+         bufv.buf[0].mem = op->buf;
+         fuse_reply_data(op->req, &bufv, FUSE_BUF_SPLICE_MOVE);
+#else
+         fuse_reply_buf(op->req, op->buf, op->resp.io.total_completed);
+#endif
+         pvfs_fuse_op_free(op);
+         break;
+      }
+      case PVFS_FUSE_WRITE:
+         fuse_reply_write(op->req, op->resp.io.total_completed);
+         pvfs_fuse_op_free(op);
+         break;
+      case PVFS_FUSE_READDIR:
+      {
+         pvfs_fuse_dir_t *dir = op->dir;
+
+         free(dir->dirents);
+         dir->batch_off += dir->count;
+         dir->dirents = op->resp.readdir.dirent_array;
+         dir->count = op->resp.readdir.pvfs_dirent_outcount;
+         dir->token = op->resp.readdir.token;
+         dir->eof = (dir->token == PVFS_READDIR_END || dir->count == 0);
+         pvfs_fuse_readdir_reply(op);
+         break;
+      }
+      case PVFS_FUSE_STATFS:
+         pvfs_fuse_reply_statfs(op);
+         break;
+      case PVFS_FUSE_REMOVE:
+      case PVFS_FUSE_RENAME:
+      case PVFS_FUSE_FLUSH:
+      default:
+         pvfs_fuse_op_reply_err(op, 0);
+         break;
    }
+}
 
-   ret = lookup( todir, &dir_pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if(ret < 0)
+/* pvfs_fuse_progress()
+ *
+ * progress thread: completes the calls posted by the FUSE threads
+ */
+static void *pvfs_fuse_progress(void *arg)
+{
+   PVFS_sys_op_id op_id_array[PVFS_FUSE_TEST_COUNT];
+   void *user_ptr_array[PVFS_FUSE_TEST_COUNT];
+   int error_array[PVFS_FUSE_TEST_COUNT];
+   int count, i, ret;
+
+   while (!pvfs2fuse.exiting)
    {
-	  free( tofile );
-	  free( todir );
-	  PVFS_perror("lookup", ret);
-	  return(-1);
+      count = PVFS_FUSE_TEST_COUNT;
+      ret = PVFS_sys_testsome(op_id_array, &count, user_ptr_array,
+                              error_array, PVFS_FUSE_TEST_TIMEOUT_MS);
+      if (ret < 0)
+      {
+         PVFS_perror_gossip("PVFS_sys_testsome", ret);
+         continue;
+      }
+
+      for (i = 0; i < count; i++)
+      {
+         PINT_sys_release(op_id_array[i]);
+         pvfs_fuse_complete((pvfs_fuse_op_t *)user_ptr_array[i],
+                            error_array[i]);
+      }
    }
+   return NULL;
+}
 
-   ret = PVFS_sys_symlink(tofile, 
-						  dir_pfh.ref, 
-						  (char *) from,
-						  attr, 
-						  &credential, 
-						  &resp_sym);
+/*
+ * FUSE operations
+ */
 
-   pvfs_fuse_cleanup_credential(&credential);
-   pvfs_fuse_cleanup_credential(&dir_pfh.cred);
+static void pvfs_fuse_init(void *userdata, struct fuse_conn_info *conn)
+{
+   (void) userdata;
+
+#if FUSE_VERSION >= 29
+   /* move read and write payloads through pipes instead of copying
+    * them through the request buffer
+    */
+   if (conn->capable & FUSE_CAP_SPLICE_READ)
+      conn->want |= FUSE_CAP_SPLICE_READ;
+   if (conn->capable & FUSE_CAP_SPLICE_WRITE)
+      conn->want |= FUSE_CAP_SPLICE_WRITE;
+   if (conn->capable & FUSE_CAP_SPLICE_MOVE)
+      conn->want |= FUSE_CAP_SPLICE_MOVE;
+   /* let the kernel drop cached pages when it sees the size or mtime of
+    * a file change, e.g. after a write from another client
+    */
+   if (conn->capable & FUSE_CAP_AUTO_INVAL_DATA)
+      conn->want |= FUSE_CAP_AUTO_INVAL_DATA;
+#endif
+}
 
-   if (ret < 0)
-   {
-	  PVFS_perror("PVFS_sys_symlink", ret);
-	  return(ret);
-   }
-   else
+static void pvfs_fuse_lookup(fuse_req_t req, fuse_ino_t parent,
+                             const char *name)
+{
+   PVFS_sys_op_id op_id = -1;
+   pvfs_fuse_op_t *op;
+   int ret;
+
+   op = pvfs_fuse_op_alloc(req, NULL);
+   if (!op)
+      return;
+
+   op->name = strdup(name);
+   if (!op->name)
    {
-	  ret = 0;
+      pvfs_fuse_op_reply_err(op, ENOMEM);
+      return;
    }
-    
-   free( tofile );
-   free( todir );
-   return(ret);
+
+   op->state = PVFS_FUSE_LOOKUP;
+   ret = PVFS_isys_ref_lookup(pvfs2fuse.fs_id, op->name,
+                              pvfs_fuse_inode(parent)->ref, &op->cred,
+                              &op->resp.lookup, PVFS2_LOOKUP_LINK_NO_FOLLOW,
+                              &op_id, PVFS_HINT_NULL, op);
+   pvfs_fuse_posted(op, op_id, ret);
 }
 
-static int pvfs_fuse_rename(const char *from, const char *to)
+static void pvfs_fuse_forget(fuse_req_t req, fuse_ino_t ino,
+                             unsigned long nlookup)
 {
-   int rc;
-   int num_segs;
-   char fromdir[PVFS_NAME_MAX], todir[PVFS_NAME_MAX];
-   char fromname[PVFS_SEGMENT_MAX], toname[PVFS_SEGMENT_MAX];
-   pvfs_fuse_handle_t	todir_pfh, fromdir_pfh;
-
-   /* Translate path into pvfs2 relative path */
-   rc = PINT_get_base_dir((char *)from, fromdir, PVFS_NAME_MAX);
-   num_segs = PINT_string_count_segments((char *)from);
-   rc = PINT_get_path_element((char *)from, num_segs - 1,
-							  fromname, PVFS_SEGMENT_MAX);
-
-   if (rc)
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
-
-   rc = lookup( fromdir, &fromdir_pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if (rc < 0)
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
-
-   /* Translate path into pvfs2 relative path */
-   rc = PINT_get_base_dir((char *)to, todir, PVFS_NAME_MAX);
-   num_segs = PINT_string_count_segments((char *)to);
-   rc = PINT_get_path_element((char *)to, num_segs - 1,
-							  toname, PVFS_SEGMENT_MAX);
-
-   if (rc)
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
-
-   lookup( todir, &todir_pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if (rc < 0)
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
-
-   rc = PVFS_sys_rename(fromname,
-						fromdir_pfh.ref,
-						toname,
-						todir_pfh.ref,
-						&todir_pfh.cred);
-
-   pvfs_fuse_cleanup_credential(&fromdir_pfh.cred);
-   pvfs_fuse_cleanup_credential(&todir_pfh.cred);
-
-   if (rc)
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
-
-   return 0;
+   pvfs_fuse_inode_forget(ino, nlookup);
+   fuse_reply_none(req);
 }
 
-static int pvfs_fuse_chmod(const char *path, mode_t mode)
+#if FUSE_VERSION >= 29
+static void pvfs_fuse_forget_multi(fuse_req_t req, size_t count,
+                                   struct fuse_forget_data *forgets)
 {
-   int			ret;
-   PVFS_sys_attr	new_attr;
- 
-   pvfs_fuse_handle_t	pfh;
-
-   ret = lookup( path, &pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if ( ret < 0 )
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
-   /* FUSE passes in 5 octets in 'mode'. However, the the first 
-    * octet is not related to permissions, hence checking only
-    *  the lower 4 octets */
-   new_attr.perms = mode & 07777;
-   new_attr.mask = PVFS_ATTR_SYS_PERM;
- 
-   ret = PVFS_sys_setattr(pfh.ref,new_attr,&pfh.cred);
-
-   pvfs_fuse_cleanup_credential(&pfh.cred);
-
-   if (ret < 0) 
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
+   size_t i;
 
-   return 0;
+   for (i = 0; i < count; i++)
+      pvfs_fuse_inode_forget(forgets[i].ino, forgets[i].nlookup);
+   fuse_reply_none(req);
 }
+#endif
 
-static int pvfs_fuse_chown(const char *path, uid_t uid, gid_t gid)
+static void pvfs_fuse_getattr(fuse_req_t req, fuse_ino_t ino,
+                              struct fuse_file_info *fi)
 {
-   int			ret;
-   PVFS_sys_attr	new_attr;
- 
-   pvfs_fuse_handle_t	pfh;
-
-   ret = lookup( path, &pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if ( ret < 0 )
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
-   
-   new_attr.owner = uid;
-   new_attr.group = gid;
-   new_attr.mask = PVFS_ATTR_SYS_UID | PVFS_ATTR_SYS_GID;
- 
-   ret = PVFS_sys_setattr(pfh.ref,new_attr,&pfh.cred);
-
-   pvfs_fuse_cleanup_credential(&pfh.cred);
-
-   if (ret < 0) 
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
+   pvfs_fuse_op_t *op;
 
-   return 0;
+   op = pvfs_fuse_op_alloc(req, NULL);
+   if (!op)
+      return;
+
+   pvfs_fuse_post_getattr(op, PVFS_FUSE_GETATTR, pvfs_fuse_inode(ino)->ref);
 }
 
-static int pvfs_fuse_truncate(const char *path, off_t size)
+static void pvfs_fuse_setattr(fuse_req_t req, fuse_ino_t ino,
+                              struct stat *attr, int to_set,
+                              struct fuse_file_info *fi)
 {
-   int			ret;
-   pvfs_fuse_handle_t	pfh;
+   PVFS_sys_op_id op_id = -1;
+   pvfs_fuse_op_t *op;
+   int ret;
 
-   ret = lookup( path, &pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if ( ret < 0 )
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
-   
-   ret = PVFS_sys_truncate(pfh.ref,size,&pfh.cred);
+   op = pvfs_fuse_op_alloc(req, NULL);
+   if (!op)
+      return;
 
-   pvfs_fuse_cleanup_credential(&pfh.cred);
+   op->ref = pvfs_fuse_inode(ino)->ref;
 
-   if (ret < 0) 
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
+   if (to_set & FUSE_SET_ATTR_MODE)
+   {
+      op->attr.perms = attr->st_mode & 07777;
+      op->attr.mask |= PVFS_ATTR_SYS_PERM;
+   }
+   if (to_set & FUSE_SET_ATTR_UID)
+   {
+      op->attr.owner = attr->st_uid;
+      op->attr.mask |= PVFS_ATTR_SYS_UID;
+   }
+   if (to_set & FUSE_SET_ATTR_GID)
+   {
+      op->attr.group = attr->st_gid;
+      op->attr.mask |= PVFS_ATTR_SYS_GID;
+   }
+   if (to_set & FUSE_SET_ATTR_ATIME)
+   {
+      op->attr.atime = attr->st_atime;
+      op->attr.mask |= PVFS_ATTR_SYS_ATIME;
+   }
+   if (to_set & FUSE_SET_ATTR_MTIME)
+   {
+      op->attr.mtime = attr->st_mtime;
+      op->attr.mask |= PVFS_ATTR_SYS_MTIME;
+   }
+#ifdef FUSE_SET_ATTR_ATIME_NOW
+   if (to_set & FUSE_SET_ATTR_ATIME_NOW)
+   {
+      op->attr.atime = time(NULL);
+      op->attr.mask |= PVFS_ATTR_SYS_ATIME;
+   }
+   if (to_set & FUSE_SET_ATTR_MTIME_NOW)
+   {
+      op->attr.mtime = time(NULL);
+      op->attr.mask |= PVFS_ATTR_SYS_MTIME;
+   }
+#endif
 
-   return 0;
+   if (to_set & FUSE_SET_ATTR_SIZE)
+   {
+      op->state = PVFS_FUSE_TRUNCATE;
+      ret = PVFS_isys_truncate(op->ref, attr->st_size, &op->cred,
+                               &op_id, PVFS_HINT_NULL, op);
+      pvfs_fuse_posted(op, op_id, ret);
+   }
+   else if (op->attr.mask)
+   {
+      pvfs_fuse_post_setattr(op);
+   }
+   else
+   {
+      pvfs_fuse_post_getattr(op, PVFS_FUSE_GETATTR, op->ref);
+   }
 }
 
-static int pvfs_fuse_utime(const char *path, struct utimbuf *timbuf)
+static void pvfs_fuse_readlink(fuse_req_t req, fuse_ino_t ino)
 {
-   int			ret;
-   PVFS_sys_attr	new_attr;
- 
-   pvfs_fuse_handle_t	pfh;
-
-   ret = lookup( path, &pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if ( ret < 0 )
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
-   
-   new_attr.atime = (PVFS_time)timbuf->actime;
-   new_attr.mtime = (PVFS_time)timbuf->modtime;
-   new_attr.mask = PVFS_ATTR_SYS_ATIME | PVFS_ATTR_SYS_MTIME;
- 
-   ret = PVFS_sys_setattr(pfh.ref,new_attr,&pfh.cred);
-
-   pvfs_fuse_cleanup_credential(&pfh.cred);
-
-   if (ret < 0) 
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
+   pvfs_fuse_op_t *op;
 
-   return 0;
+   op = pvfs_fuse_op_alloc(req, NULL);
+   if (!op)
+      return;
+
+   pvfs_fuse_post_getattr(op, PVFS_FUSE_READLINK, pvfs_fuse_inode(ino)->ref);
 }
 
-static int pvfs_fuse_open(const char *path, struct fuse_file_info *fi)
+static void pvfs_fuse_mkdir(fuse_req_t req, fuse_ino_t parent,
+                            const char *name, mode_t mode)
 {
-   pvfs_fuse_handle_t *pfhp;
-   int			ret;
+   PVFS_sys_op_id op_id = -1;
+   pvfs_fuse_op_t *op;
+   PVFS_sys_attr attr;
+   int ret;
 
-   pfhp = (pvfs_fuse_handle_t *)malloc( sizeof( pvfs_fuse_handle_t ) );
-   if (pfhp == NULL)
-   {
-	  return -ENOMEM;
-   }
+   op = pvfs_fuse_op_alloc(req, NULL);
+   if (!op)
+      return;
 
-   ret = lookup( path, pfhp, PVFS2_LOOKUP_LINK_FOLLOW );
-   if ( ret < 0 ) {
-      free( pfhp );
-      return PVFS_ERROR_TO_ERRNO_N( ret );
+   op->name = strdup(name);
+   if (!op->name)
+   {
+      pvfs_fuse_op_reply_err(op, ENOMEM);
+      return;
    }
 
-   SET_FUSE_HANDLE( fi, pfhp );
+   /* Set attributes */
+   memset(&attr, 0, sizeof(PVFS_sys_attr));
+   attr.owner = op->cred.userid;
+   attr.group = op->cred.group_array[0];
+   attr.perms = mode & 07777;
+   attr.mask = PVFS_ATTR_SYS_ALL_SETABLE;
 
-   return 0;
+   op->state = PVFS_FUSE_MKDIR;
+   ret = PVFS_isys_mkdir(op->name, pvfs_fuse_inode(parent)->ref, attr,
+                         &op->cred, &op->resp.mkdir, &op_id,
+                         PVFS_HINT_NULL, op);
+   pvfs_fuse_posted(op, op_id, ret);
 }
 
-static int pvfs_fuse_read(const char *path, char *buf, size_t size, off_t offset,
-						  struct fuse_file_info *fi)
+static void pvfs_fuse_remove(fuse_req_t req, fuse_ino_t parent,
+                             const char *name)
 {
-   PVFS_Request	mem_req, file_req;
-   PVFS_sysresp_io	resp_io;
-   int			ret;
-   pvfs_fuse_handle_t	*pfh = GET_FUSE_HANDLE( fi );
-  
-   file_req = PVFS_BYTE;
-   ret = PVFS_Request_contiguous(size, PVFS_BYTE, &mem_req);
-   if (ret < 0)
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
+   PVFS_sys_op_id op_id = -1;
+   pvfs_fuse_op_t *op;
+   int ret;
 
-   ret = PVFS_sys_read(pfh->ref, file_req, offset, buf,
-					   mem_req, &pfh->cred, &resp_io);
+   op = pvfs_fuse_op_alloc(req, NULL);
+   if (!op)
+      return;
 
-   if (ret == 0) 
+   op->name = strdup(name);
+   if (!op->name)
    {
-	  PVFS_Request_free(&mem_req);
-	  return(resp_io.total_completed);
+      pvfs_fuse_op_reply_err(op, ENOMEM);
+      return;
    }
-   else
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
+
+   op->state = PVFS_FUSE_REMOVE;
+   ret = PVFS_isys_remove(op->name, pvfs_fuse_inode(parent)->ref,
+                          &op->cred, &op_id, PVFS_HINT_NULL, op);
+   pvfs_fuse_posted(op, op_id, ret);
 }
 
-static int pvfs_fuse_write(const char *path, const char *buf, size_t size,
-						   off_t offset, struct fuse_file_info *fi)
+static void pvfs_fuse_symlink(fuse_req_t req, const char *link,
+                              fuse_ino_t parent, const char *name)
 {
-   PVFS_Request	mem_req, file_req;
-   PVFS_sysresp_io	resp_io;
-   int			ret;
-   pvfs_fuse_handle_t	*pfh = GET_FUSE_HANDLE( fi );
-  
-   file_req = PVFS_BYTE;
-   ret = PVFS_Request_contiguous(size, PVFS_BYTE, &mem_req);
-   if (ret < 0)
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
+   PVFS_sys_op_id op_id = -1;
+   pvfs_fuse_op_t *op;
+   PVFS_sys_attr attr;
+   int ret;
+
+   op = pvfs_fuse_op_alloc(req, NULL);
+   if (!op)
+      return;
 
-   ret = PVFS_sys_write(pfh->ref, file_req, offset, (char*)buf,
-						mem_req, &pfh->cred, &resp_io);
-   if (ret == 0) 
+   op->name = strdup(name);
+   op->newname = strdup(link);
+   if (!op->name || !op->newname)
    {
-	  PVFS_Request_free(&mem_req);
-	  return(resp_io.total_completed);
+      pvfs_fuse_op_reply_err(op, ENOMEM);
+      return;
    }
-   else
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
+
+   /* Set attributes */
+   memset(&attr, 0, sizeof(PVFS_sys_attr));
+   attr.owner = op->cred.userid;
+   attr.group = op->cred.group_array[0];
+   attr.perms = 0777;
+   attr.mask = PVFS_ATTR_SYS_ALL_SETABLE;
+
+   op->state = PVFS_FUSE_SYMLINK;
+   ret = PVFS_isys_symlink(op->name, pvfs_fuse_inode(parent)->ref,
+                           op->newname, attr, &op->cred,
+                           &op->resp.symlink, &op_id, PVFS_HINT_NULL, op);
+   pvfs_fuse_posted(op, op_id, ret);
 }
 
-static int pvfs_fuse_statfs(const char *path, struct statvfs *stbuf)
+static void pvfs_fuse_rename(fuse_req_t req, fuse_ino_t parent,
+                             const char *name, fuse_ino_t newparent,
+                             const char *newname)
 {
-   int			ret;
-   PVFS_credential	cred;
-   PVFS_sysresp_statfs resp_statfs;
+   PVFS_sys_op_id op_id = -1;
+   pvfs_fuse_op_t *op;
+   int ret;
 
-   ret = pvfs_fuse_gen_credential(&cred);
-   if (ret < 0)
+   op = pvfs_fuse_op_alloc(req, NULL);
+   if (!op)
+      return;
+
+   op->name = strdup(name);
+   op->newname = strdup(newname);
+   if (!op->name || !op->newname)
    {
-       return PVFS_ERROR_TO_ERRNO_N(ret);
+      pvfs_fuse_op_reply_err(op, ENOMEM);
+      return;
    }
 
-   /* gather normal statfs statistics from system interface */
+   op->state = PVFS_FUSE_RENAME;
+   ret = PVFS_isys_rename(op->name, pvfs_fuse_inode(parent)->ref,
+                          op->newname, pvfs_fuse_inode(newparent)->ref,
+                          &op->cred, &op_id, PVFS_HINT_NULL, op);
+   pvfs_fuse_posted(op, op_id, ret);
+}
 
-   ret = PVFS_sys_statfs(pvfs2fuse.fs_id, &cred, &resp_statfs);
+static void pvfs_fuse_create(fuse_req_t req, fuse_ino_t parent,
+                             const char *name, mode_t mode,
+                             struct fuse_file_info *fi)
+{
+   PVFS_sys_op_id op_id = -1;
+   pvfs_fuse_op_t *op;
+   PVFS_sys_attr attr;
+   int ret;
 
-   pvfs_fuse_cleanup_credential(&cred);
+   op = pvfs_fuse_op_alloc(req, NULL);
+   if (!op)
+      return;
 
-   if (ret < 0)
+   op->name = strdup(name);
+   if (!op->name)
    {
-	  if(ret != ERANGE)
-		 return PVFS_ERROR_TO_ERRNO_N( ret );
+      pvfs_fuse_op_reply_err(op, ENOMEM);
+      return;
    }
+   op->fi = *fi;
+   op->reply_create = 1;
 
-   memcpy(&stbuf->f_fsid, &resp_statfs.statfs_buf.fs_id, 
-		  sizeof(resp_statfs.statfs_buf.fs_id));
-   /* FIXME is this bsize right? */
+   /* Set attributes */
+   memset(&attr, 0, sizeof(PVFS_sys_attr));
+   attr.owner = op->cred.userid;
+   attr.group = op->cred.group_array[0];
+   attr.perms = mode & 07777;
+   attr.atime = time(NULL);
+   attr.mtime = attr.atime;
+   attr.mask = PVFS_ATTR_SYS_ALL_SETABLE;
+   attr.dfile_count = 0;
 
-   stbuf->f_bsize = PVFS2_BUFMAP_DEFAULT_DESC_SIZE;
-   stbuf->f_frsize = PVFS2_BUFMAP_DEFAULT_DESC_SIZE;
-   stbuf->f_namemax = PVFS_NAME_MAX;
+   op->state = PVFS_FUSE_CREATE;
+   ret = PVFS_isys_create(op->name, pvfs_fuse_inode(parent)->ref, attr,
+                          &op->cred, NULL, NULL, &op->resp.create,
+                          &op_id, PVFS_HINT_NULL, op);
+   pvfs_fuse_posted(op, op_id, ret);
+}
 
-   stbuf->f_blocks = resp_statfs.statfs_buf.bytes_total / stbuf->f_bsize;
-   stbuf->f_bfree = resp_statfs.statfs_buf.bytes_available / stbuf->f_bsize;
-   stbuf->f_bavail = resp_statfs.statfs_buf.bytes_available / stbuf->f_bsize;
-   stbuf->f_files = resp_statfs.statfs_buf.handles_total_count;
-   stbuf->f_ffree = resp_statfs.statfs_buf.handles_available_count;
-   stbuf->f_favail = resp_statfs.statfs_buf.handles_available_count;
+static void pvfs_fuse_open(fuse_req_t req, fuse_ino_t ino,
+                           struct fuse_file_info *fi)
+{
+   pvfs_fuse_op_t *op;
 
-   stbuf->f_flag = 0;
+   op = pvfs_fuse_op_alloc(req, NULL);
+   if (!op)
+      return;
 
-   return 0;
+   op->ino = ino;
+   op->fi = *fi;
+   pvfs_fuse_post_getattr(op, PVFS_FUSE_OPEN, pvfs_fuse_inode(ino)->ref);
 }
 
-static int pvfs_fuse_release(const char *path, struct fuse_file_info *fi)
+static void pvfs_fuse_read(fuse_req_t req, fuse_ino_t ino, size_t size,
+                           off_t off, struct fuse_file_info *fi)
 {
    pvfs_fuse_handle_t *pfh = GET_FUSE_HANDLE( fi );
-  
-   if ( pfh != NULL ) {
-      pvfs_fuse_cleanup_credential(&pfh->cred);
-      free( pfh );
-      SET_FUSE_HANDLE( fi, NULL );
+   pvfs_fuse_op_t *op;
+   int ret;
+
+   op = pvfs_fuse_op_alloc(req, &pfh->cred);
+   if (!op)
+      return;
+
+   op->size = size;
+   op->off = off;
+   op->buf = (char *)malloc(size ? size : 1);
+   if (!op->buf)
+   {
+      pvfs_fuse_op_reply_err(op, ENOMEM);
+      return;
    }
 
-   return 0;
+   ret = pvfs_fuse_post_io(op, pfh, PVFS_IO_READ);
+   if (ret < 0)
+      pvfs_fuse_op_reply_err(op, pvfs_fuse_errno(ret));
 }
 
-static int pvfs_fuse_fsync(const char *path, int isdatasync,
-						   struct fuse_file_info *fi)
+static void pvfs_fuse_write(fuse_req_t req, fuse_ino_t ino, const char *buf,
+                            size_t size, off_t off, struct fuse_file_info *fi)
 {
-   /* Just a stub.  This method is optional and can safely be left
-	  unimplemented */
+   pvfs_fuse_handle_t *pfh = GET_FUSE_HANDLE( fi );
+   pvfs_fuse_op_t *op;
+   int ret;
 
-   (void) path;
-   (void) isdatasync;
-   (void) fi;
+   op = pvfs_fuse_op_alloc(req, &pfh->cred);
+   if (!op)
+      return;
 
-   return 0;
-}
+   /* FUSE reuses buf once we return */
+   op->size = size;
+   op->off = off;
+   op->buf = (char *)malloc(size ? size : 1);
+   if (!op->buf)
+   {
+      pvfs_fuse_op_reply_err(op, ENOMEM);
+      return;
+   }
+   memcpy(op->buf, buf, size);
 
-#define MAX_NUM_DIRENTS    32
+   ret = pvfs_fuse_post_io(op, pfh, PVFS_IO_WRITE);
+   if (ret < 0)
+      pvfs_fuse_op_reply_err(op, pvfs_fuse_errno(ret));
+}
 
-static int pvfs_fuse_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
-							 off_t offset, struct fuse_file_info *fi)
+#if FUSE_VERSION >= 29
+/* pvfs_fuse_write_buf()
+ *
+ * write whose payload may still be in the pipe it was spliced into;
+ * moved straight from there into the buffer handed to the sysint
+ */
+static void pvfs_fuse_write_buf(fuse_req_t req, fuse_ino_t ino,
+                                struct fuse_bufvec *bufv, off_t off,
+                                struct fuse_file_info *fi)
 {
-   int			ret;
-   PVFS_ds_position	token;
-   pvfs_fuse_handle_t	pfh;
-   int			pvfs_dirent_incount;
-   PVFS_sysresp_readdir rd_response;
-
-   ret = lookup( path, &pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if ( ret < 0 )
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
-
-   pvfs_dirent_incount = MAX_NUM_DIRENTS;
-   token = 0;
-   do
-   {
-	  char *cur_file = NULL;
-	  int i;
-
-	  memset(&rd_response, 0, sizeof(PVFS_sysresp_readdir));
-	  ret = PVFS_sys_readdir(
-		 pfh.ref, (!token ? PVFS_READDIR_START : token),
-		 pvfs_dirent_incount, &pfh.cred, &rd_response);
-	  if(ret < 0)
-      {
-         pvfs_fuse_cleanup_credential(&pfh.cred);
-         return PVFS_ERROR_TO_ERRNO_N( ret );
-      }
-
-	  for(i = 0; i < rd_response.pvfs_dirent_outcount; i++)
-	  {
-		 cur_file = rd_response.dirent_array[i].d_name;
+   pvfs_fuse_handle_t *pfh = GET_FUSE_HANDLE( fi );
+   struct fuse_bufvec dst = FUSE_BUFVEC_INIT(fuse_buf_size(bufv));
+   pvfs_fuse_op_t *op;
+   ssize_t copied;
+   int ret;
 
-		 if (filler(buf, cur_file, NULL, 0))
-			break;
-	  }
-	  token = rd_response.token;
+   op = pvfs_fuse_op_alloc(req, &pfh->cred);
+   if (!op)
+      return;
 
-	  if (rd_response.pvfs_dirent_outcount)
-	  {
-		 free(rd_response.dirent_array);
-		 rd_response.dirent_array = NULL;
-	  }
+   op->off = off;
+   op->buf = (char *)malloc(dst.buf[0].size ? dst.buf[0].size : 1);
+   if (!op->buf)
+   {
+      pvfs_fuse_op_reply_err(op, ENOMEM);
+      return;
+   }
 
-   } while(token != PVFS_READDIR_END);
+   dst.buf[0].mem = op->buf;
+   copied = fuse_buf_copy(&dst, bufv, FUSE_BUF_SPLICE_NONBLOCK);
+   if (copied < 0)
+   {
+      pvfs_fuse_op_reply_err(op, (int)-copied);
+      return;
+   }
+   op->size = copied;
 
-   pvfs_fuse_cleanup_credential(&pfh.cred);
+   ret = pvfs_fuse_post_io(op, pfh, PVFS_IO_WRITE);
+   if (ret < 0)
+      pvfs_fuse_op_reply_err(op, pvfs_fuse_errno(ret));
+}
+#endif
 
-   return 0;
+static void pvfs_fuse_flush(fuse_req_t req, fuse_ino_t ino,
+                            struct fuse_file_info *fi)
+{
+   /* writes are not buffered here; fsync flushes the servers */
+   fuse_reply_err(req, 0);
 }
 
-static int pvfs_fuse_access(const char *path, int mask)
+static void pvfs_fuse_release(fuse_req_t req, fuse_ino_t ino,
+                              struct fuse_file_info *fi)
 {
-   PVFS_sysresp_getattr getattr_response;
-   PVFS_sys_attr*	attrs;
-   int			ret;
-   pvfs_fuse_handle_t	pfh;
-   int			in_group_flag = 0;
-   PVFS_uid     uid;
-   PVFS_gid     gid;
-
-   ret = lookup( path, &pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if ( ret < 0 )
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
-
-   /* give root permission, no matter what */
-   if ( pfh.cred.userid == 0 )
-	  return 0;
-
-   /* if checking for file existence, return 0 */
-   if ( mask == F_OK )
-	  return 0;
-
-   ret = PVFS_sys_getattr(pfh.ref, 
-                          PVFS_ATTR_SYS_ALL_NOHINT,
-                          (PVFS_credential *) &pfh.cred, 
-                          &getattr_response);
-
-   /* copy uid and gid so credential can be freed */
-   uid = pfh.cred.userid;
-   gid = pfh.cred.group_array[0];
-   pvfs_fuse_cleanup_credential(&pfh.cred);
-
-   if ( ret < 0 )
-   {            
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
+   pvfs_fuse_handle_t *pfh = GET_FUSE_HANDLE( fi );
+
+   if ( pfh != NULL ) {
+      pvfs_fuse_cleanup_credential(&pfh->cred);
+      free( pfh );
    }
+   fuse_reply_err(req, 0);
+}
 
-   attrs = &getattr_response.attr;
+static void pvfs_fuse_fsync(fuse_req_t req, fuse_ino_t ino, int datasync,
+                            struct fuse_file_info *fi)
+{
+   pvfs_fuse_handle_t *pfh = GET_FUSE_HANDLE( fi );
+   PVFS_sys_op_id op_id = -1;
+   pvfs_fuse_op_t *op;
+   int ret;
 
-   /* basic code is copied from PINT_check_mode() */
+   op = pvfs_fuse_op_alloc(req, &pfh->cred);
+   if (!op)
+      return;
 
-   /* see if uid matches object owner */
-   if ( attrs->owner == uid )
-   {
-	  /* see if object user permissions match access type */
-	  if( (mask & R_OK) && (attrs->perms & PVFS_U_READ))
-	  {
-		 return(0);
-	  }
-	  if( (mask & W_OK) && (attrs->perms & PVFS_U_WRITE))
-	  {
-		 return(0);
-	  }
-	  if( (mask & X_OK) && (attrs->perms & PVFS_U_EXECUTE))
-	  {
-		 return(0);
-	  }
-   }
+   op->state = PVFS_FUSE_FLUSH;
+   ret = PVFS_isys_flush(pfh->ref, &op->cred, &op_id, PVFS_HINT_NULL, op);
+   pvfs_fuse_posted(op, op_id, ret);
+}
 
-   /* see if other bits allow access */
-   if( (mask & R_OK) && (attrs->perms & PVFS_O_READ))
-   {
-	  return(0);
-   }
-   if( (mask & W_OK) && (attrs->perms & PVFS_O_WRITE))
-   {
-	  return(0);
-   }
-   if( (mask & X_OK) && (attrs->perms & PVFS_O_EXECUTE))
+static void pvfs_fuse_opendir(fuse_req_t req, fuse_ino_t ino,
+                              struct fuse_file_info *fi)
+{
+   pvfs_fuse_dir_t *dir;
+   int ret;
+
+   dir = (pvfs_fuse_dir_t *)calloc(1, sizeof(pvfs_fuse_dir_t));
+   if (!dir)
    {
-	  return(0);
+      fuse_reply_err(req, ENOMEM);
+      return;
    }
 
-   /* see if gid matches object group 
-      TODO: check all groups */
-   if(attrs->group == gid)
+   ret = pvfs_fuse_gen_credential(req, &dir->cred);
+   if (ret < 0)
    {
-	  /* default group match */
-	  in_group_flag = 1;
-   }
-   else
-   {
-#if 0
-	  /* no default group match, check supplementary groups */
-	  ret = PINT_check_group(uid, attrs->group);
-	  if(ret == 0)
-	  {
-		 in_group_flag = 1;
-	  }
-	  else
-	  {
-		 if(ret != -PVFS_ENOENT)
-		 {
-			/* system error; not just failed match */
-			return(ret);
-		 }
-	  }
-#endif
+      free(dir);
+      fuse_reply_err(req, pvfs_fuse_errno(ret));
+      return;
    }
+   dir->ref = pvfs_fuse_inode(ino)->ref;
+   dir->token = PVFS_READDIR_START;
 
-   if(in_group_flag)
+   SET_FUSE_DIR( fi, dir );
+   if (fuse_reply_open(req, fi) != 0)
    {
-	  /* see if object group permissions match access type */
-	  if( (mask & R_OK) && (attrs->perms & PVFS_G_READ))
-	  {
-		 return(0);
-	  }
-	  if( (mask & W_OK) && (attrs->perms & PVFS_G_WRITE))
-	  {
-		 return(0);
-	  }
-	  if( (mask & X_OK) && (attrs->perms & PVFS_G_EXECUTE))
-	  {
-		 return(0);
-	  }
+      pvfs_fuse_cleanup_credential(&dir->cred);
+      free(dir);
    }
-  
-   /* default case: access denied */
-   return -EACCES;
 }
 
-static int pvfs_fuse_create(const char *path, mode_t mode,
-							struct fuse_file_info *fi)
+static void pvfs_fuse_readdir(fuse_req_t req, fuse_ino_t ino, size_t size,
+                              off_t off, struct fuse_file_info *fi)
 {
-   int rc;
-   int num_segs;
-   PVFS_sys_attr attr;
-   char directory[PVFS_NAME_MAX];
-   char filename[PVFS_SEGMENT_MAX];
-   pvfs_fuse_handle_t	dir_pfh, *pfhp;
-
-   PVFS_sysresp_create resp_create;
+   pvfs_fuse_dir_t *dir = GET_FUSE_DIR( fi );
+   pvfs_fuse_op_t *op;
 
-   /* Translate path into pvfs2 relative path */
-   rc = PINT_get_base_dir((char *)path, directory, PVFS_NAME_MAX);
-   num_segs = PINT_string_count_segments((char *)path);
-   rc = PINT_get_path_element((char *)path, num_segs - 1,
-							  filename, PVFS_SEGMENT_MAX);
+   op = pvfs_fuse_op_alloc(req, &dir->cred);
+   if (!op)
+      return;
 
-   if (rc)
-   {
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
-   }
-
-   rc = lookup( directory, &dir_pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if ( rc < 0 )
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
-
-   /* Set attributes */
-   memset(&attr, 0, sizeof(PVFS_sys_attr));
-   attr.owner = dir_pfh.cred.userid;
-   attr.group = dir_pfh.cred.group_array[0];
-   attr.perms = mode;
-   attr.atime = time(NULL);
-   attr.mtime = attr.atime;
-   attr.mask = PVFS_ATTR_SYS_ALL_SETABLE;
-   attr.dfile_count = 0;
+   op->dir = dir;
+   op->size = size;
+   op->off = off;
+   pvfs_fuse_readdir_reply(op);
+}
 
-   rc = PVFS_sys_create(filename,
-						dir_pfh.ref,
-						attr,
-						&dir_pfh.cred,
-						NULL,
-						&resp_create);
-   if (rc)
-   {
-      /* FIXME
-       * the PVFS2 server code returns a ENOENT instead of an EACCES
-       * because it does a ACL lookup for the system.posix_acl_access
-       * which returns a ENOENT from the TROVE DBPF and that error is
-       * just passed up in prelude_check_acls (server/prelude.c).  I'm
-       * not sure that's the right thing to do.
-       */
-	  if ( rc == -PVFS_ENOENT ) 
-	  {
-		 return -EACCES;
-	  }
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
-   }
+static void pvfs_fuse_releasedir(fuse_req_t req, fuse_ino_t ino,
+                                 struct fuse_file_info *fi)
+{
+   pvfs_fuse_dir_t *dir = GET_FUSE_DIR( fi );
 
-   pfhp = (pvfs_fuse_handle_t *)malloc( sizeof( pvfs_fuse_handle_t ) );
-   if (pfhp == NULL)
-   {
-	  return -ENOMEM;
-   }
+   free(dir->dirents);
+   pvfs_fuse_cleanup_credential(&dir->cred);
+   free(dir);
+   fuse_reply_err(req, 0);
+}
 
-   pfhp->ref = resp_create.ref;
-   pfhp->cred = dir_pfh.cred;
+static void pvfs_fuse_statfs(fuse_req_t req, fuse_ino_t ino)
+{
+   PVFS_sys_op_id op_id = -1;
+   pvfs_fuse_op_t *op;
+   int ret;
 
-   SET_FUSE_HANDLE( fi, pfhp );
+   op = pvfs_fuse_op_alloc(req, NULL);
+   if (!op)
+      return;
 
-   return 0;
+   op->state = PVFS_FUSE_STATFS;
+   ret = PVFS_isys_statfs(pvfs2fuse.fs_id, &op->cred, &op->resp.statfs,
+                          &op_id, PVFS_HINT_NULL, op);
+   pvfs_fuse_posted(op, op_id, ret);
 }
 
-static struct fuse_operations pvfs_fuse_oper = {
+/* access() is left to the kernel, which checks modes itself when
+ * mounted with default_permissions
+ */
+static struct fuse_lowlevel_ops pvfs_fuse_oper = {
+   .init	= pvfs_fuse_init,
+   .lookup	= pvfs_fuse_lookup,
+   .forget	= pvfs_fuse_forget,
    .getattr	= pvfs_fuse_getattr,
-   .fgetattr	= pvfs_fuse_fgetattr,
+   .setattr	= pvfs_fuse_setattr,
    .readlink	= pvfs_fuse_readlink,
    .mkdir	= pvfs_fuse_mkdir,
-   .unlink	= pvfs_fuse_unlink,
-   .rmdir	= pvfs_fuse_rmdir,
+   .unlink	= pvfs_fuse_remove,
+   .rmdir	= pvfs_fuse_remove,
    .symlink	= pvfs_fuse_symlink,
    .rename	= pvfs_fuse_rename,
    /* .link	= pvfs_fuse_link, */ /* hard links not supported on PVFS */
-   .chmod	= pvfs_fuse_chmod,
-   .chown	= pvfs_fuse_chown,
-   .truncate	= pvfs_fuse_truncate,
-   .utime	= pvfs_fuse_utime,
    .open	= pvfs_fuse_open,
    .read	= pvfs_fuse_read,
    .write	= pvfs_fuse_write,
-   .statfs	= pvfs_fuse_statfs,
-/*  .flush	= pvfs_fuse_flush, */
+   .flush	= pvfs_fuse_flush,
    .release	= pvfs_fuse_release,
    .fsync	= pvfs_fuse_fsync,
+   .opendir	= pvfs_fuse_opendir,
    .readdir	= pvfs_fuse_readdir,
-   .access	= pvfs_fuse_access,
+   .releasedir	= pvfs_fuse_releasedir,
+   .statfs	= pvfs_fuse_statfs,
    .create	= pvfs_fuse_create,
+#if FUSE_VERSION >= 29
+   .write_buf	= pvfs_fuse_write_buf,
+   .forget_multi	= pvfs_fuse_forget_multi,
+#endif
 };
 
 enum {
@@ -1103,6 +1485,9 @@ enum {
 
 static struct fuse_opt pvfs2fuse_opts[] = {
    PVFS2FUSE_OPT("fs_spec=%s",     fs_spec, 0),
+   PVFS2FUSE_OPT("attr_timeout=%lf", attr_timeout, 0),
+   PVFS2FUSE_OPT("entry_timeout=%lf", entry_timeout, 0),
+   PVFS2FUSE_OPT("direct_io",      direct_io, 1),
 
    FUSE_OPT_KEY("-V",             KEY_VERSION),
    FUSE_OPT_KEY("--version",      KEY_VERSION),
@@ -1123,18 +1508,12 @@ static void usage(const char *progname)
 		   "\n"
 		   "PVFS2FUSE options:\n"
 		   "    -o fs_spec=FS_SPEC     PVFS2 fs_spec URI (eg. tcp://localhost:3334/pvfs2-fs)\n"
+		   "    -o attr_timeout=T      seconds the kernel caches attributes (1.0)\n"
+		   "    -o entry_timeout=T     seconds the kernel caches names (1.0)\n"
+		   "    -o direct_io           bypass the kernel page cache\n"
 		   "\n", progname);
 }
 
-static int pvfs_fuse_main(struct fuse_args *args)
-{
-#if FUSE_VERSION >= 26
-   return fuse_main(args->argc, args->argv, &pvfs_fuse_oper, NULL);
-#else
-   return fuse_main(args->argc, args->argv, &pvfs_fuse_oper);
-#endif
-}
-
 static int pvfs2fuse_opt_proc(void *data, const char *arg, int key,
 							  struct fuse_args *outargs)
 {
@@ -1158,18 +1537,13 @@ static int pvfs2fuse_opt_proc(void *data, const char *arg, int key,
 
 	  case KEY_HELP:
 		 usage(outargs->argv[0]);
-		 /* FIXME don't show the FUSE arguments
-			fuse_opt_add_arg(outargs, "-ho");
-			pvfs_fuse_main(outargs); */
 		 exit(1);
 
 	  case KEY_VERSION:
 		 fprintf(stderr, "PVFS2FUSE version %s (PVFS2 %s) (%s, %s)\n",
 				 pvfs2fuse_version, PVFS2_VERSION, __DATE__, __TIME__);
-#if FUSE_VERSION >= 25
-		 fuse_opt_add_arg(outargs, "--version");
-		 pvfs_fuse_main(outargs);
-#endif
+		 fprintf(stderr, "FUSE library version %d.%d\n",
+				 fuse_version() / 10, fuse_version() % 10);
 		 exit(0);
 
 	  default:
@@ -1178,54 +1552,16 @@ static int pvfs2fuse_opt_proc(void *data, const char *arg, int key,
    }
 }
 
-int main(int argc, char *argv[])
+/* pvfs_fuse_parse_fs_spec()
+ *
+ * fills in pvfs2fuse.mntent from the fs_spec option
+ */
+static void pvfs_fuse_parse_fs_spec(void)
 {
-   int ret;
-   struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
-
-   umask(0);
-
-   if (fuse_opt_parse(&args, &pvfs2fuse, pvfs2fuse_opts,
-					  pvfs2fuse_opt_proc) == -1 )
-	  exit(1);
-
-   if (pvfs2fuse.fs_spec == NULL)
-   {
-	  ret = PVFS_util_init_defaults();
-	  if(ret < 0)
-	  {
-		 PVFS_perror("PVFS_util_init_defaults", ret);
-		 return(-1);
-	  }
-
-	  ret = PVFS_util_get_default_fsid(&pvfs2fuse.fs_id);
-	  if( ret < 0 )
-	  {
-		 PVFS_perror("No default PVFS2 filesystem found", ret);
-		 return(-1);
-	  }
-
-	  PVFS_util_get_mntent_copy( pvfs2fuse.fs_id, &pvfs2fuse.mntent );
-	  /* Set timeouts for PVFS2's name cache and attribute cache */
-	  PVFS_sys_set_info(PVFS_SYS_ACACHE_TIMEOUT_MSECS, 0);
-	  PVFS_sys_set_info(PVFS_SYS_NCACHE_TIMEOUT_MSECS, 0);
-   }
-   else
-   {
 	  struct PVFS_sys_mntent *me = &pvfs2fuse.mntent;
 	  char *cp;
 	  int cur_server;
 
-	  /* the following is copied from PVFS_util_init_defaults()
-		 in fuse/lib/pvfs2-util.c */
-
-	  /* initialize pvfs system interface */
-	  ret = PVFS_sys_initialize(GOSSIP_NO_DEBUG);
-	  if (ret < 0)
-	  {
-		 return(ret);
-	  }
-
 	  /* the following is copied from PVFS_util_parse_pvfstab()
 		 in fuse/lib/pvfs2-util.c */
 	  memset( me, 0, sizeof(pvfs2fuse.mntent) );
@@ -1280,7 +1616,7 @@ int main(int argc, char *argv[])
 		 last_slash = rindex(tok, '/');
 		 *last_slash = '\0';
 
-		 /* config server and fs name are a special case, take one 
+		 /* config server and fs name are a special case, take one
 		  * string and split it in half on "/" delimiter
 		  */
 		 me->pvfs_config_servers[cur_server] = strdup(tok);
@@ -1303,7 +1639,7 @@ int main(int argc, char *argv[])
 		 }
 		 ++cur_server;
 	  }
-	
+
 	  /* FIXME flowproto should be an option */
 	  me->flowproto = FLOWPROTO_DEFAULT;
 
@@ -1311,29 +1647,160 @@ int main(int argc, char *argv[])
 	  me->encoding = PVFS2_ENCODING_DEFAULT;
 
 	  /* FIXME default_num_dfiles should be an option */
+}
 
-	  ret = PVFS_sys_fs_add(me);
-	  if( ret < 0 )
+/* pvfs_fuse_pvfs_init()
+ *
+ * brings up the sysint and finds the root of the file system; run after
+ * daemonizing, since the threads the sysint starts do not survive fork()
+ */
+static int pvfs_fuse_pvfs_init(void)
+{
+   PVFS_credential cred;
+   PVFS_sysresp_lookup resp_lookup;
+   int ret;
+
+   ret = PVFS_sys_initialize(GOSSIP_NO_DEBUG);
+   if (ret < 0)
+   {
+      PVFS_perror_gossip("PVFS_sys_initialize", ret);
+      return ret;
+   }
+
+   ret = PVFS_sys_fs_add(&pvfs2fuse.mntent);
+   if (ret < 0 && ret != -PVFS_EEXIST)
+   {
+      PVFS_perror_gossip("Could not add mnt entry", ret);
+      return ret;
+   }
+   pvfs2fuse.fs_id = pvfs2fuse.mntent.fs_id;
+
+   /* the kernel caches names and attributes for attr_timeout and
+    * entry_timeout; a second cache here would only delay changes
+    */
+   PVFS_sys_set_info(PVFS_SYS_ACACHE_TIMEOUT_MSECS, 0);
+   PVFS_sys_set_info(PVFS_SYS_NCACHE_TIMEOUT_MSECS, 0);
+
+   ret = PVFS_util_gen_credential_defaults(&cred);
+   if (ret < 0)
+   {
+      PVFS_perror_gossip("PVFS_util_gen_credential_defaults", ret);
+      return ret;
+   }
+
+   memset(&resp_lookup, 0, sizeof(resp_lookup));
+   ret = PVFS_sys_lookup(pvfs2fuse.fs_id, "/", &cred, &resp_lookup,
+                         PVFS2_LOOKUP_LINK_FOLLOW);
+   pvfs_fuse_cleanup_credential(&cred);
+   if (ret < 0)
+   {
+      PVFS_perror_gossip("PVFS_sys_lookup", ret);
+      return ret;
+   }
+
+   root_inode.ref = resp_lookup.ref;
+   root_inode.nlookup = 1;
+
+   inode_table = qhash_init(pvfs_fuse_inode_compare, quickhash_64bit_hash,
+                            1021);
+   if (!inode_table)
+      return -PVFS_ENOMEM;
+
+   return 0;
+}
+
+static int pvfs_fuse_main(struct fuse_args *args)
+{
+   struct fuse_chan *ch;
+   struct fuse_session *se;
+   char *mountpoint = NULL;
+   int multithreaded, foreground;
+   pthread_t progress_thread;
+   int ret = -1;
+
+   if (fuse_parse_cmdline(args, &mountpoint, &multithreaded,
+                          &foreground) == -1)
+      return -1;
+
+   ch = fuse_mount(mountpoint, args);
+   if (!ch)
+      goto out;
+
+   se = fuse_lowlevel_new(args, &pvfs_fuse_oper, sizeof(pvfs_fuse_oper),
+                          NULL);
+   if (!se)
+      goto out_unmount;
+
+   if (fuse_set_signal_handlers(se) == -1)
+      goto out_destroy;
+   fuse_session_add_chan(se, ch);
+
+   if (fuse_daemonize(foreground) == -1)
+      goto out_remove;
+
+   if (pvfs_fuse_pvfs_init() < 0)
+      goto out_remove;
+
+   if (pthread_create(&progress_thread, NULL, pvfs_fuse_progress, NULL))
+      goto out_finalize;
+
+   if (multithreaded)
+      ret = fuse_session_loop_mt(se);
+   else
+      ret = fuse_session_loop(se);
+
+   pvfs2fuse.exiting = 1;
+   pthread_join(progress_thread, NULL);
+
+out_finalize:
+   PVFS_sys_finalize();
+out_remove:
+   fuse_remove_signal_handlers(se);
+   fuse_session_remove_chan(ch);
+out_destroy:
+   fuse_session_destroy(se);
+out_unmount:
+   fuse_unmount(mountpoint, ch);
+out:
+   free(mountpoint);
+   return ret ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+   struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+
+   umask(0);
+
+   pvfs2fuse.attr_timeout = 1.0;
+   pvfs2fuse.entry_timeout = 1.0;
+
+   if (fuse_opt_parse(&args, &pvfs2fuse, pvfs2fuse_opts,
+					  pvfs2fuse_opt_proc) == -1 )
+	  exit(1);
+
+   if (pvfs2fuse.fs_spec == NULL)
+   {
+	  const PVFS_util_tab *tab = PVFS_util_parse_pvfstab(NULL);
+
+	  if (!tab || tab->mntent_count < 1)
 	  {
-		 PVFS_perror("Could not add mnt entry", ret);
+		 fprintf(stderr, "No default PVFS2 filesystem found\n");
 		 return(-1);
 	  }
-	  pvfs2fuse.fs_id = me->fs_id;
+	  PVFS_util_copy_mntent( &pvfs2fuse.mntent, &tab->mntent_array[0] );
+   }
+   else
+   {
+	  pvfs_fuse_parse_fs_spec();
    }
 
-   /* FIXME should we allow all the FUSE options?  Maybe we should
-	* pass only some of the FUSE options to fuse_main.  For now,
-	* force the direct_io and allow_other options.  Also turn off
-	* multithreaded operation since it doesnt work with PVFS.
-	*/
-
-   fuse_opt_insert_arg( &args, 1, "-odirect_io" );
-   fuse_opt_insert_arg( &args, 1, "-oattr_timeout=0");
    fuse_opt_insert_arg( &args, 1, "-omax_write=524288");
    if ( getuid() == 0 )
 	  fuse_opt_insert_arg( &args, 1, "-oallow_other" );
-   fuse_opt_insert_arg( &args, 1, "-s" );
-    
+   /* permissions are checked by the kernel instead of an access call */
+   fuse_opt_insert_arg( &args, 1, "-odefault_permissions" );
+
    {
 	  /* set the fsname and volname */
 	  char name[200];
@@ -1349,15 +1816,16 @@ int main(int argc, char *argv[])
 	  fuse_opt_insert_arg( &args, 1, name );
 #endif
    }
-    
+
 #if (__FreeBSD__ >= 10)
    {
 	  /* MacFUSE has a bug where cached attributes
 	   * arent invalidated on direct_io writes
 	   */
-	  fuse_opt_insert_arg( &args, 1, "-oattr_timeout=0" );
+	  pvfs2fuse.attr_timeout = 0;
    }
 #endif
 
    return pvfs_fuse_main(&args);
 }
+
@@ -1697,6 +1697,29 @@ fail_downcall:
     goto ok;
 }
 
+/* appends the per shard hit rates of a client cache after its counters,
+ * as far as they fit in the downcall buffer
+ */
+static void append_shard_text(char *buffer, char *(*generate)(int))
+{
+    char *shard_str;
+    int used;
+
+    buffer[PERF_COUNT_BUF_SIZE - 1] = '\0';
+    used = strlen(buffer);
+    if (used >= PERF_COUNT_BUF_SIZE - 1)
+    {
+        return;
+    }
+
+    shard_str = generate(PERF_COUNT_BUF_SIZE - used);
+    if (shard_str)
+    {
+        strncat(buffer, shard_str, PERF_COUNT_BUF_SIZE - used - 1);
+        free(shard_str);
+    }
+}
+
 static PVFS_error service_perf_count_request(vfs_request_t *vfs_request)
 {
     char* tmp_str;
@@ -1721,6 +1744,9 @@ static PVFS_error service_perf_count_request(vfs_request_t *vfs_request)
                 strncpy(vfs_request->out_downcall.resp.perf_count.buffer,
                     tmp_str, PERF_COUNT_BUF_SIZE - 1);
                 free(tmp_str);
+                append_shard_text(
+                    vfs_request->out_downcall.resp.perf_count.buffer,
+                    PINT_acache_generate_shard_text);
                 vfs_request->out_downcall.status = 0;
             }
             break;
@@ -1737,6 +1763,9 @@ static PVFS_error service_perf_count_request(vfs_request_t *vfs_request)
                 strncpy(vfs_request->out_downcall.resp.perf_count.buffer,
                     tmp_str, PERF_COUNT_BUF_SIZE - 1);
                 free(tmp_str);
+                append_shard_text(
+                    vfs_request->out_downcall.resp.perf_count.buffer,
+                    PINT_ncache_generate_shard_text);
                 vfs_request->out_downcall.status = 0;
             }
             break;
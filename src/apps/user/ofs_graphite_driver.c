@@ -617,6 +617,8 @@ int main(int argc, char **argv)
                         GRAPHITE_CNT("io", PINT_PERF_IO, s, h);
                         GRAPHITE_CNT("smallio", PINT_PERF_SMALL_IO, s, h);
                         GRAPHITE_CNT("readdir", PINT_PERF_READDIR, s, h);
+                        GRAPHITE_CNT("fdcachehits", PINT_PERF_OPEN_CACHE_HITS, s, h);
+                        GRAPHITE_CNT("fdcachemisses", PINT_PERF_OPEN_CACHE_MISSES, s, h);
                     }
                 }
                 else if (user_opts->ctype == PINT_PERF_TIMER)
@@ -15,6 +15,7 @@ import java.util.EnumSet;
 import org.apache.commons.logging.Log;
 import org.apache.commons.logging.LogFactory;
 import org.apache.hadoop.conf.Configuration;
+import org.apache.hadoop.fs.BlockLocation;
 import org.apache.hadoop.fs.CreateFlag;
 import org.apache.hadoop.fs.FSDataInputStream;
 import org.apache.hadoop.fs.FSDataOutputStream;
@@ -283,6 +284,63 @@ public class OrangeFileSystem extends FileSystem {
         return true;
     }
 
+    /*
+     * Return the OrangeFS servers holding each block of the file so that
+     * tasks can be scheduled on the nodes their data lives on.
+     */
+    @Override
+    public BlockLocation[] getFileBlockLocations(FileStatus file, long start,
+            long len)
+            throws IOException {
+        String[] blockHosts;
+        BlockLocation[] locations;
+        String[] names;
+        String[] hosts;
+        long blockSize;
+        long end;
+        long offset;
+
+        if (file == null) {
+            return null;
+        }
+        if (start < 0 || len < 0) {
+            throw new IllegalArgumentException("Invalid start or len parameter");
+        }
+        if (file.isDirectory() || file.getLen() <= start || len == 0) {
+            return new BlockLocation[0];
+        }
+        blockSize = file.getBlockSize() > 0 ? file.getBlockSize()
+                : ofsBlockSize;
+        end = (len > file.getLen() - start) ? file.getLen() : start + len;
+
+        String fOFS = getOFSPathName(file.getPath());
+        statistics.incrementReadOps(1);
+        blockHosts = orange.stdio.getBlockHosts(fOFS, start, end - start,
+                blockSize);
+        if (blockHosts == null) {
+            OFSLOG.debug("getBlockHosts(" + fOFS + ") returned null");
+            return super.getFileBlockLocations(file, start, len);
+        }
+
+        locations = new BlockLocation[blockHosts.length];
+        offset = (start / blockSize) * blockSize;
+        for (int i = 0; i < blockHosts.length; i++) {
+            names = blockHosts[i].isEmpty() ? new String[0]
+                    : blockHosts[i].split(",");
+            hosts = new String[names.length];
+            for (int j = 0; j < names.length; j++) {
+                int colon = names[j].lastIndexOf(':');
+                hosts[j] = colon > 0 ? names[j].substring(0, colon)
+                        : names[j];
+            }
+            locations[i] = new BlockLocation(names, hosts, offset,
+                    Math.min(blockSize, file.getLen() - offset));
+            OFSLOG.debug("block " + offset + ": " + blockHosts[i]);
+            offset += blockSize;
+        }
+        return locations;
+    }
+
     /* Return a file status object that represents the path. */
     @Override
     public FileStatus getFileStatus(Path f)
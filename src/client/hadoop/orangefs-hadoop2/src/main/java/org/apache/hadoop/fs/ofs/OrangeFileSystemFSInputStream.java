@@ -7,16 +7,18 @@ package org.apache.hadoop.fs.ofs;
 
 import java.io.Closeable;
 import java.io.IOException;
+import java.nio.ByteBuffer;
 
 import org.apache.commons.logging.Log;
 import org.apache.commons.logging.LogFactory;
+import org.apache.hadoop.fs.ByteBufferReadable;
 import org.apache.hadoop.fs.FileSystem;
 import org.apache.hadoop.fs.PositionedReadable;
 import org.apache.hadoop.fs.Seekable;
 import org.orangefs.usrint.OrangeFileSystemInputStream;
 
 public class OrangeFileSystemFSInputStream extends OrangeFileSystemInputStream
-        implements Closeable, Seekable, PositionedReadable {
+        implements Closeable, Seekable, PositionedReadable, ByteBufferReadable {
     private FileSystem.Statistics statistics;
     public static final Log OFSLOG = LogFactory
             .getLog(OrangeFileSystemFSInputStream.class);
@@ -91,6 +93,22 @@ public class OrangeFileSystemFSInputStream extends OrangeFileSystemInputStream
         return ret;
     }
 
+    /*
+     * Override parent class implementation to include FileSystem.Statistics.
+     * Lets FSDataInputStream.read(ByteBuffer) fill direct buffers without a
+     * heap copy.
+     */
+    @Override
+    public synchronized int read(ByteBuffer buf)
+            throws IOException {
+        int ret = super.read(buf);
+        statistics.incrementReadOps(1);
+        if (ret > 0 && statistics != null) {
+            statistics.incrementBytesRead(ret);
+        }
+        return ret;
+    }
+
     /* This method has an implementation in abstract class FSInputStream */
     @Override
     public int read(long position, byte[] buffer, int offset, int length)
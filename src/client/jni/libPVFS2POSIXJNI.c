@@ -7,6 +7,7 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <pvfs2-hint.h>
 #include <pvfs2-types.h>
 #include <pvfs2-usrint.h>
@@ -30,6 +31,8 @@
 
 /* Forward Declarations */
 static int fill_stat(JNIEnv *env, struct stat *ptr, jobject *inst);
+static int fill_iovec(JNIEnv *env, jobjectArray iov, jlongArray iovlen,
+        struct iovec **vec);
 //static int fill_statfs(JNIEnv *env, struct statfs *ptr, jobject *inst);
 
 /* Convert allocated struct to an instance of our Stat Class */
@@ -83,6 +86,72 @@ static int fill_stat(JNIEnv *env, struct stat *ptr, jobject *inst)
     return 0;
 }
 
+/*
+ * Point an iovec at each direct ByteBuffer of iov, iovlen[i] bytes from the
+ * start of the buffer, so readv and writev move data without copying it.
+ * Returns the number of entries in *vec, which the caller frees, or -1.
+ */
+static int fill_iovec(JNIEnv *env, jobjectArray iov, jlongArray iovlen,
+        struct iovec **vec)
+{
+    JNI_PFI();
+    jobject buf;
+    jlong *lens;
+    int count, i;
+
+    *vec = NULL;
+    if (!iov || !iovlen)
+    {
+        JNI_ERROR("iov or iovlen is NULL\n");
+        return -1;
+    }
+    count = (*env)->GetArrayLength(env, iov);
+    if (count != (*env)->GetArrayLength(env, iovlen) || count > IOV_MAX)
+    {
+        JNI_ERROR("invalid iov count: %d\n", count);
+        return -1;
+    }
+    *vec = malloc((count ? count : 1) * sizeof(struct iovec));
+    if (!*vec)
+    {
+        JNI_ERROR("malloc failed\n");
+        return -1;
+    }
+    lens = (*env)->GetLongArrayElements(env, iovlen, NULL);
+    if (!lens)
+    {
+        JNI_ERROR("GetLongArrayElements returned NULL\n");
+        free(*vec);
+        *vec = NULL;
+        return -1;
+    }
+    for (i = 0; i < count; i++)
+    {
+        buf = (*env)->GetObjectArrayElement(env, iov, i);
+        (*vec)[i].iov_base = buf ? (*env)->GetDirectBufferAddress(env, buf)
+                                 : NULL;
+        (*vec)[i].iov_len = (size_t) lens[i];
+        if (!(*vec)[i].iov_base || lens[i] < 0 ||
+            lens[i] > (*env)->GetDirectBufferCapacity(env, buf))
+        {
+            JNI_ERROR("iov[%d] is not a direct buffer of %lld bytes\n", i,
+                    (long long) lens[i]);
+            (*env)->DeleteLocalRef(env, buf);
+            break;
+        }
+        (*env)->DeleteLocalRef(env, buf);
+    }
+    /* lengths were only read, nothing to copy back */
+    (*env)->ReleaseLongArrayElements(env, iovlen, lens, JNI_ABORT);
+    if (i < count)
+    {
+        free(*vec);
+        *vec = NULL;
+        return -1;
+    }
+    return count;
+}
+
 /* Convert allocated structure to an instance of our Statfs Class */
 
 static int fill_statfs(JNIEnv *env, struct statfs *ptr, jobject *inst)
@@ -1232,22 +1301,56 @@ Java_org_orangefs_usrint_PVFS2POSIXJNI_openat(JNIEnv *env, jobject obj,
     return (jint) ret;
 }
 
-/* pread */
+/* pread: like read, into a direct ByteBuffer, at offset in the file */
 JNIEXPORT jlong JNICALL
 Java_org_orangefs_usrint_PVFS2POSIXJNI_pread(JNIEnv *env, jobject obj, int fd,
-        jbyteArray buf, jlong count, jlong offset)
+        jobject buf, jlong count, jlong offset)
 {
-    /* TODO */
-    return -1;
+    JNI_PFI();
+    jlong ret = 0;
+    void * buf_addr = 0;
+    JNI_PRINT("\tfd = %d\n\tcount = %lu\n\toffset = %ld\n", fd,
+            (uint64_t ) count, (int64_t ) offset);
+    buf_addr = (*env)->GetDirectBufferAddress(env, buf);
+    if (!buf_addr)
+    {
+        JNI_ERROR("buf_addr returned by GetDirectBufferAddress is NULL\n");
+        ret = -1;
+        return ret;
+    }
+    ret = (jlong) pread(fd, buf_addr, (size_t) count, (off_t) offset);
+    if (ret < 0)
+    {
+        JNI_PERROR();
+        ret = -1;
+    }
+    return ret;
 }
 
-/* pwrite */
+/* pwrite: like write, from a direct ByteBuffer, at offset in the file */
 JNIEXPORT jlong JNICALL
 Java_org_orangefs_usrint_PVFS2POSIXJNI_pwrite(JNIEnv *env, jobject obj, int fd,
-        jbyteArray buf, jlong count, jlong offset)
+        jobject buf, jlong count, jlong offset)
 {
-    /* TODO */
-    return -1;
+    JNI_PFI();
+    jlong ret = 0;
+    void * buf_addr = 0;
+    JNI_PRINT("\tfd = %d\n\tcount = %lu\n\toffset = %ld\n", fd,
+            (uint64_t ) count, (int64_t ) offset);
+    buf_addr = (*env)->GetDirectBufferAddress(env, buf);
+    if (!buf_addr)
+    {
+        JNI_ERROR("buf_addr returned by GetDirectBufferAddress is NULL\n");
+        ret = -1;
+        return ret;
+    }
+    ret = (jlong) pwrite(fd, buf_addr, (size_t) count, (off_t) offset);
+    if (ret < 0)
+    {
+        JNI_PERROR();
+        ret = -1;
+    }
+    return ret;
 }
 
 /*
@@ -1347,6 +1450,30 @@ Java_org_orangefs_usrint_PVFS2POSIXJNI_removexattr(JNIEnv *env, jobject obj,
     return ret;
 }
 
+/* readv: scatter into direct ByteBuffers, see fill_iovec */
+JNIEXPORT jlong JNICALL
+Java_org_orangefs_usrint_PVFS2POSIXJNI_readv(JNIEnv *env, jobject obj, int fd,
+        jobjectArray iov, jlongArray iovlen)
+{
+    JNI_PFI();
+    jlong ret = 0;
+    struct iovec *vec = NULL;
+    int count = fill_iovec(env, iov, iovlen, &vec);
+    if (count < 0)
+    {
+        return -1;
+    }
+    JNI_PRINT("\tfd = %d\n\tiovcnt = %d\n", fd, count);
+    ret = (jlong) readv(fd, vec, count);
+    if (ret < 0)
+    {
+        JNI_PERROR();
+        ret = -1;
+    }
+    free(vec);
+    return ret;
+}
+
 /* rename */
 JNIEXPORT jint JNICALL
 Java_org_orangefs_usrint_PVFS2POSIXJNI_rename(JNIEnv *env, jobject obj,
@@ -1695,3 +1822,28 @@ Java_org_orangefs_usrint_PVFS2POSIXJNI_write(JNIEnv *env, jobject obj, int fd,
     }
     return ret;
 }
+
+/* writev: gather from direct ByteBuffers, see fill_iovec */
+JNIEXPORT jlong JNICALL
+Java_org_orangefs_usrint_PVFS2POSIXJNI_writev(JNIEnv *env, jobject obj, int fd,
+        jobjectArray iov, jlongArray iovlen)
+{
+    JNI_PFI();
+    jlong ret = 0;
+    struct iovec *vec = NULL;
+    int count = fill_iovec(env, iov, iovlen, &vec);
+    if (count < 0)
+    {
+        return -1;
+    }
+    JNI_PRINT("\tfd = %d\n\tiovcnt = %d\n", fd, count);
+    ret = (jlong) writev(fd, vec, count);
+    JNI_PRINT("writev returned: %ld\n", ret);
+    if (ret < 0)
+    {
+        JNI_PERROR();
+        ret = -1;
+    }
+    free(vec);
+    return ret;
+}
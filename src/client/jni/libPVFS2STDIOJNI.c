@@ -17,6 +17,11 @@
 #include <usrint.h>
 #include <recursive-remove.h>
 #include <str-utils.h>
+#include <posix-ops.h>
+#include <openfile-util.h>
+#include <iocommon.h>
+#include <pint-distribution.h>
+#include <pint-cached-config.h>
 #include "org_orangefs_usrint_PVFS2STDIOJNI.h"
 
 /* TODO: relocate these maybe to pvfs2-types.h? */
@@ -25,11 +30,21 @@
 /* From 'man groupadd': "Groupnames may only be up to 32 characters long." */
 #define MAX_GROUPNAME_LENGTH 32
 
+/* metafile distribution and datafile handles of a file */
+#define DIST_KEY "system.pvfs2." METAFILE_DIST_KEYSTR
+#define DFILE_KEY "system.pvfs2." DATAFILE_HANDLES_KEYSTR
+
 /* Forward declarations of non-native functions */
 static int get_groupname_by_gid(gid_t gid, char *groupname);
 static int get_username_by_uid(uid_t uid, char *username);
 static int get_gid_by_groupname(gid_t *gid, char *groupname);
 static int get_uid_by_username(uid_t *uid, char *username);
+static int get_file_layout(const char *path, PVFS_fs_id *fs_id,
+        PINT_dist **dist, PVFS_handle **handles, int *dfile_count);
+static void get_server_host(PVFS_fs_id fs_id, PVFS_handle handle,
+        char *host, int len);
+static PVFS_size get_dfile_bytes(PINT_dist *dist, PINT_request_file_data *rf,
+        PVFS_offset start, PVFS_offset end);
 
 static int get_groupname_by_gid(gid_t gid, char *groupname)
 {
@@ -115,6 +130,131 @@ static int get_uid_by_username(uid_t *uid, char *username)
     return 0;
 }
 
+/* Read the distribution and the datafile handles of an OrangeFS file */
+static int get_file_layout(const char *path, PVFS_fs_id *fs_id,
+        PINT_dist **dist, PVFS_handle **handles, int *dfile_count)
+{
+    JNI_PFI();
+    pvfs_descriptor *pd;
+    char *dist_buf = NULL;
+    int fd, ret = -1;
+
+    *dist = NULL;
+    *handles = NULL;
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        JNI_PERROR();
+        return -1;
+    }
+    pd = pvfs_find_descriptor(fd);
+    if (!pd || pd->is_in_use != PVFS_FS || !pd->s ||
+        pd->s->fsops != &pvfs_ops)
+    {
+        JNI_PRINT("%s is not an OrangeFS file\n", path);
+        goto out;
+    }
+    *fs_id = pd->s->pvfs_ref.fs_id;
+
+    dist_buf = malloc(PVFS_REQ_LIMIT_DIST_BYTES);
+    *handles = malloc(PVFS_REQ_LIMIT_DFILE_COUNT * sizeof(PVFS_handle));
+    if (!dist_buf || !*handles)
+    {
+        goto out;
+    }
+    if (iocommon_geteattr(pd, DIST_KEY, dist_buf,
+                          PVFS_REQ_LIMIT_DIST_BYTES) <= 0)
+    {
+        JNI_PERROR();
+        goto out;
+    }
+    ret = iocommon_geteattr(pd, DFILE_KEY, *handles,
+                            PVFS_REQ_LIMIT_DFILE_COUNT * sizeof(PVFS_handle));
+    if (ret < (int) sizeof(PVFS_handle))
+    {
+        JNI_PERROR();
+        ret = -1;
+        goto out;
+    }
+    *dfile_count = ret / sizeof(PVFS_handle);
+
+    PINT_dist_decode(dist, dist_buf);
+    ret = (*dist && (*dist)->methods) ? 0 : -1;
+out:
+    if (ret != 0)
+    {
+        PINT_dist_free(*dist);
+        *dist = NULL;
+        free(*handles);
+        *handles = NULL;
+    }
+    free(dist_buf);
+    close(fd);
+    return ret;
+}
+
+/* Copy the host:port of the server holding handle into host */
+static void get_server_host(PVFS_fs_id fs_id, PVFS_handle handle,
+        char *host, int len)
+{
+    PVFS_BMI_addr_t addr;
+    const char *name = NULL;
+    const char *p;
+    int i = 0;
+
+    if (PINT_cached_config_map_to_server(&addr, handle, fs_id) == 0)
+    {
+        name = PINT_cached_config_map_addr(fs_id, addr, NULL);
+    }
+    if (!name)
+    {
+        name = "";
+    }
+    /* "tcp://host:port" or a list of them, keep the first host:port */
+    p = strstr(name, "://");
+    p = p ? p + 3 : name;
+    while (p[i] && p[i] != ',' && p[i] != '/' && i < len - 1)
+    {
+        host[i] = p[i];
+        i++;
+    }
+    host[i] = '\0';
+}
+
+/* Count the bytes of [start, end) of the file that the datafile
+ * rf->server_nr holds
+ */
+static PVFS_size get_dfile_bytes(PINT_dist *dist, PINT_request_file_data *rf,
+        PVFS_offset start, PVFS_offset end)
+{
+    PVFS_size total = 0;
+    PVFS_size run;
+    PVFS_offset off = start;
+
+    while (off < end)
+    {
+        off = dist->methods->next_mapped_offset(dist->params, rf, off);
+        if (off < 0 || off >= end)
+        {
+            break;
+        }
+        run = dist->methods->contiguous_length(dist->params, rf,
+                dist->methods->logical_to_physical_offset(dist->params, rf,
+                                                          off));
+        if (run <= 0)
+        {
+            break;
+        }
+        if (run > end - off)
+        {
+            run = end - off;
+        }
+        total += run;
+        off += run;
+    }
+    return total;
+}
+
 /* clearerr */
 JNIEXPORT void JNICALL
 Java_org_orangefs_usrint_PVFS2STDIOJNI_clearerr(JNIEnv *env, jobject obj,
@@ -597,7 +737,7 @@ JNIEXPORT jlong JNICALL
 Java_org_orangefs_usrint_PVFS2STDIOJNI_fread(JNIEnv *env, jobject obj,
         jbyteArray ptr, jlong size, jlong nmemb, jlong stream)
 {
-    /* TODO: rewrite this using NIO ByteBuffer like PVFS2POSIXJNI_read. */
+    /* copies ptr in and out, see freadDirect */
     JNI_PFI();
     jlong ret = 0;
     jboolean is_copy;
@@ -629,12 +769,48 @@ Java_org_orangefs_usrint_PVFS2STDIOJNI_fread(JNIEnv *env, jobject obj,
     return ret;
 }
 
+/* freadDirect: fread into a direct ByteBuffer, without copying it */
+JNIEXPORT jlong JNICALL
+Java_org_orangefs_usrint_PVFS2STDIOJNI_freadDirect(JNIEnv *env, jobject obj,
+        jobject ptr, jlong size, jlong nmemb, jlong stream)
+{
+    JNI_PFI();
+    jlong ret = 0;
+    void * buf_addr = 0;
+    if (ptr == NULL )
+    {
+        JNI_ERROR("ptr is null");
+        return ret;
+    }
+    buf_addr = (*env)->GetDirectBufferAddress(env, ptr);
+    if (!buf_addr ||
+        size * nmemb > (*env)->GetDirectBufferCapacity(env, ptr))
+    {
+        JNI_ERROR("ptr is not a direct buffer of %llu bytes\n",
+                (long long unsigned int ) (size * nmemb));
+        return ret;
+    }
+    JNI_PRINT("size = %llu\nnmemb = %llu\nstream = %llu\n",
+            (long long unsigned int ) size, (long long unsigned int ) nmemb,
+            (long long unsigned int ) stream);
+    ret = (jlong) fread(buf_addr, (size_t) size, (size_t) nmemb,
+            (FILE *) stream);
+    if (ret < nmemb)
+    {
+        JNI_PRINT("ret < nmemb, so check feof, then ferror if necessary.");
+    }
+    JNI_PRINT("\tread %llu items totaling %llu bytes\n",
+            (long long unsigned int ) ret,
+            (long long unsigned int ) ret * (long long unsigned int ) size);
+    return ret;
+}
+
 /* fread_unlocked */
 JNIEXPORT jlong JNICALL
 Java_org_orangefs_usrint_PVFS2STDIOJNI_freadUnlocked(JNIEnv *env, jobject obj,
         jbyteArray ptr, jlong size, jlong nmemb, jlong stream)
 {
-    /* TODO: rewrite this using NIO ByteBuffer like PVFS2POSIXJNI_read. */
+    /* copies ptr in and out, see freadDirect */
     JNI_PFI();
     jlong ret = 0;
     jboolean is_copy;
@@ -663,6 +839,42 @@ Java_org_orangefs_usrint_PVFS2STDIOJNI_freadUnlocked(JNIEnv *env, jobject obj,
     return ret;
 }
 
+/* freadUnlockedDirect: fread into a direct ByteBuffer, without copying it */
+JNIEXPORT jlong JNICALL
+Java_org_orangefs_usrint_PVFS2STDIOJNI_freadUnlockedDirect(JNIEnv *env,
+        jobject obj, jobject ptr, jlong size, jlong nmemb, jlong stream)
+{
+    JNI_PFI();
+    jlong ret = 0;
+    void * buf_addr = 0;
+    if (ptr == NULL )
+    {
+        JNI_ERROR("ptr is null");
+        return ret;
+    }
+    buf_addr = (*env)->GetDirectBufferAddress(env, ptr);
+    if (!buf_addr ||
+        size * nmemb > (*env)->GetDirectBufferCapacity(env, ptr))
+    {
+        JNI_ERROR("ptr is not a direct buffer of %llu bytes\n",
+                (long long unsigned int ) (size * nmemb));
+        return ret;
+    }
+    JNI_PRINT("size = %llu\nnmemb = %llu\nstream = %llu\n",
+            (long long unsigned int ) size, (long long unsigned int ) nmemb,
+            (long long unsigned int ) stream);
+    ret = (jlong) fread_unlocked(buf_addr, (size_t) size, (size_t) nmemb,
+            (FILE *) stream);
+    if (ret < nmemb)
+    {
+        JNI_PRINT("ret < nmemb, so check feof, then ferror if necessary.");
+    }
+    JNI_PRINT("\tread %llu items totaling %llu bytes\n",
+            (long long unsigned int ) ret,
+            (long long unsigned int ) ret * (long long unsigned int ) size);
+    return ret;
+}
+
 /* freopen */
 JNIEXPORT jlong JNICALL
 Java_org_orangefs_usrint_PVFS2STDIOJNI_freopen(JNIEnv *env, jobject obj,
@@ -771,7 +983,7 @@ JNIEXPORT jlong JNICALL
 Java_org_orangefs_usrint_PVFS2STDIOJNI_fwrite(JNIEnv *env, jobject obj,
         jbyteArray ptr, jlong size, jlong nmemb, jlong stream)
 {
-    /* TODO: rewrite this using NIO ByteBuffer like PVFS2POSIXJNI_write. */
+    /* copies ptr in and out, see fwriteDirect */
     JNI_PFI();
     jlong ret = 0;
     jboolean is_copy;
@@ -800,12 +1012,48 @@ Java_org_orangefs_usrint_PVFS2STDIOJNI_fwrite(JNIEnv *env, jobject obj,
     return ret;
 }
 
+/* fwriteDirect: fwrite from a direct ByteBuffer, without copying it */
+JNIEXPORT jlong JNICALL
+Java_org_orangefs_usrint_PVFS2STDIOJNI_fwriteDirect(JNIEnv *env, jobject obj,
+        jobject ptr, jlong size, jlong nmemb, jlong stream)
+{
+    JNI_PFI();
+    jlong ret = 0;
+    void * buf_addr = 0;
+    if (ptr == NULL )
+    {
+        JNI_ERROR("ptr is null");
+        return ret;
+    }
+    buf_addr = (*env)->GetDirectBufferAddress(env, ptr);
+    if (!buf_addr ||
+        size * nmemb > (*env)->GetDirectBufferCapacity(env, ptr))
+    {
+        JNI_ERROR("ptr is not a direct buffer of %llu bytes\n",
+                (long long unsigned int ) (size * nmemb));
+        return ret;
+    }
+    JNI_PRINT("size = %llu\nnmemb = %llu\nstream = %llu\n",
+            (long long unsigned int ) size, (long long unsigned int ) nmemb,
+            (long long unsigned int ) stream);
+    ret = (jlong) fwrite(buf_addr, (size_t) size, (size_t) nmemb,
+            (FILE *) stream);
+    if (ret < nmemb)
+    {
+        JNI_ERROR("ret < nmemb");
+    }
+    JNI_PRINT("\twrote %llu items totaling %llu bytes\n",
+            (long long unsigned int ) ret,
+            (long long unsigned int ) ret * (long long unsigned int ) size);
+    return ret;
+}
+
 /* fwrite_unlocked */
 JNIEXPORT jlong JNICALL
 Java_org_orangefs_usrint_PVFS2STDIOJNI_fwriteUnlocked(JNIEnv *env, jobject obj,
         jbyteArray ptr, jlong size, jlong nmemb, jlong stream)
 {
-    /* TODO: rewrite this using NIO ByteBuffer like PVFS2POSIXJNI_write. */
+    /* copies ptr in and out, see fwriteDirect */
     JNI_PFI();
     jlong ret = 0;
     jboolean is_copy;
@@ -834,6 +1082,191 @@ Java_org_orangefs_usrint_PVFS2STDIOJNI_fwriteUnlocked(JNIEnv *env, jobject obj,
     return ret;
 }
 
+/* fwriteUnlockedDirect: fwrite from a direct ByteBuffer, without copying it */
+JNIEXPORT jlong JNICALL
+Java_org_orangefs_usrint_PVFS2STDIOJNI_fwriteUnlockedDirect(JNIEnv *env,
+        jobject obj, jobject ptr, jlong size, jlong nmemb, jlong stream)
+{
+    JNI_PFI();
+    jlong ret = 0;
+    void * buf_addr = 0;
+    if (ptr == NULL )
+    {
+        JNI_ERROR("ptr is null");
+        return ret;
+    }
+    buf_addr = (*env)->GetDirectBufferAddress(env, ptr);
+    if (!buf_addr ||
+        size * nmemb > (*env)->GetDirectBufferCapacity(env, ptr))
+    {
+        JNI_ERROR("ptr is not a direct buffer of %llu bytes\n",
+                (long long unsigned int ) (size * nmemb));
+        return ret;
+    }
+    JNI_PRINT("size = %llu\nnmemb = %llu\nstream = %llu\n",
+            (long long unsigned int ) size, (long long unsigned int ) nmemb,
+            (long long unsigned int ) stream);
+    ret = (jlong) fwrite_unlocked(buf_addr, (size_t) size, (size_t) nmemb,
+            (FILE *) stream);
+    if (ret < nmemb)
+    {
+        JNI_ERROR("ret < nmemb");
+    }
+    JNI_PRINT("\twrote %llu items totaling %llu bytes\n",
+            (long long unsigned int ) ret,
+            (long long unsigned int ) ret * (long long unsigned int ) size);
+    return ret;
+}
+
+/* Return, for each blockSize block overlapping the len bytes of path at
+ * start, the comma separated host:port of the servers holding its data,
+ * the server holding most of the block first.  Returns NULL if path is
+ * not an OrangeFS file or its layout cannot be read.
+ */
+JNIEXPORT jobjectArray JNICALL
+Java_org_orangefs_usrint_PVFS2STDIOJNI_getBlockHosts(JNIEnv *env, jobject obj,
+        jstring path, jlong start, jlong len, jlong blockSize)
+{
+    JNI_PFI();
+    jobjectArray ret = NULL;
+    jclass string_cls;
+    jstring entry;
+    PVFS_fs_id fs_id = 0;
+    PINT_dist *dist = NULL;
+    PVFS_handle *handles = NULL;
+    PINT_request_file_data rf;
+    char (*hosts)[PVFS_MAX_SERVER_ADDR_LEN] = NULL;
+    int *host_of = NULL;   /* index in hosts of each datafile's server */
+    PVFS_size *bytes = NULL;
+    int *order = NULL;
+    char *list = NULL;
+    int dfile_count = 0, host_count = 0, ordered;
+    jlong first_block, block_count, block;
+    PVFS_offset block_start;
+    int i, j;
+
+    if (start < 0 || len <= 0 || blockSize <= 0)
+    {
+        return NULL;
+    }
+
+    int cpath_len = (*env)->GetStringLength(env, path);
+    char cpath[cpath_len + 1];
+    (*env)->GetStringUTFRegion(env, path, 0, cpath_len, cpath);
+    JNI_PRINT("path = %s\n", cpath);
+
+    if (get_file_layout(cpath, &fs_id, &dist, &handles, &dfile_count) != 0)
+    {
+        return NULL;
+    }
+
+    hosts = malloc(dfile_count * sizeof(*hosts));
+    host_of = malloc(dfile_count * sizeof(int));
+    bytes = malloc(dfile_count * sizeof(PVFS_size));
+    order = malloc(dfile_count * sizeof(int));
+    list = malloc(dfile_count * PVFS_MAX_SERVER_ADDR_LEN);
+    if (!hosts || !host_of || !bytes || !order || !list)
+    {
+        JNI_ERROR("malloc failed\n");
+        goto out;
+    }
+
+    /* a server may hold more than one datafile of the file */
+    for (i = 0; i < dfile_count; i++)
+    {
+        get_server_host(fs_id, handles[i], hosts[host_count],
+                        PVFS_MAX_SERVER_ADDR_LEN);
+        for (j = 0; j < host_count; j++)
+        {
+            if (strcmp(hosts[j], hosts[host_count]) == 0)
+            {
+                break;
+            }
+        }
+        host_of[i] = j;
+        if (j == host_count)
+        {
+            host_count++;
+        }
+    }
+
+    string_cls = (*env)->FindClass(env, "java/lang/String");
+    if (!string_cls)
+    {
+        JNI_ERROR("FindClass failed on class java/lang/String\n");
+        goto out;
+    }
+    first_block = start / blockSize;
+    block_count = (start + len - 1) / blockSize - first_block + 1;
+    ret = (*env)->NewObjectArray(env, (jsize) block_count, string_cls, NULL);
+    if (!ret)
+    {
+        JNI_ERROR("NewObjectArray returned NULL.\n");
+        goto out;
+    }
+
+    memset(&rf, 0, sizeof(rf));
+    rf.server_ct = dfile_count;
+    rf.dist = dist;
+    for (block = 0; block < block_count; block++)
+    {
+        block_start = (first_block + block) * blockSize;
+        memset(bytes, 0, host_count * sizeof(PVFS_size));
+        for (i = 0; i < dfile_count; i++)
+        {
+            rf.server_nr = i;
+            bytes[host_of[i]] += get_dfile_bytes(dist, &rf, block_start,
+                                                 block_start + blockSize);
+        }
+
+        /* order the servers by their share of the block */
+        ordered = 0;
+        for (j = 0; j < host_count; j++)
+        {
+            if (bytes[j] <= 0 || hosts[j][0] == '\0')
+            {
+                continue;
+            }
+            for (i = ordered; i > 0 && bytes[order[i - 1]] < bytes[j]; i--)
+            {
+                order[i] = order[i - 1];
+            }
+            order[i] = j;
+            ordered++;
+        }
+        list[0] = '\0';
+        for (i = 0; i < ordered; i++)
+        {
+            if (i > 0)
+            {
+                strcat(list, ",");
+            }
+            strcat(list, hosts[order[i]]);
+        }
+
+        entry = (*env)->NewStringUTF(env, list);
+        if (!entry)
+        {
+            JNI_ERROR("NewStringUTF returned Null.\n");
+            ret = NULL;
+            goto out;
+        }
+        (*env)->SetObjectArrayElement(env, ret, (jsize) block, entry);
+        (*env)->DeleteLocalRef(env, entry);
+    }
+    JNI_PRINT("blocks = %lld, servers = %d\n", (long long) block_count,
+              host_count);
+out:
+    free(list);
+    free(order);
+    free(bytes);
+    free(host_of);
+    free(hosts);
+    free(handles);
+    PINT_dist_free(dist);
+    return ret;
+}
+
 /* getc */
 JNIEXPORT jint JNICALL
 Java_org_orangefs_usrint_PVFS2STDIOJNI_getc(JNIEnv *env, jobject obj,
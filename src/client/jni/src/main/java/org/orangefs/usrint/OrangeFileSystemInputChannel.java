@@ -90,6 +90,22 @@ public class OrangeFileSystemInputChannel implements ReadableByteChannel {
         /* Put bytes from channelBuffer into dst */
         while (dst.hasRemaining()) {
             dstRemaining = dst.remaining();
+            /*
+             * A direct dst with room for a whole buffer is read into straight
+             * from OrangeFS, skipping channelBuffer.
+             */
+            if (!channelBuffer.hasRemaining() && dst.isDirect()
+                    && dstRemaining >= bufferSize) {
+                long ret = orange.posix.read(fd, dst.slice(), dstRemaining);
+                if (ret < 0) {
+                    throw new IOException("orange.posix.read failed.");
+                }
+                if (ret == 0) {
+                    break;
+                }
+                dst.position(dst.position() + (int) ret);
+                continue;
+            }
             /* Read from OrangeFS if channelBuffer is empty */
             if (!channelBuffer.hasRemaining()) {
                 /* clear buffer then readOFS */
@@ -114,6 +114,21 @@ public class OrangeFileSystemInputStream extends InputStream implements
         return ret;
     }
 
+    /*
+     * Reads up to buf.remaining() bytes into buf. A direct buf of at least a
+     * buffer's worth is filled from OrangeFS without a copy.
+     */
+    public synchronized int read(ByteBuffer buf)
+            throws IOException {
+        if (inChannel == null) {
+            throw new IOException("InputChannel is null.");
+        }
+        if (!buf.hasRemaining()) {
+            return 0;
+        }
+        return inChannel.read(buf);
+    }
+
     @Override
     public void reset()
             throws IOException {
@@ -141,6 +141,19 @@ public class OrangeFileSystemOutputChannel implements WritableByteChannel {
         while (src.hasRemaining()) {
             srcRemaining = src.remaining();
             srcPosition = src.position();
+            /*
+             * A direct src of at least a whole buffer is written straight to
+             * OrangeFS once the buffered bytes before it are flushed.
+             */
+            if (src.isDirect() && srcRemaining >= channelBuffer.capacity()) {
+                flush();
+                long ret = orange.posix.write(fd, src.slice(), srcRemaining);
+                if (ret <= 0) {
+                    throw new IOException("write error");
+                }
+                src.position(srcPosition + (int) ret);
+                continue;
+            }
             // Write to OrangeFS if channelBuffer is full
             if (!channelBuffer.hasRemaining()) {
                 flush();
@@ -140,6 +140,18 @@ public class OrangeFileSystemOutputStream extends OutputStream {
         outChannel.write(ByteBuffer.wrap(b, off, len));
     }
 
+    /*
+     * Writes the remaining bytes of src to this output stream. A direct src
+     * of at least a buffer's worth goes to OrangeFS without being copied.
+     */
+    public void write(ByteBuffer src)
+            throws IOException {
+        if (outChannel == null) {
+            throw new IOException("outChannel is null");
+        }
+        outChannel.write(src);
+    }
+
     /*
      * Writes b.length bytes from the specified byte array to this output
      * stream. The general contract for write(b) is that it should have exactly
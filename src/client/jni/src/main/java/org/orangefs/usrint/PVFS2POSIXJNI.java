@@ -148,9 +148,9 @@ public class PVFS2POSIXJNI {
 
     public native int openat(int dirfd, String path, long flags, long mode);
 
-    public native long pread(int fd, byte[] buf, long count, long offset);
+    public native long pread(int fd, ByteBuffer buf, long count, long offset);
 
-    public native long pwrite(int fd, byte[] buf, long count, long offset);
+    public native long pwrite(int fd, ByteBuffer buf, long count, long offset);
 
     public native long read(int fd, ByteBuffer buf, long count);
 
@@ -158,6 +158,12 @@ public class PVFS2POSIXJNI {
 
     public native long readlinkat(int fd, String path, String buf, long bufsiz);
 
+    /*
+     * Vectored I/O on direct ByteBuffers: iovlen[i] bytes from the start of
+     * iov[i].
+     */
+    public native long readv(int fd, ByteBuffer[] iov, long[] iovlen);
+
     public native int removexattr(String path, String name);
 
     public native int rename(String oldpath, String newpath);
@@ -178,9 +184,6 @@ public class PVFS2POSIXJNI {
 
     public native void sync();
 
-    /* TODO? */
-    // public native long readv(int fd, Iovec [] vector, int count);
-    // public native long writev(int fd, Iovec [] vector, int count);
     /* Generic Object Dump to String */
     @Override
     public String toString() {
@@ -219,6 +222,8 @@ public class PVFS2POSIXJNI {
 
     public native long write(int fd, ByteBuffer buf, long count);
 
+    public native long writev(int fd, ByteBuffer[] iov, long[] iovlen);
+
     // public native int getcwd(String path, long mode);
 
 }
@@ -6,6 +6,7 @@
 package org.orangefs.usrint;
 
 import java.lang.reflect.Field;
+import java.nio.ByteBuffer;
 import java.util.ArrayList;
 
 public class PVFS2STDIOJNI {
@@ -101,9 +102,16 @@ public class PVFS2STDIOJNI {
 
     public native long fread(byte[] ptr, long size, long nmemb, long stream);
 
+    /* Reads into the start of a direct ByteBuffer without copying it. */
+    public native long freadDirect(ByteBuffer ptr, long size, long nmemb,
+            long stream);
+
     public native long freadUnlocked(byte[] ptr, long size, long nmemb,
             long stream);
 
+    public native long freadUnlockedDirect(ByteBuffer ptr, long size,
+            long nmemb, long stream);
+
     public native long freopen(String path, String mode, long stream);
 
     public native int fseek(long stream, long offset, long whence);
@@ -118,9 +126,24 @@ public class PVFS2STDIOJNI {
 
     public native long fwrite(byte[] ptr, long size, long nmemb, long stream);
 
+    /* Writes from the start of a direct ByteBuffer without copying it. */
+    public native long fwriteDirect(ByteBuffer ptr, long size, long nmemb,
+            long stream);
+
     public native long fwriteUnlocked(byte[] ptr, long size, long nmemb,
             long stream);
 
+    public native long fwriteUnlockedDirect(ByteBuffer ptr, long size,
+            long nmemb, long stream);
+
+    /*
+     * Returns the comma separated host:port of the servers holding each
+     * blockSize block of path overlapping [start, start + len), or null if
+     * path is not an OrangeFS file.
+     */
+    public native String[] getBlockHosts(String path, long start, long len,
+            long blockSize);
+
     public native int getc(long stream);
 
     public native int getchar();
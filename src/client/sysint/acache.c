@@ -56,6 +56,9 @@ struct acache_payload
 };
 
 static struct PINT_tcache* acache = NULL;
+/* serializes setup and option changes; entries are protected by the
+ * lock of the tcache shard that holds their key
+ */
 static gen_mutex_t acache_mutex = GEN_MUTEX_INITIALIZER;
 static struct PINT_perf_counter* acache_pc = NULL;
 
@@ -255,6 +258,7 @@ int PINT_acache_get_cached_entry(
     struct acache_payload* tmp_payload;
     int ret = -1;
     struct timeval current_time = { 0, 0};
+    struct PINT_tcache_shard* shard;
 
     if(!attr || !attr_status ||
        !size || !size_status)
@@ -276,7 +280,7 @@ int PINT_acache_get_cached_entry(
     *size_status = -PVFS_ETIME;
     attr->mask = 0;
 
-    gen_mutex_lock(&acache_mutex);
+    shard = PINT_tcache_lock_key(acache, &refn);
 
     /* lookup */
     ret = PINT_tcache_lookup(acache, &refn, &tmp_entry, attr_status);
@@ -384,7 +388,7 @@ int PINT_acache_get_cached_entry(
     ret = 0;
 
 done:
-    gen_mutex_unlock(&acache_mutex);
+    PINT_tcache_unlock_shard(shard);
     return(ret);
 }
 
@@ -397,13 +401,14 @@ void PINT_acache_invalidate(
     int ret = -1;
     struct PINT_tcache_entry* tmp_entry;
     int tmp_status;
+    struct PINT_tcache_shard* shard;
 
     gossip_debug(GOSSIP_ACACHE_DEBUG,
                  "%s: H=%llu\n",
                  __func__,
                  llu(refn.handle));
 
-    gen_mutex_lock(&acache_mutex);
+    shard = PINT_tcache_lock_key(acache, &refn);
 
     ret = PINT_tcache_lookup(acache, 
                              &refn,
@@ -424,7 +429,7 @@ void PINT_acache_invalidate(
                     acache->num_entries,
                     PINT_PERF_SET);
 
-    gen_mutex_unlock(&acache_mutex);
+    PINT_tcache_unlock_shard(shard);
     return;
 }
 
@@ -439,8 +444,9 @@ void PINT_acache_invalidate_size(
     struct PINT_tcache_entry* tmp_entry;
     struct acache_payload* tmp_payload;
     int tmp_status;
+    struct PINT_tcache_shard* shard;
 
-    gen_mutex_lock(&acache_mutex);
+    shard = PINT_tcache_lock_key(acache, &refn);
 
     gossip_debug(GOSSIP_ACACHE_DEBUG,
                  "%s: H=%llu\n",
@@ -463,7 +469,7 @@ void PINT_acache_invalidate_size(
                         PINT_PERF_ADD);
     }
 
-    gen_mutex_unlock(&acache_mutex);
+    PINT_tcache_unlock_shard(shard);
     return;
 }
 
@@ -481,6 +487,7 @@ int PINT_acache_update(
     PVFS_size* size)        /**< logical file size (NULL if not available) */
 {
     struct acache_payload* tmp_payload = NULL;
+    struct PINT_tcache_shard* shard;
     uint32_t save_mask;
     int ret = -1;
 
@@ -569,14 +576,14 @@ int PINT_acache_update(
                 __func__,
                  tmp_payload->attr.mask);
 
-    gen_mutex_lock(&acache_mutex);
+    shard = PINT_tcache_lock_key(acache, &refn);
 
     if(tmp_payload)
     {
         load_payload(acache, refn, tmp_payload);
     }
 
-    gen_mutex_unlock(&acache_mutex);
+    PINT_tcache_unlock_shard(shard);
     return(0);
 }
 
@@ -622,6 +629,22 @@ int PINT_acache_amend(
 }
 #endif
 
+/**
+ * Formats the per shard entry counts and hit rates of the acache.  The
+ * caller must free the returned string.
+ * \return string on success, NULL on failure
+ */
+char* PINT_acache_generate_shard_text(int max_size)
+{
+    char* tmp_str;
+
+    gen_mutex_lock(&acache_mutex);
+    tmp_str = PINT_tcache_generate_shard_text(acache, max_size);
+    gen_mutex_unlock(&acache_mutex);
+
+    return(tmp_str);
+}
+
 /**
  * Returns the perf counter associated with this acache instance.
  */
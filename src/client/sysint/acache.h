@@ -139,6 +139,8 @@ void PINT_acache_invalidate_size(
 
 struct PINT_perf_counter* PINT_acache_get_pc(void);
 
+char* PINT_acache_generate_shard_text(int max_size);
+
 #endif /* __ACACHE_H */
 
 /* @} */
@@ -415,6 +415,8 @@ struct PINT_state_machine_s *client_op_state_get_machine(int op)
         return &pvfs2_client_job_timer_sm;
     case PVFS_CLIENT_PERF_COUNT_TIMER :
         return &pvfs2_client_perf_count_timer_sm;
+    case PVFS_CLIENT_PLACEMENT_TIMER :
+        return &pvfs2_client_placement_timer_sm;
     case PVFS_DEV_UNEXPECTED :
         return &pvfs2_sysdev_unexp_sm;
     default:
@@ -1239,6 +1241,7 @@ const char *PINT_client_get_name_str(int op_type)
         { PVFS_SYS_LISTEATTR, "PVFS_SYS_LISTEATTR" },
         { PVFS_SERVER_GET_CONFIG, "PVFS_SERVER_GET_CONFIG" },
         { PVFS_CLIENT_JOB_TIMER, "PVFS_CLIENT_JOB_TIMER" },
+        { PVFS_CLIENT_PLACEMENT_TIMER, "PVFS_CLIENT_PLACEMENT_TIMER" },
         { PVFS_DEV_UNEXPECTED, "PVFS_DEV_UNEXPECTED" },
         { PVFS_SYS_FS_ADD, "PVFS_SYS_FS_ADD" },
         { PVFS_SYS_STATFS, "PVFS_SYS_STATFS" },
@@ -1291,6 +1294,11 @@ int PVFS_sys_wait(PVFS_sys_op_id op_id,
     return PINT_client_wait_internal(op_id, in_op_str, out_error, "sys");
 }
 
+void PVFS_sys_release(PVFS_sys_op_id op_id)
+{
+    PINT_sys_release(op_id);
+}
+
 int PVFS_mgmt_testsome(PVFS_mgmt_op_id *op_id_array, /* out */
                        int *op_count,                /* in/out */
                        void **user_ptr_array,        /* out if present */
@@ -205,6 +205,9 @@ struct PINT_client_create_sm
     PVFS_handle handles[2];
 
     struct PVFS_servresp_create server_resp; /* data returned from the server request */
+
+    int compound;               /* entry added along with the create */
+    PVFS_error dirent_status;   /* result of adding it */
 };
 
 struct PINT_client_mkdir_sm
@@ -361,6 +364,20 @@ struct PINT_client_flush_sm
 #endif
 };
 
+/* a dirdata response kept until all of a round are in, since a retried
+ * msgpair completes after the ones set up behind it
+ */
+struct PINT_client_readdir_reply
+{
+    int received;
+    int dirent_count;
+    PVFS_dirent *dirent_array;
+    PVFS_object_attr *attr_array;   /* readdirplus only */
+    char *attr_valid;
+    PVFS_ds_position token;
+    uint64_t directory_version;
+};
+
 struct PINT_client_readdir_sm
 {
     PVFS_ds_position pos_token;         /* in/out parameter */
@@ -369,6 +386,10 @@ struct PINT_client_readdir_sm
     PVFS_sysresp_readdir *readdir_resp; /* in/out parameter*/
 
     int num_dirdata_needed; /* tmp parameter */
+    int *dirdata_index_array;   /* dirdata read by each msgpair */
+    int *dirent_limit_array;    /* entries asked of each msgpair */
+    struct PINT_client_readdir_reply *reply_array; /* what each returned */
+    int stopped;                /* position settled inside a dirdata */
 };
 
 struct handle_to_index {
@@ -606,6 +627,13 @@ struct PINT_client_job_timer_sm
     job_id_t job_id;
 };
 
+struct PINT_client_placement_timer_sm
+{
+    job_id_t job_id;
+    PVFS_fs_id fs_id;   /* file system being refreshed */
+    int busy;           /* requests to servers are outstanding */
+};
+
 struct PINT_sysdev_unexp_sm
 {
     struct PINT_dev_unexp_info *info;
@@ -651,6 +679,12 @@ typedef struct
     PVFS_ds_position pos_token;     /* input/output parameter */
     int32_t      dirent_limit;      /* input parameter */
     int32_t      dirdata_index;      /* input parameter */
+    /* set by readdirplus to have the servers return the attributes of
+     * the entries they hold along with the entries
+     */
+    uint32_t         attrmask;
+    PVFS_object_attr *attr_array;   /* dirent_limit entries */
+    char             *attr_valid;   /* non-zero where attr_array is set */
 } PINT_sm_readdir_state;
 
 typedef struct PINT_client_sm
@@ -725,6 +759,7 @@ typedef struct PINT_client_sm
         struct PINT_client_perf_count_timer_sm perf_count_timer;
         struct PINT_sysdev_unexp_sm sysdev_unexp;
         struct PINT_client_job_timer_sm job_timer;
+        struct PINT_client_placement_timer_sm placement_timer;
         struct PINT_client_mgmt_get_uid_list_sm get_uid_list;
 #ifdef ENABLE_SECURITY_CERT
         struct PINT_client_mgmt_get_user_cert_sm mgmt_get_user_cert;
@@ -831,6 +866,7 @@ enum
     PVFS_SERVER_GET_CONFIG         = 200,
     PVFS_CLIENT_JOB_TIMER          = 300,
     PVFS_CLIENT_PERF_COUNT_TIMER   = 301,
+    PVFS_CLIENT_PLACEMENT_TIMER    = 302,
     PVFS_DEV_UNEXPECTED            = 400
 };
 
@@ -920,6 +956,7 @@ extern struct PINT_state_machine_s pvfs2_client_truncate_sm;
 extern struct PINT_state_machine_s pvfs2_sysdev_unexp_sm;
 extern struct PINT_state_machine_s pvfs2_client_job_timer_sm;
 extern struct PINT_state_machine_s pvfs2_client_perf_count_timer_sm;
+extern struct PINT_state_machine_s pvfs2_client_placement_timer_sm;
 extern struct PINT_state_machine_s pvfs2_server_get_config_sm;
 extern struct PINT_state_machine_s pvfs2_server_fetch_config_sm;
 extern struct PINT_state_machine_s pvfs2_client_mgmt_setparam_list_sm;
@@ -129,6 +129,7 @@ int PVFS_sys_finalize()
     gossip_disable();
 
     PINT_client_state_machine_release(g_smcb);
+    PINT_client_placement_timer_stop();
 
 #ifdef WIN32
     pvfs_sys_init_flag = 0;
@@ -342,6 +342,16 @@ int PVFS_sys_initialize(uint64_t default_debug_mask)
     /* keep track of this pointer for freeing on finalize */
     g_smcb = smcb;
 
+    /* start the timer that refreshes server statistics for file
+     * systems using the weighted placement policy
+     */
+    ret = PINT_client_placement_timer_start();
+    if (ret < 0)
+    {
+        gossip_lerr("Error posting placement timer.\n");
+        goto error_exit;
+    }
+
     ret = 0;
     goto local_exit;
 
@@ -61,6 +61,9 @@ struct ncache_key
 };
   
 static struct PINT_tcache* ncache = NULL;
+/* serializes setup and option changes; entries are protected by the
+ * lock of the tcache shard that holds their key
+ */
 static gen_mutex_t ncache_mutex = GEN_MUTEX_INITIALIZER;
 static struct PINT_perf_counter* ncache_pc = NULL;
 
@@ -227,6 +230,7 @@ int PINT_ncache_get_cached_entry(
     struct PINT_tcache_entry* tmp_entry;
     struct ncache_payload* tmp_payload;
     struct ncache_key entry_key;
+    struct PINT_tcache_shard* shard;
     int status;
 
     gossip_debug(GOSSIP_NCACHE_DEBUG, 
@@ -236,7 +240,7 @@ int PINT_ncache_get_cached_entry(
     entry_key.parent_ref.handle = parent_ref->handle;
     entry_key.parent_ref.fs_id = parent_ref->fs_id;
 
-    gen_mutex_lock(&ncache_mutex);
+    shard = PINT_tcache_lock_key(ncache, &entry_key);
 
     /* lookup entry */
     ret = PINT_tcache_lookup(ncache, (void *) &entry_key, &tmp_entry, &status);
@@ -248,7 +252,7 @@ int PINT_ncache_get_cached_entry(
                         PERF_NCACHE_MISSES,
                         1,
                         PINT_PERF_ADD);
-        gen_mutex_unlock(&ncache_mutex);
+        PINT_tcache_unlock_shard(shard);
         /* Return -PVFS_ENOENT if the entry has expired */
         if(status != 0)
         {   
@@ -273,11 +277,11 @@ int PINT_ncache_get_cached_entry(
     {
         /* return success if we got _anything_ out of the cache */
         PINT_perf_count(ncache_pc, PERF_NCACHE_HITS, 1, PINT_PERF_ADD);
-        gen_mutex_unlock(&ncache_mutex);
+        PINT_tcache_unlock_shard(shard);
         return(0);
     }
 
-    gen_mutex_unlock(&ncache_mutex);
+    PINT_tcache_unlock_shard(shard);
   
     PINT_perf_count(ncache_pc, PERF_NCACHE_MISSES, 1, PINT_PERF_ADD);
     return(-PVFS_ETIME);
@@ -293,17 +297,18 @@ void PINT_ncache_invalidate(
     int ret = -1;
     struct PINT_tcache_entry* tmp_entry;
     struct ncache_key entry_key;
+    struct PINT_tcache_shard* shard;
     int tmp_status;
   
     gossip_debug(GOSSIP_NCACHE_DEBUG, "ncache: invalidate(): entry=%s\n",
                  entry);
   
-    gen_mutex_lock(&ncache_mutex);
-  
     entry_key.entry_name = entry;
     entry_key.parent_ref.handle = parent_ref->handle;
     entry_key.parent_ref.fs_id = parent_ref->fs_id;
 
+    shard = PINT_tcache_lock_key(ncache, &entry_key);
+
     /* find out if the entry is in the cache */
     ret = PINT_tcache_lookup(ncache, 
                              &entry_key,
@@ -323,7 +328,7 @@ void PINT_ncache_invalidate(
                     ncache->num_entries,
                     PINT_PERF_SET);
 
-    gen_mutex_unlock(&ncache_mutex);
+    PINT_tcache_unlock_shard(shard);
     return;
 }
   
@@ -345,6 +350,7 @@ int PINT_ncache_update(
     struct PINT_tcache_entry* tmp_entry;
     struct ncache_payload* tmp_payload;
     struct ncache_key entry_key;
+    struct PINT_tcache_shard* shard;
     int status;
     int purged;
     unsigned int enabled;
@@ -385,12 +391,12 @@ int PINT_ncache_update(
     }
     memcpy(tmp_payload->entry_name, entry, strlen(entry) + 1);
 
-    gen_mutex_lock(&ncache_mutex);
-
     entry_key.entry_name = entry;
     entry_key.parent_ref.handle = parent_ref->handle;
     entry_key.parent_ref.fs_id = parent_ref->fs_id;
 
+    shard = PINT_tcache_lock_key(ncache, &entry_key);
+
     /* find out if the entry is already in the cache */
     ret = PINT_tcache_lookup(ncache, 
                              &entry_key,
@@ -444,7 +450,7 @@ int PINT_ncache_update(
                     ncache->num_entries,
                     PINT_PERF_SET);
 
-    gen_mutex_unlock(&ncache_mutex);
+    PINT_tcache_unlock_shard(shard);
   
     /* cleanup if we did not succeed for some reason */
     if(ret < 0)
@@ -456,6 +462,22 @@ int PINT_ncache_update(
     return(ret);
 }
 
+/**
+ * Formats the per shard entry counts and hit rates of the ncache.  The
+ * caller must free the returned string.
+ * \return string on success, NULL on failure
+ */
+char* PINT_ncache_generate_shard_text(int max_size)
+{
+    char* tmp_str;
+
+    gen_mutex_lock(&ncache_mutex);
+    tmp_str = PINT_tcache_generate_shard_text(ncache, max_size);
+    gen_mutex_unlock(&ncache_mutex);
+
+    return(tmp_str);
+}
+
 /**
  * Returns the perf counter associated with this ncache instance.
  */
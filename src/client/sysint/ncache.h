@@ -116,6 +116,8 @@ void PINT_ncache_invalidate(
 
 struct PINT_perf_counter* PINT_ncache_get_pc(void);
 
+char* PINT_ncache_generate_shard_text(int max_size);
+
 #endif /* __NCACHE_H */
 
 /* @} */
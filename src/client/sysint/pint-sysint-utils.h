@@ -55,6 +55,10 @@ int PINT_client_security_finalize(void);
 int client_perf_start_rollover(struct PINT_perf_counter *pc,
                                struct PINT_perf_counter *tpc);
 
+/* client only functions to run the weighted placement statistics timer */
+int PINT_client_placement_timer_start(void);
+void PINT_client_placement_timer_stop(void);
+
 /*
  * Local variables:
  *  c-indent-level: 4
@@ -32,6 +32,8 @@
 #include <pvfs2-util.h>
 #include <pvfs2-types.h>
 
+#include "../orangefs_stream.h"
+
 /* getpwnam needs these... */
 #include <sys/types.h>
 #include <pwd.h>
@@ -58,6 +60,10 @@ char pass[100];
                  below and change it too...
  */
 #define READBUFSIZE 1048576
+/* READAHEAD = default number of READBUFSIZE reads kept in flight for
+               GET or COPY.
+ */
+#define READAHEAD ORANGEFS_STREAM_DEPTH
 #define KEYBUFSIZ 256
 /* these are reserved property names, code in dav_orangefs_propdb_store
    won't let you set them with PROPPATCH. */
@@ -84,6 +90,7 @@ typedef struct {
 typedef struct dav_orangefs_dir_conf {
   int putBufSize;
   int readBufSize;
+  int readAhead;
 } dav_orangefs_dir_conf;
 
 /* list of properties associated with a resource */
@@ -131,6 +138,10 @@ struct dav_resource_private {
   PVFS_object_ref *parent_ref;
   PVFS_object_ref *recurse_ref;
   PVFS_credential *credential;
+  /* byte range of a GET, see dav_orangefs_set_headers */
+  int ranged;
+  PVFS_offset rangeStart;
+  PVFS_size rangeLength;
 };
 
 /* this repository's version of the dav_stream opaque handle... */
@@ -839,7 +850,31 @@ static dav_error *dav_orangefs_set_headers(request_rec *r,
      implemented dav_orangefs_deliver, stuff about content length
      and whether to use Chunked Encoding will work out without us
      having to handle it...
+
+     ...except for a GET of a single byte range of a file, which
+     dav_orangefs_deliver reads on its own instead of reading the whole
+     file for Apache's byterange filter to throw most of it away.
   */
+  if ((r->method_number == M_GET) &&
+      (resource->info->orangefs_finfo.filetype != APR_DIR)) {
+    switch (orangefs_stream_range(r,resource->info->orangefs_finfo.size,
+                                  &(resource->info->rangeStart),
+                                  &(resource->info->rangeLength))) {
+      case 1:
+        resource->info->ranged = 1;
+        break;
+      case -1:
+#if AP_SERVER_MAJORVERSION_NUMBER == 2 && AP_SERVER_MINORVERSION_NUMBER <= 2
+        return dav_new_error(resource->pool,HTTP_RANGE_NOT_SATISFIABLE,0,
+          "dav_orangefs_set_headers: range not satisfiable");
+#else
+        return dav_new_error(resource->pool,HTTP_RANGE_NOT_SATISFIABLE,0,0,
+          "dav_orangefs_set_headers: range not satisfiable");
+#endif
+      default:
+        break;
+    }
+  }
 
   /* What is the best way to decide how to set the content_type header? */
   if ((resource->info->orangefs_finfo.filetype == APR_DIR) ||
@@ -861,11 +896,7 @@ static dav_error *dav_orangefs_deliver(const dav_resource *resource,
                                        ap_filter_t *output)
 {
   int rc=1;
-  PVFS_Request mem_req;
-  int64_t offset=0;
-  PVFS_sysresp_io resp_io;
-  void *buffer;
-  int bytesRead;
+  orangefs_stream stream;
   int pvfs_dirent_incount;
   PVFS_ds_position token;
   PVFS_sysresp_readdir resp_readdir;
@@ -1059,45 +1090,32 @@ static dav_error *dav_orangefs_deliver(const dav_resource *resource,
     dconf = ap_get_module_config(resource->info->r->per_dir_config, 
                                  &dav_orangefs_module);
 
-    buffer = apr_pcalloc(resource->pool,dconf->readBufSize);
-    bytesRead = 0;
+    /* keep dconf->readAhead reads in flight while the output filters
+       send what has already been read...
+     */
+    if (resource->info->ranged) {
+      orangefs_stream_init(&stream,resource->info->ref,
+                           resource->info->credential,PVFS_HINT_NULL,
+                           resource->info->rangeStart,
+                           resource->info->rangeLength,
+                           dconf->readBufSize,dconf->readAhead);
+    } else {
+      orangefs_stream_init(&stream,resource->info->ref,
+                           resource->info->credential,PVFS_HINT_NULL,
+                           0,-1,dconf->readBufSize,dconf->readAhead);
+    }
 
-    /* priming read... */
-    if ((bytesRead = 
-           orangeRead(resource->info->ref,resource->info->credential,
-                      (char *)resource->uri,
-                      buffer,dconf->readBufSize,offset)) < 0 ) 
+    if ((rc = orangefs_stream_deliver(&stream,resource->info->r,output)) < 0)
     {
+      ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL,
+        "dav_orangefs_deliver: read failed on :%s:, rc:%d:",
+        resource->uri,rc);
 #if AP_SERVER_MAJORVERSION_NUMBER == 2 && AP_SERVER_MINORVERSION_NUMBER <= 2
       return dav_new_error(resource->pool,HTTP_NOT_FOUND,0,NULL);
 #else
       return dav_new_error(resource->pool,HTTP_NOT_FOUND,0,0,NULL);
 #endif
     }
-  
-    /* "while bytesread > 0" causes orangeRead to be visited 
-       one extra time... how can we tell we're done when we get
-       the last few byte of a file without making that one last
-       visit to the empty well? Is it safe to say that if
-       we don't fill up the buffer, then that was it?
-     */
-    while (bytesRead > 0) {
-      offset+=bytesRead;
-      ap_rwrite((const void *) buffer,bytesRead,resource->info->r); 
-
-      memset(buffer,0,dconf->readBufSize);
-      if ((bytesRead = 
-             orangeRead(resource->info->ref,resource->info->credential,
-                        (char *)resource->uri,
-                        buffer,dconf->readBufSize,offset)) < 0 ) 
-      {
-#if AP_SERVER_MAJORVERSION_NUMBER == 2 && AP_SERVER_MINORVERSION_NUMBER <= 2
-        return dav_new_error(resource->pool,HTTP_NOT_FOUND,0,NULL);
-#else
-        return dav_new_error(resource->pool,HTTP_NOT_FOUND,0,0,NULL);
-#endif
-      }
-    }
 
   }
 
@@ -2680,6 +2698,10 @@ static const command_rec dav_orangefs_cmds[] =
                  ACCESS_CONF, "PVFS_Request_contiguous Buffer size argument "
                  "when setting up PVFS_sys_read for GET or COPY "
                  "(default: 1048576)"),
+  AP_INIT_TAKE1("ReadAhead", ap_set_int_slot,
+                (void *)APR_OFFSETOF(dav_orangefs_dir_conf, readAhead),
+                 ACCESS_CONF, "number of ReadBufSize reads kept in flight "
+                 "for GET or COPY (default: 4)"),
   AP_INIT_TAKE1("DAVpvfsCertPath", set_certpath, 0, ACCESS_CONF,
                 "The path to read user keys and certificates from."),
 
@@ -2698,6 +2720,7 @@ static void *dav_orangefs_create_dir_config(apr_pool_t *p, char *dir)
   conf = (dav_orangefs_dir_conf *)apr_pcalloc(p,sizeof(*conf));
   conf->putBufSize = PUTBUFSIZE;
   conf->readBufSize = READBUFSIZE;
+  conf->readAhead = READAHEAD;
   return conf;
 }
 
@@ -2725,6 +2748,10 @@ static void *dav_orangefs_merge_dir_config(apr_pool_t *p,
                       (parent->readBufSize) :
                       (child->readBufSize); 
 
+  conf->readAhead = (parent->readAhead == child->readAhead) ?
+                    (parent->readAhead) :
+                    (child->readAhead); 
+
   return conf;
 }   
 
@@ -4864,9 +4891,10 @@ int orangeMkdir(dav_resource *resource) {
 /* copy an orangefs file from src to dst... */
 static dav_error *orangeCopy(const dav_resource *src, dav_resource *dst) {
   int rc;
-  int bytesRead;
-  void *buffer;
+  apr_size_t bytesRead;
+  char *buffer;
   int64_t offset=0;
+  orangefs_stream stream;
   PVFS_sysresp_create *resp_create;
   PVFS_object_ref *targetRef;
   dav_orangefs_dir_conf *dconf;
@@ -4928,45 +4956,37 @@ static dav_error *orangeCopy(const dav_resource *src, dav_resource *dst) {
   targetRef->handle = resp_create->ref.handle;
   targetRef->fs_id = resp_create->ref.fs_id;
 
-  buffer = apr_pcalloc(src->pool,dconf->readBufSize);
-  bytesRead = 0;
+  /* read ahead of the writes to the copy... */
+  orangefs_stream_init(&stream,src->info->ref,src->info->credential,
+                       PVFS_HINT_NULL,0,-1,dconf->readBufSize,
+                       dconf->readAhead);
 
-  /* priming read... */
-  if ((bytesRead = orangeRead(src->info->ref,src->info->credential,
-                              (char *)src->uri,
-                              buffer,dconf->readBufSize,offset)) < 0 )
-  {
-#if AP_SERVER_MAJORVERSION_NUMBER == 2 && AP_SERVER_MINORVERSION_NUMBER <= 2
-    return dav_new_error(src->pool,HTTP_INTERNAL_SERVER_ERROR,0,NULL);
-#else
-    return dav_new_error(src->pool,HTTP_INTERNAL_SERVER_ERROR,0,0,NULL);
-#endif
-  }
-
-  while (bytesRead > 0) {
-    if (orangeWrite(buffer,bytesRead,dst->pool,targetRef,
-                    offset,dst->info->credential) < 0)
-    {
+  do {
+    if ((rc = orangefs_stream_next(&stream,&buffer,&bytesRead)) < 0) {
+      orangefs_stream_close(&stream);
 #if AP_SERVER_MAJORVERSION_NUMBER == 2 && AP_SERVER_MINORVERSION_NUMBER <= 2
       return dav_new_error(src->pool,HTTP_INTERNAL_SERVER_ERROR,0,NULL);
 #else
       return dav_new_error(src->pool,HTTP_INTERNAL_SERVER_ERROR,0,0,NULL);
 #endif
     }
-    offset+=bytesRead;
-
-    memset(buffer,0,dconf->readBufSize);
-    if ((bytesRead = orangeRead(src->info->ref,src->info->credential,
-                                (char *)src->uri,
-                                buffer,dconf->readBufSize,offset)) < 0 )
-    {
+    if (bytesRead > 0) {
+      rc = orangeWrite(buffer,bytesRead,dst->pool,targetRef,
+                       offset,dst->info->credential);
+      free(buffer);
+      if (rc < 0) {
+        orangefs_stream_close(&stream);
 #if AP_SERVER_MAJORVERSION_NUMBER == 2 && AP_SERVER_MINORVERSION_NUMBER <= 2
-      return dav_new_error(src->pool,HTTP_INTERNAL_SERVER_ERROR,0,NULL);
+        return dav_new_error(src->pool,HTTP_INTERNAL_SERVER_ERROR,0,NULL);
 #else
-      return dav_new_error(src->pool,HTTP_INTERNAL_SERVER_ERROR,0,0,NULL);
+        return dav_new_error(src->pool,HTTP_INTERNAL_SERVER_ERROR,0,0,NULL);
 #endif
+      }
+      offset+=bytesRead;
     }
-  }
+  } while (bytesRead > 0);
+
+  orangefs_stream_close(&stream);
 
   /* copy over the properties... */
   orangePropCopy(src,dst);
@@ -44,6 +44,7 @@
 #include <pvfs2-request.h>
 
 #include <apr.h>
+#include <apr_general.h>
 #include <apr_optional.h>
 #include <apr_strings.h>
 #include <apr_md5.h>
@@ -61,6 +62,8 @@
 #include <http_main.h>
 #include <http_request.h>
 
+#include "../orangefs_stream.h"
+
 
 #include <libxml/xmlreader.h>
 #include <libxml/catalog.h>
@@ -101,6 +104,8 @@ static const char* orangefs_s3_setDisplayName(cmd_parms *cmd, void *cfg,
                                               const char *displayName);
 static const char* orangefs_s3_addAWSAccount(cmd_parms *cmd, void *cfg,
 			                     const char *args);
+static const char* orangefs_s3_setReadAhead(cmd_parms *cmd, void *cfg, 
+                                            const char *readAhead);
 static void orangefs_s3_register_hooks(apr_pool_t *pool);
 
 
@@ -113,6 +118,7 @@ typedef struct {
   char *displayName;
   char pvfs_path[PVFS_NAME_MAX];
   apr_hash_t *awsAccounts;
+  int readAhead;
   int fsid;
   int quit;
 } orangefs_s3_config;
@@ -130,6 +136,9 @@ static const command_rec orangefs_s3_cmds[] = {
                 NULL, OR_ALL, "root display name for s3"),
   AP_INIT_RAW_ARGS("AWSAccount", orangefs_s3_addAWSAccount,
                    NULL, OR_ALL, "Add AWS Account"),
+  AP_INIT_TAKE1("ReadAhead", orangefs_s3_setReadAhead,
+                NULL, RSRC_CONF, "Number of reads kept in flight for "
+                "GET (default: 4)"),
   AP_INIT_NO_ARGS("TraceOn", orangefs_s3_setTraceOn,
                   NULL, ACCESS_CONF, "OrangeFS Trace On"),
   {NULL}
@@ -198,6 +207,42 @@ typedef struct {
   char *delimiter;
 } orangefs_s3_s3_list;
 
+/*
+  struct orangefs_s3_write_slot
+
+    One buffer of PUT/POST data and the write posted for it.
+ */
+typedef struct {
+  char *buf;
+  apr_size_t len;
+  apr_size_t limit;
+  PVFS_offset offset;
+  PVFS_Request mem_req;
+  PVFS_sysresp_io resp;
+  PVFS_sys_op_id op_id;
+  int busy;
+} orangefs_s3_write_slot;
+
+#define S3_WRITE_DEPTH 4
+#define S3_WRITE_BUFFER_SIZE (4 * 1024 * 1024)
+#define S3_READ_BUFFER_SIZE (4 * 1024 * 1024)
+
+/*
+  struct orangefs_s3_writer
+
+    Keeps several writes of PUT/POST data to one object in flight.
+ */
+typedef struct {
+  orangefs_s3_request *req;
+  PVFS_object_ref ref;
+  PVFS_hint hints;
+  apr_size_t buffer_size;
+  orangefs_s3_write_slot slots[S3_WRITE_DEPTH];
+  orangefs_s3_write_slot *cur;
+  PVFS_offset offset;
+  int error;
+} orangefs_s3_writer;
+
 
 /* some defines and constants */
 const char *EXT_ATTR_S3_CREATE_DATE        = "user.s3.create-date";
@@ -205,6 +250,13 @@ const char *EXT_ATTR_S3_OWNER_ID           = "user.s3.owner.id";
 const char *EXT_ATTR_S3_OWNER_DISPLAY_NAME = "user.s3.owner.display-name";
 const char *EXT_ATTR_S3_ENTITY_TAG         = "user.s3.entity-tag";
 const char *EXT_ATTR_S3_SIZE               = "user.s3.size";
+const char *EXT_ATTR_S3_UPLOAD_KEY         = "user.s3.upload.key";
+const char *EXT_ATTR_S3_UPLOAD_STRIDE      = "user.s3.upload.part-stride";
+const char *EXT_ATTR_S3_UPLOAD_PART        = "user.s3.upload.part.";
+
+/* multipart uploads are staged here, below the bucket root */
+#define S3_UPLOAD_DIR ".s3-uploads"
+#define S3_MAX_PARTS 10000
 
 const int PERM_S3_FULL_CONTROL 	= 1;
 const int PERM_S3_WRITE		= 2;
@@ -441,12 +493,220 @@ static char * orangefs_s3_bin_to_hex(apr_pool_t *pool,
 }
 
 /*
-   This routine will write the contents of the POST data to a PVFS2 object and
-   return the contents MD5 sum.
+   The PUT/POST data is gathered into buffers that end on multiples of the
+   write buffer size in the file, which is a multiple of its stripe width,
+   and up to S3_WRITE_DEPTH buffers are written at once.
+ */
+static apr_size_t orangefs_s3_write_buffer_size(orangefs_s3_request *req,
+                                                PVFS_object_ref *ref)
+{
+  PVFS_sysresp_getattr resp_getattr;
+  apr_size_t size = S3_WRITE_BUFFER_SIZE;
+  PVFS_size width;
+  int rc;
+
+  memset(&resp_getattr, 0, sizeof(PVFS_sysresp_getattr));
+  rc = PVFS_sys_getattr(*ref, PVFS_ATTR_SYS_BLKSIZE, req->credentials,
+                        &resp_getattr, NULL);
+  if (rc == 0 && (resp_getattr.attr.mask & PVFS_ATTR_SYS_BLKSIZE) &&
+      resp_getattr.attr.blksize > 0) {
+    width = resp_getattr.attr.blksize;
+    size = ((S3_WRITE_BUFFER_SIZE + width - 1) / width) * width;
+  }
+
+  return size;
+}
+
+static void orangefs_s3_writer_init(orangefs_s3_writer *w,
+                                    orangefs_s3_request *req,
+                                    PVFS_object_ref *ref,
+                                    PVFS_hint hints,
+                                    PVFS_offset offset)
+{
+  memset(w, 0, sizeof(orangefs_s3_writer));
+  w->req = req;
+  w->ref = *ref;
+  w->hints = hints;
+  w->offset = offset;
+  w->buffer_size = orangefs_s3_write_buffer_size(req, ref);
+}
+
+/*
+   Waits for writes to complete, oldest first: for all of them if all is
+   set, otherwise for one.  Returns the first error seen by any write.
+   Only this writer's own operations are waited on, other requests are
+   served by other threads of the same process.
+ */
+static int orangefs_s3_writer_wait(orangefs_s3_writer *w, int all)
+{
+  orangefs_s3_write_slot *slot;
+  int error, i, rc;
+
+  for (;;) {
+    /* buffers are posted at rising offsets, so the lowest is the oldest */
+    slot = NULL;
+    for (i = 0; i < S3_WRITE_DEPTH; i++) {
+      if (w->slots[i].busy &&
+          (slot == NULL || w->slots[i].offset < slot->offset)) {
+        slot = &w->slots[i];
+      }
+    }
+    if (slot == NULL) {
+      return w->error;
+    }
+
+    error = 0;
+    rc = PVFS_sys_wait(slot->op_id, "write", &error);
+    PVFS_sys_release(slot->op_id);
+    slot->busy = 0;
+    PVFS_Request_free(&slot->mem_req);
+    if (rc == 0) {
+      rc = error;
+    }
+
+    if (rc < 0) {
+      ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                   "PVFS_isys_write returned %d.", rc);
+      if (w->error == 0) {
+        w->error = rc;
+      }
+    } else if (slot->resp.total_completed != slot->len && w->error == 0) {
+      w->error = -PVFS_EIO;
+    }
+
+    if (!all) {
+      return w->error;
+    }
+  }
+}
+
+/* posts the write of the buffer being filled, if it holds anything */
+static int orangefs_s3_writer_flush(orangefs_s3_writer *w)
+{
+  orangefs_s3_write_slot *slot = w->cur;
+  int rc;
+
+  w->cur = NULL;
+  if (slot == NULL || slot->len == 0) {
+    return 0;
+  }
+
+  rc = PVFS_Request_contiguous(slot->len, PVFS_BYTE, &slot->mem_req);
+  if (rc < 0) {
+    ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                 "PVFS_Request_contiguous returned %d.", rc);
+    return rc;
+  }
+
+  memset(&slot->resp, 0, sizeof(PVFS_sysresp_io));
+  rc = PVFS_isys_write(w->ref, PVFS_BYTE, slot->offset, slot->buf,
+                       slot->mem_req, w->req->credentials, &slot->resp,
+                       &slot->op_id, w->hints, NULL);
+  if (rc < 0) {
+    ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                 "PVFS_isys_write returned %d.", rc);
+    PVFS_Request_free(&slot->mem_req);
+    return rc;
+  }
+
+  if (slot->op_id == -1) {
+    /* completed at once */
+    PVFS_Request_free(&slot->mem_req);
+    return (slot->resp.total_completed == slot->len) ? 0 : -PVFS_EIO;
+  }
+
+  slot->busy = 1;
+  return 0;
+}
+
+/* starts a new buffer, waiting for a write to complete if all are busy */
+static int orangefs_s3_writer_next(orangefs_s3_writer *w)
+{
+  int i, rc;
+
+  for (;;) {
+    for (i = 0; i < S3_WRITE_DEPTH; i++) {
+      if (!w->slots[i].busy) {
+        break;
+      }
+    }
+    if (i < S3_WRITE_DEPTH) {
+      break;
+    }
+    rc = orangefs_s3_writer_wait(w, 0);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+
+  w->cur = &w->slots[i];
+  if (w->cur->buf == NULL) {
+    w->cur->buf = apr_palloc(w->req->pool, w->buffer_size);
+  }
+  w->cur->offset = w->offset;
+  w->cur->len = 0;
+  /* end the buffer on a stripe boundary */
+  w->cur->limit = w->buffer_size - (apr_size_t)(w->offset % w->buffer_size);
+
+  return 0;
+}
+
+/* adds data to be written at the current offset */
+static int orangefs_s3_writer_add(orangefs_s3_writer *w, 
+                                  const char *buf, 
+                                  apr_size_t bytes)
+{
+  apr_size_t n;
+  int rc;
+
+  while (bytes > 0) {
+    if (w->cur == NULL) {
+      rc = orangefs_s3_writer_next(w);
+      if (rc < 0) {
+        return rc;
+      }
+    }
+
+    n = w->cur->limit - w->cur->len;
+    if (n > bytes) {
+      n = bytes;
+    }
+    memcpy(w->cur->buf + w->cur->len, buf, n);
+    w->cur->len += n;
+    w->offset += n;
+    buf += n;
+    bytes -= n;
+
+    if (w->cur->len == w->cur->limit) {
+      rc = orangefs_s3_writer_flush(w);
+      if (rc < 0) {
+        return rc;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/* writes out what is left and waits for all writes */
+static int orangefs_s3_writer_finish(orangefs_s3_writer *w)
+{
+  int rc, ret;
+
+  rc = orangefs_s3_writer_flush(w);
+  ret = orangefs_s3_writer_wait(w, 1);
+
+  return (rc < 0) ? rc : ret;
+}
+
+/*
+   This routine will write the contents of the POST data to a PVFS2 object,
+   starting at offset, and return its size and MD5 sum.
  */
 static int orangefs_s3_write_post_data_ref(orangefs_s3_request *req, 
                                            PVFS_object_ref *ref, 
                                            PVFS_hint hints, 
+                                           PVFS_offset offset,
                                            size_t *size, 
                                            unsigned char *md5)
 {
@@ -456,17 +716,17 @@ static int orangefs_s3_write_post_data_ref(orangefs_s3_request *req,
   const char *buf;
   apr_bucket *b;
   apr_bucket_brigade *bb;
-  PVFS_Request mem_req, file_req;
-  PVFS_sysresp_io resp_io;
-  size_t offset = 0;
+  orangefs_s3_writer w;
   apr_md5_ctx_t md5_ctx;
-  int rc;
+  int rc = 0, ret;
 
   if (debug_orangefs_s3) {
     ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL,
                  "orangefs_s3_write_post_data_ref:");
   }
 
+  orangefs_s3_writer_init(&w, req, ref, hints, offset);
+
   /* initialize the bucket brigade from the request */
   bb = apr_brigade_create(req->r->pool, req->r->connection->bucket_alloc);
 
@@ -475,7 +735,7 @@ static int orangefs_s3_write_post_data_ref(orangefs_s3_request *req,
   /* loop over each bucket until we get an EOS */
   do {
     status = ap_get_brigade(req->r->input_filters, bb, AP_MODE_READBYTES,
-                            APR_BLOCK_READ, 4096);
+                            APR_BLOCK_READ, w.buffer_size);
     if (status == APR_SUCCESS) {
       for (b = APR_BRIGADE_FIRST(bb);
            b!= APR_BRIGADE_SENTINEL(bb);
@@ -492,35 +752,34 @@ static int orangefs_s3_write_post_data_ref(orangefs_s3_request *req,
 
         /* read into buf */
         status = apr_bucket_read(b, &buf, &bytes, APR_BLOCK_READ);
-        if (status == APR_SUCCESS) {
-          file_req = PVFS_BYTE;
-          rc = PVFS_Request_contiguous(bytes, PVFS_BYTE, &mem_req);
-          if (rc < 0) {
-            ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
-                         "PVFS_sys_resolve returned %d.", rc);
-            return -1;
-          }
-
-          rc = PVFS_sys_write(*ref, file_req, offset, (void *)buf, mem_req,
-                              req->credentials, &resp_io, hints);
-
-          offset += bytes;
-
-          PVFS_Request_free(&mem_req);
+        if (status != APR_SUCCESS) {
+          break;
+        }
 
-          apr_md5_update(&md5_ctx, buf, bytes);
+        apr_md5_update(&md5_ctx, buf, bytes);
 
-        } else {
-          return -1;
+        /* the write of a full buffer overlaps reading the next one */
+        rc = orangefs_s3_writer_add(&w, buf, bytes);
+        if (rc < 0) {
+          break;
         }
       }
     }
 
     apr_brigade_cleanup(bb);
-  } while (!end && (status == APR_SUCCESS));
+  } while (!end && rc == 0 && (status == APR_SUCCESS));
+
+  /* always wait for the writes in flight, they use the request's pool */
+  ret = orangefs_s3_writer_finish(&w);
+  if (rc == 0) {
+    rc = ret;
+  }
+  if (rc < 0 || status != APR_SUCCESS) {
+    return -1;
+  }
 
   apr_md5_final(md5, &md5_ctx);
-  *size = offset;
+  *size = w.offset - offset;
 
   return 0;
 }
@@ -680,211 +939,1023 @@ static PVFS_object_ref * orangefs_s3_mkdir_p(orangefs_s3_request *req,
   attr.perms = mode;
   attr.mask = (PVFS_ATTR_SYS_ALL_SETABLE);
 
-  memset(&mkdir_response, 0, sizeof(PVFS_sysresp_mkdir));
-  rc = PVFS_sys_mkdir(entry_name, *parent_ref, attr, 
-                      req->credentials, &mkdir_response, NULL);
+  memset(&mkdir_response, 0, sizeof(PVFS_sysresp_mkdir));
+  rc = PVFS_sys_mkdir(entry_name, *parent_ref, attr, 
+                      req->credentials, &mkdir_response, NULL);
+  if (rc < 0) {
+    ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                 "PVFS_sys_mkdir() returned %d.", rc);
+    return NULL;
+  }
+
+  /* assign the S3 owner attributes */
+  key.buffer = (void*) apr_pstrdup(req->pool, EXT_ATTR_S3_OWNER_ID);
+  key.buffer_sz = strlen(key.buffer) + 1;
+  val.buffer = apr_pcalloc(req->pool, BUFSIZ);
+  sprintf(val.buffer, "%d", req->credentials->userid);
+  val.buffer_sz = strlen(val.buffer) + 1;
+
+  rc = PVFS_sys_seteattr(mkdir_response.ref, req->credentials, 
+                         &key, &val, 0, NULL);
+  if (rc < 0) {
+    ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                 "PVFS_sys_seteattr() for owner id returned rc %d.", rc);
+  }
+
+  key.buffer = (void*)EXT_ATTR_S3_OWNER_DISPLAY_NAME;
+  key.buffer_sz = strlen(key.buffer) + 1;
+  val.buffer = req->cn;
+  val.buffer_sz = strlen(val.buffer) + 1;
+
+  rc = PVFS_sys_seteattr(mkdir_response.ref, req->credentials, 
+                         &key, &val, 0, NULL);
+  if (rc < 0) {
+    ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                 "PVFS_sys_seteattr() for owner display name returned rc %d.", 
+                 rc);
+  }
+
+  rc = PVFS_sys_lookup(fsid, path, req->credentials, resp_lookup, 
+                       PVFS2_LOOKUP_LINK_NO_FOLLOW, NULL);
+  if (rc == 0) {
+    return &resp_lookup->ref;
+  }
+
+  return NULL;
+}
+
+/*
+   Splits the path of an object in a bucket into the PVFS2 path of its
+   parent directory and its entry name.
+ */
+static void orangefs_s3_split_path(orangefs_s3_request *req, 
+                                   char *bucket, 
+                                   char *path,
+                                   char **parent_path,
+                                   char **entry_name)
+{
+  char *ptr;
+
+  *parent_path = 
+    apr_pstrcat(req->pool, req->conf->pvfs_path, "/", bucket, NULL);
+
+  /* walk backwards from the end to find the last '/' */
+  for (ptr = path + strlen(path) -1; (ptr > path) && (*ptr != '/'); ptr--);
+
+  if (ptr > path) {
+    *entry_name = apr_pstrdup(req->pool, ptr + 1);
+    *parent_path = apr_pstrcat(req->pool, *parent_path, 
+                               apr_pstrndup(req->pool, path, 
+                               (ptr - path)), NULL);
+  } else {
+    *entry_name = apr_pstrdup(req->pool, path + 1);
+  }
+}
+
+/*
+   Sets the S3 attributes of an object and the ETag response header.
+ */
+static void orangefs_s3_set_object_attrs(orangefs_s3_request *req, 
+                                         PVFS_object_ref *ref, 
+                                         char *etag, 
+                                         PVFS_size size)
+{
+  PVFS_ds_keyval key, val;
+  char tmp[64];
+  int rc;
+
+  key.buffer = (void*)EXT_ATTR_S3_ENTITY_TAG;
+  key.buffer_sz = strlen(key.buffer) + 1;
+  val.buffer = etag;
+  val.buffer_sz = strlen(val.buffer) + 1;
+
+  rc = PVFS_sys_seteattr(*ref, req->credentials, &key, &val, 0, NULL);
+  if (rc < 0) {
+    ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                 "PVFS_sys_seteattr() for entity tag returned rc %d.", rc);
+  }
+ 
+  /* write out etag response header */
+  apr_table_setn(req->r->headers_out, "ETag", 
+                 apr_pstrcat(req->pool, "\"", etag, "\"", NULL));
+
+  key.buffer = (void*)EXT_ATTR_S3_SIZE;
+  key.buffer_sz = strlen(key.buffer) + 1;
+  sprintf(tmp, "%lld", (long long)size);
+  val.buffer = tmp;
+  val.buffer_sz = strlen(val.buffer) + 1;
+
+  rc = PVFS_sys_seteattr(*ref, req->credentials, &key, &val, 0, NULL);
+  if (rc < 0) {
+    ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                 "PVFS_sys_seteattr() for size returned rc %d.", rc);
+  }
+
+  key.buffer = (void*)EXT_ATTR_S3_OWNER_ID;
+  key.buffer_sz = strlen(key.buffer) + 1;
+  val.buffer = apr_pcalloc(req->pool, BUFSIZ);
+  sprintf(val.buffer, "%d", req->credentials->userid);
+  val.buffer_sz = strlen(val.buffer) + 1;
+
+  rc = PVFS_sys_seteattr(*ref, req->credentials, &key, &val, 0, NULL);
+  if (rc < 0) {
+    ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                 "PVFS_sys_seteattr() for owner id returned rc %d.", rc);
+  }
+
+  key.buffer = (void*)EXT_ATTR_S3_OWNER_DISPLAY_NAME;
+  key.buffer_sz = strlen(key.buffer) + 1;
+  val.buffer = req->cn;
+  val.buffer_sz = strlen(val.buffer) + 1;
+
+  rc = PVFS_sys_seteattr(*ref, req->credentials, &key, &val, 0, NULL);
+  if (rc < 0) {
+    ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                 "PVFS_sys_seteattr() for owner display name returned rc %d.", 
+                 rc);
+  }
+}
+
+static int orangefs_s3_put_object(orangefs_s3_request *req, 
+                                  char *bucket, 
+                                  char *path)
+{
+  char *entry_name, *parent_path, *entry_path;
+  PVFS_sysresp_lookup resp_lookup;
+  PVFS_sysresp_create resp_create;
+  PVFS_object_ref *parent_ref;
+  PVFS_object_ref *ref;
+  PVFS_sys_dist *new_dist = NULL;
+  PVFS_sys_attr attr;
+  PVFS_hint hints = NULL;
+  unsigned char md5[APR_MD5_DIGESTSIZE];
+  size_t size = 0;
+  int exists = 0;
+  int rc;
+
+  if (debug_orangefs_s3) {
+    ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                 "orangefs_s3_put_object for bucket %s path %s.", bucket, path);
+  }
+
+  PVFS_hint_import_env(&hints);
+
+  entry_path = apr_pstrcat(req->pool, req->conf->pvfs_path, "/", 
+                           bucket, path, NULL);
+
+  memset(&resp_lookup, 0, sizeof(PVFS_sysresp_lookup));
+  rc = PVFS_sys_lookup(req->conf->fsid, entry_path, req->credentials, 
+                       &resp_lookup, PVFS2_LOOKUP_LINK_NO_FOLLOW, NULL);
+  if (rc == 0) {
+    /* file already exists */
+    ref = &resp_lookup.ref;
+    exists = 1;
+  } else {
+    /* does not exist, need to create it */
+
+    /* fill out our attr */
+    attr.owner = req->credentials->userid;
+    attr.group = req->credentials->group_array[0];
+    attr.perms = 256;
+    attr.mask = (PVFS_ATTR_SYS_ALL_SETABLE);
+    attr.dfile_count = 0;
+
+    orangefs_s3_split_path(req, bucket, path, &parent_path, &entry_name);
+    
+    parent_ref = orangefs_s3_mkdir_p(req, req->conf->fsid, parent_path);
+    if (parent_ref == NULL) {
+      ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                   "Unable to get or create parent directory %s", parent_path);
+      return HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    /* need to create the entry */
+    rc = PVFS_sys_create(entry_name, *parent_ref, attr, req->credentials, 
+                         new_dist, &resp_create, NULL, hints);
+    if (rc < 0) {
+      ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                   "PVFS_sys_create returned %d.", rc);
+      return HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    ref = &resp_create.ref;
+  }
+
+  /* now we need to write the PUT/POST data */
+  memset(md5, 0, APR_MD5_DIGESTSIZE);
+  rc = orangefs_s3_write_post_data_ref(req, ref, hints, 0, &size, md5);
+  if (rc < 0) {
+    ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                 "Unable to write object %s.", entry_path);
+    return HTTP_INTERNAL_SERVER_ERROR;
+  }
+
+  if (exists) {
+    /* drop whatever was left of the old object */
+    rc = PVFS_sys_truncate(*ref, size, req->credentials, NULL);
+    if (rc < 0) {
+      ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                   "PVFS_sys_truncate returned %d.", rc);
+      return HTTP_INTERNAL_SERVER_ERROR;
+    }
+  }
+
+  orangefs_s3_set_object_attrs(req, ref, 
+                               orangefs_s3_bin_to_hex(req->pool, md5, 
+                                                      APR_MD5_DIGESTSIZE),
+                               size);
+
+  return OK;
+}
+
+/*
+   Multipart uploads.
+
+   Each upload is staged in a file named after its upload id in 
+   S3_UPLOAD_DIR.  The Content-Length of the first part uploaded becomes
+   the part stride of the upload, and every part that is no longer than
+   that is written in place at (number - 1) * stride.  Since all parts but
+   the last are usually the same size, completing the upload is then just
+   a truncate and a rename.  Longer parts are written to a file of their
+   own and force the parts to be copied at completion.
+
+   Each part is recorded in an extended attribute of the staging file as
+   "<md5> <offset> <size> <spilled>".
+ */
+
+/* returns the first value of an HTTP parameter, or NULL */
+static char *orangefs_s3_param(orangefs_s3_request *req, const char *name)
+{
+  apr_array_header_t *values;
+
+  if (!req->params) {
+    return NULL;
+  }
+
+  values = apr_hash_get(req->params, name, APR_HASH_KEY_STRING);
+  if (!values || values->nelts < 1) {
+    return NULL;
+  }
+
+  return ((char **)values->elts)[0];
+}
+
+static void orangefs_s3_error(orangefs_s3_request *req, 
+                              const char *code, 
+                              const char *message, 
+                              const char *resource)
+{
+  ap_rprintf(req->r, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>");
+  ap_rprintf(req->r, "<Error>");
+  ap_rprintf(req->r,   "<Code>%s</Code>", code);
+  ap_rprintf(req->r,   "<Message>%s</Message>", message);
+  ap_rprintf(req->r,   "<Resource>%s</Resource>", resource);
+  ap_rprintf(req->r,   "<RequestId></RequestId>");
+  ap_rprintf(req->r, "</Error>");
+}
+
+/* returns the value of an extended attribute, or NULL */
+static char *orangefs_s3_get_xattr(orangefs_s3_request *req, 
+                                   PVFS_object_ref *ref, 
+                                   const char *name)
+{
+  PVFS_ds_keyval key, val;
+  int rc;
+
+  key.buffer = apr_pstrdup(req->pool, name);
+  key.buffer_sz = strlen(key.buffer) + 1;
+  val.buffer = apr_pcalloc(req->pool, 4096 + 1);
+  val.buffer_sz = 4096;
+
+  rc = PVFS_sys_geteattr(*ref, req->credentials, &key, &val, NULL);
+  if (rc < 0) {
+    return NULL;
+  }
+
+  return (char*)val.buffer;
+}
+
+static int orangefs_s3_set_xattr(orangefs_s3_request *req, 
+                                 PVFS_object_ref *ref, 
+                                 const char *name,
+                                 char *value,
+                                 int flags)
+{
+  PVFS_ds_keyval key, val;
+
+  key.buffer = apr_pstrdup(req->pool, name);
+  key.buffer_sz = strlen(key.buffer) + 1;
+  val.buffer = value;
+  val.buffer_sz = strlen(value) + 1;
+
+  return PVFS_sys_seteattr(*ref, req->credentials, &key, &val, flags, NULL);
+}
+
+static void orangefs_s3_del_xattr(orangefs_s3_request *req, 
+                                  PVFS_object_ref *ref, 
+                                  const char *name)
+{
+  PVFS_ds_keyval key;
+
+  key.buffer = apr_pstrdup(req->pool, name);
+  key.buffer_sz = strlen(key.buffer) + 1;
+
+  PVFS_sys_deleattr(*ref, req->credentials, &key, NULL);
+}
+
+/*
+   Looks up the upload staging directory, creating it on first use.  It
+   has no S3 owner attribute, so it never shows up as a bucket.
+ */
+static int orangefs_s3_upload_dir(orangefs_s3_request *req, 
+                                  PVFS_object_ref *dir_ref)
+{
+  PVFS_sysresp_lookup resp_lookup;
+  PVFS_sysresp_mkdir mkdir_response;
+  PVFS_sys_attr attr;
+  char *path;
+  int rc;
+
+  path = apr_pstrcat(req->pool, req->conf->pvfs_path, "/", S3_UPLOAD_DIR, 
+                     NULL);
+
+  memset(&resp_lookup, 0, sizeof(PVFS_sysresp_lookup));
+  rc = PVFS_sys_lookup(req->conf->fsid, path, req->root, &resp_lookup, 
+                       PVFS2_LOOKUP_LINK_NO_FOLLOW, NULL);
+  if (rc == 0) {
+    *dir_ref = resp_lookup.ref;
+    return 0;
+  }
+
+  rc = PVFS_sys_lookup(req->conf->fsid, req->conf->pvfs_path, req->root, 
+                       &resp_lookup, PVFS2_LOOKUP_LINK_NO_FOLLOW, NULL);
+  if (rc < 0) {
+    ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                 "PVFS_sys_lookup for %s returned %d.", 
+                 req->conf->pvfs_path, rc);
+    return rc;
+  }
+
+  /* rwx-wx-wx: anyone can stage files, but not list them */
+  attr.owner = req->root->userid;
+  attr.group = req->root->group_array[0];
+  attr.perms = 475;
+  attr.mask = (PVFS_ATTR_SYS_ALL_SETABLE);
+
+  memset(&mkdir_response, 0, sizeof(PVFS_sysresp_mkdir));
+  rc = PVFS_sys_mkdir(S3_UPLOAD_DIR, resp_lookup.ref, attr, req->root, 
+                      &mkdir_response, NULL);
+  if (rc == 0) {
+    *dir_ref = mkdir_response.ref;
+    return 0;
+  }
+
+  /* another request may have just made it */
+  rc = PVFS_sys_lookup(req->conf->fsid, path, req->root, &resp_lookup, 
+                       PVFS2_LOOKUP_LINK_NO_FOLLOW, NULL);
+  if (rc < 0) {
+    ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                 "Unable to get or create upload directory %s.", path);
+    return rc;
+  }
+
+  *dir_ref = resp_lookup.ref;
+  return 0;
+}
+
+/* creates an empty file in the upload directory, truncating a stale one */
+static int orangefs_s3_upload_create(orangefs_s3_request *req, 
+                                     PVFS_object_ref *dir_ref, 
+                                     char *name,
+                                     PVFS_hint hints,
+                                     PVFS_object_ref *ref)
+{
+  PVFS_sysresp_create resp_create;
+  PVFS_sysresp_lookup resp_lookup;
+  PVFS_sys_attr attr;
+  int rc;
+
+  attr.owner = req->credentials->userid;
+  attr.group = req->credentials->group_array[0];
+  attr.perms = 384;
+  attr.mask = (PVFS_ATTR_SYS_ALL_SETABLE);
+  attr.dfile_count = 0;
+
+  memset(&resp_create, 0, sizeof(PVFS_sysresp_create));
+  rc = PVFS_sys_create(name, *dir_ref, attr, req->credentials, NULL, 
+                       &resp_create, NULL, hints);
+  if (rc == 0) {
+    *ref = resp_create.ref;
+    return 0;
+  }
+  if (rc != -PVFS_EEXIST) {
+    ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                 "PVFS_sys_create returned %d.", rc);
+    return rc;
+  }
+
+  memset(&resp_lookup, 0, sizeof(PVFS_sysresp_lookup));
+  rc = PVFS_sys_ref_lookup(req->conf->fsid, name, *dir_ref, 
+                           req->credentials, &resp_lookup, 
+                           PVFS2_LOOKUP_LINK_NO_FOLLOW, NULL);
+  if (rc < 0) {
+    return rc;
+  }
+  *ref = resp_lookup.ref;
+
+  return PVFS_sys_truncate(*ref, 0, req->credentials, NULL);
+}
+
+/*
+   Finds the staging file of an upload and checks that the upload is for
+   this object.  Returns OK or an HTTP error.
+ */
+static int orangefs_s3_upload_lookup(orangefs_s3_request *req, 
+                                     char *bucket, 
+                                     char *path,
+                                     char *upload_id,
+                                     PVFS_object_ref *dir_ref,
+                                     PVFS_object_ref *ref)
+{
+  PVFS_sysresp_lookup resp_lookup;
+  char *key;
+  int rc;
+
+  /* upload ids are ours, and name files; take nothing else */
+  if (strlen(upload_id) != APR_MD5_DIGESTSIZE * 2 ||
+      strspn(upload_id, "0123456789abcdef") != strlen(upload_id)) {
+    orangefs_s3_error(req, "NoSuchUpload", 
+                      "The specified upload does not exist.", path);
+    return HTTP_NOT_FOUND;
+  }
+
+  rc = orangefs_s3_upload_dir(req, dir_ref);
+  if (rc < 0) {
+    return HTTP_INTERNAL_SERVER_ERROR;
+  }
+
+  memset(&resp_lookup, 0, sizeof(PVFS_sysresp_lookup));
+  rc = PVFS_sys_ref_lookup(req->conf->fsid, upload_id, *dir_ref, 
+                           req->credentials, &resp_lookup, 
+                           PVFS2_LOOKUP_LINK_NO_FOLLOW, NULL);
+  if (rc == 0) {
+    *ref = resp_lookup.ref;
+    key = orangefs_s3_get_xattr(req, ref, EXT_ATTR_S3_UPLOAD_KEY);
+    if (key && 
+        strcmp(key, apr_pstrcat(req->pool, bucket, path, NULL)) == 0) {
+      return OK;
+    }
+  }
+
+  orangefs_s3_error(req, "NoSuchUpload", 
+                    "The specified upload does not exist.", path);
+  return HTTP_NOT_FOUND;
+}
+
+static int orangefs_s3_initiate_upload(orangefs_s3_request *req, 
+                                       char *bucket, 
+                                       char *path)
+{
+  PVFS_sysresp_lookup resp_lookup;
+  PVFS_object_ref dir_ref, ref;
+  PVFS_hint hints = NULL;
+  unsigned char id[APR_MD5_DIGESTSIZE];
+  char *upload_id;
+  int rc;
+
+  if (debug_orangefs_s3) {
+    ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                 "orangefs_s3_initiate_upload for bucket %s path %s.", 
+                 bucket, path);
+  }
+
+  memset(&resp_lookup, 0, sizeof(PVFS_sysresp_lookup));
+  rc = PVFS_sys_lookup(req->conf->fsid, 
+                       apr_pstrcat(req->pool, req->conf->pvfs_path, "/", 
+                                   bucket, NULL),
+                       req->root, &resp_lookup, 
+                       PVFS2_LOOKUP_LINK_NO_FOLLOW, NULL);
+  if (rc < 0) {
+    orangefs_s3_error(req, "NoSuchBucket", 
+                      "The specified bucket does not exist.", bucket);
+    return HTTP_NOT_FOUND;
+  }
+
+  if (apr_generate_random_bytes(id, sizeof(id)) != APR_SUCCESS) {
+    ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                 "Unable to generate an upload id.");
+    return HTTP_INTERNAL_SERVER_ERROR;
+  }
+  upload_id = orangefs_s3_bin_to_hex(req->pool, id, sizeof(id));
+
+  rc = orangefs_s3_upload_dir(req, &dir_ref);
+  if (rc < 0) {
+    return HTTP_INTERNAL_SERVER_ERROR;
+  }
+
+  PVFS_hint_import_env(&hints);
+
+  rc = orangefs_s3_upload_create(req, &dir_ref, upload_id, hints, &ref);
+  if (rc < 0) {
+    return HTTP_INTERNAL_SERVER_ERROR;
+  }
+
+  rc = orangefs_s3_set_xattr(req, &ref, EXT_ATTR_S3_UPLOAD_KEY, 
+                             apr_pstrcat(req->pool, bucket, path, NULL), 0);
+  if (rc < 0) {
+    ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                 "PVFS_sys_seteattr() for upload key returned rc %d.", rc);
+    PVFS_sys_remove(upload_id, dir_ref, req->credentials, NULL);
+    return HTTP_INTERNAL_SERVER_ERROR;
+  }
+
+  ap_rprintf(req->r, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>");
+  ap_rprintf(req->r, "<InitiateMultipartUploadResult xmlns=\"http://s3.amazonaws.com/doc/2006-03-01/\">");
+  ap_rprintf(req->r,   "<Bucket>%s</Bucket>", bucket);
+  ap_rprintf(req->r,   "<Key>%s</Key>", path + 1);
+  ap_rprintf(req->r,   "<UploadId>%s</UploadId>", upload_id);
+  ap_rprintf(req->r, "</InitiateMultipartUploadResult>");
+
+  return OK;
+}
+
+static int orangefs_s3_put_object_part(orangefs_s3_request *req, 
+                                       char *bucket, 
+                                       char *path,
+                                       char *upload_id,
+                                       char *part)
+{
+  PVFS_object_ref dir_ref, ref, spill_ref, *target;
+  PVFS_hint hints = NULL;
+  unsigned char md5[APR_MD5_DIGESTSIZE];
+  const char *length_header;
+  apr_off_t length, stride = 0;
+  PVFS_offset offset = 0;
+  size_t size = 0;
+  char *value, *etag;
+  char tmp[64];
+  int number, spilled = 0;
+  int rc;
+
+  if (debug_orangefs_s3) {
+    ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                 "orangefs_s3_put_object_part %s for upload %s.", 
+                 part, upload_id);
+  }
+
+  number = atoi(part);
+  if (number < 1 || number > S3_MAX_PARTS) {
+    orangefs_s3_error(req, "InvalidArgument", 
+                      "Part number must be an integer between 1 and 10000.",
+                      path);
+    return HTTP_BAD_REQUEST;
+  }
+
+  rc = orangefs_s3_upload_lookup(req, bucket, path, upload_id, 
+                                 &dir_ref, &ref);
+  if (rc != OK) {
+    return rc;
+  }
+
+  PVFS_hint_import_env(&hints);
+
+  length_header = apr_table_get(req->r->headers_in, "Content-Length");
+  length = length_header ? apr_atoi64(length_header) : -1;
+
+  /* the first part to arrive sets the stride */
+  value = orangefs_s3_get_xattr(req, &ref, EXT_ATTR_S3_UPLOAD_STRIDE);
+  if (!value && length > 0) {
+    sprintf(tmp, "%lld", (long long)length);
+    rc = orangefs_s3_set_xattr(req, &ref, EXT_ATTR_S3_UPLOAD_STRIDE, tmp,
+                               PVFS_XATTR_CREATE);
+    value = (rc == 0) ? tmp :
+      orangefs_s3_get_xattr(req, &ref, EXT_ATTR_S3_UPLOAD_STRIDE);
+  }
+  if (value) {
+    stride = apr_atoi64(value);
+  }
+
+  if (length >= 0 && stride > 0 && length <= stride) {
+    target = &ref;
+    offset = (PVFS_offset)(number - 1) * stride;
+  } else {
+    rc = orangefs_s3_upload_create(req, &dir_ref, 
+                                   apr_psprintf(req->pool, "%s.%d", 
+                                                upload_id, number),
+                                   hints, &spill_ref);
+    if (rc < 0) {
+      return HTTP_INTERNAL_SERVER_ERROR;
+    }
+    target = &spill_ref;
+    spilled = 1;
+  }
+
+  memset(md5, 0, APR_MD5_DIGESTSIZE);
+  rc = orangefs_s3_write_post_data_ref(req, target, hints, offset, 
+                                       &size, md5);
   if (rc < 0) {
     ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
-                 "PVFS_sys_mkdir() returned %d.", rc);
-    return NULL;
+                 "Unable to write part %d of upload %s.", number, upload_id);
+    return HTTP_INTERNAL_SERVER_ERROR;
   }
 
-  /* assign the S3 owner attributes */
-  key.buffer = (void*) apr_pstrdup(req->pool, EXT_ATTR_S3_OWNER_ID);
-  key.buffer_sz = strlen(key.buffer) + 1;
-  val.buffer = apr_pcalloc(req->pool, BUFSIZ);
-  sprintf(val.buffer, "%d", req->credentials->userid);
-  val.buffer_sz = strlen(val.buffer) + 1;
+  etag = orangefs_s3_bin_to_hex(req->pool, md5, APR_MD5_DIGESTSIZE);
 
-  rc = PVFS_sys_seteattr(mkdir_response.ref, req->credentials, 
-                         &key, &val, 0, NULL);
+  rc = orangefs_s3_set_xattr(req, &ref, 
+                             apr_psprintf(req->pool, "%s%d", 
+                                          EXT_ATTR_S3_UPLOAD_PART, number),
+                             apr_psprintf(req->pool, "%s %lld %lld %d", 
+                                          etag, (long long)offset, 
+                                          (long long)size, spilled),
+                             0);
   if (rc < 0) {
     ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
-                 "PVFS_sys_seteattr() for owner id returned rc %d.", rc);
+                 "PVFS_sys_seteattr() for part %d returned rc %d.", 
+                 number, rc);
+    return HTTP_INTERNAL_SERVER_ERROR;
   }
 
-  key.buffer = (void*)EXT_ATTR_S3_OWNER_DISPLAY_NAME;
-  key.buffer_sz = strlen(key.buffer) + 1;
-  val.buffer = req->cn;
-  val.buffer_sz = strlen(val.buffer) + 1;
+  apr_table_setn(req->r->headers_out, "ETag", 
+                 apr_pstrcat(req->pool, "\"", etag, "\"", NULL));
 
-  rc = PVFS_sys_seteattr(mkdir_response.ref, req->credentials, 
-                         &key, &val, 0, NULL);
-  if (rc < 0) {
-    ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
-                 "PVFS_sys_seteattr() for owner display name returned rc %d.", 
-                 rc);
+  return OK;
+}
+
+/* copies size bytes of a part into the object being assembled */
+static int orangefs_s3_copy_part(orangefs_s3_request *req, 
+                                 PVFS_object_ref *src, 
+                                 PVFS_offset offset, 
+                                 PVFS_size size,
+                                 char *buffer,
+                                 orangefs_s3_writer *w)
+{
+  PVFS_Request mem_req;
+  PVFS_sysresp_io resp_io;
+  PVFS_size count;
+  int rc;
+
+  while (size > 0) {
+    count = (size < (PVFS_size)w->buffer_size) ? size : w->buffer_size;
+
+    rc = PVFS_Request_contiguous(count, PVFS_BYTE, &mem_req);
+    if (rc < 0) {
+      return rc;
+    }
+
+    memset(&resp_io, 0, sizeof(PVFS_sysresp_io));
+    rc = PVFS_sys_read(*src, PVFS_BYTE, offset, buffer, mem_req, 
+                       req->credentials, &resp_io, NULL);
+    PVFS_Request_free(&mem_req);
+    if (rc < 0) {
+      ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                   "PVFS_sys_read returned rc %d.", rc);
+      return rc;
+    }
+    if (resp_io.total_completed != count) {
+      return -PVFS_EIO;
+    }
+
+    rc = orangefs_s3_writer_add(w, buffer, count);
+    if (rc < 0) {
+      return rc;
+    }
+
+    offset += count;
+    size -= count;
   }
 
-  rc = PVFS_sys_lookup(fsid, path, req->credentials, resp_lookup, 
-                       PVFS2_LOOKUP_LINK_NO_FOLLOW, NULL);
-  if (rc == 0) {
-    return &resp_lookup->ref;
+  return 0;
+}
+
+/* returns the part numbers listed in a CompleteMultipartUpload body */
+static apr_array_header_t *orangefs_s3_parse_parts(orangefs_s3_request *req,
+                                                   char *body, 
+                                                   apr_size_t size)
+{
+  apr_array_header_t *parts;
+  xmlTextReaderPtr reader;
+  xmlChar *value;
+  const xmlChar *name;
+
+  parts = apr_array_make(req->pool, 16, sizeof(int));
+
+  reader = xmlReaderForMemory(body, size, NULL, NULL, 0);
+  if (reader == NULL) {
+    return NULL;
   }
 
-  return NULL;
+  while (xmlTextReaderRead(reader) == 1) {
+    name = xmlTextReaderConstLocalName(reader);
+    if (xmlTextReaderNodeType(reader) == XML_READER_TYPE_ELEMENT &&
+        name && strcmp((const char *)name, "PartNumber") == 0) {
+      value = xmlTextReaderReadString(reader);
+      if (value) {
+        *(int *)apr_array_push(parts) = atoi((char *)value);
+        xmlFree(value);
+      }
+    }
+  }
+
+  xmlFreeTextReader(reader);
+
+  return parts;
 }
 
-static int orangefs_s3_put_object(orangefs_s3_request *req, 
-                                  char *bucket, 
-                                  char *path)
+static int orangefs_s3_complete_upload(orangefs_s3_request *req, 
+                                       char *bucket, 
+                                       char *path,
+                                       char *upload_id)
 {
-  char *entry_name, *parent_path, *entry_path;
+  PVFS_object_ref dir_ref, ref, final_ref, src_ref, *parent_ref;
   PVFS_sysresp_lookup resp_lookup;
-  PVFS_sysresp_create resp_create;
-  PVFS_object_ref *parent_ref;
-  PVFS_object_ref *ref;
-  PVFS_ds_keyval key, val;
-  PVFS_sys_dist *new_dist = NULL;
-  PVFS_sys_attr attr;
   PVFS_hint hints = NULL;
-  unsigned char md5[APR_MD5_DIGESTSIZE];
-  char tmp[1024];
-  size_t size = 0;
-  char *ptr;
-  int rc, i;
+  apr_array_header_t *parts;
+  apr_md5_ctx_t md5_ctx;
+  unsigned char md5[APR_MD5_DIGESTSIZE], part_md5[APR_MD5_DIGESTSIZE];
+  char hex[APR_MD5_DIGESTSIZE * 2 + 1];
+  char *body, *record, *final_name, *parent_path, *entry_name, *etag;
+  char *buffer;
+  PVFS_offset *offsets;
+  PVFS_size *sizes, total = 0;
+  int *spilled;
+  apr_size_t body_size;
+  long long part_offset, part_size;
+  orangefs_s3_writer w;
+  int contiguous = 1;
+  int number, i, j, rc, ret;
 
   if (debug_orangefs_s3) {
     ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
-                 "orangefs_s3_put_object for bucket %s path %s.", bucket, path);
+                 "orangefs_s3_complete_upload %s for bucket %s path %s.", 
+                 upload_id, bucket, path);
   }
 
-  PVFS_hint_import_env(&hints);
+  rc = orangefs_s3_upload_lookup(req, bucket, path, upload_id, 
+                                 &dir_ref, &ref);
+  if (rc != OK) {
+    return rc;
+  }
 
-  entry_path = apr_pstrcat(req->pool, req->conf->pvfs_path, "/", 
-                           bucket, path, NULL);
+  orangefs_s3_load_post_data(req->r, &body, &body_size);
+  parts = body ? orangefs_s3_parse_parts(req, body, body_size) : NULL;
+  if (parts == NULL || parts->nelts == 0) {
+    orangefs_s3_error(req, "MalformedXML", 
+                      "The XML you provided was not well-formed.", path);
+    return HTTP_BAD_REQUEST;
+  }
 
-  memset(&resp_lookup, 0, sizeof(PVFS_sysresp_lookup));
-  rc = PVFS_sys_lookup(req->conf->fsid, entry_path, req->credentials, 
-                       &resp_lookup, PVFS2_LOOKUP_LINK_NO_FOLLOW, NULL);
-  if (rc == 0) {
-    /* file already exists */
-    ref = &resp_lookup.ref;
-  } else {
-    /* does not exist, need to create it */
-    entry_name = apr_pstrdup(req->pool, path);
-    entry_name++;
+  offsets = apr_pcalloc(req->pool, parts->nelts * sizeof(PVFS_offset));
+  sizes = apr_pcalloc(req->pool, parts->nelts * sizeof(PVFS_size));
+  spilled = apr_pcalloc(req->pool, parts->nelts * sizeof(int));
 
-    /* fill out our attr */
-    attr.owner = req->credentials->userid;
-    attr.group = req->credentials->group_array[0];
-    attr.perms = 256;
-    attr.mask = (PVFS_ATTR_SYS_ALL_SETABLE);
-    attr.dfile_count = 0;
+  apr_md5_init(&md5_ctx);
 
-    parent_path = 
-      apr_pstrcat(req->pool, req->conf->pvfs_path, "/", bucket, NULL);
+  for (i = 0; i < parts->nelts; i++) {
+    number = ((int *)parts->elts)[i];
+    if (i > 0 && number <= ((int *)parts->elts)[i - 1]) {
+      orangefs_s3_error(req, "InvalidPartOrder", 
+                        "The list of parts was not in ascending order.", 
+                        path);
+      return HTTP_BAD_REQUEST;
+    }
 
-    /* walk backwards from the end to find the last '/' */
-    for (ptr = path + strlen(path) -1; (ptr > path) && (*ptr != '/'); ptr--);
+    record = orangefs_s3_get_xattr(req, &ref, 
+                                   apr_psprintf(req->pool, "%s%d", 
+                                                EXT_ATTR_S3_UPLOAD_PART, 
+                                                number));
+    if (!record || 
+        sscanf(record, "%32s %lld %lld %d", hex, &part_offset, &part_size, 
+               &spilled[i]) != 4) {
+      orangefs_s3_error(req, "InvalidPart", 
+                        "One or more of the specified parts could not be found.",
+                        path);
+      return HTTP_BAD_REQUEST;
+    }
+    offsets[i] = part_offset;
+    sizes[i] = part_size;
 
-    if (ptr > path) {
-      entry_name = apr_pstrdup(req->pool, ptr + 1);
-      parent_path = apr_pstrcat(req->pool, parent_path, 
-                                apr_pstrndup(req->pool, path, 
-                                (ptr - path)), NULL);
-    } else {
-      entry_name = apr_pstrdup(req->pool, path + 1);
+    /* the etag of the object is the md5 of the md5s of its parts */
+    for (j = 0; j < APR_MD5_DIGESTSIZE; j++) {
+      sscanf(hex + j * 2, "%2hhx", &part_md5[j]);
     }
-    
-    parent_ref = orangefs_s3_mkdir_p(req, req->conf->fsid, parent_path);
-    if (parent_ref == NULL) {
-      ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
-                   "Unable to get or create parent directory %s", parent_path);
-      return HTTP_INTERNAL_SERVER_ERROR;
+    apr_md5_update(&md5_ctx, part_md5, APR_MD5_DIGESTSIZE);
+
+    if (spilled[i] || offsets[i] != total) {
+      contiguous = 0;
     }
+    total += sizes[i];
+  }
 
-    /* need to create the entry */
-    rc = PVFS_sys_create(entry_name, *parent_ref, attr, req->credentials, 
-                         new_dist, &resp_create, NULL, hints);
+  apr_md5_final(md5, &md5_ctx);
+  etag = apr_psprintf(req->pool, "%s-%d", 
+                      orangefs_s3_bin_to_hex(req->pool, md5, 
+                                             APR_MD5_DIGESTSIZE),
+                      parts->nelts);
+
+  PVFS_hint_import_env(&hints);
+
+  if (contiguous) {
+    /* the parts are already in place */
+    final_name = upload_id;
+    final_ref = ref;
+    rc = PVFS_sys_truncate(final_ref, total, req->credentials, NULL);
     if (rc < 0) {
       ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
-                   "PVFS_sys_create returned %d.", rc);
+                   "PVFS_sys_truncate returned %d.", rc);
+      return HTTP_INTERNAL_SERVER_ERROR;
+    }
+  } else {
+    final_name = apr_pstrcat(req->pool, upload_id, ".complete", NULL);
+    rc = orangefs_s3_upload_create(req, &dir_ref, final_name, hints, 
+                                   &final_ref);
+    if (rc < 0) {
       return HTTP_INTERNAL_SERVER_ERROR;
     }
 
-    ref = &resp_create.ref;
-  }
-
-  /* now we need to write the PUT/POST data */
-  memset(md5, 0, APR_MD5_DIGESTSIZE);
-  rc = orangefs_s3_write_post_data_ref(req, ref, hints, &size, md5);
+    orangefs_s3_writer_init(&w, req, &final_ref, hints, 0);
+    buffer = apr_palloc(req->pool, w.buffer_size);
+
+    for (i = 0, rc = 0; i < parts->nelts && rc == 0; i++) {
+      src_ref = ref;
+      if (spilled[i]) {
+        memset(&resp_lookup, 0, sizeof(PVFS_sysresp_lookup));
+        rc = PVFS_sys_ref_lookup(req->conf->fsid, 
+                                 apr_psprintf(req->pool, "%s.%d", upload_id, 
+                                              ((int *)parts->elts)[i]),
+                                 dir_ref, req->credentials, &resp_lookup, 
+                                 PVFS2_LOOKUP_LINK_NO_FOLLOW, NULL);
+        if (rc < 0) {
+          break;
+        }
+        src_ref = resp_lookup.ref;
+      }
+      rc = orangefs_s3_copy_part(req, &src_ref, offsets[i], sizes[i], 
+                                 buffer, &w);
+    }
 
-  /* convert md5sum to hex string */
-  {
-    char hexval[16] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 
-                        'a', 'b', 'c', 'd', 'e', 'f' };
-  
-    memset(tmp, 0, APR_MD5_DIGESTSIZE*2+1); 
-    for (i = 0; i < APR_MD5_DIGESTSIZE; i++) {
-      tmp[i*2] = hexval[(md5[i] >> 4) & 0xf];
-      tmp[(i*2)+1] = hexval[md5[i] & 0x0f];
+    ret = orangefs_s3_writer_finish(&w);
+    if (rc < 0 || ret < 0) {
+      ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                   "Unable to assemble upload %s.", upload_id);
+      PVFS_sys_remove(final_name, dir_ref, req->credentials, NULL);
+      return HTTP_INTERNAL_SERVER_ERROR;
     }
   }
 
-  key.buffer = (void*)EXT_ATTR_S3_ENTITY_TAG;
-  key.buffer_sz = strlen(key.buffer) + 1;
-  val.buffer = tmp;
-  val.buffer_sz = strlen(val.buffer) + 1;
+  orangefs_s3_set_object_attrs(req, &final_ref, etag, total);
 
-  rc = PVFS_sys_seteattr(*ref, req->credentials, &key, &val, 0, NULL);
-  if (rc < 0) {
+  /* move the object into its bucket, replacing any older version */
+  orangefs_s3_split_path(req, bucket, path, &parent_path, &entry_name);
 
+  parent_ref = orangefs_s3_mkdir_p(req, req->conf->fsid, parent_path);
+  if (parent_ref == NULL) {
+    ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                 "Unable to get or create parent directory %s", parent_path);
+    return HTTP_INTERNAL_SERVER_ERROR;
   }
- 
-  /* write out etag response header */
-  apr_table_setn(req->r->headers_out, "ETag", 
-                 apr_pstrcat(req->pool, "\"", tmp, "\"", NULL));
 
-  key.buffer = (void*)EXT_ATTR_S3_SIZE;
-  key.buffer_sz = strlen(key.buffer) + 1;
-  sprintf(tmp, "%lu", size);
-  val.buffer = tmp;
-  val.buffer_sz = strlen(val.buffer) + 1;
+  PVFS_sys_remove(entry_name, *parent_ref, req->credentials, NULL);
 
-  rc = PVFS_sys_seteattr(*ref, req->credentials, &key, &val, 0, NULL);
+  rc = PVFS_sys_rename(final_name, dir_ref, entry_name, *parent_ref, 
+                       req->credentials, NULL);
   if (rc < 0) {
+    ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                 "PVFS_sys_rename returned %d.", rc);
+    return HTTP_INTERNAL_SERVER_ERROR;
+  }
 
+  /* clean up the upload */
+  if (contiguous) {
+    for (i = 0; i < parts->nelts; i++) {
+      orangefs_s3_del_xattr(req, &final_ref, 
+                            apr_psprintf(req->pool, "%s%d", 
+                                         EXT_ATTR_S3_UPLOAD_PART, 
+                                         ((int *)parts->elts)[i]));
+    }
+    orangefs_s3_del_xattr(req, &final_ref, EXT_ATTR_S3_UPLOAD_STRIDE);
+    orangefs_s3_del_xattr(req, &final_ref, EXT_ATTR_S3_UPLOAD_KEY);
+  } else {
+    PVFS_sys_remove(upload_id, dir_ref, req->credentials, NULL);
+  }
+  for (i = 0; i < parts->nelts; i++) {
+    if (spilled[i]) {
+      PVFS_sys_remove(apr_psprintf(req->pool, "%s.%d", upload_id, 
+                                   ((int *)parts->elts)[i]),
+                      dir_ref, req->credentials, NULL);
+    }
   }
 
-  key.buffer = (void*)EXT_ATTR_S3_OWNER_ID;
-  key.buffer_sz = strlen(key.buffer) + 1;
-  val.buffer = apr_pcalloc(req->pool, BUFSIZ);
-  sprintf(val.buffer, "%d", req->credentials->userid);
-  val.buffer_sz = strlen(val.buffer) + 1;
+  ap_rprintf(req->r, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>");
+  ap_rprintf(req->r, "<CompleteMultipartUploadResult xmlns=\"http://s3.amazonaws.com/doc/2006-03-01/\">");
+  ap_rprintf(req->r,   "<Location>%s</Location>", req->r->uri);
+  ap_rprintf(req->r,   "<Bucket>%s</Bucket>", bucket);
+  ap_rprintf(req->r,   "<Key>%s</Key>", path + 1);
+  ap_rprintf(req->r,   "<ETag>\"%s\"</ETag>", etag);
+  ap_rprintf(req->r, "</CompleteMultipartUploadResult>");
 
-  rc = PVFS_sys_seteattr(*ref, req->credentials, &key, &val, 0, NULL);
-  if (rc < 0) {
+  return OK;
+}
+
+static int orangefs_s3_abort_upload(orangefs_s3_request *req, 
+                                    char *bucket, 
+                                    char *path,
+                                    char *upload_id)
+{
+  PVFS_object_ref dir_ref, ref;
+  PVFS_sysresp_readdir resp_readdir;
+  PVFS_ds_position token = PVFS_READDIR_START;
+  apr_array_header_t *names;
+  char *prefix;
+  int i, rc;
 
+  if (debug_orangefs_s3) {
+    ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                 "orangefs_s3_abort_upload %s for bucket %s path %s.", 
+                 upload_id, bucket, path);
   }
 
-  key.buffer = (void*)EXT_ATTR_S3_OWNER_DISPLAY_NAME;
-  key.buffer_sz = strlen(key.buffer) + 1;
-  val.buffer = req->cn;
-  val.buffer_sz = strlen(val.buffer) + 1;
+  rc = orangefs_s3_upload_lookup(req, bucket, path, upload_id, 
+                                 &dir_ref, &ref);
+  if (rc != OK) {
+    return rc;
+  }
 
-  rc = PVFS_sys_seteattr(*ref, req->credentials, &key, &val, 0, NULL);
-  if (rc < 0) {
+  /* find the files parts were spilled to before removing anything */
+  names = apr_array_make(req->pool, 16, sizeof(char *));
+  prefix = apr_pstrcat(req->pool, upload_id, ".", NULL);
+  do {
+    memset(&resp_readdir, 0, sizeof(PVFS_sysresp_readdir));
+    rc = PVFS_sys_readdir(dir_ref, token, 60, req->root, &resp_readdir, NULL);
+    if (rc < 0) {
+      ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                   "PVFS_sys_readdir returned %d.", rc);
+      break;
+    }
+    for (i = 0; i < resp_readdir.pvfs_dirent_outcount; i++) {
+      if (strncmp(resp_readdir.dirent_array[i].d_name, prefix, 
+                  strlen(prefix)) == 0) {
+        *(char **)apr_array_push(names) = 
+          apr_pstrdup(req->pool, resp_readdir.dirent_array[i].d_name);
+      }
+    }
+    token = resp_readdir.token;
+    if (resp_readdir.dirent_array) {
+      free(resp_readdir.dirent_array);
+    }
+  } while (resp_readdir.pvfs_dirent_outcount > 0 && 
+           token != PVFS_READDIR_END);
+
+  for (i = 0; i < names->nelts; i++) {
+    PVFS_sys_remove(((char **)names->elts)[i], dir_ref, req->credentials, 
+                    NULL);
+  }
 
+  rc = PVFS_sys_remove(upload_id, dir_ref, req->credentials, NULL);
+  if (rc < 0) {
+    ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                 "PVFS_sys_remove returned %d.", rc);
+    return HTTP_INTERNAL_SERVER_ERROR;
   }
 
   return OK;
 }
 
+/* dispatches the multipart upload requests on an object */
+static int orangefs_s3_multipart(orangefs_s3_request *req, 
+                                 char *bucket, 
+                                 char *path)
+{
+  char *upload_id = orangefs_s3_param(req, "uploadId");
+  char *part = orangefs_s3_param(req, "partNumber");
+
+  if (req->r->method_number == M_POST && orangefs_s3_param(req, "uploads")) {
+    return orangefs_s3_initiate_upload(req, bucket, path);
+  } else if (req->r->method_number == M_PUT && upload_id && part) {
+    return orangefs_s3_put_object_part(req, bucket, path, upload_id, part);
+  } else if (req->r->method_number == M_POST && upload_id) {
+    return orangefs_s3_complete_upload(req, bucket, path, upload_id);
+  } else if (req->r->method_number == M_DELETE && upload_id) {
+    return orangefs_s3_abort_upload(req, bucket, path, upload_id);
+  }
+
+  return HTTP_METHOD_NOT_ALLOWED;
+}
+
 static int orangefs_s3_get_object(orangefs_s3_request *req, 
                                   char *bucket, 
                                   char *path)
 {
   char *entry_path;
   PVFS_sysresp_lookup resp_lookup;
-  PVFS_Request mem_req, file_req;
-  PVFS_sysresp_io resp_io;
+  PVFS_sysresp_getattr resp_getattr;
   PVFS_object_ref *ref;
   PVFS_hint hints = NULL;
   PVFS_ds_keyval k, v;
+  PVFS_offset offset = 0;
+  PVFS_size length = -1;
+  orangefs_stream stream;
   char buffer[4096];
   char buffer2[256];
-  size_t offset = 0;
   int rc;
 
   if (debug_orangefs_s3) {
@@ -921,18 +1992,32 @@ static int orangefs_s3_get_object(orangefs_s3_request *req,
   ref = &resp_lookup.ref;
   PVFS_hint_import_env(&hints);
 
-  k.buffer = (void*)EXT_ATTR_S3_SIZE;
-  k.buffer_sz = strlen(k.buffer) + 1;
-  v.buffer = buffer;
-  v.buffer_sz = 4096;
+  memset(&resp_getattr, 0, sizeof(PVFS_sysresp_getattr));
+  rc = PVFS_sys_getattr(*ref, PVFS_ATTR_SYS_SIZE, req->credentials, 
+                        &resp_getattr, NULL);
+  if (rc == 0 && (resp_getattr.attr.mask & PVFS_ATTR_SYS_SIZE)) {
+    ap_set_content_length(req->r, resp_getattr.attr.size);
+
+    /* a single range is read on its own, see orangefs_stream_range */
+    rc = orangefs_stream_range(req->r, resp_getattr.attr.size, 
+                               &offset, &length);
+    if (rc < 0) {
+      return HTTP_RANGE_NOT_SATISFIABLE;
+    }
+  } else {
+    k.buffer = (void*)EXT_ATTR_S3_SIZE;
+    k.buffer_sz = strlen(k.buffer) + 1;
+    v.buffer = buffer;
+    v.buffer_sz = 4096;
 
-  memset(buffer, 0, 4096);
-  rc = PVFS_sys_geteattr(resp_lookup.ref, req->credentials, &k, &v, NULL);
-  if (rc >= 0) {
-    memset(buffer2, 0, 256);
-    memcpy(buffer2, buffer, v.read_sz);
-    apr_table_setn(req->r->headers_out, "Content-Length", 
-                   apr_pstrdup(req->pool, (char*)buffer2));
+    memset(buffer, 0, 4096);
+    rc = PVFS_sys_geteattr(resp_lookup.ref, req->credentials, &k, &v, NULL);
+    if (rc >= 0) {
+      memset(buffer2, 0, 256);
+      memcpy(buffer2, buffer, v.read_sz);
+      apr_table_setn(req->r->headers_out, "Content-Length", 
+                     apr_pstrdup(req->pool, (char*)buffer2));
+    }
   }
 
   k.buffer = (void*)EXT_ATTR_S3_ENTITY_TAG;
@@ -948,35 +2033,22 @@ static int orangefs_s3_get_object(orangefs_s3_request *req,
     apr_table_setn(req->r->headers_out, "ETag", 
                    apr_pstrcat(req->pool, "\"", (char*)buffer2, "\"", NULL));
   }
+  apr_table_setn(req->r->headers_out, "Accept-Ranges", "bytes");
 
   /* if it's a HEAD request, return without content */
   if (strcmp(req->r->method, "HEAD") == 0) {
     return OK;
   }
 
-  do {
-    file_req = PVFS_BYTE;
-    rc = PVFS_Request_contiguous(4096, PVFS_BYTE, &mem_req);
-    if (rc < 0) {
-      ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
-                   "PVFS_Request_contiguous returned rc %d.", rc);
-      return HTTP_INTERNAL_SERVER_ERROR;
-    }
-
-    rc = PVFS_sys_read(*ref, file_req, offset, buffer, mem_req, 
-                       req->credentials, &resp_io, hints);
-    if (rc < 0) {
-      ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
-                   "PVFS_sys_read returned rc %d.", rc);
-      return HTTP_INTERNAL_SERVER_ERROR;
-    }
-
-    offset += resp_io.total_completed;
-
-    ap_rwrite(buffer, resp_io.total_completed, req->r);
-  } while (resp_io.total_completed > 0);
-
-  PVFS_Request_free(&mem_req);
+  orangefs_stream_init(&stream, ref, req->credentials, hints, offset, length,
+                       S3_READ_BUFFER_SIZE, req->conf->readAhead);
+  rc = orangefs_stream_deliver(&stream, req->r, req->r->output_filters);
+  if (rc < 0) {
+    ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, 
+                 "Unable to read object %s, rc %d.", entry_path, rc);
+    /* the status line may already be out, all we can do is cut it short */
+    req->r->connection->keepalive = AP_CONN_CLOSE;
+  }
 
   return OK;
 }
@@ -1699,7 +2771,10 @@ static int orangefs_s3(orangefs_s3_request *req)
                      "Processing s3 object request for bucket %s, object %s.", 
                      bucket, path);
 
-        if (req->r->method_number == M_GET) {
+        if (orangefs_s3_param(req, "uploads") || 
+            orangefs_s3_param(req, "uploadId")) {
+          rc = orangefs_s3_multipart(req, bucket, path);
+        } else if (req->r->method_number == M_GET) {
           rc = orangefs_s3_get_object(req, bucket, path);
         } else if (req->r->method_number == M_PUT) {
           rc = orangefs_s3_put_object(req, bucket, path);
@@ -1739,7 +2814,10 @@ static int orangefs_s3(orangefs_s3_request *req)
                    "Processing s3 object request for bucket %s, object %s.", 
                    bucket, req->r->uri);
 
-      if (req->r->method_number == M_GET) {
+      if (orangefs_s3_param(req, "uploads") || 
+          orangefs_s3_param(req, "uploadId")) {
+        rc = orangefs_s3_multipart(req, bucket, req->r->uri);
+      } else if (req->r->method_number == M_GET) {
         rc = orangefs_s3_get_object(req, bucket, req->r->uri);
       } else if (req->r->method_number == M_PUT) {
         /* check if this a PUT/copy or just a PUT by checking the 
@@ -2204,6 +3282,7 @@ static void* orangefs_s3_create_srv_config(apr_pool_t *pool, server_rec *srv)
   ret->bucket_root = NULL;
   ret->awsAccounts = NULL;
   ret->PVFSInit = apr_pstrdup(pool,ON);
+  ret->readAhead = ORANGEFS_STREAM_DEPTH;
 
   return (void *)ret;
 }
@@ -2232,6 +3311,10 @@ static void *orangefs_s3_merge_srv_config(apr_pool_t *p,
                      b->PVFSInit :
                      v->PVFSInit;
 
+  b->readAhead = (v->readAhead == ORANGEFS_STREAM_DEPTH) ? 
+                     b->readAhead :
+                     v->readAhead;
+
   return b;
 }
 
@@ -2303,6 +3386,27 @@ static const char* orangefs_s3_setDisplayName(cmd_parms *cmd, void *cfg,
   return NULL;
 }
 
+static const char* orangefs_s3_setReadAhead(cmd_parms *cmd, void *cfg,
+                                            const char *readAhead)
+{
+  server_rec *s = cmd->server;
+  orangefs_s3_config *conf = 
+    (orangefs_s3_config *)ap_get_module_config(s->module_config, 
+                                               &orangefs_s3_module);
+
+  if (debug_orangefs_s3) {
+    ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL, "orangefs_s3_setReadAhead:");
+  }
+
+  conf->readAhead = atoi(readAhead);
+  if (conf->readAhead < 1 || conf->readAhead > ORANGEFS_STREAM_MAX_DEPTH) {
+    return apr_psprintf(cmd->pool, "ReadAhead must be between 1 and %d",
+                        ORANGEFS_STREAM_MAX_DEPTH);
+  }
+
+  return NULL;
+}
+
 static const char* orangefs_s3_addAWSAccount(cmd_parms *cmd, void *cfg,
 			    const char *args)
 {
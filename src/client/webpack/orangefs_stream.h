@@ -0,0 +1,395 @@
+/*
+ * See COPYING in top-level directory.
+ */
+
+/*
+   orangefs_stream.h
+
+   Streaming reads shared by the S3 and WebDAV modules.  A stream keeps
+   a number of stripe aligned reads of an object in flight and hands
+   them out in file order, so the file system is read while the last
+   buffer is on its way to the client.  A buffer handed out belongs to
+   the caller, orangefs_stream_deliver gives it to a heap bucket, so the
+   output filters send it without another copy.
+
+   Each module is its own shared object, so everything here is static.
+ */
+
+#ifndef ORANGEFS_STREAM_H
+#define ORANGEFS_STREAM_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <pvfs2.h>
+#include <pvfs2-types.h>
+#include <pvfs2-sysint.h>
+#include <pvfs2-request.h>
+
+#include <apr_strings.h>
+#include <apr_buckets.h>
+#include <httpd.h>
+#include <http_protocol.h>
+#include <http_log.h>
+#include <util_filter.h>
+
+/* reads kept in flight unless the module is configured otherwise */
+#define ORANGEFS_STREAM_DEPTH 4
+#define ORANGEFS_STREAM_MAX_DEPTH 32
+
+/* end of a stream that runs to the end of the file */
+#define ORANGEFS_STREAM_EOF ((PVFS_offset)0x7fffffffffffffffLL)
+
+typedef struct {
+  char *buf;
+  apr_size_t len;
+  PVFS_Request mem_req;
+  PVFS_sysresp_io resp;
+  PVFS_sys_op_id op_id;
+  int busy;
+  int error;
+} orangefs_stream_read;
+
+typedef struct {
+  PVFS_object_ref ref;
+  PVFS_credential *credential;
+  PVFS_hint hints;
+  apr_size_t buffer_size;
+  int depth;
+  /* reads[head] is handed out next, count reads are queued behind it */
+  orangefs_stream_read reads[ORANGEFS_STREAM_MAX_DEPTH];
+  int head;
+  int count;
+  PVFS_offset next;
+  PVFS_offset end;
+  int eof;
+} orangefs_stream;
+
+/*
+   Sets up a stream over length bytes of ref from offset, or up to the
+   end of the file if length is negative.  The buffer size is rounded up
+   to a multiple of the file's stripe width.
+ */
+static void orangefs_stream_init(orangefs_stream *s,
+                                 PVFS_object_ref *ref,
+                                 PVFS_credential *credential,
+                                 PVFS_hint hints,
+                                 PVFS_offset offset,
+                                 PVFS_size length,
+                                 apr_size_t buffer_size,
+                                 int depth)
+{
+  PVFS_sysresp_getattr resp_getattr;
+  PVFS_size width;
+
+  memset(s, 0, sizeof(orangefs_stream));
+  s->ref = *ref;
+  s->credential = credential;
+  s->hints = hints;
+  s->next = offset;
+  s->end = (length < 0) ? ORANGEFS_STREAM_EOF : offset + length;
+
+  if (depth < 1) {
+    depth = ORANGEFS_STREAM_DEPTH;
+  }
+  s->depth = (depth > ORANGEFS_STREAM_MAX_DEPTH) ?
+             ORANGEFS_STREAM_MAX_DEPTH : depth;
+
+  if (buffer_size == 0) {
+    buffer_size = 1048576;
+  }
+  memset(&resp_getattr, 0, sizeof(PVFS_sysresp_getattr));
+  if (PVFS_sys_getattr(*ref, PVFS_ATTR_SYS_BLKSIZE, credential,
+                       &resp_getattr, NULL) == 0 &&
+      (resp_getattr.attr.mask & PVFS_ATTR_SYS_BLKSIZE) &&
+      resp_getattr.attr.blksize > 0) {
+    width = resp_getattr.attr.blksize;
+    buffer_size = ((buffer_size + width - 1) / width) * width;
+  }
+  s->buffer_size = buffer_size;
+}
+
+/* posts reads until depth of them are queued */
+static int orangefs_stream_post(orangefs_stream *s)
+{
+  orangefs_stream_read *rd;
+  apr_size_t len;
+  int rc;
+
+  while (s->count < s->depth && s->next < s->end && !s->eof) {
+    rd = &s->reads[(s->head + s->count) % s->depth];
+
+    /* end each read on a stripe boundary */
+    len = s->buffer_size - (apr_size_t)(s->next % s->buffer_size);
+    if ((PVFS_size)len > s->end - s->next) {
+      len = (apr_size_t)(s->end - s->next);
+    }
+
+    rd->buf = malloc(len);
+    if (!rd->buf) {
+      return -PVFS_ENOMEM;
+    }
+    rd->len = len;
+    rd->error = 0;
+
+    rc = PVFS_Request_contiguous(len, PVFS_BYTE, &rd->mem_req);
+    if (rc < 0) {
+      free(rd->buf);
+      rd->buf = NULL;
+      return rc;
+    }
+
+    memset(&rd->resp, 0, sizeof(PVFS_sysresp_io));
+    rc = PVFS_isys_read(s->ref, PVFS_BYTE, s->next, rd->buf, rd->mem_req,
+                        s->credential, &rd->resp, &rd->op_id, s->hints, NULL);
+    if (rc < 0) {
+      ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL,
+                   "orangefs_stream_post: PVFS_isys_read returned %d.", rc);
+      PVFS_Request_free(&rd->mem_req);
+      free(rd->buf);
+      rd->buf = NULL;
+      return rc;
+    }
+
+    if (rd->op_id == -1) {
+      /* completed at once */
+      PVFS_Request_free(&rd->mem_req);
+      rd->busy = 0;
+    } else {
+      rd->busy = 1;
+    }
+
+    s->next += len;
+    s->count++;
+  }
+
+  return 0;
+}
+
+/*
+   Waits for the oldest queued read still in flight.  Reads are handed
+   out in file order, so nothing is gained by reaping a later one first,
+   and other threads' operations must be left to them.
+ */
+static int orangefs_stream_reap(orangefs_stream *s)
+{
+  orangefs_stream_read *rd;
+  int error = 0, i, rc;
+
+  for (i = 0; i < s->count; i++) {
+    rd = &s->reads[(s->head + i) % s->depth];
+    if (rd->busy) {
+      break;
+    }
+  }
+  if (i == s->count) {
+    return 0;
+  }
+
+  rc = PVFS_sys_wait(rd->op_id, "read", &error);
+  PVFS_sys_release(rd->op_id);
+  rd->busy = 0;
+  rd->error = (rc < 0) ? rc : error;
+  PVFS_Request_free(&rd->mem_req);
+
+  return 0;
+}
+
+/*
+   Returns the next buffer of the stream in *buf, which the caller must
+   free(), and its length in *len.  *len is 0 at the end of the stream.
+ */
+static int orangefs_stream_next(orangefs_stream *s, char **buf,
+                                apr_size_t *len)
+{
+  orangefs_stream_read *rd;
+  int rc;
+
+  *buf = NULL;
+  *len = 0;
+
+  if (s->eof) {
+    return 0;
+  }
+
+  rc = orangefs_stream_post(s);
+  if (rc < 0) {
+    return rc;
+  }
+  if (s->count == 0) {
+    return 0;
+  }
+
+  rd = &s->reads[s->head];
+  while (rd->busy) {
+    rc = orangefs_stream_reap(s);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+  s->head = (s->head + 1) % s->depth;
+  s->count--;
+
+  if (rd->error < 0) {
+    ap_log_error(APLOG_MARK,APLOG_ERR,0,NULL,
+                 "orangefs_stream_next: read failed, rc=%d.", rd->error);
+    free(rd->buf);
+    rd->buf = NULL;
+    return rd->error;
+  }
+
+  if (rd->resp.total_completed < (PVFS_size)rd->len) {
+    /* anything queued behind a short read is past the end of the file */
+    s->eof = 1;
+  }
+
+  if (rd->resp.total_completed > 0) {
+    *buf = rd->buf;
+    *len = (apr_size_t)rd->resp.total_completed;
+  } else {
+    free(rd->buf);
+  }
+  rd->buf = NULL;
+
+  /* keep the pipeline full while the caller uses this buffer; an error
+     here shows up on the next call
+   */
+  orangefs_stream_post(s);
+  return 0;
+}
+
+/* waits for the reads still queued and frees their buffers */
+static void orangefs_stream_close(orangefs_stream *s)
+{
+  orangefs_stream_read *rd;
+  int i, busy;
+
+  do {
+    busy = 0;
+    for (i = 0; i < s->count; i++) {
+      busy |= s->reads[(s->head + i) % s->depth].busy;
+    }
+  } while (busy && orangefs_stream_reap(s) == 0);
+
+  for (i = 0; i < s->count; i++) {
+    rd = &s->reads[(s->head + i) % s->depth];
+    /* a read that could not be reaped still owns its buffer */
+    if (rd->buf && !rd->busy) {
+      free(rd->buf);
+      rd->buf = NULL;
+    }
+  }
+  s->count = 0;
+}
+
+/*
+   Passes the whole stream down the output filters and closes it.
+ */
+static int orangefs_stream_deliver(orangefs_stream *s,
+                                   request_rec *r,
+                                   ap_filter_t *output)
+{
+  apr_bucket_brigade *bb;
+  apr_bucket *b;
+  apr_size_t len;
+  char *buf;
+  int rc;
+
+  bb = apr_brigade_create(r->pool, r->connection->bucket_alloc);
+
+  for (;;) {
+    rc = orangefs_stream_next(s, &buf, &len);
+    if (rc < 0 || len == 0) {
+      break;
+    }
+
+    /* the bucket takes the buffer over */
+    b = apr_bucket_heap_create(buf, len, free, r->connection->bucket_alloc);
+    APR_BRIGADE_INSERT_TAIL(bb, b);
+
+    if (ap_pass_brigade(output, bb) != APR_SUCCESS) {
+      /* most likely the client went away */
+      rc = -PVFS_EIO;
+      break;
+    }
+    apr_brigade_cleanup(bb);
+  }
+
+  apr_brigade_destroy(bb);
+  orangefs_stream_close(s);
+
+  return rc;
+}
+
+/*
+   Looks at the Range header of a GET of an object of size bytes.  A
+   single range is served by the module: the status, Content-Range and
+   Content-Length are set, its start and length returned, and so is 1.
+   Otherwise 0 is returned and the whole object should be sent, which
+   leaves multiple ranges to Apache's byterange filter.  -1 means the
+   range cannot be satisfied.
+ */
+static int orangefs_stream_range(request_rec *r,
+                                 PVFS_size size,
+                                 PVFS_offset *start,
+                                 PVFS_size *length)
+{
+  const char *range = apr_table_get(r->headers_in, "Range");
+  apr_off_t first, last;
+  char *end;
+
+  if (!range || r->status != HTTP_OK ||
+      apr_table_get(r->headers_in, "If-Range") ||
+      strncasecmp(range, "bytes=", 6) != 0 || strchr(range, ',')) {
+    return 0;
+  }
+
+  range += 6;
+  while (*range == ' ') {
+    range++;
+  }
+
+  if (*range == '-') {
+    /* the last n bytes */
+    if (apr_strtoff(&last, range + 1, &end, 10) != APR_SUCCESS ||
+        *end || last <= 0) {
+      return 0;
+    }
+    first = (last < size) ? size - last : 0;
+    last = size - 1;
+  } else {
+    if (apr_strtoff(&first, range, &end, 10) != APR_SUCCESS ||
+        *end != '-' || first < 0) {
+      return 0;
+    }
+    if (end[1] == '\0') {
+      last = size - 1;
+    } else if (apr_strtoff(&last, end + 1, &end, 10) != APR_SUCCESS ||
+               *end || last < first) {
+      return 0;
+    }
+    if (last >= size) {
+      last = size - 1;
+    }
+  }
+
+  if (first >= size) {
+    apr_table_setn(r->headers_out, "Content-Range",
+                   apr_psprintf(r->pool, "bytes */%lld", (long long)size));
+    return -1;
+  }
+
+  r->status = HTTP_PARTIAL_CONTENT;
+  apr_table_setn(r->headers_out, "Content-Range",
+                 apr_psprintf(r->pool, "bytes %lld-%lld/%lld",
+                              (long long)first, (long long)last,
+                              (long long)size));
+  ap_set_content_length(r, last - first + 1);
+
+  *start = first;
+  *length = last - first + 1;
+  return 1;
+}
+
+#endif /* ORANGEFS_STREAM_H */
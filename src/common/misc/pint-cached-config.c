@@ -46,6 +46,18 @@ struct handle_lookup_entry
     PVFS_BMI_addr_t server_addr;
 };
 
+/* what the weighted placement policy knows about one server; kept in
+ * the same order as server_array
+ */
+struct placement_stat
+{
+    int valid;                  /* has answered a statfs */
+    PVFS_size bytes_available;
+    PVFS_size bytes_total;
+    int64_t active_requests;    /* request scheduler depth, -1 unknown */
+    int pending;                /* objects placed here since refresh */
+};
+
 struct config_fs_cache_s
 {
     struct qlist_head hash_link;
@@ -75,6 +87,10 @@ struct config_fs_cache_s
 
     struct handle_lookup_entry* handle_lookup_table;
     int handle_lookup_table_size;
+
+    /* per server statistics for the weighted placement policy */
+    struct placement_stat *server_stats;
+    time_t placement_refreshed;
 };
 
 struct qhash_table *PINT_fsid_config_cache_table = NULL;
@@ -90,6 +106,16 @@ static const struct handle_lookup_entry* find_handle_lookup_entry(
                                                      PVFS_fs_id fsid);
 static int load_handle_lookup_table(
                        struct config_fs_cache_s *cur_config_fs_cache);
+static int placement_weights(struct config_fs_cache_s *cur_config_cache,
+                             PINT_llist *server_list,
+                             double *weights,
+                             int *stat_index);
+static int placement_pick(double *weights, int count);
+static int map_servers_weighted(struct config_fs_cache_s *cur_config_cache,
+                                int ordered,
+                                int *inout_num_datafiles,
+                                PVFS_BMI_addr_t *addr_array,
+                                PVFS_handle_extent_array *handle_extent_array);
 
 /* removed by WBL when selection algorithm rewritten 
 static int meta_randomized = 0;
@@ -235,6 +261,7 @@ int PINT_cached_config_finalize(void)
                 }
 
                 free(cur_config_cache->handle_lookup_table);
+                free(cur_config_cache->server_stats);
 
                 free(cur_config_cache);
             }
@@ -445,6 +472,8 @@ int PINT_cached_config_get_next_meta(PVFS_fs_id fsid,
     struct host_handle_mapping_s *cur_mapping = NULL;
     struct qlist_head *hash_link = NULL;
     struct config_fs_cache_s *cur_config_cache = NULL;
+    double *weights = NULL;
+    int *stat_index = NULL;
 
     if (!ext_array)
     {
@@ -469,7 +498,30 @@ int PINT_cached_config_get_next_meta(PVFS_fs_id fsid,
     num_meta_servers = PINT_llist_count(
                                   cur_config_cache->fs->meta_handle_ranges);
 
-    randsrv = (rand() % num_meta_servers);
+    randsrv = -1;
+    if (cur_config_cache->fs->placement_policy == PINT_PLACEMENT_WEIGHTED)
+    {
+        weights = (double *)malloc(num_meta_servers * sizeof(double));
+        stat_index = (int *)malloc(num_meta_servers * sizeof(int));
+        if (weights && stat_index &&
+            placement_weights(cur_config_cache,
+                              cur_config_cache->fs->meta_handle_ranges,
+                              weights, stat_index) == 0)
+        {
+            randsrv = placement_pick(weights, num_meta_servers);
+            if (randsrv >= 0 && stat_index[randsrv] >= 0)
+            {
+                cur_config_cache->server_stats[
+                                stat_index[randsrv]].pending++;
+            }
+        }
+        free(weights);
+        free(stat_index);
+    }
+    if (randsrv < 0)
+    {
+        randsrv = (rand() % num_meta_servers);
+    }
 
     /* set cursor at beginning of list */
     cur_config_cache->meta_server_cursor =
@@ -606,6 +658,27 @@ int PINT_cached_config_map_servers(
     server_list_head = cur_config_cache->fs->data_handle_ranges;
     num_io_servers = PINT_llist_count(server_list_head);
 
+    /* the weighted policy replaces the random choices below; layouts
+     * that name their servers are left alone
+     */
+    if (cur_config_cache->fs->placement_policy == PINT_PLACEMENT_WEIGHTED &&
+        (layout->algorithm == PVFS_SYS_LAYOUT_ROUND_ROBIN ||
+         layout->algorithm == PVFS_SYS_LAYOUT_RANDOM ||
+         (layout->algorithm == PVFS_SYS_LAYOUT_LOCAL &&
+          !cur_config_cache->data_local_alias)))
+    {
+        ret = map_servers_weighted(
+                        cur_config_cache,
+                        (layout->algorithm != PVFS_SYS_LAYOUT_RANDOM),
+                        inout_num_datafiles,
+                        addr_array,
+                        handle_extent_array);
+        if (ret != -PVFS_EAGAIN)
+        {
+            return ret;
+        }
+    }
+
     switch(layout->algorithm)
     {
     case PVFS_SYS_LAYOUT_LIST:
@@ -832,6 +905,356 @@ int PINT_cached_config_map_servers(
     return 0;
 }
 
+/* map_servers_weighted()
+ *
+ * chooses *inout_num_datafiles distinct I/O servers for the weighted
+ * placement policy, favoring those with more free space and fewer
+ * active requests.  If "ordered" is set the servers keep their order
+ * in the server list, starting with the first one picked, as the round
+ * robin layout does.
+ *
+ * returns 0 on success, -PVFS_EAGAIN if no statistics can be used (the
+ * caller falls back to the plain layouts), -errno on failure
+ */
+static int map_servers_weighted(struct config_fs_cache_s *cur_config_cache,
+                                int ordered,
+                                int *inout_num_datafiles,
+                                PVFS_BMI_addr_t *addr_array,
+                                PVFS_handle_extent_array *handle_extent_array)
+{
+    PINT_llist *server_list = cur_config_cache->fs->data_handle_ranges;
+    struct host_handle_mapping_s **servers = NULL;
+    struct host_handle_mapping_s *sv = NULL;
+    double *weights = NULL;
+    int *stat_index = NULL;
+    int *chosen = NULL;
+    int num_io_servers, i, j, df, ret;
+    int first = 0, first_pick, tmp;
+
+    num_io_servers = PINT_llist_count(server_list);
+    if(num_io_servers < *inout_num_datafiles)
+    {
+        *inout_num_datafiles = num_io_servers;
+    }
+
+    servers = (struct host_handle_mapping_s **)malloc(
+                    num_io_servers * sizeof(struct host_handle_mapping_s *));
+    weights = (double *)malloc(num_io_servers * sizeof(double));
+    stat_index = (int *)malloc(num_io_servers * sizeof(int));
+    chosen = (int *)malloc(*inout_num_datafiles * sizeof(int));
+    if (!servers || !weights || !stat_index || !chosen)
+    {
+        ret = -PVFS_ENOMEM;
+        goto out;
+    }
+
+    ret = placement_weights(cur_config_cache, server_list,
+                            weights, stat_index);
+    if (ret < 0)
+    {
+        ret = -PVFS_EAGAIN;
+        goto out;
+    }
+
+    for (i = 0; i < num_io_servers; i++)
+    {
+        servers[i] = PINT_llist_head(server_list);
+        server_list = PINT_llist_next(server_list);
+    }
+
+    /* used servers get a negative weight so they are not picked twice */
+    for(df = 0; df < *inout_num_datafiles; df++)
+    {
+        i = placement_pick(weights, num_io_servers);
+        if (i < 0)
+        {
+            /* every server left reported no free space; take any */
+            i = rand() % num_io_servers;
+            while (weights[i] < 0)
+            {
+                i = (i + 1) % num_io_servers;
+            }
+        }
+        weights[i] = -1.0;
+        chosen[df] = i;
+    }
+
+    if (ordered)
+    {
+        /* sort by list position, then start at the first one picked */
+        first_pick = chosen[0];
+        for (i = 1; i < *inout_num_datafiles; i++)
+        {
+            tmp = chosen[i];
+            for (j = i; j > 0 && chosen[j - 1] > tmp; j--)
+            {
+                chosen[j] = chosen[j - 1];
+            }
+            chosen[j] = tmp;
+        }
+        while (chosen[first] != first_pick)
+        {
+            first++;
+        }
+    }
+
+    for(df = 0; df < *inout_num_datafiles; df++)
+    {
+        i = chosen[(first + df) % *inout_num_datafiles];
+        sv = servers[i];
+
+        ret = BMI_addr_lookup(&addr_array[df],
+                              sv->alias_mapping->bmi_address,
+                              NULL);
+        if (ret)
+        {
+            goto out;
+        }
+        if(handle_extent_array)
+        {
+            handle_extent_array[df].extent_count =
+                            sv->handle_extent_array.extent_count;
+            handle_extent_array[df].extent_array =
+                            sv->handle_extent_array.extent_array;
+        }
+        if (stat_index[i] >= 0)
+        {
+            cur_config_cache->server_stats[stat_index[i]].pending++;
+        }
+    }
+    ret = 0;
+
+out:
+    free(servers);
+    free(weights);
+    free(stat_index);
+    free(chosen);
+    return ret;
+}
+
+/* placement_weights()
+ *
+ * fills in a weight for each server in server_list: its fraction of
+ * free space divided by one plus its active requests and the objects
+ * this client placed on it since the last refresh.  Servers that have
+ * not reported yet count as half full and idle.  stat_index gets the
+ * index of each server in server_stats, or -1.
+ *
+ * returns 0 on success, -errno on failure
+ */
+static int placement_weights(struct config_fs_cache_s *cur_config_cache,
+                             PINT_llist *server_list,
+                             double *weights,
+                             int *stat_index)
+{
+    struct host_handle_mapping_s *cur_mapping = NULL;
+    struct placement_stat *stat = NULL;
+    double free_frac, load;
+    int i = 0, j, ret;
+
+    ret = cache_server_array(cur_config_cache->fs->coll_id);
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    while ((cur_mapping = PINT_llist_head(server_list)))
+    {
+        server_list = PINT_llist_next(server_list);
+
+        stat_index[i] = -1;
+        for (j = 0; j < cur_config_cache->server_count; j++)
+        {
+            if (!strcmp(cur_config_cache->server_array[j].addr_string,
+                        cur_mapping->alias_mapping->bmi_address))
+            {
+                stat_index[i] = j;
+                break;
+            }
+        }
+
+        free_frac = 0.5;
+        load = 0.0;
+        if (stat_index[i] >= 0)
+        {
+            stat = &cur_config_cache->server_stats[stat_index[i]];
+            if (stat->valid && stat->bytes_total > 0)
+            {
+                free_frac = (double)stat->bytes_available /
+                            (double)stat->bytes_total;
+            }
+            if (stat->active_requests > 0)
+            {
+                load += (double)stat->active_requests;
+            }
+            load += (double)stat->pending;
+        }
+        weights[i] = free_frac / (1.0 + load);
+        i++;
+    }
+    return 0;
+}
+
+/* placement_pick()
+ *
+ * picks an index at random with probability proportional to its
+ * weight; entries with a weight of zero or less are never picked.
+ *
+ * returns the index, or -1 if no entry has a positive weight
+ */
+static int placement_pick(double *weights, int count)
+{
+    double total = 0.0, r;
+    int i, last = -1;
+
+    for (i = 0; i < count; i++)
+    {
+        if (weights[i] > 0.0)
+        {
+            total += weights[i];
+            last = i;
+        }
+    }
+    if (last < 0)
+    {
+        return -1;
+    }
+
+    r = ((double)rand() / ((double)RAND_MAX + 1.0)) * total;
+    for (i = 0; i < count; i++)
+    {
+        if (weights[i] > 0.0)
+        {
+            if (r < weights[i])
+            {
+                return i;
+            }
+            r -= weights[i];
+        }
+    }
+    /* rounding left r past the end */
+    return last;
+}
+
+static struct placement_stat *find_server_stat(PVFS_fs_id fsid,
+                                               PVFS_BMI_addr_t addr)
+{
+    struct qlist_head *hash_link = NULL;
+    struct config_fs_cache_s *cur_config_cache = NULL;
+    int i;
+
+    hash_link = qhash_search(PINT_fsid_config_cache_table, &(fsid));
+    if (!hash_link)
+    {
+        return NULL;
+    }
+    cur_config_cache = qlist_entry(hash_link,
+                                   struct config_fs_cache_s,
+                                   hash_link);
+
+    if (cache_server_array(fsid) < 0)
+    {
+        return NULL;
+    }
+    for (i = 0; i < cur_config_cache->server_count; i++)
+    {
+        if (cur_config_cache->server_array[i].addr == addr)
+        {
+            return &cur_config_cache->server_stats[i];
+        }
+    }
+    return NULL;
+}
+
+/* PINT_cached_config_next_placement_refresh()
+ *
+ * finds a file system using the weighted placement policy whose server
+ * statistics are older than its PlacementRefreshSecs, and marks them
+ * as refreshed now.
+ *
+ * returns 1 and fills in fs_id if one is due, 0 otherwise
+ */
+int PINT_cached_config_next_placement_refresh(PVFS_fs_id *fs_id)
+{
+    struct qlist_head *hash_link = NULL;
+    struct config_fs_cache_s *cur_config_cache = NULL;
+    time_t now;
+    int i;
+
+    if (!PINT_fsid_config_cache_table)
+    {
+        return 0;
+    }
+
+    now = time(NULL);
+    for (i = 0; i < PINT_fsid_config_cache_table->table_size; i++)
+    {
+        qhash_for_each(hash_link, &PINT_fsid_config_cache_table->array[i])
+        {
+            cur_config_cache = qlist_entry(hash_link,
+                                           struct config_fs_cache_s,
+                                           hash_link);
+            if (cur_config_cache->fs->placement_policy ==
+                    PINT_PLACEMENT_WEIGHTED &&
+                (now - cur_config_cache->placement_refreshed) >=
+                    cur_config_cache->fs->placement_refresh_secs)
+            {
+                cur_config_cache->placement_refreshed = now;
+                *fs_id = cur_config_cache->fs->coll_id;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* PINT_cached_config_set_server_space()
+ *
+ * records the free space a server reported for the weighted placement
+ * policy, and forgets what this client placed there since the last
+ * report
+ *
+ * returns 0 on success, -errno on failure
+ */
+int PINT_cached_config_set_server_space(PVFS_fs_id fsid,
+                                        PVFS_BMI_addr_t addr,
+                                        PVFS_size bytes_available,
+                                        PVFS_size bytes_total)
+{
+    struct placement_stat *stat = find_server_stat(fsid, addr);
+
+    if (!stat)
+    {
+        return -PVFS_ENOENT;
+    }
+    stat->valid = 1;
+    stat->bytes_available = bytes_available;
+    stat->bytes_total = bytes_total;
+    stat->pending = 0;
+    return 0;
+}
+
+/* PINT_cached_config_set_server_load()
+ *
+ * records the number of requests a server reported as active in its
+ * request scheduler, for the weighted placement policy
+ *
+ * returns 0 on success, -errno on failure
+ */
+int PINT_cached_config_set_server_load(PVFS_fs_id fsid,
+                                       PVFS_BMI_addr_t addr,
+                                       int64_t active_requests)
+{
+    struct placement_stat *stat = find_server_stat(fsid, addr);
+
+    if (!stat)
+    {
+        return -PVFS_ENOENT;
+    }
+    stat->active_requests = active_requests;
+    return 0;
+}
+
 /* THIS APPEARS TO BE SUPERCEDED BY THE PREVIOUS FUNCTION*/
 #if 0
 /* PINT_cached_config_get_next_io()
@@ -1624,10 +2047,14 @@ static int cache_server_array(PVFS_fs_id fsid)
         cur_config_cache->server_array = (phys_server_desc_s*)malloc(
                         (cur_config_cache->server_count*
                          sizeof(phys_server_desc_s)));
+        cur_config_cache->server_stats = (struct placement_stat*)malloc(
+                        (cur_config_cache->server_count*
+                         sizeof(struct placement_stat)));
 
         if ((cur_config_cache->meta_server_array == NULL) ||
             (cur_config_cache->io_server_array == NULL) ||
-            (cur_config_cache->server_array == NULL))
+            (cur_config_cache->server_array == NULL) ||
+            (cur_config_cache->server_stats == NULL))
         {
             ret = -PVFS_ENOMEM;
             goto cleanup_allocations;
@@ -1635,6 +2062,14 @@ static int cache_server_array(PVFS_fs_id fsid)
         memset(cur_config_cache->server_array,
                0, 
                (cur_config_cache->server_count * sizeof(phys_server_desc_s)));
+        memset(cur_config_cache->server_stats,
+               0, 
+               (cur_config_cache->server_count *
+                sizeof(struct placement_stat)));
+        for (i = 0; i < cur_config_cache->server_count; i++)
+        {
+            cur_config_cache->server_stats[i].active_requests = -1;
+        }
 
         /* reset counts until we find out how many physical servers
          * are actually present
@@ -1732,6 +2167,11 @@ cleanup_allocations:
     {
         free(cur_config_cache->server_array);
     }
+    if (cur_config_cache->server_stats)
+    {
+        free(cur_config_cache->server_stats);
+        cur_config_cache->server_stats = NULL;
+    }
     return ret;
 }
 
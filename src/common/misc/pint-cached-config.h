@@ -91,6 +91,20 @@ int PINT_cached_config_map_servers(
     PVFS_BMI_addr_t *addr_array,
     PVFS_handle_extent_array *handle_extent_array);
 
+int PINT_cached_config_next_placement_refresh(
+    PVFS_fs_id *fs_id);
+
+int PINT_cached_config_set_server_space(
+    PVFS_fs_id fsid,
+    PVFS_BMI_addr_t addr,
+    PVFS_size bytes_available,
+    PVFS_size bytes_total);
+
+int PINT_cached_config_set_server_load(
+    PVFS_fs_id fsid,
+    PVFS_BMI_addr_t addr,
+    int64_t active_requests);
+
 int PINT_cached_config_get_num_dfiles(
     PVFS_fs_id fsid,
     PINT_dist *dist,
@@ -100,6 +100,9 @@ struct PINT_perf_key server_keys[] =
     {"io requests called", PINT_PERF_IO, PINT_PERF_PRESERVE},
     {"small_io requests called", PINT_PERF_SMALL_IO, PINT_PERF_PRESERVE},
     {"readdir requests called", PINT_PERF_READDIR, PINT_PERF_PRESERVE},
+    {"bstream fd cache hits", PINT_PERF_OPEN_CACHE_HITS, PINT_PERF_PRESERVE},
+    {"bstream fd cache misses", PINT_PERF_OPEN_CACHE_MISSES,
+        PINT_PERF_PRESERVE},
     {NULL, 0, 0},
 };
 
@@ -123,6 +126,30 @@ struct PINT_perf_key server_tkeys[] =
     {NULL, 0, 0},
 };
 
+/**
+ * track per-operation latency histograms for the server
+ * keys must be defined here in order based on the
+ * enumeration in include/pvfs2-mgmt.h
+ */
+struct PINT_perf_key server_hkeys[] =
+{
+    {"lookup", PINT_PERF_HLOOKUP, PINT_PERF_PRESERVE},
+    {"create", PINT_PERF_HCREATE, PINT_PERF_PRESERVE},
+    {"remove", PINT_PERF_HREMOVE, PINT_PERF_PRESERVE},
+    {"mkdir", PINT_PERF_HMKDIR, PINT_PERF_PRESERVE},
+    {"getattr", PINT_PERF_HGETATTR, PINT_PERF_PRESERVE},
+    {"setattr", PINT_PERF_HSETATTR, PINT_PERF_PRESERVE},
+    {"crdirent", PINT_PERF_HCRDIRENT, PINT_PERF_PRESERVE},
+    {"rmdirent", PINT_PERF_HRMDIRENT, PINT_PERF_PRESERVE},
+    {"io", PINT_PERF_HIO, PINT_PERF_PRESERVE},
+    {"small_io", PINT_PERF_HSMALL_IO, PINT_PERF_PRESERVE},
+    {"readdir", PINT_PERF_HREADDIR, PINT_PERF_PRESERVE},
+    {"listattr", PINT_PERF_HLISTATTR, PINT_PERF_PRESERVE},
+    {"eattr", PINT_PERF_HEATTR, PINT_PERF_PRESERVE},
+    {"other", PINT_PERF_HOTHER, PINT_PERF_PRESERVE},
+    {NULL, 0, 0},
+};
+
 /**
  * this utility removes all of the samples from a perf counter
  * this is mostly for cleanup in case of a memory alloc error
@@ -202,6 +229,10 @@ struct PINT_perf_counter *PINT_perf_initialize(
     {
         pc->perf_counter_size = sizeof(struct PINT_perf_timer);
     }
+    else if (cnt_type == PINT_PERF_HISTOGRAM)
+    {
+        pc->perf_counter_size = sizeof(struct PINT_perf_histogram);
+    }
     else
     {
         pc->perf_counter_size = sizeof(int64_t);
@@ -329,6 +360,7 @@ void __PINT_perf_count( struct PINT_perf_counter* pc,
                         enum PINT_perf_ops op)
 {
     struct PINT_perf_timer *pt;
+    struct PINT_perf_histogram *ph;
 #if 0
     int64_t tmp; /* this is for debugging purposes */
 #endif
@@ -407,6 +439,27 @@ void __PINT_perf_count( struct PINT_perf_counter* pc,
                 }
             }
             break;
+
+        case PINT_PERF_RECORD:
+            if (pc->cnt_type != PINT_PERF_HISTOGRAM)
+            {
+                gossip_err("Error: PINT_perf_count(): invalid op for non-histogram.\n");
+                goto errorout;
+            }
+            if (value < 0)
+            {
+                gossip_err("Error: PINT_perf_count(): sample rolled over.\n");
+                break;
+            }
+            ph = &pc->sample->value.h[key];
+            ph->count++;
+            ph->sum += value;
+            if (value > ph->max)
+            {
+                ph->max = value;
+            }
+            ph->bucket[PINT_perf_hist_bucket(value / 1000)]++;
+            break;
         default:
             gossip_err("Error: PINT_perf_count(): invalid op.\n");
             break;
@@ -498,6 +551,126 @@ void __PINT_perf_timer_end(struct PINT_perf_counter* pc,
     start_time->tv_nsec = 0;
 }
 
+/**
+ * Records the time elapsed since start_time in a latency histogram.
+ * Unlike __PINT_perf_timer_end this leaves start_time alone, so the
+ * same start time may feed both a timer and a histogram.
+ */
+void __PINT_perf_histogram_end(struct PINT_perf_counter *hpc,
+                               int key,
+                               const struct timespec *start_time)
+{
+    struct timespec end_time;
+    struct timespec td;
+
+    if (start_time->tv_sec == 0 && start_time->tv_nsec == 0)
+    {
+        /* timer was never started */
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &end_time);
+    td = timediff(*start_time, end_time);
+
+    __PINT_perf_count(hpc,
+                      key,
+                      ((int64_t)td.tv_sec * 1000000000) + td.tv_nsec,
+                      PINT_PERF_RECORD);
+}
+
+/**
+ * maps a latency in microseconds to its histogram bucket
+ *
+ * Values under PINT_PERF_HIST_SUB_COUNT index the first buckets
+ * directly.  Above that, the position of the highest set bit picks the
+ * power of two and the PINT_PERF_HIST_SUB_BITS bits below it pick one of
+ * the equal slices within it.
+ */
+int PINT_perf_hist_bucket(int64_t usecs)
+{
+    int msb = 0;
+    uint64_t v;
+
+    if (usecs < PINT_PERF_HIST_SUB_COUNT)
+    {
+        return (usecs < 0) ? 0 : (int)usecs;
+    }
+    if (usecs >> PINT_PERF_HIST_MAX_BITS)
+    {
+        return PINT_PERF_HIST_BUCKETS - 1;
+    }
+
+    for (v = (uint64_t)usecs; v > 1; v >>= 1)
+    {
+        msb++;
+    }
+    return ((msb - PINT_PERF_HIST_SUB_BITS + 1) << PINT_PERF_HIST_SUB_BITS) +
+           (int)((usecs >> (msb - PINT_PERF_HIST_SUB_BITS)) &
+                 (PINT_PERF_HIST_SUB_COUNT - 1));
+}
+
+/**
+ * returns the smallest latency in microseconds that lands in a bucket
+ */
+int64_t PINT_perf_hist_bucket_floor(int bucket)
+{
+    int msb;
+
+    if (bucket < PINT_PERF_HIST_SUB_COUNT)
+    {
+        return bucket;
+    }
+    msb = (bucket >> PINT_PERF_HIST_SUB_BITS) + PINT_PERF_HIST_SUB_BITS - 1;
+    return ((int64_t)1 << msb) +
+           ((int64_t)(bucket & (PINT_PERF_HIST_SUB_COUNT - 1)) <<
+            (msb - PINT_PERF_HIST_SUB_BITS));
+}
+
+/**
+ * estimates the pct percentile (0 < pct <= 100) of a histogram
+ * \returns the upper edge of the bucket holding that sample in
+ * microseconds, capped at the largest recorded value, or 0 if empty
+ */
+int64_t PINT_perf_hist_percentile(const struct PINT_perf_histogram *h,
+                                  double pct)
+{
+    int64_t rank;
+    int64_t seen = 0;
+    int64_t edge;
+    int i;
+
+    if (h->count <= 0)
+    {
+        return 0;
+    }
+
+    rank = (int64_t)((pct / 100.0) * (double)h->count + 0.5);
+    if (rank < 1)
+    {
+        rank = 1;
+    }
+
+    for (i = 0; i < PINT_PERF_HIST_BUCKETS; i++)
+    {
+        seen += h->bucket[i];
+        if (seen >= rank)
+        {
+            break;
+        }
+    }
+    if (i >= PINT_PERF_HIST_BUCKETS - 1)
+    {
+        return h->max / 1000;
+    }
+
+    edge = PINT_perf_hist_bucket_floor(i + 1);
+    if (h->max > 0 && edge > h->max / 1000)
+    {
+        edge = h->max / 1000;
+    }
+    return edge;
+}
+
 /** 
  * rolls over the current history window
  */
@@ -556,6 +729,10 @@ void PINT_perf_rollover( struct PINT_perf_counter* pc)
             {
                 memset(&pc->sample->value.t[i], 0, pc->perf_counter_size);
             }
+            else if (pc->cnt_type == PINT_PERF_HISTOGRAM)
+            {
+                memset(&pc->sample->value.h[i], 0, pc->perf_counter_size);
+            }
             else
             {
                 memset(&pc->sample->value.c[i], 0, pc->perf_counter_size);
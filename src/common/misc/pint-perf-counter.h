@@ -33,6 +33,7 @@ enum PINT_perf_ops
     PINT_PERF_SET = 2,
     PINT_PERF_START = 3, /* use with a timer */
     PINT_PERF_END = 4,   /* use with a timer */
+    PINT_PERF_RECORD = 5, /* use with a histogram */
 };
 
 /** enumeration of runtime options */
@@ -60,6 +61,7 @@ struct PINT_perf_sample
         void *v;
         int64_t *c;
         struct PINT_perf_timer *t;
+        struct PINT_perf_histogram *h;
     } value;  /**< this points to an array[key_count] of counters */
     struct PINT_perf_sample *next; /**< link to next sample in the list of */
                                    /**< history sameples */
@@ -70,7 +72,7 @@ struct PINT_perf_counter
 {
     gen_mutex_t mutex;
     struct PINT_perf_key* key_array;     /**< keys (provided by initialize()) */
-    enum PINT_perf_type cnt_type;        /**< counter or timer */
+    enum PINT_perf_type cnt_type;        /**< counter, timer or histogram */
     int perf_counter_size;               /**< number of bytes in single cnt */
     int key_count;                       /**< number of keys */
     int history;                         /**< number of history intervals */
@@ -90,6 +92,8 @@ extern struct PINT_perf_key server_keys[];
 
 extern struct PINT_perf_key server_tkeys[];
 
+extern struct PINT_perf_key server_hkeys[];
+
 /* this is rediculous, this is defined in trove, but "owned" by the
  * server!!!
  */
@@ -97,6 +101,8 @@ extern struct PINT_perf_counter *PINT_server_pc;
 
 extern struct PINT_perf_counter *PINT_server_tpc;
 
+extern struct PINT_perf_counter *PINT_server_hpc;
+
 struct PINT_perf_counter *PINT_perf_initialize(
         enum PINT_perf_type cnt_type,
         struct PINT_perf_key *key_array,
@@ -120,16 +126,31 @@ void __PINT_perf_timer_end(
         int key, 
         struct timespec *start_time);
 
+void __PINT_perf_histogram_end(
+        struct PINT_perf_counter *hpc,
+        int key,
+        const struct timespec *start_time);
+
 #ifdef __PVFS2_DISABLE_PERF_COUNTERS__
     #define PINT_perf_count(w,x,y,z) do{}while(0)
     #define PINT_perf_timer_start(w) do{}while(0)
     #define PINT_perf_timer_end(w,x,y) do{}while(0)
+    #define PINT_perf_histogram_end(w,x,y) do{}while(0)
 #else
     #define PINT_perf_count __PINT_perf_count
     #define PINT_perf_timer_start __PINT_perf_timer_start
     #define PINT_perf_timer_end __PINT_perf_timer_end
+    #define PINT_perf_histogram_end __PINT_perf_histogram_end
 #endif
 
+int PINT_perf_hist_bucket(int64_t usecs);
+
+int64_t PINT_perf_hist_bucket_floor(int bucket);
+
+int64_t PINT_perf_hist_percentile(
+        const struct PINT_perf_histogram *h,
+        double pct);
+
 void PINT_perf_rollover(struct PINT_perf_counter *pc);
 
 int PINT_perf_set_info(
@@ -0,0 +1,416 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Fixed size object caches; see pint-slab.h.
+ *
+ * A cache owns a list of slabs, each holding SLAB_OBJECTS objects, and
+ * a depot of free objects protected by the cache mutex.  Free objects
+ * are chained through their first word.  With POSIX threads each
+ * thread also owns a magazine per cache, reached through a thread
+ * specific key.  Allocation and release work on the magazine alone
+ * until it runs empty or overflows; then half a magazine moves between
+ * it and the depot under the cache mutex.  Counters kept in the
+ * magazine are folded into the cache at the same time, so the numbers
+ * reported by PINT_slab_log_stats() lag by at most one batch per
+ * thread.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <assert.h>
+
+#include "pvfs2-internal.h"
+#include "pvfs2-types.h"
+#include "gen-locks.h"
+#include "gossip.h"
+#include "pvfs2-debug.h"
+#include "quicklist.h"
+#include "pint-slab.h"
+
+/* objects carved out of one slab */
+#define SLAB_OBJECTS 64
+/* objects a thread may keep cached per cache */
+#define MAGAZINE_SIZE 32
+/* objects are aligned as malloc would align them */
+#define SLAB_ALIGN 16
+#define SLAB_ROUND(__s) (((__s) + SLAB_ALIGN - 1) & ~((size_t)SLAB_ALIGN - 1))
+
+#if defined(__GEN_POSIX_LOCKING__) && !defined(PINT_SLAB_DISABLE)
+#define SLAB_MAGAZINES
+#endif
+
+struct slab_magazine
+{
+    struct PINT_slab_cache *cache;
+    void *objs;
+    int count;
+    /* allocations and releases not yet folded into the cache */
+    int64_t allocs;
+    int64_t frees;
+};
+
+struct PINT_slab_cache
+{
+    char name[32];
+    size_t size;            /* size handed to the caller */
+    size_t obj_size;        /* size of one object within a slab */
+    gen_mutex_t mutex;
+    void *depot;            /* free objects not held by any thread */
+    int depot_count;
+    void *slabs;            /* slabs chained through their first word */
+#ifdef SLAB_MAGAZINES
+    pthread_key_t key;
+#endif
+    /* statistics, protected by mutex */
+    int64_t slab_count;
+    int64_t allocs;
+    int64_t frees;
+    int64_t refills;
+    int64_t flushes;
+    struct qlist_head link;
+};
+
+/* all caches, for reporting */
+static QLIST_HEAD(slab_caches);
+static gen_mutex_t slab_caches_mutex = GEN_MUTEX_INITIALIZER;
+
+#ifndef PINT_SLAB_DISABLE
+/* slab_grow()
+ *
+ * adds a new slab's worth of objects to the depot.  Cache mutex must
+ * be held.
+ *
+ * returns 0 on success, -PVFS_ENOMEM on failure
+ */
+static int slab_grow(struct PINT_slab_cache *cache)
+{
+    char *slab;
+    char *obj;
+    int i;
+
+    slab = malloc(SLAB_ROUND(sizeof(void *)) +
+                  (SLAB_OBJECTS * cache->obj_size));
+    if (!slab)
+    {
+        return -PVFS_ENOMEM;
+    }
+    *(void **)slab = cache->slabs;
+    cache->slabs = slab;
+    cache->slab_count++;
+
+    obj = slab + SLAB_ROUND(sizeof(void *));
+    for (i = 0; i < SLAB_OBJECTS; i++, obj += cache->obj_size)
+    {
+        *(void **)obj = cache->depot;
+        cache->depot = obj;
+    }
+    cache->depot_count += SLAB_OBJECTS;
+    return 0;
+}
+#endif
+
+#ifdef SLAB_MAGAZINES
+/* slab_magazine_flush()
+ *
+ * moves all but keep objects from a magazine back to the depot and
+ * folds its counters into the cache.  Cache mutex must be held.
+ */
+static void slab_magazine_flush(struct slab_magazine *mag, int keep)
+{
+    struct PINT_slab_cache *cache = mag->cache;
+    void *obj;
+
+    while (mag->count > keep)
+    {
+        obj = mag->objs;
+        mag->objs = *(void **)obj;
+        mag->count--;
+        *(void **)obj = cache->depot;
+        cache->depot = obj;
+        cache->depot_count++;
+    }
+    cache->allocs += mag->allocs;
+    cache->frees += mag->frees;
+    mag->allocs = 0;
+    mag->frees = 0;
+}
+
+/* slab_magazine_release()
+ *
+ * thread specific data destructor: returns an exiting thread's cached
+ * objects to the depot
+ */
+static void slab_magazine_release(void *arg)
+{
+    struct slab_magazine *mag = arg;
+
+    gen_mutex_lock(&mag->cache->mutex);
+    slab_magazine_flush(mag, 0);
+    gen_mutex_unlock(&mag->cache->mutex);
+    free(mag);
+}
+
+/* slab_magazine_get()
+ *
+ * returns the calling thread's magazine for the cache, creating it on
+ * first use.  Returns NULL if one could not be created, in which case
+ * the caller goes straight to the depot.
+ */
+static struct slab_magazine *slab_magazine_get(struct PINT_slab_cache *cache)
+{
+    struct slab_magazine *mag;
+
+    mag = pthread_getspecific(cache->key);
+    if (mag)
+    {
+        return mag;
+    }
+    mag = malloc(sizeof(*mag));
+    if (!mag)
+    {
+        return NULL;
+    }
+    memset(mag, 0, sizeof(*mag));
+    mag->cache = cache;
+    if (pthread_setspecific(cache->key, mag) != 0)
+    {
+        free(mag);
+        return NULL;
+    }
+    return mag;
+}
+#endif
+
+/** Creates a cache of zeroed objects of the given size.
+ *
+ *  \return pointer to the cache on success, NULL on failure
+ */
+struct PINT_slab_cache *PINT_slab_create(const char *name, size_t size)
+{
+    struct PINT_slab_cache *cache;
+
+    cache = malloc(sizeof(*cache));
+    if (!cache)
+    {
+        return NULL;
+    }
+    memset(cache, 0, sizeof(*cache));
+    strncpy(cache->name, name, sizeof(cache->name) - 1);
+    cache->size = size;
+    cache->obj_size = SLAB_ROUND(size < sizeof(void *) ? sizeof(void *) : size);
+    gen_mutex_init(&cache->mutex);
+#ifdef SLAB_MAGAZINES
+    if (pthread_key_create(&cache->key, slab_magazine_release) != 0)
+    {
+        gen_mutex_destroy(&cache->mutex);
+        free(cache);
+        return NULL;
+    }
+#endif
+
+    gen_mutex_lock(&slab_caches_mutex);
+    qlist_add_tail(&cache->link, &slab_caches);
+    gen_mutex_unlock(&slab_caches_mutex);
+
+    gossip_debug(GOSSIP_PERFCOUNTER_DEBUG,
+                 "slab cache %s created, %llu byte objects\n",
+                 cache->name, llu(cache->obj_size));
+    return cache;
+}
+
+/** Destroys a cache and all of its slabs.  Every object must have been
+ *  returned to it; objects still cached by other threads are discarded
+ *  along with their slabs.
+ */
+void PINT_slab_destroy(struct PINT_slab_cache *cache)
+{
+    void *slab;
+#ifdef SLAB_MAGAZINES
+    struct slab_magazine *mag;
+#endif
+
+    if (!cache)
+    {
+        return;
+    }
+
+    gen_mutex_lock(&slab_caches_mutex);
+    qlist_del(&cache->link);
+    gen_mutex_unlock(&slab_caches_mutex);
+
+#ifdef SLAB_MAGAZINES
+    mag = pthread_getspecific(cache->key);
+    if (mag)
+    {
+        pthread_setspecific(cache->key, NULL);
+        free(mag);
+    }
+    pthread_key_delete(cache->key);
+#endif
+
+    while (cache->slabs)
+    {
+        slab = cache->slabs;
+        cache->slabs = *(void **)slab;
+        free(slab);
+    }
+    gen_mutex_destroy(&cache->mutex);
+    free(cache);
+}
+
+/** Allocates a zeroed object from a cache.
+ *
+ *  \return pointer to the object on success, NULL on failure
+ */
+void *PINT_slab_alloc(struct PINT_slab_cache *cache)
+{
+    void *obj = NULL;
+#ifdef SLAB_MAGAZINES
+    struct slab_magazine *mag;
+#endif
+
+#ifdef PINT_SLAB_DISABLE
+    obj = calloc(1, cache->size);
+    return obj;
+#else
+
+#ifdef SLAB_MAGAZINES
+    mag = slab_magazine_get(cache);
+    if (mag && mag->count == 0)
+    {
+        /* refill half a magazine from the depot */
+        gen_mutex_lock(&cache->mutex);
+        cache->refills++;
+        while (mag->count < MAGAZINE_SIZE / 2)
+        {
+            if (!cache->depot && slab_grow(cache) < 0)
+            {
+                break;
+            }
+            obj = cache->depot;
+            cache->depot = *(void **)obj;
+            cache->depot_count--;
+            *(void **)obj = mag->objs;
+            mag->objs = obj;
+            mag->count++;
+        }
+        slab_magazine_flush(mag, mag->count);
+        gen_mutex_unlock(&cache->mutex);
+    }
+    if (mag)
+    {
+        if (mag->count == 0)
+        {
+            return NULL;
+        }
+        obj = mag->objs;
+        mag->objs = *(void **)obj;
+        mag->count--;
+        mag->allocs++;
+        memset(obj, 0, cache->size);
+        return obj;
+    }
+#endif
+
+    gen_mutex_lock(&cache->mutex);
+    if (cache->depot || slab_grow(cache) == 0)
+    {
+        obj = cache->depot;
+        cache->depot = *(void **)obj;
+        cache->depot_count--;
+        cache->allocs++;
+    }
+    gen_mutex_unlock(&cache->mutex);
+    if (obj)
+    {
+        memset(obj, 0, cache->size);
+    }
+    return obj;
+#endif
+}
+
+/** Returns an object to the cache it was allocated from.
+ */
+void PINT_slab_free(struct PINT_slab_cache *cache, void *obj)
+{
+#ifdef SLAB_MAGAZINES
+    struct slab_magazine *mag;
+#endif
+
+    if (!obj)
+    {
+        return;
+    }
+
+#ifdef PINT_SLAB_DISABLE
+    free(obj);
+#else
+
+#ifdef SLAB_MAGAZINES
+    mag = slab_magazine_get(cache);
+    if (mag)
+    {
+        *(void **)obj = mag->objs;
+        mag->objs = obj;
+        mag->count++;
+        mag->frees++;
+        if (mag->count > MAGAZINE_SIZE)
+        {
+            /* hand half a magazine back to the depot */
+            gen_mutex_lock(&cache->mutex);
+            cache->flushes++;
+            slab_magazine_flush(mag, MAGAZINE_SIZE / 2);
+            gen_mutex_unlock(&cache->mutex);
+        }
+        return;
+    }
+#endif
+
+    gen_mutex_lock(&cache->mutex);
+    *(void **)obj = cache->depot;
+    cache->depot = obj;
+    cache->depot_count++;
+    cache->frees++;
+    gen_mutex_unlock(&cache->mutex);
+#endif
+}
+
+/** Logs the statistics of every cache to the performance log.
+ */
+void PINT_slab_log_stats(void)
+{
+    struct qlist_head *iterator;
+    struct PINT_slab_cache *cache;
+
+    gen_mutex_lock(&slab_caches_mutex);
+    qlist_for_each(iterator, &slab_caches)
+    {
+        cache = qlist_entry(iterator, struct PINT_slab_cache, link);
+        gen_mutex_lock(&cache->mutex);
+        gossip_perf_log("slab %s: size %llu slabs %lld depot %d "
+                        "allocs %lld in use %lld refills %lld flushes %lld\n",
+                        cache->name,
+                        llu(cache->obj_size),
+                        lld(cache->slab_count),
+                        cache->depot_count,
+                        lld(cache->allocs),
+                        lld(cache->allocs - cache->frees),
+                        lld(cache->refills),
+                        lld(cache->flushes));
+        gen_mutex_unlock(&cache->mutex);
+    }
+    gen_mutex_unlock(&slab_caches_mutex);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
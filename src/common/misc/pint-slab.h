@@ -0,0 +1,48 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Object caches for the small structures allocated and freed once or
+ * more per request (job descriptors, queued trove ops, state machine
+ * control blocks, flow descriptors, ...).
+ *
+ * Each cache hands out zeroed objects of one fixed size.  Objects are
+ * carved out of larger slabs that are kept until the cache is
+ * destroyed.  Each thread keeps a small magazine of free objects per
+ * cache so that the common alloc/free pair touches no lock; the
+ * magazine is refilled from or flushed to the cache's shared depot in
+ * batches.
+ *
+ * Objects from a cache must be released with PINT_slab_free() on the
+ * same cache, never with free().  Defining PINT_SLAB_DISABLE makes
+ * every cache a thin wrapper around calloc()/free(), which is what
+ * memory checkers want to see.
+ */
+
+#ifndef __PINT_SLAB_H
+#define __PINT_SLAB_H
+
+#include <stdlib.h>
+
+struct PINT_slab_cache;
+
+struct PINT_slab_cache *PINT_slab_create(const char *name, size_t size);
+void PINT_slab_destroy(struct PINT_slab_cache *cache);
+
+void *PINT_slab_alloc(struct PINT_slab_cache *cache);
+void PINT_slab_free(struct PINT_slab_cache *cache, void *obj);
+
+void PINT_slab_log_stats(void);
+
+#endif /* __PINT_SLAB_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
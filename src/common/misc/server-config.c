@@ -69,8 +69,11 @@ static DOTCONF_CB(enter_distribution_context);
 static DOTCONF_CB(exit_distribution_context);
 static DOTCONF_CB(get_unexp_req);
 static DOTCONF_CB(get_tcp_buffer_send);
+static DOTCONF_CB(get_tcp_progress_threads);
 static DOTCONF_CB(get_tcp_buffer_receive);
 static DOTCONF_CB(get_tcp_bind_specific);
+static DOTCONF_CB(get_flow_zero_copy_reads);
+static DOTCONF_CB(get_flow_buffer_budget_mb);
 static DOTCONF_CB(get_perf_update_interval);
 static DOTCONF_CB(get_perf_update_history);
 static DOTCONF_CB(get_root_handle);
@@ -107,7 +110,13 @@ static DOTCONF_CB(get_attr_cache_max_num_elems);
 static DOTCONF_CB(get_trove_sync_meta);
 static DOTCONF_CB(get_trove_sync_data);
 static DOTCONF_CB(get_file_stuffing);
+static DOTCONF_CB(get_compound_create);
+static DOTCONF_CB(get_readdirplus_attrs);
+static DOTCONF_CB(get_placement_policy);
+static DOTCONF_CB(get_placement_refresh_secs);
 static DOTCONF_CB(get_trove_max_concurrent_io);
+static DOTCONF_CB(get_trove_meta_threads);
+static DOTCONF_CB(get_trove_open_cache_size);
 /* Berkeley DB */
 static DOTCONF_CB(get_db_cache_size_bytes);
 static DOTCONF_CB(get_db_cache_type);
@@ -130,6 +139,8 @@ static DOTCONF_CB(get_coalescing_high_watermark);
 static DOTCONF_CB(get_coalescing_low_watermark);
 static DOTCONF_CB(get_trove_method);
 static DOTCONF_CB(get_small_file_size);
+static DOTCONF_CB(get_trove_packed_bstreams);
+static DOTCONF_CB(get_trove_inline_bstream_size);
 static DOTCONF_CB(directio_thread_num);
 static DOTCONF_CB(directio_ops_per_queue);
 static DOTCONF_CB(directio_timeout);
@@ -681,6 +692,23 @@ static const configoption_t options[] =
     {"TroveMaxConcurrentIO", ARG_INT, get_trove_max_concurrent_io, NULL,
         CTX_DEFAULTS|CTX_SERVER_OPTIONS,"16"},
 
+    /* number of threads that service queued Trove metadata (keyval and
+     * dspace) operations.  Operations that only read metadata run in
+     * parallel; operations that modify it still run one at a time, and
+     * operations on the same handle are never run concurrently.
+     */
+    {"TroveMetaThreads", ARG_INT, get_trove_meta_threads, NULL,
+        CTX_DEFAULTS|CTX_SERVER_OPTIONS,"1"},
+
+    /* number of bstream file descriptors the server keeps open between
+     * I/O operations.  Data servers with many active datafiles should
+     * raise this (and the server's open file limit) so that bstreams are
+     * not reopened on every I/O.  The cache hit and miss counts are
+     * reported by the performance monitor.
+     */
+    {"TroveOpenCacheSize", ARG_INT, get_trove_open_cache_size, NULL,
+        CTX_DEFAULTS|CTX_SERVER_OPTIONS,"512"},
+
     /* The gossip interface in OrangeFS allows users to specify different
      * levels of logging for the OrangeFS server.  The output of these
      * different log levels is written to a file, which is specified in
@@ -798,6 +826,16 @@ static const configoption_t options[] =
       {"TCPBufferReceive",ARG_INT, get_tcp_buffer_receive,NULL,
          CTX_DEFAULTS,"0"},
 
+     /* Number of dedicated threads used to drive TCP socket progress.
+      * Connections are spread across the threads, each of which polls
+      * its own epoll set, so that network polling is no longer limited
+      * to the thread that happens to be testing for completion.  The
+      * default of 0 keeps the classic behavior of polling from within
+      * BMI test calls.
+      */
+     {"TCPProgressThreads",ARG_INT, get_tcp_progress_threads,NULL,
+         CTX_DEFAULTS,"0"},
+
      /* If enabled, specifies that the server should bind its port only on
       * the specified address (rather than INADDR_ANY).
       */
@@ -868,6 +906,42 @@ static const configoption_t options[] =
     {"FileStuffing",ARG_STR, get_file_stuffing, NULL, 
         CTX_FILESYSTEM,"yes"},
 
+    /* Specifies if clients should create a file and add its directory
+     * entry with a single request.  When enabled, the file's metadata is
+     * placed on the server that holds the directory entry rather than on
+     * the next metadata server in turn, which saves a round trip per
+     * create but concentrates the files of a directory on the servers
+     * holding its entries.  Every server of the file system must
+     * support the request before this is enabled.
+     */
+    {"CompoundCreate",ARG_STR, get_compound_create, NULL,
+        CTX_FILESYSTEM,"no"},
+
+    /* Specifies if readdirplus should ask the servers holding the
+     * directory entries for the attributes of the entries they also
+     * hold, so that only entries on other servers need a listattr.
+     * Every server of the file system must support the request before
+     * this is enabled.
+     */
+    {"ReaddirPlusAttrs",ARG_STR, get_readdirplus_attrs, NULL,
+        CTX_FILESYSTEM,"no"},
+
+    /* Specifies how clients choose the servers that hold new metafiles
+     * and datafiles.  "roundrobin" picks them in turn from a random
+     * starting point.  "weighted" favors servers with more free space
+     * and fewer active requests, using statistics that clients fetch
+     * from every server each PlacementRefreshSecs seconds.  Layouts that
+     * name their servers explicitly are not affected.
+     */
+    {"PlacementPolicy",ARG_STR, get_placement_policy, NULL,
+        CTX_FILESYSTEM,"roundrobin"},
+
+    /* Specifies how often, in seconds, clients refresh the server
+     * statistics used by the weighted placement policy.
+     */
+    {"PlacementRefreshSecs",ARG_INT, get_placement_refresh_secs, NULL,
+        CTX_FILESYSTEM,"30"},
+
      /* This specifies the number of samples
       * that performance monitor should keep
       *
@@ -885,10 +959,12 @@ static const configoption_t options[] =
         CTX_DEFAULTS, "1000"},
 
     /* List the BMI modules to load when the server is started.  At present,
-     * only tcp, infiniband, and myrinet are valid BMI modules.  
+     * only tcp, shared memory, infiniband, and myrinet are valid BMI
+     * modules.  
      * The format of the list is a comma separated list of one of:
      *
      * <c>bmi_tcp</c>
+     * <p><c>bmi_sm</c></p>
      * <p><c>bmi_ib</c></p>
      * <p><c>bmi_gm</c></p>
      *
@@ -896,6 +972,9 @@ static const configoption_t options[] =
      *
      * <c>BMIModules bmi_tcp,bmi_ib</c>
      *
+     * bmi_sm only serves clients on the same host and is used together
+     * with another module; see src/io/bmi/bmi_sm/README.
+     *
      * Note that only the bmi modules compiled into OrangeFS should be
      * specified in this list.  The BMIModules option can be specified
      * in either the Defaults or ServerOptions contexts.
@@ -936,6 +1015,29 @@ static const configoption_t options[] =
     {"FlowModules",ARG_LIST, get_flow_module_list,NULL,
         CTX_DEFAULTS,"flowproto_multiqueue,"},
 
+    /* If enabled, reads that map to a single contiguous region of a
+     * bstream are sent by the network layer directly from the storage
+     * file with sendfile(), skipping the copy into a flow buffer.  Only
+     * takes effect with the flowproto_multiqueue flow module, for
+     * clients reached over TCP, and for storage methods that expose a
+     * file descriptor (default, alt-aio, io-uring); everything else
+     * silently uses the regular path.
+     */
+    {"FlowZeroCopyReads",ARG_STR, get_flow_zero_copy_reads,NULL,
+        CTX_DEFAULTS,"no"},
+
+    /* Megabytes of memory shared by the buffers of all flows between
+     * the network and storage.  Within this budget the
+     * flowproto_multiqueue module sizes each flow on its own: requests
+     * smaller than FlowBufferSizeBytes get smaller buffers, and large
+     * transfers get up to four times FlowBuffersPerFlow buffers when the
+     * network and storage run at different speeds.  When the budget is
+     * used up, new flows fall back to two buffers.  0 turns this off and
+     * every flow uses FlowBufferSizeBytes and FlowBuffersPerFlow as is.
+     */
+    {"FlowBufferBudgetMB",ARG_INT, get_flow_buffer_budget_mb,NULL,
+        CTX_DEFAULTS,"256"},
+
     /* Specifies the format of the date/timestamp that events will have
      * in the event log.  Possible values are:
      *
@@ -1173,6 +1275,12 @@ static const configoption_t options[] =
      * for large I/O accesses.  For local storage, including RAID setups,
      * the alt-aio method is recommended.
      *
+     * <c>io-uring</c>  Like alt-aio, but submits datafile reads and writes
+     * through a single Linux io_uring instead of one thread per request.
+     * This reduces per-I/O thread and system call overhead when many
+     * small to medium flows are active.  Falls back to alt-aio if the
+     * kernel does not support io_uring.
+     *
      * <c>null-aio</c>  This method is an implementation 
      * that does no disk I/O at all
      * and is only useful for development or debugging purposes.  It can
@@ -1204,6 +1312,27 @@ static const configoption_t options[] =
     /* Specifies the size of the small file transition point */
     {"SmallFileSize", ARG_INT, get_small_file_size, NULL, CTX_FILESYSTEM, NULL},
 
+    /* Specifies if the data of small datafiles should be packed into
+     * large container files instead of being given a file each.  A
+     * datafile stays packed while it is no larger than SmallFileSize
+     * (64 KB if that is not set, at most 1 MB) and moves to a file of
+     * its own once it grows past that.  This saves the inodes, opens and
+     * syncs of millions of small files on the server's local file
+     * system.  It does not apply to the directio TroveMethod.
+     */
+    {"TrovePackedBstreams", ARG_STR, get_trove_packed_bstreams, NULL,
+        CTX_STORAGEHINTS, "no"},
+
+    /* Specifies the size up to which the data of a datafile is kept in
+     * the keyval database, next to its other records, instead of in a
+     * file or a packed extent.  Tiny files then cost no inode, open or
+     * file read at all.  A datafile moves out once it grows past this
+     * size.  At most 4096; 0 turns it off.  It does not apply to the
+     * directio TroveMethod.
+     */
+    {"TroveInlineBstreamSize", ARG_INT, get_trove_inline_bstream_size,
+        NULL, CTX_STORAGEHINTS, "0"},
+
     /* Specifies the number of threads that should be started to service
      * Direct I/O operations.
      */
@@ -1294,6 +1423,7 @@ int PINT_parse_config(struct server_configuration_s *config_obj,
     config_s->client_retry_limit = PVFS2_CLIENT_RETRY_LIMIT_DEFAULT;
     config_s->client_retry_delay_ms = PVFS2_CLIENT_RETRY_DELAY_MS_DEFAULT;
     config_s->trove_max_concurrent_io = 16;
+    config_s->trove_open_cache_size = 512;
     config_s->db_max_size = 536870912;
 
     if (cache_config_files(config_s, global_config_filename))
@@ -1838,6 +1968,18 @@ DOTCONF_CB(get_tcp_buffer_send)
     return NULL;
 }
 
+DOTCONF_CB(get_tcp_progress_threads)
+{
+    struct server_configuration_s *config_s =
+                    (struct server_configuration_s *)cmd->context;
+    if(cmd->data.value < 0)
+    {
+        return("TCPProgressThreads must be a non-negative integer.\n");
+    }
+    config_s->tcp_progress_threads = cmd->data.value;
+    return NULL;
+}
+
 DOTCONF_CB(get_tcp_bind_specific)
 {
     struct server_configuration_s *config_s =
@@ -1864,6 +2006,41 @@ DOTCONF_CB(get_tcp_bind_specific)
     return NULL;
 }
 
+DOTCONF_CB(get_flow_zero_copy_reads)
+{
+    struct server_configuration_s *config_s =
+                    (struct server_configuration_s *)cmd->context;
+
+    if(strcasecmp(cmd->data.str, "yes") == 0)
+    {
+        config_s->flow_zero_copy_reads = 1;
+    }
+    else if(strcasecmp(cmd->data.str, "no") == 0)
+    {
+        config_s->flow_zero_copy_reads = 0;
+    }
+    else
+    {
+        return("FlowZeroCopyReads value must be 'yes' or 'no'.\n");
+    }
+
+    return NULL;
+}
+
+DOTCONF_CB(get_flow_buffer_budget_mb)
+{
+    struct server_configuration_s *config_s =
+                    (struct server_configuration_s *)cmd->context;
+
+    if(cmd->data.value < 0)
+    {
+        return("FlowBufferBudgetMB must not be negative.\n");
+    }
+    config_s->flow_buffer_budget_mb = cmd->data.value;
+
+    return NULL;
+}
+
 DOTCONF_CB(get_server_job_bmi_timeout)
 {
     struct server_configuration_s *config_s = 
@@ -2837,6 +3014,104 @@ DOTCONF_CB(get_file_stuffing)
     return NULL;
 }
 
+DOTCONF_CB(get_compound_create)
+{
+    struct filesystem_configuration_s *fs_conf = NULL;
+    struct server_configuration_s *config_s = 
+                 (struct server_configuration_s *)cmd->context;
+
+    fs_conf = (struct filesystem_configuration_s *)
+                    PINT_llist_head(config_s->file_systems);
+    assert(fs_conf);
+
+    if(strcasecmp(cmd->data.str, "yes") == 0)
+    {
+        fs_conf->compound_create = 1;
+    }
+    else if(strcasecmp(cmd->data.str, "no") == 0)
+    {
+        fs_conf->compound_create = 0;
+    }
+    else
+    {
+        return("CompoundCreate value must be 'yes' or 'no'.\n");
+    }
+
+    return NULL;
+}
+
+DOTCONF_CB(get_readdirplus_attrs)
+{
+    struct filesystem_configuration_s *fs_conf = NULL;
+    struct server_configuration_s *config_s = 
+                 (struct server_configuration_s *)cmd->context;
+
+    fs_conf = (struct filesystem_configuration_s *)
+                    PINT_llist_head(config_s->file_systems);
+    assert(fs_conf);
+
+    if(strcasecmp(cmd->data.str, "yes") == 0)
+    {
+        fs_conf->readdirplus_attrs = 1;
+    }
+    else if(strcasecmp(cmd->data.str, "no") == 0)
+    {
+        fs_conf->readdirplus_attrs = 0;
+    }
+    else
+    {
+        return("ReaddirPlusAttrs value must be 'yes' or 'no'.\n");
+    }
+
+    return NULL;
+}
+
+DOTCONF_CB(get_placement_policy)
+{
+    struct filesystem_configuration_s *fs_conf = NULL;
+    struct server_configuration_s *config_s = 
+                 (struct server_configuration_s *)cmd->context;
+
+    fs_conf = (struct filesystem_configuration_s *)
+                    PINT_llist_head(config_s->file_systems);
+    assert(fs_conf);
+
+    if(strcasecmp(cmd->data.str, "roundrobin") == 0)
+    {
+        fs_conf->placement_policy = PINT_PLACEMENT_ROUND_ROBIN;
+    }
+    else if(strcasecmp(cmd->data.str, "weighted") == 0)
+    {
+        fs_conf->placement_policy = PINT_PLACEMENT_WEIGHTED;
+    }
+    else
+    {
+        return("PlacementPolicy value must be 'roundrobin' or "
+               "'weighted'.\n");
+    }
+
+    return NULL;
+}
+
+DOTCONF_CB(get_placement_refresh_secs)
+{
+    struct filesystem_configuration_s *fs_conf = NULL;
+    struct server_configuration_s *config_s = 
+                 (struct server_configuration_s *)cmd->context;
+
+    fs_conf = (struct filesystem_configuration_s *)
+                    PINT_llist_head(config_s->file_systems);
+    assert(fs_conf);
+
+    if(cmd->data.value < 1)
+    {
+        return("PlacementRefreshSecs must be at least 1.\n");
+    }
+    fs_conf->placement_refresh_secs = cmd->data.value;
+
+    return NULL;
+}
+
 
 DOTCONF_CB(get_trove_sync_meta)
 {
@@ -2914,6 +3189,42 @@ DOTCONF_CB(get_trove_max_concurrent_io)
     return NULL;
 }
 
+DOTCONF_CB(get_trove_meta_threads)
+{
+    struct server_configuration_s *config_s = 
+                    (struct server_configuration_s *)cmd->context;
+
+    if(config_s->configuration_context == CTX_SERVER_OPTIONS &&
+       config_s->my_server_options == 0)
+    {
+        return NULL;
+    }
+    if(cmd->data.value < 1)
+    {
+        return("TroveMetaThreads must be at least 1.\n");
+    }
+    config_s->trove_meta_threads = cmd->data.value;
+    return NULL;
+}
+
+DOTCONF_CB(get_trove_open_cache_size)
+{
+    struct server_configuration_s *config_s = 
+                    (struct server_configuration_s *)cmd->context;
+
+    if(config_s->configuration_context == CTX_SERVER_OPTIONS &&
+       config_s->my_server_options == 0)
+    {
+        return NULL;
+    }
+    if(cmd->data.value < 1)
+    {
+        return("TroveOpenCacheSize must be at least 1.\n");
+    }
+    config_s->trove_open_cache_size = cmd->data.value;
+    return NULL;
+}
+
 DOTCONF_CB(get_db_cache_size_bytes)
 {
     struct server_configuration_s *config_s = 
@@ -3394,6 +3705,10 @@ DOTCONF_CB(get_trove_method)
     {
         *method = TROVE_METHOD_DBPF_DIRECTIO;
     }
+    else if(!strcmp(cmd->data.str, "io-uring"))
+    {
+        *method = TROVE_METHOD_DBPF_IOURING;
+    }
     else
     {
         return "Error unknown TroveMethod option\n";
@@ -3414,6 +3729,48 @@ DOTCONF_CB(get_small_file_size)
     return NULL;
 }
 
+DOTCONF_CB(get_trove_packed_bstreams)
+{
+    struct server_configuration_s *config_s =
+        (struct server_configuration_s *)cmd->context;
+    struct filesystem_configuration_s *fs_conf = NULL;
+
+    fs_conf = (struct filesystem_configuration_s *)
+        PINT_llist_head(config_s->file_systems);
+
+    if(!strcmp((char *)cmd->data.str, "yes"))
+    {
+        fs_conf->trove_packed_bstreams = 1;
+    }
+    else if(!strcmp((char *)cmd->data.str, "no"))
+    {
+        fs_conf->trove_packed_bstreams = 0;
+    }
+    else
+    {
+        return "TrovePackedBstreams must be yes or no.\n";
+    }
+
+    return NULL;
+}
+
+DOTCONF_CB(get_trove_inline_bstream_size)
+{
+    struct server_configuration_s *config_s =
+        (struct server_configuration_s *)cmd->context;
+    struct filesystem_configuration_s *fs_conf = NULL;
+
+    fs_conf = (struct filesystem_configuration_s *)
+        PINT_llist_head(config_s->file_systems);
+
+    if(cmd->data.value < 0)
+    {
+        return "TroveInlineBstreamSize must not be negative.\n";
+    }
+    fs_conf->trove_inline_bstream_size = cmd->data.value;
+    return NULL;
+}
+
 DOTCONF_CB(directio_thread_num)
 {
     struct server_configuration_s *config_s =
@@ -62,6 +62,13 @@ typedef struct host_handle_mapping_s
     PVFS_handle_extent_array handle_extent_array;
 } host_handle_mapping_s;
 
+/* how clients choose the servers for new metafiles and datafiles */
+enum PINT_placement_policy
+{
+    PINT_PLACEMENT_ROUND_ROBIN = 0,
+    PINT_PLACEMENT_WEIGHTED = 1
+};
+
 typedef struct filesystem_configuration_s
 {
     char *file_system_name;
@@ -89,9 +96,15 @@ typedef struct filesystem_configuration_s
     int trove_sync_meta;
     int trove_sync_data;
     int immediate_completion;
+    int trove_packed_bstreams;
+    int trove_inline_bstream_size;
     int coalescing_high_watermark;
     int coalescing_low_watermark;
     int file_stuffing;
+    int compound_create;
+    int readdirplus_attrs;
+    enum PINT_placement_policy placement_policy;
+    int placement_refresh_secs;
 
     char *secret_key;
 
@@ -181,10 +194,17 @@ typedef struct server_configuration_s
     char *bmi_modules;              /* BMI modules                      */
     char *bmi_opts;                 /* BMI options                      */
     char *flow_modules;             /* Flow modules                     */
+    int flow_zero_copy_reads;       /* send contiguous reads with
+                                     * sendfile() when possible
+                                     */
+    int flow_buffer_budget_mb;      /* memory shared by the buffers of
+                                     * all trove flows, 0 = fixed sizes
+                                     */
 
     int tcp_buffer_size_receive;    /* Size of TCP receive buffer, is set
                                        later with setsockopt */
     int tcp_buffer_size_send;       /* Size of TCP send buffer */
+    int tcp_progress_threads;       /* Number of BMI TCP progress threads */
     int tcp_bind_specific;          /* Flag indicates if we should bind to
                                      * specific server address
                                      */
@@ -218,6 +238,12 @@ typedef struct server_configuration_s
     int trove_max_concurrent_io;    /* allow the number of aio operations to
                                      * be configurable.
                                      */
+    int trove_meta_threads;         /* number of threads servicing queued
+                                     * keyval and dspace operations
+                                     */
+    int trove_open_cache_size;      /* number of bstream file descriptors
+                                     * kept open
+                                     */
     int trove_method;
 	
     char *keystore_path;             /* location of trusted server public keys */
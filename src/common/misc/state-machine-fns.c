@@ -16,6 +16,8 @@
 #include "pvfs2-debug.h"
 #include "state-machine.h"
 #include "client-state-machine.h"
+#include "gen-locks.h"
+#include "pint-slab.h"
 
 struct PINT_frame_s
 {
@@ -25,11 +27,49 @@ struct PINT_frame_s
     struct qlist_head link;
 };
 
+/* every state machine needs an smcb and at least one frame entry, so
+ * both come from caches that are set up on first use
+ */
+static struct PINT_slab_cache *smcb_cache = NULL;
+static struct PINT_slab_cache *frame_entry_cache = NULL;
+static gen_mutex_t sm_cache_mutex = GEN_MUTEX_INITIALIZER;
+
+static int PINT_sm_caches_init(void);
+
 static struct PINT_state_s *PINT_pop_state(struct PINT_smcb *);
 static void PINT_push_state(struct PINT_smcb *, struct PINT_state_s *);
 static struct PINT_state_s *PINT_sm_task_map(struct PINT_smcb *smcb, int task_id);
 static void PINT_sm_start_child_frames(struct PINT_smcb *smcb, int* children_started);
 
+/* Function: PINT_sm_caches_init
+   Params: None
+   Returns: 0 on success, -PVFS_ENOMEM on failure
+   Synopsis: creates the smcb and frame entry caches if they do not
+        exist yet.  frame_entry_cache is created last and is what
+        callers test to skip the mutex.
+ */
+static int PINT_sm_caches_init(void)
+{
+    int ret = 0;
+
+    gen_mutex_lock(&sm_cache_mutex);
+    if (!smcb_cache)
+    {
+        smcb_cache = PINT_slab_create("smcb", sizeof(struct PINT_smcb));
+    }
+    if (smcb_cache && !frame_entry_cache)
+    {
+        frame_entry_cache = PINT_slab_create("sm_frame",
+                                             sizeof(struct PINT_frame_s));
+    }
+    if (!frame_entry_cache)
+    {
+        ret = -PVFS_ENOMEM;
+    }
+    gen_mutex_unlock(&sm_cache_mutex);
+    return ret;
+}
+
 /* Function: PINT_state_machine_halt(void)
    Params: None
    Returns: True
@@ -522,13 +562,17 @@ int PINT_smcb_alloc(
         int (*term_fn)(struct PINT_smcb *, job_status_s *),
         job_context_id context_id)
 {
-    *smcb = (struct PINT_smcb *)malloc(sizeof(struct PINT_smcb));
+    if (!frame_entry_cache && PINT_sm_caches_init() < 0)
+    {
+        *smcb = NULL;
+        return -PVFS_ENOMEM;
+    }
+    /* members come back zeroed */
+    *smcb = (struct PINT_smcb *)PINT_slab_alloc(smcb_cache);
     if (!(*smcb))
     {
         return -PVFS_ENOMEM;
     }
-    /* zero out all members */
-    memset(*smcb, 0, sizeof(struct PINT_smcb));
 
     INIT_QLIST_HEAD(&(*smcb)->frames);
     (*smcb)->base_frame = -1; /* no frames yet */
@@ -540,7 +584,7 @@ int PINT_smcb_alloc(
         void *new_frame = malloc(frame_size);
         if (!new_frame)
         {
-            free(*smcb);
+            PINT_slab_free(smcb_cache, *smcb);
             *smcb = NULL;
             return -PVFS_ENOMEM;
         }
@@ -597,9 +641,9 @@ void PINT_smcb_free(struct PINT_smcb *smcb)
             free(frame_entry->frame);
         } 
         qlist_del(&frame_entry->link);
-        free(frame_entry);
+        PINT_slab_free(frame_entry_cache, frame_entry);
     }
-    free(smcb);
+    PINT_slab_free(smcb_cache, smcb);
 }
 
 /* Function: PINT_pop_state
@@ -708,7 +752,11 @@ int PINT_sm_push_frame(struct PINT_smcb *smcb, int task_id, void *frame_p)
     gossip_debug(GOSSIP_STATE_MACHINE_DEBUG,
                  "[SM Frame PUSH]: (%p) frame: %p\n",
                  smcb, frame_p);
-    newframe = malloc(sizeof(struct PINT_frame_s));
+    if (!frame_entry_cache && PINT_sm_caches_init() < 0)
+    {
+        return -PVFS_ENOMEM;
+    }
+    newframe = PINT_slab_alloc(frame_entry_cache);
     if(!newframe)
     {
         return -PVFS_ENOMEM;
@@ -755,7 +803,7 @@ void *PINT_sm_pop_frame(struct PINT_smcb *smcb,
     *error_code = frame_entry->error;
     *task_id = frame_entry->task_id;
 
-    free(frame_entry);
+    PINT_slab_free(frame_entry_cache, frame_entry);
 
     gossip_debug(GOSSIP_STATE_MACHINE_DEBUG,
             "[SM Frame POP]: (%p) frame: %p\n",
@@ -7,6 +7,8 @@
 
 #include <string.h>
 #include <assert.h>
+#include <stdio.h>
+#include <time.h>
 
 #include "pvfs2-internal.h"
 #include "tcache.h"
@@ -24,16 +26,57 @@ TCACHE_DEFAULT_HARD_LIMIT     = 10240,
 TCACHE_DEFAULT_RECLAIM_PERCENTAGE = 25,
 TCACHE_DEFAULT_TABLE_SIZE     =  1019,
 TCACHE_DEFAULT_REPLACE_ALGORITHM  = LEAST_RECENTLY_USED,
+TCACHE_MIN_SHARD_BUCKETS      =    16,
+TCACHE_MAX_SHARD_BUCKETS      = 1 << 20,
 };
 
+/* hash functions are asked for a value below this; a power of two so
+ * that both "%" and "&" style hash functions use it fully
+ */
+#define TCACHE_HASH_SPACE (1 << 30)
+
+#ifdef WIN32
+#define tcache_count_add(__p, __n) \
+    InterlockedExchangeAdd((volatile LONG *)(__p), (__n))
+#else
+#define tcache_count_add(__p, __n) __sync_add_and_fetch((__p), (__n))
+#endif
+
+static uint64_t tcache_now_ms(void);
+static uint32_t tcache_hash(
+    struct PINT_tcache* tcache,
+    const void* key);
+static struct PINT_tcache_shard* tcache_shard(
+    struct PINT_tcache* tcache,
+    uint32_t hash);
+static struct qlist_head* tcache_bucket(
+    struct PINT_tcache* tcache,
+    struct PINT_tcache_shard* shard,
+    uint32_t hash);
+static void tcache_grow_shard(
+    struct PINT_tcache* tcache,
+    struct PINT_tcache_shard* shard);
+static int tcache_alloc_shards(
+    struct PINT_tcache* tcache,
+    unsigned int shard_count,
+    unsigned int bucket_count);
+static void tcache_free_shards(
+    struct PINT_tcache* tcache);
+static void tcache_set_shard_limits(
+    struct PINT_tcache* tcache);
+static int tcache_reclaim_shard(
+    struct PINT_tcache* tcache,
+    struct PINT_tcache_shard* shard,
+    int* reclaimed);
+static struct PINT_tcache_entry* tcache_clock_victim(
+    struct PINT_tcache_shard* shard);
+static void tcache_set_expiration(
+    struct PINT_tcache* tcache,
+    struct PINT_tcache_entry* entry);
 static int check_expiration(
     struct PINT_tcache* tcache,
     struct PINT_tcache_entry* entry, /**< tcached entry */
-    struct timeval * tv); /**< time interval to check expiration against */
-static int tcache_lookup_oldest(
-    struct PINT_tcache* tcache,       /**< pointer to tcache instance */
-    struct PINT_tcache_entry** entry, /**< tcache entry (output) */
-    int* status);                     /**< indicates if the entry is expired or not */
+    uint64_t now_ms); /**< time to check expiration against, 0 for now */
 
 /**
  * Initializes a tcache instance
@@ -44,9 +87,10 @@ struct PINT_tcache* PINT_tcache_initialize(
     to compare keys with payloads within entry, return 1 on match, 0 if not match */
     int (*hash_key) (const void *key, int table_size), /**< function to hash keys */
     int (*free_payload) (void* payload), /**< function to free payload members (used during reclaim) */
-    int table_size) /**< size of hash table to use */
+    int table_size) /**< size of hash table to use, across all shards */
 {
     struct PINT_tcache* tcache_tmp = NULL;
+    unsigned int bucket_count = TCACHE_MIN_SHARD_BUCKETS;
 
     /* check parameters */
     assert(compare_key_entry);
@@ -72,16 +116,25 @@ struct PINT_tcache* PINT_tcache_initialize(
     tcache_tmp->num_entries = 0;
     tcache_tmp->enable = 1;
 
-    tcache_tmp->h_table = qhash_init(compare_key_entry, hash_key,
-        (table_size <= 0 ? TCACHE_DEFAULT_TABLE_SIZE : table_size));
-    if(!tcache_tmp->h_table)
+    /* split the requested table size over the shards, rounded up to a
+     * power of two; shards grow their buckets as they fill
+     */
+    if(table_size <= 0)
+    {
+        table_size = TCACHE_DEFAULT_TABLE_SIZE;
+    }
+    while(bucket_count * TCACHE_DEFAULT_SHARD_COUNT < (unsigned int)table_size)
+    {
+        bucket_count *= 2;
+    }
+
+    if(tcache_alloc_shards(tcache_tmp, TCACHE_DEFAULT_SHARD_COUNT,
+                           bucket_count) < 0)
     {
         free(tcache_tmp);
         return(NULL);
     }
 
-    INIT_QLIST_HEAD(&(tcache_tmp->lru_list));
-
     return(tcache_tmp);
 }
 
@@ -89,36 +142,13 @@ struct PINT_tcache* PINT_tcache_initialize(
 void PINT_tcache_finalize(
     struct PINT_tcache* tcache) /**< tcache instance to destroy */
 {
-    int i;
-    struct qlist_head *iterator = NULL, *scratch = NULL;
-    struct PINT_tcache_entry* tmp_entry;
-
-    /* TODO: simplify by iterating LRU list instead of hash table */
-
     if (!tcache)
     {
         gossip_err("PINT_tcache_finalize called with NULL pointer\n");
         return;
     }
 
-    /* iterate through hash table and destroy all entries */
-    for(i = 0; i < tcache->h_table->table_size; i++)
-    {
-        qlist_for_each_safe(iterator, scratch, &(tcache->h_table->array[i]))
-        {
-            tmp_entry = qlist_entry(iterator, struct PINT_tcache_entry,
-                hash_link);
-            assert(tmp_entry);
-
-            PINT_tcache_delete(tcache, tmp_entry);
-        }
-    }
-
-    /* assuming that all entries were destroyed in hash table, then there
-     * should be nothing left to clean up in LRU list 
-     */
-    
-    qhash_finalize(tcache->h_table);
+    tcache_free_shards(tcache);
 
     /* make sure that we haven't lost any entries */
     assert(tcache->num_entries == 0);
@@ -177,6 +207,10 @@ int PINT_tcache_get_info(
             *arg = tcache->replacement_algorithm;
             ret = 0;
             break;
+        case TCACHE_NUM_SHARDS:
+            *arg = tcache->shard_count;
+            ret = 0;
+            break;
         /* leave out "default" on purpose so we get a compile warning if a case
          * is not handled
          */
@@ -195,6 +229,8 @@ int PINT_tcache_set_info(
     unsigned int arg)         /**< input value */
 {
     int ret = -1;
+    unsigned int bucket_count, old_count;
+    struct PINT_tcache_shard* old_shards;
 
     switch(option)
     {
@@ -221,12 +257,46 @@ int PINT_tcache_set_info(
             /* this parameter cannot be set */
             ret = -PVFS_EINVAL;
             break;
+        case TCACHE_NUM_SHARDS:
+            /* only a power of two, and only while the cache is empty and
+             * nobody else is using it
+             */
+            if(arg < 1 || (arg & (arg - 1)) || tcache->num_entries != 0)
+            {
+                return(-PVFS_EINVAL);
+            }
+            bucket_count = (tcache->shard_count *
+                            tcache->shards[0].bucket_count) / arg;
+            if(bucket_count < TCACHE_MIN_SHARD_BUCKETS)
+            {
+                bucket_count = TCACHE_MIN_SHARD_BUCKETS;
+            }
+            old_shards = tcache->shards;
+            old_count = tcache->shard_count;
+            ret = tcache_alloc_shards(tcache, arg, bucket_count);
+            if(ret < 0)
+            {
+                /* keep the shards we had */
+                tcache->shards = old_shards;
+                tcache->shard_count = old_count;
+                return(ret);
+            }
+            /* the old shards are empty */
+            while(old_count > 0)
+            {
+                old_count--;
+                free(old_shards[old_count].buckets);
+                gen_mutex_destroy(&old_shards[old_count].mutex);
+            }
+            free(old_shards);
+            break;
         case TCACHE_HARD_LIMIT:
             if(arg < 1)
             {
                 return(-PVFS_EINVAL);
             }
             tcache->hard_limit = arg;
+            tcache_set_shard_limits(tcache);
             ret = 0;
             break;
         case TCACHE_SOFT_LIMIT:
@@ -235,6 +305,7 @@ int PINT_tcache_set_info(
                 return(-PVFS_EINVAL);
             }
             tcache->soft_limit = arg;
+            tcache_set_shard_limits(tcache);
             ret = 0;
             break;
         case TCACHE_ENABLE:
@@ -298,7 +369,10 @@ int PINT_tcache_insert_entry_ex(
 
 {
     struct PINT_tcache_entry* tmp_entry = NULL;
-    int tmp_status = 0;
+    struct PINT_tcache_shard* shard = NULL;
+    struct timeval now_tv;
+    int64_t delta_ms;
+    uint32_t hash;
     int ret = -1;
 
     *purged = 0;
@@ -310,11 +384,14 @@ int PINT_tcache_insert_entry_ex(
         return(0);
     }
 
+    hash = tcache_hash(tcache, key);
+    shard = tcache_shard(tcache, hash);
+
     /* are we over the soft limit? */
-    if(tcache->num_entries >= tcache->soft_limit)
+    if(shard->num_entries >= shard->soft_limit)
     {
         /* try to reclaim some entries */
-        ret = PINT_tcache_reclaim(tcache, purged);
+        ret = tcache_reclaim_shard(tcache, shard, purged);
         if(ret < 0)
         {
             return(ret);
@@ -322,25 +399,14 @@ int PINT_tcache_insert_entry_ex(
     }
 
     /* are we over the hard limit? */
-    if(tcache->num_entries >= tcache->hard_limit)
+    if(shard->num_entries >= shard->hard_limit)
     {
-        /* remove oldest entry. Each algorithm must follow the return interface 
-         * definition like tcache_lookup_oldest 
-         */
-        switch(tcache->replacement_algorithm)
-        {
-            case LEAST_RECENTLY_USED:
-                ret = tcache_lookup_oldest(tcache, &tmp_entry, &tmp_status);
-                break;
-        }
-
-        if(ret < 0)
+        /* remove the entry the CLOCK hand settles on */
+        tmp_entry = tcache_clock_victim(shard);
+        if(!tmp_entry)
         {
-            return(ret);
+            return(-PVFS_ENOENT);
         }
-        /* we don't care about the status- we need to remove an entry
-         * regardless
-         */
         ret = PINT_tcache_delete(tcache, tmp_entry);
         if(ret < 0)
         {
@@ -357,30 +423,39 @@ int PINT_tcache_insert_entry_ex(
         return(-PVFS_ENOMEM);
     }
     tmp_entry->payload = payload;
+    tmp_entry->hash = hash;
+    tmp_entry->shard = shard;
+    /* a new entry survives one pass of the hand */
+    tmp_entry->referenced = 1;
 
-    /* set expiration date */
+    /* set expiration date; the caller's is in wall clock time */
     if (expiration)
     {
-        memcpy(&tmp_entry->expiration_date, expiration,
-               sizeof(struct timeval));
+        gettimeofday(&now_tv, NULL);
+        delta_ms = ((int64_t)(expiration->tv_sec - now_tv.tv_sec) * 1000) +
+                   ((expiration->tv_usec - now_tv.tv_usec) / 1000);
+        tmp_entry->expiration_ms =
+            (delta_ms > 0) ? tcache_now_ms() + delta_ms : 0;
     }
     else
     {
-        ret = PINT_tcache_refresh_entry(tcache, tmp_entry);
-        if(ret < 0)
-        {
-            free(tmp_entry);
-            return(ret);
-        }
+        tcache_set_expiration(tcache, tmp_entry);
     }
 
-    /* add to hash table */
-    qhash_add(tcache->h_table, key, &tmp_entry->hash_link);
+    /* add to hash bucket */
+    qlist_add(&tmp_entry->hash_link, tcache_bucket(tcache, shard, hash));
 
-    /* add to LRU list (tail) */
-    qlist_add_tail(&tmp_entry->lru_list_link, &tcache->lru_list);
+    /* add to CLOCK ring (tail) */
+    qlist_add_tail(&tmp_entry->clock_link, &shard->clock_list);
     
-    tcache->num_entries++;
+    shard->num_entries++;
+    tcache_count_add(&tcache->num_entries, 1);
+
+    if(shard->num_entries > 2 * shard->bucket_count &&
+       shard->bucket_count < TCACHE_MAX_SHARD_BUCKETS)
+    {
+        tcache_grow_shard(tcache, shard);
+    }
 
     return(0);
 }
@@ -397,101 +472,463 @@ int PINT_tcache_lookup(
     struct PINT_tcache_entry** entry, /**< tcache entry (output) */
     int* status)                      /**< indicates if the entry is expired or not */
 {
-    struct qhash_head* link;
+    struct PINT_tcache_shard* shard;
+    struct qlist_head* bucket;
+    struct qlist_head* link;
+    uint32_t hash;
 
     *status = -PVFS_EINVAL;
     *entry = NULL;
 
-    link = qhash_search(tcache->h_table, key);
-    if(!link)
+    hash = tcache_hash(tcache, key);
+    shard = tcache_shard(tcache, hash);
+    bucket = tcache_bucket(tcache, shard, hash);
+
+    qlist_for_each(link, bucket)
+    {
+        if(tcache->compare_key_entry(key, link))
+        {
+            *entry = qlist_entry(link, struct PINT_tcache_entry, hash_link);
+            break;
+        }
+    }
+    if(!*entry)
     {
+        shard->misses++;
         return(-PVFS_ENOENT);
     }
-
-    /* find entry */
-    *entry = qlist_entry(link, struct PINT_tcache_entry, hash_link);
+    shard->hits++;
 
     /* check status. Let the function determine expiration */
-    *status = check_expiration(tcache, *entry, NULL);
+    *status = check_expiration(tcache, *entry, 0);
 
-    /* put at tail of LRU */
-    qlist_del(&((*entry)->lru_list_link));
-    qlist_add_tail(&((*entry)->lru_list_link), &tcache->lru_list);
+    /* give it another pass of the CLOCK hand */
+    (*entry)->referenced = 1;
 
     return(0);
 }
 
 /**
- * Looks up the oldest entry in the tcache.  Subsequent tcache function 
- * calls may destroy the entry and payload.  Therefore the caller should 
- * copy the payload data if it intends to use it after another tcache 
- * function call.
+ * Tries to purge and destroy expired entries, up to
+ * TCACHE_RECLAIM_PERCENTAGE of the current soft limit value.  The
+ * payload_free() function is used to destroy the payload associated with
+ * reclaimed entries.  Locks each shard in turn, so the caller must not
+ * hold a shard lock.
  * \return 0 on success, -PVFS_error on failure
  */
-int tcache_lookup_oldest(
-    struct PINT_tcache* tcache,       /**< pointer to tcache instance */
-    struct PINT_tcache_entry** entry, /**< tcache entry (output) */
-    int* status)                      /**< indicates if the entry is expired or not */
+int PINT_tcache_reclaim(
+    struct PINT_tcache* tcache, /**< pointer to tcache instance */
+    int* reclaimed)             /**< number of entries reclaimed */
 {
-    *entry = NULL;
-    *status = -PVFS_EINVAL;
+    unsigned int i;
+    int shard_reclaimed;
+    int ret = 0;
+
+    *reclaimed = 0;
 
-    if(qlist_empty(&tcache->lru_list))
+    for(i = 0; i < tcache->shard_count && ret == 0; i++)
     {
-        return(-PVFS_ENOENT);
+        gen_mutex_lock(&tcache->shards[i].mutex);
+        ret = tcache_reclaim_shard(tcache, &tcache->shards[i],
+                                   &shard_reclaimed);
+        gen_mutex_unlock(&tcache->shards[i].mutex);
+        *reclaimed += shard_reclaimed;
     }
 
-    /* find pointer to item at head of LRU list */
-    *entry = qlist_entry(tcache->lru_list.next, struct PINT_tcache_entry,
-        lru_list_link);
-    assert(*entry);
+    return(ret);
+}
+
+/**
+ * Removes and destroys specified tcache entry.  The payload_free() function
+ * will be used to destroy payload data.
+ * \return 0 on success, -PVFS_error on failure
+ */
+int PINT_tcache_delete(
+    struct PINT_tcache* tcache,      /**< pointer to tcache instance */
+    struct PINT_tcache_entry* entry) /**< entry to remove and destroy */
+{
+    struct PINT_tcache_shard* shard = entry->shard;
+
+    /* remove from hash bucket */
+    qlist_del(&entry->hash_link);
 
-    /* do not move it */
+    /* remove from CLOCK ring, moving the hand off of it first */
+    if(shard->clock_hand == &entry->clock_link)
+    {
+        shard->clock_hand = entry->clock_link.next;
+    }
+    qlist_del(&entry->clock_link);
 
-    /* check status. */
-    *status = check_expiration(tcache, *entry, NULL);
+    shard->num_entries--;
+    tcache_count_add(&tcache->num_entries, -1);
+
+    /* destroy payload and entry */
+    tcache->free_payload(entry->payload);
+    free(entry);
 
     return(0);
 }
 
 /**
- * Tries to purge and destroy expired entries, up to
- * TCACHE_RECLAIM_PERCENTAGE of the current soft limit value.  The
- * payload_free() function is used to destroy the payload associated with
- * reclaimed entries. 
+ * Updates the timestamp on the specified entry to TCACHE_TIMEOUT
+ * milliseconds in the future
  * \return 0 on success, -PVFS_error on failure
  */
-int PINT_tcache_reclaim(
+int PINT_tcache_refresh_entry(
+    struct PINT_tcache* tcache,      /**< pointer to tcache instance */
+    struct PINT_tcache_entry* entry) /**< entry to refresh */
+{
+    struct PINT_tcache_shard* shard = entry->shard;
+
+    if(!tcache->expiration_enabled) return 0;
+
+    tcache_set_expiration(tcache, entry);
+
+    /* keep the ring ordered by expiration for reclaim */
+    if(shard->clock_hand == &entry->clock_link)
+    {
+        shard->clock_hand = entry->clock_link.next;
+    }
+    qlist_del(&entry->clock_link);
+    qlist_add_tail(&entry->clock_link, &shard->clock_list);
+
+    return(0);
+}
+
+/**
+ * Locks the shard that holds (or would hold) the given key.  While the
+ * lock is held the caller may insert, look up, refresh and delete that
+ * key and use the entry and payload returned.
+ * \return the shard, to be passed to PINT_tcache_unlock_shard()
+ */
+struct PINT_tcache_shard* PINT_tcache_lock_key(
     struct PINT_tcache* tcache, /**< pointer to tcache instance */
-    int* reclaimed)             /**< number of entries reclaimed */
+    const void* key)            /**< key the caller is about to use */
+{
+    struct PINT_tcache_shard* shard;
+
+    shard = tcache_shard(tcache, tcache_hash(tcache, key));
+    gen_mutex_lock(&shard->mutex);
+    return(shard);
+}
+
+/** Releases a shard locked by PINT_tcache_lock_key() */
+void PINT_tcache_unlock_shard(
+    struct PINT_tcache_shard* shard) /**< shard to unlock */
+{
+    gen_mutex_unlock(&shard->mutex);
+}
+
+/**
+ * Retrieves the entry count and lookup statistics of one shard
+ * \return 0 on success, -PVFS_error on failure
+ */
+int PINT_tcache_get_shard_stats(
+    struct PINT_tcache* tcache,  /**< pointer to tcache instance */
+    unsigned int shard,          /**< index of shard, below TCACHE_NUM_SHARDS */
+    unsigned int* num_entries,   /**< entries in the shard (output) */
+    uint64_t* hits,              /**< lookups that found an entry (output) */
+    uint64_t* misses)            /**< lookups that did not (output) */
+{
+    struct PINT_tcache_shard* s;
+
+    if(shard >= tcache->shard_count)
+    {
+        return(-PVFS_EINVAL);
+    }
+    s = &tcache->shards[shard];
+
+    gen_mutex_lock(&s->mutex);
+    *num_entries = s->num_entries;
+    *hits = s->hits;
+    *misses = s->misses;
+    gen_mutex_unlock(&s->mutex);
+
+    return(0);
+}
+
+/**
+ * Formats the entry count and hit rate of each shard as text, one line
+ * per shard.  The caller must free the returned string.
+ * \return string on success, NULL on failure
+ */
+char* PINT_tcache_generate_shard_text(
+    struct PINT_tcache* tcache, /**< pointer to tcache instance */
+    int max_size)               /**< maximum size of string, including NUL */
+{
+    char *tmp_str;
+    int used = 0, ret;
+    unsigned int i, num_entries;
+    uint64_t hits, misses;
+
+    if(!tcache || max_size < 1)
+    {
+        return(NULL);
+    }
+
+    tmp_str = (char*)malloc(max_size);
+    if(!tmp_str)
+    {
+        return(NULL);
+    }
+    tmp_str[0] = '\0';
+
+    ret = snprintf(tmp_str, max_size, "%-8s%10s%16s%16s%8s\n",
+                   "shard", "entries", "hits", "misses", "hit%");
+    used = (ret < 0) ? max_size : ret;
+
+    for(i = 0; i < tcache->shard_count && used < max_size; i++)
+    {
+        PINT_tcache_get_shard_stats(tcache, i, &num_entries, &hits, &misses);
+        ret = snprintf(tmp_str + used, max_size - used,
+                       "%-8u%10u%16llu%16llu%7.1f%%\n",
+                       i, num_entries, llu(hits), llu(misses),
+                       (hits + misses) ?
+                           (100.0 * hits) / (double)(hits + misses) : 0.0);
+        if(ret < 0)
+        {
+            break;
+        }
+        used += ret;
+    }
+
+    return(tmp_str);
+}
+
+/* tcache_now_ms()
+ *
+ * reads a coarse monotonic clock; cheap enough to call on every lookup
+ *
+ * returns milliseconds from an arbitrary starting point
+ */
+static uint64_t tcache_now_ms(void)
+{
+#ifdef WIN32
+    return((uint64_t)GetTickCount64());
+#else
+    struct timespec ts;
+
+#ifdef CLOCK_MONOTONIC_COARSE
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return(((uint64_t)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000));
+#endif
+}
+
+/* tcache_hash()
+ *
+ * hashes a key with the caller's hash function and mixes the result so
+ * that its low bits pick the shard and the rest the bucket
+ */
+static uint32_t tcache_hash(
+    struct PINT_tcache* tcache,
+    const void* key)
+{
+    uint32_t hash = (uint32_t)tcache->hash_key(key, TCACHE_HASH_SPACE);
+
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6b;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35;
+    hash ^= hash >> 16;
+    return(hash);
+}
+
+static struct PINT_tcache_shard* tcache_shard(
+    struct PINT_tcache* tcache,
+    uint32_t hash)
+{
+    return(&tcache->shards[hash & (tcache->shard_count - 1)]);
+}
+
+static struct qlist_head* tcache_bucket(
+    struct PINT_tcache* tcache,
+    struct PINT_tcache_shard* shard,
+    uint32_t hash)
+{
+    return(&shard->buckets[(hash / tcache->shard_count) &
+                           (shard->bucket_count - 1)]);
+}
+
+/* tcache_grow_shard()
+ *
+ * doubles the buckets of a shard and rehashes its entries; the shard
+ * keeps its old buckets if memory is short
+ */
+static void tcache_grow_shard(
+    struct PINT_tcache* tcache,
+    struct PINT_tcache_shard* shard)
+{
+    struct qlist_head* new_buckets;
+    struct qlist_head* iterator;
+    struct PINT_tcache_entry* tmp_entry;
+    unsigned int new_count = shard->bucket_count * 2;
+    unsigned int i;
+
+    new_buckets = (struct qlist_head*)malloc(
+        new_count * sizeof(struct qlist_head));
+    if(!new_buckets)
+    {
+        return;
+    }
+    for(i = 0; i < new_count; i++)
+    {
+        INIT_QLIST_HEAD(&new_buckets[i]);
+    }
+
+    free(shard->buckets);
+    shard->buckets = new_buckets;
+    shard->bucket_count = new_count;
+
+    qlist_for_each(iterator, &shard->clock_list)
+    {
+        tmp_entry = qlist_entry(iterator, struct PINT_tcache_entry,
+            clock_link);
+        qlist_add(&tmp_entry->hash_link,
+                  tcache_bucket(tcache, shard, tmp_entry->hash));
+    }
+}
+
+/* tcache_alloc_shards()
+ *
+ * creates the shards of a tcache, each with the given number of buckets
+ *
+ * returns 0 on success, -PVFS_error on failure
+ */
+static int tcache_alloc_shards(
+    struct PINT_tcache* tcache,
+    unsigned int shard_count,
+    unsigned int bucket_count)
+{
+    struct PINT_tcache_shard* shard;
+    unsigned int i, j;
+
+    tcache->shard_count = 0;
+    tcache->shards = (struct PINT_tcache_shard*)calloc(
+        shard_count, sizeof(struct PINT_tcache_shard));
+    if(!tcache->shards)
+    {
+        return(-PVFS_ENOMEM);
+    }
+
+    for(i = 0; i < shard_count; i++)
+    {
+        shard = &tcache->shards[i];
+        shard->buckets = (struct qlist_head*)malloc(
+            bucket_count * sizeof(struct qlist_head));
+        if(!shard->buckets)
+        {
+            tcache_free_shards(tcache);
+            return(-PVFS_ENOMEM);
+        }
+        for(j = 0; j < bucket_count; j++)
+        {
+            INIT_QLIST_HEAD(&shard->buckets[j]);
+        }
+        shard->bucket_count = bucket_count;
+        INIT_QLIST_HEAD(&shard->clock_list);
+        shard->clock_hand = &shard->clock_list;
+        gen_mutex_init(&shard->mutex);
+        tcache->shard_count++;
+    }
+    tcache_set_shard_limits(tcache);
+
+    return(0);
+}
+
+/* tcache_free_shards()
+ *
+ * destroys the entries and shards of a tcache
+ */
+static void tcache_free_shards(
+    struct PINT_tcache* tcache)
+{
+    struct qlist_head *iterator = NULL, *scratch = NULL;
+    struct PINT_tcache_entry* tmp_entry;
+    struct PINT_tcache_shard* shard;
+    unsigned int i;
+
+    /* every entry is on its shard's CLOCK ring */
+    for(i = 0; i < tcache->shard_count; i++)
+    {
+        shard = &tcache->shards[i];
+        qlist_for_each_safe(iterator, scratch, &shard->clock_list)
+        {
+            tmp_entry = qlist_entry(iterator, struct PINT_tcache_entry,
+                clock_link);
+            assert(tmp_entry);
+
+            PINT_tcache_delete(tcache, tmp_entry);
+        }
+        assert(shard->num_entries == 0);
+        free(shard->buckets);
+        gen_mutex_destroy(&shard->mutex);
+    }
+
+    free(tcache->shards);
+    tcache->shards = NULL;
+    tcache->shard_count = 0;
+}
+
+/* tcache_set_shard_limits()
+ *
+ * gives each shard its share of the soft and hard limits
+ */
+static void tcache_set_shard_limits(
+    struct PINT_tcache* tcache)
+{
+    unsigned int i, soft, hard;
+
+    soft = (tcache->soft_limit + tcache->shard_count - 1) /
+           tcache->shard_count;
+    hard = (tcache->hard_limit + tcache->shard_count - 1) /
+           tcache->shard_count;
+
+    for(i = 0; i < tcache->shard_count; i++)
+    {
+        gen_mutex_lock(&tcache->shards[i].mutex);
+        tcache->shards[i].soft_limit = soft;
+        tcache->shards[i].hard_limit = hard;
+        gen_mutex_unlock(&tcache->shards[i].mutex);
+    }
+}
+
+/* tcache_reclaim_shard()
+ *
+ * purges expired entries from the head of a shard's ring, which holds
+ * the entries inserted or refreshed longest ago, up to the reclaim
+ * percentage of the shard's soft limit.  Stops at the first entry that
+ * has not expired.
+ *
+ * returns 0 on success, -PVFS_error on failure
+ */
+static int tcache_reclaim_shard(
+    struct PINT_tcache* tcache,
+    struct PINT_tcache_shard* shard,
+    int* reclaimed)
 {
     struct qlist_head *iterator = NULL, *scratch = NULL;
     struct PINT_tcache_entry* tmp_entry;
     int entries_to_purge = (tcache->reclaim_percentage *
-        tcache->soft_limit)/100; 
-    int status = 0;
+        shard->soft_limit)/100; 
     int ret;
-    struct timeval tv;
+    uint64_t now_ms;
 
     *reclaimed = 0;
-    
-    /* Capture a moment in time to check for expiration. This keeps the 
-     * check_expiration function call from constantly having to call 
-     * gettimeofday for each tcached entry 
-     */
-    gettimeofday(&tv, NULL);
-    
-    /* work down LRU list to try oldest entries */
-    qlist_for_each_safe(iterator, scratch, &(tcache->lru_list))
+
+    /* read the clock once for the whole pass */
+    now_ms = tcache_now_ms();
+
+    qlist_for_each_safe(iterator, scratch, &shard->clock_list)
     {
         tmp_entry = qlist_entry(iterator, struct PINT_tcache_entry,
-            lru_list_link);
+            clock_link);
         assert(tmp_entry);
 
-        /* check status */
-        status = check_expiration(tcache, tmp_entry, &tv);
         /* break if not expired */
-        if(status == 0)
+        if(check_expiration(tcache, tmp_entry, now_ms) == 0)
         {
             break;
         }
@@ -515,54 +952,49 @@ int PINT_tcache_reclaim(
     return(0);
 }
 
-/**
- * Removes and destroys specified tcache entry.  The payload_free() function
- * will be used to destroy payload data.
- * \return 0 on success, -PVFS_error on failure
+/* tcache_clock_victim()
+ *
+ * advances the shard's CLOCK hand, clearing reference bits, until it
+ * finds an entry whose bit is already clear
+ *
+ * returns the entry to replace, or NULL if the shard is empty
  */
-int PINT_tcache_delete(
-    struct PINT_tcache* tcache,      /**< pointer to tcache instance */
-    struct PINT_tcache_entry* entry) /**< entry to remove and destroy */
+static struct PINT_tcache_entry* tcache_clock_victim(
+    struct PINT_tcache_shard* shard)
 {
-    /* remove from hash table */
-    qhash_del(&entry->hash_link);
-
-    /* remove from lru list */
-    qlist_del(&entry->lru_list_link);
+    struct PINT_tcache_entry* tmp_entry;
 
-    tcache->num_entries--;
+    if(qlist_empty(&shard->clock_list))
+    {
+        return(NULL);
+    }
 
-    /* destroy payload and entry */
-    tcache->free_payload(entry->payload);
-    free(entry);
+    /* ends within two turns, as each visit clears a bit */
+    for(;;)
+    {
+        if(shard->clock_hand == &shard->clock_list)
+        {
+            shard->clock_hand = shard->clock_list.next;
+        }
+        tmp_entry = qlist_entry(shard->clock_hand, struct PINT_tcache_entry,
+            clock_link);
+        shard->clock_hand = shard->clock_hand->next;
 
-    return(0);
+        if(!tmp_entry->referenced)
+        {
+            return(tmp_entry);
+        }
+        tmp_entry->referenced = 0;
+    }
 }
 
-/**
- * Updates the timestamp on the specified entry to TCACHE_TIMEOUT
- * milliseconds in the future
- * \return 0 on success, -PVFS_error on failure
- */
-int PINT_tcache_refresh_entry(
-    struct PINT_tcache* tcache,      /**< pointer to tcache instance */
-    struct PINT_tcache_entry* entry) /**< entry to refresh */
+static void tcache_set_expiration(
+    struct PINT_tcache* tcache,
+    struct PINT_tcache_entry* entry)
 {
-
-    if(!tcache->expiration_enabled) return 0;
-
-    gettimeofday(&entry->expiration_date, NULL);
-    entry->expiration_date.tv_sec += (tcache->timeout_msecs / 1000);
-    entry->expiration_date.tv_usec += ((tcache->timeout_msecs % 1000)*1000);
-    if(entry->expiration_date.tv_usec > 1000000)
-    {
-        entry->expiration_date.tv_usec -= 1000000;
-        entry->expiration_date.tv_sec += 1;
-    }
-    return(0);
+    entry->expiration_ms = tcache_now_ms() + tcache->timeout_msecs;
 }
 
-
 /* check_expiration()
  *
  * checks to see if a given entry is expired or not
@@ -572,38 +1004,17 @@ int PINT_tcache_refresh_entry(
 static int check_expiration(
     struct PINT_tcache* tcache,
     struct PINT_tcache_entry* entry, /* tcached entry */
-    struct timeval * tv) /* time interval to check expiration against. Pass in
-                            NULL value to have function get current time */
+    uint64_t now_ms) /* time to check expiration against. Pass in 0 to
+                        have function read the clock */
 {
-    struct timeval local_tv;
-    struct timeval *tmp_tv = NULL;
-
     if(!tcache->expiration_enabled) return 0;
 
-    /* Blindly assign our variable to the passed in parameter, check for 
-       validity later */
-    tmp_tv = tv;
-
-    /* If the timeval parameter is NULL, we must get a current timeval to check
-     * for expiration
-     */
-    if(tmp_tv == NULL)
+    if(now_ms == 0)
     {
-        gettimeofday(&local_tv, NULL);
-        tmp_tv = &local_tv;
-    }
-
-    if(tmp_tv->tv_sec > entry->expiration_date.tv_sec)
-    {
-        return(-PVFS_ETIME);
-    }
-    
-    if(tmp_tv->tv_sec < entry->expiration_date.tv_sec)
-    {
-        return(0);
+        now_ms = tcache_now_ms();
     }
 
-    if(tmp_tv->tv_usec > entry->expiration_date.tv_usec)
+    if(now_ms > entry->expiration_ms)
     {
         return(-PVFS_ETIME);
     }
@@ -17,6 +17,7 @@
 #include "pvfs2-types.h"
 #include "quicklist.h"
 #include "quickhash.h"
+#include "gen-locks.h"
 
 
 /** \defgroup tcache Timeout Cache (tcache)
@@ -27,8 +28,13 @@
  * attribute or name cache may be built on top of this one.
  *
  * Notes:
- * - This interface is not thread safe.  Caller must provided any necessary
- * protection against race conditions.
+ * - The tcache is split into shards, each with its own lock, hash buckets
+ * and replacement state.  Every entry lives in the shard its key hashes
+ * to, and insert, lookup, refresh and delete only touch that shard.
+ * Callers may either serialize all calls themselves, or hold the lock of
+ * the key's shard (PINT_tcache_lock_key()) around the calls for that key
+ * and around any use of the entry and payload returned.  get_info,
+ * set_info and reclaim lock the shards themselves.
  * - Also note that keys should be considered immutable once an item is
  * inserted into the cache.
  * - The caller is responsible for allocating memory for payloads 
@@ -61,6 +67,13 @@
  *   that can exist in the cache.
  * - Once CACHE_HARD_LIMIT is reached, an item that needs to be
  *   cached will replace the least recently used item in the cache.
+ *   Recency is approximated with the CLOCK algorithm: lookups set a
+ *   reference bit, and a hand sweeping each shard evicts the first
+ *   entry whose bit is clear.
+ * - The limits apply to each shard in proportion; a shard's hash
+ *   buckets double when it holds twice as many entries as buckets.
+ * - Expiration uses a coarse monotonic clock with a resolution of a few
+ *   milliseconds.
  * - To turn OFF caching, set the CACHE_TIMEOUT_MSECS to 0 or set the
  *   "enable" option to 0
  * - keys and data cached are void * types
@@ -81,16 +94,39 @@
  */
 enum PINT_tcache_replace_algorithms
 {
-    LEAST_RECENTLY_USED = 1, /**< find the least recently used entry */
+    LEAST_RECENTLY_USED = 1, /**< find the least recently used entry (CLOCK) */
 };
 
+/** default number of shards in a tcache */
+#define TCACHE_DEFAULT_SHARD_COUNT 16
+
+struct PINT_tcache_shard;
+
 /** Describes a single entry in the tcache. */
 struct PINT_tcache_entry
 {
     void* payload;                   /**< data to store, must be matchable to a unique key*/
-    struct timeval expiration_date;  /**< when the entry will expire */
-    struct qhash_head hash_link;     /**< link to primary data structure */
-    struct qlist_head lru_list_link; /**< link to time ordered LRU list */
+    uint64_t expiration_ms;          /**< when the entry will expire (coarse monotonic clock) */
+    uint32_t hash;                   /**< hash of the key */
+    int referenced;                  /**< CLOCK reference bit */
+    struct PINT_tcache_shard *shard; /**< shard holding the entry */
+    struct qhash_head hash_link;     /**< link to hash bucket */
+    struct qlist_head clock_link;    /**< link to the shard's CLOCK ring */
+};
+
+/** One lock stripe of a tcache */
+struct PINT_tcache_shard
+{
+    gen_mutex_t mutex;               /**< protects everything below */
+    struct qlist_head *buckets;      /**< hash buckets */
+    unsigned int bucket_count;       /**< number of buckets, a power of two */
+    unsigned int num_entries;        /**< entries in this shard */
+    unsigned int hard_limit;         /**< this shard's share of the hard limit */
+    unsigned int soft_limit;         /**< this shard's share of the soft limit */
+    struct qlist_head clock_list;    /**< entries in insertion order */
+    struct qlist_head *clock_hand;   /**< next entry the hand examines */
+    uint64_t hits;                   /**< lookups that found an entry */
+    uint64_t misses;                 /**< lookups that did not */
 };
 
 /** Describes a tcache instance */
@@ -112,10 +148,10 @@ struct PINT_tcache
     enum PINT_tcache_replace_algorithms replacement_algorithm; /**< what algorithm to use to find entry to replace */
     unsigned int enable;        /**< is the cache enabled? */
 
-    /** hash table */
-    struct qhash_table* h_table;
-    /** lru list */
-    struct qlist_head lru_list;
+    /** shards, each with its own lock, buckets and CLOCK ring */
+    struct PINT_tcache_shard* shards;
+    /** number of shards, a power of two */
+    unsigned int shard_count;
 };
 
 /** enumeration of options to get_info() and set_info() calls 
@@ -134,6 +170,9 @@ enum PINT_tcache_options
                                       *  entry to replace
                                       */
     TCACHE_ENABLE_EXPIRATION = 8, /**< turn on/off expiration */
+    TCACHE_NUM_SHARDS = 9,        /**< number of shards; a power of two,
+                                   *  set only while the cache is empty
+                                   */
 };
 
 struct PINT_tcache* PINT_tcache_initialize(
@@ -185,6 +224,24 @@ int PINT_tcache_refresh_entry(
     struct PINT_tcache* tcache,
     struct PINT_tcache_entry* entry);
 
+struct PINT_tcache_shard* PINT_tcache_lock_key(
+    struct PINT_tcache* tcache,
+    const void* key);
+
+void PINT_tcache_unlock_shard(
+    struct PINT_tcache_shard* shard);
+
+int PINT_tcache_get_shard_stats(
+    struct PINT_tcache* tcache,
+    unsigned int shard,
+    unsigned int* num_entries,
+    uint64_t* hits,
+    uint64_t* misses);
+
+char* PINT_tcache_generate_shard_text(
+    struct PINT_tcache* tcache,
+    int max_size);
+
 #endif /* __TCACHE_H */
 
 /* @} */
@@ -61,6 +61,8 @@ struct bmi_method_unexpected_info
 
 /* flags that can be set per method to affect behavior */
 #define BMI_METHOD_FLAG_NO_POLLING 1
+/* method only reaches peers on this host; preferred when listed */
+#define BMI_METHOD_FLAG_LOCAL 2
 
 /* This is the table of interface functions that must be provided by BMI
  * methods.
@@ -174,6 +176,18 @@ struct bmi_method_ops
     int (*cancel)(bmi_op_id_t, bmi_context_id);
     const char* (*rev_lookup_unexpected)(bmi_method_addr_p);
     int (*query_addr_range)(bmi_method_addr_p, const char *, int);
+    /* optional; sends size bytes read from fd at offset without staging
+     * them in a user buffer.  NULL if the method cannot do this.
+     */
+    int (*post_send_fd) (bmi_op_id_t *,
+                         bmi_method_addr_p,
+                         int,
+                         int64_t,
+                         bmi_size_t,
+                         bmi_msg_tag_t,
+                         void *,
+                         bmi_context_id,
+                         PVFS_hint hints);
 };
 
 
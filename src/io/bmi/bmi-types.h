@@ -94,6 +94,7 @@ enum
     BMI_OPTIMISTIC_BUFFER_REG = 14,
     BMI_TCP_CHECK_UNEXPECTED = 15,
     BMI_TRANSPORT_METHODS_STRING = 16,
+    BMI_TCP_PROGRESS_THREADS = 17, /**< number of dedicated TCP progress threads */
 };
 
 enum BMI_io_type
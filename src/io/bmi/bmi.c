@@ -98,6 +98,9 @@ extern struct bmi_method_ops bmi_portals_ops;
 #ifdef __STATIC_METHOD_BMI_ZOID__
 extern struct bmi_method_ops bmi_zoid_ops;
 #endif
+#ifdef __STATIC_METHOD_BMI_SM__
+extern struct bmi_method_ops bmi_sm_ops;
+#endif
 
 static struct bmi_method_ops *const static_methods[] = {
 #ifdef __STATIC_METHOD_BMI_TCP__
@@ -123,6 +126,9 @@ static struct bmi_method_ops *const static_methods[] = {
 #endif
 #ifdef __STATIC_METHOD_BMI_ZOID__
     &bmi_zoid_ops,
+#endif
+#ifdef __STATIC_METHOD_BMI_SM__
+    &bmi_sm_ops,
 #endif
     NULL
 };
@@ -1843,7 +1849,9 @@ int BMI_addr_lookup(BMI_addr_t * new_addr,
     bmi_method_addr_p meth_addr = NULL;
     int ret = -1;
     int i = 0;
+    int k;
     int failed;
+    int meth_index = -1;    /* active method that resolved the address */
 
     gossip_debug(GOSSIP_BMI_DEBUG_CONTROL, "BMI_addr_lookup: %s\n", id_string);
 
@@ -1869,18 +1877,76 @@ int BMI_addr_lookup(BMI_addr_t * new_addr,
     }
     gossip_debug(GOSSIP_BMI_DEBUG_CONTROL, "\taddr not found, go to methods\n");
 
+    gen_mutex_lock(&active_method_count_mutex);
+
+    /* Methods that only reach peers on this host get the first look at
+     * any address that lists them.  They refuse peers they cannot reach,
+     * so an address like "sm://host:port,tcp://host:port" goes through
+     * shared memory when the server is local and through tcp otherwise,
+     * regardless of which method happened to be activated first.
+     */
+    for (k = 0; k < known_method_count && !meth_addr; k++)
+    {
+        char *local_key;
+
+        if (!(known_method_table[k]->flags & BMI_METHOD_FLAG_LOCAL))
+        {
+            continue;
+        }
+        /* well-known that mapping is "x" -> "bmi_x" */
+        local_key = string_key(known_method_table[k]->method_name + 4,
+                               id_string);
+        if (!local_key)
+        {
+            continue;
+        }
+        free(local_key);
+
+        for (i = 0; i < active_method_count; i++)
+        {
+            if (known_method_table[k] == active_method_table[i])
+            {
+                break;
+            }
+        }
+        if (i == active_method_count)
+        {
+            gossip_debug(GOSSIP_BMI_DEBUG_CONTROL,
+                         "\tActivating local method\n");
+            if (activate_method(known_method_table[k]->method_name,
+                                0, 0, bmi_opts) < 0)
+            {
+                /* not fatal; other methods may still reach the peer */
+                continue;
+            }
+            i = active_method_count - 1;  /* point at the new one */
+        }
+        meth_addr = active_method_table[i]->method_addr_lookup(id_string);
+        if (meth_addr)
+        {
+            meth_index = i;
+        }
+    }
+
     /* Now we will run through each method looking for one that
      * responds successfully.  It is assumed that they are already
      * listed in order of preference
      */
-    i = 0;
-    gen_mutex_lock(&active_method_count_mutex);
-    while ((i < active_method_count) &&
-           !(meth_addr = active_method_table[i]->method_addr_lookup(id_string)))
+    for (i = 0; i < active_method_count && !meth_addr; i++)
     {
+        if (active_method_table[i]->flags & BMI_METHOD_FLAG_LOCAL)
+        {
+            /* already tried above */
+            continue;
+        }
         gossip_debug(GOSSIP_BMI_DEBUG_CONTROL, 
                      "\tLooking up in active method\n");
-        i++;
+        meth_addr = active_method_table[i]->method_addr_lookup(id_string);
+        if (meth_addr)
+        {
+            meth_index = i;
+            break;
+        }
     }
 
     /* if not found, try to bring it up now */
@@ -1922,7 +1988,8 @@ int BMI_addr_lookup(BMI_addr_t * new_addr,
                              "\tLooking up in method\n");
                 meth_addr = known_method_table[i]->
                                     method_addr_lookup(id_string);
-                i = active_method_count - 1;  /* point at the new one */
+                /* point at the new one */
+                meth_index = active_method_count - 1;
                 break;
             }
         }
@@ -1957,7 +2024,7 @@ int BMI_addr_lookup(BMI_addr_t * new_addr,
         goto bmi_addr_lookup_failure;
     }
     strcpy(new_ref->id_string, id_string);
-    new_ref->interface = active_method_table[i];
+    new_ref->interface = active_method_table[meth_index];
 
     /* keep up with the reference and we are done */
     gen_mutex_lock(&ref_mutex);
@@ -1971,7 +2038,7 @@ int BMI_addr_lookup(BMI_addr_t * new_addr,
 
     if (meth_addr)
     {
-        active_method_table[i]->set_info(BMI_DROP_ADDR, meth_addr);
+        active_method_table[meth_index]->set_info(BMI_DROP_ADDR, meth_addr);
     }
 
     if (new_ref)
@@ -2056,6 +2123,61 @@ int BMI_post_send_list(bmi_op_id_t * id,
 }
 
 
+/** Submits a send operation whose payload is read directly from an open
+ *  file descriptor rather than from a memory buffer.  The receiver sees
+ *  an ordinary message and must use BMI_post_recv() as usual.  The fd
+ *  must remain open until the operation completes.
+ *
+ *  \return 0 on success that requires later poll, 1 on immediate
+ *  completion, -BMI_ENOSYS if the method for this address does not
+ *  support fd sends (callers are expected to fall back to
+ *  BMI_post_send()), other -errno on failure.
+ */
+int BMI_post_send_fd(bmi_op_id_t * id,
+                     BMI_addr_t dest,
+                     int fd,
+                     int64_t offset,
+                     bmi_size_t size,
+                     bmi_msg_tag_t tag,
+                     void *user_ptr,
+                     bmi_context_id context_id,
+                     bmi_hint hints)
+{
+    ref_st_p tmp_ref = NULL;
+
+    gossip_debug(GOSSIP_BMI_DEBUG_OFFSETS,
+                 "BMI_post_send_fd: addr: %ld, fd: %d, offset: %lld, "
+                 "size: %ld, tag: %d\n",
+                 (long) dest, fd, lld(offset), (long) size, (int) tag);
+
+    *id = 0;
+
+    gen_mutex_lock(&ref_mutex);
+    tmp_ref = ref_list_search_addr(cur_ref_list, dest);
+    if (!tmp_ref)
+    {
+        gen_mutex_unlock(&ref_mutex);
+        return (bmi_errno_to_pvfs(-EPROTO));
+    }
+    gen_mutex_unlock(&ref_mutex);
+
+    if (!tmp_ref->interface->post_send_fd)
+    {
+        return (bmi_errno_to_pvfs(-ENOSYS));
+    }
+
+    return (tmp_ref->interface->post_send_fd(id,
+                                             tmp_ref->method_addr,
+                                             fd,
+                                             offset,
+                                             size,
+                                             tag,
+                                             user_ptr,
+                                             context_id,
+                                             (PVFS_hint) hints));
+}
+
+
 /** Similar to BMI_post_recv(), except that the dest buffer is 
  *  replaced by a list of (possibly non contiguous) buffers
  *
@@ -54,6 +54,16 @@ int BMI_post_send(bmi_op_id_t * id,
 		  bmi_context_id context_id,
                   bmi_hint hints);
 
+int BMI_post_send_fd(bmi_op_id_t * id,
+                     BMI_addr_t dest,
+                     int fd,
+                     int64_t offset,
+                     bmi_size_t size,
+                     bmi_msg_tag_t tag,
+                     void *user_ptr,
+                     bmi_context_id context_id,
+                     bmi_hint hints);
+
 int BMI_post_sendunexpected(bmi_op_id_t * id,
 			    BMI_addr_t dest,
 			    const void *buffer,
@@ -858,6 +858,7 @@ int BMI_gm_set_info(int option,
     {
         case BMI_TCP_BUFFER_SEND_SIZE:
         case BMI_TCP_BUFFER_RECEIVE_SIZE:
+        case BMI_TCP_PROGRESS_THREADS:
         case BMI_FORCEFUL_CANCEL_MODE:
         case BMI_DROP_ADDR:
 #ifdef USE_TRUSTED
@@ -0,0 +1,147 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/*
+ * shared memory method addressing information and the layout of the
+ * memory region shared by the two ends of a connection
+ */
+
+#ifndef __BMI_SM_ADDRESSING_H
+#define __BMI_SM_ADDRESSING_H
+
+#include <sys/types.h>
+#include "bmi-types.h"
+#include "op-list.h"
+#include "quicklist.h"
+
+/*****************************************************************
+ * shared region layout
+ */
+
+#define BMI_SM_MAGIC 0x736d3031         /* "sm01" */
+
+/* bytes of ring in each direction; must be a power of two */
+#define BMI_SM_RING_SIZE (1024 * 1024)
+/* entries are padded to this many bytes so that a header never wraps */
+#define BMI_SM_ALIGN 64
+/* largest eager (and unexpected) message */
+#define BMI_SM_EAGER_LIMIT 16384
+/* largest fragment of a message streamed through the ring */
+#define BMI_SM_FRAG_SIZE 65536
+
+/* which end of the connection a process is; the connecting end owns
+ * ring 0 as producer, the accepting end ring 1
+ */
+#define BMI_SM_CONNECTOR 0
+#define BMI_SM_ACCEPTOR 1
+
+/* ring entry types */
+enum
+{
+    BMI_SM_PAD = 1,     /* filler up to the end of the ring */
+    BMI_SM_EAGER,       /* expected message, payload inline */
+    BMI_SM_UNEXP,       /* unexpected message, payload inline */
+    BMI_SM_RTS,         /* large message; payload lists sender's buffers */
+    BMI_SM_CTS,         /* receiver could not pull; payload lists its buffers */
+    BMI_SM_DATA,        /* one fragment of a streamed message */
+    BMI_SM_PULLED,      /* receiver copied the message out of the sender */
+    BMI_SM_PUSHED       /* sender copied the message into the receiver */
+};
+
+struct sm_msg_hdr
+{
+    uint32_t type;
+    uint32_t len;           /* payload bytes following the header */
+    bmi_msg_tag_t tag;
+    int32_t status;         /* PULLED/PUSHED: BMI error code or 0 */
+    uint64_t size;          /* RTS: message size, DATA: offset */
+    uint64_t send_id;       /* sender's op id (RTS, CTS, PULLED) */
+    uint64_t recv_id;       /* receiver's op id (CTS, DATA, PUSHED) */
+};
+
+/* a buffer as listed in RTS and CTS payloads */
+struct sm_iov
+{
+    uint64_t base;
+    uint64_t len;
+};
+
+/* one direction of the connection.  head is only written by the
+ * producer and tail only by the consumer; both count bytes since the
+ * connection was made.
+ */
+struct sm_ring
+{
+    volatile uint64_t head;
+    char pad1[BMI_SM_ALIGN - sizeof(uint64_t)];
+    volatile uint64_t tail;
+    char pad2[BMI_SM_ALIGN - sizeof(uint64_t)];
+    char data[BMI_SM_RING_SIZE];
+};
+
+struct sm_region
+{
+    uint32_t magic;
+    uint32_t ring_size;
+    /* set by an end before it sleeps in poll(); whoever clears it owes
+     * that end a wakeup byte on the socket
+     */
+    volatile int32_t sleeping[2];
+    /* set by an end that has messages queued for lack of ring space */
+    volatile int32_t blocked[2];
+    char pad[BMI_SM_ALIGN - 5 * sizeof(int32_t)];
+    struct sm_ring ring[2];
+};
+
+/*****************************************************************
+ * per address information
+ */
+
+struct sm_addr
+{
+    bmi_method_addr_p map;      /* points back to generic address */
+    BMI_addr_t bmi_addr;
+    /* stores error code for addresses that are broken for some reason */
+    int addr_error;
+    char *hostname;
+    int port;
+    int side;                   /* BMI_SM_CONNECTOR or BMI_SM_ACCEPTOR */
+    int socket;                 /* connection setup, wakeups, liveness */
+    struct sm_region *region;   /* NULL until the connection is set up */
+    pid_t peer_pid;
+    uid_t peer_uid;
+    int pidfd;                  /* pins peer_pid while copying across */
+    /* cleared once copying to or from the peer's memory was refused */
+    int vm_ok;
+    /* flag used to determine if we can reconnect this address after failure */
+    int dont_reconnect;
+    /* flag that indicates this address is our listening address */
+    int server_port;
+    op_list_p send_queue;       /* ops waiting for ring space */
+    op_list_p wait_queue;       /* ops waiting for the peer */
+    struct qlist_head link;     /* list of connected addresses */
+};
+
+/*****************************************************************
+ * function prototypes
+ */
+
+#define bmi_sm_errno_to_pvfs bmi_errno_to_pvfs
+
+void sm_forget_addr(bmi_method_addr_p map,
+                    int dealloc_flag,
+                    int error_code);
+
+#endif /* __BMI_SM_ADDRESSING_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
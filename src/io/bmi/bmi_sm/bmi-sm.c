@@ -0,0 +1,3272 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Shared memory implementation of a BMI method, for clients and servers
+ * that run on the same host.
+ *
+ * A server listens on a UNIX domain socket named after its port in the
+ * abstract namespace.  Any process may bind such a name, so a client
+ * only talks to a listener running as BMI_SM_SERVER_UID or as itself.
+ * A client connects to it, creates a memory region holding one ring per
+ * direction and passes the region's file descriptor over the socket.
+ * From then on messages travel through the rings; the socket is only
+ * used to wake an end that sleeps in poll() and to notice when the peer
+ * goes away.
+ *
+ * Messages up to BMI_SM_EAGER_LIMIT bytes are copied into the ring.
+ * Larger ones are announced with an RTS listing the sender's buffers,
+ * and the receiver copies the data directly out of the sender's address
+ * space with process_vm_readv().  If it may not, it answers with a CTS
+ * listing its own buffers and the sender tries process_vm_writev()
+ * instead.  If neither end may touch the other's memory the data is
+ * streamed through the ring in BMI_SM_FRAG_SIZE fragments.
+ *
+ * The addresses in an RTS or CTS come from the peer, so copying across
+ * is only tried between processes of the same unprivileged user, where
+ * the kernel's ptrace checks protect everything else, and only while a
+ * pidfd shows that the peer found at connect time is still alive.  A
+ * privileged process (typically a server running as root) always
+ * streams through the ring.
+ *
+ * Limitations:
+ * - peers must be on the same host; addresses for other hosts are
+ *   refused at lookup so that BMI falls back to the next method
+ * - Linux only (SO_PEERCRED, SCM_RIGHTS, abstract sockets, /dev/shm)
+ */
+
+#include "pvfs2-internal.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <sys/poll.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#include "bmi-method-support.h"
+#include "bmi-method-callback.h"
+#include "bmi-sm-addressing.h"
+#include "op-list.h"
+#include "gossip.h"
+#include "id-generator.h"
+#include "pvfs2-debug.h"
+#include "gen-locks.h"
+#include "pint-hint.h"
+
+/* abstract socket name servers listen on; the port is appended */
+#ifndef BMI_SM_SOCKET_PREFIX
+#define BMI_SM_SOCKET_PREFIX "pvfs2-sm-"
+#endif
+/* user that servers run as, besides the client's own */
+#ifndef BMI_SM_SERVER_UID
+#define BMI_SM_SERVER_UID 0
+#endif
+/* where connection regions are created (and immediately unlinked) */
+#ifndef BMI_SM_REGION_TEMPLATE
+#define BMI_SM_REGION_TEMPLATE "/dev/shm/pvfs2-sm.XXXXXX"
+#endif
+
+/* largest message we accept, as for bmi_tcp */
+#define BMI_SM_REND_LIMIT 16777216
+/* most buffers listed in an RTS or CTS */
+#define BMI_SM_MAX_IOV (BMI_SM_EAGER_LIMIT / sizeof(struct sm_iov))
+/* copying across processes needs a pidfd to pin the peer with */
+#if defined(HAVE_PROCESS_VM_READV) && defined(SYS_pidfd_open) && \
+    defined(SYS_pidfd_send_signal)
+#define BMI_SM_VM_COPY 1
+#endif
+/* most iovecs handed to one process_vm_readv/writev call */
+#define BMI_SM_VM_IOV 64
+/* how long to keep polling the rings before sleeping in poll() */
+#define BMI_SM_SPIN_USECS 20
+
+#define SM_ROUND(__s) (((__s) + BMI_SM_ALIGN - 1) & ~((uint64_t)BMI_SM_ALIGN - 1))
+#define SM_ADDR(__map) ((struct sm_addr *)(__map)->method_data)
+#define SM_OP(__op) ((struct sm_op *)(__op)->method_data)
+
+static gen_mutex_t interface_mutex = GEN_MUTEX_INITIALIZER;
+static gen_cond_t interface_cond = GEN_COND_INITIALIZER;
+static int poll_busy = 0;
+
+/* function prototypes */
+int BMI_sm_initialize(bmi_method_addr_p listen_addr,
+                      int method_id,
+                      int init_flags,
+                      char *options);
+int BMI_sm_finalize(void);
+int BMI_sm_set_info(int option,
+                    void *inout_parameter);
+int BMI_sm_get_info(int option,
+                    void *inout_parameter);
+void *BMI_sm_memalloc(bmi_size_t size,
+                      enum bmi_op_type send_recv);
+int BMI_sm_memfree(void *buffer,
+                   bmi_size_t size,
+                   enum bmi_op_type send_recv);
+int BMI_sm_unexpected_free(void *buffer);
+int BMI_sm_post_send(bmi_op_id_t *id,
+                     bmi_method_addr_p dest,
+                     const void *buffer,
+                     bmi_size_t size,
+                     enum bmi_buffer_type buffer_type,
+                     bmi_msg_tag_t tag,
+                     void *user_ptr,
+                     bmi_context_id context_id,
+                     PVFS_hint hints);
+int BMI_sm_post_sendunexpected(bmi_op_id_t *id,
+                               bmi_method_addr_p dest,
+                               const void *buffer,
+                               bmi_size_t size,
+                               enum bmi_buffer_type buffer_type,
+                               bmi_msg_tag_t tag,
+                               void *user_ptr,
+                               bmi_context_id context_id,
+                               PVFS_hint hints);
+int BMI_sm_post_recv(bmi_op_id_t *id,
+                     bmi_method_addr_p src,
+                     void *buffer,
+                     bmi_size_t expected_size,
+                     bmi_size_t *actual_size,
+                     enum bmi_buffer_type buffer_type,
+                     bmi_msg_tag_t tag,
+                     void *user_ptr,
+                     bmi_context_id context_id,
+                     PVFS_hint hints);
+int BMI_sm_test(bmi_op_id_t id,
+                int *outcount,
+                bmi_error_code_t *error_code,
+                bmi_size_t *actual_size,
+                void **user_ptr,
+                int max_idle_time_ms,
+                bmi_context_id context_id);
+int BMI_sm_testsome(int incount,
+                    bmi_op_id_t *id_array,
+                    int *outcount,
+                    int *index_array,
+                    bmi_error_code_t *error_code_array,
+                    bmi_size_t *actual_size_array,
+                    void **user_ptr_array,
+                    int max_idle_time_ms,
+                    bmi_context_id context_id);
+int BMI_sm_testunexpected(int incount,
+                          int *outcount,
+                          struct bmi_method_unexpected_info *info,
+                          int max_idle_time_ms);
+int BMI_sm_testcontext(int incount,
+                       bmi_op_id_t *out_id_array,
+                       int *outcount,
+                       bmi_error_code_t *error_code_array,
+                       bmi_size_t *actual_size_array,
+                       void **user_ptr_array,
+                       int max_idle_time_ms,
+                       bmi_context_id context_id);
+bmi_method_addr_p BMI_sm_method_addr_lookup(const char *id_string);
+int BMI_sm_post_send_list(bmi_op_id_t *id,
+                          bmi_method_addr_p dest,
+                          const void *const *buffer_list,
+                          const bmi_size_t *size_list,
+                          int list_count,
+                          bmi_size_t total_size,
+                          enum bmi_buffer_type buffer_type,
+                          bmi_msg_tag_t tag,
+                          void *user_ptr,
+                          bmi_context_id context_id,
+                          PVFS_hint hints);
+int BMI_sm_post_recv_list(bmi_op_id_t *id,
+                          bmi_method_addr_p src,
+                          void *const *buffer_list,
+                          const bmi_size_t *size_list,
+                          int list_count,
+                          bmi_size_t total_expected_size,
+                          bmi_size_t *total_actual_size,
+                          enum bmi_buffer_type buffer_type,
+                          bmi_msg_tag_t tag,
+                          void *user_ptr,
+                          bmi_context_id context_id,
+                          PVFS_hint hints);
+int BMI_sm_post_sendunexpected_list(bmi_op_id_t *id,
+                                    bmi_method_addr_p dest,
+                                    const void *const *buffer_list,
+                                    const bmi_size_t *size_list,
+                                    int list_count,
+                                    bmi_size_t total_size,
+                                    enum bmi_buffer_type buffer_type,
+                                    bmi_msg_tag_t tag,
+                                    void *user_ptr,
+                                    bmi_context_id context_id,
+                                    PVFS_hint hints);
+int BMI_sm_open_context(bmi_context_id context_id);
+void BMI_sm_close_context(bmi_context_id context_id);
+int BMI_sm_cancel(bmi_op_id_t id,
+                  bmi_context_id context_id);
+const char *BMI_sm_rev_lookup_unexpected(bmi_method_addr_p map);
+int BMI_sm_query_addr_range(bmi_method_addr_p map,
+                            const char *wildcard_string,
+                            int netmask);
+
+static char BMI_sm_method_name[] = "bmi_sm";
+
+/* exported method interface */
+const struct bmi_method_ops bmi_sm_ops = {
+    .method_name = BMI_sm_method_name,
+    .flags = BMI_METHOD_FLAG_LOCAL,
+    .initialize = BMI_sm_initialize,
+    .finalize = BMI_sm_finalize,
+    .set_info = BMI_sm_set_info,
+    .get_info = BMI_sm_get_info,
+    .memalloc = BMI_sm_memalloc,
+    .memfree  = BMI_sm_memfree,
+    .unexpected_free = BMI_sm_unexpected_free,
+    .post_send = BMI_sm_post_send,
+    .post_sendunexpected = BMI_sm_post_sendunexpected,
+    .post_recv = BMI_sm_post_recv,
+    .test = BMI_sm_test,
+    .testsome = BMI_sm_testsome,
+    .testcontext = BMI_sm_testcontext,
+    .testunexpected = BMI_sm_testunexpected,
+    .method_addr_lookup = BMI_sm_method_addr_lookup,
+    .post_send_list = BMI_sm_post_send_list,
+    .post_recv_list = BMI_sm_post_recv_list,
+    .post_sendunexpected_list = BMI_sm_post_sendunexpected_list,
+    .open_context = BMI_sm_open_context,
+    .close_context = BMI_sm_close_context,
+    .cancel = BMI_sm_cancel,
+    .rev_lookup_unexpected = BMI_sm_rev_lookup_unexpected,
+    .query_addr_range = BMI_sm_query_addr_range,
+};
+
+/* module parameters */
+static struct
+{
+    int method_flags;
+    int method_id;
+    int initialized;
+    bmi_method_addr_p listen_addr;
+    int listen_socket;
+    /* written to by threads that add a connection while another one
+     * sleeps in poll()
+     */
+    int wake_pipe[2];
+    char hostname[256];
+} sm_method_params;
+
+static int check_unexpected = 1;
+
+/* states of an operation */
+enum
+{
+    SM_OP_POSTED = 1,   /* receive waiting for a matching message */
+    SM_OP_EARLY,        /* message waiting for a matching receive */
+    SM_OP_EAGER,        /* eager send waiting for ring space */
+    SM_OP_RTS,          /* RTS waiting for ring space */
+    SM_OP_CTS,          /* CTS waiting for ring space */
+    SM_OP_PULLED,       /* PULLED waiting for ring space */
+    SM_OP_PUSHED,       /* PUSHED waiting for ring space */
+    SM_OP_DATA,         /* fragments waiting for ring space */
+    SM_OP_WAIT,         /* waiting for the peer's answer */
+    SM_OP_COMPLETE
+};
+
+/* method specific part of an operation */
+struct sm_op
+{
+    int state;
+    int unexpected;
+    /* status to report to the peer in PULLED */
+    int status;
+    /* the peer's op id once known */
+    bmi_op_id_t peer_id;
+    /* early RTS: the sender's buffers, if it listed them */
+    int rts;
+    int peer_iov_count;
+    struct sm_iov *peer_iov;
+    /* bytes streamed so far in SM_OP_DATA */
+    bmi_size_t data_done;
+};
+
+/* completion queues, one per context */
+static op_list_p completion_array[BMI_MAX_CONTEXTS] = { NULL };
+/* receives posted before their message arrived */
+static op_list_p recv_queue = NULL;
+/* messages that arrived before their receive was posted */
+static op_list_p early_queue = NULL;
+/* unexpected messages not yet picked up by testunexpected */
+static op_list_p unexp_queue = NULL;
+
+/* addresses with an open socket, polled by sm_do_work() */
+static QLIST_HEAD(sm_addr_list);
+static int sm_addr_count = 0;
+/* bumped whenever an address leaves sm_addr_list */
+static int sm_addr_generation = 0;
+
+/* scratch space for poll() */
+static struct pollfd *sm_pollfds = NULL;
+static struct sm_addr **sm_polladdrs = NULL;
+static int sm_poll_size = 0;
+
+/* internal utility functions */
+static bmi_method_addr_p alloc_sm_method_addr(void);
+static void dealloc_sm_method_addr(bmi_method_addr_p map);
+static int sm_host_is_local(const char *hostname);
+static int sm_server_init(void);
+static int sm_connect(struct sm_addr *sm_addr_data);
+static void sm_accept(void);
+static void sm_finish_accept(struct sm_addr *sm_addr_data);
+static void sm_close_addr(struct sm_addr *sm_addr_data);
+static int sm_do_work(int max_idle_time);
+static int sm_progress(void);
+static int sm_drain_socket(struct sm_addr *sm_addr_data);
+static void sm_wake_peer(struct sm_addr *sm_addr_data);
+static int sm_ring_push(struct sm_addr *sm_addr_data,
+                        struct sm_msg_hdr *hdr,
+                        const void *const *buffer_list,
+                        const bmi_size_t *size_list,
+                        int list_count,
+                        bmi_size_t offset);
+static int sm_ring_poll(struct sm_addr *sm_addr_data);
+static void sm_handle_msg(struct sm_addr *sm_addr_data,
+                          struct sm_msg_hdr *hdr,
+                          char *payload);
+static int sm_push_queue(struct sm_addr *sm_addr_data);
+static int sm_push_op(struct sm_addr *sm_addr_data, method_op_p op);
+static void sm_recv_rendezvous(struct sm_addr *sm_addr_data,
+                               method_op_p op,
+                               bmi_size_t size,
+                               bmi_op_id_t peer_id,
+                               const struct sm_iov *peer_iov,
+                               int peer_iov_count);
+static void sm_send_rendezvous(struct sm_addr *sm_addr_data,
+                               method_op_p op,
+                               bmi_op_id_t peer_id,
+                               const struct sm_iov *peer_iov,
+                               int peer_iov_count);
+static int sm_vm_copy(struct sm_addr *sm_addr_data,
+                      method_op_p op,
+                      const struct sm_iov *peer_iov,
+                      int peer_iov_count,
+                      bmi_size_t size,
+                      int write_flag);
+static int sm_list_iov(method_op_p op, struct sm_iov *iov, int max);
+static void sm_copy_to_list(method_op_p op,
+                            bmi_size_t offset,
+                            const char *src,
+                            bmi_size_t len);
+static method_op_p alloc_sm_method_op(bmi_method_addr_p map,
+                                      enum bmi_op_type send_recv,
+                                      void *const *buffer_list,
+                                      const bmi_size_t *size_list,
+                                      int list_count,
+                                      bmi_size_t total_size,
+                                      bmi_msg_tag_t tag,
+                                      void *user_ptr,
+                                      bmi_context_id context_id);
+static void dealloc_sm_method_op(method_op_p op);
+static method_op_p sm_find_op(op_list_p list,
+                              bmi_method_addr_p map,
+                              bmi_msg_tag_t tag);
+static method_op_p sm_find_wait(struct sm_addr *sm_addr_data,
+                                uint64_t id);
+static void sm_complete_op(method_op_p op, int error_code);
+static int sm_ready_addr(struct sm_addr *sm_addr_data);
+static int sm_post_send_generic(bmi_op_id_t *id,
+                                bmi_method_addr_p dest,
+                                const void *const *buffer_list,
+                                const bmi_size_t *size_list,
+                                int list_count,
+                                bmi_size_t total_size,
+                                bmi_msg_tag_t tag,
+                                void *user_ptr,
+                                bmi_context_id context_id,
+                                int unexpected);
+static int sm_post_recv_generic(bmi_op_id_t *id,
+                                bmi_method_addr_p src,
+                                void *const *buffer_list,
+                                const bmi_size_t *size_list,
+                                int list_count,
+                                bmi_size_t total_expected_size,
+                                bmi_size_t *total_actual_size,
+                                bmi_msg_tag_t tag,
+                                void *user_ptr,
+                                bmi_context_id context_id);
+
+/* handshake sent by the connecting end along with the region */
+struct sm_hello
+{
+    uint32_t magic;
+    uint32_t ring_size;
+};
+
+/*************************************************************************
+ * Visible Interface
+ */
+
+/* BMI_sm_initialize()
+ *
+ * Initializes the shared memory method.  Servers start listening for
+ * connections on the socket named after their port.
+ *
+ * returns 0 on success, -errno on failure
+ */
+int BMI_sm_initialize(bmi_method_addr_p listen_addr,
+                      int method_id,
+                      int init_flags,
+                      char *options)
+{
+    int ret = -1;
+    int tmp_errno = bmi_sm_errno_to_pvfs(-ENOSYS);
+
+    gossip_debug(GOSSIP_BMI_DEBUG_SM, "Initializing shared memory module.\n");
+
+    /* check args */
+    if ((init_flags & BMI_INIT_SERVER) && !listen_addr)
+    {
+        gossip_lerr("Error: bad parameters given to shared memory "
+                    "module.\n");
+        return (bmi_sm_errno_to_pvfs(-EINVAL));
+    }
+
+    gen_mutex_lock(&interface_mutex);
+
+    memset(&sm_method_params, 0, sizeof(sm_method_params));
+    sm_method_params.method_id = method_id;
+    sm_method_params.method_flags = init_flags;
+    sm_method_params.listen_socket = -1;
+    sm_method_params.wake_pipe[0] = -1;
+    sm_method_params.wake_pipe[1] = -1;
+    gethostname(sm_method_params.hostname,
+                sizeof(sm_method_params.hostname) - 1);
+
+    recv_queue = op_list_new();
+    early_queue = op_list_new();
+    unexp_queue = op_list_new();
+    if (!recv_queue || !early_queue || !unexp_queue)
+    {
+        tmp_errno = bmi_sm_errno_to_pvfs(-ENOMEM);
+        goto initialize_failure;
+    }
+
+    if (pipe(sm_method_params.wake_pipe) < 0)
+    {
+        tmp_errno = bmi_sm_errno_to_pvfs(-errno);
+        goto initialize_failure;
+    }
+    fcntl(sm_method_params.wake_pipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(sm_method_params.wake_pipe[1], F_SETFL, O_NONBLOCK);
+    fcntl(sm_method_params.wake_pipe[0], F_SETFD, FD_CLOEXEC);
+    fcntl(sm_method_params.wake_pipe[1], F_SETFD, FD_CLOEXEC);
+
+    if (init_flags & BMI_INIT_SERVER)
+    {
+        /* hang on to our local listening address */
+        sm_method_params.listen_addr = listen_addr;
+        ret = sm_server_init();
+        if (ret < 0)
+        {
+            tmp_errno = bmi_sm_errno_to_pvfs(ret);
+            gossip_err("Error: sm_server_init() failure.\n");
+            goto initialize_failure;
+        }
+    }
+
+    sm_method_params.initialized = 1;
+    gen_mutex_unlock(&interface_mutex);
+    gossip_debug(GOSSIP_BMI_DEBUG_SM,
+                 "Shared memory module successfully initialized.\n");
+    return (0);
+
+  initialize_failure:
+
+    if (recv_queue)
+    {
+        op_list_cleanup(recv_queue);
+        recv_queue = NULL;
+    }
+    if (early_queue)
+    {
+        op_list_cleanup(early_queue);
+        early_queue = NULL;
+    }
+    if (unexp_queue)
+    {
+        op_list_cleanup(unexp_queue);
+        unexp_queue = NULL;
+    }
+    if (sm_method_params.wake_pipe[0] >= 0)
+    {
+        close(sm_method_params.wake_pipe[0]);
+        close(sm_method_params.wake_pipe[1]);
+    }
+    gen_mutex_unlock(&interface_mutex);
+    return (tmp_errno);
+}
+
+
+/* BMI_sm_finalize()
+ *
+ * Shuts down the shared memory method.
+ *
+ * returns 0 on success, -errno on failure
+ */
+int BMI_sm_finalize(void)
+{
+    method_op_p op = NULL;
+    int i;
+
+    gen_mutex_lock(&interface_mutex);
+
+    /* shut down our listen addr, if we have one */
+    if (sm_method_params.listen_socket >= 0)
+    {
+        close(sm_method_params.listen_socket);
+    }
+    if (sm_method_params.listen_addr)
+    {
+        dealloc_sm_method_addr(sm_method_params.listen_addr);
+    }
+
+    /* buffered messages own memory that op_list_cleanup() knows
+     * nothing about
+     */
+    while ((op = op_list_shownext(early_queue)))
+    {
+        op_list_remove(op);
+        dealloc_sm_method_op(op);
+    }
+    while ((op = op_list_shownext(unexp_queue)))
+    {
+        op_list_remove(op);
+        free(op->buffer);
+        dealloc_sm_method_op(op);
+    }
+
+    /* note that this forcefully shuts down operations */
+    op_list_cleanup(recv_queue);
+    op_list_cleanup(early_queue);
+    op_list_cleanup(unexp_queue);
+    recv_queue = early_queue = unexp_queue = NULL;
+    for (i = 0; i < BMI_MAX_CONTEXTS; i++)
+    {
+        if (completion_array[i])
+        {
+            op_list_cleanup(completion_array[i]);
+            completion_array[i] = NULL;
+        }
+    }
+
+    close(sm_method_params.wake_pipe[0]);
+    close(sm_method_params.wake_pipe[1]);
+    free(sm_pollfds);
+    free(sm_polladdrs);
+    sm_pollfds = NULL;
+    sm_polladdrs = NULL;
+    sm_poll_size = 0;
+    sm_method_params.initialized = 0;
+
+    /* NOTE: we are trusting the calling BMI layer to deallocate
+     * all of the method addresses (this will close any connections)
+     */
+    gossip_debug(GOSSIP_BMI_DEBUG_SM, "Shared memory module finalized.\n");
+    gen_mutex_unlock(&interface_mutex);
+    return (0);
+}
+
+
+/*
+ * BMI_sm_method_addr_lookup()
+ *
+ * resolves the string representation of an address into a method
+ * address structure.  Only addresses on this host are accepted, and
+ * once the method is running only those of a server that accepts our
+ * connection; anything else returns NULL so that BMI can try the next
+ * method listed in the address.
+ *
+ * returns a pointer to method_addr on success, NULL on failure
+ */
+bmi_method_addr_p BMI_sm_method_addr_lookup(const char *id_string)
+{
+    char *sm_string = NULL;
+    char *delim = NULL;
+    bmi_method_addr_p new_addr = NULL;
+    struct sm_addr *sm_addr_data = NULL;
+    int ret;
+
+    sm_string = string_key("sm", id_string);
+    if (!sm_string)
+    {
+        /* the string doesn't even have our info */
+        return (NULL);
+    }
+
+    /* looks like it is our turn to parse the sm portion */
+    delim = strchr(sm_string, ':');
+    if (!delim)
+    {
+        gossip_lerr("Error: malformed sm address.\n");
+        free(sm_string);
+        return (NULL);
+    }
+    *delim = '\0';
+
+    if (!sm_host_is_local(sm_string))
+    {
+        gossip_debug(GOSSIP_BMI_DEBUG_SM, "%s is not this host.\n",
+                     sm_string);
+        free(sm_string);
+        return (NULL);
+    }
+
+    new_addr = alloc_sm_method_addr();
+    if (!new_addr)
+    {
+        free(sm_string);
+        return (NULL);
+    }
+    sm_addr_data = new_addr->method_data;
+    sm_addr_data->port = atoi(delim + 1);
+    sm_addr_data->hostname = strdup(sm_string);
+    free(sm_string);
+    if (!sm_addr_data->hostname)
+    {
+        dealloc_sm_method_addr(new_addr);
+        return (NULL);
+    }
+
+    gen_mutex_lock(&interface_mutex);
+    /* a server looks up its own listening address before initializing;
+     * there is nothing to connect to yet
+     */
+    if (sm_method_params.initialized)
+    {
+        ret = sm_connect(sm_addr_data);
+        if (ret < 0)
+        {
+            gen_mutex_unlock(&interface_mutex);
+            gossip_debug(GOSSIP_BMI_DEBUG_SM,
+                         "no shared memory server on port %d: %d\n",
+                         sm_addr_data->port, ret);
+            dealloc_sm_method_addr(new_addr);
+            return (NULL);
+        }
+    }
+    gen_mutex_unlock(&interface_mutex);
+
+    return (new_addr);
+}
+
+
+/* BMI_sm_memalloc()
+ *
+ * Allocates memory that can be used in native mode by shared memory.
+ *
+ * returns 0 on success, -errno on failure
+ */
+void *BMI_sm_memalloc(bmi_size_t size,
+                      enum bmi_op_type send_recv)
+{
+    /* we don't care what the buffer is used for */
+    return (malloc((size_t) size));
+}
+
+
+/* BMI_sm_memfree()
+ *
+ * Frees memory that was allocated with BMI_sm_memalloc()
+ *
+ * returns 0 on success, -errno on failure
+ */
+int BMI_sm_memfree(void *buffer,
+                   bmi_size_t size,
+                   enum bmi_op_type send_recv)
+{
+    free(buffer);
+    return (0);
+}
+
+/* BMI_sm_unexpected_free()
+ *
+ * Frees memory that was returned from BMI_sm_test_unexpected()
+ *
+ * returns 0 on success, -errno on failure
+ */
+int BMI_sm_unexpected_free(void *buffer)
+{
+    if (buffer)
+    {
+        free(buffer);
+    }
+    return (0);
+}
+
+
+/* BMI_sm_set_info()
+ *
+ * Pass in optional parameters.
+ *
+ * returns 0 on success, -errno on failure
+ */
+int BMI_sm_set_info(int option,
+                    void *inout_parameter)
+{
+    int ret = 0;
+
+    gen_mutex_lock(&interface_mutex);
+
+    switch (option)
+    {
+    case BMI_DROP_ADDR:
+        if (inout_parameter == NULL)
+        {
+            ret = bmi_sm_errno_to_pvfs(-EINVAL);
+        }
+        else
+        {
+            sm_forget_addr((bmi_method_addr_p) inout_parameter, 1, 0);
+        }
+        break;
+
+    case BMI_TCP_CHECK_UNEXPECTED:
+        check_unexpected = *(int *)inout_parameter;
+        break;
+
+    default:
+        gossip_ldebug(GOSSIP_BMI_DEBUG_SM,
+                      "SM hint %d not implemented.\n", option);
+        break;
+    }
+
+    gen_mutex_unlock(&interface_mutex);
+    return (ret);
+}
+
+
+/* BMI_sm_get_info()
+ *
+ * Query for optional parameters.
+ *
+ * returns 0 on success, -errno on failure
+ */
+int BMI_sm_get_info(int option,
+                    void *inout_parameter)
+{
+    struct method_drop_addr_query *query;
+    struct sm_addr *sm_addr_data;
+    int ret = 0;
+
+    gen_mutex_lock(&interface_mutex);
+
+    switch (option)
+    {
+    case BMI_CHECK_MAXSIZE:
+        *((int *) inout_parameter) = BMI_SM_REND_LIMIT;
+        break;
+
+    case BMI_DROP_ADDR_QUERY:
+        query = (struct method_drop_addr_query *) inout_parameter;
+        sm_addr_data = query->addr->method_data;
+        /* only suggest that we discard the address if we have experienced
+         * an error and there is no way to reconnect
+         */
+        query->response = (sm_addr_data->addr_error != 0 &&
+                           sm_addr_data->dont_reconnect == 1);
+        break;
+
+    case BMI_GET_UNEXP_SIZE:
+        *((int *) inout_parameter) = BMI_SM_EAGER_LIMIT;
+        break;
+
+    default:
+        gossip_ldebug(GOSSIP_BMI_DEBUG_SM,
+                      "SM hint %d not implemented.\n", option);
+        ret = bmi_sm_errno_to_pvfs(-ENOSYS);
+        break;
+    }
+
+    gen_mutex_unlock(&interface_mutex);
+    return (ret);
+}
+
+
+/* BMI_sm_post_send()
+ *
+ * Submits send operations.
+ *
+ * returns 0 on success that requires later poll, returns 1 on instant
+ * completion, -errno on failure
+ */
+int BMI_sm_post_send(bmi_op_id_t *id,
+                     bmi_method_addr_p dest,
+                     const void *buffer,
+                     bmi_size_t size,
+                     enum bmi_buffer_type buffer_type,
+                     bmi_msg_tag_t tag,
+                     void *user_ptr,
+                     bmi_context_id context_id,
+                     PVFS_hint hints)
+{
+    int ret;
+
+    gen_mutex_lock(&interface_mutex);
+    ret = sm_post_send_generic(id, dest, &buffer, &size, 1, size, tag,
+                               user_ptr, context_id, 0);
+    gen_mutex_unlock(&interface_mutex);
+    return (ret);
+}
+
+
+/* BMI_sm_post_sendunexpected()
+ *
+ * Submits unexpected send operations.
+ *
+ * returns 0 on success that requires later poll, returns 1 on instant
+ * completion, -errno on failure
+ */
+int BMI_sm_post_sendunexpected(bmi_op_id_t *id,
+                               bmi_method_addr_p dest,
+                               const void *buffer,
+                               bmi_size_t size,
+                               enum bmi_buffer_type buffer_type,
+                               bmi_msg_tag_t tag,
+                               void *user_ptr,
+                               bmi_context_id context_id,
+                               PVFS_hint hints)
+{
+    int ret;
+
+    if (size > BMI_SM_EAGER_LIMIT)
+    {
+        return (bmi_sm_errno_to_pvfs(-EMSGSIZE));
+    }
+
+    gen_mutex_lock(&interface_mutex);
+    ret = sm_post_send_generic(id, dest, &buffer, &size, 1, size, tag,
+                               user_ptr, context_id, 1);
+    gen_mutex_unlock(&interface_mutex);
+    return (ret);
+}
+
+
+/* BMI_sm_post_recv()
+ *
+ * Submits recv operations.
+ *
+ * returns 0 on success that requires later poll, returns 1 on instant
+ * completion, -errno on failure
+ */
+int BMI_sm_post_recv(bmi_op_id_t *id,
+                     bmi_method_addr_p src,
+                     void *buffer,
+                     bmi_size_t expected_size,
+                     bmi_size_t *actual_size,
+                     enum bmi_buffer_type buffer_type,
+                     bmi_msg_tag_t tag,
+                     void *user_ptr,
+                     bmi_context_id context_id,
+                     PVFS_hint hints)
+{
+    int ret;
+
+    if (expected_size > BMI_SM_REND_LIMIT)
+    {
+        return (bmi_sm_errno_to_pvfs(-EINVAL));
+    }
+
+    gen_mutex_lock(&interface_mutex);
+    ret = sm_post_recv_generic(id, src, &buffer, &expected_size, 1,
+                               expected_size, actual_size, tag, user_ptr,
+                               context_id);
+    gen_mutex_unlock(&interface_mutex);
+    return (ret);
+}
+
+
+/* BMI_sm_test()
+ *
+ * Checks to see if a particular message has completed.
+ *
+ * returns 0 on success, -errno on failure
+ */
+int BMI_sm_test(bmi_op_id_t id,
+                int *outcount,
+                bmi_error_code_t *error_code,
+                bmi_size_t *actual_size,
+                void **user_ptr,
+                int max_idle_time,
+                bmi_context_id context_id)
+{
+    int ret = -1;
+    method_op_p query_op = (method_op_p)id_gen_fast_lookup(id);
+
+    assert(query_op != NULL);
+
+    gen_mutex_lock(&interface_mutex);
+
+    ret = sm_do_work(max_idle_time);
+    if (ret < 0)
+    {
+        gen_mutex_unlock(&interface_mutex);
+        return (ret);
+    }
+
+    if (SM_OP(query_op)->state == SM_OP_COMPLETE)
+    {
+        assert(query_op->context_id == context_id);
+        op_list_remove(query_op);
+        if (user_ptr != NULL)
+        {
+            (*user_ptr) = query_op->user_ptr;
+        }
+        (*error_code) = query_op->error_code;
+        (*actual_size) = query_op->actual_size;
+        dealloc_sm_method_op(query_op);
+        (*outcount)++;
+    }
+
+    gen_mutex_unlock(&interface_mutex);
+    return (0);
+}
+
+
+/* BMI_sm_testsome()
+ *
+ * Checks to see if any messages from the specified list have completed.
+ *
+ * returns 0 on success, -errno on failure
+ */
+int BMI_sm_testsome(int incount,
+                    bmi_op_id_t *id_array,
+                    int *outcount,
+                    int *index_array,
+                    bmi_error_code_t *error_code_array,
+                    bmi_size_t *actual_size_array,
+                    void **user_ptr_array,
+                    int max_idle_time,
+                    bmi_context_id context_id)
+{
+    int ret = -1;
+    method_op_p query_op = NULL;
+    int i;
+
+    gen_mutex_lock(&interface_mutex);
+
+    ret = sm_do_work(max_idle_time);
+    if (ret < 0)
+    {
+        gen_mutex_unlock(&interface_mutex);
+        return (ret);
+    }
+
+    for (i = 0; i < incount; i++)
+    {
+        if (!id_array[i])
+        {
+            continue;
+        }
+        query_op = (method_op_p)id_gen_fast_lookup(id_array[i]);
+        if (SM_OP(query_op)->state != SM_OP_COMPLETE)
+        {
+            continue;
+        }
+        assert(query_op->context_id == context_id);
+        op_list_remove(query_op);
+        error_code_array[*outcount] = query_op->error_code;
+        actual_size_array[*outcount] = query_op->actual_size;
+        index_array[*outcount] = i;
+        if (user_ptr_array != NULL)
+        {
+            user_ptr_array[*outcount] = query_op->user_ptr;
+        }
+        dealloc_sm_method_op(query_op);
+        (*outcount)++;
+    }
+
+    gen_mutex_unlock(&interface_mutex);
+    return (0);
+}
+
+
+/* BMI_sm_testunexpected()
+ *
+ * Checks to see if any unexpected messages have completed.
+ *
+ * returns 0 on success, -errno on failure
+ */
+int BMI_sm_testunexpected(int incount,
+                          int *outcount,
+                          struct bmi_method_unexpected_info *info,
+                          int max_idle_time)
+{
+    int ret = -1;
+    method_op_p query_op = NULL;
+
+    gen_mutex_lock(&interface_mutex);
+
+    if (op_list_empty(unexp_queue))
+    {
+        ret = sm_do_work(max_idle_time);
+        if (ret < 0)
+        {
+            gen_mutex_unlock(&interface_mutex);
+            return (ret);
+        }
+    }
+
+    *outcount = 0;
+    while ((*outcount < incount) &&
+           (query_op = op_list_shownext(unexp_queue)))
+    {
+        info[*outcount].error_code = query_op->error_code;
+        info[*outcount].addr = query_op->addr;
+        info[*outcount].buffer = query_op->buffer;
+        info[*outcount].size = query_op->actual_size;
+        info[*outcount].tag = query_op->msg_tag;
+        op_list_remove(query_op);
+        dealloc_sm_method_op(query_op);
+        (*outcount)++;
+    }
+
+    gen_mutex_unlock(&interface_mutex);
+    return (0);
+}
+
+
+/* BMI_sm_testcontext()
+ *
+ * Checks to see if any messages from the specified context have completed.
+ *
+ * returns 0 on success, -errno on failure
+ */
+int BMI_sm_testcontext(int incount,
+                       bmi_op_id_t *out_id_array,
+                       int *outcount,
+                       bmi_error_code_t *error_code_array,
+                       bmi_size_t *actual_size_array,
+                       void **user_ptr_array,
+                       int max_idle_time,
+                       bmi_context_id context_id)
+{
+    int ret = -1;
+    method_op_p query_op = NULL;
+
+    *outcount = 0;
+
+    gen_mutex_lock(&interface_mutex);
+
+    if (op_list_empty(completion_array[context_id]))
+    {
+        /* if there are unexpected ops ready to go, then short out so
+         * that the next testunexpected call can pick it up without
+         * delay
+         */
+        if (check_unexpected && !op_list_empty(unexp_queue))
+        {
+            gen_mutex_unlock(&interface_mutex);
+            return (0);
+        }
+
+        ret = sm_do_work(max_idle_time);
+        if (ret < 0)
+        {
+            gen_mutex_unlock(&interface_mutex);
+            return (ret);
+        }
+    }
+
+    /* pop as many items off of the completion queue as we can */
+    while ((*outcount < incount) &&
+           (query_op = op_list_shownext(completion_array[context_id])))
+    {
+        assert(query_op->context_id == context_id);
+        op_list_remove(query_op);
+        error_code_array[*outcount] = query_op->error_code;
+        actual_size_array[*outcount] = query_op->actual_size;
+        out_id_array[*outcount] = query_op->op_id;
+        if (user_ptr_array != NULL)
+        {
+            user_ptr_array[*outcount] = query_op->user_ptr;
+        }
+        dealloc_sm_method_op(query_op);
+        (*outcount)++;
+    }
+
+    gen_mutex_unlock(&interface_mutex);
+    return (0);
+}
+
+
+/* BMI_sm_post_send_list()
+ *
+ * same as the BMI_sm_post_send() function, except that it sends
+ * from an array of possibly non contiguous buffers
+ *
+ * returns 0 on success, 1 on immediate successful completion,
+ * -errno on failure
+ */
+int BMI_sm_post_send_list(bmi_op_id_t *id,
+                          bmi_method_addr_p dest,
+                          const void *const *buffer_list,
+                          const bmi_size_t *size_list,
+                          int list_count,
+                          bmi_size_t total_size,
+                          enum bmi_buffer_type buffer_type,
+                          bmi_msg_tag_t tag,
+                          void *user_ptr,
+                          bmi_context_id context_id,
+                          PVFS_hint hints)
+{
+    int ret;
+
+    if (total_size > BMI_SM_REND_LIMIT)
+    {
+        return (bmi_sm_errno_to_pvfs(-EINVAL));
+    }
+
+    gen_mutex_lock(&interface_mutex);
+    ret = sm_post_send_generic(id, dest, buffer_list, size_list,
+                               list_count, total_size, tag, user_ptr,
+                               context_id, 0);
+    gen_mutex_unlock(&interface_mutex);
+    return (ret);
+}
+
+/* BMI_sm_post_recv_list()
+ *
+ * same as the BMI_sm_post_recv() function, except that it recvs
+ * into an array of possibly non contiguous buffers
+ *
+ * returns 0 on success, 1 on immediate successful completion,
+ * -errno on failure
+ */
+int BMI_sm_post_recv_list(bmi_op_id_t *id,
+                          bmi_method_addr_p src,
+                          void *const *buffer_list,
+                          const bmi_size_t *size_list,
+                          int list_count,
+                          bmi_size_t total_expected_size,
+                          bmi_size_t *total_actual_size,
+                          enum bmi_buffer_type buffer_type,
+                          bmi_msg_tag_t tag,
+                          void *user_ptr,
+                          bmi_context_id context_id,
+                          PVFS_hint hints)
+{
+    int ret;
+
+    if (total_expected_size > BMI_SM_REND_LIMIT)
+    {
+        return (bmi_sm_errno_to_pvfs(-EINVAL));
+    }
+
+    gen_mutex_lock(&interface_mutex);
+    ret = sm_post_recv_generic(id, src, buffer_list, size_list, list_count,
+                               total_expected_size, total_actual_size, tag,
+                               user_ptr, context_id);
+    gen_mutex_unlock(&interface_mutex);
+    return (ret);
+}
+
+
+/* BMI_sm_post_sendunexpected_list()
+ *
+ * same as the BMI_sm_post_sendunexpected() function, except that it
+ * sends from an array of possibly non contiguous buffers
+ *
+ * returns 0 on success, 1 on immediate successful completion,
+ * -errno on failure
+ */
+int BMI_sm_post_sendunexpected_list(bmi_op_id_t *id,
+                                    bmi_method_addr_p dest,
+                                    const void *const *buffer_list,
+                                    const bmi_size_t *size_list,
+                                    int list_count,
+                                    bmi_size_t total_size,
+                                    enum bmi_buffer_type buffer_type,
+                                    bmi_msg_tag_t tag,
+                                    void *user_ptr,
+                                    bmi_context_id context_id,
+                                    PVFS_hint hints)
+{
+    int ret;
+
+    if (total_size > BMI_SM_EAGER_LIMIT)
+    {
+        return (bmi_sm_errno_to_pvfs(-EMSGSIZE));
+    }
+
+    gen_mutex_lock(&interface_mutex);
+    ret = sm_post_send_generic(id, dest, buffer_list, size_list,
+                               list_count, total_size, tag, user_ptr,
+                               context_id, 1);
+    gen_mutex_unlock(&interface_mutex);
+    return (ret);
+}
+
+
+/* BMI_sm_open_context()
+ *
+ * opens a new context with the specified context id
+ *
+ * returns 0 on success, -errno on failure
+ */
+int BMI_sm_open_context(bmi_context_id context_id)
+{
+    gen_mutex_lock(&interface_mutex);
+
+    /* start a new queue for tracking completions in this context */
+    completion_array[context_id] = op_list_new();
+    if (!completion_array[context_id])
+    {
+        gen_mutex_unlock(&interface_mutex);
+        return (bmi_sm_errno_to_pvfs(-ENOMEM));
+    }
+
+    gen_mutex_unlock(&interface_mutex);
+    return (0);
+}
+
+
+/* BMI_sm_close_context()
+ *
+ * shuts down a context, previously opened with BMI_sm_open_context()
+ *
+ * no return value
+ */
+void BMI_sm_close_context(bmi_context_id context_id)
+{
+    gen_mutex_lock(&interface_mutex);
+
+    /* tear down completion queue for this context */
+    op_list_cleanup(completion_array[context_id]);
+    completion_array[context_id] = NULL;
+
+    gen_mutex_unlock(&interface_mutex);
+    return;
+}
+
+
+/* BMI_sm_cancel()
+ *
+ * attempt to cancel a pending shared memory operation.  Operations that
+ * have not touched the rings yet simply complete with BMI_ECANCEL;
+ * once the peer knows about one, the whole connection is shut down.
+ *
+ * returns 0 on success, -errno on failure
+ */
+int BMI_sm_cancel(bmi_op_id_t id,
+                  bmi_context_id context_id)
+{
+    method_op_p query_op = NULL;
+
+    gen_mutex_lock(&interface_mutex);
+
+    query_op = (method_op_p) id_gen_fast_lookup(id);
+    if (!query_op)
+    {
+        /* if we can't find the operation, then assume that it has already
+         * completed naturally
+         */
+        gen_mutex_unlock(&interface_mutex);
+        return (0);
+    }
+
+    switch (SM_OP(query_op)->state)
+    {
+    case SM_OP_COMPLETE:
+        /* status will be collected during test */
+        break;
+
+    case SM_OP_POSTED:
+    case SM_OP_EAGER:
+    case SM_OP_RTS:
+        sm_complete_op(query_op, -BMI_ECANCEL);
+        break;
+
+    default:
+        /* the peer may be copying to or from our buffers */
+        sm_forget_addr(query_op->addr, 0, -BMI_ECANCEL);
+        break;
+    }
+
+    gen_mutex_unlock(&interface_mutex);
+    return (0);
+}
+
+
+/* BMI_sm_rev_lookup_unexpected()
+ *
+ * looks up the host an unexpected message came from; for shared memory
+ * that is always this one
+ *
+ * returns a string on success, NULL on failure
+ */
+const char *BMI_sm_rev_lookup_unexpected(bmi_method_addr_p map)
+{
+    return (sm_method_params.hostname);
+}
+
+
+/* BMI_sm_query_addr_range()
+ *
+ * checks whether an address falls into a wildcard address.  Every peer
+ * of this method is on this host, so a wildcard matches if it is "*"
+ * or names this host.
+ *
+ * returns 1 on a match, 0 otherwise, -errno on failure
+ */
+int BMI_sm_query_addr_range(bmi_method_addr_p map,
+                            const char *wildcard_string,
+                            int netmask)
+{
+    char *sm_string = NULL;
+    char *delim = NULL;
+    int ret;
+
+    sm_string = string_key("sm", wildcard_string);
+    if (!sm_string)
+    {
+        return (bmi_sm_errno_to_pvfs(-EINVAL));
+    }
+    delim = strchr(sm_string, ':');
+    if (delim)
+    {
+        *delim = '\0';
+    }
+    ret = (!strcmp(sm_string, "*") || sm_host_is_local(sm_string));
+    free(sm_string);
+    return (ret);
+}
+
+
+/* sm_forget_addr()
+ *
+ * shuts down the connection to a peer and fails every operation that
+ * involves it.  If the dealloc_flag is set, the memory used by the
+ * address is released as well; otherwise addresses that cannot be
+ * reconnected are handed to the BMI control layer to be forgotten.
+ *
+ * no return value
+ */
+void sm_forget_addr(bmi_method_addr_p map,
+                    int dealloc_flag,
+                    int error_code)
+{
+    struct sm_addr *sm_addr_data = map->method_data;
+    BMI_addr_t bmi_addr = sm_addr_data->bmi_addr;
+    int op_error = error_code ? error_code : -BMI_ECONNRESET;
+    method_op_p op = NULL;
+    struct qlist_head *iterator = NULL;
+    struct qlist_head *scratch = NULL;
+
+    /* nothing queued on this connection can finish now */
+    while ((op = op_list_shownext(sm_addr_data->send_queue)))
+    {
+        sm_complete_op(op, op_error);
+    }
+    while ((op = op_list_shownext(sm_addr_data->wait_queue)))
+    {
+        sm_complete_op(op, op_error);
+    }
+    if (recv_queue)
+    {
+        qlist_for_each_safe(iterator, scratch, recv_queue)
+        {
+            op = qlist_entry(iterator, struct method_op, op_list_entry);
+            if (op->addr == map)
+            {
+                sm_complete_op(op, op_error);
+            }
+        }
+    }
+    /* eager messages already here stay deliverable unless the address
+     * itself goes away; announced ones can no longer be fetched
+     */
+    if (early_queue)
+    {
+        qlist_for_each_safe(iterator, scratch, early_queue)
+        {
+            op = qlist_entry(iterator, struct method_op, op_list_entry);
+            if (op->addr == map && (dealloc_flag || SM_OP(op)->rts))
+            {
+                op_list_remove(op);
+                dealloc_sm_method_op(op);
+            }
+        }
+    }
+
+    sm_close_addr(sm_addr_data);
+    sm_addr_data->addr_error = error_code;
+
+    if (dealloc_flag)
+    {
+        dealloc_sm_method_addr(map);
+    }
+    else if (sm_addr_data->dont_reconnect && bmi_addr)
+    {
+        /* this will cause the bmi control layer to check to see if
+         * this address can be completely forgotten
+         */
+        bmi_method_addr_forget_callback(bmi_addr);
+    }
+}
+
+
+/******************************************************************
+ * Internal support functions
+ */
+
+/*
+ * alloc_sm_method_addr()
+ *
+ * creates a new method address with defaults filled in for shared
+ * memory.
+ *
+ * returns pointer to struct on success, NULL on failure
+ */
+static bmi_method_addr_p alloc_sm_method_addr(void)
+{
+    struct bmi_method_addr *my_method_addr = NULL;
+    struct sm_addr *sm_addr_data = NULL;
+
+    my_method_addr = bmi_alloc_method_addr(sm_method_params.method_id,
+                                           sizeof(struct sm_addr));
+    if (!my_method_addr)
+    {
+        return (NULL);
+    }
+
+    /* note that we trust the alloc_method_addr() function to have zeroed
+     * out the structures for us already
+     */
+    sm_addr_data = my_method_addr->method_data;
+    sm_addr_data->map = my_method_addr;
+    sm_addr_data->socket = -1;
+    sm_addr_data->port = -1;
+    sm_addr_data->pidfd = -1;
+    sm_addr_data->send_queue = op_list_new();
+    sm_addr_data->wait_queue = op_list_new();
+    if (!sm_addr_data->send_queue || !sm_addr_data->wait_queue)
+    {
+        dealloc_sm_method_addr(my_method_addr);
+        return (NULL);
+    }
+
+    return (my_method_addr);
+}
+
+
+/*
+ * dealloc_sm_method_addr()
+ *
+ * destroys shared memory method address structures, closing the
+ * connection if there is one.
+ *
+ * no return value
+ */
+static void dealloc_sm_method_addr(bmi_method_addr_p map)
+{
+    struct sm_addr *sm_addr_data = map->method_data;
+
+    sm_close_addr(sm_addr_data);
+    if (sm_addr_data->send_queue)
+    {
+        op_list_cleanup(sm_addr_data->send_queue);
+    }
+    if (sm_addr_data->wait_queue)
+    {
+        op_list_cleanup(sm_addr_data->wait_queue);
+    }
+    if (sm_addr_data->hostname)
+    {
+        free(sm_addr_data->hostname);
+    }
+    bmi_dealloc_method_addr(map);
+}
+
+
+/* sm_host_is_local()
+ *
+ * checks whether a host name refers to this host.  Short names are
+ * compared, so "node1" and "node1.cluster" match either way.
+ *
+ * returns 1 if it does, 0 otherwise
+ */
+static int sm_host_is_local(const char *hostname)
+{
+    char local[256] = {0};
+    size_t len;
+    size_t local_len;
+
+    if (!strcmp(hostname, "localhost"))
+    {
+        return (1);
+    }
+    if (gethostname(local, sizeof(local) - 1) < 0)
+    {
+        return (0);
+    }
+    len = strcspn(hostname, ".");
+    local_len = strcspn(local, ".");
+    return (len == local_len && !strncmp(hostname, local, len));
+}
+
+
+/* sm_socket_address()
+ *
+ * fills in the abstract UNIX domain socket address a server on the
+ * given port listens on.  Such a name is not a file, so no other user
+ * can replace it while the server runs, and nothing is left behind.
+ *
+ * returns the length of the address
+ */
+static socklen_t sm_socket_address(struct sockaddr_un *sun, int port)
+{
+    int len;
+
+    memset(sun, 0, sizeof(*sun));
+    sun->sun_family = AF_UNIX;
+    /* sun_path[0] stays 0 */
+    len = snprintf(sun->sun_path + 1, sizeof(sun->sun_path) - 1, "%s%d",
+                   BMI_SM_SOCKET_PREFIX, port);
+    return (offsetof(struct sockaddr_un, sun_path) + 1 + len);
+}
+
+
+/* sm_server_init()
+ *
+ * creates the socket servers accept connections on.  Any user on the
+ * host may connect, just as with a TCP port.
+ *
+ * returns 0 on success, -errno on failure
+ */
+static int sm_server_init(void)
+{
+    struct sm_addr *sm_addr_data = sm_method_params.listen_addr->method_data;
+    struct sockaddr_un sun;
+    socklen_t sun_len;
+    int fd;
+    int tmp_errno;
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        return (-errno);
+    }
+    sun_len = sm_socket_address(&sun, sm_addr_data->port);
+
+    if (bind(fd, (struct sockaddr *)&sun, sun_len) < 0 ||
+        listen(fd, SOMAXCONN) < 0)
+    {
+        tmp_errno = errno;
+        gossip_err("Error: failed to listen on @%s: %s\n", sun.sun_path + 1,
+                   strerror(tmp_errno));
+        close(fd);
+        return (-tmp_errno);
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    sm_addr_data->server_port = 1;
+    sm_method_params.listen_socket = fd;
+    return (0);
+}
+
+
+/* sm_add_addr()
+ *
+ * puts an address with a fresh socket on the list polled for events
+ *
+ * no return value
+ */
+static void sm_add_addr(struct sm_addr *sm_addr_data)
+{
+    qlist_add_tail(&sm_addr_data->link, &sm_addr_list);
+    sm_addr_count++;
+    if (poll_busy)
+    {
+        /* make the polling thread pick up the new socket */
+        if (write(sm_method_params.wake_pipe[1], "c", 1) < 0)
+        {
+            /* the pipe is full, so it will wake up anyway */
+        }
+    }
+}
+
+
+/* sm_close_addr()
+ *
+ * closes the socket and unmaps the region of a connection, if any
+ *
+ * no return value
+ */
+static void sm_close_addr(struct sm_addr *sm_addr_data)
+{
+    if (sm_addr_data->socket >= 0)
+    {
+        qlist_del(&sm_addr_data->link);
+        sm_addr_count--;
+        sm_addr_generation++;
+        close(sm_addr_data->socket);
+        sm_addr_data->socket = -1;
+    }
+    if (sm_addr_data->region)
+    {
+        munmap(sm_addr_data->region, sizeof(struct sm_region));
+        sm_addr_data->region = NULL;
+    }
+    if (sm_addr_data->pidfd >= 0)
+    {
+        close(sm_addr_data->pidfd);
+        sm_addr_data->pidfd = -1;
+    }
+    sm_addr_data->vm_ok = 0;
+}
+
+
+/* sm_peer_check()
+ *
+ * finds the process at the other end of a connection's socket and
+ * decides whether its memory may be copied directly: only if it runs as
+ * the same user as we do, neither of us is privileged, and it can be
+ * pinned with a pidfd
+ *
+ * returns 0 on success, -errno on failure
+ */
+static int sm_peer_check(struct sm_addr *sm_addr_data, int fd)
+{
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0)
+    {
+        return (-errno);
+    }
+    sm_addr_data->peer_pid = cred.pid;
+    sm_addr_data->peer_uid = cred.uid;
+    sm_addr_data->vm_ok = 0;
+
+#ifdef BMI_SM_VM_COPY
+    if (cred.uid == geteuid() && cred.uid != 0 && getuid() != 0)
+    {
+        sm_addr_data->pidfd = syscall(SYS_pidfd_open, cred.pid, 0);
+        if (sm_addr_data->pidfd >= 0)
+        {
+            sm_addr_data->vm_ok = 1;
+        }
+    }
+#endif
+    return (0);
+}
+
+
+/* sm_connect()
+ *
+ * connects to a server on this host: creates the region shared with it
+ * and passes it over the server's socket.  The server does not answer;
+ * the region can be used as soon as this returns.  A listener that does
+ * not run as BMI_SM_SERVER_UID or as ourselves never sees the region.
+ *
+ * returns 0 on success, -errno on failure
+ */
+static int sm_connect(struct sm_addr *sm_addr_data)
+{
+    struct sockaddr_un sun;
+    socklen_t sun_len;
+    char region_name[] = BMI_SM_REGION_TEMPLATE;
+    struct sm_region *region = MAP_FAILED;
+    struct sm_hello hello;
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    char control[CMSG_SPACE(sizeof(int))];
+    int fd = -1;
+    int region_fd = -1;
+    int tmp_errno;
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        return (-errno);
+    }
+    sun_len = sm_socket_address(&sun, sm_addr_data->port);
+    if (connect(fd, (struct sockaddr *)&sun, sun_len) < 0)
+    {
+        tmp_errno = errno;
+        goto connect_failure;
+    }
+
+    tmp_errno = -sm_peer_check(sm_addr_data, fd);
+    if (tmp_errno)
+    {
+        goto connect_failure;
+    }
+    if (sm_addr_data->peer_uid != BMI_SM_SERVER_UID &&
+        sm_addr_data->peer_uid != geteuid())
+    {
+        gossip_err("Error: shared memory port %d is held by uid %d, "
+                   "not a server.\n", sm_addr_data->port,
+                   (int)sm_addr_data->peer_uid);
+        tmp_errno = EACCES;
+        goto connect_failure;
+    }
+
+    region_fd = mkstemp(region_name);
+    if (region_fd < 0)
+    {
+        tmp_errno = errno;
+        goto connect_failure;
+    }
+    unlink(region_name);
+    if (ftruncate(region_fd, sizeof(struct sm_region)) < 0)
+    {
+        tmp_errno = errno;
+        goto connect_failure;
+    }
+    region = mmap(NULL, sizeof(struct sm_region), PROT_READ | PROT_WRITE,
+                  MAP_SHARED, region_fd, 0);
+    if (region == MAP_FAILED)
+    {
+        tmp_errno = errno;
+        goto connect_failure;
+    }
+    /* the rest of the region is zero filled by ftruncate() */
+    region->magic = BMI_SM_MAGIC;
+    region->ring_size = BMI_SM_RING_SIZE;
+
+    hello.magic = BMI_SM_MAGIC;
+    hello.ring_size = BMI_SM_RING_SIZE;
+    iov.iov_base = &hello;
+    iov.iov_len = sizeof(hello);
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &region_fd, sizeof(int));
+    if (sendmsg(fd, &msg, 0) != sizeof(hello))
+    {
+        tmp_errno = errno ? errno : EPROTO;
+        goto connect_failure;
+    }
+    close(region_fd);
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    sm_addr_data->socket = fd;
+    sm_addr_data->region = region;
+    sm_addr_data->side = BMI_SM_CONNECTOR;
+    sm_addr_data->addr_error = 0;
+    sm_add_addr(sm_addr_data);
+
+    gossip_debug(GOSSIP_BMI_DEBUG_SM, "connected to server pid %d on "
+                 "port %d.\n", (int)sm_addr_data->peer_pid,
+                 sm_addr_data->port);
+    return (0);
+
+  connect_failure:
+    if (sm_addr_data->pidfd >= 0)
+    {
+        close(sm_addr_data->pidfd);
+        sm_addr_data->pidfd = -1;
+    }
+    sm_addr_data->vm_ok = 0;
+    if (region != MAP_FAILED)
+    {
+        munmap(region, sizeof(struct sm_region));
+    }
+    if (region_fd >= 0)
+    {
+        close(region_fd);
+    }
+    close(fd);
+    return (-tmp_errno);
+}
+
+
+/* sm_accept()
+ *
+ * accepts pending connections on the listening socket.  Each becomes an
+ * address that is registered with BMI once the client's region has
+ * arrived.
+ *
+ * no return value
+ */
+static void sm_accept(void)
+{
+    bmi_method_addr_p new_addr = NULL;
+    struct sm_addr *sm_addr_data = NULL;
+    int fd;
+
+    while ((fd = accept(sm_method_params.listen_socket, NULL, NULL)) >= 0)
+    {
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+        new_addr = alloc_sm_method_addr();
+        if (!new_addr)
+        {
+            close(fd);
+            continue;
+        }
+        sm_addr_data = new_addr->method_data;
+        sm_addr_data->socket = fd;
+        sm_addr_data->side = BMI_SM_ACCEPTOR;
+        /* make sure that we never try to reconnect this address */
+        sm_addr_data->dont_reconnect = 1;
+        sm_add_addr(sm_addr_data);
+
+        /* the client sends its region right after connecting */
+        sm_finish_accept(sm_addr_data);
+    }
+}
+
+
+/* sm_finish_accept()
+ *
+ * maps the region a newly accepted client sent us and registers the
+ * address with BMI.  Does nothing if the region has not arrived yet.
+ *
+ * no return value
+ */
+static void sm_finish_accept(struct sm_addr *sm_addr_data)
+{
+    struct sm_hello hello;
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    struct stat st;
+    char control[CMSG_SPACE(sizeof(int))];
+    struct sm_region *region;
+    int region_fd = -1;
+    ssize_t ret;
+
+    iov.iov_base = &hello;
+    iov.iov_len = sizeof(hello);
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ret = recvmsg(sm_addr_data->socket, &msg, 0);
+    if (ret < 0 && (errno == EAGAIN || errno == EINTR))
+    {
+        return;
+    }
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if (ret == sizeof(hello) && cmsg && cmsg->cmsg_level == SOL_SOCKET &&
+        cmsg->cmsg_type == SCM_RIGHTS)
+    {
+        memcpy(&region_fd, CMSG_DATA(cmsg), sizeof(int));
+    }
+    if (region_fd < 0 || hello.magic != BMI_SM_MAGIC ||
+        hello.ring_size != BMI_SM_RING_SIZE ||
+        fstat(region_fd, &st) < 0 ||
+        st.st_size < (off_t)sizeof(struct sm_region))
+    {
+        gossip_err("Error: bad shared memory connection request.\n");
+        goto accept_failure;
+    }
+
+    region = mmap(NULL, sizeof(struct sm_region), PROT_READ | PROT_WRITE,
+                  MAP_SHARED, region_fd, 0);
+    close(region_fd);
+    region_fd = -1;
+    if (region == MAP_FAILED)
+    {
+        goto accept_failure;
+    }
+    sm_addr_data->region = region;
+    if (sm_peer_check(sm_addr_data, sm_addr_data->socket) < 0)
+    {
+        goto accept_failure;
+    }
+
+    /* register this address with the method control layer */
+    sm_addr_data->bmi_addr = bmi_method_addr_reg_callback(sm_addr_data->map);
+    gossip_debug(GOSSIP_BMI_DEBUG_SM, "accepted client pid %d.\n",
+                 (int)sm_addr_data->peer_pid);
+    return;
+
+  accept_failure:
+    if (region_fd >= 0)
+    {
+        close(region_fd);
+    }
+    /* BMI never heard of this address */
+    dealloc_sm_method_addr(sm_addr_data->map);
+}
+
+
+/* sm_ready_addr()
+ *
+ * makes sure an address has a working connection, reconnecting it if
+ * it broke and we are the end that connected
+ *
+ * returns 0 on success, -errno on failure
+ */
+static int sm_ready_addr(struct sm_addr *sm_addr_data)
+{
+    int ret;
+
+    if (sm_addr_data->region)
+    {
+        return (0);
+    }
+    if (sm_addr_data->dont_reconnect || sm_addr_data->server_port)
+    {
+        return (sm_addr_data->addr_error ? sm_addr_data->addr_error :
+                bmi_sm_errno_to_pvfs(-ENOTCONN));
+    }
+    ret = sm_connect(sm_addr_data);
+    if (ret < 0)
+    {
+        return (bmi_sm_errno_to_pvfs(ret));
+    }
+    return (0);
+}
+
+
+/* sm_wake_peer()
+ *
+ * wakes the other end of a connection if it is sleeping in poll()
+ *
+ * no return value
+ */
+static void sm_wake_peer(struct sm_addr *sm_addr_data)
+{
+    volatile int32_t *sleeping =
+        &sm_addr_data->region->sleeping[1 - sm_addr_data->side];
+
+    /* whoever clears the flag owes the byte */
+    if (*sleeping && __sync_bool_compare_and_swap(sleeping, 1, 0))
+    {
+        if (write(sm_addr_data->socket, "w", 1) < 0)
+        {
+            /* a full socket buffer will wake it up anyway */
+        }
+    }
+}
+
+
+/* sm_ring_push()
+ *
+ * appends a message to the ring we produce for, copying len bytes of
+ * payload from the buffer list starting at offset.  Writes a pad entry
+ * first if the message would not fit before the end of the ring.
+ *
+ * returns 1 if the message was queued, 0 if there is no room yet
+ */
+static int sm_ring_push(struct sm_addr *sm_addr_data,
+                        struct sm_msg_hdr *hdr,
+                        const void *const *buffer_list,
+                        const bmi_size_t *size_list,
+                        int list_count,
+                        bmi_size_t offset)
+{
+    struct sm_region *region = sm_addr_data->region;
+    struct sm_ring *ring = &region->ring[sm_addr_data->side];
+    uint64_t need = SM_ROUND(sizeof(struct sm_msg_hdr) + hdr->len);
+    uint64_t head = ring->head;
+    uint64_t pos = head & (BMI_SM_RING_SIZE - 1);
+    uint64_t to_end = BMI_SM_RING_SIZE - pos;
+    uint64_t total = (need > to_end) ? need + to_end : need;
+    struct sm_msg_hdr *pad;
+    char *dst;
+    bmi_size_t left = hdr->len;
+    bmi_size_t chunk;
+    int i;
+
+    __sync_synchronize();
+    if (BMI_SM_RING_SIZE - (head - ring->tail) < total)
+    {
+        /* ask the consumer to tell us when it makes room, then look
+         * again in case it already did
+         */
+        region->blocked[sm_addr_data->side] = 1;
+        __sync_synchronize();
+        if (BMI_SM_RING_SIZE - (head - ring->tail) < total)
+        {
+            return (0);
+        }
+    }
+
+    if (need > to_end)
+    {
+        pad = (struct sm_msg_hdr *)&ring->data[pos];
+        pad->type = BMI_SM_PAD;
+        pad->len = to_end - sizeof(struct sm_msg_hdr);
+        head += to_end;
+        pos = 0;
+    }
+
+    dst = &ring->data[pos];
+    memcpy(dst, hdr, sizeof(*hdr));
+    dst += sizeof(*hdr);
+
+    /* gather the payload */
+    for (i = 0; i < list_count && left > 0; i++)
+    {
+        if (offset >= size_list[i])
+        {
+            offset -= size_list[i];
+            continue;
+        }
+        chunk = size_list[i] - offset;
+        if (chunk > left)
+        {
+            chunk = left;
+        }
+        memcpy(dst, (const char *)buffer_list[i] + offset, chunk);
+        dst += chunk;
+        left -= chunk;
+        offset = 0;
+    }
+
+    /* publish the message only once its contents are in place */
+    __sync_synchronize();
+    ring->head = head + need;
+    __sync_synchronize();
+
+    sm_wake_peer(sm_addr_data);
+    return (1);
+}
+
+
+/* sm_ring_poll()
+ *
+ * handles every message waiting in the ring we consume from
+ *
+ * returns number of messages handled
+ */
+static int sm_ring_poll(struct sm_addr *sm_addr_data)
+{
+    struct sm_region *region = sm_addr_data->region;
+    struct sm_ring *ring = &region->ring[1 - sm_addr_data->side];
+    volatile int32_t *blocked = &region->blocked[1 - sm_addr_data->side];
+    struct sm_msg_hdr hdr;
+    char *msg;
+    uint64_t head;
+    uint64_t tail;
+    uint64_t pos;
+    uint64_t need;
+    int count = 0;
+
+    head = ring->head;
+    __sync_synchronize();
+    tail = ring->tail;
+
+    while (tail != head)
+    {
+        pos = tail & (BMI_SM_RING_SIZE - 1);
+        msg = (char *)&ring->data[pos];
+
+        /* the peer can still write to the ring, so check and use a
+         * private copy of the header rather than reading it twice
+         */
+        memcpy(&hdr, msg, sizeof(struct sm_msg_hdr));
+        __sync_synchronize();
+        need = SM_ROUND(sizeof(struct sm_msg_hdr) + (uint64_t)hdr.len);
+        if (need > BMI_SM_RING_SIZE - pos || need > head - tail)
+        {
+            gossip_err("Error: corrupt shared memory ring from pid %d.\n",
+                       (int)sm_addr_data->peer_pid);
+            sm_forget_addr(sm_addr_data->map, 0, -BMI_EPROTO);
+            return (count);
+        }
+        if (hdr.type != BMI_SM_PAD)
+        {
+            sm_handle_msg(sm_addr_data, &hdr,
+                          msg + sizeof(struct sm_msg_hdr));
+            count++;
+        }
+        tail += need;
+
+        /* let the producer reuse the space */
+        __sync_synchronize();
+        ring->tail = tail;
+
+        if (tail == head)
+        {
+            head = ring->head;
+            __sync_synchronize();
+        }
+    }
+
+    if (count && *blocked && __sync_bool_compare_and_swap(blocked, 1, 0))
+    {
+        sm_wake_peer(sm_addr_data);
+    }
+    return (count);
+}
+
+
+/* sm_handle_msg()
+ *
+ * acts on one message from the peer.  hdr is a private copy whose length
+ * has been checked against the ring; the payload lives in the ring and
+ * must be copied if it is needed after this returns.
+ *
+ * no return value
+ */
+static void sm_handle_msg(struct sm_addr *sm_addr_data,
+                          struct sm_msg_hdr *hdr,
+                          char *payload)
+{
+    bmi_method_addr_p map = sm_addr_data->map;
+    method_op_p op = NULL;
+    struct sm_op *sm_op_data = NULL;
+    int iov_count = hdr->len / sizeof(struct sm_iov);
+
+    switch (hdr->type)
+    {
+    case BMI_SM_EAGER:
+        op = sm_find_op(recv_queue, map, hdr->tag);
+        if (op)
+        {
+            op->actual_size = hdr->len;
+            sm_copy_to_list(op, 0, payload, hdr->len);
+            sm_complete_op(op, (hdr->len > op->expected_size) ?
+                           -BMI_EMSGSIZE : 0);
+            break;
+        }
+        /* fall through: buffer it until the receive is posted */
+    case BMI_SM_UNEXP:
+        op = alloc_sm_method_op(map, BMI_RECV, NULL, NULL, 0, hdr->len,
+                                hdr->tag, NULL, 0);
+        if (op)
+        {
+            op->buffer = malloc(hdr->len ? hdr->len : 1);
+        }
+        if (!op || !op->buffer)
+        {
+            gossip_err("Error: out of memory buffering a message from "
+                       "pid %d; dropped.\n", (int)sm_addr_data->peer_pid);
+            if (op)
+            {
+                dealloc_sm_method_op(op);
+            }
+            break;
+        }
+        memcpy(op->buffer, payload, hdr->len);
+        op->actual_size = hdr->len;
+        if (hdr->type == BMI_SM_UNEXP)
+        {
+            SM_OP(op)->state = SM_OP_COMPLETE;
+            SM_OP(op)->unexpected = 1;
+            op_list_add(unexp_queue, op);
+        }
+        else
+        {
+            SM_OP(op)->state = SM_OP_EARLY;
+            op_list_add(early_queue, op);
+        }
+        break;
+
+    case BMI_SM_RTS:
+        op = sm_find_op(recv_queue, map, hdr->tag);
+        if (op)
+        {
+            op_list_remove(op);
+            sm_recv_rendezvous(sm_addr_data, op, hdr->size, hdr->send_id,
+                               (struct sm_iov *)payload, iov_count);
+            break;
+        }
+        op = alloc_sm_method_op(map, BMI_RECV, NULL, NULL, 0, hdr->size,
+                                hdr->tag, NULL, 0);
+        if (!op)
+        {
+            gossip_err("Error: out of memory buffering a message from "
+                       "pid %d; dropped.\n", (int)sm_addr_data->peer_pid);
+            break;
+        }
+        sm_op_data = op->method_data;
+        sm_op_data->state = SM_OP_EARLY;
+        sm_op_data->rts = 1;
+        sm_op_data->peer_id = hdr->send_id;
+        if (iov_count)
+        {
+            sm_op_data->peer_iov = malloc(hdr->len);
+            if (sm_op_data->peer_iov)
+            {
+                memcpy(sm_op_data->peer_iov, payload, hdr->len);
+                sm_op_data->peer_iov_count = iov_count;
+            }
+        }
+        op->actual_size = hdr->size;
+        op_list_add(early_queue, op);
+        break;
+
+    case BMI_SM_CTS:
+        op = sm_find_wait(sm_addr_data, hdr->send_id);
+        if (op)
+        {
+            op_list_remove(op);
+            sm_send_rendezvous(sm_addr_data, op, hdr->recv_id,
+                               (struct sm_iov *)payload, iov_count);
+        }
+        break;
+
+    case BMI_SM_PULLED:
+        op = sm_find_wait(sm_addr_data, hdr->send_id);
+        if (op)
+        {
+            sm_complete_op(op, hdr->status);
+        }
+        break;
+
+    case BMI_SM_PUSHED:
+        op = sm_find_wait(sm_addr_data, hdr->recv_id);
+        if (op)
+        {
+            sm_complete_op(op, hdr->status);
+        }
+        break;
+
+    case BMI_SM_DATA:
+        op = sm_find_wait(sm_addr_data, hdr->recv_id);
+        if (op)
+        {
+            sm_copy_to_list(op, hdr->size, payload, hdr->len);
+            op->amt_complete += hdr->len;
+            if (op->amt_complete >= op->actual_size)
+            {
+                sm_complete_op(op, 0);
+            }
+        }
+        break;
+
+    default:
+        gossip_err("Error: unknown shared memory message type %u from "
+                   "pid %d.\n", hdr->type, (int)sm_addr_data->peer_pid);
+        break;
+    }
+}
+
+
+/* sm_recv_rendezvous()
+ *
+ * starts receiving a large message: copy it out of the sender if we may,
+ * otherwise ask the sender to deliver it.  The op must not be on any
+ * list.
+ *
+ * no return value
+ */
+static void sm_recv_rendezvous(struct sm_addr *sm_addr_data,
+                               method_op_p op,
+                               bmi_size_t size,
+                               bmi_op_id_t peer_id,
+                               const struct sm_iov *peer_iov,
+                               int peer_iov_count)
+{
+    struct sm_op *sm_op_data = op->method_data;
+
+    sm_op_data->peer_id = peer_id;
+    op->actual_size = size;
+
+    if (size > op->expected_size)
+    {
+        /* fail both ends */
+        sm_op_data->status = -BMI_EMSGSIZE;
+        sm_op_data->state = SM_OP_PULLED;
+    }
+    else if (peer_iov_count && sm_addr_data->vm_ok &&
+             sm_vm_copy(sm_addr_data, op, peer_iov, peer_iov_count, size,
+                        0) == 0)
+    {
+        sm_op_data->status = 0;
+        sm_op_data->state = SM_OP_PULLED;
+    }
+    else
+    {
+        sm_op_data->state = SM_OP_CTS;
+    }
+
+    op_list_add(sm_addr_data->send_queue, op);
+    sm_push_queue(sm_addr_data);
+}
+
+
+/* sm_send_rendezvous()
+ *
+ * answers a CTS: copy the message into the receiver if we may,
+ * otherwise stream it through the ring.  The op must not be on any
+ * list.
+ *
+ * no return value
+ */
+static void sm_send_rendezvous(struct sm_addr *sm_addr_data,
+                               method_op_p op,
+                               bmi_op_id_t peer_id,
+                               const struct sm_iov *peer_iov,
+                               int peer_iov_count)
+{
+    struct sm_op *sm_op_data = op->method_data;
+
+    sm_op_data->peer_id = peer_id;
+    if (peer_iov_count && sm_addr_data->vm_ok &&
+        sm_vm_copy(sm_addr_data, op, peer_iov, peer_iov_count,
+                   op->actual_size, 1) == 0)
+    {
+        sm_op_data->state = SM_OP_PUSHED;
+    }
+    else
+    {
+        sm_op_data->state = SM_OP_DATA;
+        sm_op_data->data_done = 0;
+    }
+
+    op_list_add(sm_addr_data->send_queue, op);
+    sm_push_queue(sm_addr_data);
+}
+
+
+/* sm_iov_window()
+ *
+ * fills out with up to max iovecs covering at most limit bytes of a
+ * buffer list, starting at the cursor (*index, *offset)
+ *
+ * returns number of iovecs filled in
+ */
+static int sm_iov_window(const struct iovec *list,
+                         int count,
+                         int index,
+                         size_t offset,
+                         struct iovec *out,
+                         int max,
+                         size_t limit)
+{
+    int n = 0;
+    size_t len;
+
+    while (index < count && n < max && limit > 0)
+    {
+        len = list[index].iov_len - offset;
+        if (len > limit)
+        {
+            len = limit;
+        }
+        if (len > 0)
+        {
+            out[n].iov_base = (char *)list[index].iov_base + offset;
+            out[n].iov_len = len;
+            limit -= len;
+            n++;
+        }
+        index++;
+        offset = 0;
+    }
+    return (n);
+}
+
+
+/* sm_iov_advance()
+ *
+ * moves a buffer list cursor forward by len bytes
+ *
+ * no return value
+ */
+static void sm_iov_advance(const struct iovec *list,
+                           int count,
+                           int *index,
+                           size_t *offset,
+                           size_t len)
+{
+    size_t left;
+
+    while (*index < count && len > 0)
+    {
+        left = list[*index].iov_len - *offset;
+        if (len < left)
+        {
+            *offset += len;
+            return;
+        }
+        len -= left;
+        (*index)++;
+        *offset = 0;
+    }
+}
+
+
+/* sm_vm_copy()
+ *
+ * copies size bytes between our buffers for op and the peer's buffers
+ * with a single process_vm_readv() (write_flag == 0) or
+ * process_vm_writev() per window of iovecs.  Every call is preceded by
+ * a check that the pinned peer still exists, so that its pid cannot
+ * have been reused.  Once that fails or the kernel refuses access to
+ * the peer we stop trying for this connection.
+ *
+ * returns 0 on success, -errno on failure
+ */
+static int sm_vm_copy(struct sm_addr *sm_addr_data,
+                      method_op_p op,
+                      const struct sm_iov *peer_iov,
+                      int peer_iov_count,
+                      bmi_size_t size,
+                      int write_flag)
+{
+#ifdef BMI_SM_VM_COPY
+    struct iovec *local = NULL;
+    struct iovec *remote = NULL;
+    struct iovec lwin[BMI_SM_VM_IOV];
+    struct iovec rwin[BMI_SM_VM_IOV];
+    int lindex = 0;
+    int rindex = 0;
+    size_t loffset = 0;
+    size_t roffset = 0;
+    int lcount;
+    int rcount;
+    bmi_size_t done = 0;
+    ssize_t ret = 0;
+    int tmp_errno = 0;
+    int i;
+
+    local = malloc(op->list_count * sizeof(*local));
+    remote = malloc(peer_iov_count * sizeof(*remote));
+    if (!local || !remote)
+    {
+        free(local);
+        free(remote);
+        return (-ENOMEM);
+    }
+    for (i = 0; i < op->list_count; i++)
+    {
+        local[i].iov_base = op->buffer_list[i];
+        local[i].iov_len = op->size_list[i];
+    }
+    for (i = 0; i < peer_iov_count; i++)
+    {
+        remote[i].iov_base = (void *)(uintptr_t)peer_iov[i].base;
+        remote[i].iov_len = peer_iov[i].len;
+    }
+
+    while (done < size)
+    {
+        lcount = sm_iov_window(local, op->list_count, lindex, loffset,
+                               lwin, BMI_SM_VM_IOV, size - done);
+        rcount = sm_iov_window(remote, peer_iov_count, rindex, roffset,
+                               rwin, BMI_SM_VM_IOV, size - done);
+        if (lcount == 0 || rcount == 0)
+        {
+            /* one of the lists is shorter than the message */
+            tmp_errno = EINVAL;
+            break;
+        }
+        if (syscall(SYS_pidfd_send_signal, sm_addr_data->pidfd, 0, NULL,
+                    0) < 0)
+        {
+            tmp_errno = ESRCH;
+            break;
+        }
+        if (write_flag)
+        {
+            ret = process_vm_writev(sm_addr_data->peer_pid, lwin, lcount,
+                                    rwin, rcount, 0);
+        }
+        else
+        {
+            ret = process_vm_readv(sm_addr_data->peer_pid, lwin, lcount,
+                                   rwin, rcount, 0);
+        }
+        if (ret < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (ret <= 0)
+        {
+            tmp_errno = (ret < 0) ? errno : EIO;
+            break;
+        }
+        sm_iov_advance(local, op->list_count, &lindex, &loffset, ret);
+        sm_iov_advance(remote, peer_iov_count, &rindex, &roffset, ret);
+        done += ret;
+    }
+
+    free(local);
+    free(remote);
+
+    if (tmp_errno)
+    {
+        if (tmp_errno == EPERM || tmp_errno == ENOSYS ||
+            tmp_errno == ESRCH)
+        {
+            gossip_debug(GOSSIP_BMI_DEBUG_SM, "no access to the memory "
+                         "of pid %d; streaming through the ring.\n",
+                         (int)sm_addr_data->peer_pid);
+            sm_addr_data->vm_ok = 0;
+        }
+        return (-tmp_errno);
+    }
+    return (0);
+#else
+    sm_addr_data->vm_ok = 0;
+    return (-ENOSYS);
+#endif
+}
+
+
+/* sm_list_iov()
+ *
+ * describes the buffers of an op for the peer, up to max of them
+ *
+ * returns number of entries, or 0 if there are more than max
+ */
+static int sm_list_iov(method_op_p op, struct sm_iov *iov, int max)
+{
+    int i;
+
+    if (op->list_count > max)
+    {
+        return (0);
+    }
+    for (i = 0; i < op->list_count; i++)
+    {
+        iov[i].base = (uint64_t)(uintptr_t)op->buffer_list[i];
+        iov[i].len = op->size_list[i];
+    }
+    return (op->list_count);
+}
+
+
+/* sm_copy_to_list()
+ *
+ * scatters len bytes into the buffers of a receive, starting at offset;
+ * anything that does not fit is dropped
+ *
+ * no return value
+ */
+static void sm_copy_to_list(method_op_p op,
+                            bmi_size_t offset,
+                            const char *src,
+                            bmi_size_t len)
+{
+    bmi_size_t chunk;
+    int i;
+
+    if (offset + len > op->expected_size)
+    {
+        len = (offset < op->expected_size) ? op->expected_size - offset : 0;
+    }
+    for (i = 0; i < op->list_count && len > 0; i++)
+    {
+        if (offset >= op->size_list[i])
+        {
+            offset -= op->size_list[i];
+            continue;
+        }
+        chunk = op->size_list[i] - offset;
+        if (chunk > len)
+        {
+            chunk = len;
+        }
+        memcpy((char *)op->buffer_list[i] + offset, src, chunk);
+        src += chunk;
+        len -= chunk;
+        offset = 0;
+    }
+}
+
+
+/* sm_push_queue()
+ *
+ * moves as much of a connection's send queue into the ring as fits
+ *
+ * returns number of messages written to the ring
+ */
+static int sm_push_queue(struct sm_addr *sm_addr_data)
+{
+    method_op_p op = NULL;
+    int count = 0;
+
+    while (sm_addr_data->region &&
+           (op = op_list_shownext(sm_addr_data->send_queue)))
+    {
+        count += sm_push_op(sm_addr_data, op);
+        if (op_list_shownext(sm_addr_data->send_queue) == op)
+        {
+            /* out of room */
+            break;
+        }
+    }
+    return (count);
+}
+
+
+/* sm_push_op()
+ *
+ * writes the next message(s) of an op at the head of a send queue to
+ * the ring and moves the op along once it is done there
+ *
+ * returns number of messages written to the ring
+ */
+static int sm_push_op(struct sm_addr *sm_addr_data, method_op_p op)
+{
+    struct sm_op *sm_op_data = op->method_data;
+    struct sm_msg_hdr hdr;
+    struct sm_iov iov[BMI_SM_MAX_IOV];
+    const void *iov_buffer = iov;
+    bmi_size_t iov_size;
+    bmi_size_t frag;
+    int count = 0;
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.tag = op->msg_tag;
+
+    switch (sm_op_data->state)
+    {
+    case SM_OP_EAGER:
+        hdr.type = sm_op_data->unexpected ? BMI_SM_UNEXP : BMI_SM_EAGER;
+        hdr.len = op->actual_size;
+        if (sm_ring_push(sm_addr_data, &hdr,
+                         (const void *const *)op->buffer_list,
+                         op->size_list, op->list_count, 0))
+        {
+            sm_complete_op(op, 0);
+            count++;
+        }
+        break;
+
+    case SM_OP_RTS:
+    case SM_OP_CTS:
+        if (sm_op_data->state == SM_OP_RTS)
+        {
+            hdr.type = BMI_SM_RTS;
+            hdr.size = op->actual_size;
+            hdr.send_id = op->op_id;
+        }
+        else
+        {
+            hdr.type = BMI_SM_CTS;
+            hdr.send_id = sm_op_data->peer_id;
+            hdr.recv_id = op->op_id;
+        }
+        /* a peer that may not touch our memory ignores the list */
+        iov_size = sm_addr_data->vm_ok ?
+            sm_list_iov(op, iov, BMI_SM_MAX_IOV) * sizeof(struct sm_iov) : 0;
+        hdr.len = iov_size;
+        if (sm_ring_push(sm_addr_data, &hdr, &iov_buffer, &iov_size, 1, 0))
+        {
+            sm_op_data->state = SM_OP_WAIT;
+            op_list_remove(op);
+            op_list_add(sm_addr_data->wait_queue, op);
+            count++;
+        }
+        break;
+
+    case SM_OP_PULLED:
+        hdr.type = BMI_SM_PULLED;
+        hdr.send_id = sm_op_data->peer_id;
+        hdr.status = sm_op_data->status;
+        if (sm_ring_push(sm_addr_data, &hdr, NULL, NULL, 0, 0))
+        {
+            sm_complete_op(op, sm_op_data->status);
+            count++;
+        }
+        break;
+
+    case SM_OP_PUSHED:
+        hdr.type = BMI_SM_PUSHED;
+        hdr.recv_id = sm_op_data->peer_id;
+        hdr.size = op->actual_size;
+        if (sm_ring_push(sm_addr_data, &hdr, NULL, NULL, 0, 0))
+        {
+            sm_complete_op(op, 0);
+            count++;
+        }
+        break;
+
+    case SM_OP_DATA:
+        hdr.type = BMI_SM_DATA;
+        hdr.recv_id = sm_op_data->peer_id;
+        while (sm_op_data->data_done < op->actual_size)
+        {
+            frag = op->actual_size - sm_op_data->data_done;
+            if (frag > BMI_SM_FRAG_SIZE)
+            {
+                frag = BMI_SM_FRAG_SIZE;
+            }
+            hdr.size = sm_op_data->data_done;
+            hdr.len = frag;
+            if (!sm_ring_push(sm_addr_data, &hdr,
+                              (const void *const *)op->buffer_list,
+                              op->size_list, op->list_count,
+                              sm_op_data->data_done))
+            {
+                break;
+            }
+            sm_op_data->data_done += frag;
+            count++;
+        }
+        if (sm_op_data->data_done >= op->actual_size)
+        {
+            sm_complete_op(op, 0);
+        }
+        break;
+
+    default:
+        assert(0);
+        break;
+    }
+
+    return (count);
+}
+
+
+/* sm_progress()
+ *
+ * makes one pass over all connections, handling what arrived and
+ * pushing what is queued
+ *
+ * returns number of messages handled or written
+ */
+static int sm_progress(void)
+{
+    struct sm_addr *sm_addr_data = NULL;
+    struct sm_addr *scratch = NULL;
+    int count = 0;
+
+    qlist_for_each_entry_safe(sm_addr_data, scratch, &sm_addr_list, link)
+    {
+        if (!sm_addr_data->region)
+        {
+            continue;
+        }
+        count += sm_push_queue(sm_addr_data);
+        /* may forget the address on a corrupt ring */
+        count += sm_ring_poll(sm_addr_data);
+    }
+    return (count);
+}
+
+
+/* sm_drain_socket()
+ *
+ * reads wakeup bytes from a connection, or finishes accepting it if its
+ * region has not arrived yet.  A closed socket means the peer is gone.
+ *
+ * returns 1 if the address went away, 0 otherwise
+ */
+static int sm_drain_socket(struct sm_addr *sm_addr_data)
+{
+    char buf[64];
+    ssize_t ret;
+
+    if (!sm_addr_data->region)
+    {
+        /* still accepting; frees the address on failure */
+        sm_finish_accept(sm_addr_data);
+        return (0);
+    }
+
+    do
+    {
+        ret = read(sm_addr_data->socket, buf, sizeof(buf));
+    } while (ret == sizeof(buf) || (ret < 0 && errno == EINTR));
+
+    if (ret == 0 || (ret < 0 && errno != EAGAIN))
+    {
+        gossip_debug(GOSSIP_BMI_DEBUG_SM, "pid %d closed its connection.\n",
+                     (int)sm_addr_data->peer_pid);
+        /* pick up whatever it sent before going away */
+        sm_ring_poll(sm_addr_data);
+        if (sm_addr_data->region)
+        {
+            sm_forget_addr(sm_addr_data->map, 0, -BMI_ECONNRESET);
+        }
+        return (1);
+    }
+    return (0);
+}
+
+
+/* sm_set_sleeping()
+ *
+ * raises or lowers our sleeping flag in every connected region
+ *
+ * no return value
+ */
+static void sm_set_sleeping(int value)
+{
+    struct sm_addr *sm_addr_data = NULL;
+
+    qlist_for_each_entry(sm_addr_data, &sm_addr_list, link)
+    {
+        if (sm_addr_data->region)
+        {
+            sm_addr_data->region->sleeping[sm_addr_data->side] = value;
+        }
+    }
+    __sync_synchronize();
+}
+
+
+/* sm_do_work()
+ *
+ * this is the main function for moving messages.  It polls the rings,
+ * briefly spinning if nothing is there, and then sleeps in poll() until
+ * a peer wakes us, a connection arrives or the idle time runs out.
+ * Called with interface_mutex held.
+ *
+ * returns 0 on success, -errno on failure
+ */
+static int sm_do_work(int max_idle_time)
+{
+    struct sm_addr *sm_addr_data = NULL;
+    struct sm_addr *scratch = NULL;
+    struct timeval start;
+    struct timeval now;
+    struct timeval diff;
+    struct timespec wait_time;
+    char buf[64];
+    int generation;
+    int nfds;
+    int ret;
+    int i;
+
+    if (sm_progress() > 0 || max_idle_time == 0)
+    {
+        if (sm_method_params.listen_socket >= 0)
+        {
+            sm_accept();
+        }
+        return (0);
+    }
+
+    gettimeofday(&start, NULL);
+
+    if (poll_busy)
+    {
+        /* another thread is already sleeping on our sockets; wait for
+         * it to finish rather than polling the same descriptors
+         */
+        wait_time.tv_sec = start.tv_sec + max_idle_time / 1000;
+        wait_time.tv_nsec = (start.tv_usec +
+                             ((max_idle_time % 1000) * 1000)) * 1000;
+        if (wait_time.tv_nsec > 1000000000)
+        {
+            wait_time.tv_nsec = wait_time.tv_nsec - 1000000000;
+            wait_time.tv_sec++;
+        }
+        gen_cond_timedwait(&interface_cond, &interface_mutex, &wait_time);
+        return (0);
+    }
+
+    /* a peer usually answers within microseconds */
+    do
+    {
+        if (sm_progress() > 0)
+        {
+            return (0);
+        }
+        gettimeofday(&now, NULL);
+        timersub(&now, &start, &diff);
+    } while (diff.tv_sec == 0 && diff.tv_usec < BMI_SM_SPIN_USECS);
+
+    /* announce that we will sleep, then look one last time so that a
+     * peer that did not see the flag cannot have left us anything
+     */
+    sm_set_sleeping(1);
+    if (sm_progress() > 0)
+    {
+        sm_set_sleeping(0);
+        return (0);
+    }
+
+    if (sm_poll_size < sm_addr_count + 2)
+    {
+        free(sm_pollfds);
+        free(sm_polladdrs);
+        sm_poll_size = sm_addr_count + 16;
+        sm_pollfds = malloc(sm_poll_size * sizeof(*sm_pollfds));
+        sm_polladdrs = malloc(sm_poll_size * sizeof(*sm_polladdrs));
+        if (!sm_pollfds || !sm_polladdrs)
+        {
+            free(sm_pollfds);
+            free(sm_polladdrs);
+            sm_pollfds = NULL;
+            sm_polladdrs = NULL;
+            sm_poll_size = 0;
+            sm_set_sleeping(0);
+            return (bmi_sm_errno_to_pvfs(-ENOMEM));
+        }
+    }
+
+    nfds = 0;
+    sm_pollfds[nfds].fd = sm_method_params.wake_pipe[0];
+    sm_pollfds[nfds].events = POLLIN;
+    sm_polladdrs[nfds++] = NULL;
+    if (sm_method_params.listen_socket >= 0)
+    {
+        sm_pollfds[nfds].fd = sm_method_params.listen_socket;
+        sm_pollfds[nfds].events = POLLIN;
+        sm_polladdrs[nfds++] = NULL;
+    }
+    qlist_for_each_entry(sm_addr_data, &sm_addr_list, link)
+    {
+        sm_pollfds[nfds].fd = sm_addr_data->socket;
+        sm_pollfds[nfds].events = POLLIN;
+        sm_polladdrs[nfds++] = sm_addr_data;
+    }
+    generation = sm_addr_generation;
+
+    poll_busy = 1;
+    gen_mutex_unlock(&interface_mutex);
+
+    ret = poll(sm_pollfds, nfds, max_idle_time);
+
+    gen_mutex_lock(&interface_mutex);
+    poll_busy = 0;
+    sm_set_sleeping(0);
+
+    if (ret < 0 && errno != EINTR)
+    {
+        ret = bmi_sm_errno_to_pvfs(-errno);
+        gen_cond_broadcast(&interface_cond);
+        return (ret);
+    }
+
+    if (ret > 0)
+    {
+        while (read(sm_method_params.wake_pipe[0], buf, sizeof(buf)) > 0)
+        {
+            /* empty the pipe */
+        }
+        if (generation == sm_addr_generation)
+        {
+            for (i = 0; i < nfds; i++)
+            {
+                if (sm_polladdrs[i] && sm_pollfds[i].revents)
+                {
+                    sm_drain_socket(sm_polladdrs[i]);
+                }
+            }
+        }
+        else
+        {
+            /* addresses went away while we slept; check them all */
+            qlist_for_each_entry_safe(sm_addr_data, scratch,
+                                      &sm_addr_list, link)
+            {
+                sm_drain_socket(sm_addr_data);
+            }
+        }
+        if (sm_method_params.listen_socket >= 0)
+        {
+            sm_accept();
+        }
+    }
+
+    sm_progress();
+
+    /* wake up anyone else who might have been waiting */
+    gen_cond_broadcast(&interface_cond);
+    return (0);
+}
+
+
+/* alloc_sm_method_op()
+ *
+ * creates an op for a send or receive.  Single buffers are kept in the
+ * op itself, since callers pass them in temporaries.
+ *
+ * returns pointer to op on success, NULL on failure
+ */
+static method_op_p alloc_sm_method_op(bmi_method_addr_p map,
+                                      enum bmi_op_type send_recv,
+                                      void *const *buffer_list,
+                                      const bmi_size_t *size_list,
+                                      int list_count,
+                                      bmi_size_t total_size,
+                                      bmi_msg_tag_t tag,
+                                      void *user_ptr,
+                                      bmi_context_id context_id)
+{
+    method_op_p op = NULL;
+
+    op = bmi_alloc_method_op(sizeof(struct sm_op));
+    if (!op)
+    {
+        return (NULL);
+    }
+    op->addr = map;
+    op->send_recv = send_recv;
+    op->msg_tag = tag;
+    op->user_ptr = user_ptr;
+    op->context_id = context_id;
+    op->list_count = list_count;
+    if (send_recv == BMI_SEND)
+    {
+        op->actual_size = total_size;
+    }
+    else
+    {
+        op->expected_size = total_size;
+    }
+
+    if (list_count == 1)
+    {
+        op->buffer = buffer_list[0];
+        op->buffer_list = &op->buffer;
+        op->size_list = (send_recv == BMI_SEND) ?
+            &op->actual_size : &op->expected_size;
+    }
+    else
+    {
+        op->buffer_list = buffer_list;
+        op->size_list = size_list;
+    }
+    return (op);
+}
+
+
+/* dealloc_sm_method_op()
+ *
+ * releases an op and anything buffered for it, except the buffer of an
+ * unexpected message, which belongs to the caller of testunexpected
+ *
+ * no return value
+ */
+static void dealloc_sm_method_op(method_op_p op)
+{
+    struct sm_op *sm_op_data = op->method_data;
+
+    if (sm_op_data->state == SM_OP_EARLY && op->buffer)
+    {
+        free(op->buffer);
+    }
+    if (sm_op_data->peer_iov)
+    {
+        free(sm_op_data->peer_iov);
+    }
+    bmi_dealloc_method_op(op);
+}
+
+
+/* sm_find_op()
+ *
+ * finds the oldest op on a list for an address and tag
+ *
+ * returns pointer to op if found, NULL otherwise
+ */
+static method_op_p sm_find_op(op_list_p list,
+                              bmi_method_addr_p map,
+                              bmi_msg_tag_t tag)
+{
+    struct op_list_search_key key;
+
+    memset(&key, 0, sizeof(key));
+    key.method_addr = map;
+    key.method_addr_yes = 1;
+    key.msg_tag = tag;
+    key.msg_tag_yes = 1;
+    return (op_list_search(list, &key));
+}
+
+
+/* sm_find_wait()
+ *
+ * finds an op that waits for the peer by its id.  Ids come from the
+ * peer, so they are only trusted if they name an op we have waiting on
+ * this connection.
+ *
+ * returns pointer to op if found, NULL otherwise
+ */
+static method_op_p sm_find_wait(struct sm_addr *sm_addr_data,
+                                uint64_t id)
+{
+    struct op_list_search_key key;
+
+    memset(&key, 0, sizeof(key));
+    key.op_id = (bmi_op_id_t)id;
+    key.op_id_yes = 1;
+    return (op_list_search(sm_addr_data->wait_queue, &key));
+}
+
+
+/* sm_complete_op()
+ *
+ * takes an op off whatever list it is on and hands it to its context's
+ * completion queue
+ *
+ * no return value
+ */
+static void sm_complete_op(method_op_p op, int error_code)
+{
+    op_list_remove(op);
+    SM_OP(op)->state = SM_OP_COMPLETE;
+    op->error_code = error_code;
+    if (completion_array[op->context_id])
+    {
+        op_list_add(completion_array[op->context_id], op);
+    }
+    else
+    {
+        dealloc_sm_method_op(op);
+    }
+}
+
+
+/* sm_post_send_generic()
+ *
+ * does the work common to all sends.  Small messages go straight into
+ * the ring when nothing is queued ahead of them; anything else is
+ * queued on the connection.  Called with interface_mutex held.
+ *
+ * returns 0 on success that requires later poll, returns 1 on instant
+ * completion, -errno on failure
+ */
+static int sm_post_send_generic(bmi_op_id_t *id,
+                                bmi_method_addr_p dest,
+                                const void *const *buffer_list,
+                                const bmi_size_t *size_list,
+                                int list_count,
+                                bmi_size_t total_size,
+                                bmi_msg_tag_t tag,
+                                void *user_ptr,
+                                bmi_context_id context_id,
+                                int unexpected)
+{
+    struct sm_addr *sm_addr_data = dest->method_data;
+    struct sm_msg_hdr hdr;
+    method_op_p op = NULL;
+    int ret;
+
+    ret = sm_ready_addr(sm_addr_data);
+    if (ret < 0)
+    {
+        return (ret);
+    }
+
+    if (total_size <= BMI_SM_EAGER_LIMIT &&
+        op_list_empty(sm_addr_data->send_queue))
+    {
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.type = unexpected ? BMI_SM_UNEXP : BMI_SM_EAGER;
+        hdr.len = total_size;
+        hdr.tag = tag;
+        if (sm_ring_push(sm_addr_data, &hdr, buffer_list, size_list,
+                         list_count, 0))
+        {
+            return (1);
+        }
+    }
+
+    op = alloc_sm_method_op(dest, BMI_SEND, (void *const *)buffer_list,
+                            size_list, list_count, total_size, tag,
+                            user_ptr, context_id);
+    if (!op)
+    {
+        return (bmi_sm_errno_to_pvfs(-ENOMEM));
+    }
+    *id = op->op_id;
+    SM_OP(op)->unexpected = unexpected;
+    SM_OP(op)->state = (total_size <= BMI_SM_EAGER_LIMIT) ?
+        SM_OP_EAGER : SM_OP_RTS;
+
+    op_list_add(sm_addr_data->send_queue, op);
+    sm_push_queue(sm_addr_data);
+    return (0);
+}
+
+
+/* sm_post_recv_generic()
+ *
+ * does the work common to all receives: takes a message that already
+ * arrived, starts fetching one that was announced, or queues the
+ * receive.  Called with interface_mutex held.
+ *
+ * returns 0 on success that requires later poll, returns 1 on instant
+ * completion, -errno on failure
+ */
+static int sm_post_recv_generic(bmi_op_id_t *id,
+                                bmi_method_addr_p src,
+                                void *const *buffer_list,
+                                const bmi_size_t *size_list,
+                                int list_count,
+                                bmi_size_t total_expected_size,
+                                bmi_size_t *total_actual_size,
+                                bmi_msg_tag_t tag,
+                                void *user_ptr,
+                                bmi_context_id context_id)
+{
+    struct sm_addr *sm_addr_data = src->method_data;
+    method_op_p early = NULL;
+    method_op_p op = NULL;
+    struct sm_op *early_data = NULL;
+    int ret = 0;
+
+    op = alloc_sm_method_op(src, BMI_RECV, buffer_list, size_list,
+                            list_count, total_expected_size, tag, user_ptr,
+                            context_id);
+    if (!op)
+    {
+        return (bmi_sm_errno_to_pvfs(-ENOMEM));
+    }
+
+    early = sm_find_op(early_queue, src, tag);
+    if (!early)
+    {
+        if (!sm_addr_data->region && sm_addr_data->addr_error)
+        {
+            dealloc_sm_method_op(op);
+            return (sm_addr_data->addr_error);
+        }
+        *id = op->op_id;
+        SM_OP(op)->state = SM_OP_POSTED;
+        op_list_add(recv_queue, op);
+        return (0);
+    }
+
+    op_list_remove(early);
+    early_data = early->method_data;
+    if (!early_data->rts)
+    {
+        /* the whole message is already here */
+        if (early->actual_size > total_expected_size)
+        {
+            ret = bmi_sm_errno_to_pvfs(-EMSGSIZE);
+        }
+        else
+        {
+            sm_copy_to_list(op, 0, early->buffer, early->actual_size);
+            *total_actual_size = early->actual_size;
+            ret = 1;
+        }
+        dealloc_sm_method_op(op);
+    }
+    else
+    {
+        *id = op->op_id;
+        sm_recv_rendezvous(sm_addr_data, op, early->actual_size,
+                           early_data->peer_id, early_data->peer_iov,
+                           early_data->peer_iov_count);
+    }
+    dealloc_sm_method_op(early);
+    return (ret);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
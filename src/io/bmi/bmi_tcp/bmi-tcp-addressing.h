@@ -69,6 +69,14 @@ struct tcp_addr
     /* socket collection link */
     struct qlist_head sc_link;
     int sc_index;
+    /* which socket collection shard this address is polled in */
+    int sc_shard;
+    /* set while a thread moves data on the socket without holding
+     * interface_mutex */
+    int io_busy;
+    /* number of threads holding this address in a list of ready
+     * sockets; it is not freed until they are done with it */
+    int work_refs;
     /* count of the number of sequential zero read operations */
     int zero_read_limit;
     /* timer for how long we wait on incomplete headers to arrive */
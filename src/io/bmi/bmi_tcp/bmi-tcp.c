@@ -28,6 +28,9 @@
 #ifdef HAVE_NETDB_H
 #include <netdb.h>
 #endif
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
 
 #include "bmi-method-support.h"
 #include "bmi-method-callback.h"
@@ -56,6 +59,9 @@ static gen_mutex_t interface_mutex = GEN_MUTEX_INITIALIZER;
 static gen_cond_t interface_cond = GEN_COND_INITIALIZER;
 static int sc_test_busy = 0;
 
+/* maximum number of socket collection shards (and progress threads) */
+#define BMI_TCP_MAX_PROGRESS_THREADS 16
+
 /* function prototypes */
 int BMI_tcp_initialize(bmi_method_addr_p listen_addr,
                        int method_id,
@@ -162,6 +168,18 @@ int BMI_tcp_post_send_list(bmi_op_id_t *id,
 			   bmi_context_id context_id,
                            PVFS_hint hints);
 
+#ifdef HAVE_SYS_SENDFILE_H
+int BMI_tcp_post_send_fd(bmi_op_id_t *id,
+                         bmi_method_addr_p dest,
+                         int fd,
+                         int64_t offset,
+                         bmi_size_t size,
+                         bmi_msg_tag_t tag,
+                         void *user_ptr,
+                         bmi_context_id context_id,
+                         PVFS_hint hints);
+#endif
+
 int BMI_tcp_post_recv_list(bmi_op_id_t *id,
                            bmi_method_addr_p src,
                            void *const *buffer_list,
@@ -258,6 +276,13 @@ struct tcp_op
      */
     void *buffer_list_stub;
     bmi_size_t size_list_stub;
+    /* set for operations posted with BMI_tcp_post_send_fd(); the
+     * payload is pushed from sendfile_fd with sendfile() rather than
+     * from the buffer list
+     */
+    int sendfile_flag;
+    int sendfile_fd;
+    int64_t sendfile_offset;
 };
 
 /* static io vector for use with readv and writev; we can only use
@@ -297,6 +322,14 @@ static int tcp_shutdown_addr(bmi_method_addr_p map);
 
 static int tcp_do_work(int max_idle_time);
 
+static int tcp_do_work_sockets(int socket_count,
+                               bmi_method_addr_p *addr_array,
+                               int *status_array);
+
+static void tcp_do_work_address(bmi_method_addr_p map,
+                                int status,
+                                int *busy_flag);
+
 static int tcp_do_work_error(bmi_method_addr_p map);
 
 static int tcp_do_work_recv(bmi_method_addr_p map, 
@@ -305,6 +338,10 @@ static int tcp_do_work_recv(bmi_method_addr_p map,
 static int tcp_do_work_send(bmi_method_addr_p map, 
                             int *stall_flag);
 
+static void tcp_addr_io_begin(bmi_method_addr_p map);
+static void tcp_addr_io_end(bmi_method_addr_p map);
+static void tcp_addr_io_wait(bmi_method_addr_p map);
+
 static int work_on_recv_op(method_op_p my_method_op,
 			   int *stall_flag);
 
@@ -356,6 +393,11 @@ static int payload_progress(int s,
                             char *enc_hdr,
                             bmi_size_t *env_amt_complete);
 
+#ifdef HAVE_SYS_SENDFILE_H
+static int sendfile_progress(int s,
+                             method_op_p my_method_op);
+#endif
+
 #if defined(USE_TRUSTED) && defined(__PVFS2_CLIENT__)
 static int tcp_enable_trusted(struct tcp_addr *tcp_addr_data);
 #endif
@@ -391,6 +433,9 @@ const struct bmi_method_ops bmi_tcp_ops = {
     .cancel = BMI_tcp_cancel,
     .rev_lookup_unexpected = BMI_tcp_addr_rev_lookup_unexpected,
     .query_addr_range = BMI_tcp_query_addr_range,
+#ifdef HAVE_SYS_SENDFILE_H
+    .post_send_fd = BMI_tcp_post_send_fd,
+#endif
 };
 
 /* module parameters */
@@ -425,8 +470,35 @@ static op_list_p op_list_array[6] = { NULL, NULL, NULL, NULL, NULL, NULL };
 /* internal completion queues */
 static op_list_p completion_array[BMI_MAX_CONTEXTS] = { NULL };
 
-/* internal socket collection */
-static socket_collection_p tcp_socket_collection_p = NULL;
+/* internal socket collections.  Without progress threads only shard 0
+ * is used and it is polled by whichever thread calls into tcp_do_work().
+ * With progress threads, each thread owns and polls one shard, and new
+ * connections are spread across the shards round robin.  The op lists
+ * are shared and protected by interface_mutex, but the payload transfers
+ * done while polling run without it, so data moves on several
+ * connections at once; see tcp_addr_io_begin().
+ */
+static socket_collection_p tcp_sc_array[BMI_TCP_MAX_PROGRESS_THREADS] =
+    { NULL };
+static int tcp_sc_count = 1;
+static int tcp_sc_next = 0;
+#define tcp_socket_collection_p (tcp_sc_array[0])
+
+/* collection that a given address is polled in */
+#define TCP_ADDR_SC(__map) \
+    (tcp_sc_array[((struct tcp_addr *)(__map)->method_data)->sc_shard])
+
+#ifdef __GEN_POSIX_LOCKING__
+static gen_thread_t tcp_progress_thread_array[BMI_TCP_MAX_PROGRESS_THREADS];
+static int tcp_progress_thread_count = 0;
+static int tcp_progress_shutdown = 0;
+
+static int tcp_start_progress_threads(int count);
+static void tcp_stop_progress_threads(void);
+static void *tcp_progress_thread_function(void *ptr);
+#else
+#define tcp_progress_thread_count 0
+#endif
 
 /* tunable parameters */
 enum
@@ -437,7 +509,11 @@ enum
      * translates into the number of sockets that we will perform
      * nonblocking operations on during one function call.
      */
-    TCP_WORK_METRIC = 128
+    TCP_WORK_METRIC = 128,
+    /* how long (in ms) a progress thread blocks on its socket collection
+     * before checking for shutdown
+     */
+    TCP_PROGRESS_POLL_MS = 100
 };
 
 /* TCP message modes */
@@ -628,6 +704,11 @@ int BMI_tcp_finalize(void)
 {
     int i = 0;
 
+#ifdef __GEN_POSIX_LOCKING__
+    /* progress threads need the interface lock to exit cleanly */
+    tcp_stop_progress_threads();
+#endif
+
     gen_mutex_lock(&interface_mutex);
 
     /* shut down our listen addr, if we have one */
@@ -647,12 +728,16 @@ int BMI_tcp_finalize(void)
         }
     }
 
-    /* get rid of socket collection */
-    if (tcp_socket_collection_p)
+    /* get rid of socket collections */
+    for (i = 0; i < tcp_sc_count; i++)
     {
-        BMI_socket_collection_finalize(tcp_socket_collection_p);
-        tcp_socket_collection_p = NULL;
+        if (tcp_sc_array[i])
+        {
+            BMI_socket_collection_finalize(tcp_sc_array[i]);
+            tcp_sc_array[i] = NULL;
+        }
     }
+    tcp_sc_count = 1;
 
     /* NOTE: we are trusting the calling BMI layer to deallocate 
      * all of the method addresses (this will close any open sockets)
@@ -1154,6 +1239,16 @@ int BMI_tcp_set_info(int option,
         break;
     }
 
+    case BMI_TCP_PROGRESS_THREADS:
+    {
+#ifdef __GEN_POSIX_LOCKING__
+        ret = tcp_start_progress_threads(*(int *)inout_parameter);
+#else
+        ret = bmi_tcp_errno_to_pvfs(-ENOSYS);
+#endif
+        break;
+    }
+
     default:
 	gossip_ldebug(GOSSIP_BMI_DEBUG_TCP,
                       "TCP hint %d not implemented.\n", option);
@@ -1288,6 +1383,86 @@ int BMI_tcp_post_send(bmi_op_id_t *id,
 }
 
 
+#ifdef HAVE_SYS_SENDFILE_H
+/* BMI_tcp_post_send_fd()
+ *
+ * Submits a send operation whose payload is read from an open file
+ * descriptor with sendfile().  These are always queued; the data is
+ * moved by work_on_send_op() once the socket is writable.
+ *
+ * returns 0 on success that requires later poll, -errno on failure
+ */
+int BMI_tcp_post_send_fd(bmi_op_id_t *id,
+                         bmi_method_addr_p dest,
+                         int fd,
+                         int64_t offset,
+                         bmi_size_t size,
+                         bmi_msg_tag_t tag,
+                         void *user_ptr,
+                         bmi_context_id context_id,
+                         PVFS_hint hints)
+{
+    struct tcp_msg_header my_header;
+    method_op_p new_op = NULL;
+    struct tcp_op *tcp_op_data = NULL;
+    void *buffer = NULL;
+    int ret = -1;
+
+    /* clear the id field for safety */
+    *id = 0;
+
+    if (size > TCP_MODE_REND_LIMIT)
+    {
+	return (bmi_tcp_errno_to_pvfs(-EMSGSIZE));
+    }
+
+    if (size <= TCP_MODE_EAGER_LIMIT)
+    {
+	my_header.mode = TCP_MODE_EAGER;
+    }
+    else
+    {
+	my_header.mode = TCP_MODE_REND;
+    }
+    my_header.tag = tag;
+    my_header.size = size;
+    my_header.magic_nr = BMI_MAGIC_NR;
+    BMI_TCP_ENC_HDR(my_header);
+
+    gen_mutex_lock(&interface_mutex);
+
+    ret = enqueue_operation(op_list_array[IND_SEND],
+                            BMI_SEND,
+                            dest,
+                            &buffer,
+                            &size,
+                            1,
+                            0,
+                            0,
+                            id,
+                            BMI_TCP_INPROGRESS,
+                            my_header,
+                            user_ptr,
+                            size,
+                            0,
+                            context_id,
+                            0);
+    if (*id)
+    {
+        /* still under the interface lock, so nobody has worked on it */
+        new_op = (method_op_p) id_gen_fast_lookup(*id);
+        tcp_op_data = new_op->method_data;
+        tcp_op_data->sendfile_flag = 1;
+        tcp_op_data->sendfile_fd = fd;
+        tcp_op_data->sendfile_offset = offset;
+    }
+
+    gen_mutex_unlock(&interface_mutex);
+    return (ret);
+}
+#endif
+
+
 /* BMI_tcp_post_sendunexpected()
  * 
  * Submits unexpected send operations.
@@ -1879,6 +2054,9 @@ int BMI_tcp_cancel(bmi_op_id_t id,
         return (0);
     }
 
+    /* the op may be the one whose data is moving right now */
+    tcp_addr_io_wait(query_op->addr);
+
     /* easy case: is the operation already completed? */
     if (((struct tcp_op *) (query_op->method_data))->tcp_op_state ==
 	    BMI_TCP_COMPLETE)
@@ -1916,7 +2094,7 @@ int BMI_tcp_cancel(bmi_op_id_t id,
     query_op->error_code = -BMI_ECANCEL;
     if (query_op->send_recv == BMI_SEND)
     {
-	BMI_socket_collection_remove_write_bit(tcp_socket_collection_p,
+	BMI_socket_collection_remove_write_bit(TCP_ADDR_SC(query_op->addr),
 					       query_op->addr);
     }
     op_list_remove(query_op);
@@ -2249,15 +2427,18 @@ void tcp_forget_addr(bmi_method_addr_p map,
     bmi_method_addr_p tmp_addr;
     int tmp_status;
 
-    if (tcp_socket_collection_p && tcp_addr_data->socket >= 0)
+    /* don't close the socket or fail ops while data is moving on them */
+    tcp_addr_io_wait(map);
+
+    if (TCP_ADDR_SC(map) && tcp_addr_data->socket >= 0)
     {
-	BMI_socket_collection_remove(tcp_socket_collection_p, map);
+	BMI_socket_collection_remove(TCP_ADDR_SC(map), map);
 	/* perform a test to force the socket collection to act on the remove
 	 * request before continuing
 	 */
-        if (!sc_test_busy)
+        if (!sc_test_busy && !tcp_progress_thread_count)
         {
-            BMI_socket_collection_testglobal(tcp_socket_collection_p,
+            BMI_socket_collection_testglobal(TCP_ADDR_SC(map),
                                              0, 
                                              &tmp_outcount, 
                                              &tmp_addr, 
@@ -2304,6 +2485,14 @@ static void dealloc_tcp_method_addr(bmi_method_addr_p map)
 
     tcp_addr_data = map->method_data;
 
+    tcp_addr_io_wait(map);
+#ifdef __GEN_POSIX_LOCKING__
+    while (tcp_addr_data->work_refs)
+    {
+        gen_cond_wait(&interface_cond, &interface_mutex);
+    }
+#endif
+
     /* close the socket, as long as it is not the one we are listening on
      * as a server.
      */
@@ -2362,6 +2551,9 @@ bmi_method_addr_p alloc_tcp_method_addr(void)
     tcp_addr_data->port = -1;
     tcp_addr_data->map = my_method_addr;
     tcp_addr_data->sc_index = -1;
+    /* spread connections over the socket collection shards */
+    tcp_addr_data->sc_shard = tcp_sc_next;
+    tcp_sc_next = (tcp_sc_next + 1) % tcp_sc_count;
 
     return (my_method_addr);
 }
@@ -2750,10 +2942,10 @@ static int enqueue_operation(op_list_p target_list,
 #endif
 
     /* add the socket to poll on */
-    BMI_socket_collection_add(tcp_socket_collection_p, map);
+    BMI_socket_collection_add(TCP_ADDR_SC(map), map);
     if (send_recv == BMI_SEND)
     {
-        BMI_socket_collection_add_write_bit(tcp_socket_collection_p, map);
+        BMI_socket_collection_add_write_bit(TCP_ADDR_SC(map), map);
     }
 
     /* keep up with the operation */
@@ -2819,6 +3011,9 @@ static int tcp_post_recv_generic(bmi_op_id_t *id,
         return (tcp_addr_data->addr_error);
     }
 
+    /* an eager message for this recv may be being buffered right now */
+    tcp_addr_io_wait(src);
+
     /* lets make sure that the message hasn't already been fully
      * buffered in eager mode before doing anything else
      */
@@ -3151,15 +3346,12 @@ static int tcp_do_work(int max_idle_time)
     bmi_method_addr_p addr_array[TCP_WORK_METRIC];
     int status_array[TCP_WORK_METRIC];
     int socket_count = 0;
-    int i = 0;
-    int stall_flag = 0;
     int busy_flag = 1;
     struct timespec req;
-    struct tcp_addr *tcp_addr_data = NULL;
     struct timespec wait_time;
     struct timeval start;
 
-    if (sc_test_busy)
+    if (sc_test_busy || tcp_progress_thread_count)
     {
         /* another thread is already polling or working on sockets */
         if (max_idle_time == 0)
@@ -3213,63 +3405,7 @@ static int tcp_do_work(int max_idle_time)
 	return (ret);
     }
 
-    if (socket_count == 0)
-    {
-	busy_flag = 0;
-    }
-
-    /* do different kinds of work depending on results */
-    for (i = 0; i < socket_count; i++)
-    {
-	tcp_addr_data = addr_array[i]->method_data;
-	/* skip working on addresses in failure mode */
-	if (tcp_addr_data->addr_error)
-	{
-            /* addr_error field is in BMI error code format */
-	    tcp_forget_addr(addr_array[i], 0, tcp_addr_data->addr_error);
-	    continue;
-	}
-
-	if (status_array[i] & SC_ERROR_BIT)
-	{
-	    ret = tcp_do_work_error(addr_array[i]);
-	    if (ret < 0)
-	    {
-                PVFS_perror_gossip("Warning: BMI error handling "
-                                   "failure, continuing", ret);
-	    }
-	}
-	else
-	{
-	    if (status_array[i] & SC_WRITE_BIT)
-	    {
-                ret = tcp_do_work_send(addr_array[i], &stall_flag);
-                if (ret < 0)
-                {
-                    PVFS_perror_gossip("Warning: BMI send error, continuing", 
-                                       ret);
-                }
-                if (!stall_flag)
-                {
-                    busy_flag = 0;
-                }
-	    }
-
-	    if (status_array[i] & SC_READ_BIT)
-	    {
-                ret = tcp_do_work_recv(addr_array[i], &stall_flag);
-                if (ret < 0)
-                {
-                    PVFS_perror_gossip("Warning: BMI recv error, continuing", 
-                                       ret);
-                }
-                if (!stall_flag)
-                {
-                    busy_flag = 0;
-                }
-	    }
-        }
-    }
+    busy_flag = tcp_do_work_sockets(socket_count, addr_array, status_array);
 
     /* IMPORTANT NOTE: if we have set the following flag, then it indicates that
      * poll() is finding data on our sockets, yet we are not able to move
@@ -3293,6 +3429,280 @@ static int tcp_do_work(int max_idle_time)
     return (0);
 }
 
+/* tcp_do_work_sockets()
+ *
+ * performs send, recv, and error handling work on the addresses that a
+ * socket collection reported as ready.  Must be called with
+ * interface_mutex held, which is dropped while payload data moves.
+ * Every address in the list is held until its turn has passed, so that
+ * one dropped by another thread meanwhile is not freed under us.
+ *
+ * returns 1 if sockets were ready but no data could be moved (the
+ * caller should back off briefly), 0 otherwise.
+ */
+static int tcp_do_work_sockets(int socket_count,
+                               bmi_method_addr_p *addr_array,
+                               int *status_array)
+{
+    int i = 0;
+    int busy_flag = 1;
+    int held = 0;
+    struct tcp_addr *tcp_addr_data = NULL;
+
+    if (socket_count == 0)
+    {
+	busy_flag = 0;
+    }
+
+    /* server port entries are temporary addresses that belong to us */
+    for (i = 0; i < socket_count; i++)
+    {
+	tcp_addr_data = addr_array[i]->method_data;
+        if (!tcp_addr_data->server_port)
+        {
+            tcp_addr_data->work_refs++;
+        }
+    }
+
+    /* do different kinds of work depending on results */
+    for (i = 0; i < socket_count; i++)
+    {
+	tcp_addr_data = addr_array[i]->method_data;
+        held = !tcp_addr_data->server_port;
+        tcp_do_work_address(addr_array[i], status_array[i], &busy_flag);
+        if (held && --tcp_addr_data->work_refs == 0)
+        {
+            gen_cond_broadcast(&interface_cond);
+        }
+    }
+
+    return (busy_flag);
+}
+
+/* tcp_do_work_address()
+ *
+ * performs the work tcp_do_work_sockets() found for one address, and
+ * clears *busy_flag if any data could be moved on it.
+ *
+ * no return value
+ */
+static void tcp_do_work_address(bmi_method_addr_p map,
+                                int status,
+                                int *busy_flag)
+{
+    int ret = -1;
+    int stall_flag = 0;
+    struct tcp_addr *tcp_addr_data = map->method_data;
+
+    /* another thread is already moving data on this one */
+    if (tcp_addr_data->io_busy)
+    {
+        return;
+    }
+    /* shut down since it was polled, most likely dropped */
+    if (tcp_addr_data->socket < 0)
+    {
+        return;
+    }
+    /* skip working on addresses in failure mode */
+    if (tcp_addr_data->addr_error)
+    {
+        /* addr_error field is in BMI error code format */
+        tcp_forget_addr(map, 0, tcp_addr_data->addr_error);
+        return;
+    }
+
+    if (status & SC_ERROR_BIT)
+    {
+        ret = tcp_do_work_error(map);
+        if (ret < 0)
+        {
+            PVFS_perror_gossip("Warning: BMI error handling "
+                               "failure, continuing", ret);
+        }
+        return;
+    }
+
+    if (status & SC_WRITE_BIT)
+    {
+        ret = tcp_do_work_send(map, &stall_flag);
+        if (ret < 0)
+        {
+            PVFS_perror_gossip("Warning: BMI send error, continuing", ret);
+        }
+        if (!stall_flag)
+        {
+            *busy_flag = 0;
+        }
+    }
+
+    if (status & SC_READ_BIT)
+    {
+        ret = tcp_do_work_recv(map, &stall_flag);
+        if (ret < 0)
+        {
+            PVFS_perror_gossip("Warning: BMI recv error, continuing", ret);
+        }
+        if (!stall_flag)
+        {
+            *busy_flag = 0;
+        }
+    }
+}
+
+#ifdef __GEN_POSIX_LOCKING__
+/* tcp_start_progress_threads()
+ *
+ * splits socket polling across count socket collections, each serviced
+ * by its own thread.  Once running, callers of the test functions no
+ * longer poll; they wait for a progress thread to signal interface_cond.
+ * Must be called with interface_mutex held, before connections are
+ * established (addresses created earlier stay on shard 0).
+ *
+ * returns 0 on success, -errno on failure
+ */
+static int tcp_start_progress_threads(int count)
+{
+    int i;
+    int ret;
+
+    if (count <= 0)
+    {
+        return (0);
+    }
+    if (tcp_progress_thread_count)
+    {
+        gossip_err("Error: TCP progress threads already started.\n");
+        return (bmi_tcp_errno_to_pvfs(-EALREADY));
+    }
+    if (count > BMI_TCP_MAX_PROGRESS_THREADS)
+    {
+        gossip_err("Warning: limiting TCP progress threads to %d.\n",
+                   BMI_TCP_MAX_PROGRESS_THREADS);
+        count = BMI_TCP_MAX_PROGRESS_THREADS;
+    }
+
+    /* shard 0 already exists and holds the listening socket, if any */
+    for (i = 1; i < count; i++)
+    {
+        tcp_sc_array[i] = BMI_socket_collection_init(-1);
+        if (!tcp_sc_array[i])
+        {
+            for (i = i - 1; i > 0; i--)
+            {
+                BMI_socket_collection_finalize(tcp_sc_array[i]);
+                tcp_sc_array[i] = NULL;
+            }
+            return (bmi_tcp_errno_to_pvfs(-ENOMEM));
+        }
+    }
+    tcp_sc_count = count;
+    tcp_progress_shutdown = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        ret = pthread_create(&tcp_progress_thread_array[i], NULL,
+                             tcp_progress_thread_function,
+                             (void *)(intptr_t)i);
+        if (ret != 0)
+        {
+            gossip_err("Error: failed to start TCP progress thread %d: "
+                       "%s\n", i, strerror(ret));
+            /* the threads that did start are joined at finalize */
+            break;
+        }
+        tcp_progress_thread_count++;
+    }
+
+    gossip_debug(GOSSIP_BMI_DEBUG_TCP,
+                 "Started %d TCP progress threads.\n",
+                 tcp_progress_thread_count);
+
+    return (tcp_progress_thread_count ? 0 : bmi_tcp_errno_to_pvfs(-ret));
+}
+
+/* tcp_stop_progress_threads()
+ *
+ * signals progress threads to exit and waits for them.  Must be called
+ * without interface_mutex held.
+ */
+static void tcp_stop_progress_threads(void)
+{
+    int i;
+    int count;
+
+    gen_mutex_lock(&interface_mutex);
+    count = tcp_progress_thread_count;
+    tcp_progress_shutdown = 1;
+    gen_mutex_unlock(&interface_mutex);
+
+    for (i = 0; i < count; i++)
+    {
+        pthread_join(tcp_progress_thread_array[i], NULL);
+    }
+
+    gen_mutex_lock(&interface_mutex);
+    tcp_progress_thread_count = 0;
+    gen_mutex_unlock(&interface_mutex);
+}
+
+/* tcp_progress_thread_function()
+ *
+ * polls one socket collection shard and works on whatever it reports.
+ */
+static void *tcp_progress_thread_function(void *ptr)
+{
+    int shard = (int)(intptr_t)ptr;
+    bmi_method_addr_p addr_array[TCP_WORK_METRIC];
+    int status_array[TCP_WORK_METRIC];
+    int socket_count = 0;
+    int busy_flag;
+    int ret;
+    struct timespec req;
+
+    gen_mutex_lock(&interface_mutex);
+    while (!tcp_progress_shutdown)
+    {
+        gen_mutex_unlock(&interface_mutex);
+
+        ret = BMI_socket_collection_testglobal(tcp_sc_array[shard],
+                                               TCP_WORK_METRIC,
+                                               &socket_count,
+                                               addr_array,
+                                               status_array,
+                                               TCP_PROGRESS_POLL_MS);
+
+        gen_mutex_lock(&interface_mutex);
+        if (ret < 0)
+        {
+            PVFS_perror_gossip("Error: socket collection:", ret);
+            continue;
+        }
+
+        busy_flag = tcp_do_work_sockets(socket_count, addr_array,
+                                        status_array);
+        if (socket_count > 0)
+        {
+            /* wake up test callers waiting on completions */
+            gen_cond_broadcast(&interface_cond);
+        }
+
+        if (busy_flag)
+        {
+            /* see the note in tcp_do_work() about backlogged sockets */
+            req.tv_sec = 0;
+            req.tv_nsec = 1000;
+            gen_mutex_unlock(&interface_mutex);
+            nanosleep(&req, NULL);
+            gen_mutex_lock(&interface_mutex);
+        }
+    }
+    gen_mutex_unlock(&interface_mutex);
+
+    return (NULL);
+}
+#endif /* __GEN_POSIX_LOCKING__ */
+
 
 /* tcp_do_work_send()
  *
@@ -3399,7 +3809,7 @@ static int handle_new_connection(bmi_method_addr_p map)
 	return (ret);
     }
 
-    BMI_socket_collection_add(tcp_socket_collection_p, new_addr);
+    BMI_socket_collection_add(TCP_ADDR_SC(new_addr), new_addr);
 
     dealloc_tcp_method_addr(map);
     return (0);
@@ -3706,6 +4116,59 @@ static int tcp_do_work_recv(bmi_method_addr_p map,
 }
 
 
+/* tcp_addr_io_begin()
+ *
+ * marks an address busy and drops interface_mutex so that data can move
+ * on its socket while other threads work on other connections.  Only
+ * the marking thread touches the socket or the op being worked on until
+ * tcp_addr_io_end(); threads that would close the socket, fail its ops,
+ * or hand a buffer to an op being filled wait in tcp_addr_io_wait(), and
+ * a send posted meanwhile queues behind the one in the send list.  Must
+ * be called with interface_mutex held.
+ *
+ * no return value
+ */
+static void tcp_addr_io_begin(bmi_method_addr_p map)
+{
+#ifdef __GEN_POSIX_LOCKING__
+    ((struct tcp_addr *)map->method_data)->io_busy = 1;
+    gen_mutex_unlock(&interface_mutex);
+#endif
+}
+
+/* tcp_addr_io_end()
+ *
+ * retakes interface_mutex after tcp_addr_io_begin() and wakes anyone
+ * waiting on the address
+ *
+ * no return value
+ */
+static void tcp_addr_io_end(bmi_method_addr_p map)
+{
+#ifdef __GEN_POSIX_LOCKING__
+    gen_mutex_lock(&interface_mutex);
+    ((struct tcp_addr *)map->method_data)->io_busy = 0;
+    gen_cond_broadcast(&interface_cond);
+#endif
+}
+
+/* tcp_addr_io_wait()
+ *
+ * waits until no other thread is moving data on an address.  Must be
+ * called with interface_mutex held; it is released while waiting.
+ *
+ * no return value
+ */
+static void tcp_addr_io_wait(bmi_method_addr_p map)
+{
+#ifdef __GEN_POSIX_LOCKING__
+    while (((struct tcp_addr *)map->method_data)->io_busy)
+    {
+        gen_cond_wait(&interface_cond, &interface_mutex);
+    }
+#endif
+}
+
 /* work_on_send_op()
  *
  * used to perform work on a send operation.  this is called by the poll
@@ -3746,6 +4209,14 @@ static int work_on_send_op(method_op_p my_method_op,
 	}
     }
 
+    tcp_addr_io_begin(my_method_op->addr);
+#ifdef HAVE_SYS_SENDFILE_H
+    if (tcp_op_data->sendfile_flag)
+    {
+        ret = sendfile_progress(tcp_addr_data->socket, my_method_op);
+    }
+    else
+#endif
     ret = payload_progress(tcp_addr_data->socket,
 	                   my_method_op->buffer_list,
 	                   my_method_op->size_list,
@@ -3756,6 +4227,7 @@ static int work_on_send_op(method_op_p my_method_op,
 	                   BMI_SEND,
 	                   tcp_op_data->env.enc_hdr,
 	                   &my_method_op->env_amt_complete);
+    tcp_addr_io_end(my_method_op->addr);
     if (ret < 0)
     {
         PVFS_perror_gossip("Error: payload_progress", ret);
@@ -3778,7 +4250,7 @@ static int work_on_send_op(method_op_p my_method_op,
     {
 	/* we are done */
 	my_method_op->error_code = 0;
-	BMI_socket_collection_remove_write_bit(tcp_socket_collection_p,
+	BMI_socket_collection_remove_write_bit(TCP_ADDR_SC(my_method_op->addr),
 					       my_method_op->addr);
 	op_list_remove(my_method_op);
 	((struct tcp_op *) (my_method_op->method_data))->tcp_op_state = 
@@ -3816,6 +4288,7 @@ static int work_on_recv_op(method_op_p my_method_op,
     if (my_method_op->actual_size != 0)
     {
 	/* now let's try to recv some actual data */
+	tcp_addr_io_begin(my_method_op->addr);
 	ret = payload_progress(tcp_addr_data->socket,
 	                       my_method_op->buffer_list,
 	                       my_method_op->size_list,
@@ -3826,6 +4299,7 @@ static int work_on_recv_op(method_op_p my_method_op,
 	                       BMI_RECV,
 	                       NULL,
 	                       0);
+	tcp_addr_io_end(my_method_op->addr);
 	if (ret < 0)
 	{
             PVFS_perror_gossip("Error: payload_progress", ret);
@@ -4597,6 +5071,88 @@ static int payload_progress(int s,
 }
 
 
+#ifdef HAVE_SYS_SENDFILE_H
+/* zeroes used to pad out a sendfile operation whose file came up short */
+static char sendfile_pad[4096];
+
+/* sendfile_progress()
+ *
+ * counterpart to payload_progress() for sends posted with
+ * BMI_tcp_post_send_fd().  Finishes any outstanding part of the
+ * envelope and then lets the kernel copy the payload straight from the
+ * file to the socket.  If the file ends before the message does, the
+ * rest of the message is filled with zeroes so that the receiver still
+ * sees the size announced in the header.
+ *
+ * returns number of payload bytes sent on success, -errno on failure
+ */
+static int sendfile_progress(int s,
+                             method_op_p my_method_op)
+{
+    struct tcp_op *tcp_op_data = my_method_op->method_data;
+    bmi_size_t remaining = 0;
+    off_t file_offset;
+    ssize_t ret;
+
+    if (my_method_op->env_amt_complete < TCP_ENC_HDR_SIZE)
+    {
+        ret = BMI_sockio_nbsend(s,
+            &tcp_op_data->env.enc_hdr[my_method_op->env_amt_complete],
+            TCP_ENC_HDR_SIZE - my_method_op->env_amt_complete);
+        if (ret < 0)
+        {
+            return (bmi_tcp_errno_to_pvfs(-errno));
+        }
+        my_method_op->env_amt_complete += ret;
+        if (my_method_op->env_amt_complete < TCP_ENC_HDR_SIZE)
+        {
+            return (0);
+        }
+    }
+
+    remaining = my_method_op->actual_size - my_method_op->amt_complete;
+    if (remaining == 0)
+    {
+        return (0);
+    }
+
+    file_offset = (off_t) tcp_op_data->sendfile_offset;
+    do
+    {
+        ret = sendfile(s, tcp_op_data->sendfile_fd, &file_offset,
+                       (size_t) remaining);
+    } while (ret < 0 && errno == EINTR);
+
+    if (ret < 0)
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            return (0);
+        }
+        return (bmi_tcp_errno_to_pvfs(-errno));
+    }
+
+    if (ret == 0)
+    {
+        /* hit end of file; pad out the remainder of the message */
+        if (remaining > (bmi_size_t) sizeof(sendfile_pad))
+        {
+            remaining = sizeof(sendfile_pad);
+        }
+        ret = BMI_sockio_nbsend(s, sendfile_pad, (int) remaining);
+        if (ret < 0)
+        {
+            return (bmi_tcp_errno_to_pvfs(-errno));
+        }
+        return ((int) ret);
+    }
+
+    tcp_op_data->sendfile_offset += ret;
+    return ((int) ret);
+}
+#endif
+
+
 static void bmi_set_sock_buffers(int socket)
 {
     /* Set socket buffer sizes */
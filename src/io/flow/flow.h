@@ -79,7 +79,9 @@ enum flow_state
 /* supported setinfo types */
 enum flow_setinfo_option
 {
-    FLOWPROTO_DATA_SYNC_MODE = 1
+    FLOWPROTO_DATA_SYNC_MODE = 1,
+    FLOWPROTO_ZERO_COPY_READS = 2,
+    FLOWPROTO_BUFFER_BUDGET = 3
 };
 
 /* supported getinfo types */
@@ -22,6 +22,8 @@
 #include "trove.h"
 #include "thread-mgr.h"
 #include "pint-perf-counter.h"
+#include "pint-util.h"
+#include "pint-slab.h"
 #include "pvfs2-internal.h"
 
 /* the following buffer settings are used by default if none are specified in
@@ -30,6 +32,10 @@
 #define BUFFERS_PER_FLOW 8
 #define BUFFER_SIZE (256*1024)
 
+/* limits for the per-flow tuning of trove flows (see fp_tune_flow()) */
+#define MAX_DEPTH_FACTOR 4
+#define MIN_BUFFER_SIZE 4096
+
 #define MAX_REGIONS 64
 
 #define FLOW_CLEANUP_CANCEL_PATH(__flow_data, __cancel_path)          \
@@ -39,7 +45,7 @@ do {                                                                  \
                  __flow_d);                                           \
     cleanup_buffers(__flow_data);                                     \
     __flow_d = (__flow_data)->parent;                                 \
-    free(__flow_data);                                                \
+    PINT_slab_free(flow_data_cache, __flow_data);                     \
     __flow_d->release(__flow_d);                                      \
     __flow_d->callback(__flow_d, __cancel_path);                      \
 } while(0)
@@ -72,6 +78,14 @@ struct fp_queue_item
     struct qlist_head list_link;
     flow_descriptor *parent;
     struct PINT_thread_mgr_bmi_callback bmi_callback;
+    /* set when the data for this item is sent straight from the bstream
+     * descriptor instead of being read into buffer first
+     */
+    void *sendfile_ref;
+    int sendfile_fd;
+    PVFS_offset sendfile_offset;
+    /* when the bmi or trove operation in progress was posted, in usecs */
+    PVFS_time posted_us;
 };
 
 /* fp_private_data is information specific to this flow protocol, stored
@@ -92,6 +106,8 @@ struct fp_private_data
     void *intermediate;
     int cleanup_pending_count;
     int req_proc_done;
+    int no_zero_copy;
+    int64_t budget_bytes;
 
     struct qlist_head src_list;
     struct qlist_head dest_list;
@@ -100,6 +116,12 @@ struct fp_private_data
 #define PRIVATE_FLOW(target_flow)\
     ((struct fp_private_data*)(target_flow->flow_protocol_data))
 
+/* private data for every flow, and the queue items of every flow that
+ * uses no more than the default number of buffers, come from these
+ */
+static struct PINT_slab_cache *flow_data_cache = NULL;
+static struct PINT_slab_cache *prealloc_cache = NULL;
+
 static bmi_context_id global_bmi_context = -1;
 static void cleanup_buffers(
     struct fp_private_data *flow_data);
@@ -124,6 +146,25 @@ typedef struct
 static QLIST_HEAD(s_id_sync_mode_list);
 static gen_mutex_t id_sync_mode_mutex = GEN_MUTEX_INITIALIZER;
 static TROVE_context_id global_trove_context = -1;
+static int zero_copy_reads = 0;
+
+/* buffers for trove flows are drawn from a server wide budget; a zero
+ * budget turns tuning off and every flow uses the configured settings.
+ * The costs are smoothed nsecs per KB moved by each stage of the
+ * pipeline, and are protected by the same mutex as the budget.
+ */
+static gen_mutex_t tune_mutex = GEN_MUTEX_INITIALIZER;
+static int64_t tune_budget_total = 0;
+static int64_t tune_budget_avail = 0;
+static int64_t tune_bmi_cost = 0;
+static int64_t tune_trove_cost = 0;
+
+static void fp_tune_flow(struct fp_private_data *flow_data);
+static void fp_tune_release(struct fp_private_data *flow_data);
+static void fp_tune_sample(int64_t *cost,
+                           PVFS_time posted_us,
+                           PVFS_size bytes);
+#define FP_TUNE_STAMP() (tune_budget_total ? PINT_util_get_time_us() : 0)
 
 static int get_data_sync_mode(TROVE_coll_id coll_id);
 static void bmi_recv_callback_fn(void *user_ptr,
@@ -134,6 +175,9 @@ static int bmi_send_callback_fn(void *user_ptr,
                                 PVFS_size actual_size,
                                 PVFS_error error_code,
                                 int initial_call_flag);
+static int post_trove_reads(struct fp_queue_item *q_item,
+                            struct fp_private_data *flow_data);
+static int post_ready_sends(struct fp_private_data *flow_data);
 static void trove_read_callback_fn(void *user_ptr,
                                    PVFS_error error_code);
 static void trove_write_callback_fn(void *user_ptr,
@@ -313,9 +357,24 @@ int fp_multiqueue_initialize(int flowproto_id)
 {
     int ret = -1;
 
+    flow_data_cache = PINT_slab_create("fp_private_data",
+                                       sizeof(struct fp_private_data));
+    prealloc_cache = PINT_slab_create("fp_queue_items",
+        BUFFERS_PER_FLOW * sizeof(struct fp_queue_item));
+    if(!flow_data_cache || !prealloc_cache)
+    {
+        PINT_slab_destroy(flow_data_cache);
+        PINT_slab_destroy(prealloc_cache);
+        return(-PVFS_ENOMEM);
+    }
+
     ret = PINT_thread_mgr_bmi_start();
     if(ret < 0)
+    {
+        PINT_slab_destroy(flow_data_cache);
+        PINT_slab_destroy(prealloc_cache);
         return(ret);
+    }
     PINT_thread_mgr_bmi_getcontext(&global_bmi_context);
 
 #ifdef __PVFS2_TROVE_SUPPORT__
@@ -323,6 +382,8 @@ int fp_multiqueue_initialize(int flowproto_id)
     if(ret < 0)
     {
         PINT_thread_mgr_bmi_stop();
+        PINT_slab_destroy(flow_data_cache);
+        PINT_slab_destroy(prealloc_cache);
         return(ret);
     }
     PINT_thread_mgr_trove_getcontext(&global_trove_context);
@@ -358,6 +419,10 @@ int fp_multiqueue_finalize(void)
         gen_mutex_unlock(&id_sync_mode_mutex);
     }
 #endif
+    PINT_slab_destroy(flow_data_cache);
+    flow_data_cache = NULL;
+    PINT_slab_destroy(prealloc_cache);
+    prealloc_cache = NULL;
     return (0);
 }
 
@@ -446,6 +511,25 @@ int fp_multiqueue_setinfo(flow_descriptor *flow_d,
             }
         }
         break;
+        case FLOWPROTO_ZERO_COPY_READS:
+            assert(parameter);
+            zero_copy_reads = *(int *)parameter;
+            gossip_debug(GOSSIP_FLOW_PROTO_DEBUG, "fp_multiqueue_setinfo: "
+                         "zero copy reads %s\n",
+                         (zero_copy_reads ? "enabled" : "disabled"));
+            ret = 0;
+            break;
+        case FLOWPROTO_BUFFER_BUDGET:
+            assert(parameter);
+            gen_mutex_lock(&tune_mutex);
+            tune_budget_avail -= tune_budget_total;
+            tune_budget_total = (int64_t)(*(int *)parameter) * 1024 * 1024;
+            tune_budget_avail += tune_budget_total;
+            gen_mutex_unlock(&tune_mutex);
+            gossip_debug(GOSSIP_FLOW_PROTO_DEBUG, "fp_multiqueue_setinfo: "
+                         "buffer budget set to %d MB\n", *(int *)parameter);
+            ret = 0;
+            break;
 #endif
         default:
             break;
@@ -521,12 +605,11 @@ int fp_multiqueue_post(flow_descriptor  *flow_d)
            (flow_d->src.endpoint_id == BMI_ENDPOINT &&
             flow_d->dest.endpoint_id == MEM_ENDPOINT));
 
-    flow_data = (struct fp_private_data*)malloc(sizeof(struct fp_private_data));
+    flow_data = (struct fp_private_data*)PINT_slab_alloc(flow_data_cache);
     if(!flow_data)
     {
         return(-PVFS_ENOMEM);
     }
-    memset(flow_data, 0, sizeof(struct fp_private_data));
     
     flow_d->flow_protocol_data = flow_data;
     flow_d->state = FLOW_TRANSMITTING;
@@ -565,17 +648,32 @@ int fp_multiqueue_post(flow_descriptor  *flow_d)
     {
         flow_d->buffers_per_flow = BUFFERS_PER_FLOW;
     }
+#ifdef __PVFS2_TROVE_SUPPORT__
+    if(flow_d->src.endpoint_id == TROVE_ENDPOINT ||
+       flow_d->dest.endpoint_id == TROVE_ENDPOINT)
+    {
+        fp_tune_flow(flow_data);
+    }
+#endif
         
-    flow_data->prealloc_array = (struct fp_queue_item*)
-                malloc(flow_d->buffers_per_flow*sizeof(struct fp_queue_item));
+    if(flow_d->buffers_per_flow <= BUFFERS_PER_FLOW)
+    {
+        flow_data->prealloc_array = (struct fp_queue_item*)
+                PINT_slab_alloc(prealloc_cache);
+    }
+    else
+    {
+        flow_data->prealloc_array = (struct fp_queue_item*)
+                calloc(flow_d->buffers_per_flow, sizeof(struct fp_queue_item));
+    }
     if(!flow_data->prealloc_array)
     {
-        free(flow_data);
+#ifdef __PVFS2_TROVE_SUPPORT__
+        fp_tune_release(flow_data);
+#endif
+        PINT_slab_free(flow_data_cache, flow_data);
         return(-PVFS_ENOMEM);
     }
-    memset(flow_data->prealloc_array,
-           0,
-           flow_d->buffers_per_flow*sizeof(struct fp_queue_item));
     for(i = 0; i < flow_d->buffers_per_flow; i++)
     {
         flow_data->prealloc_array[i].parent = flow_d;
@@ -738,6 +836,9 @@ static void bmi_recv_callback_fn(void *user_ptr,
         return;
     }
 
+    fp_tune_sample(&tune_bmi_cost, q_item->posted_us, actual_size);
+    q_item->posted_us = FP_TUNE_STAMP();
+
     /* remove from current queue */
     qlist_del(&q_item->list_link);
     /* add to dest queue */
@@ -882,6 +983,7 @@ static void bmi_recv_callback_fn(void *user_ptr,
                      q_item->buffer);
 
         /* TODO: what if we recv less than expected? */
+        q_item->posted_us = FP_TUNE_STAMP();
         ret = BMI_post_recv(&q_item->posted_id,
                             q_item->parent->src.u.bmi.address,
                             ((char *)q_item->buffer),
@@ -920,13 +1022,10 @@ static void bmi_recv_callback_fn(void *user_ptr,
 static void trove_read_callback_fn(void *user_ptr,
                                    PVFS_error error_code)
 {
-    int ret;
     struct result_chain_entry *result_tmp = user_ptr;
     struct fp_queue_item *q_item = result_tmp->q_item;
     struct fp_private_data *flow_data = PRIVATE_FLOW(q_item->parent);
     struct result_chain_entry *old_result_tmp;
-    int done = 0;
-    struct qlist_head *tmp_link;
 
     q_item = result_tmp->q_item;
 
@@ -950,6 +1049,8 @@ static void trove_read_callback_fn(void *user_ptr,
         return;
     }
 
+    fp_tune_sample(&tune_trove_cost, q_item->posted_us, q_item->buffer_used);
+
     /* remove from current queue */
     qlist_del(&q_item->list_link);
     /* add to dest queue */
@@ -968,31 +1069,87 @@ static void trove_read_callback_fn(void *user_ptr,
     q_item->result_chain.next = NULL;
     q_item->result_chain_count = 0;
 
+    post_ready_sends(flow_data);
+
+    return;
+}
+
+/* post_ready_sends()
+ *
+ * posts BMI sends for items on the dest list, in sequence order, for as
+ * long as the next item in sequence is ready.  Items are either sent from
+ * their buffer or, if they were set up for a zero copy read, directly from
+ * the bstream descriptor.
+ *
+ * returns 1 if flow completes, 0 otherwise
+ */
+static int post_ready_sends(struct fp_private_data *flow_data)
+{
+    int ret;
+    int done = 0;
+    struct qlist_head *tmp_link;
+    struct fp_queue_item *q_item;
+    struct fp_queue_item *tmp_item;
+
     /* while we hold dest lock, look for next seq no. to send */
     do{
+        q_item = NULL;
         qlist_for_each(tmp_link, &flow_data->dest_list)
         {
-            q_item = qlist_entry(tmp_link, struct fp_queue_item,
-                                 list_link);
-            if(q_item->seq == flow_data->next_seq_to_send)
+            tmp_item = qlist_entry(tmp_link, struct fp_queue_item,
+                                   list_link);
+            if(tmp_item->seq == flow_data->next_seq_to_send)
             {
+                q_item = tmp_item;
                 break;
             }
         }
 
-        if(q_item->seq == flow_data->next_seq_to_send)
+        if(q_item)
         {
             flow_data->dest_pending++;
             assert(q_item->buffer_used);
-            ret = BMI_post_send(&q_item->posted_id,
-                                q_item->parent->dest.u.bmi.address,
-                                q_item->buffer,
-                                q_item->buffer_used,
-                                BMI_PRE_ALLOC,
-                                q_item->parent->tag,
-                                &q_item->bmi_callback,
-                                global_bmi_context,
-                                (bmi_hint)q_item->parent->hints);
+            q_item->posted_us = FP_TUNE_STAMP();
+            if(q_item->sendfile_ref)
+            {
+                ret = BMI_post_send_fd(&q_item->posted_id,
+                                       q_item->parent->dest.u.bmi.address,
+                                       q_item->sendfile_fd,
+                                       q_item->sendfile_offset,
+                                       q_item->buffer_used,
+                                       q_item->parent->tag,
+                                       &q_item->bmi_callback,
+                                       global_bmi_context,
+                                       (bmi_hint)q_item->parent->hints);
+                if(ret == -BMI_ENOSYS)
+                {
+                    /* the method for this peer can't send from a
+                     * descriptor; read into the buffer after all and
+                     * don't try again for the rest of this flow
+                     */
+                    flow_data->dest_pending--;
+                    flow_data->no_zero_copy = 1;
+                    trove_bstream_put_fd(q_item->parent->src.u.trove.coll_id,
+                                         q_item->sendfile_ref);
+                    q_item->sendfile_ref = NULL;
+                    qlist_del(&q_item->list_link);
+                    qlist_add_tail(&q_item->list_link, &flow_data->src_list);
+                    q_item->result_chain_count = 1;
+                    return(post_trove_reads(q_item, flow_data));
+                }
+            }
+            else
+            {
+                ret = BMI_post_send(&q_item->posted_id,
+                                    q_item->parent->dest.u.bmi.address,
+                                    q_item->buffer,
+                                    q_item->buffer_used,
+                                    BMI_PRE_ALLOC,
+                                    q_item->parent->tag,
+                                    &q_item->bmi_callback,
+                                    global_bmi_context,
+                                    (bmi_hint)q_item->parent->hints);
+            }
             flow_data->next_seq_to_send++;
             if(q_item->last)
             {
@@ -1015,7 +1172,7 @@ static void trove_read_callback_fn(void *user_ptr,
         {
             gossip_err("%s: I/O error occurred\n", __func__);
             handle_io_error(ret, q_item, flow_data);
-            return;
+            return(flow_data->parent->state == FLOW_COMPLETE ? 1 : 0);
         }
 
         if(ret == 1)
@@ -1025,13 +1182,13 @@ static void trove_read_callback_fn(void *user_ptr,
             /* if that callback finished the flow, then return now */
             if(ret == 1)
             {
-                return;
+                return(1);
             }
         }
     }
     while(!done);
 
-    return;
+    return(0);
 }
 
 /* bmi_send_callback_fn()
@@ -1052,7 +1209,6 @@ static int bmi_send_callback_fn(void *user_ptr,
     struct result_chain_entry *old_result_tmp;
     void *tmp_buffer;
     PVFS_size bytes_processed = 0;
-    void *tmp_user_ptr = NULL;
 
     gossip_debug(GOSSIP_FLOW_PROTO_DEBUG,
         "flowproto-multiqueue bmi_send_callback_fn, error_code: %d, "
@@ -1067,6 +1223,13 @@ static int bmi_send_callback_fn(void *user_ptr,
 
     q_item->posted_id = 0;
 
+    if(q_item->sendfile_ref)
+    {
+        trove_bstream_put_fd(flow_data->parent->src.u.trove.coll_id,
+                             q_item->sendfile_ref);
+        q_item->sendfile_ref = NULL;
+    }
+
     if(error_code != 0 || flow_data->parent->error_code != 0)
     {
         gossip_err("%s: I/O error occurred\n", __func__);
@@ -1100,6 +1263,7 @@ static int bmi_send_callback_fn(void *user_ptr,
     else
     {
         flow_data->dest_pending--;
+        fp_tune_sample(&tune_bmi_cost, q_item->posted_us, actual_size);
     }
 
 #if 0
@@ -1286,6 +1450,50 @@ static int bmi_send_callback_fn(void *user_ptr,
 
     assert(q_item->buffer_used);
 
+    if(zero_copy_reads && !flow_data->no_zero_copy &&
+       q_item->result_chain_count == 1 &&
+       q_item->result_chain.result.segs == 1)
+    {
+        /* one contiguous region; let BMI send it straight from the
+         * bstream instead of reading it into the buffer first
+         */
+        ret = trove_bstream_get_fd(q_item->parent->src.u.trove.coll_id,
+                                   q_item->parent->src.u.trove.handle,
+                                   &q_item->sendfile_fd,
+                                   &q_item->sendfile_ref);
+        if(ret == 0)
+        {
+            q_item->sendfile_offset =
+                q_item->result_chain.result.offset_array[0];
+            q_item->result_chain_count = 0;
+            qlist_del(&q_item->list_link);
+            qlist_add_tail(&q_item->list_link, &flow_data->dest_list);
+            return(post_ready_sends(flow_data));
+        }
+        /* no descriptor available (the method doesn't have one, or
+         * nothing has been written to the bstream yet); read it normally
+         */
+        q_item->sendfile_ref = NULL;
+    }
+
+    return(post_trove_reads(q_item, flow_data));
+}
+
+/* post_trove_reads()
+ *
+ * posts the trove reads described by the result chain of a queue item
+ * that has already been placed on the src list
+ *
+ * returns 1 if flow completes, 0 otherwise
+ */
+static int post_trove_reads(struct fp_queue_item *q_item,
+                            struct fp_private_data *flow_data)
+{
+    int ret;
+    struct result_chain_entry *result_tmp;
+    void *tmp_user_ptr = NULL;
+
+    q_item->posted_us = FP_TUNE_STAMP();
     result_tmp = &q_item->result_chain;
     do{
         assert(q_item->buffer_used);
@@ -1357,6 +1565,7 @@ static void trove_write_callback_fn(void *user_ptr, PVFS_error error_code)
     struct result_chain_entry *old_result_tmp;
     void *tmp_buffer;
     PVFS_size bytes_processed = 0;
+    PVFS_size bytes_written = 0;
 
     gossip_debug(
         GOSSIP_FLOW_PROTO_DEBUG,
@@ -1382,6 +1591,7 @@ static void trove_write_callback_fn(void *user_ptr, PVFS_error error_code)
     result_tmp = &q_item->result_chain;
     do{
         q_item->parent->total_transferred += result_tmp->result.bytes;
+        bytes_written += result_tmp->result.bytes;
 
         PINT_perf_count( PINT_server_pc,
                          PINT_PERF_WRITE, 
@@ -1403,6 +1613,8 @@ static void trove_write_callback_fn(void *user_ptr, PVFS_error error_code)
     q_item->result_chain.next = NULL;
     q_item->result_chain_count = 0;
 
+    fp_tune_sample(&tune_trove_cost, q_item->posted_us, bytes_written);
+
     /* if this was the last operation, then mark the flow as done */
     if(flow_data->parent->total_transferred ==
         flow_data->total_bytes_processed &&
@@ -1520,6 +1732,7 @@ static void trove_write_callback_fn(void *user_ptr, PVFS_error error_code)
                      q_item->buffer);
 
         /* TODO: what if we recv less than expected? */
+        q_item->posted_us = FP_TUNE_STAMP();
         ret = BMI_post_recv(&q_item->posted_id,
                             q_item->parent->src.u.bmi.address,
                             ((char *)q_item->buffer),
@@ -1602,6 +1815,14 @@ static void cleanup_buffers(struct fp_private_data *flow_data)
                             flow_data->parent->buffer_size,
                             BMI_SEND);
             }
+#ifdef __PVFS2_TROVE_SUPPORT__
+            if(flow_data->prealloc_array[i].sendfile_ref)
+            {
+                trove_bstream_put_fd(flow_data->parent->src.u.trove.coll_id,
+                                     flow_data->prealloc_array[i].sendfile_ref);
+                flow_data->prealloc_array[i].sendfile_ref = NULL;
+            }
+#endif
             result_tmp = &(flow_data->prealloc_array[i].result_chain);
             do{
                 old_result_tmp = result_tmp;
@@ -1638,7 +1859,17 @@ static void cleanup_buffers(struct fp_private_data *flow_data)
         }
     }
 
-    free(flow_data->prealloc_array);
+#ifdef __PVFS2_TROVE_SUPPORT__
+    fp_tune_release(flow_data);
+#endif
+    if(flow_data->parent->buffers_per_flow <= BUFFERS_PER_FLOW)
+    {
+        PINT_slab_free(prealloc_cache, flow_data->prealloc_array);
+    }
+    else
+    {
+        free(flow_data->prealloc_array);
+    }
 }
 
 /* mem_to_bmi_callback()
@@ -2246,6 +2477,155 @@ static int get_data_sync_mode(TROVE_coll_id coll_id)
                  "returning %d\n", mode);
     return mode;
 }
+
+/* fp_tune_flow()
+ *
+ * picks the buffer size and count for a trove flow before its queue
+ * items are allocated, and reserves the memory they may use from the
+ * server wide budget.
+ *
+ * A flow whose whole request is smaller than the configured buffer
+ * gets a buffer just big enough for it.  Neither side ever sends or
+ * expects more than aggregate_size bytes, so the client, which still
+ * uses the configured size, sees the same single message either way.
+ *
+ * The configured buffer count is taken as right for a pipeline whose
+ * network and storage stages are equally fast.  When one stage is
+ * slower, buffers are added in proportion so that the slow stage still
+ * has as many in flight, up to MAX_DEPTH_FACTOR times the configured
+ * count.  The count is then cut to what the request can use and to
+ * what the budget can afford, but never below two buffers so a flow
+ * always makes progress.
+ *
+ * no return value
+ */
+static void fp_tune_flow(struct fp_private_data *flow_data)
+{
+    flow_descriptor *flow_d = flow_data->parent;
+    int64_t chunks = -1;
+    int64_t depth = flow_d->buffers_per_flow;
+    int64_t min_depth = 2;
+    int64_t fast, slow;
+
+    if(!tune_budget_total)
+    {
+        return;
+    }
+
+    if(flow_d->aggregate_size > -1)
+    {
+        if(flow_d->aggregate_size < flow_d->buffer_size)
+        {
+            int64_t size = ((flow_d->aggregate_size + MIN_BUFFER_SIZE - 1) /
+                            MIN_BUFFER_SIZE) * MIN_BUFFER_SIZE;
+            if(size < MIN_BUFFER_SIZE)
+            {
+                size = MIN_BUFFER_SIZE;
+            }
+            if(size < flow_d->buffer_size)
+            {
+                flow_d->buffer_size = size;
+            }
+        }
+        chunks = (flow_d->aggregate_size + flow_d->buffer_size - 1) /
+                 flow_d->buffer_size;
+        if(chunks < min_depth)
+        {
+            min_depth = (chunks < 1) ? 1 : chunks;
+        }
+    }
+
+    gen_mutex_lock(&tune_mutex);
+
+    fast = tune_bmi_cost;
+    slow = tune_trove_cost;
+    if(fast > slow)
+    {
+        fast = tune_trove_cost;
+        slow = tune_bmi_cost;
+    }
+    if(fast > 0 && slow > fast)
+    {
+        depth = ((depth * (fast + slow)) + (2 * fast) - 1) / (2 * fast);
+        if(depth > flow_d->buffers_per_flow * MAX_DEPTH_FACTOR)
+        {
+            depth = flow_d->buffers_per_flow * MAX_DEPTH_FACTOR;
+        }
+    }
+    if(chunks > 0 && depth > chunks)
+    {
+        depth = chunks;
+    }
+    if(depth > tune_budget_avail / flow_d->buffer_size)
+    {
+        depth = tune_budget_avail / flow_d->buffer_size;
+    }
+    if(depth < min_depth)
+    {
+        depth = min_depth;
+    }
+
+    flow_data->budget_bytes = depth * flow_d->buffer_size;
+    tune_budget_avail -= flow_data->budget_bytes;
+
+    gen_mutex_unlock(&tune_mutex);
+
+    gossip_debug(GOSSIP_FLOW_PROTO_DEBUG,
+                 "%s: flow %p using %lld buffers of %lld bytes\n",
+                 __func__, flow_d, lld(depth), lld(flow_d->buffer_size));
+
+    flow_d->buffers_per_flow = (int)depth;
+}
+
+/* fp_tune_release()
+ *
+ * returns the memory reserved by fp_tune_flow() to the budget
+ *
+ * no return value
+ */
+static void fp_tune_release(struct fp_private_data *flow_data)
+{
+    if(flow_data->budget_bytes)
+    {
+        gen_mutex_lock(&tune_mutex);
+        tune_budget_avail += flow_data->budget_bytes;
+        gen_mutex_unlock(&tune_mutex);
+        flow_data->budget_bytes = 0;
+    }
+}
+
+/* fp_tune_sample()
+ *
+ * folds the cost of one completed bmi or trove operation into the
+ * smoothed per-KB cost of that stage
+ *
+ * no return value
+ */
+static void fp_tune_sample(int64_t *cost,
+                           PVFS_time posted_us,
+                           PVFS_size bytes)
+{
+    int64_t sample;
+
+    if(!tune_budget_total || !posted_us || bytes <= 0)
+    {
+        return;
+    }
+
+    sample = ((int64_t)(PINT_util_get_time_us() - posted_us) * 1024000) /
+             bytes;
+
+    gen_mutex_lock(&tune_mutex);
+    if(*cost == 0)
+    {
+        *cost = sample;
+    }
+    else
+    {
+        *cost += (sample - *cost) / 8;
+    }
+    gen_mutex_unlock(&tune_mutex);
+}
 #endif
 
 /*
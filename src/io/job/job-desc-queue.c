@@ -18,15 +18,47 @@
 #include "id-generator.h"
 #include "pint-util.h"
 #include "pvfs2-internal.h"
+#include "pint-slab.h"
 
 #ifdef WIN32
 typedef enum job_type job_type_t;
 #endif
 
+/* every job is described by one of these, so they come from a cache */
+static struct PINT_slab_cache *job_desc_cache = NULL;
+
 /***************************************************************
  * Visible functions
  */
 
+/* job_desc_cache_initialize()
+ *
+ * sets up the cache that job descriptors are allocated from
+ *
+ * returns 0 on success, -errno on failure
+ */
+int job_desc_cache_initialize(void)
+{
+    job_desc_cache = PINT_slab_create("job_desc", sizeof(struct job_desc));
+    if (!job_desc_cache)
+    {
+        return (-ENOMEM);
+    }
+    return (0);
+}
+
+/* job_desc_cache_finalize()
+ *
+ * releases the job descriptor cache
+ *
+ * no return value
+ */
+void job_desc_cache_finalize(void)
+{
+    PINT_slab_destroy(job_desc_cache);
+    job_desc_cache = NULL;
+}
+
 /* alloc_job_desc()
  *
  * creates a new job desc struct and fills in default values
@@ -37,12 +69,11 @@ struct job_desc *alloc_job_desc(int type)
 {
     struct job_desc *jd = NULL;
 
-    jd = (struct job_desc *) malloc(sizeof(struct job_desc));
+    jd = (struct job_desc *) PINT_slab_alloc(job_desc_cache);
     if (!jd)
     {
 	return (NULL);
     }
-    memset(jd, 0, sizeof(struct job_desc));
 
     id_gen_safe_register(&(jd->job_id), jd);
 
@@ -64,7 +95,7 @@ struct job_desc *alloc_job_desc(int type)
 void dealloc_job_desc(struct job_desc *jd)
 {
     id_gen_safe_unregister(jd->job_id);
-    free(jd);
+    PINT_slab_free(job_desc_cache, jd);
 }
 
 /* job_desc_q_new()
@@ -106,7 +137,7 @@ void job_desc_q_cleanup(job_desc_q_p jdqp)
                         job_desc_q_link);
                 /* qlist_for_each_safe lets us iterate and remove nodes.  no
                  * need to adjust pointers as we are freeing everything */
-                free(tmp_job_desc);
+                PINT_slab_free(job_desc_cache, tmp_job_desc);
             }
 
             free(jdqp);
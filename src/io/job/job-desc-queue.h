@@ -148,6 +148,8 @@ struct job_desc
 
 typedef struct qlist_head *job_desc_q_p;
 
+int job_desc_cache_initialize(void);
+void job_desc_cache_finalize(void);
 struct job_desc *alloc_job_desc(int type);
 void dealloc_job_desc(struct job_desc *jd);
 job_desc_q_p job_desc_q_new(void);
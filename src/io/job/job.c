@@ -175,9 +175,16 @@ int job_initialize(int flags)
 {
     int ret = -1;
 
+    ret = job_desc_cache_initialize();
+    if (ret < 0)
+    {
+        return (ret);
+    }
+
     ret = setup_queues();
     if (ret < 0)
     {
+        job_desc_cache_finalize();
         return (ret);
     }
 
@@ -186,6 +193,7 @@ int job_initialize(int flags)
     if (ret != 0)
     {
         teardown_queues();
+        job_desc_cache_finalize();
         return (-ret);
     }
     ret = PINT_thread_mgr_bmi_getcontext((PVFS_context_id *)&global_bmi_context);
@@ -198,6 +206,7 @@ int job_initialize(int flags)
     {
         PINT_thread_mgr_bmi_stop();
         teardown_queues();
+        job_desc_cache_finalize();
         return(-ret);
     }
 #endif
@@ -211,6 +220,7 @@ int job_initialize(int flags)
         PINT_thread_mgr_dev_stop();
 #endif
         teardown_queues();
+        job_desc_cache_finalize();
         return (-ret);
     }
     ret = PINT_thread_mgr_trove_getcontext(&global_trove_context);
@@ -249,6 +259,7 @@ int job_finalize(void)
     PINT_thread_mgr_trove_stop();
 #endif
     teardown_queues();
+    job_desc_cache_finalize();
     return 0;
 }
 
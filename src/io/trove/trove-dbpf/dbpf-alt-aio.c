@@ -17,8 +17,6 @@ static int alt_aio_read(struct aiocb * aiocbp);
 static int alt_aio_write(struct aiocb * aiocbp);
 static int alt_aio_fsync(int operation, struct aiocb * aiocbp);
 
-static struct dbpf_aio_ops alt_aio_ops;
-
 struct alt_aio_item
 {
     struct aiocb *cb_p;
@@ -356,7 +354,7 @@ static int alt_aio_bstream_write_list(TROVE_coll_id coll_id,
                                 hints);
 }
 
-static struct dbpf_aio_ops alt_aio_ops =
+struct dbpf_aio_ops alt_aio_ops =
 {
     alt_aio_read,
     alt_aio_write,
@@ -377,7 +375,9 @@ struct TROVE_bstream_ops alt_aio_bstream_ops =
     alt_aio_bstream_read_list,
     alt_aio_bstream_write_list,
     dbpf_bstream_flush,
-    NULL
+    NULL,
+    dbpf_bstream_get_fd,
+    dbpf_bstream_put_fd
 };
 
 /*
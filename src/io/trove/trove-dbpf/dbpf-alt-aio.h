@@ -31,6 +31,9 @@ extern "C" {
 #include "dbpf.h"
 #include "aio.h"
 
+/* shared with the io-uring method, which falls back to alt-aio */
+extern struct dbpf_aio_ops alt_aio_ops;
+
 #if defined(__cplusplus)
 }
 #endif
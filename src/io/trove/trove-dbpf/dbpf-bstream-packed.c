@@ -0,0 +1,1599 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Packed bstreams
+ *
+ * When enabled for a collection, bstreams that stay small do not get a
+ * file of their own.  Their data is kept in an extent of a container
+ * file instead.  There is one container per extent size, in powers of
+ * two from 1 KB to 1 MB, in the collection's packed-bstreams directory.
+ *
+ * The extent a bstream uses is recorded in the keyval database under the
+ * bstream's handle, as a DBPF_PACKED_EXTENT_TYPE entry.  Extents that
+ * have been given back are recorded under the null handle, as
+ * DBPF_PACKED_FREE_TYPE entries, and are read into a free list per
+ * container when the collection is set up.
+ *
+ * A bstream is packed when it is first written, provided the write ends
+ * within the packing limit and no bstream file exists yet.  It moves to
+ * a larger extent as it grows.  Once it grows past the limit it moves to
+ * a bstream file of its own, and it is never packed again.  Extents are
+ * zeroed when they are given back, so that whatever lies past the end
+ * of a bstream in its extent reads as zeros.
+ *
+ * Bstreams that are smaller still may be kept inline, as the value of a
+ * DBPF_INLINE_DATA_TYPE entry under the bstream's handle, so that they
+ * need no file or extent at all.  A bstream is made inline when it is
+ * first written and the write ends within the inline limit.  Once it
+ * grows past that limit its data moves to an extent, or to a file of its
+ * own if it is past the packing limit too.  A collection that has kept
+ * bstreams inline records that under the null handle, so that they are
+ * still found after the limit is set to 0.
+ *
+ * I/O to packed and inline bstreams is done synchronously by a trove
+ * thread rather than through aio.  Their size is kept in the dspace
+ * attributes, as for any other bstream.
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <aio.h>
+
+#include "gossip.h"
+#include "pvfs2-debug.h"
+#include "trove.h"
+#include "trove-internal.h"
+#include "gen-locks.h"
+#include "dbpf.h"
+#include "dbpf-op-queue.h"
+#include "dbpf-open-cache.h"
+#include "dbpf-bstream-packed.h"
+
+extern gen_mutex_t dbpf_update_size_lock;
+
+/* extents are 1 KB to 1 MB */
+#define PACKED_MIN_SHIFT 10
+#define PACKED_MAX_SHIFT 20
+#define PACKED_CLASS_COUNT (PACKED_MAX_SHIFT - PACKED_MIN_SHIFT + 1)
+#define PACKED_SHARD_COUNT 16
+
+/* inline bstreams are at most 4 KB */
+#define INLINE_MAX_SIZE 4096
+
+#define PACKED_EXTENT_SIZE(__ext) ((TROVE_size)1 << (__ext)->shift)
+#define PACKED_EXTENT_OFFSET(__ext) \
+    ((TROVE_offset)((__ext)->slot << (__ext)->shift))
+
+/* a container file and the extents that are free in it */
+struct packed_class
+{
+    int fd;
+    uint64_t top;       /* number of extents in the container file */
+    uint64_t *free_slots;
+    uint64_t free_count;
+    uint64_t free_size;
+};
+
+struct dbpf_packed_state
+{
+    /* largest bstream to pack; 0 if bstreams are no longer packed */
+    int max_size;
+    /* largest bstream to keep inline; 0 if bstreams are no longer kept
+     * inline
+     */
+    int inline_size;
+    /* serializes packing decisions and packed I/O on the handles of a
+     * shard
+     */
+    gen_mutex_t shard_mutex[PACKED_SHARD_COUNT];
+    /* protects the free lists and container sizes */
+    gen_mutex_t class_mutex;
+    struct packed_class classes[PACKED_CLASS_COUNT];
+};
+
+static const char packed_zeros[65536];
+
+static gen_mutex_t *packed_shard(struct dbpf_packed_state *state,
+                                 TROVE_handle handle)
+{
+    return &state->shard_mutex[handle % PACKED_SHARD_COUNT];
+}
+
+static struct packed_class *packed_class(struct dbpf_packed_state *state,
+                                         const struct dbpf_packed_extent *ext)
+{
+    return &state->classes[ext->shift - PACKED_MIN_SHIFT];
+}
+
+/* returns the shift of the smallest extent that holds size bytes */
+static int packed_shift(TROVE_size size)
+{
+    int shift = PACKED_MIN_SHIFT;
+
+    while (((TROVE_size)1 << shift) < size)
+    {
+        shift++;
+    }
+    return shift;
+}
+
+static TROVE_offset packed_request_end(TROVE_offset *stream_offset_array,
+                                       TROVE_size *stream_size_array,
+                                       int stream_count)
+{
+    TROVE_offset eor = 0;
+    int i;
+
+    for (i = 0; i < stream_count; i++)
+    {
+        if (eor < stream_offset_array[i] + stream_size_array[i])
+        {
+            eor = stream_offset_array[i] + stream_size_array[i];
+        }
+    }
+    return eor;
+}
+
+static int packed_bstream_file_exists(struct dbpf_collection *coll_p,
+                                      TROVE_handle handle)
+{
+    char filename[PATH_MAX] = {0};
+
+    DBPF_GET_BSTREAM_FILENAME(filename, PATH_MAX, my_storage_p->data_path,
+                              coll_p->coll_id, llu(handle));
+    return (access(filename, F_OK) == 0);
+}
+
+static void packed_extent_key(struct dbpf_keyval_db_entry *entry,
+                              struct dbpf_data *key,
+                              TROVE_handle handle)
+{
+    entry->handle = handle;
+    entry->type = DBPF_PACKED_EXTENT_TYPE;
+    key->data = entry;
+    key->len = DBPF_KEYVAL_DB_ENTRY_TOTAL_SIZE(0);
+}
+
+static void packed_free_key(struct dbpf_keyval_db_entry *entry,
+                            struct dbpf_data *key,
+                            const struct dbpf_packed_extent *ext)
+{
+    entry->handle = TROVE_HANDLE_NULL;
+    entry->type = DBPF_PACKED_FREE_TYPE;
+    memcpy(entry->key, ext, sizeof(*ext));
+    key->data = entry;
+    key->len = DBPF_KEYVAL_DB_ENTRY_TOTAL_SIZE(sizeof(*ext));
+}
+
+/* returns 0 and fills in ext if the bstream is packed, -TROVE_ENOENT if
+ * it is not, or another error
+ */
+static int packed_get(struct dbpf_collection *coll_p,
+                      TROVE_handle handle,
+                      struct dbpf_packed_extent *ext)
+{
+    struct dbpf_keyval_db_entry entry;
+    struct dbpf_data key, data;
+    int ret;
+
+    packed_extent_key(&entry, &key, handle);
+    data.data = ext;
+    data.len = sizeof(*ext);
+
+    ret = dbpf_db_get(coll_p->keyval_db, &key, &data);
+    return -ret;
+}
+
+static int packed_put(struct dbpf_collection *coll_p,
+                      TROVE_handle handle,
+                      struct dbpf_packed_extent *ext)
+{
+    struct dbpf_keyval_db_entry entry;
+    struct dbpf_data key, data;
+
+    packed_extent_key(&entry, &key, handle);
+    data.data = ext;
+    data.len = sizeof(*ext);
+
+    return -dbpf_db_put(coll_p->keyval_db, &key, &data);
+}
+
+static int packed_del(struct dbpf_collection *coll_p, TROVE_handle handle)
+{
+    struct dbpf_keyval_db_entry entry;
+    struct dbpf_data key;
+
+    packed_extent_key(&entry, &key, handle);
+    return -dbpf_db_del(coll_p->keyval_db, &key);
+}
+
+/* the inline data of a bstream; under the null handle, the record that
+ * the collection has inline bstreams
+ */
+static void inline_data_key(struct dbpf_keyval_db_entry *entry,
+                            struct dbpf_data *key,
+                            TROVE_handle handle)
+{
+    entry->handle = handle;
+    entry->type = DBPF_INLINE_DATA_TYPE;
+    key->data = entry;
+    key->len = DBPF_KEYVAL_DB_ENTRY_TOTAL_SIZE(0);
+}
+
+/* reads the data of an inline bstream into buf, which must hold
+ * INLINE_MAX_SIZE bytes.  Returns its length, -TROVE_ENOENT if the
+ * bstream is not inline, or another error.
+ */
+static int inline_get(struct dbpf_collection *coll_p,
+                      TROVE_handle handle,
+                      char *buf)
+{
+    struct dbpf_keyval_db_entry entry;
+    struct dbpf_data key, data;
+    int ret;
+
+    inline_data_key(&entry, &key, handle);
+    data.data = buf;
+    data.len = INLINE_MAX_SIZE;
+
+    ret = dbpf_db_get(coll_p->keyval_db, &key, &data);
+    if (ret != 0)
+    {
+        return -ret;
+    }
+    return ((data.len > INLINE_MAX_SIZE) ? INLINE_MAX_SIZE : (int)data.len);
+}
+
+static int inline_put(struct dbpf_collection *coll_p,
+                      TROVE_handle handle,
+                      char *buf,
+                      TROVE_size len)
+{
+    struct dbpf_keyval_db_entry entry;
+    struct dbpf_data key, data;
+
+    inline_data_key(&entry, &key, handle);
+    data.data = buf;
+    data.len = len;
+
+    return -dbpf_db_put(coll_p->keyval_db, &key, &data);
+}
+
+static int inline_del(struct dbpf_collection *coll_p, TROVE_handle handle)
+{
+    struct dbpf_keyval_db_entry entry;
+    struct dbpf_data key;
+
+    inline_data_key(&entry, &key, handle);
+    return -dbpf_db_del(coll_p->keyval_db, &key);
+}
+
+/* zeros len bytes of a container, punching a hole where possible */
+static int packed_zero(int fd, TROVE_offset offset, TROVE_size len)
+{
+    TROVE_size count;
+    int ret;
+
+    if (len <= 0)
+    {
+        return 0;
+    }
+
+#ifdef FALLOC_FL_PUNCH_HOLE
+    if (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                  offset, len) == 0)
+    {
+        return 0;
+    }
+#endif
+
+    while (len > 0)
+    {
+        count = (len < sizeof(packed_zeros)) ? len : sizeof(packed_zeros);
+        ret = dbpf_pwrite(fd, packed_zeros, count, offset);
+        if (ret < 0)
+        {
+            return ret;
+        }
+        offset += count;
+        len -= count;
+    }
+    return 0;
+}
+
+/* copies len bytes between files; reads past the end of the source
+ * give zeros
+ */
+static int packed_copy(int from_fd, TROVE_offset from_offset,
+                       int to_fd, TROVE_offset to_offset, TROVE_size len)
+{
+    char *buf = NULL;
+    int ret;
+
+    if (len <= 0)
+    {
+        return 0;
+    }
+
+    buf = malloc(len);
+    if (!buf)
+    {
+        return -TROVE_ENOMEM;
+    }
+
+    ret = dbpf_pread(from_fd, buf, len, from_offset);
+    if (ret < 0)
+    {
+        ret = -trove_errno_to_trove_error(errno);
+    }
+    else
+    {
+        memset(buf + ret, 0, len - ret);
+        ret = dbpf_pwrite(to_fd, buf, len, to_offset);
+    }
+
+    free(buf);
+    return ((ret < 0) ? ret : 0);
+}
+
+static int packed_class_open(struct dbpf_collection *coll_p,
+                             struct packed_class *class,
+                             int shift,
+                             int create)
+{
+    char filename[PATH_MAX] = {0};
+    struct stat statbuf;
+    int ret, tmp_errno;
+
+    DBPF_GET_PACKED_CONTAINER_FILENAME(filename, PATH_MAX,
+                                       my_storage_p->data_path,
+                                       coll_p->coll_id, 1 << shift);
+
+    class->fd = open(filename, O_RDWR | (create ? O_CREAT : 0),
+                     TROVE_FD_MODE);
+    if (class->fd < 0)
+    {
+        tmp_errno = errno;
+        if (!create && tmp_errno == ENOENT)
+        {
+            return 0;
+        }
+        gossip_err("Error: failed to open bstream container %s: %s\n",
+                   filename, strerror(tmp_errno));
+        return -trove_errno_to_trove_error(tmp_errno);
+    }
+
+    ret = fstat(class->fd, &statbuf);
+    if (ret != 0)
+    {
+        tmp_errno = errno;
+        close(class->fd);
+        class->fd = -1;
+        return -trove_errno_to_trove_error(tmp_errno);
+    }
+
+    class->top = (uint64_t)statbuf.st_size >> shift;
+    return 0;
+}
+
+static int packed_free_push(struct packed_class *class, uint64_t slot)
+{
+    uint64_t *slots = NULL;
+    uint64_t size;
+
+    if (class->free_count == class->free_size)
+    {
+        size = class->free_size ? 2 * class->free_size : 64;
+        slots = realloc(class->free_slots, size * sizeof(uint64_t));
+        if (!slots)
+        {
+            return -TROVE_ENOMEM;
+        }
+        class->free_slots = slots;
+        class->free_size = size;
+    }
+    class->free_slots[class->free_count++] = slot;
+    return 0;
+}
+
+/* takes a free extent of the given size, or adds one to the end of the
+ * container
+ */
+static int packed_extent_alloc(struct dbpf_collection *coll_p,
+                               int shift,
+                               struct dbpf_packed_extent *ext)
+{
+    struct dbpf_packed_state *state = coll_p->packed;
+    struct packed_class *class = NULL;
+    struct dbpf_keyval_db_entry entry;
+    struct dbpf_data key;
+    int ret = 0;
+
+    ext->shift = shift;
+    ext->unused = 0;
+    class = packed_class(state, ext);
+
+    gen_mutex_lock(&state->class_mutex);
+    if (class->free_count > 0)
+    {
+        ext->slot = class->free_slots[class->free_count - 1];
+        packed_free_key(&entry, &key, ext);
+        ret = dbpf_db_del(coll_p->keyval_db, &key);
+        if (ret != 0 && ret != TROVE_ENOENT)
+        {
+            gen_mutex_unlock(&state->class_mutex);
+            return -ret;
+        }
+        class->free_count--;
+        gen_mutex_unlock(&state->class_mutex);
+        return 0;
+    }
+
+    if (class->fd < 0)
+    {
+        ret = packed_class_open(coll_p, class, shift, 1);
+        if (ret < 0)
+        {
+            gen_mutex_unlock(&state->class_mutex);
+            return ret;
+        }
+    }
+
+    /* grow the container now, so that the new extent is accounted for
+     * on restart even if nothing is ever written to it
+     */
+    if (ftruncate(class->fd, (off_t)((class->top + 1) << shift)) != 0)
+    {
+        ret = -trove_errno_to_trove_error(errno);
+        gen_mutex_unlock(&state->class_mutex);
+        return ret;
+    }
+    ext->slot = class->top++;
+    gen_mutex_unlock(&state->class_mutex);
+    return 0;
+}
+
+/* zeros the first used bytes of an extent and puts it on the free list;
+ * an extent that cannot be recorded as free is leaked
+ */
+static void packed_extent_free(struct dbpf_collection *coll_p,
+                               const struct dbpf_packed_extent *ext,
+                               TROVE_size used)
+{
+    struct dbpf_packed_state *state = coll_p->packed;
+    struct packed_class *class = packed_class(state, ext);
+    struct dbpf_keyval_db_entry entry;
+    struct dbpf_data key, data;
+    int ret;
+
+    if (used > PACKED_EXTENT_SIZE(ext))
+    {
+        used = PACKED_EXTENT_SIZE(ext);
+    }
+
+    ret = packed_zero(class->fd, PACKED_EXTENT_OFFSET(ext), used);
+    if (ret < 0)
+    {
+        gossip_err("Error: failed to clear bstream container extent "
+                   "%llu of size %lld; leaking it\n",
+                   llu(ext->slot), lld(PACKED_EXTENT_SIZE(ext)));
+        return;
+    }
+
+    gen_mutex_lock(&state->class_mutex);
+    ret = packed_free_push(class, ext->slot);
+    if (ret == 0)
+    {
+        packed_free_key(&entry, &key, ext);
+        data.data = (void *)ext;
+        data.len = sizeof(*ext);
+        ret = -dbpf_db_put(coll_p->keyval_db, &key, &data);
+        if (ret < 0)
+        {
+            class->free_count--;
+        }
+    }
+    gen_mutex_unlock(&state->class_mutex);
+
+    if (ret < 0)
+    {
+        gossip_err("Error: failed to free bstream container extent "
+                   "%llu of size %lld; leaking it\n",
+                   llu(ext->slot), lld(PACKED_EXTENT_SIZE(ext)));
+    }
+}
+
+/* syncs the keyval database if sync is set, so that extent records
+ * changed by a synchronous operation are on disk before it completes
+ */
+static int packed_sync_records(struct dbpf_collection *coll_p, int sync)
+{
+    return (sync ? -dbpf_db_sync(coll_p->keyval_db) : 0);
+}
+
+/* moves a packed bstream of the given size to a bstream file of its own.
+ * If sync is set the removal of its extent record is synced before the
+ * extent can be reused.  Must hold the handle's shard mutex.
+ */
+static int packed_migrate(struct dbpf_collection *coll_p,
+                          TROVE_handle handle,
+                          const struct dbpf_packed_extent *ext,
+                          TROVE_size size,
+                          int sync)
+{
+    struct packed_class *class = packed_class(coll_p->packed, ext);
+    struct open_cache_ref open_ref;
+    int ret;
+
+    if (size > PACKED_EXTENT_SIZE(ext))
+    {
+        size = PACKED_EXTENT_SIZE(ext);
+    }
+
+    ret = dbpf_open_cache_get(coll_p->coll_id, handle,
+                              DBPF_FD_BUFFERED_WRITE, &open_ref);
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    ret = packed_copy(class->fd, PACKED_EXTENT_OFFSET(ext),
+                      open_ref.fd, 0, size);
+    if (ret == 0 && ftruncate(open_ref.fd, size) != 0)
+    {
+        ret = -trove_errno_to_trove_error(errno);
+    }
+    /* the data has to be on disk before the extent is given up */
+    if (ret == 0 && fdatasync(open_ref.fd) != 0)
+    {
+        ret = -trove_errno_to_trove_error(errno);
+    }
+    dbpf_open_cache_put(&open_ref);
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    ret = packed_del(coll_p, handle);
+    if (ret == 0)
+    {
+        /* on failure the extent is left allocated rather than risk
+         * handing out one that a record on disk still points at
+         */
+        ret = packed_sync_records(coll_p, sync);
+    }
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    gossip_debug(GOSSIP_TROVE_DEBUG, "packed bstream %llu moved to its "
+                 "own file (%lld bytes)\n", llu(handle), lld(size));
+
+    packed_extent_free(coll_p, ext, size);
+    return 0;
+}
+
+/* moves a packed bstream of the given size to an extent that holds
+ * needed bytes.  If sync is set the copy and the new extent record are
+ * synced before the old extent can be reused.  Must hold the handle's
+ * shard mutex.
+ */
+static int packed_relocate(struct dbpf_collection *coll_p,
+                           TROVE_handle handle,
+                           struct dbpf_packed_extent *ext,
+                           TROVE_size size,
+                           TROVE_size needed,
+                           int sync)
+{
+    struct dbpf_packed_state *state = coll_p->packed;
+    struct dbpf_packed_extent new_ext;
+    int ret;
+
+    if (size > PACKED_EXTENT_SIZE(ext))
+    {
+        size = PACKED_EXTENT_SIZE(ext);
+    }
+
+    ret = packed_extent_alloc(coll_p, packed_shift(needed), &new_ext);
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    ret = packed_copy(packed_class(state, ext)->fd,
+                      PACKED_EXTENT_OFFSET(ext),
+                      packed_class(state, &new_ext)->fd,
+                      PACKED_EXTENT_OFFSET(&new_ext), size);
+    if (ret == 0 && sync &&
+        fdatasync(packed_class(state, &new_ext)->fd) != 0)
+    {
+        ret = -trove_errno_to_trove_error(errno);
+    }
+    if (ret == 0)
+    {
+        ret = packed_put(coll_p, handle, &new_ext);
+    }
+    if (ret < 0)
+    {
+        packed_extent_free(coll_p, &new_ext, size);
+        return ret;
+    }
+
+    ret = packed_sync_records(coll_p, sync);
+    if (ret < 0)
+    {
+        /* the record may be on disk either way, so keep both extents */
+        *ext = new_ext;
+        return ret;
+    }
+
+    packed_extent_free(coll_p, ext, size);
+    *ext = new_ext;
+    return 0;
+}
+
+/* moves an inline bstream holding len bytes of data to an extent that
+ * holds needed bytes, or to a bstream file of its own if needed is past
+ * the packing limit.  Sets packed and fills in ext if it moved to an
+ * extent.  If sync is set the record changes are synced before
+ * returning.  Must hold the handle's shard mutex.
+ */
+static int inline_migrate(struct dbpf_collection *coll_p,
+                          TROVE_handle handle,
+                          const char *data,
+                          TROVE_size len,
+                          TROVE_size needed,
+                          struct dbpf_packed_extent *ext,
+                          int *packed,
+                          int sync)
+{
+    struct dbpf_packed_state *state = coll_p->packed;
+    struct open_cache_ref open_ref;
+    int fd, ret;
+
+    *packed = (needed <= state->max_size);
+    if (*packed)
+    {
+        ret = packed_extent_alloc(coll_p, packed_shift(needed), ext);
+        if (ret < 0)
+        {
+            return ret;
+        }
+        fd = packed_class(state, ext)->fd;
+        ret = dbpf_pwrite(fd, data, len, PACKED_EXTENT_OFFSET(ext));
+        /* the data has to be on disk before the inline copy is dropped */
+        if (ret >= 0 && fdatasync(fd) != 0)
+        {
+            ret = -trove_errno_to_trove_error(errno);
+        }
+        if (ret >= 0)
+        {
+            ret = packed_put(coll_p, handle, ext);
+        }
+        if (ret < 0)
+        {
+            packed_extent_free(coll_p, ext, len);
+            return ret;
+        }
+    }
+    else
+    {
+        ret = dbpf_open_cache_get(coll_p->coll_id, handle,
+                                  DBPF_FD_BUFFERED_WRITE, &open_ref);
+        if (ret < 0)
+        {
+            return ret;
+        }
+        ret = dbpf_pwrite(open_ref.fd, data, len, 0);
+        if (ret >= 0 && fdatasync(open_ref.fd) != 0)
+        {
+            ret = -trove_errno_to_trove_error(errno);
+        }
+        dbpf_open_cache_put(&open_ref);
+        if (ret < 0)
+        {
+            return ret;
+        }
+    }
+
+    ret = inline_del(coll_p, handle);
+    if (ret == 0)
+    {
+        ret = packed_sync_records(coll_p, sync);
+    }
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    gossip_debug(GOSSIP_TROVE_DEBUG, "inline bstream %llu moved to %s "
+                 "(%lld bytes)\n", llu(handle),
+                 (*packed ? "an extent" : "its own file"), lld(len));
+    return 0;
+}
+
+/* performs the reads or writes of a list operation against fd, or
+ * against mem if it is not NULL, with bstream offsets shifted by base.
+ * Reads are cut off at limit unless it is negative.
+ */
+static int packed_list_io(int fd,
+                          char *mem,
+                          TROVE_offset base,
+                          TROVE_size limit,
+                          struct dbpf_bstream_rw_list_op *rw)
+{
+    int mem_ct = 0, stream_ct = 0;
+    TROVE_size mem_off = 0, stream_off = 0, len, count;
+    TROVE_offset offset;
+    char *buf;
+    int ret;
+
+    while (mem_ct < rw->mem_array_count &&
+           stream_ct < rw->stream_array_count)
+    {
+        len = rw->mem_size_array[mem_ct] - mem_off;
+        if (rw->stream_size_array[stream_ct] - stream_off < len)
+        {
+            len = rw->stream_size_array[stream_ct] - stream_off;
+        }
+        buf = rw->mem_offset_array[mem_ct] + mem_off;
+        offset = rw->stream_offset_array[stream_ct] + stream_off;
+
+        count = len;
+        if (limit >= 0)
+        {
+            count = (offset >= limit) ? 0 :
+                ((limit - offset < len) ? limit - offset : len);
+        }
+
+        if (count > 0 && mem)
+        {
+            if (rw->opcode == LIO_WRITE)
+            {
+                memcpy(mem + base + offset, buf, count);
+            }
+            else
+            {
+                memcpy(buf, mem + base + offset, count);
+            }
+            *rw->out_size_p += count;
+        }
+        else if (count > 0)
+        {
+            if (rw->opcode == LIO_WRITE)
+            {
+                ret = dbpf_pwrite(fd, buf, count, base + offset);
+            }
+            else
+            {
+                ret = dbpf_pread(fd, buf, count, base + offset);
+                if (ret < 0)
+                {
+                    ret = -trove_errno_to_trove_error(errno);
+                }
+            }
+            if (ret < 0)
+            {
+                return ret;
+            }
+            *rw->out_size_p += ret;
+        }
+
+        mem_off += len;
+        stream_off += len;
+        if (mem_off == rw->mem_size_array[mem_ct])
+        {
+            mem_ct++;
+            mem_off = 0;
+        }
+        if (stream_off == rw->stream_size_array[stream_ct])
+        {
+            stream_ct++;
+            stream_off = 0;
+        }
+    }
+    return 0;
+}
+
+static int packed_load_free(struct dbpf_collection *coll_p,
+                            struct dbpf_packed_state *state)
+{
+    struct dbpf_keyval_db_entry entry;
+    struct dbpf_packed_extent ext, value;
+    struct dbpf_data key, data;
+    struct packed_class *class = NULL;
+    dbpf_cursor *dbc = NULL;
+    int op = DBPF_DB_CURSOR_SET_RANGE;
+    int ret;
+
+    ret = dbpf_db_cursor(coll_p->keyval_db, &dbc, 1);
+    if (ret != 0)
+    {
+        return -ret;
+    }
+
+    memset(&ext, 0, sizeof(ext));
+    while (1)
+    {
+        packed_free_key(&entry, &key, &ext);
+        data.data = &value;
+        data.len = sizeof(value);
+
+        ret = dbpf_db_cursor_get(dbc, &key, &data, op,
+                                 DBPF_KEYVAL_DB_ENTRY_TOTAL_SIZE(
+                                     DBPF_MAX_KEY_LENGTH));
+        if (ret == TROVE_ENOENT)
+        {
+            ret = 0;
+            break;
+        }
+        if (ret != 0)
+        {
+            ret = -ret;
+            break;
+        }
+        op = DBPF_DB_CURSOR_NEXT;
+
+        if (entry.handle != TROVE_HANDLE_NULL ||
+            entry.type != DBPF_PACKED_FREE_TYPE)
+        {
+            break;
+        }
+
+        memcpy(&ext, entry.key, sizeof(ext));
+        if (key.len != DBPF_KEYVAL_DB_ENTRY_TOTAL_SIZE(sizeof(ext)) ||
+            ext.shift < PACKED_MIN_SHIFT || ext.shift > PACKED_MAX_SHIFT)
+        {
+            gossip_err("Warning: ignoring bad free bstream container "
+                       "extent record\n");
+            continue;
+        }
+
+        class = packed_class(state, &ext);
+        if (ext.slot >= class->top)
+        {
+            continue;
+        }
+        ret = packed_free_push(class, ext.slot);
+        if (ret < 0)
+        {
+            break;
+        }
+    }
+
+    dbpf_db_cursor_close(dbc);
+    return ret;
+}
+
+static void packed_state_free(struct dbpf_packed_state *state)
+{
+    int i;
+
+    for (i = 0; i < PACKED_CLASS_COUNT; i++)
+    {
+        if (state->classes[i].fd >= 0)
+        {
+            close(state->classes[i].fd);
+        }
+        free(state->classes[i].free_slots);
+    }
+    for (i = 0; i < PACKED_SHARD_COUNT; i++)
+    {
+        gen_mutex_destroy(&state->shard_mutex[i]);
+    }
+    gen_mutex_destroy(&state->class_mutex);
+    free(state);
+}
+
+static struct dbpf_packed_state *packed_state_alloc(void)
+{
+    struct dbpf_packed_state *state = NULL;
+    int i;
+
+    state = (struct dbpf_packed_state *)malloc(sizeof(*state));
+    if (!state)
+    {
+        return NULL;
+    }
+    memset(state, 0, sizeof(*state));
+    for (i = 0; i < PACKED_SHARD_COUNT; i++)
+    {
+        gen_mutex_init(&state->shard_mutex[i]);
+    }
+    gen_mutex_init(&state->class_mutex);
+    for (i = 0; i < PACKED_CLASS_COUNT; i++)
+    {
+        state->classes[i].fd = -1;
+    }
+    return state;
+}
+
+/* dbpf_bstream_packed_initialize()
+ *
+ * sets the largest bstream that is packed in a collection, 0 to stop
+ * packing.  The containers of a collection that packed bstreams before
+ * are opened even when packing is off, so that those bstreams can still
+ * be read and moved to files of their own as they grow.
+ */
+int dbpf_bstream_packed_initialize(struct dbpf_collection *coll_p,
+                                   int max_size)
+{
+    char path_name[PATH_MAX] = {0};
+    struct dbpf_packed_state *state = NULL;
+    int i, ret;
+
+    if (max_size < 0)
+    {
+        max_size = 0;
+    }
+    if (max_size > (1 << PACKED_MAX_SHIFT))
+    {
+        gossip_err("Warning: bstreams are packed up to %d bytes only\n",
+                   1 << PACKED_MAX_SHIFT);
+        max_size = 1 << PACKED_MAX_SHIFT;
+    }
+
+    if (coll_p->packed)
+    {
+        coll_p->packed->max_size = max_size;
+        return 0;
+    }
+
+    DBPF_GET_PACKED_BSTREAM_DIRNAME(path_name, PATH_MAX,
+                                    my_storage_p->data_path,
+                                    coll_p->coll_id);
+    if (max_size == 0)
+    {
+        if (access(path_name, F_OK) != 0)
+        {
+            return 0;
+        }
+    }
+    else if (mkdir(path_name, 0755) != 0 && errno != EEXIST)
+    {
+        ret = -trove_errno_to_trove_error(errno);
+        gossip_err("mkdir failed on packed bstream directory %s\n",
+                   path_name);
+        return ret;
+    }
+
+    state = packed_state_alloc();
+    if (!state)
+    {
+        return -TROVE_ENOMEM;
+    }
+    state->max_size = max_size;
+
+    for (i = 0; i < PACKED_CLASS_COUNT; i++)
+    {
+        ret = packed_class_open(coll_p, &state->classes[i],
+                                PACKED_MIN_SHIFT + i, 0);
+        if (ret < 0)
+        {
+            packed_state_free(state);
+            return ret;
+        }
+    }
+
+    ret = packed_load_free(coll_p, state);
+    if (ret < 0)
+    {
+        gossip_err("Error: failed to read free bstream container "
+                   "extents\n");
+        packed_state_free(state);
+        return ret;
+    }
+
+    coll_p->packed = state;
+
+    gossip_debug(GOSSIP_TROVE_DEBUG, "dbpf collection %d - packing "
+                 "bstreams of up to %d bytes\n", (int)coll_p->coll_id,
+                 max_size);
+    return 0;
+}
+
+/* dbpf_bstream_packed_set_inline()
+ *
+ * sets the largest bstream that is kept inline in a collection, 0 to
+ * stop keeping bstreams inline.  Called after
+ * dbpf_bstream_packed_initialize(), whose state it shares.
+ */
+int dbpf_bstream_packed_set_inline(struct dbpf_collection *coll_p,
+                                   int inline_size)
+{
+    char marker[INLINE_MAX_SIZE];
+    int32_t value;
+    int ret;
+
+    if (inline_size < 0)
+    {
+        inline_size = 0;
+    }
+    if (inline_size > INLINE_MAX_SIZE)
+    {
+        gossip_err("Warning: bstreams are kept inline up to %d bytes "
+                   "only\n", INLINE_MAX_SIZE);
+        inline_size = INLINE_MAX_SIZE;
+    }
+
+    if (!coll_p->packed)
+    {
+        if (inline_size == 0 &&
+            inline_get(coll_p, TROVE_HANDLE_NULL, marker) == -TROVE_ENOENT)
+        {
+            return 0;
+        }
+        coll_p->packed = packed_state_alloc();
+        if (!coll_p->packed)
+        {
+            return -TROVE_ENOMEM;
+        }
+    }
+
+    if (inline_size > 0)
+    {
+        value = inline_size;
+        ret = inline_put(coll_p, TROVE_HANDLE_NULL, (char *)&value,
+                         sizeof(value));
+        if (ret < 0)
+        {
+            return ret;
+        }
+    }
+    coll_p->packed->inline_size = inline_size;
+
+    gossip_debug(GOSSIP_TROVE_DEBUG, "dbpf collection %d - keeping "
+                 "bstreams of up to %d bytes inline\n",
+                 (int)coll_p->coll_id, inline_size);
+    return 0;
+}
+
+void dbpf_bstream_packed_finalize(struct dbpf_collection *coll_p)
+{
+    if (coll_p->packed)
+    {
+        packed_state_free(coll_p->packed);
+        coll_p->packed = NULL;
+    }
+}
+
+/* dbpf_bstream_packed_route()
+ *
+ * decides how a list operation is serviced.  Returns 1 if it must be
+ * serviced by dbpf_bstream_packed_rw_op_svc(), because the bstream is
+ * packed or inline, or may be made so by this write.  Otherwise gets the bstream
+ * file from the open cache into out_ref and returns 0.
+ */
+int dbpf_bstream_packed_route(struct dbpf_collection *coll_p,
+                              TROVE_handle handle,
+                              int opcode,
+                              TROVE_offset *stream_offset_array,
+                              TROVE_size *stream_size_array,
+                              int stream_count,
+                              struct open_cache_ref *out_ref)
+{
+    struct dbpf_packed_state *state = coll_p->packed;
+    enum open_cache_open_type type;
+    gen_mutex_t *shard = NULL;
+    struct dbpf_packed_extent ext;
+    TROVE_ds_attributes attr;
+    TROVE_object_ref ref;
+    char data[INLINE_MAX_SIZE];
+    TROVE_offset eor;
+    int ret;
+
+    type = (opcode == LIO_WRITE) ?
+        DBPF_FD_BUFFERED_WRITE : DBPF_FD_BUFFERED_READ;
+
+    if (!state)
+    {
+        return dbpf_open_cache_get(coll_p->coll_id, handle, type, out_ref);
+    }
+
+    shard = packed_shard(state, handle);
+    gen_mutex_lock(shard);
+
+    ret = inline_get(coll_p, handle, data);
+    if (ret != -TROVE_ENOENT)
+    {
+        gen_mutex_unlock(shard);
+        return ((ret >= 0) ? 1 : ret);
+    }
+
+    ret = packed_get(coll_p, handle, &ext);
+    if (ret != -TROVE_ENOENT)
+    {
+        gen_mutex_unlock(shard);
+        return ((ret == 0) ? 1 : ret);
+    }
+
+    eor = packed_request_end(stream_offset_array, stream_size_array,
+                             stream_count);
+    if (opcode == LIO_WRITE &&
+        ((state->max_size > 0 && eor <= state->max_size) ||
+         (state->inline_size > 0 && eor <= state->inline_size)))
+    {
+        ref.fs_id = coll_p->coll_id;
+        ref.handle = handle;
+        ret = dbpf_dspace_attr_get(coll_p, ref, &attr);
+        if (ret == 0 && attr.u.datafile.b_size == 0)
+        {
+            gen_mutex_unlock(shard);
+            return 1;
+        }
+    }
+
+    /* the bstream file is created while the shard is held, so a write
+     * that was queued for packing sees it and leaves the bstream alone
+     */
+    ret = dbpf_open_cache_get(coll_p->coll_id, handle, type, out_ref);
+    gen_mutex_unlock(shard);
+    return ret;
+}
+
+/* dbpf_bstream_packed_rw_op_svc()
+ *
+ * services a list operation routed here by dbpf_bstream_packed_route().
+ * The bstream may have been moved to an extent or a file of its own
+ * since, in which case the I/O is done there instead.
+ */
+int dbpf_bstream_packed_rw_op_svc(struct dbpf_op *op_p)
+{
+    struct dbpf_collection *coll_p = op_p->coll_p;
+    struct dbpf_packed_state *state = coll_p->packed;
+    struct dbpf_bstream_rw_list_op *rw = &op_p->u.b_rw_list;
+    dbpf_queued_op_t *q_op_p = (dbpf_queued_op_t *)rw->queued_op_ptr;
+    gen_mutex_t *shard = packed_shard(state, op_p->handle);
+    struct dbpf_packed_extent ext;
+    struct open_cache_ref open_ref;
+    TROVE_ds_attributes attr;
+    TROVE_object_ref ref;
+    TROVE_offset eor;
+    TROVE_size size, data_len = 0;
+    char data[INLINE_MAX_SIZE];
+    int writing = (rw->opcode == LIO_WRITE);
+    int sync = (op_p->flags & TROVE_SYNC) ? 1 : 0;
+    int packed = 0, inlined, got_ref = 0, sync_required = 0, fd = -1;
+    int allocated = 0;
+    int ret;
+
+    ref.fs_id = coll_p->coll_id;
+    ref.handle = op_p->handle;
+    eor = packed_request_end(rw->stream_offset_array,
+                             rw->stream_size_array,
+                             rw->stream_array_count);
+
+    gen_mutex_lock(shard);
+
+    ret = dbpf_dspace_attr_get(coll_p, ref, &attr);
+    if (ret < 0)
+    {
+        goto out;
+    }
+    size = attr.u.datafile.b_size;
+
+    ret = inline_get(coll_p, op_p->handle, data);
+    if (ret < 0 && ret != -TROVE_ENOENT)
+    {
+        goto out;
+    }
+    inlined = (ret >= 0);
+    if (inlined)
+    {
+        data_len = ret;
+    }
+    else
+    {
+        ret = packed_get(coll_p, op_p->handle, &ext);
+        if (ret < 0 && ret != -TROVE_ENOENT)
+        {
+            goto out;
+        }
+        packed = (ret == 0);
+    }
+    ret = 0;
+
+    if (writing && inlined)
+    {
+        if (eor > state->inline_size)
+        {
+            ret = inline_migrate(coll_p, op_p->handle, data, data_len, eor,
+                                 &ext, &packed, sync);
+            inlined = 0;
+        }
+        if (ret < 0)
+        {
+            goto out;
+        }
+    }
+    else if (writing && packed)
+    {
+        if (eor > state->max_size)
+        {
+            ret = packed_migrate(coll_p, op_p->handle, &ext, size, sync);
+            packed = 0;
+        }
+        else if (eor > PACKED_EXTENT_SIZE(&ext))
+        {
+            ret = packed_relocate(coll_p, op_p->handle, &ext, size, eor,
+                                  sync);
+        }
+        if (ret < 0)
+        {
+            goto out;
+        }
+    }
+    else if (writing && size == 0 &&
+             ((state->inline_size > 0 && eor <= state->inline_size) ||
+              (state->max_size > 0 && eor <= state->max_size)) &&
+             !packed_bstream_file_exists(coll_p, op_p->handle))
+    {
+        if (state->inline_size > 0 && eor <= state->inline_size)
+        {
+            inlined = 1;
+        }
+        else
+        {
+            ret = packed_extent_alloc(coll_p, packed_shift(eor), &ext);
+            if (ret < 0)
+            {
+                goto out;
+            }
+            ret = packed_put(coll_p, op_p->handle, &ext);
+            if (ret < 0)
+            {
+                packed_extent_free(coll_p, &ext, 0);
+                goto out;
+            }
+            packed = 1;
+            allocated = 1;
+        }
+    }
+
+    if (inlined)
+    {
+        if (writing && eor > data_len)
+        {
+            memset(data + data_len, 0, eor - data_len);
+            data_len = eor;
+        }
+        ret = packed_list_io(-1, data, 0, writing ? -1 : data_len, rw);
+        if (ret == 0 && writing)
+        {
+            ret = inline_put(coll_p, op_p->handle, data, data_len);
+        }
+    }
+    else if (packed)
+    {
+        fd = packed_class(state, &ext)->fd;
+        ret = packed_list_io(fd, NULL, PACKED_EXTENT_OFFSET(&ext),
+                             writing ? -1 : size, rw);
+    }
+    else
+    {
+        ret = dbpf_open_cache_get(coll_p->coll_id, op_p->handle,
+                                  writing ? DBPF_FD_BUFFERED_WRITE :
+                                  DBPF_FD_BUFFERED_READ, &open_ref);
+        if (ret < 0)
+        {
+            goto out;
+        }
+        got_ref = 1;
+        fd = open_ref.fd;
+        ret = packed_list_io(fd, NULL, 0, -1, rw);
+    }
+
+    if (ret < 0 || !writing)
+    {
+        goto out;
+    }
+
+    if (inlined)
+    {
+        if (op_p->flags & TROVE_SYNC)
+        {
+            ret = -dbpf_db_sync(coll_p->keyval_db);
+        }
+    }
+    else
+    {
+        DBPF_AIO_SYNC_IF_NECESSARY(op_p, fd, ret);
+        /* the record of a new extent goes to disk after its data */
+        if (ret == 0 && allocated)
+        {
+            ret = packed_sync_records(coll_p, sync);
+        }
+    }
+    if (ret < 0 || eor <= size)
+    {
+        goto out;
+    }
+
+    gen_mutex_lock(&dbpf_update_size_lock);
+    ret = dbpf_dspace_attr_get(coll_p, ref, &attr);
+    if (ret == 0 && eor > attr.u.datafile.b_size)
+    {
+        attr.u.datafile.b_size = eor;
+        ret = dbpf_dspace_attr_set(coll_p, ref, &attr);
+        if (ret == 0 && (op_p->flags & TROVE_SYNC))
+        {
+            sync_required = 1;
+        }
+    }
+    gen_mutex_unlock(&dbpf_update_size_lock);
+
+out:
+    gen_mutex_unlock(shard);
+    if (got_ref)
+    {
+        dbpf_open_cache_put(&open_ref);
+    }
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    if (sync_required)
+    {
+        /* complete as a setattr, as a resize does, so that the size
+         * update is synced before the write is reported done
+         */
+        dbpf_queued_op_init(q_op_p,
+                            DSPACE_SETATTR,
+                            ref.handle,
+                            coll_p,
+                            dbpf_dspace_setattr_op_svc,
+                            q_op_p->op.user_ptr,
+                            TROVE_SYNC,
+                            q_op_p->op.context_id);
+        q_op_p->op.state = OP_IN_SERVICE;
+    }
+    return DBPF_OP_COMPLETE;
+}
+
+/* dbpf_bstream_packed_resize()
+ *
+ * prepares a packed or inline bstream for a resize to size bytes, moving
+ * it to a larger extent or to a file of its own as needed.  Moves are
+ * synced, as a resize always completes as a synced setattr.  Returns 1
+ * if the bstream file must be left alone, 0 if it is to be truncated.
+ */
+int dbpf_bstream_packed_resize(struct dbpf_collection *coll_p,
+                               TROVE_handle handle,
+                               TROVE_size size)
+{
+    struct dbpf_packed_state *state = coll_p->packed;
+    gen_mutex_t *shard = NULL;
+    struct dbpf_packed_extent ext;
+    TROVE_ds_attributes attr;
+    TROVE_object_ref ref;
+    TROVE_size old_size;
+    char data[INLINE_MAX_SIZE];
+    int packed, ret;
+
+    if (!state)
+    {
+        return 0;
+    }
+
+    shard = packed_shard(state, handle);
+    gen_mutex_lock(shard);
+
+    ret = inline_get(coll_p, handle, data);
+    if (ret >= 0)
+    {
+        old_size = ret;
+        if (size > state->inline_size)
+        {
+            /* a new file is truncated to size, an extent reads as zeros
+             * past the data already
+             */
+            ret = inline_migrate(coll_p, handle, data, old_size, size,
+                                 &ext, &packed, 1);
+            if (ret == 0)
+            {
+                ret = packed;
+            }
+            goto out;
+        }
+        if (size > old_size)
+        {
+            memset(data + old_size, 0, size - old_size);
+        }
+        ret = inline_put(coll_p, handle, data, size);
+        if (ret == 0)
+        {
+            ret = 1;
+        }
+        goto out;
+    }
+    if (ret != -TROVE_ENOENT)
+    {
+        goto out;
+    }
+
+    ret = packed_get(coll_p, handle, &ext);
+    if (ret == -TROVE_ENOENT)
+    {
+        /* truncating a bstream that was never written to zero would
+         * only create its file and stop it from being packed
+         */
+        ret = (size == 0 &&
+               (state->max_size > 0 || state->inline_size > 0) &&
+               !packed_bstream_file_exists(coll_p, handle));
+        goto out;
+    }
+    if (ret < 0)
+    {
+        goto out;
+    }
+
+    ref.fs_id = coll_p->coll_id;
+    ref.handle = handle;
+    ret = dbpf_dspace_attr_get(coll_p, ref, &attr);
+    if (ret < 0)
+    {
+        goto out;
+    }
+    old_size = attr.u.datafile.b_size;
+    if (old_size > PACKED_EXTENT_SIZE(&ext))
+    {
+        old_size = PACKED_EXTENT_SIZE(&ext);
+    }
+
+    if (size > state->max_size)
+    {
+        ret = packed_migrate(coll_p, handle, &ext, old_size, 1);
+        goto out;
+    }
+
+    if (size > PACKED_EXTENT_SIZE(&ext))
+    {
+        ret = packed_relocate(coll_p, handle, &ext, old_size, size, 1);
+    }
+    else if (size < old_size)
+    {
+        ret = packed_zero(packed_class(state, &ext)->fd,
+                          PACKED_EXTENT_OFFSET(&ext) + size,
+                          old_size - size);
+    }
+    if (ret == 0)
+    {
+        ret = 1;
+    }
+
+out:
+    gen_mutex_unlock(shard);
+    return ret;
+}
+
+/* dbpf_bstream_packed_flush()
+ *
+ * returns 1 if the bstream is packed or inline and its data and extent
+ * record were synced, 0 if it is neither
+ */
+int dbpf_bstream_packed_flush(struct dbpf_collection *coll_p,
+                              TROVE_handle handle)
+{
+    struct dbpf_packed_state *state = coll_p->packed;
+    struct dbpf_packed_extent ext;
+    char data[INLINE_MAX_SIZE];
+    int ret;
+
+    if (!state)
+    {
+        return 0;
+    }
+
+    ret = inline_get(coll_p, handle, data);
+    if (ret >= 0)
+    {
+        ret = -dbpf_db_sync(coll_p->keyval_db);
+        return ((ret < 0) ? ret : 1);
+    }
+    if (ret != -TROVE_ENOENT)
+    {
+        return ret;
+    }
+
+    ret = packed_get(coll_p, handle, &ext);
+    if (ret == -TROVE_ENOENT)
+    {
+        return 0;
+    }
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    if (fdatasync(packed_class(state, &ext)->fd) != 0)
+    {
+        return -trove_errno_to_trove_error(errno);
+    }
+    /* the extent record may not have been synced yet either */
+    ret = packed_sync_records(coll_p, 1);
+    return ((ret < 0) ? ret : 1);
+}
+
+/* dbpf_bstream_packed_is_packed()
+ *
+ * returns 1 if the bstream is packed or inline, and so has no file
+ */
+int dbpf_bstream_packed_is_packed(struct dbpf_collection *coll_p,
+                                  TROVE_handle handle)
+{
+    struct dbpf_packed_extent ext;
+    char data[INLINE_MAX_SIZE];
+
+    if (!coll_p->packed)
+    {
+        return 0;
+    }
+    return (inline_get(coll_p, handle, data) >= 0 ||
+            packed_get(coll_p, handle, &ext) == 0);
+}
+
+/* dbpf_bstream_packed_remove()
+ *
+ * gives back the extent of a packed bstream that is being removed, or
+ * drops the data of an inline one
+ */
+int dbpf_bstream_packed_remove(struct dbpf_collection *coll_p,
+                               TROVE_handle handle)
+{
+    struct dbpf_packed_state *state = coll_p->packed;
+    gen_mutex_t *shard = NULL;
+    struct dbpf_packed_extent ext;
+    int ret;
+
+    if (!state)
+    {
+        return 0;
+    }
+
+    shard = packed_shard(state, handle);
+    gen_mutex_lock(shard);
+
+    ret = inline_del(coll_p, handle);
+    if (ret != -TROVE_ENOENT)
+    {
+        gen_mutex_unlock(shard);
+        return ret;
+    }
+
+    ret = packed_get(coll_p, handle, &ext);
+    if (ret == 0)
+    {
+        ret = packed_del(coll_p, handle);
+        if (ret == 0)
+        {
+            packed_extent_free(coll_p, &ext, PACKED_EXTENT_SIZE(&ext));
+        }
+    }
+    else if (ret == -TROVE_ENOENT)
+    {
+        ret = 0;
+    }
+
+    gen_mutex_unlock(shard);
+    return ret;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
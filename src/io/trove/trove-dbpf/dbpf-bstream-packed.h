@@ -0,0 +1,55 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+#ifndef __DBPF_BSTREAM_PACKED_H__
+#define __DBPF_BSTREAM_PACKED_H__
+
+#include "pvfs2-internal.h"
+#include "trove.h"
+#include "dbpf.h"
+#include "dbpf-open-cache.h"
+
+int dbpf_bstream_packed_initialize(struct dbpf_collection *coll_p,
+                                   int max_size);
+
+int dbpf_bstream_packed_set_inline(struct dbpf_collection *coll_p,
+                                   int inline_size);
+
+void dbpf_bstream_packed_finalize(struct dbpf_collection *coll_p);
+
+int dbpf_bstream_packed_route(struct dbpf_collection *coll_p,
+                              TROVE_handle handle,
+                              int opcode,
+                              TROVE_offset *stream_offset_array,
+                              TROVE_size *stream_size_array,
+                              int stream_count,
+                              struct open_cache_ref *out_ref);
+
+int dbpf_bstream_packed_rw_op_svc(struct dbpf_op *op_p);
+
+int dbpf_bstream_packed_resize(struct dbpf_collection *coll_p,
+                               TROVE_handle handle,
+                               TROVE_size size);
+
+int dbpf_bstream_packed_flush(struct dbpf_collection *coll_p,
+                              TROVE_handle handle);
+
+int dbpf_bstream_packed_is_packed(struct dbpf_collection *coll_p,
+                                  TROVE_handle handle);
+
+int dbpf_bstream_packed_remove(struct dbpf_collection *coll_p,
+                               TROVE_handle handle);
+
+#endif /* __DBPF_BSTREAM_PACKED_H__ */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -27,6 +27,7 @@
 #include "pint-event.h"
 #include "dbpf-open-cache.h"
 #include "dbpf-sync.h"
+#include "dbpf-bstream-packed.h"
 
 #include "dbpf-alt-aio.h"
 
@@ -38,7 +39,8 @@ extern int TROVE_max_concurrent_io;
 static int s_dbpf_ios_in_progress = 0;
 static dbpf_op_queue_p s_dbpf_io_ready_queue = NULL;
 static gen_mutex_t s_dbpf_io_mutex = GEN_MUTEX_INITIALIZER;
-static gen_mutex_t dbpf_update_size_lock = GEN_MUTEX_INITIALIZER;
+/* also taken by the packed bstream code */
+gen_mutex_t dbpf_update_size_lock = GEN_MUTEX_INITIALIZER;
 
 static struct dbpf_aio_ops aio_ops;
 
@@ -592,6 +594,12 @@ static int dbpf_bstream_flush_op_svc(struct dbpf_op *op_p)
     int ret = -TROVE_EINVAL, got_fd = 0;
     struct open_cache_ref tmp_ref;
 
+    ret = dbpf_bstream_packed_flush(op_p->coll_p, op_p->handle);
+    if (ret != 0)
+    {
+        return ret;
+    }
+
     ret = dbpf_open_cache_get(
         op_p->coll_p->coll_id, op_p->handle,
         DBPF_FD_BUFFERED_WRITE, &tmp_ref);
@@ -861,10 +869,10 @@ inline int dbpf_bstream_rw_list(TROVE_coll_id coll_id,
 
     q_op_p->op.u.b_rw_list.list_proc_state = LIST_PROC_INITIALIZED;
 
-    ret = dbpf_open_cache_get(
-        coll_id, handle, 
-        (opcode == LIO_WRITE) ? DBPF_FD_BUFFERED_WRITE : DBPF_FD_BUFFERED_READ, 
-        &q_op_p->op.u.b_rw_list.open_ref);
+    /* gets the fd from the open cache unless the bstream is packed */
+    ret = dbpf_bstream_packed_route(
+        coll_p, handle, opcode, stream_offset_array, stream_size_array,
+        stream_count, &q_op_p->op.u.b_rw_list.open_ref);
     if (ret < 0)
     {
         dbpf_queued_op_free(q_op_p);
@@ -872,7 +880,6 @@ inline int dbpf_bstream_rw_list(TROVE_coll_id coll_id,
                       "warning: useless error value: %d\n", ret);
         return ret;
     }
-    q_op_p->op.u.b_rw_list.fd = q_op_p->op.u.b_rw_list.open_ref.fd;
 
     /*
       if we're doing an i/o write, remove the cached attribute for
@@ -886,6 +893,16 @@ inline int dbpf_bstream_rw_list(TROVE_coll_id coll_id,
         gen_mutex_unlock(&dbpf_attr_cache_mutex);
     }
 
+    if (ret == 1)
+    {
+        /* packed bstreams are serviced by a trove thread without aio */
+        q_op_p->op.svc_fn = dbpf_bstream_packed_rw_op_svc;
+        q_op_p->op.u.b_rw_list.queued_op_ptr = (void *)q_op_p;
+        *out_op_id_p = dbpf_queued_op_queue(q_op_p);
+        return 0;
+    }
+    q_op_p->op.u.b_rw_list.fd = q_op_p->op.u.b_rw_list.open_ref.fd;
+
 #ifndef __PVFS2_TROVE_AIO_THREADED__
 
     *out_op_id_p = dbpf_queued_op_queue(q_op_p);
@@ -1355,12 +1372,20 @@ static int dbpf_bstream_resize_op_svc(struct dbpf_op *op_p)
     dbpf_queued_op_t *q_op_p;
     struct open_cache_ref open_ref;
     PVFS_size tmpsize;
+    int packed;
 
     q_op_p = (dbpf_queued_op_t *)op_p->u.b_resize.queued_op_ptr;
 
     ref.fs_id = op_p->coll_p->coll_id;
     ref.handle = op_p->handle;
 
+    packed = dbpf_bstream_packed_resize(op_p->coll_p, op_p->handle,
+                                        op_p->u.b_resize.size);
+    if (packed < 0)
+    {
+        return packed;
+    }
+
     gen_mutex_lock(&dbpf_update_size_lock);
     ret = dbpf_dspace_attr_get(op_p->coll_p, ref, &attr);
     if(ret != 0)
@@ -1391,6 +1416,11 @@ static int dbpf_bstream_resize_op_svc(struct dbpf_op *op_p)
                         q_op_p->op.context_id);
     q_op_p->op.state = OP_IN_SERVICE;
 
+    if (packed)
+    {
+        return DBPF_OP_COMPLETE;
+    }
+
     /* truncate file after attributes are set */
     ret = dbpf_open_cache_get(
         op_p->coll_p->coll_id, op_p->handle,
@@ -1455,6 +1485,56 @@ int dbpf_bstream_resize(TROVE_coll_id coll_id,
     return 0;
 }
 
+/* dbpf_bstream_get_fd()
+ *
+ * pins a buffered read descriptor for the bstream in the open cache and
+ * hands it out; the reference is what the caller gives back to
+ * dbpf_bstream_put_fd().  Does not create the bstream file if it does
+ * not exist yet, and fails for packed bstreams, which have no file.
+ */
+int dbpf_bstream_get_fd(TROVE_coll_id coll_id,
+                        TROVE_handle handle,
+                        int *out_fd_p,
+                        void **out_fd_ref_p)
+{
+    struct open_cache_ref *ref = NULL;
+    struct dbpf_collection *coll_p = NULL;
+    int ret = -TROVE_EINVAL;
+
+    coll_p = dbpf_collection_find_registered(coll_id);
+    if (coll_p == NULL)
+    {
+        return -TROVE_EINVAL;
+    }
+    if (dbpf_bstream_packed_is_packed(coll_p, handle))
+    {
+        return -TROVE_ENOSYS;
+    }
+
+    ref = (struct open_cache_ref *)malloc(sizeof(struct open_cache_ref));
+    if (!ref)
+    {
+        return -TROVE_ENOMEM;
+    }
+
+    ret = dbpf_open_cache_get(coll_id, handle, DBPF_FD_BUFFERED_READ, ref);
+    if (ret < 0)
+    {
+        free(ref);
+        return ret;
+    }
+
+    *out_fd_p = ref->fd;
+    *out_fd_ref_p = ref;
+    return 0;
+}
+
+void dbpf_bstream_put_fd(void *fd_ref)
+{
+    dbpf_open_cache_put((struct open_cache_ref *)fd_ref);
+    free(fd_ref);
+}
+
 struct TROVE_bstream_ops dbpf_bstream_ops =
 {
     dbpf_bstream_read_at,
@@ -1464,7 +1544,9 @@ struct TROVE_bstream_ops dbpf_bstream_ops =
     dbpf_bstream_read_list,
     dbpf_bstream_write_list,
     dbpf_bstream_flush,
-    dbpf_bstream_cancel
+    dbpf_bstream_cancel,
+    dbpf_bstream_get_fd,
+    dbpf_bstream_put_fd
 };
 
 /*
@@ -253,6 +253,18 @@ int dbpf_db_del(struct dbpf_db *db, struct dbpf_data *key)
     return db_error(db->db->del(db->db, NULL, &db_key, 0));
 }
 
+/* Berkeley DB is opened without a transactional environment, so there is
+ * nothing to group and every update is applied as it is made. */
+int dbpf_db_batch_begin(struct dbpf_db *db)
+{
+    return 0;
+}
+
+int dbpf_db_batch_commit(struct dbpf_db *db)
+{
+    return 0;
+}
+
 int dbpf_db_cursor(struct dbpf_db *db, struct dbpf_cursor **dbc, int rdonly)
 {
     int r;
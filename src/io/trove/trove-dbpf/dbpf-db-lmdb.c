@@ -5,10 +5,12 @@
  */
 
 #include <errno.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <sys/stat.h>
 
 #include <gossip.h>
+#include <gen-locks.h>
 
 #include <lmdb.h>
 
@@ -18,14 +20,30 @@
 
 extern filesystem_configuration_s *cfg_fs;
 
+/* A read-only transaction kept per thread and reused across gets. It
+ * sits in the reset state between gets so that it pins no snapshot. */
+struct dbpf_db_rdtxn {
+    MDB_txn *txn;
+    struct dbpf_db_rdtxn *next;
+};
+
 struct dbpf_db {
     MDB_env *env;
     MDB_dbi dbi;
+    /* this thread's reusable read transaction */
+    pthread_key_t rdtxn_key;
+    /* this thread's open batch write transaction, if any */
+    pthread_key_t batch_key;
+    /* every read transaction handed out, so they can be freed on close */
+    gen_mutex_t rdtxn_mutex;
+    struct dbpf_db_rdtxn *rdtxns;
 };
 
 struct dbpf_cursor {
     MDB_cursor *cursor;
     MDB_txn *txn;
+    /* false if the cursor borrowed a batch transaction */
+    int own_txn;
 };
 
 static int db_error(int e)
@@ -222,16 +240,155 @@ int dbpf_db_open(char *name, int compare, struct dbpf_db **db,
         return db_error(errno);
     }
 
+    r = pthread_key_create(&(*db)->rdtxn_key, NULL);
+    if (r)
+    {
+        mdb_env_close((*db)->env);
+        free(*db);
+        return db_error(r);
+    }
+    r = pthread_key_create(&(*db)->batch_key, NULL);
+    if (r)
+    {
+        pthread_key_delete((*db)->rdtxn_key);
+        mdb_env_close((*db)->env);
+        free(*db);
+        return db_error(r);
+    }
+    gen_mutex_init(&(*db)->rdtxn_mutex);
+    (*db)->rdtxns = NULL;
+
     return 0;
 }
 
 int dbpf_db_close(struct dbpf_db *db)
 {
+    struct dbpf_db_rdtxn *rdtxn;
+
+    /* the read transactions are all reset, so no thread is using them */
+    while (db->rdtxns)
+    {
+        rdtxn = db->rdtxns;
+        db->rdtxns = rdtxn->next;
+        mdb_txn_abort(rdtxn->txn);
+        free(rdtxn);
+    }
+    gen_mutex_destroy(&db->rdtxn_mutex);
+    pthread_key_delete(db->batch_key);
+    pthread_key_delete(db->rdtxn_key);
+
     mdb_env_close(db->env);
     free(db);
     return 0;
 }
 
+/* Return this thread's read transaction for *db*, renewed and ready to
+ * use, creating it on the first call from a thread. */
+static int rdtxn_get(struct dbpf_db *db, MDB_txn **txn)
+{
+    struct dbpf_db_rdtxn *rdtxn;
+    int r;
+
+    rdtxn = pthread_getspecific(db->rdtxn_key);
+    if (rdtxn)
+    {
+        *txn = rdtxn->txn;
+        return mdb_txn_renew(rdtxn->txn);
+    }
+
+    rdtxn = malloc(sizeof *rdtxn);
+    if (!rdtxn)
+    {
+        return ENOMEM;
+    }
+    r = mdb_txn_begin(db->env, NULL, MDB_RDONLY, &rdtxn->txn);
+    if (r)
+    {
+        free(rdtxn);
+        return r;
+    }
+    r = pthread_setspecific(db->rdtxn_key, rdtxn);
+    if (r)
+    {
+        mdb_txn_abort(rdtxn->txn);
+        free(rdtxn);
+        return r;
+    }
+
+    gen_mutex_lock(&db->rdtxn_mutex);
+    rdtxn->next = db->rdtxns;
+    db->rdtxns = rdtxn;
+    gen_mutex_unlock(&db->rdtxn_mutex);
+
+    *txn = rdtxn->txn;
+    return 0;
+}
+
+/* Begin a write transaction for a single update, or return the batch
+ * transaction if this thread has one open. */
+static int wrtxn_begin(struct dbpf_db *db, MDB_txn **txn)
+{
+    *txn = pthread_getspecific(db->batch_key);
+    if (*txn)
+    {
+        return 0;
+    }
+    return mdb_txn_begin(db->env, NULL, 0, txn);
+}
+
+/* Finish a transaction from wrtxn_begin. Batch transactions are left
+ * open for dbpf_db_batch_commit, even after a failed update, since
+ * LMDB leaves the transaction usable when an individual put fails. */
+static int wrtxn_end(struct dbpf_db *db, MDB_txn *txn, int r)
+{
+    if (txn == pthread_getspecific(db->batch_key))
+    {
+        return r;
+    }
+    if (r)
+    {
+        mdb_txn_abort(txn);
+        return r;
+    }
+    return mdb_txn_commit(txn);
+}
+
+int dbpf_db_batch_begin(struct dbpf_db *db)
+{
+    MDB_txn *txn;
+    int r;
+
+    if (pthread_getspecific(db->batch_key))
+    {
+        return 0;
+    }
+    r = mdb_txn_begin(db->env, NULL, 0, &txn);
+    if (r)
+    {
+        return db_error(r);
+    }
+    r = pthread_setspecific(db->batch_key, txn);
+    if (r)
+    {
+        mdb_txn_abort(txn);
+        return db_error(r);
+    }
+    return 0;
+}
+
+int dbpf_db_batch_commit(struct dbpf_db *db)
+{
+    MDB_txn *txn;
+
+    txn = pthread_getspecific(db->batch_key);
+    if (!txn)
+    {
+        return 0;
+    }
+    pthread_setspecific(db->batch_key, NULL);
+    return db_error(mdb_txn_commit(txn));
+}
+
 int dbpf_db_sync(struct dbpf_db *db)
 {
     return db_error(mdb_env_sync(db->env, 0));
@@ -247,26 +404,38 @@ int dbpf_db_get(struct dbpf_db *db, struct dbpf_data *key,
     db_key.mv_size = key->len;
     db_key.mv_data = key->data;
 
-    r = mdb_txn_begin(db->env, NULL, MDB_RDONLY, &txn);
-    if (r)
+    /* read our own uncommitted updates if a batch is open */
+    txn = pthread_getspecific(db->batch_key);
+    if (txn)
     {
-        return db_error(r);
+        r = mdb_get(txn, db->dbi, &db_key, &db_data);
+        if (r)
+        {
+            return db_error(r);
+        }
+        memcpy(val->data, db_data.mv_data,
+               (db_data.mv_size < val->len) ? db_data.mv_size : val->len);
+        val->len = db_data.mv_size;
+        return 0;
     }
-    r = mdb_get(txn, db->dbi, &db_key, &db_data);
+
+    r = rdtxn_get(db, &txn);
     if (r)
     {
-        mdb_txn_abort(txn);
         return db_error(r);
     }
-    r = mdb_txn_commit(txn);
-    if (r)
+    r = mdb_get(txn, db->dbi, &db_key, &db_data);
+    if (!r)
     {
-        return db_error(r);
+        /* the data lives in the map only until the reset; values may be
+         * shorter than the buffer
+         */
+        memcpy(val->data, db_data.mv_data,
+               (db_data.mv_size < val->len) ? db_data.mv_size : val->len);
+        val->len = db_data.mv_size;
     }
-
-    memcpy(val->data, db_data.mv_data, val->len);
-    val->len = db_data.mv_size;
-    return 0;
+    mdb_txn_reset(txn);
+    return db_error(r);
 }
 
 int dbpf_db_put(struct dbpf_db *db, struct dbpf_data *key,
@@ -281,23 +450,13 @@ int dbpf_db_put(struct dbpf_db *db, struct dbpf_data *key,
     db_data.mv_size = val->len;
     db_data.mv_data = val->data;
 
-    r = mdb_txn_begin(db->env, NULL, 0, &txn);
+    r = wrtxn_begin(db, &txn);
     if (r)
     {
         return db_error(r);
     }
     r = mdb_put(txn, db->dbi, &db_key, &db_data, 0);
-    if (r)
-    {
-        mdb_txn_abort(txn);
-        return db_error(r);
-    }
-    r = mdb_txn_commit(txn);
-    if (r)
-    {
-        return db_error(r);
-    }
-    return 0;
+    return db_error(wrtxn_end(db, txn, r));
 }
 
 int dbpf_db_putonce(struct dbpf_db *db, struct dbpf_data *key,
@@ -312,23 +471,13 @@ int dbpf_db_putonce(struct dbpf_db *db, struct dbpf_data *key,
     db_data.mv_size = val->len;
     db_data.mv_data = val->data;
 
-    r = mdb_txn_begin(db->env, NULL, 0, &txn);
+    r = wrtxn_begin(db, &txn);
     if (r)
     {
         return db_error(r);
     }
     r = mdb_put(txn, db->dbi, &db_key, &db_data, MDB_NOOVERWRITE);
-    if (r)
-    {
-        mdb_txn_abort(txn);
-        return db_error(r);
-    }
-    r = mdb_txn_commit(txn);
-    if (r)
-    {
-        return db_error(r);
-    }
-    return 0;
+    return db_error(wrtxn_end(db, txn, r));
 }
 
 int dbpf_db_del(struct dbpf_db *db, struct dbpf_data *key)
@@ -340,23 +489,13 @@ int dbpf_db_del(struct dbpf_db *db, struct dbpf_data *key)
     db_key.mv_size = key->len;
     db_key.mv_data = key->data;
 
-    r = mdb_txn_begin(db->env, NULL, 0, &txn);
+    r = wrtxn_begin(db, &txn);
     if (r)
     {
         return db_error(r);
     }
     r = mdb_del(txn, db->dbi, &db_key, NULL);
-    if (r)
-    {
-        mdb_txn_abort(txn);
-        return db_error(r);
-    }
-    r = mdb_txn_commit(txn);
-    if (r)
-    {
-        return db_error(r);
-    }
-    return 0;
+    return db_error(wrtxn_end(db, txn, r));
 }
 
 int dbpf_db_cursor(struct dbpf_db *db, struct dbpf_cursor **dbc, int rdonly)
@@ -368,16 +507,27 @@ int dbpf_db_cursor(struct dbpf_db *db, struct dbpf_cursor **dbc, int rdonly)
         return db_error(errno);
     }
 
-    r = mdb_txn_begin(db->env, NULL, rdonly ? MDB_RDONLY : 0, &(*dbc)->txn);
-    if (r)
+    /* a second write transaction from this thread would deadlock on
+     * an open batch, so the cursor runs inside it instead */
+    (*dbc)->txn = pthread_getspecific(db->batch_key);
+    (*dbc)->own_txn = ((*dbc)->txn == NULL);
+    if ((*dbc)->own_txn)
     {
-        free(*dbc);
-        return db_error(r);
+        r = mdb_txn_begin(db->env, NULL, rdonly ? MDB_RDONLY : 0,
+                &(*dbc)->txn);
+        if (r)
+        {
+            free(*dbc);
+            return db_error(r);
+        }
     }
     r = mdb_cursor_open((*dbc)->txn, db->dbi, &(*dbc)->cursor);
     if (r)
     {
-        mdb_txn_abort((*dbc)->txn);
+        if ((*dbc)->own_txn)
+        {
+            mdb_txn_abort((*dbc)->txn);
+        }
         free(*dbc);
         return db_error(r);
     }
@@ -388,6 +538,11 @@ int dbpf_db_cursor_close(struct dbpf_cursor *dbc)
 {
     int r;
     mdb_cursor_close(dbc->cursor);
+    if (!dbc->own_txn)
+    {
+        free(dbc);
+        return 0;
+    }
     r = mdb_txn_commit(dbc->txn);
     if (r)
     {
@@ -64,6 +64,18 @@ int dbpf_db_putonce(dbpf_db *, struct dbpf_data *, struct dbpf_data *);
 /* dbpf_db_del(db, key): Remove value for *key* in *db*. */
 int dbpf_db_del(dbpf_db *, struct dbpf_data *);
 
+/* dbpf_db_batch_begin(db): Group the following puts, putonces, and
+ * dels made by the calling thread on *db* into one transaction. Gets
+ * and cursors from the same thread see the uncommitted updates; other
+ * threads do not see them until dbpf_db_batch_commit. Beginning a batch
+ * that is already open does nothing. Backends without transactions may
+ * treat this as a no-op. */
+int dbpf_db_batch_begin(dbpf_db *);
+
+/* dbpf_db_batch_commit(db): Commit the batch the calling thread has
+ * open on *db*, if any. */
+int dbpf_db_batch_commit(dbpf_db *);
+
 /* dbpf_db_cursor(db, dbc, rdonly): Open the cursor *dbc* on database
  * *db* which is read-only if *rdonly*. */
 int dbpf_db_cursor(dbpf_db *, dbpf_cursor **, int);
@@ -31,6 +31,7 @@
 #include "dbpf-op-queue.h"
 #include "dbpf-attr-cache.h"
 #include "dbpf-open-cache.h"
+#include "dbpf-bstream-packed.h"
 
 #define TROVE_DEFAULT_DB_PAGESIZE 512
 
@@ -538,6 +539,8 @@ static int remove_one_handle(TROVE_object_ref ref,
      * error if this fails (may not have ever been created)
      */
     ret = dbpf_open_cache_remove(coll_p->coll_id, ref.handle);
+    /* or give back its container extent if it was packed */
+    ret = dbpf_bstream_packed_remove(coll_p, ref.handle);
 
     /* remove the keyval entries for this handle if any exist.
      * this way seems a bit messy to me, i.e. we're operating
@@ -0,0 +1,733 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* io_uring based implementation of the dbpf_aio_ops interface.
+ *
+ * All bstream list I/O for collections using the "io-uring" TroveMethod
+ * is funneled into a single process wide submission ring.  Each call to
+ * lio_listio() becomes one batch; every aiocb in the batch becomes one
+ * readv/writev SQE.  A dedicated reaper thread waits on the completion
+ * ring, fills in the aiocb error/return fields and fires the batch's
+ * sigevent callback once the last member completes, exactly as the
+ * alt-aio master thread does.
+ *
+ * The number of SQEs in flight is capped at the completion ring size so
+ * that the CQ can never overflow.  Batches that do not fit are parked on
+ * a pending list and submitted by the reaper as completions free up
+ * room, which means lio_listio() never blocks (the reaper itself issues
+ * new lio_listio() calls from inside completion callbacks).
+ *
+ * If the kernel (or the build environment) does not provide io_uring,
+ * the method transparently falls back to the alt-aio implementation.
+ */
+
+#include "pvfs2-internal.h"
+#include "quicklist.h"
+#include "dbpf-alt-aio.h"
+#include "dbpf-iouring-aio.h"
+#include "gen-locks.h"
+#include "dbpf.h"
+#include <string.h>
+
+#ifdef HAVE_IO_URING
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+/* number of submission queue entries requested from the kernel */
+#define IOURING_AIO_QUEUE_DEPTH 256
+
+struct iouring_aio_batch;
+
+struct iouring_aio_item
+{
+    struct aiocb *cb_p;
+    struct iovec iov;
+    struct iouring_aio_batch *batch;
+};
+
+struct iouring_aio_batch
+{
+    struct sigevent *sig;
+    struct qlist_head list_link;
+    int nent;
+    int next_submit;      /* index of the first item not yet queued */
+    int remaining;        /* items queued or pending but not completed */
+    struct iouring_aio_item items[1];
+};
+
+struct iouring_aio_ring
+{
+    int fd;
+    unsigned sq_entries;
+    unsigned cq_entries;
+
+    void *sq_ptr;
+    size_t sq_map_size;
+    void *cq_ptr;
+    size_t cq_map_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_map_size;
+
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    unsigned inflight;
+    int shutdown;
+    pthread_t reaper;
+    struct qlist_head pending;
+};
+
+enum
+{
+    IOURING_AIO_UNINITIALIZED = 0,
+    IOURING_AIO_RUNNING,
+    IOURING_AIO_UNAVAILABLE
+};
+
+static gen_mutex_t iouring_aio_mutex = GEN_MUTEX_INITIALIZER;
+static int iouring_aio_state = IOURING_AIO_UNINITIALIZED;
+static struct iouring_aio_ring iouring_ring;
+
+static int iouring_aio_start(void);
+static void *iouring_aio_reaper(void *arg);
+static void iouring_aio_submit_pending_locked(void);
+static int iouring_lio_listio(int mode, struct aiocb * const list[],
+                              int nent, struct sigevent *sig);
+static int iouring_aio_error(const struct aiocb *aiocbp);
+static ssize_t iouring_aio_return(struct aiocb *aiocbp);
+static int iouring_aio_cancel(int filedesc, struct aiocb * aiocbp);
+static int iouring_aio_suspend(const struct aiocb * const list[], int nent,
+                               const struct timespec * timeout);
+static int iouring_aio_read(struct aiocb * aiocbp);
+static int iouring_aio_write(struct aiocb * aiocbp);
+static int iouring_aio_fsync(int operation, struct aiocb * aiocbp);
+
+static struct dbpf_aio_ops iouring_aio_ops;
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit,
+                              unsigned min_complete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+                        flags, NULL, 0);
+}
+
+static void iouring_aio_set_result(struct aiocb *cb_p, int error, ssize_t ret)
+{
+#ifdef HAVE_AIOCB_ERROR_CODE
+    cb_p->__error_code = error;
+#endif
+#ifdef HAVE_AIOCB_RETURN_VALUE
+    cb_p->__return_value = ret;
+#endif
+}
+
+static void iouring_aio_unmap(struct iouring_aio_ring *ring)
+{
+    if(ring->sqes)
+    {
+        munmap(ring->sqes, ring->sqes_map_size);
+    }
+    if(ring->cq_ptr && ring->cq_ptr != ring->sq_ptr)
+    {
+        munmap(ring->cq_ptr, ring->cq_map_size);
+    }
+    if(ring->sq_ptr)
+    {
+        munmap(ring->sq_ptr, ring->sq_map_size);
+    }
+    if(ring->fd >= 0)
+    {
+        close(ring->fd);
+    }
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+/* iouring_aio_start()
+ *
+ * Sets up the ring and starts the reaper thread.  Must be called with
+ * iouring_aio_mutex held.  Returns 0 on success, -1 if io_uring is not
+ * usable on this system.
+ */
+static int iouring_aio_start(void)
+{
+    struct io_uring_params params;
+    struct iouring_aio_ring *ring = &iouring_ring;
+    char *sq, *cq;
+    int ret;
+
+    memset(ring, 0, sizeof(*ring));
+    memset(&params, 0, sizeof(params));
+    INIT_QLIST_HEAD(&ring->pending);
+
+    ring->fd = sys_io_uring_setup(IOURING_AIO_QUEUE_DEPTH, &params);
+    if(ring->fd < 0)
+    {
+        gossip_err("%s: io_uring_setup failed: %s; falling back to "
+                   "alt-aio\n", __func__, strerror(errno));
+        ring->fd = -1;
+        return -1;
+    }
+
+    ring->sq_entries = params.sq_entries;
+    ring->cq_entries = params.cq_entries;
+    ring->sq_map_size = params.sq_off.array +
+        params.sq_entries * sizeof(unsigned);
+    ring->cq_map_size = params.cq_off.cqes +
+        params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_map_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+#ifdef IORING_FEAT_SINGLE_MMAP
+    if(params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if(ring->cq_map_size > ring->sq_map_size)
+        {
+            ring->sq_map_size = ring->cq_map_size;
+        }
+        ring->cq_map_size = ring->sq_map_size;
+    }
+#endif
+
+    ring->sq_ptr = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring->fd,
+                        IORING_OFF_SQ_RING);
+    if(ring->sq_ptr == MAP_FAILED)
+    {
+        ring->sq_ptr = NULL;
+        goto map_failed;
+    }
+
+#ifdef IORING_FEAT_SINGLE_MMAP
+    if(params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        ring->cq_ptr = ring->sq_ptr;
+    }
+    else
+#endif
+    {
+        ring->cq_ptr = mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, ring->fd,
+                            IORING_OFF_CQ_RING);
+        if(ring->cq_ptr == MAP_FAILED)
+        {
+            ring->cq_ptr = NULL;
+            goto map_failed;
+        }
+    }
+
+    ring->sqes = mmap(NULL, ring->sqes_map_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if(ring->sqes == MAP_FAILED)
+    {
+        ring->sqes = NULL;
+        goto map_failed;
+    }
+
+    sq = (char *)ring->sq_ptr;
+    cq = (char *)ring->cq_ptr;
+    ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    ret = pthread_create(&ring->reaper, NULL, iouring_aio_reaper, ring);
+    if(ret != 0)
+    {
+        gossip_err("%s: pthread_create failed: %s\n", __func__,
+                   strerror(ret));
+        iouring_aio_unmap(ring);
+        return -1;
+    }
+
+    gossip_debug(GOSSIP_BSTREAM_DEBUG, "[iouring-aio]: ring ready: "
+                 "sq_entries: %u, cq_entries: %u\n",
+                 ring->sq_entries, ring->cq_entries);
+    return 0;
+
+map_failed:
+    gossip_err("%s: mmap of io_uring rings failed: %s; falling back to "
+               "alt-aio\n", __func__, strerror(errno));
+    iouring_aio_unmap(ring);
+    return -1;
+}
+
+/* iouring_aio_available()
+ *
+ * Lazily brings up the ring on first use.  Returns 1 if io_uring can be
+ * used, 0 if callers should fall back to alt-aio.
+ */
+static int iouring_aio_available(void)
+{
+    int state;
+
+    gen_mutex_lock(&iouring_aio_mutex);
+    if(iouring_aio_state == IOURING_AIO_UNINITIALIZED)
+    {
+        iouring_aio_state = (iouring_aio_start() == 0) ?
+            IOURING_AIO_RUNNING : IOURING_AIO_UNAVAILABLE;
+    }
+    state = iouring_aio_state;
+    gen_mutex_unlock(&iouring_aio_mutex);
+
+    return (state == IOURING_AIO_RUNNING);
+}
+
+/* iouring_aio_submit_pending_locked()
+ *
+ * Moves as many pending items as the rings allow into the SQ and hands
+ * them to the kernel.  Must be called with iouring_aio_mutex held.
+ */
+static void iouring_aio_submit_pending_locked(void)
+{
+    struct iouring_aio_ring *ring = &iouring_ring;
+    struct iouring_aio_batch *batch;
+    struct iouring_aio_item *item;
+    struct io_uring_sqe *sqe;
+    unsigned tail, head, index, to_submit;
+    int ret;
+
+    tail = *ring->sq_tail;
+    while(!qlist_empty(&ring->pending))
+    {
+        batch = qlist_entry(ring->pending.next,
+                            struct iouring_aio_batch, list_link);
+
+        while(batch->next_submit < batch->nent)
+        {
+            head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+            if((tail - head) >= ring->sq_entries ||
+               ring->inflight >= ring->cq_entries)
+            {
+                goto flush;
+            }
+
+            item = &batch->items[batch->next_submit++];
+            index = tail & *ring->sq_mask;
+            sqe = &ring->sqes[index];
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = (item->cb_p->aio_lio_opcode == LIO_READ) ?
+                IORING_OP_READV : IORING_OP_WRITEV;
+            sqe->fd = item->cb_p->aio_fildes;
+            sqe->off = item->cb_p->aio_offset;
+            sqe->addr = (uint64_t)(uintptr_t)&item->iov;
+            sqe->len = 1;
+            sqe->user_data = (uint64_t)(uintptr_t)item;
+            ring->sq_array[index] = index;
+            tail++;
+            ring->inflight++;
+        }
+        qlist_del(&batch->list_link);
+    }
+
+flush:
+    __atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+
+    head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    to_submit = tail - head;
+    while(to_submit > 0)
+    {
+        ret = sys_io_uring_enter(ring->fd, to_submit, 0, 0);
+        if(ret < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            /* the entries stay in the SQ; the next enter retries them */
+            gossip_err("%s: io_uring_enter failed: %s\n", __func__,
+                       strerror(errno));
+            break;
+        }
+        to_submit -= ret;
+    }
+}
+
+static void *iouring_aio_reaper(void *arg)
+{
+    struct iouring_aio_ring *ring = (struct iouring_aio_ring *)arg;
+    struct iouring_aio_item *item;
+    struct iouring_aio_batch *batch;
+    struct io_uring_cqe *cqe;
+    struct qlist_head done;
+    unsigned head, tail;
+    int ret, exiting = 0;
+
+    while(!exiting)
+    {
+        ret = sys_io_uring_enter(ring->fd, 0, 1, IORING_ENTER_GETEVENTS);
+        if(ret < 0 && errno != EINTR)
+        {
+            gossip_err("%s: io_uring_enter failed: %s\n", __func__,
+                       strerror(errno));
+        }
+
+        INIT_QLIST_HEAD(&done);
+        gen_mutex_lock(&iouring_aio_mutex);
+
+        head = *ring->cq_head;
+        tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        while(head != tail)
+        {
+            cqe = &ring->cqes[head & *ring->cq_mask];
+            item = (struct iouring_aio_item *)(uintptr_t)cqe->user_data;
+            head++;
+
+            if(!item)
+            {
+                /* shutdown token posted by dbpf_iouring_aio_finalize */
+                exiting = 1;
+                continue;
+            }
+
+            ring->inflight--;
+            if(cqe->res < 0)
+            {
+                iouring_aio_set_result(item->cb_p, -cqe->res, -1);
+            }
+            else
+            {
+                iouring_aio_set_result(item->cb_p, 0, cqe->res);
+            }
+
+            batch = item->batch;
+            if(--batch->remaining == 0)
+            {
+                qlist_add_tail(&batch->list_link, &done);
+            }
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+        if(!ring->shutdown)
+        {
+            iouring_aio_submit_pending_locked();
+        }
+        gen_mutex_unlock(&iouring_aio_mutex);
+
+        /* callbacks may post more I/O, so run them without the lock */
+        while(!qlist_empty(&done))
+        {
+            batch = qlist_entry(done.next, struct iouring_aio_batch,
+                                list_link);
+            qlist_del(&batch->list_link);
+            batch->sig->sigev_notify_function(batch->sig->sigev_value);
+            free(batch);
+        }
+    }
+
+    return NULL;
+}
+
+void dbpf_iouring_aio_finalize(void)
+{
+    struct iouring_aio_ring *ring = &iouring_ring;
+    struct io_uring_sqe *sqe;
+    unsigned tail, index;
+
+    gen_mutex_lock(&iouring_aio_mutex);
+    if(iouring_aio_state != IOURING_AIO_RUNNING)
+    {
+        iouring_aio_state = IOURING_AIO_UNINITIALIZED;
+        gen_mutex_unlock(&iouring_aio_mutex);
+        return;
+    }
+
+    ring->shutdown = 1;
+    if(!qlist_empty(&ring->pending))
+    {
+        gossip_err("%s: shutting down with unsubmitted bstream I/O\n",
+                   __func__);
+    }
+
+    /* wake the reaper with a NOP whose user_data marks the shutdown */
+    tail = *ring->sq_tail;
+    index = tail & *ring->sq_mask;
+    sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_NOP;
+    sqe->user_data = 0;
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    while(sys_io_uring_enter(ring->fd, 1, 0, 0) < 0 && errno == EINTR)
+    {
+        ;
+    }
+    gen_mutex_unlock(&iouring_aio_mutex);
+
+    pthread_join(ring->reaper, NULL);
+
+    gen_mutex_lock(&iouring_aio_mutex);
+    iouring_aio_unmap(ring);
+    iouring_aio_state = IOURING_AIO_UNINITIALIZED;
+    gen_mutex_unlock(&iouring_aio_mutex);
+}
+
+static int iouring_lio_listio(int mode, struct aiocb * const list[],
+                              int nent, struct sigevent *sig)
+{
+    struct iouring_aio_batch *batch;
+    struct iouring_aio_item *item;
+    int i, count = 0;
+    ssize_t ret;
+
+    if(mode == LIO_WAIT)
+    {
+        /* nobody in dbpf asks for this; keep it simple and synchronous */
+        for(i = 0; i < nent; ++i)
+        {
+            if(list[i]->aio_lio_opcode == LIO_READ)
+            {
+                ret = pread(list[i]->aio_fildes, (void *)list[i]->aio_buf,
+                            list[i]->aio_nbytes, list[i]->aio_offset);
+            }
+            else
+            {
+                ret = pwrite(list[i]->aio_fildes,
+                             (const void *)list[i]->aio_buf,
+                             list[i]->aio_nbytes, list[i]->aio_offset);
+            }
+            iouring_aio_set_result(list[i], (ret < 0) ? errno : 0, ret);
+        }
+        return 0;
+    }
+
+    batch = (struct iouring_aio_batch *)malloc(
+        sizeof(struct iouring_aio_batch) +
+        (nent - 1) * sizeof(struct iouring_aio_item));
+    if(!batch)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+    memset(batch, 0, sizeof(struct iouring_aio_batch));
+    batch->sig = sig;
+
+    for(i = 0; i < nent; ++i)
+    {
+        if(list[i]->aio_lio_opcode != LIO_READ &&
+           list[i]->aio_lio_opcode != LIO_WRITE)
+        {
+            continue;
+        }
+
+        item = &batch->items[count++];
+        item->cb_p = list[i];
+        item->iov.iov_base = (void *)list[i]->aio_buf;
+        item->iov.iov_len = list[i]->aio_nbytes;
+        item->batch = batch;
+
+        iouring_aio_set_result(item->cb_p, EINPROGRESS, 0);
+
+        gossip_debug(GOSSIP_BSTREAM_DEBUG,
+                     "[iouring-aio]: %s: cb_p: %p, fd: %d, bufp: %p, "
+                     "size: %zd off:%llu\n",
+                     (list[i]->aio_lio_opcode == LIO_READ) ?
+                     "read" : "write",
+                     list[i], list[i]->aio_fildes, list[i]->aio_buf,
+                     list[i]->aio_nbytes, llu(list[i]->aio_offset));
+    }
+    batch->nent = count;
+    batch->remaining = count;
+
+    if(count == 0)
+    {
+        free(batch);
+        sig->sigev_notify_function(sig->sigev_value);
+        return 0;
+    }
+
+    gen_mutex_lock(&iouring_aio_mutex);
+    qlist_add_tail(&batch->list_link, &iouring_ring.pending);
+    iouring_aio_submit_pending_locked();
+    gen_mutex_unlock(&iouring_aio_mutex);
+
+    return 0;
+}
+
+static int iouring_aio_error(const struct aiocb *aiocbp)
+{
+#ifdef HAVE_AIOCB_ERROR_CODE
+    return aiocbp->__error_code;
+#else
+    return 0;
+#endif
+}
+
+static ssize_t iouring_aio_return(struct aiocb *aiocbp)
+{
+#ifdef HAVE_AIOCB_RETURN_VALUE
+    return aiocbp->__return_value;
+#else
+    return 0;
+#endif
+}
+
+static int iouring_aio_cancel(int filedesc, struct aiocb *aiocbp)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+static int iouring_aio_suspend(const struct aiocb * const list[], int nent,
+                               const struct timespec * timeout)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+static int iouring_aio_read(struct aiocb * aiocbp)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+static int iouring_aio_write(struct aiocb * aiocbp)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+static int iouring_aio_fsync(int operation, struct aiocb * aiocbp)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+static struct dbpf_aio_ops iouring_aio_ops =
+{
+    iouring_aio_read,
+    iouring_aio_write,
+    iouring_lio_listio,
+    iouring_aio_error,
+    iouring_aio_return,
+    iouring_aio_cancel,
+    iouring_aio_suspend,
+    iouring_aio_fsync
+};
+
+#define IOURING_AIO_OPS \
+    (iouring_aio_available() ? &iouring_aio_ops : &alt_aio_ops)
+
+#else /* !HAVE_IO_URING */
+
+void dbpf_iouring_aio_finalize(void)
+{
+}
+
+#define IOURING_AIO_OPS (&alt_aio_ops)
+
+#endif /* HAVE_IO_URING */
+
+static int iouring_aio_bstream_read_list(TROVE_coll_id coll_id,
+                                         TROVE_handle handle,
+                                         char **mem_offset_array,
+                                         TROVE_size *mem_size_array,
+                                         int mem_count,
+                                         TROVE_offset *stream_offset_array,
+                                         TROVE_size *stream_size_array,
+                                         int stream_count,
+                                         TROVE_size *out_size_p,
+                                         TROVE_ds_flags flags,
+                                         TROVE_vtag_s *vtag,
+                                         void *user_ptr,
+                                         TROVE_context_id context_id,
+                                         TROVE_op_id *out_op_id_p,
+                                         PVFS_hint  hints)
+{
+    return dbpf_bstream_rw_list(coll_id,
+                                handle,
+                                mem_offset_array,
+                                mem_size_array,
+                                mem_count,
+                                stream_offset_array,
+                                stream_size_array,
+                                stream_count,
+                                out_size_p,
+                                flags,
+                                vtag,
+                                user_ptr,
+                                context_id,
+                                out_op_id_p,
+                                LIO_READ,
+                                IOURING_AIO_OPS,
+                                hints);
+}
+
+static int iouring_aio_bstream_write_list(TROVE_coll_id coll_id,
+                                          TROVE_handle handle,
+                                          char **mem_offset_array,
+                                          TROVE_size *mem_size_array,
+                                          int mem_count,
+                                          TROVE_offset *stream_offset_array,
+                                          TROVE_size *stream_size_array,
+                                          int stream_count,
+                                          TROVE_size *out_size_p,
+                                          TROVE_ds_flags flags,
+                                          TROVE_vtag_s *vtag,
+                                          void *user_ptr,
+                                          TROVE_context_id context_id,
+                                          TROVE_op_id *out_op_id_p,
+                                          PVFS_hint  hints)
+{
+    return dbpf_bstream_rw_list(coll_id,
+                                handle,
+                                mem_offset_array,
+                                mem_size_array,
+                                mem_count,
+                                stream_offset_array,
+                                stream_size_array,
+                                stream_count,
+                                out_size_p,
+                                flags,
+                                vtag,
+                                user_ptr,
+                                context_id,
+                                out_op_id_p,
+                                LIO_WRITE,
+                                IOURING_AIO_OPS,
+                                hints);
+}
+
+struct TROVE_bstream_ops iouring_aio_bstream_ops =
+{
+    dbpf_bstream_read_at,
+    dbpf_bstream_write_at,
+    dbpf_bstream_resize,
+    dbpf_bstream_validate,
+    iouring_aio_bstream_read_list,
+    iouring_aio_bstream_write_list,
+    dbpf_bstream_flush,
+    NULL,
+    dbpf_bstream_get_fd,
+    dbpf_bstream_put_fd
+};
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,32 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+#ifndef __DBPF_IOURING_AIO_H__
+#define __DBPF_IOURING_AIO_H__
+
+#include "trove-internal.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* tears down the shared submission/completion ring, if one was set up */
+void dbpf_iouring_aio_finalize(void);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
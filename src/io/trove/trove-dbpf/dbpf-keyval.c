@@ -41,6 +41,8 @@
  * the new layout of the position token.
  */
 static uint16_t readdir_session = 0;
+/* iterates may be serviced by several threads at once */
+static gen_mutex_t readdir_session_mutex = GEN_MUTEX_INITIALIZER;
 
 extern int synccount;
 
@@ -851,9 +853,11 @@ static int dbpf_keyval_iterate_op_svc(struct dbpf_op *op_p)
         {
             *op_p->u.k_iterate.position_p = count-1;
             /* store a session identifier in the second 16 bits */
+            gen_mutex_lock(&readdir_session_mutex);
             tmp_pos += readdir_session;
-            *op_p->u.k_iterate.position_p += (tmp_pos << 32);
             readdir_session++;
+            gen_mutex_unlock(&readdir_session_mutex);
+            *op_p->u.k_iterate.position_p += (tmp_pos << 32);
         }
         else
         {
@@ -39,8 +39,10 @@
 #include "trove-handle-mgmt.h"
 #include "gossip.h"
 #include "dbpf-open-cache.h"
+#include "dbpf-bstream-packed.h"
 #include "pint-util.h"
 #include "dbpf-sync.h"
+#include "dbpf-iouring-aio.h"
 
 #include "server-config.h"
 
@@ -248,6 +250,22 @@ int dbpf_collection_setinfo(TROVE_method_id method_id,
             coll->immediate_completion = *(int *)parameter;
             ret = 0;
             break;
+        case TROVE_COLLECTION_PACKED_BSTREAM_SIZE:
+            gossip_debug(GOSSIP_TROVE_DEBUG, 
+                         "dbpf collection %d - Setting packed bstream "
+                         "size to %d\n",
+                         (int) coll_id, *(int *)parameter);
+            assert(coll);
+            ret = dbpf_bstream_packed_initialize(coll, *(int *)parameter);
+            break;
+        case TROVE_COLLECTION_INLINE_BSTREAM_SIZE:
+            gossip_debug(GOSSIP_TROVE_DEBUG, 
+                         "dbpf collection %d - Setting inline bstream "
+                         "size to %d\n",
+                         (int) coll_id, *(int *)parameter);
+            assert(coll);
+            ret = dbpf_bstream_packed_set_inline(coll, *(int *)parameter);
+            break;
         case TROVE_DIRECTIO_THREADS_NUM:
             trove_directio_threads_num = *(int *)parameter;
             ret = 0;
@@ -541,6 +559,12 @@ static int dbpf_initialize(char *data_path,
 
     my_storage_p = sto_p;
 
+    ret = dbpf_queued_op_cache_initialize();
+    if (ret < 0)
+    {
+        return ret;
+    }
+
     dbpf_open_cache_initialize();
 
     return dbpf_thread_initialize();
@@ -659,7 +683,9 @@ int dbpf_finalize(void)
     int ret = -TROVE_EINVAL;
 
     dbpf_thread_finalize();
+    dbpf_iouring_aio_finalize();
     dbpf_open_cache_finalize();
+    dbpf_queued_op_cache_finalize();
     gen_mutex_lock(&dbpf_attr_cache_mutex);
     dbpf_attr_cache_finalize();
     gen_mutex_unlock(&dbpf_attr_cache_mutex);
@@ -1375,6 +1401,114 @@ return_error:
     return ret;
 }
 
+/* dbpf_collection_handle_ledger_save()
+ *
+ * stores the handle ledger of the collection, prefixed with its
+ * length, in the collection attribute db so that the next start can
+ * skip the handle scan.  nothing is saved if the scan never finished.
+ */
+static void dbpf_collection_handle_ledger_save(
+    struct dbpf_collection *coll_p)
+{
+    struct dbpf_data key, data;
+    void *buf = NULL;
+    char *value = NULL;
+    uint64_t len = 0;
+    int buf_len = 0, ret;
+
+    ret = trove_handle_get_checkpoint(coll_p->coll_id, &buf, &buf_len);
+    if (ret < 0)
+    {
+        gossip_debug(GOSSIP_TROVE_DEBUG, "not saving handle ledger of "
+                     "collection %d: %d\n", (int)coll_p->coll_id, ret);
+        return;
+    }
+
+    len = buf_len;
+    value = malloc(sizeof(len) + len);
+    if (!value)
+    {
+        free(buf);
+        return;
+    }
+    memcpy(value, &len, sizeof(len));
+    memcpy(value + sizeof(len), buf, len);
+    free(buf);
+
+    key.data = TROVE_DBPF_HANDLE_LEDGER_KEY;
+    key.len = strlen(TROVE_DBPF_HANDLE_LEDGER_KEY);
+    data.data = value;
+    data.len = sizeof(len) + len;
+
+    ret = dbpf_db_put(coll_p->coll_attr_db, &key, &data);
+    if (ret != 0)
+    {
+        gossip_err("Failed to save handle ledger: %s\n", strerror(ret));
+    }
+    free(value);
+}
+
+/* dbpf_collection_handle_ledger_load()
+ *
+ * hands a handle ledger saved by dbpf_collection_handle_ledger_save()
+ * to the handle allocator.  the saved copy is removed before it is
+ * used: it is only valid until the collection is modified, so a
+ * server that does not shut down cleanly has to scan again.
+ */
+static void dbpf_collection_handle_ledger_load(
+    struct dbpf_collection *coll_p)
+{
+    struct dbpf_data key, data;
+    char *buf = NULL;
+    uint64_t len = 0;
+    int ret;
+
+    key.data = TROVE_DBPF_HANDLE_LEDGER_KEY;
+    key.len = strlen(TROVE_DBPF_HANDLE_LEDGER_KEY);
+    data.data = &len;
+    data.len = sizeof(len);
+
+    ret = dbpf_db_get(coll_p->coll_attr_db, &key, &data);
+    if (ret != 0)
+    {
+        if (ret != TROVE_ENOENT)
+        {
+            gossip_err("Failed to read saved handle ledger: %s\n",
+                       strerror(ret));
+        }
+        return;
+    }
+
+    if ((data.len == sizeof(len) + len) && (len <= INT32_MAX))
+    {
+        buf = malloc(data.len);
+    }
+    if (buf)
+    {
+        data.data = buf;
+        ret = dbpf_db_get(coll_p->coll_attr_db, &key, &data);
+    }
+
+    if (dbpf_db_del(coll_p->coll_attr_db, &key) != 0 ||
+        dbpf_db_sync(coll_p->coll_attr_db) != 0)
+    {
+        gossip_err("Failed to remove saved handle ledger; "
+                   "not using it\n");
+        free(buf);
+        return;
+    }
+
+    if (buf && (ret == 0))
+    {
+        memmove(buf, buf + sizeof(len), len);
+        trove_handle_load_checkpoint(coll_p->coll_id, buf, (int)len);
+    }
+    else
+    {
+        free(buf);
+    }
+}
+
 static int dbpf_direct_collection_clear(TROVE_coll_id coll_id)
 {
     stop_directio_threads();
@@ -1386,6 +1520,12 @@ int dbpf_collection_clear(TROVE_coll_id coll_id)
     int ret;
     struct dbpf_collection *coll_p = dbpf_collection_find_registered(coll_id);
 
+    /* stops the handle scan, which needs the collection registered */
+    if (coll_p != NULL)
+    {
+        dbpf_collection_handle_ledger_save(coll_p);
+    }
+
     dbpf_collection_deregister(coll_p);
 
     if( coll_p == NULL )
@@ -1431,6 +1571,8 @@ int dbpf_collection_clear(TROVE_coll_id coll_id)
         gossip_lerr("db_close(coll_keyval_db): %s\n", strerror(ret));
     }
 
+    dbpf_bstream_packed_finalize(coll_p);
+
     free(coll_p->name);
     free(coll_p->data_path);
     free(coll_p->meta_path);
@@ -1693,6 +1835,8 @@ int dbpf_collection_lookup(char *collname,
     dbpf_collection_register(coll_p);
     *out_coll_id_p = coll_p->coll_id;
 
+    dbpf_collection_handle_ledger_load(coll_p);
+
     clear_stranded_bstreams(coll_p->coll_id);
 
     return 1;
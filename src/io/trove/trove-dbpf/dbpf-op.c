@@ -11,10 +11,39 @@
 #include "dbpf-op.h"
 #include "dbpf-bstream.h"
 #include "gossip.h"
+#include "pint-slab.h"
+
+/* queued ops are allocated and freed once per trove operation */
+static struct PINT_slab_cache *dbpf_queued_op_cache = NULL;
+
+/* dbpf_queued_op_cache_initialize()
+ *
+ * Sets up the cache that queued ops are allocated from.
+ */
+int dbpf_queued_op_cache_initialize(void)
+{
+    if (dbpf_queued_op_cache)
+    {
+        return 0;
+    }
+    dbpf_queued_op_cache = PINT_slab_create("dbpf_queued_op",
+                                            sizeof(dbpf_queued_op_t));
+    if (!dbpf_queued_op_cache)
+    {
+        return -TROVE_ENOMEM;
+    }
+    return 0;
+}
+
+void dbpf_queued_op_cache_finalize(void)
+{
+    PINT_slab_destroy(dbpf_queued_op_cache);
+    dbpf_queued_op_cache = NULL;
+}
 
 dbpf_queued_op_t *dbpf_queued_op_alloc(void)
 {
-    return (dbpf_queued_op_t *)malloc(sizeof(dbpf_queued_op_t));
+    return (dbpf_queued_op_t *)PINT_slab_alloc(dbpf_queued_op_cache);
 }
 
 /* dbpf_queued_op_init()
@@ -67,7 +96,7 @@ void dbpf_queued_op_free(dbpf_queued_op_t *q_op_p)
             q_op_p->op.u.b_rw_list.aiocb_array = NULL;
         }
     }
-    free(q_op_p);
+    PINT_slab_free(dbpf_queued_op_cache, q_op_p);
 }
 
 /* dbpf_queued_op_touch()
@@ -68,6 +68,9 @@ typedef struct
     struct qlist_head link;
 } dbpf_queued_op_t;
 
+int dbpf_queued_op_cache_initialize(void);
+void dbpf_queued_op_cache_finalize(void);
+
 dbpf_queued_op_t *dbpf_queued_op_alloc(void);
 
 void dbpf_queued_op_init(
@@ -4,16 +4,23 @@
  * See COPYING in top-level directory.
  */
 
-/* LRU style cache for file descriptors */
-/* note that the cache is fixed size.  If we have have more active fd and/or
- * db references than will fit in the cache, then the overflow references
- * will all get new fds that are closed on put
+/* Cache of open file descriptors for bstreams.
+ *
+ * Entries are spread over OPEN_CACHE_SHARDS shards by a hash of the
+ * handle, each with its own mutex, hash table and share of the
+ * TroveOpenCacheSize entries, so lookups on different handles rarely
+ * contend.  Entries stay in their shard's table after the last reference
+ * is put; when a shard needs room for a new handle it evicts an
+ * unreferenced entry chosen by the CLOCK algorithm.  If every entry of a
+ * shard is in use, the overflow reference gets a new fd that is closed
+ * on put.
  */
 
 #define XOPEN_SOURCE 500
 
 #include <unistd.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -29,10 +36,23 @@
 #include "dbpf-bstream.h"
 #include "gossip.h"
 #include "quicklist.h"
+#include "quickhash.h"
 #include "dbpf-open-cache.h"
+#include "pint-perf-counter.h"
 #include "pvfs2-internal.h"
 
-#define OPEN_CACHE_SIZE 64
+/* must be a power of two */
+#define OPEN_CACHE_SHARDS 16
+#define OPEN_CACHE_SHARD_BITS 4
+/* hits and misses are handed to the perf counters in batches of this
+ * many, to keep the perf counter mutex off the I/O path
+ */
+#define OPEN_CACHE_STAT_BATCH 64
+
+/* number of entries over all shards; set by TroveOpenCacheSize */
+extern int TROVE_open_cache_size;
+
+struct open_cache_shard;
 
 struct open_cache_entry
 {
@@ -43,8 +63,40 @@ struct open_cache_entry
     int fd;
     int remove_flag;
     enum open_cache_open_type type;
+    /* set on every reference, cleared as the clock hand passes */
+    int referenced;
+    /* set while the entry is in the shard's hash table */
+    int hashed;
+
+    struct open_cache_shard *shard;
+    struct qhash_head hash_link;
+    struct qlist_head free_link;
+};
+
+struct open_cache_shard
+{
+    gen_mutex_t mutex;
+    struct qhash_table *table;
+    struct open_cache_entry *entries;
+    int entry_count;
+    int clock_hand;
+    /* entries not in the table */
+    struct qlist_head free_list;
+    /* statistics not yet handed to the perf counters */
+    int64_t hits;
+    int64_t misses;
+    /* lifetime statistics, for the debug log */
+    int64_t total_hits;
+    int64_t total_misses;
+    int64_t evictions;
+    int64_t overflows;
+};
 
-    struct qlist_head queue_link;
+struct open_cache_key
+{
+    TROVE_coll_id coll_id;
+    TROVE_handle handle;
+    uint64_t mix;
 };
 
 struct unlink_context
@@ -68,18 +120,10 @@ static int fast_unlink(
     TROVE_coll_id coll_id, 
     TROVE_handle handle);
 
-/* "used_list" is for active objects (ref_ct > 0) */
-static QLIST_HEAD(used_list);
-/* "unused_list" is for inactive objects (ref_ct == 0) that we are still
- * holding open in case someone asks for them again soon
- */
-static QLIST_HEAD(unused_list);
-/* "free_list" is just a list of cache entries that have not been filled in,
- * can be used at any time for new cache entries
+/* NULL if the cache could not be set up; every reference then gets an
+ * fd of its own
  */
-static QLIST_HEAD(free_list);
-static gen_mutex_t cache_mutex = GEN_MUTEX_INITIALIZER;
-static struct open_cache_entry prealloc[OPEN_CACHE_SIZE];
+static struct open_cache_shard *shards = NULL;
 
 static int open_fd(
     int *fd, 
@@ -91,31 +135,207 @@ static void close_fd(
     int fd, 
     enum open_cache_open_type type);
 
-inline static struct open_cache_entry * dbpf_open_cache_find_entry(
-    struct qlist_head * list, 
-    const char * list_name,
+/* open_cache_mix()
+ *
+ * mixes a handle and collection into the bits used to pick a shard and,
+ * above those, a bucket within it
+ */
+static inline uint64_t open_cache_mix(
     TROVE_coll_id coll_id,
-    TROVE_handle handle);
+    TROVE_handle handle)
+{
+    uint64_t key = handle ^ ((uint64_t)(uint32_t)coll_id << 32);
+
+    key = (~key) + (key << 18);
+    key = key ^ (key >> 31);
+    key = key * 21;
+    key = key ^ (key >> 11);
+    key = key + (key << 6);
+    key = key ^ (key >> 22);
+    return key;
+}
 
-void dbpf_open_cache_initialize(void)
+static int open_cache_hash(const void *k, int table_size)
 {
-    int i = 0, ret = 0;
+    const struct open_cache_key *key = k;
+
+    return (int)((key->mix >> OPEN_CACHE_SHARD_BITS) &
+                 (uint64_t)(table_size - 1));
+}
 
-    gen_mutex_lock(&cache_mutex);
+static int open_cache_compare(const void *k, struct qhash_head *link)
+{
+    const struct open_cache_key *key = k;
+    struct open_cache_entry *entry =
+        qhash_entry(link, struct open_cache_entry, hash_link);
 
-    /* initialize prealloc array */
-    memset(&prealloc[0],0,sizeof(struct open_cache_entry)*OPEN_CACHE_SIZE);
+    return (entry->handle == key->handle && entry->coll_id == key->coll_id);
+}
 
-    /* run through preallocated cache elements to initialize
-     * and put them on the free list
-     */
-    for (i = 0; i < OPEN_CACHE_SIZE; i++)
+/* open_cache_count_stats()
+ *
+ * hands a shard's hits and misses to the perf counters once enough have
+ * piled up, or unconditionally if force is set.  Shard mutex must be
+ * held.
+ */
+static void open_cache_count_stats(struct open_cache_shard *shard, int force)
+{
+    if (!force && shard->hits + shard->misses < OPEN_CACHE_STAT_BATCH)
+    {
+        return;
+    }
+    if (shard->hits)
     {
-        prealloc[i].fd = -1;
-	qlist_add(&prealloc[i].queue_link, &free_list);
+        PINT_perf_count(PINT_server_pc, PINT_PERF_OPEN_CACHE_HITS,
+                        shard->hits, PINT_PERF_ADD);
     }
+    if (shard->misses)
+    {
+        PINT_perf_count(PINT_server_pc, PINT_PERF_OPEN_CACHE_MISSES,
+                        shard->misses, PINT_PERF_ADD);
+    }
+    shard->hits = 0;
+    shard->misses = 0;
+}
 
-    gen_mutex_unlock(&cache_mutex);
+/* open_cache_release_entry()
+ *
+ * closes an unreferenced entry's fd, takes it out of the hash table and
+ * puts it on the free list.  Shard mutex must be held.
+ */
+static void open_cache_release_entry(struct open_cache_entry *entry)
+{
+    if (entry->fd > -1)
+    {
+        close_fd(entry->fd, entry->type);
+        entry->fd = -1;
+    }
+    if (entry->hashed)
+    {
+        qhash_del(&entry->hash_link);
+        entry->hashed = 0;
+    }
+    entry->remove_flag = 0;
+    entry->referenced = 0;
+    qlist_add_tail(&entry->free_link, &entry->shard->free_list);
+}
+
+/* open_cache_evict()
+ *
+ * finds an entry for a new handle: a free one if there is one,
+ * otherwise the first unreferenced entry the clock hand reaches that was
+ * not used since the hand last passed it.  Shard mutex must be held.
+ *
+ * returns the entry, off every list, or NULL if all are in use
+ */
+static struct open_cache_entry *open_cache_evict(
+    struct open_cache_shard *shard)
+{
+    struct open_cache_entry *entry;
+    int i;
+
+    if (!qlist_empty(&shard->free_list))
+    {
+        entry = qlist_entry(shard->free_list.next, struct open_cache_entry,
+                            free_link);
+        qlist_del(&entry->free_link);
+        return entry;
+    }
+
+    /* two sweeps: the first may only clear referenced bits */
+    for (i = 0; i < 2 * shard->entry_count; i++)
+    {
+        entry = &shard->entries[shard->clock_hand];
+        shard->clock_hand = (shard->clock_hand + 1) % shard->entry_count;
+        if (entry->ref_ct > 0)
+        {
+            continue;
+        }
+        if (entry->referenced)
+        {
+            entry->referenced = 0;
+            continue;
+        }
+
+        gossip_debug(GOSSIP_DBPF_OPEN_CACHE_DEBUG,
+                     "dbpf_open_cache: evicting handle %llu\n",
+                     llu(entry->handle));
+        shard->evictions++;
+        open_cache_release_entry(entry);
+        qlist_del(&entry->free_link);
+        return entry;
+    }
+    return NULL;
+}
+
+void dbpf_open_cache_initialize(void)
+{
+    struct open_cache_shard *shard;
+    int per_shard;
+    int table_size;
+    int i, j, ret = 0;
+
+    per_shard = (TROVE_open_cache_size + OPEN_CACHE_SHARDS - 1) /
+        OPEN_CACHE_SHARDS;
+    if (per_shard < 1)
+    {
+        per_shard = 1;
+    }
+    /* about two entries per bucket at most */
+    for (table_size = 1; table_size * 2 < per_shard; table_size <<= 1)
+    {
+        ;
+    }
+
+    shards = calloc(OPEN_CACHE_SHARDS, sizeof(*shards));
+    if (shards)
+    {
+        for (i = 0; i < OPEN_CACHE_SHARDS; i++)
+        {
+            shard = &shards[i];
+            gen_mutex_init(&shard->mutex);
+            INIT_QLIST_HEAD(&shard->free_list);
+            shard->entry_count = per_shard;
+            shard->entries = calloc(per_shard, sizeof(*shard->entries));
+            shard->table = qhash_init(open_cache_compare, open_cache_hash,
+                                      table_size);
+            if (!shard->entries || !shard->table)
+            {
+                break;
+            }
+            for (j = 0; j < per_shard; j++)
+            {
+                shard->entries[j].fd = -1;
+                shard->entries[j].shard = shard;
+                qlist_add_tail(&shard->entries[j].free_link,
+                               &shard->free_list);
+            }
+        }
+        if (i < OPEN_CACHE_SHARDS)
+        {
+            for (; i >= 0; i--)
+            {
+                free(shards[i].entries);
+                if (shards[i].table)
+                {
+                    qhash_finalize(shards[i].table);
+                }
+            }
+            free(shards);
+            shards = NULL;
+        }
+    }
+    if (!shards)
+    {
+        gossip_err("dbpf_open_cache_initialize: out of memory; bstream "
+                   "file descriptors will not be cached.\n");
+    }
+    else
+    {
+        gossip_debug(GOSSIP_DBPF_OPEN_CACHE_DEBUG,
+                     "dbpf_open_cache_initialize: %d shards of %d "
+                     "entries\n", OPEN_CACHE_SHARDS, per_shard);
+    }
 
     /* Initialize and create the worker thread for threaded deletes */
     INIT_QLIST_HEAD(&dbpf_unlink_context.global_list);
@@ -129,21 +349,45 @@ void dbpf_open_cache_initialize(void)
     }
 }
 
-static void dbpf_open_cache_entries_finalize(
-    struct qlist_head * list);
-
 void dbpf_open_cache_finalize(void)
 {
-    gen_mutex_lock(&cache_mutex);
+    struct open_cache_shard *shard;
+    int i, j;
 
-    /* close any open fd or db references */
+    if (shards)
+    {
+        for (i = 0; i < OPEN_CACHE_SHARDS; i++)
+        {
+            shard = &shards[i];
+            gen_mutex_lock(&shard->mutex);
 
-    dbpf_open_cache_entries_finalize(&used_list);
-    dbpf_open_cache_entries_finalize(&unused_list);
-    dbpf_open_cache_entries_finalize(&free_list);
+            gossip_debug(GOSSIP_DBPF_OPEN_CACHE_DEBUG,
+                         "dbpf_open_cache shard %d: hits %lld misses %lld "
+                         "evictions %lld uncached %lld\n", i,
+                         lld(shard->total_hits), lld(shard->total_misses),
+                         lld(shard->evictions), lld(shard->overflows));
+            open_cache_count_stats(shard, 1);
+
+            /* close any open fd references */
+            for (j = 0; j < shard->entry_count; j++)
+            {
+                if (shard->entries[j].fd > -1)
+                {
+                    close_fd(shard->entries[j].fd, shard->entries[j].type);
+                    shard->entries[j].fd = -1;
+                }
+            }
+            qhash_finalize(shard->table);
+            free(shard->entries);
 
-    gen_mutex_unlock(&cache_mutex);
+            gen_mutex_unlock(&shard->mutex);
+            gen_mutex_destroy(&shard->mutex);
+        }
+        free(shards);
+        shards = NULL;
+    }
 
+    /* Cancel the deletion thread */
     pthread_cancel(dbpf_unlink_context.thread_id);
 }
 
@@ -168,173 +412,112 @@ int dbpf_open_cache_get(
     enum open_cache_open_type type,
     struct open_cache_ref* out_ref)
 {
-    struct qlist_head *tmp_link;
-    struct open_cache_entry* tmp_entry = NULL;
-    int found = 0;
+    struct open_cache_shard *shard;
+    struct open_cache_entry *tmp_entry = NULL;
+    struct qhash_head *link;
+    struct open_cache_key key;
     int ret = 0;
 
     gossip_debug(GOSSIP_DBPF_OPEN_CACHE_DEBUG,
                  "dbpf_open_cache_get: called\n");
 
-    gen_mutex_lock(&cache_mutex);
-
-    /* check already opened objects first, reuse ref if possible */
-
-    tmp_entry = dbpf_open_cache_find_entry(
-        &used_list, "used list", coll_id, handle);
-    if (tmp_entry && tmp_entry->remove_flag)
-    {
-       gossip_err("DBPF_OPEN_CACHE_GET:  pulled EXISTING entry from the used-list with the "
-                  "remove flag set.\n");
-       gossip_err("\t\thandle:%llu\n",llu(tmp_entry->handle));
-       gossip_err("\t\tref-ct:%d \tfd:%d\n",tmp_entry->ref_ct,tmp_entry->fd);
-    }
-
-    if(!tmp_entry)
-    {
-        tmp_entry = dbpf_open_cache_find_entry(
-            &unused_list, "unused list", coll_id, handle);
-        if (tmp_entry && tmp_entry->remove_flag)
-        {
-           gossip_err("DBPF_OPEN_CACHE_GET:  pulled EXISTING entry from the UNused-list with the "
-                      "remove flag set.\n");
-           gossip_err("\t\thandle:%llu\n",llu(tmp_entry->handle));
-           gossip_err("\t\tref-ct:%d \tfd:%d\n",tmp_entry->ref_ct,tmp_entry->fd);
-        }
-    }
-
     out_ref->fd = -1;
+    out_ref->internal = NULL;
 
-    if (tmp_entry)
+    if (!shards)
     {
-	if (tmp_entry->fd < 0)
-	{
-	    ret = open_fd(&(tmp_entry->fd), coll_id, handle, type);
-	    if (ret < 0)
-	    {
-		gen_mutex_unlock(&cache_mutex);
-		return ret;
-	    }
-            tmp_entry->type = type;
-	}
-        out_ref->fd = tmp_entry->fd;
-        out_ref->type = type;
-
-	out_ref->internal = tmp_entry;
-	tmp_entry->ref_ct++;
+        goto uncached;
+    }
 
-	/* remove the entry and place it at the used head (assuming it
-	 * will be referenced again soon)
-	 */
-	gossip_debug(GOSSIP_DBPF_OPEN_CACHE_DEBUG, "dbpf_open_cache_get: "
-                     "moving to (or reordering in) used list.\n");
-	qlist_del(&tmp_entry->queue_link);
-	qlist_add(&tmp_entry->queue_link, &used_list);
+    key.coll_id = coll_id;
+    key.handle = handle;
+    key.mix = open_cache_mix(coll_id, handle);
+    shard = &shards[key.mix & (OPEN_CACHE_SHARDS - 1)];
 
-	gen_mutex_unlock(&cache_mutex);
+    gen_mutex_lock(&shard->mutex);
 
-        assert(out_ref->fd > 0);
-	return 0;
-    }
-
-    /* if we fall through to this point, then the object was not found
-     * in the cache. In order of priority we will now try: free list,
-     * unused_list, and then bypass cache
-     */
-    if (!qlist_empty(&free_list))
+    /* check already opened objects first, reuse ref if possible */
+    link = qhash_search(shard->table, &key);
+    if (link)
     {
-	tmp_link = free_list.next;
-	tmp_entry = qlist_entry(tmp_link, struct open_cache_entry,
-	    queue_link);
-	qlist_del(&tmp_entry->queue_link);
-	found = 1;
-	gossip_debug(GOSSIP_DBPF_OPEN_CACHE_DEBUG,
-	    "dbpf_open_cache_get: resetting entry from free list.\n");
-        if (tmp_entry->remove_flag)
+        tmp_entry = qhash_entry(link, struct open_cache_entry, hash_link);
+        gossip_debug(GOSSIP_DBPF_OPEN_CACHE_DEBUG,
+                     "dbpf_open_cache_get: found bstream entry.\n");
+        if (tmp_entry->fd < 0)
         {
-           gossip_err("DBPF_OPEN_CACHE_GET:  pulled FIRST entry from the free-list with the "
-                      "remove flag turned on.\n");
-           gossip_err("\t\t\tSetting remove-flag to zero.\n");
-           tmp_entry->remove_flag=0;
+            ret = open_fd(&(tmp_entry->fd), coll_id, handle, type);
+            if (ret < 0)
+            {
+                gen_mutex_unlock(&shard->mutex);
+                return ret;
+            }
+            tmp_entry->type = type;
         }
+        shard->hits++;
+        shard->total_hits++;
     }
-
-    /* anything in unused list (still open, but ref_ct == 0)? */
-    if (!found && !qlist_empty(&unused_list))
+    else
     {
-	tmp_link = unused_list.next;
-	tmp_entry = qlist_entry(
-            tmp_link, struct open_cache_entry, queue_link);
-	qlist_del(&tmp_entry->queue_link);
-	found = 1;
-	gossip_debug(GOSSIP_DBPF_OPEN_CACHE_DEBUG,
-	    "dbpf_open_cache_get: resetting entry from unused list.\n");
-
-        if (tmp_entry->remove_flag)
+        shard->misses++;
+        shard->total_misses++;
+
+        tmp_entry = open_cache_evict(shard);
+        if (!tmp_entry)
         {
-           gossip_err("DBPF_OPEN_CACHE_GET:  pulled FIRST entry from the UNused-list with the "
-                      "remove flag turned on.\n");
-           gossip_err("\t\t\tSetting remove-flag to zero.\n");
-           tmp_entry->remove_flag=0;
+            /* every entry of this shard is in use; fall back to an
+             * fd of our own below
+             */
+            shard->overflows++;
+            open_cache_count_stats(shard, 0);
+            gen_mutex_unlock(&shard->mutex);
+            gossip_debug(GOSSIP_DBPF_OPEN_CACHE_DEBUG,
+                         "dbpf_open_cache_get: missed cache entirely.\n");
+            goto uncached;
         }
-	if (tmp_entry->fd > -1)
-	{
-            close_fd(tmp_entry->fd, tmp_entry->type);
-	    tmp_entry->fd = -1;
-	}
-    }
-   
-    if (found)
-    {
-	/* have an entry to work with; fill in and place in used list */
-	tmp_entry->ref_ct = 1;
-	tmp_entry->coll_id = coll_id;
-	tmp_entry->handle = handle;
 
         ret = open_fd(&(tmp_entry->fd), coll_id, handle, type);
         if (ret < 0)
         {
-            qlist_add(&tmp_entry->queue_link, &free_list);
+            qlist_add_tail(&tmp_entry->free_link, &shard->free_list);
+            open_cache_count_stats(shard, 0);
+            gen_mutex_unlock(&shard->mutex);
             gossip_debug(GOSSIP_DBPF_OPEN_CACHE_DEBUG,
                          "dbpf_open_cache_get: could not open "
                          "(ret=%d)\n", ret);
-
-            gen_mutex_unlock(&cache_mutex);
             return ret;
         }
+        tmp_entry->coll_id = coll_id;
+        tmp_entry->handle = handle;
         tmp_entry->type = type;
-        out_ref->type = type;
-        out_ref->fd = tmp_entry->fd;
-
-	out_ref->internal = tmp_entry;
-	gossip_debug(GOSSIP_DBPF_OPEN_CACHE_DEBUG,
-	    "dbpf_open_cache_get: moving to used list.\n");
-	qlist_add(&tmp_entry->queue_link, &used_list);
-	gen_mutex_unlock(&cache_mutex);
-	return 0;
+        tmp_entry->ref_ct = 0;
+        qhash_add(shard->table, &key, &tmp_entry->hash_link);
+        tmp_entry->hashed = 1;
     }
 
-    /* if we reach this point the entry wasn't cached _and_ would
-     * could not create a new entry for it (cache exhausted).  In this
-     * case just open the file and hand out a reference that will not
-     * be cached
-     */
-    
-    out_ref->fd = -1;
+    tmp_entry->ref_ct++;
+    tmp_entry->referenced = 1;
+    out_ref->fd = tmp_entry->fd;
+    out_ref->type = type;
+    out_ref->internal = tmp_entry;
 
-    gossip_debug(GOSSIP_DBPF_OPEN_CACHE_DEBUG,
-        "dbpf_open_cache_get: missed cache entirely.\n");
+    open_cache_count_stats(shard, 0);
+    gen_mutex_unlock(&shard->mutex);
+
+    assert(out_ref->fd > 0);
+    return 0;
+
+  uncached:
+    /* the entry wasn't cached _and_ we could not create a new entry for
+     * it.  In this case just open the file and hand out a reference
+     * that will not be cached
+     */
     ret = open_fd(&(out_ref->fd), coll_id, handle, type);
     if (ret < 0)
     {
-        gen_mutex_unlock(&cache_mutex);
         return ret;
     }
     out_ref->type = type;
 
-    out_ref->internal = NULL;
-    gen_mutex_unlock(&cache_mutex);
-
     gossip_debug(GOSSIP_DBPF_OPEN_CACHE_DEBUG,
                  "dbpf_open_cache_get: returning 0\n");
 
@@ -345,45 +528,39 @@ void dbpf_open_cache_put(
     struct open_cache_ref* in_ref)
 {
     struct open_cache_entry* tmp_entry = NULL;
-    int move = 0;
-
-    gen_mutex_lock(&cache_mutex);
+    struct open_cache_shard *shard;
 
     /* handle cached entries */
     if(in_ref->internal)
     {
-	tmp_entry = in_ref->internal;
-	tmp_entry->ref_ct--;
-
-	gossip_debug(GOSSIP_DBPF_OPEN_CACHE_DEBUG,
-	    "dbpf_open_cache_put: cached entry.\n");
-
-	if(tmp_entry->ref_ct == 0)
-	{
-	    /* put this in unused list since ref ct hit zero */
-	    move = 1;
-	    qlist_del(&tmp_entry->queue_link);	    
-	}
-
-	if(move)
-	{
-	    gossip_debug(GOSSIP_DBPF_OPEN_CACHE_DEBUG,
-		"dbpf_open_cache_put: move to unused list.\n");
-	    qlist_add_tail(&tmp_entry->queue_link, &unused_list);
-	}
+        tmp_entry = in_ref->internal;
+        shard = tmp_entry->shard;
+
+        gossip_debug(GOSSIP_DBPF_OPEN_CACHE_DEBUG,
+            "dbpf_open_cache_put: cached entry.\n");
+
+        gen_mutex_lock(&shard->mutex);
+        tmp_entry->ref_ct--;
+        if (tmp_entry->ref_ct == 0 && tmp_entry->remove_flag)
+        {
+            /* the bstream was removed while we held it */
+            gossip_debug(GOSSIP_DBPF_OPEN_CACHE_DEBUG,
+                "dbpf_open_cache_put: releasing removed entry.\n");
+            open_cache_release_entry(tmp_entry);
+        }
+        gen_mutex_unlock(&shard->mutex);
     }
     else
     {
-	gossip_debug(GOSSIP_DBPF_OPEN_CACHE_DEBUG,
-	    "dbpf_open_cache_put: uncached entry.\n");
-	/* this wasn't cached; go ahead and close up */
-	if(in_ref->fd > -1)
-	{
+        gossip_debug(GOSSIP_DBPF_OPEN_CACHE_DEBUG,
+            "dbpf_open_cache_put: uncached entry.\n");
+        /* this wasn't cached; go ahead and close up */
+        if(in_ref->fd > -1)
+        {
             close_fd(in_ref->fd, in_ref->type);
-	    in_ref->fd = -1;
-	}
+            in_ref->fd = -1;
+        }
     }
-    gen_mutex_unlock(&cache_mutex);
     return;
 }
 
@@ -391,111 +568,57 @@ int dbpf_open_cache_remove(
     TROVE_coll_id coll_id,
     TROVE_handle handle)
 {
-    struct qlist_head* tmp_link;
-    struct open_cache_entry* tmp_entry = NULL;
-    int found = 0;
+    struct open_cache_shard *shard;
+    struct open_cache_entry *tmp_entry = NULL;
+    struct qhash_head *link;
+    struct open_cache_key key;
     char filename[PATH_MAX];
     int ret = -1;
     int tmp_error = 0;
-    struct qlist_head* scratch;
-    char open_type[32] = {0};
 
     gossip_debug(GOSSIP_DBPF_OPEN_CACHE_DEBUG,
                  "dbpf_open_cache_remove: called\n");
 
-    gen_mutex_lock(&cache_mutex);
-
-    /* for error checking for now, let's make sure that this object is _not_
-     * in the used list (we shouldn't be able to delete while another thread
-     * or operation has an fd/db open)
-     */
-
-    /* TODO: remove this search later when we have more confidence */
-    qlist_for_each(tmp_link, &used_list)
+    if (shards)
     {
-	tmp_entry = qlist_entry(tmp_link, struct open_cache_entry,
-	    queue_link);
-	if ((tmp_entry->handle == handle) &&
-            (tmp_entry->coll_id == coll_id))
-	{
-            gossip_err("DBPF_OPEN_CACHE_REMOVE:  BINGO! Entry found in the USED_list when trying to "
-                        "remove from the UNused_list.\n");
-            gossip_err("\t\tused_list entry:\n");
-            gossip_err("\t\t\t     handle:%llu\n",llu(tmp_entry->handle));
-            gossip_err("\t\t\t     ref-ct:%d \tfd:%d\n",tmp_entry->ref_ct,tmp_entry->fd);
-            gossip_err("\t\t\tremove-flag:%d\n",tmp_entry->remove_flag);
-            switch(tmp_entry->type)
-            {
-               case DBPF_FD_BUFFERED_READ:
-               {
-                  strcpy(&open_type[0],"DBPF_FD_BUFFERED_READ");
-                  break;
-               }
-               case DBPF_FD_BUFFERED_WRITE:
-               {
-                  strcpy(&open_type[0],"DBPF_FD_BUFFERED_WRITE");
-                  break;
-               }
-               case DBPF_FD_DIRECT_READ:
-               {
-                  strcpy(&open_type[0],"DBPF_FD_DIRECT_READ");
-                  break;
-               }
-               case DBPF_FD_DIRECT_WRITE:
-               {
-                  strcpy(&open_type[0],"DBPF_FD_DIRECT_WRITE");
-                  break;
-               }
-               default:
-               {
-                  strcpy(&open_type[0],"UNKNOWN FD TYPE");
-                  break;
-               }
-            }/*end switch*/
-            gossip_err("\t\t\t  type:%s\n",open_type);
-
-            tmp_entry->remove_flag=1;
-
-            return (0);
-	    //assert(0);
-	}
-    }
-
-    /* see if the item is in the unused list (ref_ct == 0) */    
-    qlist_for_each_safe(tmp_link, scratch, &unused_list)
-    {
-	tmp_entry = qlist_entry(tmp_link, struct open_cache_entry,
-	    queue_link);
-	if ((tmp_entry->handle == handle) &&
-             (tmp_entry->coll_id == coll_id))
+        key.coll_id = coll_id;
+        key.handle = handle;
+        key.mix = open_cache_mix(coll_id, handle);
+        shard = &shards[key.mix & (OPEN_CACHE_SHARDS - 1)];
+
+        gen_mutex_lock(&shard->mutex);
+        link = qhash_search(shard->table, &key);
+        if (link)
         {
-            qlist_del(&tmp_entry->queue_link);
-            found = 1;
-            break;
+            tmp_entry = qhash_entry(link, struct open_cache_entry,
+                                    hash_link);
+            if (tmp_entry->ref_ct > 0)
+            {
+                /* we shouldn't be able to delete while another thread or
+                 * operation has the fd open; keep the fd until the last
+                 * put, but make sure nobody else finds it
+                 */
+                gossip_err("DBPF_OPEN_CACHE_REMOVE: handle:%llu removed "
+                           "while in use (ref-ct:%d fd:%d type:%d)\n",
+                           llu(tmp_entry->handle), tmp_entry->ref_ct,
+                           tmp_entry->fd, tmp_entry->type);
+                qhash_del(&tmp_entry->hash_link);
+                tmp_entry->hashed = 0;
+                tmp_entry->remove_flag = 1;
+            }
+            else
+            {
+                gossip_debug(GOSSIP_DBPF_OPEN_CACHE_DEBUG,
+                    "dbpf_open_cache_remove: unused entry.\n");
+                open_cache_release_entry(tmp_entry);
+            }
         }
-    }
-
-    if (found)
-    {
-	gossip_debug(GOSSIP_DBPF_OPEN_CACHE_DEBUG,
-	    "dbpf_open_cache_remove: unused entry.\n");
-        if (tmp_entry->remove_flag)
+        else
         {
-           gossip_err("DBPF_OPEN_CACHE_REMOVE: handle:%llu found in the UNused list with"
-                      " remove-flag turned on\n",llu(tmp_entry->handle));
+            gossip_debug(GOSSIP_DBPF_OPEN_CACHE_DEBUG,
+                "dbpf_open_cache_remove: uncached entry.\n");
         }
-        tmp_entry->remove_flag = 0;
-	if (tmp_entry->fd > -1)
-	{
-            close_fd(tmp_entry->fd, tmp_entry->type);
-	    tmp_entry->fd = -1;
-	}
-	qlist_add(&tmp_entry->queue_link, &free_list);
-    }
-    else
-    {
-	gossip_debug(GOSSIP_DBPF_OPEN_CACHE_DEBUG,
-	    "dbpf_open_cache_remove: uncached entry.\n");
+        gen_mutex_unlock(&shard->mutex);
     }
 
     tmp_error = 0;
@@ -510,8 +633,6 @@ int dbpf_open_cache_remove(
         tmp_error = -trove_errno_to_trove_error(errno); 
     }
 
-    gen_mutex_unlock(&cache_mutex);
-
     gossip_debug(GOSSIP_DBPF_OPEN_CACHE_DEBUG,
                  "dbpf_open_cache_remove: returning %d\n", tmp_error);
 
@@ -566,52 +687,6 @@ static int open_fd(
     return ((*fd < 0) ? -trove_errno_to_trove_error(errno) : 0);
 }
 
-static void dbpf_open_cache_entries_finalize(struct qlist_head *list)
-{
-    struct qlist_head * list_entry;
-    struct qlist_head * scratch;
-    struct open_cache_entry * entry; 
-    qlist_for_each_safe(list_entry, scratch, list)
-    {
-        entry = qlist_entry(list_entry, struct open_cache_entry, queue_link);
-        if(entry->fd > -1)
-        {
-            close_fd(entry->fd, entry->type);
-	    entry->fd = -1;
-	}
-        qlist_del(&entry->queue_link);
-    }
-    /* Cancel the deletion thread */
-    pthread_cancel(dbpf_unlink_context.thread_id);
-}
-
-inline static struct open_cache_entry * dbpf_open_cache_find_entry(
-    struct qlist_head * list, 
-    const char * list_name,
-    TROVE_coll_id coll_id,
-    TROVE_handle handle)
-{
-    struct qlist_head *tmp_link;
-    struct open_cache_entry *tmp_entry = NULL;
-
-    qlist_for_each(tmp_link, list)
-    {
-	tmp_entry = qlist_entry(
-            tmp_link, struct open_cache_entry, queue_link);
-        if((tmp_entry->handle == handle) &&
-           (tmp_entry->coll_id == coll_id))
-        {
-            gossip_debug(
-                GOSSIP_DBPF_OPEN_CACHE_DEBUG,
-                "dbpf_open_cache_get: "
-                "found bstream entry in %s.\n", list_name);
-            return tmp_entry;
-        }
-    }
-
-    return NULL;
-}
-
 int fast_unlink(const char *pathname, TROVE_coll_id coll_id, TROVE_handle handle)
 {
     int ret;
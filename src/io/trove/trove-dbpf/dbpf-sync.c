@@ -220,6 +220,16 @@ int dbpf_sync_coalesce(dbpf_queued_op_t *qop_p, int retcode, int * outcount)
                      sync_context->coalesce_counter,
                      sync_context->sync_counter);
 
+        /* the coalesced ops may have been written through one batch
+         * transaction by this thread; it has to be committed before
+         * the sync and before any of them are reported complete
+         */
+        ret = dbpf_db_batch_commit(dbp);
+        if (ret != 0)
+        {
+            gossip_err("db batch commit failed: %s\n", strerror(ret));
+        }
+
         gossip_debug(GOSSIP_DBPF_COALESCE_DEBUG,
                      "[SYNC_COALESCE]: syncing now!\n");
         ret = dbpf_sync_db(dbp, sync_context_type, sync_context);
@@ -6,6 +6,8 @@
 
 #include <assert.h>
 #include <unistd.h>
+#include <string.h>
+#include <stdint.h>
 #include <pthread.h>
 
 #include "gossip.h"
@@ -27,34 +29,85 @@ extern dbpf_op_queue_p dbpf_completion_queue_array[TROVE_MAX_CONTEXTS];
 extern gen_mutex_t dbpf_completion_queue_array_mutex[TROVE_MAX_CONTEXTS];
 
 #ifdef __PVFS2_TROVE_THREADED__
-static pthread_t dbpf_thread;
+static pthread_t dbpf_threads[DBPF_MAX_THREADS];
+static int dbpf_thread_count = 0;
 static int dbpf_thread_running = 0;
 pthread_cond_t dbpf_op_incoming_cond = PTHREAD_COND_INITIALIZER;
 pthread_cond_t dbpf_op_completed_cond = PTHREAD_COND_INITIALIZER;
+
+/* handle that each service thread is currently working on, so that no
+ * two threads ever service operations on the same handle at once.
+ * Protected by dbpf_op_queue_mutex.
+ */
+static struct
+{
+    int busy;
+    TROVE_handle handle;
+} dbpf_thread_slot[DBPF_MAX_THREADS];
+
+/* read-only metadata operations hold this shared, operations that
+ * modify metadata hold it exclusively
+ */
+static pthread_rwlock_t dbpf_meta_rwlock = PTHREAD_RWLOCK_INITIALIZER;
+
+static int dbpf_op_is_runnable(dbpf_queued_op_t *cur_op, int slot);
+static dbpf_queued_op_t *dbpf_next_runnable_op(int slot);
 #endif
 
 extern int TROVE_max_concurrent_io;
+extern int TROVE_meta_threads;
 
 int dbpf_thread_initialize(void)
 {
     int ret = 0;
 #ifdef __PVFS2_TROVE_THREADED__
+    int i;
+
     ret = -1;
 
     pthread_cond_init(&dbpf_op_incoming_cond, NULL);
     pthread_cond_init(&dbpf_op_completed_cond, NULL);
 
+    dbpf_thread_count = TROVE_meta_threads;
+    if (dbpf_thread_count < 1)
+    {
+        dbpf_thread_count = 1;
+    }
+    if (dbpf_thread_count > DBPF_MAX_THREADS)
+    {
+        gossip_err("Warning: limiting Trove metadata threads to %d\n",
+                   DBPF_MAX_THREADS);
+        dbpf_thread_count = DBPF_MAX_THREADS;
+    }
+    memset(dbpf_thread_slot, 0, sizeof(dbpf_thread_slot));
+
     dbpf_thread_running = 1;
-    ret = pthread_create(&dbpf_thread, NULL,
-                         dbpf_thread_function, NULL);
+    for (i = 0; i < dbpf_thread_count; i++)
+    {
+        ret = pthread_create(&dbpf_threads[i], NULL,
+                             dbpf_thread_function, (void *)(intptr_t)i);
+        if (ret != 0)
+        {
+            break;
+        }
+    }
+
     if (ret == 0)
     {
         gossip_debug(GOSSIP_TROVE_DEBUG,
-                     "dbpf_thread_initialize: initialized\n");
+                     "dbpf_thread_initialize: initialized %d thread(s)\n",
+                     dbpf_thread_count);
     }
     else
     {
+        /* stop whatever did get started */
         dbpf_thread_running = 0;
+        pthread_cond_broadcast(&dbpf_op_incoming_cond);
+        while (--i >= 0)
+        {
+            pthread_join(dbpf_threads[i], NULL);
+        }
+        dbpf_thread_count = 0;
         gossip_debug(
             GOSSIP_TROVE_DEBUG, "dbpf_thread_initialize: failed (1)\n");
     }
@@ -67,8 +120,15 @@ int dbpf_thread_finalize(void)
 {
     int ret = 0;
 #ifdef __PVFS2_TROVE_THREADED__
+    int i;
+
     dbpf_thread_running = 0;
-    ret = pthread_join(dbpf_thread, NULL);
+    pthread_cond_broadcast(&dbpf_op_incoming_cond);
+    for (i = 0; i < dbpf_thread_count; i++)
+    {
+        ret = pthread_join(dbpf_threads[i], NULL);
+    }
+    dbpf_thread_count = 0;
 
     pthread_cond_destroy(&dbpf_op_completed_cond);
     pthread_cond_destroy(&dbpf_op_incoming_cond);
@@ -77,28 +137,150 @@ int dbpf_thread_finalize(void)
     return ret;
 }
 
+#ifdef __PVFS2_TROVE_THREADED__
+/* dbpf_op_is_read_only()
+ *
+ * metadata operations that never modify the databases, and so may run
+ * alongside each other
+ */
+static int dbpf_op_is_read_only(enum dbpf_op_type type)
+{
+    switch (type)
+    {
+        case KEYVAL_READ:
+        case KEYVAL_READ_LIST:
+        case KEYVAL_ITERATE:
+        case KEYVAL_ITERATE_KEYS:
+        case KEYVAL_GET_HANDLE_INFO:
+        case DSPACE_ITERATE_HANDLES:
+        case DSPACE_VERIFY:
+        case DSPACE_GETATTR:
+        case DSPACE_GETATTR_LIST:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/* dbpf_op_is_runnable()
+ *
+ * an op may be picked up by a thread as long as no other thread is
+ * working on the same handle.  Must hold dbpf_op_queue_mutex.
+ */
+static int dbpf_op_is_runnable(dbpf_queued_op_t *cur_op, int slot)
+{
+    int i;
+
+    for (i = 0; i < dbpf_thread_count; i++)
+    {
+        if (i != slot && dbpf_thread_slot[i].busy &&
+            dbpf_thread_slot[i].handle == cur_op->op.handle)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* dbpf_next_runnable_op()
+ *
+ * returns the oldest queued op that this thread may service, or NULL.
+ * Because a busy handle blocks every op queued on it, ops on any one
+ * handle are still started in the order they were queued.  Must hold
+ * dbpf_op_queue_mutex.
+ */
+static dbpf_queued_op_t *dbpf_next_runnable_op(int slot)
+{
+    dbpf_queued_op_t *cur_op = NULL;
+    struct qlist_head *tmp_link = NULL;
+
+    if (dbpf_thread_count == 1)
+    {
+        return dbpf_op_queue_shownext(&dbpf_op_queue);
+    }
+
+    qlist_for_each(tmp_link, &dbpf_op_queue)
+    {
+        cur_op = qlist_entry(tmp_link, dbpf_queued_op_t, link);
+        if (dbpf_op_is_runnable(cur_op, slot))
+        {
+            return cur_op;
+        }
+    }
+    return NULL;
+}
+
+/* dbpf_op_batch_db()
+ *
+ * returns the database whose updates may be written through one batch
+ * transaction with those of neighbouring ops, or NULL.  Only ops that
+ * are held back for a coalesced sync qualify: dbpf_sync_coalesce commits
+ * the batch before it syncs and completes them, while any other op would
+ * be reported complete before the batch was committed.
+ */
+static dbpf_db *dbpf_op_batch_db(struct dbpf_op *op)
+{
+    if (!DBPF_OP_DOES_SYNC(op->type) || !(op->flags & TROVE_SYNC) ||
+        !op->coll_p->meta_sync_enabled)
+    {
+        return NULL;
+    }
+    return DBPF_OP_IS_KEYVAL(op->type) ?
+        op->coll_p->keyval_db : op->coll_p->ds_db;
+}
+
+/* dbpf_batch_finish()
+ *
+ * commits the batch left open by a work cycle and drops the exclusive
+ * metadata lock held for it, so no other thread blocks on the database
+ * writer lock while holding the metadata lock this thread needs.
+ */
+static void dbpf_batch_finish(dbpf_db **batch_db,
+                              pthread_rwlock_t **batch_lock)
+{
+    int ret;
+
+    if (*batch_db)
+    {
+        ret = dbpf_db_batch_commit(*batch_db);
+        if (ret != 0)
+        {
+            gossip_err("dbpf: batch commit failed: %s\n", strerror(ret));
+        }
+        *batch_db = NULL;
+    }
+    if (*batch_lock)
+    {
+        pthread_rwlock_unlock(*batch_lock);
+        *batch_lock = NULL;
+    }
+}
+#endif
+
 int synccount = 0;
 
 void *dbpf_thread_function(void *ptr)
 {
 #ifdef __PVFS2_TROVE_THREADED__
     int out_count = 0, op_queued_empty = 0, ret = 0;
+    int slot = (int)(intptr_t)ptr;
     struct timeval base;
     struct timespec wait_time;
 
-    gossip_debug(GOSSIP_TROVE_DEBUG, "dbpf_thread_function started\n");
+    gossip_debug(GOSSIP_TROVE_DEBUG, "dbpf_thread_function %d started\n",
+                 slot);
 
     PINT_event_thread_start("TROVE-DBPF");
     while(dbpf_thread_running)
     {
         /* check if we any have ops to service in our work queue */
         gen_mutex_lock(&dbpf_op_queue_mutex);
-        op_queued_empty = qlist_empty(&dbpf_op_queue);
+        op_queued_empty = (dbpf_next_runnable_op(slot) == NULL);
 
         if (!op_queued_empty)
         {
             gen_mutex_unlock(&dbpf_op_queue_mutex);
-            dbpf_do_one_work_cycle(&out_count);
+            dbpf_do_one_work_cycle(slot, &out_count);
 #ifndef __PVFS2_TROVE_AIO_THREADED__
             if(out_count == 0)
             {
@@ -154,12 +336,16 @@ void *dbpf_thread_function(void *ptr)
     return ptr;
 }
 
-int dbpf_do_one_work_cycle(int *out_count)
+int dbpf_do_one_work_cycle(int slot, int *out_count)
 {
 #ifdef __PVFS2_TROVE_THREADED__
     int ret = 1;
     int max_num_ops_to_service = DBPF_OPS_PER_WORK_CYCLE;
     dbpf_queued_op_t *cur_op = NULL;
+    pthread_rwlock_t *meta_lock = NULL;
+    dbpf_db *op_db = NULL;
+    dbpf_db *batch_db = NULL;
+    pthread_rwlock_t *batch_lock = NULL;
 #endif
 
     assert(out_count);
@@ -170,7 +356,7 @@ int dbpf_do_one_work_cycle(int *out_count)
     {
         /* grab next op from queue and mark it as in service */
         gen_mutex_lock(&dbpf_op_queue_mutex);
-        cur_op = dbpf_op_queue_shownext(&dbpf_op_queue);
+        cur_op = dbpf_next_runnable_op(slot);
         if (cur_op)
         {
             gen_mutex_lock(&cur_op->mutex);
@@ -190,12 +376,16 @@ int dbpf_do_one_work_cycle(int *out_count)
 
             cur_op->op.state = OP_IN_SERVICE;
             gen_mutex_unlock(&cur_op->mutex);
+
+            dbpf_thread_slot[slot].busy = 1;
+            dbpf_thread_slot[slot].handle = cur_op->op.handle;
         }
         gen_mutex_unlock(&dbpf_op_queue_mutex);
 
         /* if there's no work to be done, return immediately */
         if (cur_op == NULL)
         {
+            dbpf_batch_finish(&batch_db, &batch_lock);
             return ret;
         }
 
@@ -204,8 +394,60 @@ int dbpf_do_one_work_cycle(int *out_count)
                      "SERVICE ROUTINE (%s)\n",
                      dbpf_op_type_to_str(cur_op->op.type));
 
+        /* consecutive synced updates to the same database share one
+         * write transaction; anything else ends the batch first
+         */
+        op_db = dbpf_op_batch_db(&cur_op->op);
+        if (batch_db && op_db != batch_db)
+        {
+            dbpf_batch_finish(&batch_db, &batch_lock);
+        }
+
+        /* with more than one thread, only read-only metadata ops may
+         * overlap; bstream ops do their own I/O throttling
+         */
+        meta_lock = NULL;
+        if (dbpf_thread_count > 1 && !DBPF_OP_IS_BSTREAM(cur_op->op.type) &&
+            !batch_lock)
+        {
+            meta_lock = &dbpf_meta_rwlock;
+            if (dbpf_op_is_read_only(cur_op->op.type))
+            {
+                pthread_rwlock_rdlock(meta_lock);
+            }
+            else
+            {
+                pthread_rwlock_wrlock(meta_lock);
+            }
+        }
+
+        /* the exclusive lock is kept until the batch is committed */
+        if (op_db && dbpf_db_batch_begin(op_db) == 0)
+        {
+            batch_db = op_db;
+            if (!batch_lock)
+            {
+                batch_lock = meta_lock;
+                meta_lock = NULL;
+            }
+        }
+
         ret = cur_op->op.svc_fn(&(cur_op->op));
 
+        if (meta_lock)
+        {
+            pthread_rwlock_unlock(meta_lock);
+        }
+
+        /* let ops queued behind this one on the same handle go */
+        gen_mutex_lock(&dbpf_op_queue_mutex);
+        dbpf_thread_slot[slot].busy = 0;
+        if (dbpf_thread_count > 1 && !qlist_empty(&dbpf_op_queue))
+        {
+            pthread_cond_broadcast(&dbpf_op_incoming_cond);
+        }
+        gen_mutex_unlock(&dbpf_op_queue_mutex);
+
         gossip_debug(GOSSIP_TROVE_OP_DEBUG,"[DBPF THREAD]: FINISHED TROVE "
                      "SERVICE ROUTINE (%s) (ret: %d)\n",
                      dbpf_op_type_to_str(cur_op->op.type),
@@ -222,6 +464,7 @@ int dbpf_do_one_work_cycle(int *out_count)
             ret = dbpf_sync_coalesce(cur_op, (ret == 1 ? 0 : ret), out_count);
             if(ret < 0)
             {
+                dbpf_batch_finish(&batch_db, &batch_lock);
                 return ret; /* not sure how to recover from failure here */
             }
         }
@@ -231,6 +474,7 @@ int dbpf_do_one_work_cycle(int *out_count)
              * and just return.  Make sure the return code is negative
              * here though.
              */
+            dbpf_batch_finish(&batch_db, &batch_lock);
             return (ret < 0) ? ret : -ret;
         }
         else
@@ -253,6 +497,8 @@ int dbpf_do_one_work_cycle(int *out_count)
         }
 
     } while(--max_num_ops_to_service);
+
+    dbpf_batch_finish(&batch_db, &batch_lock);
 #endif
 
     return 0;
@@ -18,13 +18,16 @@ extern "C" {
 
 #define DBPF_OPS_PER_WORK_CYCLE 5
 
+/* upper bound on the TroveMetaThreads setting */
+#define DBPF_MAX_THREADS 64
+
 int dbpf_thread_initialize(void);
 
 int dbpf_thread_finalize(void);
 
 void *dbpf_thread_function(void *ptr);
 
-int dbpf_do_one_work_cycle(int *out_count);
+int dbpf_do_one_work_cycle(int slot, int *out_count);
 
 #define DBPF_COMPLETION_START(cur_op, end_state)                   \
 do {                                                               \
@@ -37,6 +37,9 @@ extern "C" {
 
 #define LAST_HANDLE_STRING                                  "last_handle"
 
+/* handle ledger saved in the collection attribute db at shutdown */
+#define TROVE_DBPF_HANDLE_LEDGER_KEY                      "handle-ledger"
+
 #define TROVE_DB_MODE                                                 0600
 #define TROVE_FD_MODE 0600
 
@@ -124,6 +127,23 @@ do {                                                                      \
                  llu(__handle));                             \
     } while(0)
 
+#define PACKED_BSTREAM_DIRNAME "packed-bstreams"
+#define DBPF_GET_PACKED_BSTREAM_DIRNAME(                         \
+        __buf, __path_max, __base, __collid)                     \
+    do {                                                         \
+        snprintf(__buf, __path_max, "/%s/%08x/%s",               \
+                 __base, __collid, PACKED_BSTREAM_DIRNAME);      \
+    } while(0)
+
+/* arguments are: buf, path_max, base, collid, extent size */
+#define DBPF_GET_PACKED_CONTAINER_FILENAME(                  \
+        __b, __pm, __base, __cid, __size)                    \
+    do {                                                     \
+        snprintf(__b, __pm, "/%s/%08x/%s/%08x.container",    \
+                 __base, __cid, PACKED_BSTREAM_DIRNAME,      \
+                 (unsigned int)(__size));                    \
+    } while(0)
+
 /* arguments are: buf, path_max, base, collid */
 #define KEYVAL_DBNAME "keyval.db"
 #define DBPF_GET_KEYVAL_DBNAME(__buf,__path_max,__base,__collid)         \
@@ -216,6 +236,17 @@ struct dbpf_keyval_db_entry
 #define DBPF_KEYVAL_DB_ENTRY_KEY_SIZE(_size) \
     (_size - sizeof(TROVE_handle) - sizeof(char))
 
+/* container extent of a packed bstream, stored as the value of its
+ * DBPF_PACKED_EXTENT_TYPE entry and as the key of a
+ * DBPF_PACKED_FREE_TYPE entry once it is free
+ */
+struct dbpf_packed_extent
+{
+    uint32_t shift;     /* log2 of the extent size */
+    uint32_t unused;
+    uint64_t slot;      /* index of the extent within its container */
+};
+
 /**
  * The keyval database contains attributes for pvfs2 handles
  * (files, directories, symlinks, etc.) that are not considered
@@ -290,6 +321,8 @@ struct dbpf_collection
      * If this option is on we don't queue ops or use threads.
      */
     int immediate_completion;
+    /* small bstreams packed into container files; NULL if not in use */
+    struct dbpf_packed_state *packed;
 };
 
 /* Structure stored as data in collections database with collection
@@ -505,7 +538,10 @@ enum dbpf_key_type
 {
     DBPF_DIRECTORY_ENTRY_TYPE = 'd',
     DBPF_ATTRIBUTE_TYPE = 'a',
-    DBPF_COUNT_TYPE = 'c'
+    DBPF_COUNT_TYPE = 'c',
+    DBPF_PACKED_EXTENT_TYPE = 'x',     /* extent of a packed bstream */
+    DBPF_PACKED_FREE_TYPE = 'f',       /* free container extent */
+    DBPF_INLINE_DATA_TYPE = 'i'        /* data of an inline bstream */
 };
 
 struct dbpf_keyval_get_handle_info_op
@@ -839,6 +875,13 @@ int dbpf_bstream_flush(TROVE_coll_id coll_id,
                        TROVE_op_id *out_op_id_p,
                        PVFS_hint hints);
 
+int dbpf_bstream_get_fd(TROVE_coll_id coll_id,
+                        TROVE_handle handle,
+                        int *out_fd_p,
+                        void **out_fd_ref_p);
+
+void dbpf_bstream_put_fd(void *fd_ref);
+
 int dbpf_bstream_resize(TROVE_coll_id coll_id,
                         TROVE_handle handle,
                         TROVE_size *inout_size_p,
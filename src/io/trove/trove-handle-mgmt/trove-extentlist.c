@@ -44,6 +44,12 @@ static void extent_count(
 static TROVE_handle avltree_extent_search_in_range(
     struct avlnode *n,
     TROVE_extent *req_extent);
+static int64_t avltree_extent_count(
+    struct avlnode *n);
+static void avltree_extent_export(
+    struct avlnode *n,
+    TROVE_extent *out_extent_array,
+    int64_t *index);
 
 static uint64_t g_counter = 0;
 
@@ -480,6 +486,30 @@ void extentlist_count(
     *count = g_counter;
 }
 
+/* extentlist_num_extents()
+ *
+ * counts the extents in the index.  num_extents is not kept exact as
+ * extents coalesce, so walk the tree instead.
+ */
+int64_t extentlist_num_extents(struct TROVE_handle_extentlist *elist)
+{
+    return avltree_extent_count(elist->index);
+}
+
+/* extentlist_export()
+ *
+ * copies every extent in the list, in ascending order, into
+ * out_extent_array, which must have room for extentlist_num_extents()
+ * entries
+ */
+void extentlist_export(struct TROVE_handle_extentlist *elist,
+                       TROVE_extent *out_extent_array)
+{
+    int64_t index = 0;
+
+    avltree_extent_export(elist->index, out_extent_array, &index);
+}
+
 static void extent_show(struct avlnode *n, int param, int depth)
 {
     struct TROVE_handle_extent *e __attribute__((unused)) =
@@ -723,6 +753,32 @@ static TROVE_handle avltree_extent_search_in_range(
     return 0;
 }
 
+static int64_t avltree_extent_count(struct avlnode *n)
+{
+    if (!n)
+    {
+        return 0;
+    }
+    return (1 + avltree_extent_count(n->left) +
+            avltree_extent_count(n->right));
+}
+
+static void avltree_extent_export(struct avlnode *n,
+                                  TROVE_extent *out_extent_array,
+                                  int64_t *index)
+{
+    if (!n)
+    {
+        return;
+    }
+
+    avltree_extent_export(n->left, out_extent_array, index);
+    out_extent_array[*index].first = n->d->first;
+    out_extent_array[*index].last = n->d->last;
+    (*index)++;
+    avltree_extent_export(n->right, out_extent_array, index);
+}
+
 /*
  * Local variables:
  *  c-indent-level: 4
@@ -88,6 +88,11 @@ void extentlist_count(
     uint64_t* count);
 void extentlist_stats(
     struct TROVE_handle_extentlist *elist); 
+int64_t extentlist_num_extents(
+    struct TROVE_handle_extentlist *elist);
+void extentlist_export(
+    struct TROVE_handle_extentlist *elist,
+    TROVE_extent *out_extent_array);
 int extentlist_hit_cutoff(
     struct TROVE_handle_extentlist *elist,
     TROVE_handle cutoff);
@@ -9,6 +9,7 @@
 #include <string.h>
 #include <assert.h>
 #include <sys/time.h>
+#include <pthread.h>
 
 #include "trove.h"
 #include "quickhash.h"
@@ -19,6 +20,31 @@
 #include "gen-locks.h"
 #include "pvfs2-internal.h"
 
+/*
+  one slice of the handle ranges, scanned in handle order by
+  trove_check_handle_ranges and the background scan threads
+*/
+struct handle_scan_part
+{
+    TROVE_handle first;
+    TROVE_handle last;
+    TROVE_ds_position pos;  /* where the next batch starts */
+    TROVE_handle unscanned; /* handles below this have been seen */
+    int done;
+};
+
+struct handle_scan
+{
+    PINT_llist *extent_list;
+    struct handle_scan_part *parts;
+    int part_count;
+    int next_part;          /* next part a scan thread picks up */
+    int parts_left;         /* parts not scanned to the end yet */
+    int cancel;
+    int thread_count;
+    pthread_t threads[TROVE_HANDLE_SCAN_THREADS];
+};
+
 /*
   this is an internal structure and shouldn't be used
   by anyone except this module
@@ -31,6 +57,11 @@ typedef struct
     int have_valid_ranges;
 
     struct handle_ledger *ledger;
+
+    char *ranges;               /* ranges the ledger was built for */
+    void *checkpoint;           /* saved ledger, until ranges are set */
+    int checkpoint_len;
+    struct handle_scan *scan;   /* handle scan still in progress */
 } handle_ledger_t;
 
 static struct qhash_table *s_fsid_to_ledger_table = NULL;
@@ -41,103 +72,476 @@ static int hash_fsid_compare(const void *key, struct qlist_head *link);
 
 static gen_mutex_t trove_handle_mutex = GEN_MUTEX_INITIALIZER;
 
-/* trove_check_handle_ranges:
- *  internal function to verify that handles
- *  on disk match our assigned handles.
- *  this function is *very* expensive.
- *
- * coll_id: id of collection which we will verify
- * extent_list: llist of legal handle ranges/extents
- * ledger: a book-keeping ledger object
+/*
+  allocation is restricted to the scanned parts of the handle ranges
+  for as long as a scan is in progress
+*/
+#define handle_scan_active(__ledger) \
+    ((__ledger)->scan && ((__ledger)->scan->parts_left > 0))
+
+static struct handle_scan *handle_scan_create(char *handle_range_str)
+{
+    struct handle_scan *scan = NULL;
+    struct handle_scan_part *part = NULL;
+    PVFS_handle_extent *cur_extent = NULL;
+    PINT_llist *cur = NULL;
+    TROVE_handle span = 0, step = 0;
+    int extent_count = 0, slices = 0, lowest = 0, i = 0;
+
+    scan = calloc(1, sizeof(struct handle_scan));
+    if (!scan)
+    {
+        return NULL;
+    }
+    scan->extent_list = PINT_create_extent_list(handle_range_str);
+    if (!scan->extent_list)
+    {
+        free(scan);
+        return NULL;
+    }
+
+    for (cur = scan->extent_list; cur && PINT_llist_head(cur);
+         cur = PINT_llist_next(cur))
+    {
+        extent_count++;
+    }
+    slices = TROVE_HANDLE_SCAN_PARTS / extent_count;
+    slices = (slices ? slices : 1);
+
+    scan->parts = calloc(extent_count * slices,
+                         sizeof(struct handle_scan_part));
+    if (!scan->parts)
+    {
+        PINT_release_extent_list(scan->extent_list);
+        free(scan);
+        return NULL;
+    }
+
+    for (cur = scan->extent_list; cur && PINT_llist_head(cur);
+         cur = PINT_llist_next(cur))
+    {
+        cur_extent = PINT_llist_head(cur);
+        span = cur_extent->last - cur_extent->first + 1;
+        step = span / slices;
+        step = (step ? step : 1);
+
+        for (i = 0; i < slices && (i * step) < span; i++)
+        {
+            part = &scan->parts[scan->part_count++];
+            part->first = cur_extent->first + (i * step);
+            part->last = (((i == (slices - 1)) ||
+                           ((i + 1) * step >= span)) ?
+                          cur_extent->last : part->first + step - 1);
+            part->unscanned = part->first;
+
+            /* a partition must not start on one of the special
+             * iterate positions; reading a little below it is
+             * harmless */
+            part->pos = part->first;
+            while ((part->pos == TROVE_ITERATE_START) ||
+                   (part->pos == TROVE_ITERATE_END))
+            {
+                part->pos--;
+            }
+
+            if (part->first < scan->parts[lowest].first)
+            {
+                lowest = scan->part_count - 1;
+            }
+        }
+    }
+
+    /* the lowest partition starts at the beginning of the dspace db so
+     * that handles below the ranges are noticed */
+    scan->parts[lowest].pos = TROVE_ITERATE_START;
+    scan->parts_left = scan->part_count;
+    return scan;
+}
+
+static void handle_scan_free(struct handle_scan *scan)
+{
+    PINT_release_extent_list(scan->extent_list);
+    free(scan->parts);
+    free(scan);
+}
+
+/* handle_scan_read:
+ *  reads the next batch of in-use handles of one partition.  does
+ *  not need trove_handle_mutex.
  *
- * returns 0 on success; -1 otherwise
+ * returns 0 on success, negative error code otherwise
  */
-static int trove_check_handle_ranges(TROVE_coll_id coll_id,
-                                     TROVE_context_id context_id,
-                                     PINT_llist *extent_list,
-                                     struct handle_ledger *ledger)
+static int handle_scan_read(TROVE_coll_id coll_id,
+                            TROVE_context_id context_id,
+                            struct handle_scan_part *part,
+                            TROVE_handle *handles,
+                            int *count)
 {
-    int ret = -1, i = 0, count = 0, op_count = 0;
+    int ret = -1, op_count = 0;
     TROVE_op_id op_id = 0;
     TROVE_ds_state state = 0;
-    TROVE_ds_position pos = TROVE_ITERATE_START;
-    static TROVE_handle handles[MAX_NUM_VERIFY_HANDLE_COUNT] =
-        {TROVE_HANDLE_NULL};
 
-    if (extent_list && ledger)
+    *count = MAX_NUM_VERIFY_HANDLE_COUNT;
+    ret = trove_dspace_iterate_handles(coll_id, &part->pos, handles,
+                                       count, 0, NULL, NULL,
+                                       context_id, &op_id);
+    while (ret == 0)
+    {
+        ret = trove_dspace_test(coll_id, op_id, context_id,
+                                &op_count, NULL, NULL, &state,
+                                TROVE_DEFAULT_TEST_TIMEOUT);
+    }
+
+    /* check result of testing */
+    if (ret < 0)
+    {
+        gossip_debug(GOSSIP_TROVE_DEBUG,
+                     "dspace test of iterate_handles failed\n");
+        return ret;
+    }
+
+    /* also check result of actual operation, in this case,
+     * trove_dspace_iterate_handles
+     */
+    if (state < 0)
     {
-        count = MAX_NUM_VERIFY_HANDLE_COUNT;
+        gossip_debug(GOSSIP_TROVE_DEBUG,
+                     "trove_dspace_iterate_handles failed\n");
+        return state;
+    }
+    return 0;
+}
+
+/* handle_scan_apply:
+ *  takes a batch of in-use handles out of the ledger and advances the
+ *  partition.  trove_handle_mutex must be held.
+ *
+ * returns 0 on success, -1 if a handle outside of the handle ranges
+ * was found
+ */
+static int handle_scan_apply(handle_ledger_t *ledger,
+                             struct handle_scan_part *part,
+                             TROVE_handle *handles,
+                             int count)
+{
+    struct handle_scan *scan = ledger->scan;
+    int ret = 0, i = 0;
 
-        while(count > 0)
+    for (i = 0; i < count; i++)
+    {
+        if (handles[i] == TROVE_HANDLE_NULL)
         {
-            ret = trove_dspace_iterate_handles(coll_id,&pos,handles,
-                                               &count,0,NULL,NULL,
-                                               context_id,&op_id);
-            while(ret == 0)
-            {
-                ret = trove_dspace_test(coll_id,op_id,context_id,
-                                        &op_count,NULL,NULL,&state,
-                                        TROVE_DEFAULT_TEST_TIMEOUT);
-            }
+            continue;
+        }
+
+        /* check every item in our range list */
+        if (!PINT_handle_in_extent_list(scan->extent_list, handles[i]))
+        {
+            gossip_err("Error: handle %llu is invalid "
+                       "(out of bounds)\n", llu(handles[i]));
+            ret = -1;
+        }
+        else if (handles[i] > part->last)
+        {
+            /* the rest belongs to the next partition */
+            break;
+        }
+        else if (trove_handle_remove(ledger->ledger, handles[i]) != 0)
+        {
+            /* already taken by a create that forced this handle */
+            gossip_debug(GOSSIP_TROVE_DEBUG, "handle %llu is no longer "
+                         "in the ledger\n", llu(handles[i]));
+        }
+
+        if (handles[i] > part->last)
+        {
+            break;
+        }
+    }
+
+    if ((i < count) || (part->pos == TROVE_ITERATE_END) ||
+        (part->pos > part->last))
+    {
+        part->done = 1;
+        if (--scan->parts_left == 0)
+        {
+            gossip_debug(GOSSIP_TROVE_DEBUG,
+                         "handle scan of collection %d complete\n",
+                         (int)ledger->coll_id);
+        }
+    }
+    else if (part->pos > part->unscanned)
+    {
+        part->unscanned = part->pos;
+    }
+    return ret;
+}
+
+/* handle_scan_thread:
+ *  scans the partitions that trove_check_handle_ranges left
+ *  unfinished.  threads share the partitions, taking the next
+ *  unclaimed one when they finish theirs.
+ */
+static void *handle_scan_thread(void *ptr)
+{
+    handle_ledger_t *ledger = (handle_ledger_t *)ptr;
+    struct handle_scan *scan = ledger->scan;
+    struct handle_scan_part *part = NULL;
+    TROVE_context_id context_id = 0;
+    TROVE_handle *handles = NULL;
+    int ret = -1, count = 0;
+
+    handles = malloc(MAX_NUM_VERIFY_HANDLE_COUNT * sizeof(TROVE_handle));
+    if (!handles)
+    {
+        gossip_err("Error: no memory for handle scan\n");
+        return NULL;
+    }
+
+    ret = trove_open_context(ledger->coll_id, &context_id);
+    if (ret < 0)
+    {
+        gossip_err("Error: handle scan failed to open a trove context\n");
+        free(handles);
+        return NULL;
+    }
 
-            /* check result of testing */
+    gen_mutex_lock(&trove_handle_mutex);
+    while (!scan->cancel && (scan->next_part < scan->part_count))
+    {
+        part = &scan->parts[scan->next_part++];
+        while (!part->done && !scan->cancel)
+        {
+            gen_mutex_unlock(&trove_handle_mutex);
+            ret = handle_scan_read(ledger->coll_id, context_id,
+                                   part, handles, &count);
+            gen_mutex_lock(&trove_handle_mutex);
             if (ret < 0)
             {
-                gossip_debug(GOSSIP_TROVE_DEBUG,
-                             "dspace test of iterate_handles failed\n");
-                return ret;
+                gossip_err("Error: handle scan of %llu-%llu failed; "
+                           "handles from %llu on will not be "
+                           "allocated\n", llu(part->first),
+                           llu(part->last), llu(part->unscanned));
+                break;
             }
+            handle_scan_apply(ledger, part, handles, count);
+        }
+    }
+    gen_mutex_unlock(&trove_handle_mutex);
 
-            ret = 0;
+    trove_close_context(ledger->coll_id, context_id);
+    free(handles);
+    return NULL;
+}
 
-            /* also check result of actual operation, in this case,
-             * trove_dspace_iterate_handles
-             */
-            if(state < 0)
-            {
-                gossip_debug(GOSSIP_TROVE_DEBUG,
-                             "trove_dspace_iterate_handles failed\n");
-                return state;
-            }
+/* handle_scan_stop:
+ *  stops the scan threads of a ledger.  the scan state is kept if the
+ *  scan is not finished, so allocation stays restricted.
+ *  trove_handle_mutex must be held; it is dropped while waiting.
+ */
+static void handle_scan_stop(handle_ledger_t *ledger)
+{
+    struct handle_scan *scan = ledger->scan;
+    int i = 0;
+
+    scan->cancel = 1;
+    gen_mutex_unlock(&trove_handle_mutex);
+    for (i = 0; i < scan->thread_count; i++)
+    {
+        pthread_join(scan->threads[i], NULL);
+    }
+    gen_mutex_lock(&trove_handle_mutex);
+    scan->thread_count = 0;
+
+    if (scan->parts_left == 0)
+    {
+        handle_scan_free(scan);
+        ledger->scan = NULL;
+    }
+}
+
+/* handle_scan_clip:
+ *  limits 'extent' (all handles if NULL) to the part of a partition
+ *  that has been scanned.
+ *
+ * returns 1 if anything is left, 0 otherwise
+ */
+static int handle_scan_clip(struct handle_scan_part *part,
+                            TROVE_extent *extent,
+                            TROVE_extent *out_extent)
+{
+    if (!part->done && (part->unscanned == part->first))
+    {
+        return 0;
+    }
+    out_extent->first = part->first;
+    out_extent->last = (part->done ? part->last : part->unscanned - 1);
+
+    if (extent)
+    {
+        if (extent->first > out_extent->first)
+        {
+            out_extent->first = extent->first;
+        }
+        if (extent->last < out_extent->last)
+        {
+            out_extent->last = extent->last;
+        }
+    }
+    return (out_extent->first <= out_extent->last);
+}
+
+static int handle_scan_covers(struct handle_scan *scan,
+                              TROVE_handle handle)
+{
+    int i = 0;
 
-            /* look for special case of a blank fs */
-            if ((count == 1) && (handles[0] == 0))
+    for (i = 0; i < scan->part_count; i++)
+    {
+        if ((handle >= scan->parts[i].first) &&
+            (handle <= scan->parts[i].last))
+        {
+            return (scan->parts[i].done ||
+                    (handle < scan->parts[i].unscanned));
+        }
+    }
+    return 1;
+}
+
+/* handle_scan_alloc:
+ *  allocates a handle within 'extent' (anywhere if NULL) from the
+ *  scanned parts of the handle ranges, highest partition first like
+ *  the ledger itself
+ */
+static TROVE_handle handle_scan_alloc(handle_ledger_t *ledger,
+                                      TROVE_extent *extent)
+{
+    struct handle_scan *scan = ledger->scan;
+    TROVE_handle handle = TROVE_HANDLE_NULL;
+    TROVE_extent clipped;
+    int i = 0;
+
+    for (i = scan->part_count - 1; i >= 0; i--)
+    {
+        if (handle_scan_clip(&scan->parts[i], extent, &clipped))
+        {
+            handle = trove_ledger_handle_alloc_from_range(
+                ledger->ledger, &clipped);
+            if (handle != TROVE_HANDLE_NULL)
             {
-                gossip_debug(GOSSIP_TROVE_DEBUG,
-                             "* Trove: Assuming a blank filesystem\n");
-                return ret;
+                break;
             }
+        }
+    }
+    return handle;
+}
 
-            if (count > 0)
-            {
-                for(i = 0; i != count; i++)
-                {
-                    /* check every item in our range list */
-                    if (!PINT_handle_in_extent_list(extent_list,
-                                                    handles[i]))
-                    {
-                        gossip_err(
-                            "Error: handle %llu is invalid "
-                            "(out of bounds)\n", llu(handles[i]));
-                        return -1;
-                    }
+static int handle_scan_peek(handle_ledger_t *ledger,
+                            TROVE_extent *extent,
+                            TROVE_handle *out_handle_array,
+                            int max_num_handles,
+                            int *returned_handle_count)
+{
+    struct handle_scan *scan = ledger->scan;
+    TROVE_extent clipped;
+    int ret = -TROVE_ENOSPC, i = 0;
 
-		    /* remove handle from trove-handle-mgmt */
-		    ret = trove_handle_remove(ledger, handles[i]);
-		    if (ret != 0)
-                    {
-			gossip_err(
-                            "WARNING: could not remove "
-                            "handle %llu from ledger; continuing.\n", llu(handles[i]));
-		    }
-                }
-                ret = ((i == count) ? 0 : -1);
+    for (i = scan->part_count - 1; i >= 0; i--)
+    {
+        if (handle_scan_clip(&scan->parts[i], extent, &clipped))
+        {
+            ret = trove_ledger_peek_handles_from_extent(
+                ledger->ledger, &clipped, out_handle_array,
+                max_num_handles, returned_handle_count);
+            if (ret == 0)
+            {
+                break;
             }
         }
     }
     return ret;
 }
 
+/* trove_check_handle_ranges:
+ *  internal function to take the handles that are in use on disk out
+ *  of the ledger.  the handle ranges are split into partitions that
+ *  are scanned in handle order.  one batch of each partition is read
+ *  here, which finishes the partitions that hold few or no handles;
+ *  background threads scan the rest.  until then only the scanned
+ *  part of a partition is used for allocation.
+ *
+ * coll_id: id of collection which we will verify
+ * ledger: a book-keeping ledger object
+ *
+ * returns 0 on success; -1 otherwise
+ */
+static int trove_check_handle_ranges(TROVE_coll_id coll_id,
+                                     TROVE_context_id context_id,
+                                     handle_ledger_t *ledger)
+{
+    int ret = -1, i = 0, count = 0;
+    struct handle_scan *scan = NULL;
+    TROVE_handle *handles = NULL;
+
+    scan = handle_scan_create(ledger->ranges);
+    handles = malloc(MAX_NUM_VERIFY_HANDLE_COUNT * sizeof(TROVE_handle));
+    if (!scan || !handles)
+    {
+        if (scan)
+        {
+            handle_scan_free(scan);
+        }
+        free(handles);
+        return -TROVE_ENOMEM;
+    }
+    ledger->scan = scan;
+
+    for (i = 0; i < scan->part_count; i++)
+    {
+        ret = handle_scan_read(coll_id, context_id, &scan->parts[i],
+                               handles, &count);
+        if (ret == 0)
+        {
+            ret = handle_scan_apply(ledger, &scan->parts[i],
+                                    handles, count);
+        }
+        if (ret != 0)
+        {
+            ledger->scan = NULL;
+            handle_scan_free(scan);
+            free(handles);
+            return ret;
+        }
+    }
+    free(handles);
+
+    if (scan->parts_left == 0)
+    {
+        ledger->scan = NULL;
+        handle_scan_free(scan);
+        return 0;
+    }
+
+    gossip_debug(GOSSIP_TROVE_DEBUG, "scanning %d of %d handle range "
+                 "partitions of collection %d in the background\n",
+                 scan->parts_left, scan->part_count, (int)coll_id);
+
+    for (i = 0; i < TROVE_HANDLE_SCAN_THREADS && i < scan->parts_left; i++)
+    {
+        if (pthread_create(&scan->threads[scan->thread_count], NULL,
+                           handle_scan_thread, ledger) == 0)
+        {
+            scan->thread_count++;
+        }
+    }
+    if (scan->thread_count == 0)
+    {
+        gossip_err("Error: failed to start a handle scan thread\n");
+        return -1;
+    }
+    return 0;
+}
+
 static int trove_map_handle_ranges( PINT_llist *extent_list,
                                    struct handle_ledger *ledger)
 {
@@ -194,6 +598,10 @@ static handle_ledger_t *get_or_add_handle_ledger(TROVE_coll_id coll_id)
         {
             ledger->coll_id = coll_id;
             ledger->have_valid_ranges = 0;
+            ledger->ranges = NULL;
+            ledger->checkpoint = NULL;
+            ledger->checkpoint_len = 0;
+            ledger->scan = NULL;
             ledger->ledger = trove_handle_ledger_init(coll_id,NULL);
             if (ledger->ledger)
             {
@@ -295,7 +703,39 @@ int trove_set_handle_ranges(TROVE_coll_id coll_id,
             {
                 /* assert the internal ledger struct is valid */
                 assert(ledger->ledger);
-		
+
+                free(ledger->ranges);
+                ledger->ranges = strdup(handle_range_str);
+                if (!ledger->ranges)
+                {
+                    gen_mutex_unlock(&trove_handle_mutex);
+                    return -TROVE_ENOMEM;
+                }
+
+                /* a ledger saved at the last clean shutdown makes the
+                 * scan unnecessary */
+                if (ledger->checkpoint)
+                {
+                    ret = trove_handle_ledger_restore(
+                        ledger->ledger, handle_range_str,
+                        ledger->checkpoint, ledger->checkpoint_len);
+                    free(ledger->checkpoint);
+                    ledger->checkpoint = NULL;
+                    if (ret == 0)
+                    {
+                        gossip_debug(GOSSIP_TROVE_DEBUG,
+                                     "* Trove: restored handle ledger of "
+                                     "collection %d\n", (int)coll_id);
+                        ledger->have_valid_ranges = 1;
+                        PINT_release_extent_list(extent_list);
+                        gen_mutex_unlock(&trove_handle_mutex);
+                        return ret;
+                    }
+                    gossip_err("Warning: saved handle ledger does not "
+                               "match handle ranges %s; scanning\n",
+                               handle_range_str);
+                }
+
 		/* tell trove what are our valid ranges are */
 		ret = trove_map_handle_ranges(
                     extent_list, ledger->ledger);
@@ -306,7 +746,7 @@ int trove_set_handle_ranges(TROVE_coll_id coll_id,
                 }
 
                 ret = trove_check_handle_ranges(
-                    coll_id,context_id,extent_list,ledger->ledger);
+                    coll_id, context_id, ledger);
 		if (ret != 0)
                 {
                     gen_mutex_unlock(&trove_handle_mutex);
@@ -373,7 +813,9 @@ TROVE_handle trove_handle_alloc(TROVE_coll_id coll_id)
         ledger = qlist_entry(hash_link, handle_ledger_t, hash_link);
         if (ledger && (ledger->have_valid_ranges == 1))
         {
-            handle = trove_ledger_handle_alloc(ledger->ledger);
+            handle = (handle_scan_active(ledger) ?
+                      handle_scan_alloc(ledger, NULL) :
+                      trove_ledger_handle_alloc(ledger->ledger));
         }
     }
     gen_mutex_unlock(&trove_handle_mutex);
@@ -398,8 +840,12 @@ TROVE_handle trove_handle_alloc_from_range(
         {
             for(i = 0; i < extent_array->extent_count; i++)
             {
-                handle = trove_ledger_handle_alloc_from_range(
-                    ledger->ledger, &(extent_array->extent_array[i]));
+                handle = (handle_scan_active(ledger) ?
+                          handle_scan_alloc(
+                              ledger, &(extent_array->extent_array[i])) :
+                          trove_ledger_handle_alloc_from_range(
+                              ledger->ledger,
+                              &(extent_array->extent_array[i])));
                 if (handle != TROVE_HANDLE_NULL)
                 {
                     break;
@@ -433,9 +879,13 @@ int trove_handle_peek(
         ledger = qlist_entry(hash_link, handle_ledger_t, hash_link);
         if (ledger && (ledger->have_valid_ranges == 1))
         {
-            ret = trove_ledger_peek_handles(
-                ledger->ledger, out_handle_array,
-                max_num_handles, returned_handle_count);
+            ret = (handle_scan_active(ledger) ?
+                   handle_scan_peek(ledger, NULL, out_handle_array,
+                                    max_num_handles,
+                                    returned_handle_count) :
+                   trove_ledger_peek_handles(
+                       ledger->ledger, out_handle_array,
+                       max_num_handles, returned_handle_count));
         }
     }
     gen_mutex_unlock(&trove_handle_mutex);
@@ -467,10 +917,16 @@ int trove_handle_peek_from_range(
         {
             for(i = 0; i < extent_array->extent_count; i++)
             {
-                ret = trove_ledger_peek_handles_from_extent(
-                    ledger->ledger, &(extent_array->extent_array[i]),
-                    out_handle_array, max_num_handles,
-                    returned_handle_count);
+                ret = (handle_scan_active(ledger) ?
+                       handle_scan_peek(
+                           ledger, &(extent_array->extent_array[i]),
+                           out_handle_array, max_num_handles,
+                           returned_handle_count) :
+                       trove_ledger_peek_handles_from_extent(
+                           ledger->ledger,
+                           &(extent_array->extent_array[i]),
+                           out_handle_array, max_num_handles,
+                           returned_handle_count));
                 /*
                   if we get any handles back, just return, even if
                   it's not the full amount requested
@@ -518,7 +974,13 @@ int trove_handle_free(TROVE_coll_id coll_id, TROVE_handle handle)
     if (hash_link)
     {
         ledger = qlist_entry(hash_link, handle_ledger_t, hash_link);
-        if (ledger)
+        if (ledger && handle_scan_active(ledger) &&
+            !handle_scan_covers(ledger->scan, handle))
+        {
+            /* never taken out of the ledger; the scan will skip it */
+            ret = 0;
+        }
+        else if (ledger)
         {
             ret = trove_ledger_handle_free(ledger->ledger, handle);
         }
@@ -527,6 +989,74 @@ int trove_handle_free(TROVE_coll_id coll_id, TROVE_handle handle)
     return ret;
 }
 
+/* trove_handle_load_checkpoint()
+ *
+ * hands over a ledger saved by trove_handle_get_checkpoint() to be
+ * used instead of a scan by the next trove_set_handle_ranges() call
+ * for the collection.  takes ownership of buf.
+ *
+ * returns 0 on success, -TROVE_ENOMEM on error
+ */
+int trove_handle_load_checkpoint(TROVE_coll_id coll_id,
+                                 void *buf,
+                                 int len)
+{
+    handle_ledger_t *ledger = NULL;
+
+    gen_mutex_lock(&trove_handle_mutex);
+    ledger = get_or_add_handle_ledger(coll_id);
+    if (!ledger)
+    {
+        gen_mutex_unlock(&trove_handle_mutex);
+        free(buf);
+        return -TROVE_ENOMEM;
+    }
+    free(ledger->checkpoint);
+    ledger->checkpoint = buf;
+    ledger->checkpoint_len = len;
+    gen_mutex_unlock(&trove_handle_mutex);
+    return 0;
+}
+
+/* trove_handle_get_checkpoint()
+ *
+ * stops any handle scan of the collection and serializes its ledger
+ * into a buffer that the caller must free.  the ledger must not be
+ * used for allocation afterwards.
+ *
+ * returns 0 on success, -TROVE_EAGAIN if the scan had not finished,
+ * -TROVE_ENOENT if the collection has no ledger, other errors
+ * otherwise
+ */
+int trove_handle_get_checkpoint(TROVE_coll_id coll_id,
+                                void **out_buf,
+                                int *out_len)
+{
+    int ret = -TROVE_ENOENT;
+    handle_ledger_t *ledger = NULL;
+    struct qlist_head *hash_link = NULL;
+
+    gen_mutex_lock(&trove_handle_mutex);
+    hash_link = qhash_search(s_fsid_to_ledger_table,&(coll_id));
+    if (hash_link)
+    {
+        ledger = qlist_entry(hash_link, handle_ledger_t, hash_link);
+        if (ledger && (ledger->have_valid_ranges == 1))
+        {
+            if (ledger->scan)
+            {
+                handle_scan_stop(ledger);
+            }
+            ret = (ledger->scan ? -TROVE_EAGAIN :
+                   trove_handle_ledger_checkpoint(
+                       ledger->ledger, ledger->ranges,
+                       out_buf, out_len));
+        }
+    }
+    gen_mutex_unlock(&trove_handle_mutex);
+    return ret;
+}
+
 /* trove_handle_get_statistics()
  *
  * retrieves handle usage statistics from given collection; right now
@@ -587,7 +1117,17 @@ int trove_handle_mgmt_finalize()
                 assert(ledger);
                 assert(ledger->ledger);
 
+                if (ledger->scan)
+                {
+                    handle_scan_stop(ledger);
+                    if (ledger->scan)
+                    {
+                        handle_scan_free(ledger->scan);
+                    }
+                }
                 trove_handle_ledger_free(ledger->ledger);
+                free(ledger->ranges);
+                free(ledger->checkpoint);
                 free(ledger);
             }
         } while(hash_link);
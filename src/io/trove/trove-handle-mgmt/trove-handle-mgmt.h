@@ -9,6 +9,13 @@
 
 #define MAX_NUM_VERIFY_HANDLE_COUNT        4096
 
+/*
+  without a saved ledger the handle ranges are split into this many
+  partitions, scanned by up to this many background threads
+*/
+#define TROVE_HANDLE_SCAN_PARTS            64
+#define TROVE_HANDLE_SCAN_THREADS          4
+
 #define TROVE_DEFAULT_HANDLE_PURGATORY_SEC 360
 
 /*
@@ -77,6 +84,24 @@ int trove_handle_free(
 
 int trove_handle_mgmt_finalize(void);
 
+/*
+  a ledger saved with trove_handle_get_checkpoint at shutdown can be
+  handed back with trove_handle_load_checkpoint before the handle
+  ranges are set, which then skips the scan of the collection.
+  load takes ownership of the buffer; get allocates one that the
+  caller frees.  get returns -TROVE_EAGAIN if the scan had not
+  finished.
+*/
+int trove_handle_load_checkpoint(
+    TROVE_coll_id coll_id,
+    void *buf,
+    int len);
+
+int trove_handle_get_checkpoint(
+    TROVE_coll_id coll_id,
+    void **out_buf,
+    int *out_len);
+
 int trove_handle_get_statistics(
     TROVE_coll_id coll_id,
     uint64_t *free_count);
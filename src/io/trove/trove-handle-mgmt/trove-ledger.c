@@ -31,6 +31,26 @@ struct handle_ledger {
     uint64_t cutoff;	/* when to start trying to reuse handles */
 };
 
+/* handle_ledger_checkpoint
+ *
+ * header of the serialized form of a ledger.  it is followed by the
+ * handle range string the ledger was built for (padded to 8 bytes)
+ * and then by the extents of the free, recently freed and overflow
+ * lists, in that order.
+ */
+struct handle_ledger_checkpoint {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t ranges_len;    /* including the terminating null */
+    uint32_t reserved;
+    uint64_t cutoff;
+    uint64_t extent_count[3];
+};
+
+#define HANDLE_LEDGER_CHECKPOINT_MAGIC   0x4c444752
+#define HANDLE_LEDGER_CHECKPOINT_VERSION 1
+#define HANDLE_LEDGER_PAD8(__len)        (((__len) + 7) & ~7)
+
 /* Functions used only internally:
  */
 
@@ -104,6 +124,137 @@ int trove_handle_ledger_dump(struct handle_ledger *hl)
     return -1;
 }
 
+/* trove_handle_ledger_checkpoint()
+ *
+ * serializes the three extent lists of a ledger, tagged with the
+ * handle range string they were built for, into a buffer that the
+ * caller must free
+ *
+ * returns 0 on success, -TROVE_ENOMEM otherwise
+ */
+int trove_handle_ledger_checkpoint(struct handle_ledger *hl,
+                                   char *ranges,
+                                   void **out_buf,
+                                   int *out_len)
+{
+    struct TROVE_handle_extentlist *lists[3];
+    struct handle_ledger_checkpoint *hdr = NULL;
+    TROVE_extent *extents = NULL;
+    uint64_t ranges_len = strlen(ranges) + 1;
+    uint64_t len = 0;
+    int i = 0;
+
+    lists[0] = &hl->free_list;
+    lists[1] = &hl->recently_freed_list;
+    lists[2] = &hl->overflow_list;
+
+    len = sizeof(*hdr) + HANDLE_LEDGER_PAD8(ranges_len);
+    for (i = 0; i < 3; i++)
+    {
+        len += extentlist_num_extents(lists[i]) * sizeof(TROVE_extent);
+    }
+    if (len > INT32_MAX)
+    {
+        return -TROVE_ENOMEM;
+    }
+
+    hdr = calloc(1, len);
+    if (!hdr)
+    {
+        return -TROVE_ENOMEM;
+    }
+    hdr->magic = HANDLE_LEDGER_CHECKPOINT_MAGIC;
+    hdr->version = HANDLE_LEDGER_CHECKPOINT_VERSION;
+    hdr->ranges_len = ranges_len;
+    hdr->cutoff = hl->cutoff;
+    memcpy(hdr + 1, ranges, ranges_len);
+
+    extents = (TROVE_extent *)((char *)(hdr + 1) +
+                               HANDLE_LEDGER_PAD8(ranges_len));
+    for (i = 0; i < 3; i++)
+    {
+        hdr->extent_count[i] = extentlist_num_extents(lists[i]);
+        extentlist_export(lists[i], extents);
+        extents += hdr->extent_count[i];
+    }
+
+    *out_buf = hdr;
+    *out_len = (int)len;
+    return 0;
+}
+
+/* trove_handle_ledger_restore()
+ *
+ * refills an empty ledger from a buffer made by
+ * trove_handle_ledger_checkpoint().  the buffer is only accepted if
+ * it was made for the same handle ranges.
+ *
+ * returns 0 on success, -TROVE_EINVAL if the buffer does not belong
+ * to these ranges, -TROVE_ENOMEM otherwise.  the ledger is left empty
+ * on failure.
+ */
+int trove_handle_ledger_restore(struct handle_ledger *hl,
+                                char *ranges,
+                                void *buf,
+                                int len)
+{
+    struct TROVE_handle_extentlist *lists[3];
+    struct handle_ledger_checkpoint *hdr = buf;
+    TROVE_extent *extents = NULL;
+    uint64_t expected = 0;
+    int64_t j = 0;
+    int i = 0;
+
+    lists[0] = &hl->free_list;
+    lists[1] = &hl->recently_freed_list;
+    lists[2] = &hl->overflow_list;
+
+    if ((len < (int)sizeof(*hdr)) ||
+        (hdr->magic != HANDLE_LEDGER_CHECKPOINT_MAGIC) ||
+        (hdr->version != HANDLE_LEDGER_CHECKPOINT_VERSION) ||
+        (hdr->ranges_len != strlen(ranges) + 1))
+    {
+        return -TROVE_EINVAL;
+    }
+
+    expected = sizeof(*hdr) + HANDLE_LEDGER_PAD8(hdr->ranges_len);
+    for (i = 0; i < 3; i++)
+    {
+        expected += hdr->extent_count[i] * sizeof(TROVE_extent);
+    }
+    if ((expected != (uint64_t)len) ||
+        strcmp((char *)(hdr + 1), ranges))
+    {
+        return -TROVE_EINVAL;
+    }
+
+    extents = (TROVE_extent *)((char *)(hdr + 1) +
+                               HANDLE_LEDGER_PAD8(hdr->ranges_len));
+    for (i = 0; i < 3; i++)
+    {
+        for (j = 0; j < hdr->extent_count[i]; j++, extents++)
+        {
+            if (extentlist_addextent(lists[i], extents->first,
+                                     extents->last) != 0)
+            {
+                for (i = 0; i < 3; i++)
+                {
+                    extentlist_free(lists[i]);
+                    extentlist_init(lists[i]);
+                }
+                return -TROVE_ENOMEM;
+            }
+        }
+    }
+    hl->cutoff = hdr->cutoff;
+
+    /* handles that were waiting out their purgatory wait it out again
+     * from now */
+    gettimeofday(&hl->recently_freed_list.timestamp, NULL);
+    gettimeofday(&hl->overflow_list.timestamp, NULL);
+    return 0;
+}
+
 /* 
  * return all allocated memory back to the system
  */
@@ -33,6 +33,16 @@ void trove_handle_ledger_show(
     struct handle_ledger *hl);
 int trove_handle_ledger_dump(
     struct handle_ledger *hl);
+int trove_handle_ledger_checkpoint(
+    struct handle_ledger *hl,
+    char *ranges,
+    void **out_buf,
+    int *out_len);
+int trove_handle_ledger_restore(
+    struct handle_ledger *hl,
+    char *ranges,
+    void *buf,
+    int len);
 void trove_handle_ledger_free(
     struct handle_ledger *hl);
 int trove_handle_ledger_addextent(
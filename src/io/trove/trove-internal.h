@@ -115,6 +115,18 @@ struct TROVE_bstream_ops
          TROVE_coll_id coll_id,
          TROVE_op_id cancel_id,
          TROVE_context_id context_id);
+
+     /* optional; these are NULL for methods that have no file descriptor
+      * that can be read directly
+      */
+     int (*bstream_get_fd)(
+         TROVE_coll_id coll_id,
+         TROVE_handle handle,
+         int *out_fd_p,
+         void **out_fd_ref_p);
+
+     void (*bstream_put_fd)(
+         void *fd_ref);
 };
 
 struct TROVE_keyval_ops
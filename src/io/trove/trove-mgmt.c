@@ -26,6 +26,7 @@ extern struct TROVE_context_ops dbpf_context_ops;
 extern struct TROVE_bstream_ops alt_aio_bstream_ops;
 extern struct TROVE_bstream_ops null_aio_bstream_ops;
 extern struct TROVE_bstream_ops dbpf_bstream_direct_ops;
+extern struct TROVE_bstream_ops iouring_aio_bstream_ops;
 
 /* currently we only have one method for these tables to refer to */
 struct TROVE_mgmt_ops *mgmt_method_table[] =
@@ -33,8 +34,8 @@ struct TROVE_mgmt_ops *mgmt_method_table[] =
     &dbpf_mgmt_ops,
     &dbpf_mgmt_ops, /* alt-aio */
     &dbpf_mgmt_ops, /* null-aio */
-    &dbpf_mgmt_direct_ops  /* direct-io */
-
+    &dbpf_mgmt_direct_ops,  /* direct-io */
+    &dbpf_mgmt_ops  /* io-uring */
 };
 
 struct TROVE_dspace_ops *dspace_method_table[] =
@@ -42,7 +43,8 @@ struct TROVE_dspace_ops *dspace_method_table[] =
     &dbpf_dspace_ops,
     &dbpf_dspace_ops, /* alt-aio */
     &dbpf_dspace_ops, /* null-aio */
-    &dbpf_dspace_ops  /* direct-io */
+    &dbpf_dspace_ops, /* direct-io */
+    &dbpf_dspace_ops  /* io-uring */
 };
 
 struct TROVE_keyval_ops *keyval_method_table[] =
@@ -50,7 +52,8 @@ struct TROVE_keyval_ops *keyval_method_table[] =
     &dbpf_keyval_ops,
     &dbpf_keyval_ops, /* alt-aio */
     &dbpf_keyval_ops, /* null-aio */
-    &dbpf_keyval_ops  /* direct-io */
+    &dbpf_keyval_ops, /* direct-io */
+    &dbpf_keyval_ops  /* io-uring */
 };
 
 struct TROVE_bstream_ops *bstream_method_table[] =
@@ -58,7 +61,8 @@ struct TROVE_bstream_ops *bstream_method_table[] =
     &dbpf_bstream_ops,
     &alt_aio_bstream_ops,
     &null_aio_bstream_ops,
-    &dbpf_bstream_direct_ops
+    &dbpf_bstream_direct_ops,
+    &iouring_aio_bstream_ops
 };
 
 struct TROVE_context_ops *context_method_table[] =
@@ -66,7 +70,8 @@ struct TROVE_context_ops *context_method_table[] =
     &dbpf_context_ops,
     &dbpf_context_ops, /* alt-aio */
     &dbpf_context_ops, /* null-aio */
-    &dbpf_context_ops  /* direct-io */
+    &dbpf_context_ops, /* direct-io */
+    &dbpf_context_ops  /* io-uring */
 };
 
 /* trove_init_mutex, trove_init_status
@@ -31,9 +31,12 @@ extern struct TROVE_mgmt_ops    *mgmt_method_table[];
 /* this doesn't make much sense - why not pvfs2-server.c */
 struct PINT_perf_counter* PINT_server_pc = NULL;
 struct PINT_perf_counter* PINT_server_tpc = NULL;
+struct PINT_perf_counter* PINT_server_hpc = NULL;
 
 int TROVE_shm_key_hint = 0;
 int TROVE_max_concurrent_io = 16;
+int TROVE_meta_threads = 1;
+int TROVE_open_cache_size = 512;
 
 extern TROVE_method_callback global_trove_method_callback;
 
@@ -259,6 +262,44 @@ int trove_bstream_flush(
            hints);
 }
 
+/** Obtain a read-only file descriptor for the local storage backing a
+ *  bstream, so that its contents can be sent without first reading them
+ *  into a buffer.  Completes immediately.  The descriptor must be handed
+ *  back with trove_bstream_put_fd() and must not be closed by the caller.
+ *
+ *  \return 0 on success, -TROVE_ENOSYS if the method has no such
+ *  descriptor, -TROVE_ENOENT if no storage exists yet for the bstream.
+ */
+int trove_bstream_get_fd(
+    TROVE_coll_id coll_id,
+    TROVE_handle handle,
+    int *out_fd_p,
+    void **out_fd_ref_p)
+{
+    TROVE_method_id method_id;
+    method_id = global_trove_method_callback(coll_id);
+    if (!bstream_method_table[method_id]->bstream_get_fd)
+    {
+        return -TROVE_ENOSYS;
+    }
+    return bstream_method_table[method_id]->bstream_get_fd(
+           coll_id,
+           handle,
+           out_fd_p,
+           out_fd_ref_p);
+}
+
+/** Release a descriptor obtained with trove_bstream_get_fd().
+ */
+void trove_bstream_put_fd(
+    TROVE_coll_id coll_id,
+    void *fd_ref)
+{
+    TROVE_method_id method_id;
+    method_id = global_trove_method_callback(coll_id);
+    bstream_method_table[method_id]->bstream_put_fd(fd_ref);
+}
+
 /** Initiate read of a single keyword/value pair.
  */
 int trove_keyval_read(
@@ -1050,6 +1091,16 @@ int trove_collection_setinfo(
         TROVE_max_concurrent_io = *((int*)parameter);
         return(0);
     }
+    if(option == TROVE_META_THREADS)
+    {
+        TROVE_meta_threads = *((int*)parameter);
+        return(0);
+    }
+    if(option == TROVE_OPEN_CACHE_SIZE)
+    {
+        TROVE_open_cache_size = *((int*)parameter);
+        return(0);
+    }
     method_id = global_trove_method_callback(coll_id);
     return mgmt_method_table[method_id]->collection_setinfo(
            method_id,
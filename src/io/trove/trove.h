@@ -88,9 +88,16 @@ enum
     TROVE_COLLECTION_IMMEDIATE_COMPLETION,
     TROVE_DIRECTIO_THREADS_NUM,
     TROVE_DIRECTIO_OPS_PER_QUEUE,
-    TROVE_DIRECTIO_TIMEOUT
+    TROVE_DIRECTIO_TIMEOUT,
+    TROVE_META_THREADS,
+    TROVE_OPEN_CACHE_SIZE,
+    TROVE_COLLECTION_PACKED_BSTREAM_SIZE,
+    TROVE_COLLECTION_INLINE_BSTREAM_SIZE
 };
 
+/* largest bstream packed into a container when SmallFileSize is unset */
+#define TROVE_DEFAULT_PACKED_BSTREAM_SIZE 65536
+
 /** Initializes the Trove layer.  Must be called before any other Trove
  *  functions.
  */
@@ -250,6 +257,14 @@ int trove_bstream_flush(TROVE_coll_id coll_id,
 			TROVE_op_id *out_op_id_p,
             PVFS_hint hints);
 
+int trove_bstream_get_fd(TROVE_coll_id coll_id,
+                         TROVE_handle handle,
+                         int *out_fd_p,
+                         void **out_fd_ref_p);
+
+void trove_bstream_put_fd(TROVE_coll_id coll_id,
+                          void *fd_ref);
+
 int trove_keyval_read(
 		      TROVE_coll_id coll_id,
 		      TROVE_handle handle,
@@ -136,6 +136,14 @@ static void lebf_initialize(void)
                 reqsize = extra_size_PVFS_servreq_create;
                 respsize = extra_size_PVFS_servresp_create;
                 break;
+            case PVFS_SERV_CREATE_DIRENT:
+                zero_credential(&req.u.create_dirent.create.credential);
+                zero_capability(
+                    &resp.u.create_dirent.create.metafile_attrs.capability);
+                req.u.create_dirent.name = tmp_name;
+                reqsize = extra_size_PVFS_servreq_create_dirent;
+                respsize = extra_size_PVFS_servresp_create_dirent;
+                break;
             case PVFS_SERV_MIRROR:
                  req.u.mirror.dist = &tmp_dist;
                  req.u.mirror.dst_count = 0;
@@ -225,6 +233,12 @@ static void lebf_initialize(void)
                 resp.u.readdir.dirent_count = 0;
                 respsize = extra_size_PVFS_servresp_readdir;
                 break;
+            case PVFS_SERV_READDIRPLUS:
+                resp.u.readdirplus.readdir.directory_version = 0;
+                resp.u.readdirplus.readdir.dirent_count = 0;
+                resp.u.readdirplus.listattr.nhandles = 0;
+                respsize = extra_size_PVFS_servresp_readdirplus;
+                break;
             case PVFS_SERV_FLUSH:
                 /* nothing special */
                 break;
@@ -500,6 +514,7 @@ static int lebf_encode_req(
         /* call standard function defined in headers */
         CASE(PVFS_SERV_LOOKUP_PATH, lookup_path);
         CASE(PVFS_SERV_CREATE, create);
+        CASE(PVFS_SERV_CREATE_DIRENT, create_dirent);
         CASE(PVFS_SERV_MIRROR, mirror);
         CASE(PVFS_SERV_UNSTUFF, unstuff);
         CASE(PVFS_SERV_BATCH_CREATE, batch_create);
@@ -522,6 +537,7 @@ static int lebf_encode_req(
         CASE(PVFS_SERV_TRUNCATE, truncate);
         CASE(PVFS_SERV_MKDIR, mkdir);
         CASE(PVFS_SERV_READDIR, readdir);
+        CASE(PVFS_SERV_READDIRPLUS, readdirplus);
         CASE(PVFS_SERV_FLUSH, flush);
         CASE(PVFS_SERV_STATFS, statfs);
         CASE(PVFS_SERV_MGMT_SETPARAM, mgmt_setparam);
@@ -617,6 +633,7 @@ static int lebf_encode_resp(
         CASE(PVFS_SERV_GETCONFIG, getconfig);
         CASE(PVFS_SERV_LOOKUP_PATH, lookup_path);
         CASE(PVFS_SERV_CREATE, create);
+        CASE(PVFS_SERV_CREATE_DIRENT, create_dirent);
         CASE(PVFS_SERV_MIRROR, mirror);
         CASE(PVFS_SERV_UNSTUFF, unstuff);
         CASE(PVFS_SERV_BATCH_CREATE, batch_create);
@@ -627,6 +644,7 @@ static int lebf_encode_resp(
         CASE(PVFS_SERV_CHDIRENT, chdirent);
         CASE(PVFS_SERV_MKDIR, mkdir);
         CASE(PVFS_SERV_READDIR, readdir);
+        CASE(PVFS_SERV_READDIRPLUS, readdirplus);
         CASE(PVFS_SERV_STATFS, statfs);
         CASE(PVFS_SERV_MGMT_PERF_MON, mgmt_perf_mon);
         CASE(PVFS_SERV_MGMT_ITERATE_HANDLES, mgmt_iterate_handles);
@@ -728,6 +746,7 @@ static int lebf_decode_req(
         /* call standard function defined in headers */
         CASE(PVFS_SERV_LOOKUP_PATH, lookup_path);
         CASE(PVFS_SERV_CREATE, create);
+        CASE(PVFS_SERV_CREATE_DIRENT, create_dirent);
         CASE(PVFS_SERV_MIRROR, mirror);
         CASE(PVFS_SERV_UNSTUFF, unstuff);
         CASE(PVFS_SERV_BATCH_CREATE, batch_create);
@@ -750,6 +769,7 @@ static int lebf_decode_req(
         CASE(PVFS_SERV_TRUNCATE, truncate);
         CASE(PVFS_SERV_MKDIR, mkdir);
         CASE(PVFS_SERV_READDIR, readdir);
+        CASE(PVFS_SERV_READDIRPLUS, readdirplus);
         CASE(PVFS_SERV_FLUSH, flush);
         CASE(PVFS_SERV_STATFS, statfs);
         CASE(PVFS_SERV_MGMT_SETPARAM, mgmt_setparam);
@@ -835,6 +855,7 @@ static int lebf_decode_resp(
         CASE(PVFS_SERV_GETCONFIG, getconfig);
         CASE(PVFS_SERV_LOOKUP_PATH, lookup_path);
         CASE(PVFS_SERV_CREATE, create);
+        CASE(PVFS_SERV_CREATE_DIRENT, create_dirent);
         CASE(PVFS_SERV_MIRROR, mirror);
         CASE(PVFS_SERV_UNSTUFF, unstuff);
         CASE(PVFS_SERV_BATCH_CREATE, batch_create);
@@ -845,6 +866,7 @@ static int lebf_decode_resp(
         CASE(PVFS_SERV_CHDIRENT, chdirent);
         CASE(PVFS_SERV_MKDIR, mkdir);
         CASE(PVFS_SERV_READDIR, readdir);
+        CASE(PVFS_SERV_READDIRPLUS, readdirplus);
         CASE(PVFS_SERV_STATFS, statfs);
         CASE(PVFS_SERV_MGMT_PERF_MON, mgmt_perf_mon);
         CASE(PVFS_SERV_MGMT_ITERATE_HANDLES, mgmt_iterate_handles);
@@ -929,6 +951,42 @@ static void lebf_encode_rel(
     }
 }
 
+/* decode_free_listattr_resp()
+ *
+ * frees the arrays of a decoded listattr response, which is also part
+ * of the readdirplus response
+ */
+static void decode_free_listattr_resp(struct PVFS_servresp_listattr *la)
+{
+    int i;
+
+    if (la->error)
+        decode_free(la->error);
+    if (la->attr)
+    {
+        for (i = 0; i < la->nhandles; i++)
+        {
+            if (la->attr[i].mask & PVFS_ATTR_META_DIST)
+                decode_free(la->attr[i].u.meta.dist);
+            if (la->attr[i].mask & PVFS_ATTR_META_DFILES)
+                decode_free(la->attr[i].u.meta.dfile_array);
+            if (la->attr[i].mask & PVFS_ATTR_META_MIRROR_DFILES)
+                decode_free(la->attr[i].u.meta.mirror_dfile_array);
+            if (la->attr[i].mask & PVFS_ATTR_CAPABILITY)
+            {
+                decode_free(la->attr[i].capability.handle_array);
+                decode_free(la->attr[i].capability.signature);
+            }
+            if (la->attr[i].mask & PVFS_ATTR_DISTDIR_ATTR)
+            {
+                decode_free(la->attr[i].dist_dir_bitmap);
+                decode_free(la->attr[i].dirdata_handles);
+            }
+        }
+        decode_free(la->attr);
+    }
+}
+
 /* lebf_decode_rel()
  *
  * releases resources consumed while decoding
@@ -960,6 +1018,20 @@ static void lebf_decode_rel(struct PINT_decoded_msg *msg,
                 decode_free(
                     req->u.batch_create.handle_extent_array.extent_array);
                 break;
+            case PVFS_SERV_CREATE_DIRENT:
+                decode_free(
+                    req->u.create_dirent.create.credential.group_array);
+                decode_free(req->u.create_dirent.create.credential.signature);
+#ifdef ENABLE_SECURITY_CERT
+                decode_free(
+                    req->u.create_dirent.create.credential.certificate.buf);
+#endif
+                if (req->u.create_dirent.create.attr.mask & PVFS_ATTR_META_DIST)
+                    decode_free(req->u.create_dirent.create.attr.u.meta.dist);
+                if (req->u.create_dirent.create.layout.server_list.servers)
+                    decode_free(
+                        req->u.create_dirent.create.layout.server_list.servers);
+                break;
 
             case PVFS_SERV_IO:
                 decode_free(req->u.io.io_dist);
@@ -1138,6 +1210,7 @@ static void lebf_decode_rel(struct PINT_decoded_msg *msg,
             case PVFS_SERV_CHDIRENT:
             case PVFS_SERV_TRUNCATE:
             case PVFS_SERV_READDIR:
+            case PVFS_SERV_READDIRPLUS:
             case PVFS_SERV_FLUSH:
             case PVFS_SERV_MGMT_SETPARAM:
             case PVFS_SERV_MGMT_NOOP:
@@ -1187,6 +1260,11 @@ static void lebf_decode_rel(struct PINT_decoded_msg *msg,
                     decode_free(resp->u.readdir.dirent_array);
                     break;
 
+                case PVFS_SERV_READDIRPLUS:
+                    decode_free(resp->u.readdirplus.readdir.dirent_array);
+                    decode_free_listattr_resp(&resp->u.readdirplus.listattr);
+                    break;
+
                 case PVFS_SERV_MGMT_PERF_MON:
                     decode_free(resp->u.mgmt_perf_mon.perf_array);
                     break;
@@ -1211,6 +1289,22 @@ static void lebf_decode_rel(struct PINT_decoded_msg *msg,
                        }
                     break;
 
+                case PVFS_SERV_CREATE_DIRENT:
+                    {
+                        PVFS_object_attr *attr =
+                            &resp->u.create_dirent.create.metafile_attrs;
+                        if (attr->mask & PVFS_ATTR_CAPABILITY)
+                        {
+                            decode_free(attr->capability.signature);
+                            decode_free(attr->capability.handle_array);
+                        }
+                        if (attr->mask & PVFS_ATTR_META_DFILES)
+                        {
+                            decode_free(attr->u.meta.dfile_array);
+                        }
+                    }
+                    break;
+
                 case PVFS_SERV_MGMT_DSPACE_INFO_LIST:
                     decode_free(resp->u.mgmt_dspace_info_list.dspace_info_array);
                     break;
@@ -1277,44 +1371,8 @@ static void lebf_decode_rel(struct PINT_decoded_msg *msg,
                         decode_free(resp->u.listeattr.key);
                     break;
                 case PVFS_SERV_LISTATTR:
-                    {
-                     int i;
-                     if (resp->u.listattr.error)
-                         decode_free(resp->u.listattr.error);
-                     if (resp->u.listattr.attr) {
-                         for (i = 0; i < resp->u.listattr.nhandles; i++) {
-                          if (resp->u.listattr.attr[i].mask &
-                                   PVFS_ATTR_META_DIST)
-                           decode_free(resp->u.listattr.attr[i].u.meta.dist);
-                          if (resp->u.listattr.attr[i].mask &
-                                   PVFS_ATTR_META_DFILES)
-                          {
-                           decode_free(
-                              resp->u.listattr.attr[i].u.meta.dfile_array);
-                          }
-                          if(resp->u.listattr.attr[i].mask &
-                             PVFS_ATTR_META_MIRROR_DFILES)
-                            decode_free(
-                          resp->u.listattr.attr[i].u.meta.mirror_dfile_array);
-                          if (resp->u.listattr.attr[i].mask & 
-                              PVFS_ATTR_CAPABILITY) {
-                           decode_free(
-                             resp->u.listattr.attr[i].capability.handle_array);
-                           decode_free(
-                             resp->u.listattr.attr[i].capability.signature);
-                          }
-                          if (resp->u.listattr.attr[i].mask & 
-                              PVFS_ATTR_DISTDIR_ATTR) {
-                           decode_free(
-                             resp->u.listattr.attr[i].dist_dir_bitmap);
-                           decode_free(
-                             resp->u.listattr.attr[i].dirdata_handles);
-                          }
-                         }/*end for*/
-                         decode_free(resp->u.listattr.attr);
-                     }/*end if attr*/
-                        break;
-                    }/*end case*/
+                    decode_free_listattr_resp(&resp->u.listattr);
+                    break;
 
                 case PVFS_SERV_MIRROR:
                    {
@@ -98,6 +98,8 @@ enum PVFS_server_op
     PVFS_SERV_TREE_GETATTR = 49,
     PVFS_SERV_MGMT_GET_USER_CERT = 50,
     PVFS_SERV_MGMT_GET_USER_CERT_KEYREQ = 51,
+    PVFS_SERV_CREATE_DIRENT = 52,
+    PVFS_SERV_READDIRPLUS = 53,
 
     /* leave this entry last */
     PVFS_SERV_NUM_OPS
@@ -1110,6 +1112,82 @@ do {                                                      \
     (__req).u.crdirent.fs_id = (__fs_id);                 \
 } while (0)
 
+/* create_dirent ***********************************************/
+/* - creates a file as PVFS_SERV_CREATE does and then adds its entry to
+ * a directory, on a server that holds the directory's dirdata handle.
+ * Saves the client a round trip per file.
+ */
+
+struct PVFS_servreq_create_dirent
+{
+    struct PVFS_servreq_create create;
+    char *name;                 /* name of new entry */
+    PVFS_handle parent_handle;  /* handle of directory */
+    PVFS_handle dirent_handle;  /* handle of directory entries */
+};
+/* NOTE: create is encoded last because its layout must stay the final
+ * field on the wire
+ */
+endecode_fields_4_struct(
+    PVFS_servreq_create_dirent,
+    string, name,
+    PVFS_handle, parent_handle,
+    PVFS_handle, dirent_handle,
+    PVFS_servreq_create, create);
+#define extra_size_PVFS_servreq_create_dirent \
+    (extra_size_PVFS_servreq_create +         \
+     roundup8(PVFS_REQ_LIMIT_SEGMENT_BYTES+1))
+
+#define PINT_SERVREQ_CREATE_DIRENT_FILL(__req,                       \
+                                        __cap,                       \
+                                        __cred,                      \
+                                        __fsid,                      \
+                                        __attr,                      \
+                                        __num_dfiles_req,            \
+                                        __layout,                    \
+                                        __name,                      \
+                                        __parent_handle,             \
+                                        __dirent_handle,             \
+                                        __hints)                     \
+do {                                                                 \
+    int mask;                                                        \
+    memset(&(__req), 0, sizeof(__req));                              \
+    (__req).op = PVFS_SERV_CREATE_DIRENT;                            \
+    PVFS_REQ_COPY_CAPABILITY((__cap), (__req));                      \
+    (__req).hints = (__hints);                                       \
+    (__req).u.create_dirent.create.fs_id = (__fsid);                 \
+    (__req).u.create_dirent.create.credential = (__cred);            \
+    (__req).u.create_dirent.create.num_dfiles_req =                  \
+        (__num_dfiles_req);                                          \
+    (__attr).objtype = PVFS_TYPE_METAFILE;                           \
+    mask = (__attr).mask;                                            \
+    (__attr).mask = PVFS_ATTR_COMMON_ALL;                            \
+    (__attr).mask |= PVFS_ATTR_SYS_TYPE;                             \
+    PINT_copy_object_attr(&(__req).u.create_dirent.create.attr,      \
+                          &(__attr));                                \
+    (__req).u.create_dirent.create.attr.mask |= mask;                \
+    (__req).u.create_dirent.create.layout = __layout;                \
+    (__req).u.create_dirent.name = (__name);                         \
+    (__req).u.create_dirent.parent_handle = (__parent_handle);       \
+    (__req).u.create_dirent.dirent_handle = (__dirent_handle);       \
+} while (0)
+
+/* the file is reported even if adding its entry failed, so that the
+ * client can remove it or retry the entry on its own
+ */
+struct PVFS_servresp_create_dirent
+{
+    struct PVFS_servresp_create create;
+    PVFS_error dirent_status;   /* result of adding the entry */
+};
+endecode_fields_3_struct(
+    PVFS_servresp_create_dirent,
+    PVFS_error, dirent_status,
+    skip4,,
+    PVFS_servresp_create, create);
+#define extra_size_PVFS_servresp_create_dirent \
+    extra_size_PVFS_servresp_create
+
 /* rmdirent ****************************************************/
 /* - removes an existing directory entry */
 
@@ -1773,6 +1851,60 @@ endecode_fields_1aa_struct(
 #define extra_size_PVFS_servresp_listattr \
     ((PVFS_REQ_LIMIT_LISTATTR * sizeof(PVFS_error)) + (PVFS_REQ_LIMIT_LISTATTR * extra_size_PVFS_object_attr))
 
+/* readdirplus *************************************************/
+/* - reads entries from a directory as readdir does, and also returns
+ * the attributes of each entry whose metadata is held by the same
+ * server.  The error of an entry is set when its attributes could not
+ * be read here, usually because the entry lives on another server.
+ */
+
+struct PVFS_servreq_readdirplus
+{
+    struct PVFS_servreq_readdir readdir;
+    uint32_t attrmask;      /* mask of desired attributes */
+};
+endecode_fields_3_struct(
+    PVFS_servreq_readdirplus,
+    uint32_t, attrmask,
+    skip4,,
+    PVFS_servreq_readdir, readdir);
+
+#define PINT_SERVREQ_READDIRPLUS_FILL(__req,                        \
+                                      __cap,                        \
+                                      __fsid,                       \
+                                      __handle,                     \
+                                      __token,                      \
+                                      __dirent_count,               \
+                                      __amask,                      \
+                                      __hints)                      \
+do {                                                                \
+    memset(&(__req), 0, sizeof(__req));                             \
+    (__req).op = PVFS_SERV_READDIRPLUS;                             \
+    PVFS_REQ_COPY_CAPABILITY((__cap), (__req));                     \
+    (__req).hints = (__hints);                                      \
+    (__req).u.readdirplus.readdir.fs_id = (__fsid);                 \
+    (__req).u.readdirplus.readdir.handle = (__handle);              \
+    (__req).u.readdirplus.readdir.token = (__token);                \
+    (__req).u.readdirplus.readdir.dirent_count = (__dirent_count);  \
+    (__req).u.readdirplus.attrmask = (__amask);                     \
+} while (0)
+
+/* listattr.nhandles is either 0 or readdir.dirent_count, and entry i
+ * of the attribute arrays belongs to dirent i
+ */
+struct PVFS_servresp_readdirplus
+{
+    struct PVFS_servresp_readdir readdir;
+    struct PVFS_servresp_listattr listattr;
+};
+endecode_fields_2_struct(
+    PVFS_servresp_readdirplus,
+    PVFS_servresp_readdir, readdir,
+    PVFS_servresp_listattr, listattr);
+#define extra_size_PVFS_servresp_readdirplus                         \
+    ((PVFS_REQ_LIMIT_DIRENT_COUNT_READDIRPLUS * sizeof(PVFS_dirent)) + \
+     extra_size_PVFS_servresp_listattr)
+
 
 /* mgmt_setparam ****************************************************/
 /* - management operation for setting runtime parameters */
@@ -1876,8 +2008,16 @@ endecode_fields_5a_struct(
     uint32_t, sample_count,
     uint32_t, perf_array_count,
     int64_t,  perf_array);
+/* room for two samples of the latency histograms, the largest counter
+ * type; perf_mon_do_work trims the sample count to fit.  Only histogram
+ * requests, which older clients never send, may use all of it: other
+ * counter types stay within PVFS_REQ_LIMIT_PERF_MON_BYTES, the limit
+ * older clients size their receive buffers from.
+ */
+#define PVFS_REQ_LIMIT_PERF_MON_BYTES (PVFS_REQ_LIMIT_IOREQ_BYTES)
 #define extra_size_PVFS_servresp_mgmt_perf_mon \
-    (PVFS_REQ_LIMIT_IOREQ_BYTES)
+    (2 * ((PINT_PERF_HKEY_COUNT * sizeof(struct PINT_perf_histogram)) + \
+          (2 * sizeof(int64_t))))
 
 /* mgmt_iterate_handles ***************************************/
 /* iterates through handles stored on server */
@@ -2571,8 +2711,10 @@ struct PVFS_server_req
         struct PVFS_servreq_setattr setattr;
         struct PVFS_servreq_mkdir mkdir;
         struct PVFS_servreq_readdir readdir;
+        struct PVFS_servreq_readdirplus readdirplus;
         struct PVFS_servreq_lookup_path lookup_path;
         struct PVFS_servreq_crdirent crdirent;
+        struct PVFS_servreq_create_dirent create_dirent;
         struct PVFS_servreq_rmdirent rmdirent;
         struct PVFS_servreq_chdirent chdirent;
         struct PVFS_servreq_truncate truncate;
@@ -2637,11 +2779,13 @@ struct PVFS_server_resp
     {
         struct PVFS_servresp_mirror mirror;
         struct PVFS_servresp_create create;
+        struct PVFS_servresp_create_dirent create_dirent;
         struct PVFS_servresp_unstuff unstuff;
         struct PVFS_servresp_batch_create batch_create;
         struct PVFS_servresp_getattr getattr;
         struct PVFS_servresp_mkdir mkdir;
         struct PVFS_servresp_readdir readdir;
+        struct PVFS_servresp_readdirplus readdirplus;
         struct PVFS_servresp_lookup_path lookup_path;
         struct PVFS_servresp_rmdirent rmdirent;
         struct PVFS_servresp_chdirent chdirent;
@@ -202,6 +202,10 @@ static int precreate_pool_count(
 
 static TROVE_method_id trove_coll_to_method_callback(TROVE_coll_id);
 
+#ifndef __PVFS2_DISABLE_PERF_COUNTERS__
+static int server_perf_hist_key(enum PVFS_server_op op);
+#endif
+
 
 
 int main(int argc, char **argv)
@@ -792,6 +796,8 @@ static int server_initialize_subsystems(
     PVFS_ds_flags init_flags = 0;
     int bmi_flags = BMI_INIT_SERVER;
     int server_index;
+    int packed_bstream_size;
+    int inline_bstream_size;
 
     if(server_config.enable_events)
     {
@@ -869,6 +875,16 @@ static int server_initialize_subsystems(
                  (void *)&server_config.tcp_buffer_size_send);
     BMI_set_info(0, BMI_TCP_BUFFER_RECEIVE_SIZE, 
                  (void *)&server_config.tcp_buffer_size_receive);
+    if (server_config.tcp_progress_threads > 0)
+    {
+        ret = BMI_set_info(0, BMI_TCP_PROGRESS_THREADS,
+                           (void *)&server_config.tcp_progress_threads);
+        if (ret < 0)
+        {
+            PVFS_perror_gossip("Error: starting TCP progress threads", ret);
+            return ret;
+        }
+    }
 
     *server_status_flag |= SERVER_BMI_INIT;
 
@@ -891,6 +907,14 @@ static int server_initialize_subsystems(
     /* this should never fail */
     assert(ret == 0);
 
+    ret = trove_collection_setinfo(0, 0, TROVE_META_THREADS,
+                                   &server_config.trove_meta_threads);
+    assert(ret == 0);
+
+    ret = trove_collection_setinfo(0, 0, TROVE_OPEN_CACHE_SIZE,
+                                   &server_config.trove_open_cache_size);
+    assert(ret == 0);
+
     generate_shm_key_hint(&server_index);
 
 /********/
@@ -932,6 +956,18 @@ static int server_initialize_subsystems(
 
     *server_status_flag |= SERVER_FLOW_INIT;
 
+    if (server_config.flow_zero_copy_reads)
+    {
+        PINT_flow_setinfo(NULL, FLOWPROTO_ZERO_COPY_READS,
+                          (void *)&server_config.flow_zero_copy_reads);
+    }
+
+    if (server_config.flow_buffer_budget_mb)
+    {
+        PINT_flow_setinfo(NULL, FLOWPROTO_BUFFER_BUDGET,
+                          (void *)&server_config.flow_buffer_budget_mb);
+    }
+
     cur = server_config.file_systems;
     while(cur)
     {
@@ -1170,6 +1206,59 @@ static int server_initialize_subsystems(
                 return ret;
             } 
 
+            /* set even when packing is off, so that bstreams packed
+             * before are still found
+             */
+            packed_bstream_size = 0;
+            if(cur_fs->trove_packed_bstreams)
+            {
+                if(cur_fs->trove_method == TROVE_METHOD_DBPF_DIRECTIO)
+                {
+                    gossip_err("Warning: TrovePackedBstreams is not "
+                               "supported with the directio TroveMethod; "
+                               "ignoring it for %s\n",
+                               cur_fs->file_system_name);
+                }
+                else
+                {
+                    packed_bstream_size = (cur_fs->small_file_size > 0) ?
+                        cur_fs->small_file_size :
+                        TROVE_DEFAULT_PACKED_BSTREAM_SIZE;
+                }
+            }
+            ret = trove_collection_setinfo(
+                                  cur_fs->coll_id,
+                                  trove_context,
+                                  TROVE_COLLECTION_PACKED_BSTREAM_SIZE,
+                                  (void *)&packed_bstream_size);
+            if(ret < 0)
+            {
+                gossip_err("Error setting up packed bstreams\n");
+                return ret;
+            }
+
+            /* likewise for bstreams kept inline */
+            inline_bstream_size = cur_fs->trove_inline_bstream_size;
+            if(inline_bstream_size > 0 &&
+               cur_fs->trove_method == TROVE_METHOD_DBPF_DIRECTIO)
+            {
+                gossip_err("Warning: TroveInlineBstreamSize is not "
+                           "supported with the directio TroveMethod; "
+                           "ignoring it for %s\n",
+                           cur_fs->file_system_name);
+                inline_bstream_size = 0;
+            }
+            ret = trove_collection_setinfo(
+                                  cur_fs->coll_id,
+                                  trove_context,
+                                  TROVE_COLLECTION_INLINE_BSTREAM_SIZE,
+                                  (void *)&inline_bstream_size);
+            if(ret < 0)
+            {
+                gossip_err("Error setting up inline bstreams\n");
+                return ret;
+            }
+
             gossip_debug(GOSSIP_SERVER_DEBUG, "File system %s using "
                          "handles:\n\t%s\n", cur_fs->file_system_name,
                          cur_merged_handle_range);
@@ -1262,7 +1351,11 @@ static int server_initialize_subsystems(
     PINT_server_tpc = PINT_perf_initialize(PINT_PERF_TIMER,
                                            server_tkeys, 
                                            server_perf_start_rollover);
-    if(!PINT_server_pc || !PINT_server_tpc)
+
+    PINT_server_hpc = PINT_perf_initialize(PINT_PERF_HISTOGRAM,
+                                           server_hkeys,
+                                           server_perf_start_rollover);
+    if(!PINT_server_pc || !PINT_server_tpc || !PINT_server_hpc)
     {
         gossip_err("Error initializing performance counters.\n");
         return(ret);
@@ -1285,6 +1378,14 @@ static int server_initialize_subsystems(
             gossip_err("Error PINT_perf_set_info (update interval)\n");
             return(ret);
         }
+        ret = PINT_perf_set_info(PINT_server_hpc,
+                                 PINT_PERF_UPDATE_INTERVAL,
+                                 server_config.perf_update_interval);
+        if (ret < 0)
+        {
+            gossip_err("Error PINT_perf_set_info (update interval)\n");
+            return(ret);
+        }
     }
     if (server_config.perf_update_history > 0)
     {
@@ -1304,6 +1405,14 @@ static int server_initialize_subsystems(
             gossip_err("Error PINT_perf_set_info (update history)\n");
             return(ret);
         }
+        ret = PINT_perf_set_info(PINT_server_hpc,
+                                 PINT_PERF_UPDATE_HISTORY,
+                                 server_config.perf_update_history);
+        if (ret < 0)
+        {
+            gossip_err("Error PINT_perf_set_info (update history)\n");
+            return(ret);
+        }
     }
     /* if history_size is greater than 1, start the rollover SM */
     if (PINT_server_pc->running)
@@ -1979,6 +2088,7 @@ static int server_shutdown(PINT_server_status_flag status,
                      "interface     [   ...   ]\n");
         PINT_perf_finalize(PINT_server_pc);
         PINT_perf_finalize(PINT_server_tpc);
+        PINT_perf_finalize(PINT_server_hpc);
         gossip_debug(GOSSIP_SERVER_DEBUG, "[-]         performance "
                      "interface     [ stopped ]\n");
     }
@@ -2430,6 +2540,10 @@ int server_state_machine_start(
          * normal requests
          */
         PINT_perf_timer_start(&s_op->start_time);
+        /* the per-op timers clear start_time when they fire, so the
+         * latency histogram keeps its own copy until completion
+         */
+        s_op->hist_start_time = s_op->start_time;
     }
 
     s_op->addr = s_op->unexp_bmi_buff.addr;
@@ -2581,6 +2695,10 @@ int server_state_machine_complete(PINT_smcb *smcb)
                        NULL,
                        s_op->event_id,
                        0);
+
+        PINT_perf_histogram_end(PINT_server_hpc,
+                                server_perf_hist_key(s_op->op),
+                                &s_op->hist_start_time);
     }
 
     /* release the decoding of the unexpected request */
@@ -2669,6 +2787,59 @@ static TROVE_method_id trove_coll_to_method_callback(TROVE_coll_id coll_id)
     return fs_config->trove_method;
 }
 
+#ifndef __PVFS2_DISABLE_PERF_COUNTERS__
+/* server_perf_hist_key()
+ *
+ * maps a request type to the latency histogram it is recorded in
+ */
+static int server_perf_hist_key(enum PVFS_server_op op)
+{
+    switch (op)
+    {
+        case PVFS_SERV_LOOKUP_PATH:
+            return PINT_PERF_HLOOKUP;
+        case PVFS_SERV_CREATE:
+        case PVFS_SERV_BATCH_CREATE:
+        case PVFS_SERV_CREATE_DIRENT:
+            return PINT_PERF_HCREATE;
+        case PVFS_SERV_REMOVE:
+        case PVFS_SERV_BATCH_REMOVE:
+        case PVFS_SERV_TREE_REMOVE:
+            return PINT_PERF_HREMOVE;
+        case PVFS_SERV_MKDIR:
+            return PINT_PERF_HMKDIR;
+        case PVFS_SERV_GETATTR:
+        case PVFS_SERV_TREE_GETATTR:
+        case PVFS_SERV_TREE_GET_FILE_SIZE:
+            return PINT_PERF_HGETATTR;
+        case PVFS_SERV_SETATTR:
+        case PVFS_SERV_TREE_SETATTR:
+            return PINT_PERF_HSETATTR;
+        case PVFS_SERV_CRDIRENT:
+            return PINT_PERF_HCRDIRENT;
+        case PVFS_SERV_RMDIRENT:
+            return PINT_PERF_HRMDIRENT;
+        case PVFS_SERV_IO:
+            return PINT_PERF_HIO;
+        case PVFS_SERV_SMALL_IO:
+            return PINT_PERF_HSMALL_IO;
+        case PVFS_SERV_READDIR:
+        case PVFS_SERV_READDIRPLUS:
+            return PINT_PERF_HREADDIR;
+        case PVFS_SERV_LISTATTR:
+            return PINT_PERF_HLISTATTR;
+        case PVFS_SERV_GETEATTR:
+        case PVFS_SERV_SETEATTR:
+        case PVFS_SERV_DELEATTR:
+        case PVFS_SERV_LISTEATTR:
+        case PVFS_SERV_ATOMICEATTR:
+            return PINT_PERF_HEATTR;
+        default:
+            return PINT_PERF_HOTHER;
+    }
+}
+#endif
+
 #ifndef GOSSIP_DISABLE_DEBUG
 
 /* sampson: new capability-based version */
@@ -2795,6 +2966,7 @@ int server_perf_start_rollover(struct PINT_perf_counter *pc,
     s_op = PINT_sm_frame(tmp_op, PINT_FRAME_CURRENT);
     s_op->u.perf_update.pc = pc;
     s_op->u.perf_update.tpc = tpc;
+    s_op->u.perf_update.hpc = PINT_server_hpc;
 
     ret = server_state_machine_start_noreq(tmp_op);
 
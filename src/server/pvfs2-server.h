@@ -365,6 +365,13 @@ struct PINT_server_readdir_op
     PVFS_handle dirent_handle;  /* holds handle of dirdata dspace from
                                    which entries are read */
     PVFS_size dirdata_size;
+    /* readdirplus only: attributes of the entries read */
+    PVFS_handle *handles;
+    PVFS_object_attr *attr_a;
+    PVFS_ds_attributes *ds_attr_a;
+    PVFS_error *errors;
+    int attr_count;
+    int parallel_sms;
 };
 
 typedef struct
@@ -628,6 +635,7 @@ struct PINT_server_perf_update_op
 {
     struct PINT_perf_counter *pc;
     struct PINT_perf_counter *tpc;
+    struct PINT_perf_counter *hpc;
 };
 
 /* This structure is passed into the void *ptr 
@@ -645,6 +653,7 @@ typedef struct PINT_server_op
     /* variables used for monitoring and timing requests */
     PINT_event_id event_id;
     struct timespec start_time;     /* start time of a timer in ns */
+    struct timespec hist_start_time; /* start time for latency histogram */
 
     /* holds id from request scheduler so we can release it later */
     job_id_t scheduled_id; 
@@ -914,6 +923,7 @@ extern struct PINT_state_machine_s pvfs2_remove_work_sm;
 extern struct PINT_state_machine_s pvfs2_remove_with_prelude_sm;
 extern struct PINT_state_machine_s pvfs2_mkdir_work_sm;
 extern struct PINT_state_machine_s pvfs2_crdirent_work_sm;
+extern struct PINT_state_machine_s pvfs2_create_work_sm;
 extern struct PINT_state_machine_s pvfs2_unexpected_sm;
 extern struct PINT_state_machine_s pvfs2_create_immutable_copies_sm;
 extern struct PINT_state_machine_s pvfs2_mirror_work_sm;
@@ -927,6 +937,7 @@ extern void tree_getattr_free(PINT_server_op *s_op);
 extern void tree_setattr_free(PINT_server_op *s_op);
 extern void tree_remove_free(PINT_server_op *s_op);
 extern void mkdir_free(struct PINT_server_op *s_op);
+extern void crdirent_free(struct PINT_server_op *s_op);
 extern void getattr_free(struct PINT_server_op *s_op);
 
 /* Exported Prototypes */
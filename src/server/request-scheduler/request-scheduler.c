@@ -15,7 +15,10 @@
  *
  *  \note this is a prototype.  It simply hashes on the handle
  *  value in the request and builds a linked list for each handle.
- *  Only the request at the head of each list is allowed to proceed.
+ *  Only the request at the head of each list is allowed to proceed,
+ *  along with any requests behind it that can share the handle.  The
+ *  handle table is split into separately locked shards so that posts
+ *  and releases on different handles do not contend.
  */
 
 /* LONG TERM
@@ -37,7 +40,9 @@
 #include "pvfs2-debug.h"
 #include "gossip.h"
 #include "id-generator.h"
+#include "gen-locks.h"
 #include "pvfs2-internal.h"
+#include "pint-slab.h"
 
 /* we need the server header because it defines the operations that
  * we use to determine whether to schedule or queue.  
@@ -57,13 +62,22 @@ enum req_sched_states
     /** request is being processed */
     REQ_SCHEDULED,
     /** request could be processed, but caller has not asked for it
-     * yet 
+     * yet
      */
     REQ_READY_TO_SCHEDULE,
     /** for timer events */
     REQ_TIMING,
 };
 
+/** ways in which requests on the same handle may share it */
+enum req_sched_share
+{
+    /** I/O requests may overlap with each other */
+    REQ_SHARE_IO = 1,
+    /** read only requests may overlap with each other */
+    REQ_SHARE_READONLY = 2
+};
+
 /** linked lists to be stored at each hash table element */
 struct req_sched_list
 {
@@ -72,6 +86,8 @@ struct req_sched_list
     PVFS_handle handle;
 };
 
+struct req_sched_shard;
+
 /** linked list elements; one for each request in the scheduler */
 struct req_sched_element
 {
@@ -81,6 +97,7 @@ struct req_sched_element
     void *user_ptr;		/* user pointer */
     req_sched_id id;		/* unique identifier */
     struct req_sched_list *list_head;	/* points to head of queue */
+    struct req_sched_shard *shard;	/* shard holding list_head, if any */
     enum req_sched_states state;	/* state of this element */
     PVFS_handle handle;
     struct timeval tv;			/* used for timer events */
@@ -90,12 +107,43 @@ struct req_sched_element
     enum PVFS_server_mode mode; /* the mode to change to */
 };
 
+/* number of independently locked pieces of the handle table */
+#define REQ_SCHED_SHARDS 16
+/* hash table size within each shard */
+#define REQ_SCHED_SHARD_TABLE_SIZE 127
+/* most unused lists and elements kept by each shard for reuse */
+#define REQ_SCHED_SHARD_CACHE_MAX 256
+
+/** one piece of the handle table.  Each handle maps to exactly one
+ *  shard, and the shard mutex protects the queues of its handles, the
+ *  state of the elements on them, and its caches.
+ */
+struct req_sched_shard
+{
+    gen_mutex_t mutex;
+    struct qhash_table *table;
+    struct qlist_head free_lists;
+    int free_list_count;
+    struct qlist_head free_elements;
+    int free_element_count;
+};
+
+static struct req_sched_shard req_sched_shards[REQ_SCHED_SHARDS];
 
-/* hash table */
-static struct qhash_table *req_sched_table;
+/* protects the ready, timer, and mode queues, the state of timer and
+ * mode change elements, sched_count, and current_mode.  When both are
+ * needed, a shard mutex is always acquired before this one.
+ */
+static gen_mutex_t req_sched_mutex = GEN_MUTEX_INITIALIZER;
+
+/* elements that the shards do not cache come from here.  The cache
+ * outlives PINT_req_sched_finalize() because clients tear down the
+ * timer queue afterwards.
+ */
+static struct PINT_slab_cache *req_sched_element_cache = NULL;
 
 /* queue of requests that are ready for service (in case
- * test_world is called 
+ * test_world is called
  */
 static QLIST_HEAD(
     ready_queue);
@@ -127,6 +175,213 @@ enum PVFS_server_mode PINT_req_sched_get_mode(void)
     return(current_mode);
 }
 
+/* req_sched_shard_of()
+ *
+ * returns the shard that tracks requests on the given handle
+ */
+static struct req_sched_shard *req_sched_shard_of(
+    PVFS_handle handle)
+{
+    return (&req_sched_shards[handle % REQ_SCHED_SHARDS]);
+}
+
+/* req_sched_element_alloc()
+ *
+ * allocates a zeroed element, reusing one cached by the shard if
+ * possible.  Shard mutex must be held if shard is not NULL.
+ */
+static struct req_sched_element *req_sched_element_alloc(
+    struct req_sched_shard *shard)
+{
+    struct req_sched_element *element = NULL;
+
+    if (shard && !qlist_empty(&shard->free_elements))
+    {
+        element = qlist_entry(qlist_pop(&shard->free_elements),
+                              struct req_sched_element, list_link);
+        shard->free_element_count--;
+    }
+    else
+    {
+        element = (struct req_sched_element *)PINT_slab_alloc(
+            req_sched_element_cache);
+        if (!element)
+        {
+            return (NULL);
+        }
+    }
+    memset(element, 0, sizeof(*element));
+    element->shard = shard;
+    return (element);
+}
+
+/* req_sched_element_free()
+ *
+ * returns an element to its shard's cache, or frees it.  Shard mutex
+ * must be held if the element belongs to a shard.
+ */
+static void req_sched_element_free(
+    struct req_sched_element *element)
+{
+    struct req_sched_shard *shard = element->shard;
+
+    if (shard && shard->free_element_count < REQ_SCHED_SHARD_CACHE_MAX)
+    {
+        qlist_add(&element->list_link, &shard->free_elements);
+        shard->free_element_count++;
+        return;
+    }
+    PINT_slab_free(req_sched_element_cache, element);
+}
+
+/* req_sched_list_alloc()
+ *
+ * returns an empty queue for a handle that is not yet in the shard's
+ * table and adds it to the table.  Shard mutex must be held.
+ */
+static struct req_sched_list *req_sched_list_alloc(
+    struct req_sched_shard *shard,
+    PVFS_handle handle)
+{
+    struct req_sched_list *tmp_list = NULL;
+
+    if (!qlist_empty(&shard->free_lists))
+    {
+        tmp_list = qlist_entry(qlist_pop(&shard->free_lists),
+                               struct req_sched_list, hash_link);
+        shard->free_list_count--;
+    }
+    else
+    {
+        tmp_list = (struct req_sched_list *)malloc(
+            sizeof(struct req_sched_list));
+        if (!tmp_list)
+        {
+            return (NULL);
+        }
+    }
+
+    tmp_list->handle = handle;
+    INIT_QLIST_HEAD(&(tmp_list->req_list));
+    qhash_add(shard->table, &(handle), &(tmp_list->hash_link));
+    return (tmp_list);
+}
+
+/* req_sched_list_free()
+ *
+ * removes an empty queue from the shard's table and caches or frees
+ * it.  Shard mutex must be held.
+ */
+static void req_sched_list_free(
+    struct req_sched_shard *shard,
+    struct req_sched_list *tmp_list)
+{
+    qlist_del(&(tmp_list->hash_link));
+    if (shard->free_list_count < REQ_SCHED_SHARD_CACHE_MAX)
+    {
+        qlist_add(&tmp_list->hash_link, &shard->free_lists);
+        shard->free_list_count++;
+        return;
+    }
+    free(tmp_list);
+}
+
+/* req_sched_share_of()
+ *
+ * returns the req_sched_share flags that an element is able to share
+ * its handle under
+ */
+static int req_sched_share_of(
+    struct req_sched_element *element)
+{
+    int share = 0;
+
+    if (element->op == PVFS_SERV_IO)
+    {
+        share |= REQ_SHARE_IO;
+    }
+    if (element->access_type == PINT_SERVER_REQ_READONLY)
+    {
+        share |= REQ_SHARE_READONLY;
+    }
+    return (share);
+}
+
+/* req_sched_wake()
+ *
+ * moves the request at the front of a handle queue, and every queued
+ * request directly behind it that may share the handle with all of the
+ * requests ahead of it, to the ready queue.  A queued request is never
+ * bypassed.  Caller must hold the shard mutex and req_sched_mutex.
+ */
+static void req_sched_wake(
+    struct req_sched_list *tmp_list)
+{
+    struct qlist_head *iterator;
+    struct req_sched_element *next_element;
+    int share = 0;
+    int first = 1;
+
+    qlist_for_each(iterator, &tmp_list->req_list)
+    {
+        next_element = qlist_entry(iterator, struct req_sched_element,
+                                   list_link);
+        if (first)
+        {
+            share = req_sched_share_of(next_element);
+            first = 0;
+        }
+        else
+        {
+            share &= req_sched_share_of(next_element);
+            if (!share)
+            {
+                break;
+            }
+        }
+
+        if (next_element->state == REQ_QUEUED)
+        {
+            gossip_debug(GOSSIP_REQ_SCHED_DEBUG, "REQ SCHED "
+                         "readying request, handle: %llu, "
+                         "queue_element: %p\n",
+                         llu(next_element->handle), next_element);
+            next_element->state = REQ_READY_TO_SCHEDULE;
+            qlist_add_tail(&(next_element->ready_link), &ready_queue);
+        }
+
+        if (!share)
+        {
+            /* the front request does not share its handle */
+            break;
+        }
+    }
+}
+
+/* req_sched_lock_element()
+ *
+ * acquires the locks protecting an element the caller owns
+ */
+static void req_sched_lock_element(
+    struct req_sched_element *element)
+{
+    if (element->shard)
+    {
+        gen_mutex_lock(&element->shard->mutex);
+    }
+    gen_mutex_lock(&req_sched_mutex);
+}
+
+static void req_sched_unlock_element(
+    struct req_sched_shard *shard)
+{
+    gen_mutex_unlock(&req_sched_mutex);
+    if (shard)
+    {
+        gen_mutex_unlock(&shard->mutex);
+    }
+}
+
 /* setup and teardown */
 
 /** Initializes the request scheduler.  Must be called before any other
@@ -137,11 +392,40 @@ enum PVFS_server_mode PINT_req_sched_get_mode(void)
 int PINT_req_sched_initialize(
     void)
 {
-    /* build hash table */
-    req_sched_table = qhash_init(hash_handle_compare, hash_handle, 1021);
-    if (!req_sched_table)
+    int i;
+    struct req_sched_shard *shard;
+
+    if (!req_sched_element_cache)
     {
-	return (-ENOMEM);
+        req_sched_element_cache = PINT_slab_create(
+            "req_sched_element", sizeof(struct req_sched_element));
+        if (!req_sched_element_cache)
+        {
+            return (-ENOMEM);
+        }
+    }
+
+    /* build a hash table for each shard */
+    for (i = 0; i < REQ_SCHED_SHARDS; i++)
+    {
+        shard = &req_sched_shards[i];
+        shard->table = qhash_init(hash_handle_compare, hash_handle,
+                                  REQ_SCHED_SHARD_TABLE_SIZE);
+        if (!shard->table)
+        {
+            while (--i >= 0)
+            {
+                qhash_finalize(req_sched_shards[i].table);
+                req_sched_shards[i].table = NULL;
+                gen_mutex_destroy(&req_sched_shards[i].mutex);
+            }
+            return (-ENOMEM);
+        }
+        gen_mutex_init(&shard->mutex);
+        INIT_QLIST_HEAD(&shard->free_lists);
+        shard->free_list_count = 0;
+        INIT_QLIST_HEAD(&shard->free_elements);
+        shard->free_element_count = 0;
     }
 
     return (0);
@@ -155,6 +439,7 @@ int PINT_timer_queue_finalize(void)
    struct qlist_head *iterator=NULL;
    struct req_sched_element *element=NULL;
 
+   gen_mutex_lock(&req_sched_mutex);
    qlist_for_each_safe(iterator,scratch,&timer_queue)
    {
        element = qlist_entry(iterator,struct req_sched_element,list_link);
@@ -162,16 +447,17 @@ int PINT_timer_queue_finalize(void)
        if (element && element->user_ptr)
           free(element->user_ptr);
        if (element)
-          free(element);
+          PINT_slab_free(req_sched_element_cache, element);
        element=NULL;
    }
+   gen_mutex_unlock(&req_sched_mutex);
 
   return(0);
 }
 
 
 
-/** Tears down the request scheduler and its data structures 
+/** Tears down the request scheduler and its data structures
  *
  *  \return 0 on success, -errno on failure
  */
@@ -179,6 +465,8 @@ int PINT_req_sched_finalize(
     void)
 {
     int i;
+    int j;
+    struct req_sched_shard *shard;
     struct req_sched_list *tmp_list;
     struct qlist_head *scratch;
     struct qlist_head *iterator;
@@ -186,35 +474,70 @@ int PINT_req_sched_finalize(
     struct qlist_head *iterator2;
     struct req_sched_element *tmp_element;
 
-    /* iterate through the hash table */
-    for (i = 0; i < req_sched_table->table_size; i++)
+    for (j = 0; j < REQ_SCHED_SHARDS; j++)
     {
-	/* remove any queues from the table */
-	qlist_for_each_safe(iterator, scratch, &(req_sched_table->array[i]))
-	{
-	    tmp_list = qlist_entry(iterator, struct req_sched_list,
-				   hash_link);
-	    /* remove any elements from each queue */
-	    qlist_for_each_safe(iterator2, scratch2, &(tmp_list->req_list))
-	    {
-		tmp_element = qlist_entry(iterator2, struct req_sched_element,
-					  list_link);
-		free(tmp_element);
-		/* note: no need to delete from list; we are
-		 * destroying it as we go 
-		 */
-	    }
-	    free(tmp_list);
-	    /* note: no need to delete from list; we are destroying
-	     * it as we go
-	     */
-	}
+        shard = &req_sched_shards[j];
+        if (!shard->table)
+        {
+            continue;
+        }
+        gen_mutex_lock(&shard->mutex);
+
+        /* iterate through the hash table */
+        for (i = 0; i < shard->table->table_size; i++)
+        {
+            /* remove any queues from the table */
+            qlist_for_each_safe(iterator, scratch, &(shard->table->array[i]))
+            {
+                tmp_list = qlist_entry(iterator, struct req_sched_list,
+                                       hash_link);
+                /* remove any elements from each queue */
+                qlist_for_each_safe(iterator2, scratch2,
+                                    &(tmp_list->req_list))
+                {
+                    tmp_element = qlist_entry(iterator2,
+                                              struct req_sched_element,
+                                              list_link);
+                    PINT_slab_free(req_sched_element_cache, tmp_element);
+                    /* note: no need to delete from list; we are
+                     * destroying it as we go
+                     */
+                }
+                free(tmp_list);
+                /* note: no need to delete from list; we are destroying
+                 * it as we go
+                 */
+            }
+        }
+
+        /* empty the caches */
+        qlist_for_each_safe(iterator, scratch, &shard->free_lists)
+        {
+            free(qlist_entry(iterator, struct req_sched_list, hash_link));
+        }
+        INIT_QLIST_HEAD(&shard->free_lists);
+        shard->free_list_count = 0;
+        qlist_for_each_safe(iterator, scratch, &shard->free_elements)
+        {
+            PINT_slab_free(req_sched_element_cache,
+                           qlist_entry(iterator, struct req_sched_element,
+                                       list_link));
+        }
+        INIT_QLIST_HEAD(&shard->free_elements);
+        shard->free_element_count = 0;
+
+        /* tear down hash table */
+        qhash_finalize(shard->table);
+        shard->table = NULL;
+        gen_mutex_unlock(&shard->mutex);
+        gen_mutex_destroy(&shard->mutex);
     }
 
+    gen_mutex_lock(&req_sched_mutex);
+    INIT_QLIST_HEAD(&ready_queue);
     sched_count = 0;
+    gen_mutex_unlock(&req_sched_mutex);
 
-    /* tear down hash table */
-    qhash_finalize(req_sched_table);
     return (0);
 }
 
@@ -227,13 +550,11 @@ int PINT_req_sched_change_mode(enum PVFS_server_mode mode,
     struct req_sched_element *mode_element;
 
     /* create a structure to store in the request queues */
-    mode_element = (struct req_sched_element *) malloc(
-        sizeof(struct req_sched_element));
+    mode_element = req_sched_element_alloc(NULL);
     if (!mode_element)
     {
         return (-errno);
     }
-    memset(mode_element, 0, sizeof(*mode_element));
 
     mode_element->user_ptr = user_ptr;
     id_gen_fast_register(id, mode_element);
@@ -242,6 +563,8 @@ int PINT_req_sched_change_mode(enum PVFS_server_mode mode,
     mode_element->mode_change = 1;
     mode_element->mode = mode;
 
+    gen_mutex_lock(&req_sched_mutex);
+
     /* will this be the front of the queue */
     if(qlist_empty(&mode_queue))
         mode_change_ready = 1;
@@ -277,15 +600,18 @@ int PINT_req_sched_change_mode(enum PVFS_server_mode mode,
             /* TODO: be nicer about this */
             assert(0);
         }
+        gen_mutex_unlock(&req_sched_mutex);
         return(ret);
     }
     else
     {
         mode_element->state = REQ_QUEUED;
+        gen_mutex_unlock(&req_sched_mutex);
         return(0);
     }
 }
 
+/* must hold req_sched_mutex */
 static int PINT_req_sched_in_admin_mode(void)
 {
     struct req_sched_element *mode_element = NULL;
@@ -300,6 +626,7 @@ static int PINT_req_sched_in_admin_mode(void)
     return 0;
 }
 
+/* must hold req_sched_mutex */
 static int PINT_req_sched_schedule_mode_change(void)
 {
     struct req_sched_element *next_element;
@@ -316,6 +643,7 @@ static int PINT_req_sched_schedule_mode_change(void)
     return 0;
 }
 
+/* must hold req_sched_mutex */
 static void PINT_req_sched_do_change_mode(
     struct req_sched_element *req_sched_element)
 {
@@ -342,13 +670,14 @@ int PINT_req_sched_post(enum PVFS_server_op op,
 {
     struct qlist_head *hash_link;
     int ret = -1;
+    struct req_sched_shard *shard;
     struct req_sched_element *tmp_element;
     struct req_sched_element *tmp_element2;
     struct req_sched_list *tmp_list;
     struct req_sched_element *next_element;
     struct req_sched_element *last_element;
     struct qlist_head *iterator;
-    int tmp_flag;
+    int share;
 
     if(sched_policy == PINT_SERVER_REQ_BYPASS)
     {
@@ -357,7 +686,10 @@ int PINT_req_sched_post(enum PVFS_server_op op,
             /* if this requests modifies the file system, we have to check
              * to see if we are in admin mode or about to enter admin mode
              */
-            if(PINT_req_sched_in_admin_mode())
+            gen_mutex_lock(&req_sched_mutex);
+            ret = PINT_req_sched_in_admin_mode();
+            gen_mutex_unlock(&req_sched_mutex);
+            if(ret)
             {
                 return (-PVFS_EAGAIN);
             }
@@ -372,15 +704,16 @@ int PINT_req_sched_post(enum PVFS_server_op op,
      * operating on a particular handle, but we will queue anyway
      * on handle == 0 for the moment...
      */
+    shard = req_sched_shard_of(handle);
+    gen_mutex_lock(&shard->mutex);
 
     /* create a structure to store in the request queues */
-    tmp_element = (struct req_sched_element *) malloc(sizeof(struct
-							     req_sched_element));
+    tmp_element = req_sched_element_alloc(shard);
     if (!tmp_element)
     {
+        gen_mutex_unlock(&shard->mutex);
 	return (-errno);
     }
-    memset(tmp_element, 0, sizeof(*tmp_element));
 
     tmp_element->op = op;
     tmp_element->user_ptr = in_user_ptr;
@@ -394,15 +727,19 @@ int PINT_req_sched_post(enum PVFS_server_op op,
 
     if(access_type == PINT_SERVER_REQ_MODIFY && !PVFS_SERV_IS_MGMT_OP(op))
     {
-        if(PINT_req_sched_in_admin_mode())
+        gen_mutex_lock(&req_sched_mutex);
+        ret = PINT_req_sched_in_admin_mode();
+        gen_mutex_unlock(&req_sched_mutex);
+        if(ret)
         {
-            free(tmp_element);
+            req_sched_element_free(tmp_element);
+            gen_mutex_unlock(&shard->mutex);
             return(-PVFS_EAGAIN);
         }
     }
 
     /* see if we have a request queue up for this handle */
-    hash_link = qhash_search(req_sched_table, &(handle));
+    hash_link = qhash_search(shard->table, &(handle));
     if (hash_link)
     {
 	/* we already have a queue for this handle */
@@ -413,19 +750,13 @@ int PINT_req_sched_post(enum PVFS_server_op op,
     {
 	/* no queue yet for this handle */
 	/* create one and add it in */
-	tmp_list = (struct req_sched_list *)malloc(
-            sizeof(struct req_sched_list));
+	tmp_list = req_sched_list_alloc(shard, handle);
 	if (!tmp_list)
 	{
-	    free(tmp_element);
+	    req_sched_element_free(tmp_element);
+            gen_mutex_unlock(&shard->mutex);
 	    return (-ENOMEM);
 	}
-
-	tmp_list->handle = handle;
-	INIT_QLIST_HEAD(&(tmp_list->req_list));
-
-	qhash_add(req_sched_table, &(handle), &(tmp_list->hash_link));
-
     }
 
     /* at either rate, we now have a pointer to the list head */
@@ -438,96 +769,57 @@ int PINT_req_sched_post(enum PVFS_server_op op,
     }
     else
     {
-        /* check queue to see if we can apply any optimizations */
-        /* first check: are all current queued operations already scheduled
-         * (ie, is the first and last scheduled?).  We can never bypass a
-         * queued operation 
+        /* check queue to see if we can apply any optimizations.  We can
+         * never bypass a queued operation, but we may run alongside
+         * operations that have already been let through if every one of
+         * them can share the handle with us: either all I/O, or all
+         * read only.
          */
+        share = req_sched_share_of(tmp_element);
+        qlist_for_each(iterator, &tmp_list->req_list)
+        {
+            tmp_element2 = qlist_entry(iterator, struct req_sched_element,
+                list_link);
+            if(tmp_element2->state == REQ_QUEUED)
+            {
+                share = 0;
+                break;
+            }
+            share &= req_sched_share_of(tmp_element2);
+            if(!share)
+            {
+                break;
+            }
+        }
+
 	next_element = qlist_entry((tmp_list->req_list.next),
 				   struct req_sched_element,
 				   list_link);
 	last_element = qlist_entry((tmp_list->req_list.prev),
 				   struct req_sched_element,
 				   list_link);
-	if (op == PVFS_SERV_IO &&
-	    next_element->state == REQ_SCHEDULED &&
-	    last_element->state == REQ_SCHEDULED)
-	{
-            /* possible I/O optimization: see if all scheduled ops for this
-             * handle are for I/O.  If so, we can allow another concurrent
-             * I/O request to proceed 
-             */
-            tmp_flag = 0;
-            qlist_for_each(iterator, &tmp_list->req_list)
-            {
-                tmp_element2 = qlist_entry(iterator, struct req_sched_element,
-                    list_link);
-                if(tmp_element2->op != PVFS_SERV_IO)
-                {
-                    tmp_flag = 1;
-                    break;
-                }
-            }
-
-            if(!tmp_flag)
-            {
-                tmp_element->state = REQ_SCHEDULED;
-                ret = 1;
-                gossip_debug(GOSSIP_REQ_SCHED_DEBUG, "REQ SCHED allowing "
-                             "concurrent I/O, handle: %llu\n", llu(handle));
-            }
-            else
-            {
-                tmp_element->state = REQ_QUEUED;
-                ret = 0;
-            }
-	}
-	else if (access_type == PINT_SERVER_REQ_READONLY &&
-	    next_element->state == REQ_SCHEDULED &&
-	    last_element->state == REQ_SCHEDULED)
+        if(share)
         {
-            /* possible read only optimization: see if all scheduled ops 
-             * for this handle are read only.  If so, we can allow another 
-             * concurrent read only request to proceed 
-             */
-            tmp_flag = 0;
-            qlist_for_each(iterator, &tmp_list->req_list)
-            {
-                tmp_element2 = qlist_entry(iterator, struct req_sched_element,
-                    list_link);
-                if(tmp_element2->access_type == PINT_SERVER_REQ_MODIFY)
-                {
-                    tmp_flag = 1;
-                    break;
-                }
-            }
-
-            if(!tmp_flag)
-            {
-                tmp_element->state = REQ_SCHEDULED;
-                ret = 1;
-                gossip_debug(GOSSIP_REQ_SCHED_DEBUG, "REQ SCHED allowing "
-                             "concurrent read only, handle: %llu\n", llu(handle));
-            }
-            else
-            {
-                tmp_element->state = REQ_QUEUED;
-                ret = 0;
-            }
+            tmp_element->state = REQ_SCHEDULED;
+            ret = 1;
+            gossip_debug(GOSSIP_REQ_SCHED_DEBUG, "REQ SCHED allowing "
+                         "concurrent %s, handle: %llu\n",
+                         (share & REQ_SHARE_READONLY) ? "read only" : "I/O",
+                         llu(handle));
         }
         else if((op == PVFS_SERV_CRDIRENT || op == PVFS_SERV_RMDIRENT) &&
                 next_element->state == REQ_SCHEDULED &&
                 last_element->state == REQ_SCHEDULED)
         {
             /* possible dirent optimization: see if all scheduled ops for this
-             * handle are for crdirent or rmdirent.  
+             * handle are for crdirent or rmdirent.
              * If so, we can allow another concurrent
              * dirent request to proceed.
              */
             tmp_element->state = REQ_SCHEDULED;
             tmp_element->access_type = PINT_SERVER_REQ_READONLY;
             gossip_debug(GOSSIP_REQ_SCHED_DEBUG, "REQ SCHED allowing "
-                         "concurrent dirent op, handle: %llu\n", 
+                         "concurrent dirent op, handle: %llu\n",
                          llu(handle));
             ret = 1;
         }
@@ -552,12 +844,16 @@ int PINT_req_sched_post(enum PVFS_server_op op,
                      "handle: %llu, queue_element: %p\n",
 		     llu(handle), tmp_element);
     }
+
+    gen_mutex_lock(&req_sched_mutex);
     sched_count++;
+    gen_mutex_unlock(&req_sched_mutex);
+    gen_mutex_unlock(&shard->mutex);
     return (ret);
 }
 
 
-/** posts a timer - will complete like a normal request at approximately 
+/** posts a timer - will complete like a normal request at approximately
  *  the interval specified
  *
  *  \return 1 on immediate completion, 0 if caller should test later,
@@ -578,13 +874,11 @@ int PINT_req_sched_post_timer(
 	return(1);
 
     /* create a structure to store in the request queues */
-    tmp_element = (struct req_sched_element *)malloc(
-        sizeof(struct req_sched_element));
+    tmp_element = req_sched_element_alloc(NULL);
     if (!tmp_element)
     {
 	return (-errno);
     }
-    memset(tmp_element, 0, sizeof(*tmp_element));
 
     tmp_element->user_ptr = in_user_ptr;
     id_gen_fast_register(out_id, tmp_element);
@@ -604,6 +898,8 @@ int PINT_req_sched_post_timer(
 	tmp_element->tv.tv_usec = tmp_element->tv.tv_usec % 1000000;
     }
 
+    gen_mutex_lock(&req_sched_mutex);
+
     /* put in timer queue, in order */
     qlist_for_each_safe(iterator, scratch, &timer_queue)
     {
@@ -611,7 +907,7 @@ int PINT_req_sched_post_timer(
 	next_element = qlist_entry(iterator, struct req_sched_element,
 	    list_link);
 	if((next_element->tv.tv_sec > tmp_element->tv.tv_sec)
-	    || (next_element->tv.tv_sec == tmp_element->tv.tv_sec 
+	    || (next_element->tv.tv_sec == tmp_element->tv.tv_sec
 		&& next_element->tv.tv_usec > tmp_element->tv.tv_usec))
 	{
 	    found = 1;
@@ -629,6 +925,8 @@ int PINT_req_sched_post_timer(
 	qlist_add_tail(&tmp_element->list_link, &timer_queue);
     }
 
+    gen_mutex_unlock(&req_sched_mutex);
+
 #if 0
     gossip_debug(GOSSIP_REQ_SCHED_DEBUG,
 		 "REQ SCHED POSTING, queue_element: %p\n",
@@ -641,33 +939,30 @@ int PINT_req_sched_post_timer(
 /** Removes a request from the scheduler before it has even been
  *  scheduled
  *
- *  \return 0 on success, -errno on failure 
+ *  \return 0 on success, -errno on failure
  */
 int PINT_req_sched_unpost(
     req_sched_id in_id,
     void **returned_user_ptr)
 {
     struct req_sched_element *tmp_element = NULL;
-    struct req_sched_element *next_element = NULL;
-    int next_ready_flag = 0;
-
-    /* NOTE: we set the next_ready_flag to 1 if the next element in
-     * the queue should be put in the ready list 
-     */
+    struct req_sched_shard *shard = NULL;
 
     /* retrieve the element directly from the id */
     tmp_element = id_gen_fast_lookup(in_id);
+    shard = tmp_element->shard;
+    req_sched_lock_element(tmp_element);
 
     /* make sure it isn't already scheduled */
     if (tmp_element->state == REQ_SCHEDULED)
     {
+        req_sched_unlock_element(shard);
 	return (-EALREADY);
     }
 
     if (tmp_element->state == REQ_READY_TO_SCHEDULE)
     {
 	qlist_del(&(tmp_element->ready_link));
-	next_ready_flag = 1;
 	/* fall through on purpose */
     }
 
@@ -685,66 +980,28 @@ int PINT_req_sched_unpost(
 	if (qlist_empty(&(tmp_element->list_head->req_list)))
 	{
 	    /* queue now empty, remove from hash table and destroy */
-	    qlist_del(&(tmp_element->list_head->hash_link));
-	    free(tmp_element->list_head);
+	    req_sched_list_free(shard, tmp_element->list_head);
 	}
 	else
 	{
-	    /* queue not empty, prepare next request in line for
-	     * processing if necessary
+	    /* queue not empty, prepare requests that were waiting on
+	     * this one for processing if necessary
 	     */
-	    if (next_ready_flag)
-	    {
-		next_element =
-		    qlist_entry((tmp_element->list_head->req_list.next),
-				struct req_sched_element,
-				list_link);
-		/* skip looking at the next request if it is already
-		 * ready to go 
-		 */
-		if (next_element->state != REQ_READY_TO_SCHEDULE &&
-		    next_element->state != REQ_SCHEDULED)
-		{
-		    next_element->state = REQ_READY_TO_SCHEDULE;
-		    qlist_add_tail(&(next_element->ready_link), &ready_queue);
-		    /* keep going as long as the operations are I/O requests;
-		     * we let these all go concurrently
-		     */
-		    while (next_element && next_element->op == PVFS_SERV_IO
-			   && next_element->list_link.next !=
-			   &(tmp_element->list_head->req_list))
-		    {
-			next_element =
-			    qlist_entry(next_element->list_link.next,
-					struct req_sched_element,
-					list_link);
-			if (next_element
-			    && next_element->op == PVFS_SERV_IO)
-			{
-			    gossip_debug(
-                                GOSSIP_REQ_SCHED_DEBUG, "REQ SCHED "
-                                "allowing concurrent I/O, handle: %llu\n",
-                                llu(next_element->handle));
-			    next_element->state = REQ_READY_TO_SCHEDULE;
-			    qlist_add_tail(&(next_element->ready_link),
-					   &ready_queue);
-			}
-		    }
-		}
-	    }
+	    req_sched_wake(tmp_element->list_head);
 	}
 	sched_count--;
     }
 
     /* destroy the unposted element */
-    free(tmp_element);
+    req_sched_element_free(tmp_element);
 
     PINT_req_sched_schedule_mode_change();
+    req_sched_unlock_element(shard);
     return (0);
 }
 
 /** releases a completed request from the scheduler, potentially
- *  allowing other requests to proceed 
+ *  allowing other requests to proceed
  *
  *  \return 1 on immediate successful completion, 0 to test later,
  *  -errno on failure
@@ -756,7 +1013,7 @@ int PINT_req_sched_release(
 {
     struct req_sched_element *tmp_element = NULL;
     struct req_sched_list *tmp_list = NULL;
-    struct req_sched_element *next_element = NULL;
+    struct req_sched_shard *shard = NULL;
 
     /* NOTE: for now, this function always returns immediately- no
      * need to fill in the out_id
@@ -773,6 +1030,8 @@ int PINT_req_sched_release(
 
     /* retrieve the element directly from the id */
     tmp_element = id_gen_fast_lookup(in_completed_id);
+    shard = tmp_element->shard;
+    req_sched_lock_element(tmp_element);
 
     /* remove it from its handle queue */
     qlist_del(&(tmp_element->list_link));
@@ -784,89 +1043,22 @@ int PINT_req_sched_release(
     if(tmp_list)
     {
 	/* find out if there is another operation queued behind it or
-	 * not 
+	 * not
 	 */
 	if (qlist_empty(&(tmp_list->req_list)))
 	{
 	    /* nothing else in this queue, remove it from the hash table
-	     * and deallocate 
+	     * and deallocate
 	     */
-	    qlist_del(&(tmp_list->hash_link));
-	    free(tmp_list);
+	    req_sched_list_free(shard, tmp_list);
 	}
 	else
 	{
-	    /* something is queued behind this request */
-	    /* find the next request, change its state, and add it to
-	     * the queue of requests that are ready to be scheduled
-	     */
-	    next_element = qlist_entry((tmp_list->req_list.next),
-				       struct req_sched_element,
-				       list_link);
-	    /* skip it if the top queue item is already ready for
-	     * scheduling 
+	    /* something is queued behind this request; change the state
+	     * of whatever may now run and add it to the queue of requests
+	     * that are ready to be scheduled
 	     */
-	    if (next_element->state != REQ_READY_TO_SCHEDULE &&
-		next_element->state != REQ_SCHEDULED)
-	    {
-		next_element->state = REQ_READY_TO_SCHEDULE;
-		qlist_add_tail(&(next_element->ready_link), &ready_queue);
-
-                if(next_element->op == PVFS_SERV_IO)
-                {
-                    /* keep going as long as the operations are I/O requests;
-                     * we let these all go concurrently
-                     */
-                    while (next_element &&
-                           (next_element->op == PVFS_SERV_IO) &&
-                           (next_element->list_link.next != &(tmp_list->req_list)))
-                    {
-                        next_element =
-                            qlist_entry(next_element->list_link.next,
-                                        struct req_sched_element,
-                                        list_link);
-                        if (next_element &&
-                            (next_element->op == PVFS_SERV_IO))
-                        {
-                            gossip_debug(
-                                GOSSIP_REQ_SCHED_DEBUG,
-                                "REQ SCHED allowing concurrent I/O (release time), "
-                                "handle: %llu\n", llu(next_element->handle));
-                            assert(next_element->state == REQ_QUEUED);
-                            next_element->state = REQ_READY_TO_SCHEDULE;
-                            qlist_add_tail(
-                                &(next_element->ready_link), &ready_queue);
-                        }
-                    }
-                }
-                else if(next_element->access_type == PINT_SERVER_REQ_READONLY)
-                {
-                    /* keep going as long as the operations are read only;
-                     * we let these all go concurrently
-                     */
-                    while (next_element &&
-                           (next_element->access_type == PINT_SERVER_REQ_READONLY) &&
-                           (next_element->list_link.next != &(tmp_list->req_list)))
-                    {
-                        next_element =
-                            qlist_entry(next_element->list_link.next,
-                                        struct req_sched_element,
-                                        list_link);
-                        if (next_element &&
-                            (next_element->access_type == PINT_SERVER_REQ_READONLY))
-                        {
-                            gossip_debug(
-                                GOSSIP_REQ_SCHED_DEBUG,
-                                "REQ SCHED allowing concurrent read only (release time), "
-                                "handle: %llu\n", llu(next_element->handle));
-                            assert(next_element->state == REQ_QUEUED);
-                            next_element->state = REQ_READY_TO_SCHEDULE;
-                            qlist_add_tail(
-                                &(next_element->ready_link), &ready_queue);
-                        }
-                    }
-                }
-	    }
+	    req_sched_wake(tmp_list);
 	}
 	sched_count--;
     }
@@ -876,9 +1068,10 @@ int PINT_req_sched_release(
 		 llu(tmp_element->handle), tmp_element);
 
     /* destroy the released request element */
-    free(tmp_element);
+    req_sched_element_free(tmp_element);
 
     PINT_req_sched_schedule_mode_change();
+    req_sched_unlock_element(shard);
     return (1);
 }
 
@@ -895,23 +1088,27 @@ int PINT_req_sched_test(
     req_sched_error_code * out_status)
 {
     struct req_sched_element *tmp_element = NULL;
+    struct req_sched_shard *shard = NULL;
     struct timeval tv;
+    int ret;
 
     *out_count_p = 0;
 
     /* retrieve the element directly from the id */
     tmp_element = id_gen_fast_lookup(in_id);
+    shard = tmp_element->shard;
+    req_sched_lock_element(tmp_element);
 
     /* sanity check the state */
     if (tmp_element->state == REQ_SCHEDULED)
     {
 	/* it's already scheduled! */
-	return (-EINVAL);
+	ret = -EINVAL;
     }
     else if (tmp_element->state == REQ_QUEUED)
     {
 	/* it still isn't ready to schedule */
-	return (0);
+	ret = 0;
     }
     else if (tmp_element->state == REQ_READY_TO_SCHEDULE)
     {
@@ -930,7 +1127,7 @@ int PINT_req_sched_test(
                      llu(tmp_element->handle), tmp_element);
 
         PINT_req_sched_do_change_mode(tmp_element);
-        return (1);
+        ret = 1;
     }
     else if (tmp_element->state == REQ_TIMING)
     {
@@ -951,19 +1148,22 @@ int PINT_req_sched_test(
 	    gossip_debug(GOSSIP_REQ_SCHED_DEBUG,
 			 "REQ SCHED TIMER SCHEDULING, queue_element: %p\n",
 			 tmp_element);
-	    free(tmp_element);
-	    return (1);
+	    req_sched_element_free(tmp_element);
+	    ret = 1;
 	}
 	else
 	{
-	    return(0);
+	    ret = 0;
 	}
     }
     else
     {
         /* should not hit this point */
-	return (-EINVAL);
+	ret = -EINVAL;
     }
+
+    req_sched_unlock_element(shard);
+    return (ret);
 }
 
 /** Tests for completion of one or more of a set of scheduler operations.
@@ -976,30 +1176,36 @@ int PINT_req_sched_testsome(
     req_sched_error_code * out_status_array)
 {
     struct req_sched_element *tmp_element = NULL;
+    struct req_sched_shard *shard = NULL;
     int i;
     int incount = *inout_count_p;
     struct timeval tv;
+    int ret = 0;
 
     *inout_count_p = 0;
 
-    /* if there are any pending timer events, go ahead and get the 
+    /* if there are any pending timer events, go ahead and get the
      * current time so that we are ready if we run across one
      */
+    gen_mutex_lock(&req_sched_mutex);
     if(!qlist_empty(&timer_queue))
     {
 	gettimeofday(&tv, NULL);
     }
+    gen_mutex_unlock(&req_sched_mutex);
 
-    for (i = 0; i < incount; i++)
+    for (i = 0; i < incount && ret == 0; i++)
     {
 	/* retrieve the element directly from the id */
 	tmp_element = id_gen_fast_lookup(in_id_array[i]);
+        shard = tmp_element->shard;
+        req_sched_lock_element(tmp_element);
 
 	/* sanity check the state */
 	if (tmp_element->state == REQ_SCHEDULED)
 	{
 	    /* it's already scheduled! */
-	    return (-EINVAL);
+	    ret = -EINVAL;
 	}
 	else if (tmp_element->state == REQ_QUEUED)
 	{
@@ -1030,14 +1236,14 @@ int PINT_req_sched_testsome(
 	    /* timer event, see if we have hit time value yet */
 	    gettimeofday(&tv, NULL);
 	    if((tmp_element->tv.tv_sec < tv.tv_sec) ||
-		(tmp_element->tv.tv_sec == tv.tv_sec 
+		(tmp_element->tv.tv_sec == tv.tv_sec
 		    && tmp_element->tv.tv_usec < tv.tv_usec))
 	    {
 		/* time to go */
 		qlist_del(&(tmp_element->list_link));
 		if (returned_user_ptr_array)
 		{
-		    returned_user_ptr_array[*inout_count_p] = 
+		    returned_user_ptr_array[*inout_count_p] =
 			tmp_element->user_ptr;
 		}
 		out_index_array[*inout_count_p] = i;
@@ -1046,14 +1252,18 @@ int PINT_req_sched_testsome(
 		gossip_debug(GOSSIP_REQ_SCHED_DEBUG,
 			     "REQ SCHED TIMER SCHEDULING, queue_element: %p\n",
 			     tmp_element);
-		free(tmp_element);
+		req_sched_element_free(tmp_element);
 	    }
 	}
 	else
 	{
-	    return (-EINVAL);
+	    ret = -EINVAL;
 	}
+
+        req_sched_unlock_element(shard);
     }
+    if (ret < 0)
+        return (ret);
     if (*inout_count_p > 0)
 	return (1);
     else
@@ -1070,12 +1280,15 @@ int PINT_req_sched_testworld(
 {
     int incount = *inout_count_p;
     struct req_sched_element *tmp_element;
+    struct req_sched_shard *shard;
     struct qlist_head* scratch;
     struct qlist_head* iterator;
     struct timeval tv;
 
     *inout_count_p = 0;
 
+    gen_mutex_lock(&req_sched_mutex);
+
     /* do timers first, if we have them */
     if(!qlist_empty(&timer_queue))
     {
@@ -1084,10 +1297,10 @@ int PINT_req_sched_testworld(
 	{
 	    tmp_element = qlist_entry(iterator, struct req_sched_element,
 		list_link);
-	    if((tmp_element->tv.tv_sec > tv.tv_sec) 
-		|| (tmp_element->tv.tv_sec == tv.tv_sec && 
+	    if((tmp_element->tv.tv_sec > tv.tv_sec)
+		|| (tmp_element->tv.tv_sec == tv.tv_sec &&
 		    tmp_element->tv.tv_usec > tv.tv_usec))
-	    {	
+	    {
 		break;
 	    }
 	    else
@@ -1105,7 +1318,7 @@ int PINT_req_sched_testworld(
 			     "REQ SCHED SCHEDULING, queue_element: %p\n",
 			     tmp_element);
 #endif
-		free(tmp_element);
+		req_sched_element_free(tmp_element);
 		if(*inout_count_p == incount)
 		    break;
 	    }
@@ -1116,6 +1329,25 @@ int PINT_req_sched_testworld(
     {
 	tmp_element = qlist_entry((ready_queue.next), struct req_sched_element,
 				  ready_link);
+        shard = tmp_element->shard;
+        if (shard)
+        {
+            /* the element's state belongs to its shard, whose mutex
+             * has to be taken first; the element may have been unposted
+             * by the time we hold both, so look again
+             */
+            gen_mutex_unlock(&req_sched_mutex);
+            gen_mutex_lock(&shard->mutex);
+            gen_mutex_lock(&req_sched_mutex);
+            if (qlist_empty(&ready_queue) ||
+                ready_queue.next != &tmp_element->ready_link ||
+                tmp_element->shard != shard)
+            {
+                gen_mutex_unlock(&shard->mutex);
+                continue;
+            }
+        }
+
 	/* remove from ready queue */
 	qlist_del(&(tmp_element->ready_link));
 	out_id_array[*inout_count_p] = tmp_element->id;
@@ -1131,7 +1363,18 @@ int PINT_req_sched_testworld(
                      "handle: %llu, queue_element: %p\n",
 		     llu(tmp_element->handle), tmp_element);
         PINT_req_sched_do_change_mode(tmp_element);
+
+        if (shard)
+        {
+            /* keep lock order: drop ours, then the shard's */
+            gen_mutex_unlock(&req_sched_mutex);
+            gen_mutex_unlock(&shard->mutex);
+            gen_mutex_lock(&req_sched_mutex);
+        }
     }
+
+    gen_mutex_unlock(&req_sched_mutex);
+
     if (*inout_count_p > 0)
 	return (1);
     else
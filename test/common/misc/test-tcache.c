@@ -62,6 +62,14 @@ int main(int argc, char **argv)
     }
     printf("Done.\n");
 
+    /* the limits below count single entries; keep them in one shard */
+    printf("Setting TCACHE_NUM_SHARDS... ");
+    ret = PINT_tcache_set_info(test_tcache, TCACHE_NUM_SHARDS, 3);
+    assert(ret == -PVFS_EINVAL);
+    ret = PINT_tcache_set_info(test_tcache, TCACHE_NUM_SHARDS, 1);
+    assert(ret == 0);
+    printf("Done.\n");
+
     /* set parameters */
     printf("Setting all TCACHE parameters... ");
     param = TEST_TIMEOUT_MSEC;
@@ -335,6 +343,14 @@ int main(int argc, char **argv)
     assert(ret == 0);
     printf("Done.\n");
 
+    /* the limits below count single entries; keep them in one shard */
+    printf("Setting TCACHE_NUM_SHARDS... ");
+    ret = PINT_tcache_set_info(test_tcache, TCACHE_NUM_SHARDS, 3);
+    assert(ret == -PVFS_EINVAL);
+    ret = PINT_tcache_set_info(test_tcache, TCACHE_NUM_SHARDS, 1);
+    assert(ret == 0);
+    printf("Done.\n");
+
     /* set parameters */
     printf("Setting all TCACHE parameters... ");
     param = TEST_TIMEOUT_MSEC;